@@ -276,6 +276,13 @@ static GDateTime *gst_dash_demux_get_server_now_utc (GstDashDemux * demux);
 #define SIDX_ENTRY(s,i) (&(SIDX(s)->entries[(i)]))
 #define SIDX_CURRENT_ENTRY(s) SIDX_ENTRY(s, SIDX(s)->entry_index)
 
+#define IS_TRICKMODE_KEY_UNITS(d) \
+    (((d)->segment.flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS) != 0)
+
+static void gst_dash_demux_stream_sidx_seek (GstDashDemuxStream * dashstream,
+    gboolean forward, GstSeekFlags flags, GstClockTime ts,
+    GstClockTime * final_ts);
+
 static void gst_dash_demux_send_content_protection_event (gpointer cp_data,
     gpointer stream);
 
@@ -292,6 +299,11 @@ gst_dash_demux_dispose (GObject * obj)
 
   gst_dash_demux_reset (GST_ADAPTIVE_DEMUX_CAST (demux));
 
+  if (demux->sidx_cache) {
+    g_hash_table_unref (demux->sidx_cache);
+    demux->sidx_cache = NULL;
+  }
+
   if (demux->client) {
     gst_mpd_client_free (demux->client);
     demux->client = NULL;
@@ -469,6 +481,9 @@ gst_dash_demux_init (GstDashDemux * demux)
 
   g_mutex_init (&demux->client_lock);
 
+  demux->sidx_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) gst_isoff_sidx_box_free);
+
   gst_adaptive_demux_set_stream_struct_size (GST_ADAPTIVE_DEMUX_CAST (demux),
       sizeof (GstDashDemuxStream));
 }
@@ -621,6 +636,7 @@ gst_dash_demux_setup_all_streams (GstDashDemux * demux)
           (stream), tags);
     stream->index = i;
     stream->pending_seek_ts = GST_CLOCK_TIME_NONE;
+    stream->pending_seek_flags = 0;
     if (active_stream->cur_adapt_set &&
         active_stream->cur_adapt_set->RepresentationBase &&
         active_stream->cur_adapt_set->RepresentationBase->ContentProtection) {
@@ -867,6 +883,12 @@ gst_dash_demux_reset (GstAdaptiveDemux * ademux)
   demux->end_of_period = FALSE;
   demux->end_of_manifest = FALSE;
 
+  if (demux->sidx_cache) {
+    GST_OBJECT_LOCK (demux);
+    g_hash_table_remove_all (demux->sidx_cache);
+    GST_OBJECT_UNLOCK (demux);
+  }
+
   if (demux->client) {
     gst_mpd_client_free (demux->client);
     demux->client = NULL;
@@ -1007,6 +1029,90 @@ gst_dash_demux_stream_update_headers_info (GstAdaptiveDemuxStream * stream)
   }
 }
 
+static gchar *
+gst_dash_demux_stream_index_cache_key (GstAdaptiveDemuxStream * stream)
+{
+  if (stream->fragment.index_uri == NULL)
+    return NULL;
+
+  return g_strdup_printf ("%s@%" G_GINT64_FORMAT "-%" G_GINT64_FORMAT,
+      stream->fragment.index_uri, stream->fragment.index_range_start,
+      stream->fragment.index_range_end);
+}
+
+/* positions a freshly parsed or restored index at the subsegment we need to
+ * resume from */
+static void
+gst_dash_demux_stream_sidx_index_ready (GstDashDemuxStream * dashstream)
+{
+  GstAdaptiveDemux *demux = ((GstAdaptiveDemuxStream *) dashstream)->demux;
+  GstSidxBox *sidx = SIDX (dashstream);
+
+  if (GST_CLOCK_TIME_IS_VALID (dashstream->pending_seek_ts)) {
+    gst_dash_demux_stream_sidx_seek (dashstream, demux->segment.rate >= 0,
+        dashstream->pending_seek_flags, dashstream->pending_seek_ts, NULL);
+    dashstream->pending_seek_ts = GST_CLOCK_TIME_NONE;
+    dashstream->pending_seek_flags = 0;
+  } else {
+    /* the index might come from a representation with fewer subsegments */
+    sidx->entry_index = MIN (dashstream->sidx_index, sidx->entries_count - 1);
+  }
+
+  if (sidx->entry_index >= 0 && sidx->entry_index < sidx->entries_count)
+    dashstream->sidx_current_remaining = SIDX_CURRENT_ENTRY (dashstream)->size;
+  else
+    dashstream->sidx_current_remaining = 0;
+}
+
+static void
+gst_dash_demux_stream_store_index (GstDashDemux * dashdemux,
+    GstDashDemuxStream * dashstream)
+{
+  gchar *key;
+
+  key = gst_dash_demux_stream_index_cache_key ((GstAdaptiveDemuxStream *)
+      dashstream);
+  if (key == NULL)
+    return;
+
+  GST_DEBUG_OBJECT (dashdemux, "Caching index %s (%d entries)", key,
+      SIDX (dashstream)->entries_count);
+
+  GST_OBJECT_LOCK (dashdemux);
+  g_hash_table_replace (dashdemux->sidx_cache, key,
+      gst_isoff_sidx_box_copy (SIDX (dashstream)));
+  GST_OBJECT_UNLOCK (dashdemux);
+}
+
+/* Loads the index of the current representation from the cache, returns
+ * FALSE if it was never parsed before and needs to be downloaded */
+static gboolean
+gst_dash_demux_stream_restore_index (GstDashDemux * dashdemux,
+    GstDashDemuxStream * dashstream)
+{
+  GstSidxBox *sidx;
+  gchar *key;
+
+  key = gst_dash_demux_stream_index_cache_key ((GstAdaptiveDemuxStream *)
+      dashstream);
+  if (key == NULL)
+    return FALSE;
+
+  GST_OBJECT_LOCK (dashdemux);
+  sidx = g_hash_table_lookup (dashdemux->sidx_cache, key);
+  if (sidx)
+    gst_isoff_sidx_parser_set_box (&dashstream->sidx_parser, sidx);
+  GST_OBJECT_UNLOCK (dashdemux);
+
+  if (sidx) {
+    GST_DEBUG_OBJECT (dashdemux, "Reusing cached index %s", key);
+    gst_dash_demux_stream_sidx_index_ready (dashstream);
+  }
+  g_free (key);
+
+  return sidx != NULL;
+}
+
 static GstFlowReturn
 gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
 {
@@ -1023,7 +1129,13 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
   if (GST_ADAPTIVE_DEMUX_STREAM_NEED_HEADER (stream) && isombff) {
     gst_dash_demux_stream_update_headers_info (stream);
     dashstream->sidx_base_offset = stream->fragment.index_range_end + 1;
-    if (dashstream->sidx_index != 0) {
+
+    if (dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED ||
+        gst_dash_demux_stream_restore_index (dashdemux, dashstream)) {
+      /* the index is already known, only the header has to be fetched */
+      g_free (stream->fragment.index_uri);
+      stream->fragment.index_uri = NULL;
+    } else if (dashstream->sidx_index != 0) {
       /* request only the index to be downloaded as we need to reposition the
        * stream to a subsegment */
       return GST_FLOW_OK;
@@ -1032,7 +1144,7 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
 
   if (gst_mpd_client_get_next_fragment_timestamp (dashdemux->client,
           dashstream->index, &ts)) {
-    if (GST_ADAPTIVE_DEMUX_STREAM_NEED_HEADER (stream)) {
+    if (GST_ADAPTIVE_DEMUX_STREAM_NEED_HEADER (stream) && !isombff) {
       gst_adaptive_demux_stream_fragment_clear (&stream->fragment);
       gst_dash_demux_stream_update_headers_info (stream);
     }
@@ -1041,13 +1153,19 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
         &fragment);
 
     stream->fragment.uri = fragment.uri;
-    if (isombff && dashstream->sidx_index != 0) {
+    if (isombff
+        && dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED
+        && (dashstream->sidx_index != 0
+            || IS_TRICKMODE_KEY_UNITS (stream->demux))) {
       GstSidxBoxEntry *entry = SIDX_CURRENT_ENTRY (dashstream);
       stream->fragment.range_start =
           dashstream->sidx_base_offset + entry->offset;
       stream->fragment.timestamp = entry->pts;
       stream->fragment.duration = entry->duration;
-      if (stream->demux->segment.rate < 0.0) {
+      /* only fetch the current subsegment when the following ones are
+       * not going to be played in order */
+      if (stream->demux->segment.rate < 0.0
+          || IS_TRICKMODE_KEY_UNITS (stream->demux)) {
         stream->fragment.range_end =
             stream->fragment.range_start + entry->size - 1;
       } else {
@@ -1121,6 +1239,13 @@ gst_dash_demux_stream_sidx_seek (GstDashDemuxStream * dashstream,
         idx += 1;
     }
 
+    /* key unit trick modes only download subsegments starting with a
+     * stream access point, start from the one preceding the target */
+    if (flags & GST_SEEK_FLAG_TRICKMODE_KEY_UNITS) {
+      while (idx > 0 && !sidx->entries[idx].starts_with_sap)
+        idx--;
+    }
+
     dashstream->sidx_current_remaining = sidx->entries[idx].size;
   }
 
@@ -1129,7 +1254,8 @@ gst_dash_demux_stream_sidx_seek (GstDashDemuxStream * dashstream,
 
   if (final_ts) {
     if (idx == sidx->entries_count)
-      *final_ts = sidx->entries[idx].pts + sidx->entries[idx].duration;
+      *final_ts =
+          sidx->entries[idx - 1].pts + sidx->entries[idx - 1].duration;
     else
       *final_ts = sidx->entries[idx].pts;
   }
@@ -1150,6 +1276,7 @@ gst_dash_demux_stream_seek (GstAdaptiveDemuxStream * stream, gboolean forward,
       /* no index yet, seek when we have it */
       /* FIXME - the final_ts won't be correct here */
       dashstream->pending_seek_ts = ts;
+      dashstream->pending_seek_flags = flags;
     }
   }
 
@@ -1158,6 +1285,43 @@ gst_dash_demux_stream_seek (GstAdaptiveDemuxStream * stream, gboolean forward,
   return GST_FLOW_OK;
 }
 
+/* Returns the index of the next subsegment to download in key unit trick
+ * mode. Subsegments not starting with a stream access point are skipped, as
+ * is as much media as the current rate covers while the current one is shown.
+ * Returns -1 or entries_count when there is none left in that direction */
+static gint
+gst_dash_demux_stream_sidx_next_key_unit (GstAdaptiveDemuxStream * stream)
+{
+  GstDashDemuxStream *dashstream = (GstDashDemuxStream *) stream;
+  GstSidxBox *sidx = SIDX (dashstream);
+  GstSidxBoxEntry *current = SIDX_CURRENT_ENTRY (dashstream);
+  gdouble rate = MAX (ABS (stream->demux->segment.rate), 1.0);
+  GstClockTime skip;
+  gint idx;
+
+  skip = (GstClockTime) ((rate - 1.0) * current->duration);
+
+  if (stream->demux->segment.rate > 0.0) {
+    GstClockTime target = current->pts + current->duration + skip;
+
+    for (idx = sidx->entry_index + 1; idx < sidx->entries_count; idx++) {
+      GstSidxBoxEntry *entry = &sidx->entries[idx];
+      if (entry->starts_with_sap && entry->pts >= target)
+        break;
+    }
+  } else {
+    GstClockTime target = current->pts > skip ? current->pts - skip : 0;
+
+    for (idx = sidx->entry_index - 1; idx >= 0; idx--) {
+      GstSidxBoxEntry *entry = &sidx->entries[idx];
+      if (entry->starts_with_sap && entry->pts + entry->duration <= target)
+        break;
+    }
+  }
+
+  return idx;
+}
+
 static gboolean
 gst_dash_demux_stream_has_next_subfragment (GstAdaptiveDemuxStream * stream)
 {
@@ -1165,6 +1329,11 @@ gst_dash_demux_stream_has_next_subfragment (GstAdaptiveDemuxStream * stream)
   GstSidxBox *sidx = SIDX (dashstream);
 
   if (dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
+    if (IS_TRICKMODE_KEY_UNITS (stream->demux)) {
+      gint idx = gst_dash_demux_stream_sidx_next_key_unit (stream);
+      return idx >= 0 && idx < sidx->entries_count;
+    }
+
     if (stream->demux->segment.rate > 0.0) {
       if (sidx->entry_index + 1 < sidx->entries_count)
         return TRUE;
@@ -1185,7 +1354,11 @@ gst_dash_demux_stream_advance_subfragment (GstAdaptiveDemuxStream * stream)
   gboolean fragment_finished = TRUE;
 
   if (dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
-    if (stream->demux->segment.rate > 0.0) {
+    if (IS_TRICKMODE_KEY_UNITS (stream->demux)) {
+      sidx->entry_index = gst_dash_demux_stream_sidx_next_key_unit (stream);
+      if (sidx->entry_index >= 0 && sidx->entry_index < sidx->entries_count)
+        fragment_finished = FALSE;
+    } else if (stream->demux->segment.rate > 0.0) {
       sidx->entry_index++;
       if (sidx->entry_index < sidx->entries_count) {
         fragment_finished = FALSE;
@@ -1297,8 +1470,8 @@ gst_dash_demux_stream_select_bitrate (GstAdaptiveDemuxStream * stream,
      * representation if needed */
     dashstream->sidx_index = SIDX (dashstream)->entry_index;
     if (ret) {
-      /* TODO cache indexes to avoid re-downloading and parsing */
-      /* if we switched, we need a new index */
+      /* if we switched, we need a new index. It is restored from the cache
+       * when updating the fragment info if it was parsed before */
       gst_isoff_sidx_parser_clear (&dashstream->sidx_parser);
       gst_isoff_sidx_parser_init (&dashstream->sidx_parser);
     }
@@ -1383,13 +1556,11 @@ gst_dash_demux_seek (GstAdaptiveDemux * demux, GstEvent * seek)
   /* Update the current sequence on all streams */
   for (iter = (switched_period ? demux->next_streams : demux->streams); iter;
       iter = g_list_next (iter)) {
-    GstDashDemuxStream *dashstream = iter->data;
-
-    if (flags & GST_SEEK_FLAG_FLUSH) {
-      gst_isoff_sidx_parser_clear (&dashstream->sidx_parser);
-      gst_isoff_sidx_parser_init (&dashstream->sidx_parser);
-    }
-    gst_dash_demux_stream_seek (iter->data, rate >= 0, 0, target_pos, NULL);
+    /* the index of the representation stays valid across seeks, the
+     * stream is just repositioned inside of it. Only pass on the trick
+     * mode flag, snapping is handled by the base class */
+    gst_dash_demux_stream_seek (iter->data, rate >= 0,
+        flags & GST_SEEK_FLAG_TRICKMODE_KEY_UNITS, target_pos, NULL);
   }
   return TRUE;
 }
@@ -1639,6 +1810,14 @@ gst_dash_demux_data_received (GstAdaptiveDemux * demux,
     return GST_ADAPTIVE_DEMUX_CLASS (parent_class)->data_received (demux,
         stream);
 
+  if (stream->downloading_header) {
+    /* the header precedes the indexed data, push it as is so that it does
+     * not count against the current subsegment */
+    available = gst_adapter_available (stream->adapter);
+    return gst_adaptive_demux_stream_push_buffer (stream,
+        gst_adapter_take_buffer (stream->adapter, available));
+  }
+
   if (stream->downloading_index) {
     GstIsoffParserResult res;
     guint consumed;
@@ -1657,17 +1836,8 @@ gst_dash_demux_data_received (GstAdaptiveDemux * demux,
       } else {
         /* when finished, prepare for real data streaming */
         if (dash_stream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
-          if (GST_CLOCK_TIME_IS_VALID (dash_stream->pending_seek_ts)) {
-            /* FIXME, preserve seek flags */
-            gst_dash_demux_stream_sidx_seek (dash_stream,
-                demux->segment.rate >= 0, 0, dash_stream->pending_seek_ts,
-                NULL);
-            dash_stream->pending_seek_ts = GST_CLOCK_TIME_NONE;
-          } else {
-            SIDX (dash_stream)->entry_index = dash_stream->sidx_index;
-          }
-          dash_stream->sidx_current_remaining =
-              SIDX_CURRENT_ENTRY (dash_stream)->size;
+          gst_dash_demux_stream_store_index (dashdemux, dash_stream);
+          gst_dash_demux_stream_sidx_index_ready (dash_stream);
         } else if (consumed < available) {
           GstBuffer *pending;
           /* we still need to keep some data around for the next parsing round
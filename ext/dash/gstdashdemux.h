@@ -72,6 +72,7 @@ struct _GstDashDemuxStream
   gint sidx_index;
   gint64 sidx_base_offset;
   GstClockTime pending_seek_ts;
+  GstSeekFlags pending_seek_flags;
 };
 
 /**
@@ -101,6 +102,10 @@ struct _GstDashDemux
   gint n_audio_streams;
   gint n_video_streams;
   gint n_subtitle_streams;
+
+  /* parsed 'sidx' boxes of the isoff-ondemand representations, keyed
+   * by index uri and byte range, protected by the object lock */
+  GHashTable *sidx_cache;
 };
 
 struct _GstDashDemuxClass
@@ -41,6 +41,51 @@ gst_isoff_sidx_parser_clear (GstSidxParser * parser)
   parser->sidx.entries = NULL;
 }
 
+/* Puts the parser in the finished state with the entries of an index that
+ * was parsed earlier, so it does not need to be downloaded again */
+void
+gst_isoff_sidx_parser_set_box (GstSidxParser * parser, const GstSidxBox * sidx)
+{
+  g_free (parser->sidx.entries);
+
+  parser->sidx = *sidx;
+  parser->sidx.entries =
+      g_memdup (sidx->entries, sizeof (GstSidxBoxEntry) * sidx->entries_count);
+  parser->sidx.entry_index = 0;
+  parser->cumulative_entry_size = 0;
+  if (sidx->entries_count > 0) {
+    GstSidxBoxEntry *last = &sidx->entries[sidx->entries_count - 1];
+    parser->cumulative_entry_size = last->offset + last->size;
+  }
+  parser->status = GST_ISOFF_SIDX_PARSER_FINISHED;
+}
+
+GstSidxBox *
+gst_isoff_sidx_box_copy (const GstSidxBox * sidx)
+{
+  GstSidxBox *copy;
+
+  g_return_val_if_fail (sidx != NULL, NULL);
+
+  copy = g_new (GstSidxBox, 1);
+  *copy = *sidx;
+  copy->entry_index = 0;
+  copy->entries =
+      g_memdup (sidx->entries, sizeof (GstSidxBoxEntry) * sidx->entries_count);
+
+  return copy;
+}
+
+void
+gst_isoff_sidx_box_free (GstSidxBox * sidx)
+{
+  if (sidx == NULL)
+    return;
+
+  g_free (sidx->entries);
+  g_free (sidx);
+}
+
 static void
 gst_isoff_parse_sidx_entry (GstSidxBoxEntry * entry, GstByteReader * reader)
 {
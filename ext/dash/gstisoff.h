@@ -92,6 +92,10 @@ typedef struct _GstSidxParser
 void gst_isoff_sidx_parser_init (GstSidxParser * parser);
 void gst_isoff_sidx_parser_clear (GstSidxParser * parser);
 GstIsoffParserResult gst_isoff_sidx_parser_add_buffer (GstSidxParser * parser, GstBuffer * buf, guint * consumed);
+void gst_isoff_sidx_parser_set_box (GstSidxParser * parser, const GstSidxBox * sidx);
+
+GstSidxBox * gst_isoff_sidx_box_copy (const GstSidxBox * sidx);
+void gst_isoff_sidx_box_free (GstSidxBox * sidx);
 
 G_END_DECLS
 
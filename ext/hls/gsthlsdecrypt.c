@@ -0,0 +1,1149 @@
+/* GStreamer
+ *
+ * gsthlsdecrypt.c:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Decryption of HLS media segments.
+ *
+ * METHOD=AES-128 segments are CBC encrypted as a whole. Since the IV of each
+ * chunk of 16 byte blocks is just the last ciphertext block before it, the
+ * segment is cut into chunks that are decrypted independently on a thread
+ * pool while the download continues. Decrypted chunks are handed back in
+ * order.
+ *
+ * METHOD=SAMPLE-AES only encrypts parts of the H.264 slices and AAC frames
+ * of MPEG-TS (or packed ADTS audio) segments. The elementary streams have to
+ * be reassembled for that, so the whole segment is collected and processed
+ * when it is complete.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#if defined(HAVE_OPENSSL)
+#include <openssl/evp.h>
+#elif defined(HAVE_NETTLE)
+#include <nettle/aes.h>
+#include <nettle/cbc.h>
+#else
+#include <gcrypt.h>
+#endif
+
+#include "gsthls.h"
+#include "gsthlsdecrypt.h"
+
+#define GST_CAT_DEFAULT hls_debug
+
+#define AES_BLOCK 16
+
+/* Upper bound on the number of worker threads per decryptor */
+#define MAX_DECRYPT_THREADS 4
+
+#if defined(HAVE_OPENSSL)
+typedef EVP_CIPHER_CTX GstHLSAesContext;
+#elif defined(HAVE_NETTLE)
+typedef struct CBC_CTX (struct aes_ctx, AES_BLOCK_SIZE) GstHLSAesContext;
+#else
+typedef gcry_cipher_hd_t GstHLSAesContext;
+#endif
+
+typedef struct _GstHLSDecryptJob
+{
+  GstBuffer *input;
+  GstBuffer *output;
+  guint8 key[AES_BLOCK];
+  guint8 iv[AES_BLOCK];
+
+  gboolean done;
+  gboolean ok;
+} GstHLSDecryptJob;
+
+struct _GstHLSDecryptor
+{
+  GThreadPool *pool;
+  guint max_jobs;
+
+  GMutex lock;
+  GCond cond;
+  GQueue jobs;                  /* GstHLSDecryptJob, in segment order */
+  guint n_running;
+
+  GstM3U8KeyMethod method;
+  guint8 key[AES_BLOCK];
+  guint8 iv[AES_BLOCK];         /* IV of the next AES-128 chunk */
+
+  /* SAMPLE-AES: the segment data collected so far */
+  GstBuffer *sample_data;
+};
+
+/* crypto backends */
+
+#if defined(HAVE_OPENSSL)
+static gboolean
+aes_context_init (GstHLSAesContext * ctx, const guint8 * key,
+    const guint8 * iv)
+{
+  EVP_CIPHER_CTX_init (ctx);
+  if (!EVP_DecryptInit_ex (ctx, EVP_aes_128_cbc (), NULL, key, iv)) {
+    EVP_CIPHER_CTX_cleanup (ctx);
+    return FALSE;
+  }
+  EVP_CIPHER_CTX_set_padding (ctx, 0);
+  return TRUE;
+}
+
+static gboolean
+aes_context_set_iv (GstHLSAesContext * ctx, const guint8 * iv)
+{
+  return EVP_DecryptInit_ex (ctx, NULL, NULL, NULL, iv);
+}
+
+static gboolean
+aes_context_decrypt (GstHLSAesContext * ctx, const guint8 * in, guint8 * out,
+    gsize length)
+{
+  int len, flen = 0;
+
+  if (G_UNLIKELY (length > G_MAXINT || length % AES_BLOCK != 0))
+    return FALSE;
+
+  len = (int) length;
+  if (!EVP_DecryptUpdate (ctx, out, &len, in, len))
+    return FALSE;
+  EVP_DecryptFinal_ex (ctx, out + len, &flen);
+  g_return_val_if_fail (len + flen == length, FALSE);
+  return TRUE;
+}
+
+static void
+aes_context_clear (GstHLSAesContext * ctx)
+{
+  EVP_CIPHER_CTX_cleanup (ctx);
+}
+
+#elif defined(HAVE_NETTLE)
+static gboolean
+aes_context_init (GstHLSAesContext * ctx, const guint8 * key,
+    const guint8 * iv)
+{
+  aes_set_decrypt_key (&ctx->ctx, 16, key);
+  CBC_SET_IV (ctx, iv);
+
+  return TRUE;
+}
+
+static gboolean
+aes_context_set_iv (GstHLSAesContext * ctx, const guint8 * iv)
+{
+  CBC_SET_IV (ctx, iv);
+
+  return TRUE;
+}
+
+static gboolean
+aes_context_decrypt (GstHLSAesContext * ctx, const guint8 * in, guint8 * out,
+    gsize length)
+{
+  if (length % AES_BLOCK != 0)
+    return FALSE;
+
+  /* nettle handles in == out */
+  CBC_DECRYPT (ctx, aes_decrypt, length, out, in);
+
+  return TRUE;
+}
+
+static void
+aes_context_clear (GstHLSAesContext * ctx)
+{
+  /* NOP */
+}
+
+#else
+static gboolean
+aes_context_init (GstHLSAesContext * ctx, const guint8 * key,
+    const guint8 * iv)
+{
+  gcry_error_t err = 0;
+
+  *ctx = NULL;
+  err = gcry_cipher_open (ctx, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_CBC, 0);
+  if (err)
+    goto out;
+  err = gcry_cipher_setkey (*ctx, key, 16);
+  if (err)
+    goto out;
+  err = gcry_cipher_setiv (*ctx, iv, 16);
+
+out:
+  if (err && *ctx) {
+    gcry_cipher_close (*ctx);
+    *ctx = NULL;
+  }
+
+  return err == 0;
+}
+
+static gboolean
+aes_context_set_iv (GstHLSAesContext * ctx, const guint8 * iv)
+{
+  return gcry_cipher_setiv (*ctx, iv, 16) == 0;
+}
+
+static gboolean
+aes_context_decrypt (GstHLSAesContext * ctx, const guint8 * in, guint8 * out,
+    gsize length)
+{
+  gcry_error_t err = 0;
+
+  if (in == out)
+    err = gcry_cipher_decrypt (*ctx, out, length, NULL, 0);
+  else
+    err = gcry_cipher_decrypt (*ctx, out, length, in, length);
+
+  return err == 0;
+}
+
+static void
+aes_context_clear (GstHLSAesContext * ctx)
+{
+  if (*ctx) {
+    gcry_cipher_close (*ctx);
+    *ctx = NULL;
+  }
+}
+#endif
+
+/* AES-128 */
+
+/* Decrypts all of @input into the contiguous @output without merging the
+ * memories of @input first. Blocks straddling two memories go through a
+ * small bounce buffer. */
+static gboolean
+decrypt_buffer (GstHLSAesContext * ctx, GstBuffer * input, GstBuffer * output)
+{
+  GstMapInfo out_info, in_info;
+  guint8 carry[AES_BLOCK];
+  gsize carry_len = 0, out_pos = 0;
+  guint i, n;
+  gboolean ret = TRUE;
+
+  if (!gst_buffer_map (output, &out_info, GST_MAP_WRITE))
+    return FALSE;
+
+  n = gst_buffer_n_memory (input);
+  for (i = 0; i < n && ret; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (input, i);
+    const guint8 *data;
+    gsize size, len;
+
+    if (!gst_memory_map (mem, &in_info, GST_MAP_READ)) {
+      ret = FALSE;
+      break;
+    }
+    data = in_info.data;
+    size = in_info.size;
+
+    if (carry_len > 0) {
+      len = MIN (AES_BLOCK - carry_len, size);
+      memcpy (carry + carry_len, data, len);
+      carry_len += len;
+      data += len;
+      size -= len;
+
+      if (carry_len == AES_BLOCK) {
+        ret = aes_context_decrypt (ctx, carry, out_info.data + out_pos,
+            AES_BLOCK);
+        out_pos += AES_BLOCK;
+        carry_len = 0;
+      }
+    }
+
+    len = size & ~(AES_BLOCK - 1);
+    if (ret && len > 0) {
+      ret = aes_context_decrypt (ctx, data, out_info.data + out_pos, len);
+      out_pos += len;
+      data += len;
+      size -= len;
+    }
+
+    if (size > 0) {
+      memcpy (carry + carry_len, data, size);
+      carry_len += size;
+    }
+
+    gst_memory_unmap (mem, &in_info);
+  }
+
+  gst_buffer_unmap (output, &out_info);
+
+  return ret && carry_len == 0;
+}
+
+static void
+decrypt_job_free (GstHLSDecryptJob * job)
+{
+  if (job->input)
+    gst_buffer_unref (job->input);
+  if (job->output)
+    gst_buffer_unref (job->output);
+  g_slice_free (GstHLSDecryptJob, job);
+}
+
+static void
+decrypt_job_func (gpointer data, gpointer user_data)
+{
+  GstHLSDecryptJob *job = data;
+  GstHLSDecryptor *decryptor = user_data;
+  GstHLSAesContext ctx;
+  GstBuffer *output = NULL;
+  gboolean ok = FALSE;
+
+  if (aes_context_init (&ctx, job->key, job->iv)) {
+    output =
+        gst_buffer_new_allocate (NULL, gst_buffer_get_size (job->input), NULL);
+    ok = decrypt_buffer (&ctx, job->input, output);
+    aes_context_clear (&ctx);
+  }
+
+  g_mutex_lock (&decryptor->lock);
+  gst_buffer_unref (job->input);
+  job->input = NULL;
+  job->output = output;
+  job->ok = ok;
+  job->done = TRUE;
+  decryptor->n_running--;
+  g_cond_broadcast (&decryptor->cond);
+  g_mutex_unlock (&decryptor->lock);
+}
+
+/* SAMPLE-AES */
+
+#define TS_PACKET_SIZE 188
+#define TS_MAX_PID 0x2000
+
+#define STREAM_TYPE_H264 0x1b
+#define STREAM_TYPE_AAC_ADTS 0x0f
+#define STREAM_TYPE_SAMPLE_AES_H264 0xdb
+#define STREAM_TYPE_SAMPLE_AES_AAC_ADTS 0xcf
+#define STREAM_TYPE_SAMPLE_AES_AC3 0xc1
+#define STREAM_TYPE_SAMPLE_AES_EAC3 0xc2
+
+/* Clear bytes at the start of an encrypted H.264 slice NAL unit */
+#define SAMPLE_AES_H264_LEADER 32
+/* Clear bytes between two encrypted blocks of an H.264 slice */
+#define SAMPLE_AES_H264_SKIP 144
+/* Slices up to this size (without emulation prevention) are in clear */
+#define SAMPLE_AES_H264_MIN_SIZE 48
+/* Clear bytes at the start of an encrypted audio frame */
+#define SAMPLE_AES_AUDIO_LEADER 16
+
+typedef struct
+{
+  guint8 stream_type;
+  gboolean processed;
+  gboolean resized;
+  GArray *packets;              /* indexes of the TS packets carrying the PES */
+  GByteArray *data;             /* PES packet */
+  guint out_pos;
+} SampleAesPes;
+
+static guint32
+mpegts_crc32 (const guint8 * data, gsize size)
+{
+  guint32 crc = 0xffffffff;
+  gsize i;
+  gint j;
+
+  for (i = 0; i < size; i++) {
+    crc ^= ((guint32) data[i]) << 24;
+    for (j = 0; j < 8; j++)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+  }
+
+  return crc;
+}
+
+static gboolean
+sample_aes_decrypt_adts (GstHLSAesContext * ctx, const guint8 * iv,
+    guint8 * data, gsize size)
+{
+  gsize pos = 0;
+
+  while (pos + 7 <= size) {
+    guint header_size, frame_size, enc_size;
+
+    if (data[pos] != 0xff || (data[pos + 1] & 0xf6) != 0xf0) {
+      pos++;
+      continue;
+    }
+
+    header_size = (data[pos + 1] & 0x01) ? 7 : 9;
+    frame_size = ((data[pos + 3] & 0x03) << 11) | (data[pos + 4] << 3) |
+        (data[pos + 5] >> 5);
+    if (frame_size < header_size || pos + frame_size > size)
+      break;
+
+    /* The IV is reset for every frame, everything after the clear leader is
+     * encrypted except for a trailing partial block */
+    if (frame_size - header_size > SAMPLE_AES_AUDIO_LEADER) {
+      guint8 *enc = data + pos + header_size + SAMPLE_AES_AUDIO_LEADER;
+
+      enc_size = (frame_size - header_size - SAMPLE_AES_AUDIO_LEADER) &
+          ~(AES_BLOCK - 1);
+      if (enc_size > 0) {
+        if (!aes_context_set_iv (ctx, iv)
+            || !aes_context_decrypt (ctx, enc, enc, enc_size))
+          return FALSE;
+      }
+    }
+
+    pos += frame_size;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+sample_aes_decrypt_nal (GstHLSAesContext * ctx, const guint8 * iv,
+    const guint8 * nal, gsize size, GByteArray * out)
+{
+  guint8 *rbsp;
+  gsize i, n = 0, pos;
+  guint zeros = 0;
+  gboolean ret = TRUE;
+
+  /* Encryption is applied before emulation prevention, so undo it first */
+  rbsp = g_malloc (size);
+  for (i = 0; i < size; i++) {
+    if (zeros >= 2 && nal[i] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+    rbsp[n++] = nal[i];
+    zeros = nal[i] == 0x00 ? zeros + 1 : 0;
+  }
+
+  if (n <= SAMPLE_AES_H264_MIN_SIZE) {
+    g_byte_array_append (out, nal, size);
+    goto done;
+  }
+
+  if (!aes_context_set_iv (ctx, iv)) {
+    ret = FALSE;
+    goto done;
+  }
+
+  /* One encrypted block every 160 bytes, starting after the clear leader.
+   * A last block of 16 bytes or less stays in clear */
+  pos = SAMPLE_AES_H264_LEADER;
+  while (pos + AES_BLOCK < n) {
+    if (!aes_context_decrypt (ctx, rbsp + pos, rbsp + pos, AES_BLOCK)) {
+      ret = FALSE;
+      goto done;
+    }
+    pos += AES_BLOCK;
+    pos += MIN (SAMPLE_AES_H264_SKIP, n - pos);
+  }
+
+  zeros = 0;
+  for (i = 0; i < n; i++) {
+    if (zeros >= 2 && rbsp[i] <= 0x03) {
+      g_byte_array_append (out, (const guint8 *) "\003", 1);
+      zeros = 0;
+    }
+    g_byte_array_append (out, rbsp + i, 1);
+    zeros = rbsp[i] == 0x00 ? zeros + 1 : 0;
+  }
+  if (rbsp[n - 1] == 0x00)
+    g_byte_array_append (out, (const guint8 *) "\003", 1);
+
+done:
+  g_free (rbsp);
+  return ret;
+}
+
+static gsize
+scan_start_code (const guint8 * data, gsize size, gsize pos)
+{
+  for (; pos + 3 <= size; pos++) {
+    if (data[pos] == 0x00 && data[pos + 1] == 0x00 && data[pos + 2] == 0x01)
+      return pos;
+  }
+  return size;
+}
+
+static gboolean
+sample_aes_decrypt_h264 (GstHLSAesContext * ctx, const guint8 * iv,
+    const guint8 * data, gsize size, GByteArray * out)
+{
+  gsize sc, next, nal_end;
+
+  sc = scan_start_code (data, size, 0);
+  g_byte_array_append (out, data, MIN (size, sc + 3));
+
+  while (sc < size) {
+    const guint8 *nal = data + sc + 3;
+    guint8 nal_type;
+
+    next = scan_start_code (data, size, sc + 3);
+
+    /* zero bytes in front of the next start code are not part of the NAL */
+    nal_end = next;
+    while (nal_end > sc + 3 && data[nal_end - 1] == 0x00)
+      nal_end--;
+
+    if (nal_end > sc + 3) {
+      nal_type = nal[0] & 0x1f;
+      if (nal_type == 1 || nal_type == 5) {
+        if (!sample_aes_decrypt_nal (ctx, iv, nal, nal_end - sc - 3, out))
+          return FALSE;
+      } else {
+        g_byte_array_append (out, nal, nal_end - sc - 3);
+      }
+    }
+
+    g_byte_array_append (out, data + nal_end, MIN (size, next + 3) - nal_end);
+    sc = next;
+  }
+
+  return TRUE;
+}
+
+/* Length of the adaptation field @af (without its length byte) once
+ * trailing stuffing is removed */
+static guint
+ts_adaptation_field_used (const guint8 * af, guint af_len)
+{
+  guint len = 1;
+  guint8 flags;
+
+  if (af_len == 0)
+    return 0;
+
+  flags = af[0];
+  if (flags & 0x10)
+    len += 6;
+  if (flags & 0x08)
+    len += 6;
+  if (flags & 0x04)
+    len += 1;
+  if ((flags & 0x02) && len < af_len)
+    len += 1 + af[len];
+  if ((flags & 0x01) && len < af_len)
+    len += 1 + af[len];
+
+  return MIN (len, af_len);
+}
+
+/* Writes one TS packet based on the header of @orig, carrying the
+ * adaptation field @af and as much of @payload as fits. Returns the number
+ * of payload bytes written */
+static guint
+ts_write_packet (GByteArray * out, const guint8 * orig, gboolean pusi,
+    const guint8 * af, guint af_len, const guint8 * payload, guint payload_len,
+    guint8 cc)
+{
+  guint8 pkt[TS_PACKET_SIZE];
+  guint avail, used, stuffing, pos;
+
+  if (af_len == 0)
+    af = NULL;
+
+  avail = 184 - (af ? 1 + af_len : 0);
+  used = MIN (avail, payload_len);
+  stuffing = avail - used;
+
+  pkt[0] = 0x47;
+  pkt[1] = (orig[1] & 0xbf) | (pusi ? 0x40 : 0x00);
+  pkt[2] = orig[2];
+  pkt[3] = (orig[3] & 0xc0) | ((af || stuffing) ? 0x30 : 0x10) | (cc & 0x0f);
+  pos = 4;
+
+  if (af) {
+    pkt[pos++] = af_len + stuffing;
+    memcpy (pkt + pos, af, af_len);
+    pos += af_len;
+    memset (pkt + pos, 0xff, stuffing);
+    pos += stuffing;
+  } else if (stuffing > 0) {
+    pkt[pos++] = stuffing - 1;
+    if (stuffing > 1) {
+      pkt[pos++] = 0x00;
+      memset (pkt + pos, 0xff, stuffing - 2);
+      pos += stuffing - 2;
+    }
+  }
+
+  memcpy (pkt + pos, payload, used);
+  g_byte_array_append (out, pkt, TS_PACKET_SIZE);
+
+  return used;
+}
+
+static void
+ts_write_pes_packets (SampleAesPes * pes, const guint8 * orig, gboolean last,
+    gint * cc, GByteArray * out)
+{
+  const guint8 *af = NULL;
+  guint af_len = 0;
+
+  if (!pes->resized) {
+    guint offset = 4 + ((orig[3] & 0x20) ? 1 + orig[4] : 0);
+
+    /* Same size as before, only the payload changes */
+    g_byte_array_append (out, orig, offset);
+    g_byte_array_append (out, pes->data->data + pes->out_pos,
+        TS_PACKET_SIZE - offset);
+    out->data[out->len - TS_PACKET_SIZE + 3] = (orig[3] & 0xf0) | *cc;
+    pes->out_pos += TS_PACKET_SIZE - offset;
+    *cc = (*cc + 1) & 0x0f;
+    return;
+  }
+
+  if (orig[3] & 0x20) {
+    af = orig + 5;
+    af_len = ts_adaptation_field_used (af, orig[4]);
+  }
+
+  if (pes->out_pos >= pes->data->len) {
+    guint8 pkt[TS_PACKET_SIZE];
+
+    /* The PES shrunk. Keep PCRs around in adaptation field only packets,
+     * which don't increment the continuity counter */
+    if (af_len == 0 || !(af[0] & 0x10))
+      return;
+
+    pkt[0] = 0x47;
+    pkt[1] = orig[1] & 0xbf;
+    pkt[2] = orig[2];
+    pkt[3] = (orig[3] & 0xc0) | 0x20 | ((*cc - 1) & 0x0f);
+    pkt[4] = 183;
+    memcpy (pkt + 5, af, af_len);
+    memset (pkt + 5 + af_len, 0xff, 183 - af_len);
+    g_byte_array_append (out, pkt, TS_PACKET_SIZE);
+    return;
+  }
+
+  do {
+    pes->out_pos += ts_write_packet (out, orig, pes->out_pos == 0, af, af_len,
+        pes->data->data + pes->out_pos, pes->data->len - pes->out_pos, *cc);
+    *cc = (*cc + 1) & 0x0f;
+    /* adaptation fields are not duplicated into additional packets */
+    af = NULL;
+    af_len = 0;
+  } while (last && pes->out_pos < pes->data->len);
+}
+
+static gboolean
+sample_aes_process_pes (GstHLSAesContext * ctx, const guint8 * iv,
+    SampleAesPes * pes)
+{
+  GByteArray *data = pes->data, *out;
+  gsize header_size;
+  guint pes_size;
+
+  if (data->len < 9 || data->data[0] != 0x00 || data->data[1] != 0x00
+      || data->data[2] != 0x01)
+    return TRUE;
+
+  header_size = 9 + data->data[8];
+  if (header_size > data->len)
+    return TRUE;
+
+  if (pes->stream_type == STREAM_TYPE_AAC_ADTS) {
+    /* same size in and out */
+    if (!sample_aes_decrypt_adts (ctx, iv, data->data + header_size,
+            data->len - header_size))
+      return FALSE;
+    pes->processed = TRUE;
+    return TRUE;
+  }
+
+  out = g_byte_array_sized_new (data->len + 64);
+  g_byte_array_append (out, data->data, header_size);
+  if (!sample_aes_decrypt_h264 (ctx, iv, data->data + header_size,
+          data->len - header_size, out)) {
+    g_byte_array_free (out, TRUE);
+    return FALSE;
+  }
+
+  /* a PES_packet_length of 0 means unbounded and stays that way */
+  pes_size = GST_READ_UINT16_BE (data->data + 4);
+  if (pes_size != 0) {
+    pes_size = out->len - 6 > G_MAXUINT16 ? 0 : out->len - 6;
+    GST_WRITE_UINT16_BE (out->data + 4, pes_size);
+  }
+
+  pes->resized = out->len != data->len;
+  g_byte_array_free (data, TRUE);
+  pes->data = out;
+  pes->processed = TRUE;
+
+  return TRUE;
+}
+
+static void
+sample_aes_pes_free (SampleAesPes * pes)
+{
+  g_array_free (pes->packets, TRUE);
+  g_byte_array_free (pes->data, TRUE);
+  g_slice_free (SampleAesPes, pes);
+}
+
+/* Returns the offset of the section in a PSI packet, or 0 */
+static guint
+ts_section_offset (const guint8 * pkt, guint offset)
+{
+  if (!(pkt[1] & 0x40) || offset >= TS_PACKET_SIZE)
+    return 0;
+  offset += 1 + pkt[offset];
+  if (offset + 3 > TS_PACKET_SIZE)
+    return 0;
+  return offset;
+}
+
+static gboolean
+sample_aes_decrypt_ts (GstHLSAesContext * ctx, const guint8 * iv,
+    const guint8 * data, gsize size, GByteArray * out)
+{
+  guint8 *stream_types;
+  gboolean *is_pmt;
+  gint *current, *cc;
+  gint *owner;
+  GPtrArray *pes_list;
+  guint n_packets, i;
+  gboolean ret = TRUE;
+
+  n_packets = size / TS_PACKET_SIZE;
+  stream_types = g_new0 (guint8, TS_MAX_PID);
+  is_pmt = g_new0 (gboolean, TS_MAX_PID);
+  current = g_new (gint, TS_MAX_PID);
+  cc = g_new (gint, TS_MAX_PID);
+  owner = g_new (gint, n_packets);
+  pes_list = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      sample_aes_pes_free);
+
+  for (i = 0; i < TS_MAX_PID; i++) {
+    current[i] = -1;
+    cc[i] = -1;
+  }
+
+  /* Collect the PES packets of the encrypted streams */
+  for (i = 0; i < n_packets; i++) {
+    const guint8 *pkt = data + i * TS_PACKET_SIZE;
+    guint pid, offset;
+
+    owner[i] = -1;
+    if (pkt[0] != 0x47)
+      continue;
+
+    pid = GST_READ_UINT16_BE (pkt + 1) & 0x1fff;
+    offset = 4;
+    if (pkt[3] & 0x20)
+      offset += 1 + pkt[4];
+    if (!(pkt[3] & 0x10) || offset >= TS_PACKET_SIZE)
+      continue;
+
+    if (pid == 0) {
+      guint s = ts_section_offset (pkt, offset), end, p;
+
+      if (s == 0 || pkt[s] != 0x00)
+        continue;
+      end = MIN (s + 3 + (GST_READ_UINT16_BE (pkt + s + 1) & 0x0fff),
+          TS_PACKET_SIZE) - 4;
+      for (p = s + 8; p + 4 <= end; p += 4) {
+        if (GST_READ_UINT16_BE (pkt + p) != 0)
+          is_pmt[GST_READ_UINT16_BE (pkt + p + 2) & 0x1fff] = TRUE;
+      }
+    } else if (is_pmt[pid]) {
+      guint s = ts_section_offset (pkt, offset), end, p;
+      guint section_size;
+
+      if (s == 0 || pkt[s] != 0x02)
+        continue;
+      section_size = 3 + (GST_READ_UINT16_BE (pkt + s + 1) & 0x0fff);
+      if (s + section_size > TS_PACKET_SIZE || section_size < 16) {
+        GST_WARNING ("Can't handle PMT spanning several packets");
+        continue;
+      }
+      end = s + section_size - 4;
+      p = s + 12 + (GST_READ_UINT16_BE (pkt + s + 10) & 0x0fff);
+      while (p + 5 <= end) {
+        guint es_pid = GST_READ_UINT16_BE (pkt + p + 1) & 0x1fff;
+
+        /* only the SAMPLE-AES stream types carry encrypted samples */
+        switch (pkt[p]) {
+          case STREAM_TYPE_SAMPLE_AES_H264:
+            stream_types[es_pid] = STREAM_TYPE_H264;
+            break;
+          case STREAM_TYPE_SAMPLE_AES_AAC_ADTS:
+            stream_types[es_pid] = STREAM_TYPE_AAC_ADTS;
+            break;
+          case STREAM_TYPE_SAMPLE_AES_AC3:
+          case STREAM_TYPE_SAMPLE_AES_EAC3:
+            GST_WARNING ("SAMPLE-AES encrypted AC-3 is not supported");
+            break;
+          default:
+            break;
+        }
+        p += 5 + (GST_READ_UINT16_BE (pkt + p + 3) & 0x0fff);
+      }
+    } else if (stream_types[pid] != 0) {
+      SampleAesPes *pes = NULL;
+
+      if (pkt[1] & 0x40) {
+        pes = g_slice_new0 (SampleAesPes);
+        pes->stream_type = stream_types[pid];
+        pes->packets = g_array_new (FALSE, FALSE, sizeof (guint));
+        pes->data = g_byte_array_new ();
+        current[pid] = pes_list->len;
+        g_ptr_array_add (pes_list, pes);
+      } else if (current[pid] != -1) {
+        pes = g_ptr_array_index (pes_list, current[pid]);
+      }
+
+      if (pes) {
+        g_array_append_val (pes->packets, i);
+        g_byte_array_append (pes->data, pkt + offset,
+            TS_PACKET_SIZE - offset);
+        owner[i] = current[pid];
+      }
+    }
+  }
+
+  for (i = 0; i < pes_list->len && ret; i++)
+    ret = sample_aes_process_pes (ctx, iv, g_ptr_array_index (pes_list, i));
+  if (!ret)
+    goto done;
+
+  /* Write out the clear stream, each rewritten PES going into the place of
+   * the packets it came from */
+  for (i = 0; i < n_packets; i++) {
+    const guint8 *pkt = data + i * TS_PACKET_SIZE;
+    guint pid = GST_READ_UINT16_BE (pkt + 1) & 0x1fff;
+    SampleAesPes *pes;
+    guint8 *copy;
+
+    pes = owner[i] != -1 ? g_ptr_array_index (pes_list, owner[i]) : NULL;
+    if (pes && pes->processed) {
+      gboolean last = g_array_index (pes->packets, guint,
+          pes->packets->len - 1) == i;
+
+      if (cc[pid] == -1)
+        cc[pid] = pkt[3] & 0x0f;
+      ts_write_pes_packets (pes, pkt, last, &cc[pid], out);
+      continue;
+    }
+
+    g_byte_array_append (out, pkt, TS_PACKET_SIZE);
+    copy = out->data + out->len - TS_PACKET_SIZE;
+    if (pkt[0] != 0x47)
+      continue;
+
+    if (stream_types[pid] != 0 && (pkt[3] & 0x10)) {
+      /* keep continuity with the rewritten packets of the same stream */
+      if (cc[pid] != -1)
+        copy[3] = (copy[3] & 0xf0) | cc[pid];
+      cc[pid] = (copy[3] + 1) & 0x0f;
+    } else if (is_pmt[pid] && (pkt[1] & 0x40)) {
+      guint offset = 4 + ((pkt[3] & 0x20) ? 1 + pkt[4] : 0);
+      guint s = ts_section_offset (pkt, offset), end, p, section_size;
+      gboolean changed = FALSE;
+
+      if (s == 0 || copy[s] != 0x02)
+        continue;
+      section_size = 3 + (GST_READ_UINT16_BE (copy + s + 1) & 0x0fff);
+      if (s + section_size > TS_PACKET_SIZE || section_size < 16)
+        continue;
+      end = s + section_size - 4;
+      p = s + 12 + (GST_READ_UINT16_BE (copy + s + 10) & 0x0fff);
+      while (p + 5 <= end) {
+        if (copy[p] == STREAM_TYPE_SAMPLE_AES_H264) {
+          copy[p] = STREAM_TYPE_H264;
+          changed = TRUE;
+        } else if (copy[p] == STREAM_TYPE_SAMPLE_AES_AAC_ADTS) {
+          copy[p] = STREAM_TYPE_AAC_ADTS;
+          changed = TRUE;
+        }
+        p += 5 + (GST_READ_UINT16_BE (copy + p + 3) & 0x0fff);
+      }
+      if (changed)
+        GST_WRITE_UINT32_BE (copy + end, mpegts_crc32 (copy + s, end - s));
+    }
+  }
+
+  /* trailing garbage */
+  g_byte_array_append (out, data + n_packets * TS_PACKET_SIZE,
+      size - n_packets * TS_PACKET_SIZE);
+
+done:
+  g_ptr_array_free (pes_list, TRUE);
+  g_free (owner);
+  g_free (cc);
+  g_free (current);
+  g_free (is_pmt);
+  g_free (stream_types);
+
+  return ret;
+}
+
+static GstBuffer *
+sample_aes_decrypt (GstHLSDecryptor * decryptor, GstBuffer * buffer)
+{
+  GstHLSAesContext ctx;
+  GstMapInfo info;
+  GstBuffer *result = NULL;
+  gboolean ret = FALSE;
+
+  if (!aes_context_init (&ctx, decryptor->key, decryptor->iv)) {
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  if (gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+    if (info.size > 0 && info.data[0] == 0x47) {
+      GByteArray *out = g_byte_array_sized_new (info.size);
+      gsize len;
+
+      ret = sample_aes_decrypt_ts (&ctx, decryptor->iv, info.data, info.size,
+          out);
+      len = out->len;
+      if (ret)
+        result = gst_buffer_new_wrapped (g_byte_array_free (out, FALSE), len);
+      else
+        g_byte_array_free (out, TRUE);
+      gst_buffer_unmap (buffer, &info);
+    } else {
+      gsize offset = 0;
+
+      /* Packed audio: ADTS frames, usually after an ID3 tag */
+      gst_buffer_unmap (buffer, &info);
+      buffer = gst_buffer_make_writable (buffer);
+      gst_buffer_map (buffer, &info, GST_MAP_READWRITE);
+      while (offset + 10 <= info.size
+          && memcmp (info.data + offset, "ID3", 3) == 0) {
+        const guint8 *tag = info.data + offset;
+
+        offset += 10 + ((tag[6] & 0x7f) << 21) + ((tag[7] & 0x7f) << 14) +
+            ((tag[8] & 0x7f) << 7) + (tag[9] & 0x7f);
+        if (tag[5] & 0x10)
+          offset += 10;
+      }
+      if (offset <= info.size)
+        ret = sample_aes_decrypt_adts (&ctx, decryptor->iv,
+            info.data + offset, info.size - offset);
+      else
+        ret = FALSE;
+      gst_buffer_unmap (buffer, &info);
+      if (ret)
+        result = gst_buffer_ref (buffer);
+    }
+  }
+
+  aes_context_clear (&ctx);
+  gst_buffer_unref (buffer);
+
+  return result;
+}
+
+/* GstHLSDecryptor */
+
+GstHLSDecryptor *
+gst_hls_decryptor_new (void)
+{
+  GstHLSDecryptor *decryptor;
+  guint n_threads;
+
+  decryptor = g_new0 (GstHLSDecryptor, 1);
+
+  n_threads = CLAMP (g_get_num_processors (), 1, MAX_DECRYPT_THREADS);
+  decryptor->max_jobs = 2 * n_threads;
+  decryptor->pool =
+      g_thread_pool_new (decrypt_job_func, decryptor, n_threads, FALSE, NULL);
+
+  g_mutex_init (&decryptor->lock);
+  g_cond_init (&decryptor->cond);
+  g_queue_init (&decryptor->jobs);
+
+  return decryptor;
+}
+
+void
+gst_hls_decryptor_free (GstHLSDecryptor * decryptor)
+{
+  g_return_if_fail (decryptor != NULL);
+
+  gst_hls_decryptor_reset (decryptor);
+  g_thread_pool_free (decryptor->pool, FALSE, TRUE);
+  g_cond_clear (&decryptor->cond);
+  g_mutex_clear (&decryptor->lock);
+  g_free (decryptor);
+}
+
+/* Waits for all jobs to finish and drops them */
+void
+gst_hls_decryptor_reset (GstHLSDecryptor * decryptor)
+{
+  GstHLSDecryptJob *job;
+
+  g_return_if_fail (decryptor != NULL);
+
+  g_mutex_lock (&decryptor->lock);
+  while (decryptor->n_running > 0)
+    g_cond_wait (&decryptor->cond, &decryptor->lock);
+  while ((job = g_queue_pop_head (&decryptor->jobs)))
+    decrypt_job_free (job);
+  g_mutex_unlock (&decryptor->lock);
+
+  if (decryptor->sample_data)
+    gst_buffer_unref (decryptor->sample_data);
+  decryptor->sample_data = NULL;
+  decryptor->method = GST_M3U8_KEY_METHOD_NONE;
+}
+
+gboolean
+gst_hls_decryptor_start (GstHLSDecryptor * decryptor, GstM3U8KeyMethod method,
+    const guint8 * key, const guint8 * iv)
+{
+  GstHLSAesContext ctx;
+
+  g_return_val_if_fail (decryptor != NULL, FALSE);
+  g_return_val_if_fail (method != GST_M3U8_KEY_METHOD_NONE, FALSE);
+
+  gst_hls_decryptor_reset (decryptor);
+
+  /* check the key is usable before handing it to the workers */
+  if (!aes_context_init (&ctx, key, iv))
+    return FALSE;
+  aes_context_clear (&ctx);
+
+  decryptor->method = method;
+  memcpy (decryptor->key, key, AES_BLOCK);
+  memcpy (decryptor->iv, iv, AES_BLOCK);
+
+  return TRUE;
+}
+
+/* Takes ownership of @buffer. For AES-128, the size of @buffer must be a
+ * multiple of 16. Blocks when too many chunks are being decrypted already */
+void
+gst_hls_decryptor_push (GstHLSDecryptor * decryptor, GstBuffer * buffer)
+{
+  GstHLSDecryptJob *job;
+  gsize size;
+
+  g_return_if_fail (decryptor != NULL);
+  g_return_if_fail (GST_IS_BUFFER (buffer));
+
+  if (decryptor->method == GST_M3U8_KEY_METHOD_SAMPLE_AES) {
+    if (decryptor->sample_data)
+      decryptor->sample_data =
+          gst_buffer_append (decryptor->sample_data, buffer);
+    else
+      decryptor->sample_data = buffer;
+    return;
+  }
+
+  size = gst_buffer_get_size (buffer);
+  if (decryptor->method != GST_M3U8_KEY_METHOD_AES_128 || size == 0
+      || size % AES_BLOCK != 0) {
+    g_critical ("Can't decrypt buffer of size %" G_GSIZE_FORMAT, size);
+    gst_buffer_unref (buffer);
+    return;
+  }
+
+  job = g_slice_new0 (GstHLSDecryptJob);
+  job->input = buffer;
+  memcpy (job->key, decryptor->key, AES_BLOCK);
+  memcpy (job->iv, decryptor->iv, AES_BLOCK);
+
+  /* CBC: the last ciphertext block is the IV of the next chunk */
+  gst_buffer_extract (buffer, size - AES_BLOCK, decryptor->iv, AES_BLOCK);
+
+  g_mutex_lock (&decryptor->lock);
+  while (decryptor->n_running >= decryptor->max_jobs)
+    g_cond_wait (&decryptor->cond, &decryptor->lock);
+  g_queue_push_tail (&decryptor->jobs, job);
+  decryptor->n_running++;
+  g_mutex_unlock (&decryptor->lock);
+
+  g_thread_pool_push (decryptor->pool, job, NULL);
+}
+
+/* Returns the decrypted data that is ready, in order, or NULL if there is
+ * none yet. With @drain, waits for all pushed data to be decrypted */
+GstBuffer *
+gst_hls_decryptor_pop (GstHLSDecryptor * decryptor, gboolean drain,
+    GError ** err)
+{
+  GstHLSDecryptJob *job;
+  GstBuffer *result = NULL;
+  gboolean failed = FALSE;
+
+  g_return_val_if_fail (decryptor != NULL, NULL);
+
+  if (decryptor->method == GST_M3U8_KEY_METHOD_SAMPLE_AES) {
+    if (!drain || !decryptor->sample_data)
+      return NULL;
+
+    result = sample_aes_decrypt (decryptor, decryptor->sample_data);
+    decryptor->sample_data = NULL;
+    failed = result == NULL;
+    goto done;
+  }
+
+  g_mutex_lock (&decryptor->lock);
+  while ((job = g_queue_peek_head (&decryptor->jobs))) {
+    while (drain && !job->done)
+      g_cond_wait (&decryptor->cond, &decryptor->lock);
+    if (!job->done)
+      break;
+
+    g_queue_pop_head (&decryptor->jobs);
+    if (!job->ok) {
+      decrypt_job_free (job);
+      failed = TRUE;
+      break;
+    }
+
+    if (result)
+      result = gst_buffer_append (result, job->output);
+    else
+      result = job->output;
+    job->output = NULL;
+    decrypt_job_free (job);
+  }
+  g_mutex_unlock (&decryptor->lock);
+
+done:
+  if (failed) {
+    GST_ERROR ("Failed to decrypt fragment");
+    g_set_error (err, GST_STREAM_ERROR, GST_STREAM_ERROR_DECRYPT,
+        "Failed to decrypt fragment");
+    if (result)
+      gst_buffer_unref (result);
+    gst_hls_decryptor_reset (decryptor);
+    return NULL;
+  }
+
+  return result;
+}
@@ -0,0 +1,55 @@
+/* GStreamer
+ *
+ * gsthlsdecrypt.h:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_HLS_DECRYPT_H__
+#define __GST_HLS_DECRYPT_H__
+
+#include <gst/gst.h>
+#include "m3u8.h"
+
+G_BEGIN_DECLS
+
+/* Encrypted data is handed to the decryptor in chunks of at least this
+ * size so that each worker job amortizes its setup cost */
+#define GST_HLS_DECRYPTOR_CHUNK_SIZE (32 * 1024)
+
+typedef struct _GstHLSDecryptor GstHLSDecryptor;
+
+GstHLSDecryptor * gst_hls_decryptor_new   (void);
+
+void              gst_hls_decryptor_free  (GstHLSDecryptor * decryptor);
+
+gboolean          gst_hls_decryptor_start (GstHLSDecryptor * decryptor,
+                                           GstM3U8KeyMethod  method,
+                                           const guint8    * key,
+                                           const guint8    * iv);
+
+void              gst_hls_decryptor_push  (GstHLSDecryptor * decryptor,
+                                           GstBuffer       * buffer);
+
+GstBuffer *       gst_hls_decryptor_pop   (GstHLSDecryptor * decryptor,
+                                           gboolean          drain,
+                                           GError         ** err);
+
+void              gst_hls_decryptor_reset (GstHLSDecryptor * decryptor);
+
+G_END_DECLS
+
+#endif /* __GST_HLS_DECRYPT_H__ */
@@ -71,12 +71,6 @@ static gchar *gst_hls_src_buf_to_utf8_playlist (GstBuffer * buf);
 
 static gboolean gst_hls_demux_change_playlist (GstHLSDemux * demux,
     guint max_bitrate, gboolean * changed);
-static GstBuffer *gst_hls_demux_decrypt_fragment (GstHLSDemux * demux,
-    GstBuffer * encrypted_buffer, GError ** err);
-static gboolean
-gst_hls_demux_decrypt_start (GstHLSDemux * demux, const guint8 * key_data,
-    const guint8 * iv_data);
-static void gst_hls_demux_decrypt_end (GstHLSDemux * demux);
 
 static gboolean gst_hls_demux_is_live (GstAdaptiveDemux * demux);
 static GstClockTime gst_hls_demux_get_duration (GstAdaptiveDemux * demux);
@@ -115,6 +109,7 @@ gst_hls_demux_finalize (GObject * obj)
 
   gst_hls_demux_reset (GST_ADAPTIVE_DEMUX_CAST (demux));
   gst_m3u8_client_free (demux->client);
+  gst_hls_decryptor_free (demux->decryptor);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -175,6 +170,7 @@ static void
 gst_hls_demux_init (GstHLSDemux * demux)
 {
   demux->do_typefind = TRUE;
+  demux->decryptor = gst_hls_decryptor_new ();
 }
 
 static GstStateChangeReturn
@@ -254,7 +250,7 @@ gst_hls_demux_seek (GstAdaptiveDemux * demux, GstEvent * seek)
 
   /* properly cleanup pending decryption status */
   if (flags & GST_SEEK_FLAG_FLUSH) {
-    gst_hls_demux_decrypt_end (hlsdemux);
+    gst_hls_decryptor_reset (hlsdemux->decryptor);
   }
 
   /* Use I-frame variants for trick modes */
@@ -471,11 +467,16 @@ gst_hls_demux_start_fragment (GstAdaptiveDemux * demux,
 {
   GstHLSDemux *hlsdemux = GST_HLS_DEMUX_CAST (demux);
 
+  /* pushing the segment as clear data would only feed garbage downstream */
+  if (hlsdemux->current_key_method == GST_M3U8_KEY_METHOD_UNSUPPORTED)
+    goto method_unsupported;
+
   if (hlsdemux->current_key) {
     GError *err = NULL;
     GstFragment *key_fragment;
     GstBuffer *key_buffer;
     GstMapInfo key_info;
+    gboolean ret;
 
     /* new key? */
     if (hlsdemux->key_url
@@ -505,15 +506,27 @@ gst_hls_demux_start_fragment (GstAdaptiveDemux * demux,
     key_buffer = gst_fragment_get_buffer (key_fragment);
     gst_buffer_map (key_buffer, &key_info, GST_MAP_READ);
 
-    gst_hls_demux_decrypt_start (hlsdemux, key_info.data, hlsdemux->current_iv);
+    ret = key_info.size >= 16
+        && gst_hls_decryptor_start (hlsdemux->decryptor,
+        hlsdemux->current_key_method, key_info.data, hlsdemux->current_iv);
 
     gst_buffer_unmap (key_buffer, &key_info);
     gst_buffer_unref (key_buffer);
     g_object_unref (key_fragment);
+
+    if (!ret)
+      goto key_invalid;
   }
 
   return TRUE;
 
+method_unsupported:
+  {
+    GST_ELEMENT_ERROR (demux, STREAM, DECRYPT,
+        ("Unsupported encryption method"),
+        ("Can't decrypt fragment %s", stream->fragment.uri));
+    return FALSE;
+  }
 key_failed:
   {
     GST_ELEMENT_ERROR (demux, STREAM, DEMUX,
@@ -521,6 +534,13 @@ key_failed:
     GST_WARNING_OBJECT (demux, "Failed to decrypt data");
     return FALSE;
   }
+key_invalid:
+  {
+    GST_ELEMENT_ERROR (demux, STREAM, DECRYPT,
+        ("Couldn't set up decryption"), ("Invalid key %s",
+            hlsdemux->current_key));
+    return FALSE;
+  }
 }
 
 static GstFlowReturn
@@ -584,8 +604,35 @@ gst_hls_demux_finish_fragment (GstAdaptiveDemux * demux,
   GstHLSDemux *hlsdemux = GST_HLS_DEMUX_CAST (demux);
   GstFlowReturn ret = GST_FLOW_OK;
 
-  if (hlsdemux->current_key)
-    gst_hls_demux_decrypt_end (hlsdemux);
+  if (hlsdemux->current_key && stream->last_ret == GST_FLOW_OK) {
+    GError *err = NULL;
+    GstBuffer *buffer;
+    gsize available;
+
+    /* everything that is left goes to the decryptor, AES-128 can only
+     * take complete blocks */
+    available = gst_adapter_available (stream->adapter);
+    if (hlsdemux->current_key_method == GST_M3U8_KEY_METHOD_AES_128)
+      available &= ~0xF;
+    if (available > 0)
+      gst_hls_decryptor_push (hlsdemux->decryptor,
+          gst_adapter_take_buffer_fast (stream->adapter, available));
+
+    buffer = gst_hls_decryptor_pop (hlsdemux->decryptor, TRUE, &err);
+    if (err) {
+      GST_ELEMENT_ERROR (demux, STREAM, DECODE, ("Failed to decrypt buffer"),
+          ("decryption failed %s", err->message));
+      g_error_free (err);
+      ret = GST_FLOW_ERROR;
+    } else if (buffer) {
+      if (hlsdemux->pending_buffer)
+        hlsdemux->pending_buffer =
+            gst_buffer_append (hlsdemux->pending_buffer, buffer);
+      else
+        hlsdemux->pending_buffer = buffer;
+    }
+  }
+  gst_hls_decryptor_reset (hlsdemux->decryptor);
 
   /* ideally this should be empty, but this eos might have been
    * caused by an error on the source element */
@@ -593,24 +640,36 @@ gst_hls_demux_finish_fragment (GstAdaptiveDemux * demux,
       ": %" G_GSIZE_FORMAT, gst_adapter_available (stream->adapter));
   gst_adapter_clear (stream->adapter);
 
-  if (stream->last_ret == GST_FLOW_OK) {
+  if (ret == GST_FLOW_OK && stream->last_ret == GST_FLOW_OK) {
     if (hlsdemux->pending_buffer) {
-      if (hlsdemux->current_key) {
-        GstMapInfo info;
-        gssize unpadded_size;
-
-        /* Handle pkcs7 unpadding here */
-        gst_buffer_map (hlsdemux->pending_buffer, &info, GST_MAP_READ);
-        unpadded_size = info.size - info.data[info.size - 1];
-        gst_buffer_unmap (hlsdemux->pending_buffer, &info);
-
-        gst_buffer_resize (hlsdemux->pending_buffer, 0, unpadded_size);
+      if (hlsdemux->current_key_method == GST_M3U8_KEY_METHOD_AES_128) {
+        gsize size;
+        guint8 padding = 0;
+
+        /* Handle pkcs7 unpadding here. The pending buffer can be made of
+         * several decrypted chunks, so only peek at its last byte. A valid
+         * padding is always between 1 and 16 bytes, anything else means the
+         * key or IV is wrong */
+        size = gst_buffer_get_size (hlsdemux->pending_buffer);
+        if (size > 0)
+          gst_buffer_extract (hlsdemux->pending_buffer, size - 1, &padding, 1);
+        if (padding >= 1 && padding <= 16 && padding <= size) {
+          gst_buffer_resize (hlsdemux->pending_buffer, 0, size - padding);
+        } else {
+          GST_ELEMENT_ERROR (demux, STREAM, DECRYPT,
+              ("Failed to decrypt buffer"),
+              ("invalid PKCS#7 padding %u", padding));
+          gst_buffer_unref (hlsdemux->pending_buffer);
+          hlsdemux->pending_buffer = NULL;
+          ret = GST_FLOW_ERROR;
+        }
       }
 
-      ret =
-          gst_hls_demux_handle_buffer (demux, stream, hlsdemux->pending_buffer,
-          TRUE);
-      hlsdemux->pending_buffer = NULL;
+      if (hlsdemux->pending_buffer) {
+        ret = gst_hls_demux_handle_buffer (demux, stream,
+            hlsdemux->pending_buffer, TRUE);
+        hlsdemux->pending_buffer = NULL;
+      }
     }
   } else {
     if (hlsdemux->pending_buffer)
@@ -639,22 +698,31 @@ gst_hls_demux_data_received (GstAdaptiveDemux * demux,
     GError *err = NULL;
     GstBuffer *tmp_buffer;
 
-    /* must be a multiple of 16 */
-    available = available & (~0xF);
-
-    if (available == 0) {
-      return GST_FLOW_OK;
+    /* Hand data over in larger chunks so that the decryption of one chunk
+     * in the pool overlaps with the download of the next. AES-128 needs a
+     * multiple of 16 bytes, SAMPLE-AES is processed per segment anyway */
+    if (hlsdemux->current_key_method == GST_M3U8_KEY_METHOD_AES_128)
+      available = available & (~0xF);
+
+    if (available >= GST_HLS_DECRYPTOR_CHUNK_SIZE
+        || (available > 0
+            && hlsdemux->current_key_method ==
+            GST_M3U8_KEY_METHOD_SAMPLE_AES)) {
+      gst_hls_decryptor_push (hlsdemux->decryptor,
+          gst_adapter_take_buffer_fast (stream->adapter, available));
     }
 
-    buffer = gst_adapter_take_buffer (stream->adapter, available);
-    buffer = gst_hls_demux_decrypt_fragment (hlsdemux, buffer, &err);
-    if (buffer == NULL) {
+    buffer = gst_hls_decryptor_pop (hlsdemux->decryptor, FALSE, &err);
+    if (err) {
       GST_ELEMENT_ERROR (demux, STREAM, DECODE, ("Failed to decrypt buffer"),
           ("decryption failed %s", err->message));
       g_error_free (err);
       return GST_FLOW_ERROR;
     }
 
+    if (buffer == NULL)
+      return GST_FLOW_OK;
+
     tmp_buffer = hlsdemux->pending_buffer;
     hlsdemux->pending_buffer = buffer;
     buffer = tmp_buffer;
@@ -700,10 +768,11 @@ gst_hls_demux_update_fragment_info (GstAdaptiveDemuxStream * stream)
   gint64 range_start, range_end;
   gchar *key = NULL;
   guint8 *iv = NULL;
+  GstM3U8KeyMethod key_method = GST_M3U8_KEY_METHOD_NONE;
 
   if (!gst_m3u8_client_get_next_fragment (hlsdemux->client, &discont,
           &next_fragment_uri, &duration, &timestamp, &range_start, &range_end,
-          &key, &iv, stream->demux->segment.rate > 0)) {
+          &key, &iv, &key_method, stream->demux->segment.rate > 0)) {
     GST_INFO_OBJECT (hlsdemux, "This playlist doesn't contain more fragments");
     return GST_FLOW_EOS;
   }
@@ -722,6 +791,7 @@ gst_hls_demux_update_fragment_info (GstAdaptiveDemuxStream * stream)
   hlsdemux->current_key = key;
   g_free (hlsdemux->current_iv);
   hlsdemux->current_iv = iv;
+  hlsdemux->current_key_method = key_method;
   g_free (stream->fragment.uri);
   stream->fragment.uri = next_fragment_uri;
   stream->fragment.range_start = range_start;
@@ -793,8 +863,9 @@ gst_hls_demux_reset (GstAdaptiveDemux * ademux)
     g_free (demux->current_iv);
     demux->current_iv = NULL;
   }
+  demux->current_key_method = GST_M3U8_KEY_METHOD_NONE;
 
-  gst_hls_demux_decrypt_end (demux);
+  gst_hls_decryptor_reset (demux->decryptor);
 }
 
 static gchar *
@@ -1095,163 +1166,6 @@ retry_failover_protection:
   return TRUE;
 }
 
-#if defined(HAVE_OPENSSL)
-static gboolean
-gst_hls_demux_decrypt_start (GstHLSDemux * demux, const guint8 * key_data,
-    const guint8 * iv_data)
-{
-  EVP_CIPHER_CTX_init (&demux->aes_ctx);
-  if (!EVP_DecryptInit_ex (&demux->aes_ctx, EVP_aes_128_cbc (), NULL, key_data,
-          iv_data))
-    return FALSE;
-  EVP_CIPHER_CTX_set_padding (&demux->aes_ctx, 0);
-  return TRUE;
-}
-
-static gboolean
-decrypt_fragment (GstHLSDemux * demux, gsize length,
-    const guint8 * encrypted_data, guint8 * decrypted_data)
-{
-  int len, flen = 0;
-
-  if (G_UNLIKELY (length > G_MAXINT || length % 16 != 0))
-    return FALSE;
-
-  len = (int) length;
-  if (!EVP_DecryptUpdate (&demux->aes_ctx, decrypted_data, &len, encrypted_data,
-          len))
-    return FALSE;
-  EVP_DecryptFinal_ex (&demux->aes_ctx, decrypted_data + len, &flen);
-  g_return_val_if_fail (len + flen == length, FALSE);
-  return TRUE;
-}
-
-static void
-gst_hls_demux_decrypt_end (GstHLSDemux * demux)
-{
-  EVP_CIPHER_CTX_cleanup (&demux->aes_ctx);
-}
-
-#elif defined(HAVE_NETTLE)
-static gboolean
-gst_hls_demux_decrypt_start (GstHLSDemux * demux, const guint8 * key_data,
-    const guint8 * iv_data)
-{
-  aes_set_decrypt_key (&demux->aes_ctx.ctx, 16, key_data);
-  CBC_SET_IV (&demux->aes_ctx, iv_data);
-
-  return TRUE;
-}
-
-static gboolean
-decrypt_fragment (GstHLSDemux * demux, gsize length,
-    const guint8 * encrypted_data, guint8 * decrypted_data)
-{
-  if (length % 16 != 0)
-    return FALSE;
-
-  CBC_DECRYPT (&demux->aes_ctx, aes_decrypt, length, decrypted_data,
-      encrypted_data);
-
-  return TRUE;
-}
-
-static void
-gst_hls_demux_decrypt_end (GstHLSDemux * demux)
-{
-  /* NOP */
-}
-
-#else
-static gboolean
-gst_hls_demux_decrypt_start (GstHLSDemux * demux, const guint8 * key_data,
-    const guint8 * iv_data)
-{
-  gcry_error_t err = 0;
-  gboolean ret = FALSE;
-
-  err =
-      gcry_cipher_open (&demux->aes_ctx, GCRY_CIPHER_AES128,
-      GCRY_CIPHER_MODE_CBC, 0);
-  if (err)
-    goto out;
-  err = gcry_cipher_setkey (demux->aes_ctx, key_data, 16);
-  if (err)
-    goto out;
-  err = gcry_cipher_setiv (demux->aes_ctx, iv_data, 16);
-  if (!err)
-    ret = TRUE;
-
-out:
-  if (!ret)
-    if (demux->aes_ctx)
-      gcry_cipher_close (demux->aes_ctx);
-
-  return ret;
-}
-
-static gboolean
-decrypt_fragment (GstHLSDemux * demux, gsize length,
-    const guint8 * encrypted_data, guint8 * decrypted_data)
-{
-  gcry_error_t err = 0;
-
-  err = gcry_cipher_decrypt (demux->aes_ctx, decrypted_data, length,
-      encrypted_data, length);
-
-  return err == 0;
-}
-
-static void
-gst_hls_demux_decrypt_end (GstHLSDemux * demux)
-{
-  if (demux->aes_ctx) {
-    gcry_cipher_close (demux->aes_ctx);
-    demux->aes_ctx = NULL;
-  }
-}
-#endif
-
-static GstBuffer *
-gst_hls_demux_decrypt_fragment (GstHLSDemux * demux,
-    GstBuffer * encrypted_buffer, GError ** err)
-{
-  GstBuffer *decrypted_buffer = NULL;
-  GstMapInfo encrypted_info, decrypted_info;
-
-  decrypted_buffer =
-      gst_buffer_new_allocate (NULL, gst_buffer_get_size (encrypted_buffer),
-      NULL);
-
-  gst_buffer_map (encrypted_buffer, &encrypted_info, GST_MAP_READ);
-  gst_buffer_map (decrypted_buffer, &decrypted_info, GST_MAP_WRITE);
-
-  if (!decrypt_fragment (demux, encrypted_info.size,
-          encrypted_info.data, decrypted_info.data))
-    goto decrypt_error;
-
-
-  gst_buffer_unmap (decrypted_buffer, &decrypted_info);
-  gst_buffer_unmap (encrypted_buffer, &encrypted_info);
-
-  gst_buffer_unref (encrypted_buffer);
-
-  return decrypted_buffer;
-
-decrypt_error:
-  GST_ERROR_OBJECT (demux, "Failed to decrypt fragment");
-  g_set_error (err, GST_STREAM_ERROR, GST_STREAM_ERROR_DECRYPT,
-      "Failed to decrypt fragment");
-
-  gst_buffer_unmap (decrypted_buffer, &decrypted_info);
-  gst_buffer_unmap (encrypted_buffer, &encrypted_info);
-
-  gst_buffer_unref (encrypted_buffer);
-  gst_buffer_unref (decrypted_buffer);
-
-  return NULL;
-}
-
 static gint64
 gst_hls_demux_get_manifest_update_interval (GstAdaptiveDemux * demux)
 {
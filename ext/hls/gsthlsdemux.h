@@ -27,15 +27,8 @@
 #include <gst/gst.h>
 #include "m3u8.h"
 #include "gsthls.h"
+#include "gsthlsdecrypt.h"
 #include <gst/adaptivedemux/gstadaptivedemux.h>
-#if defined(HAVE_OPENSSL)
-#include <openssl/evp.h>
-#elif defined(HAVE_NETTLE)
-#include <nettle/aes.h>
-#include <nettle/cbc.h>
-#else
-#include <gcrypt.h>
-#endif
 
 G_BEGIN_DECLS
 #define GST_TYPE_HLS_DEMUX \
@@ -75,15 +68,10 @@ struct _GstHLSDemux
   GstFragment *key_fragment;
 
   /* decryption tooling */
-#if defined(HAVE_OPENSSL)
-  EVP_CIPHER_CTX aes_ctx;
-#elif defined(HAVE_NETTLE)
-  struct CBC_CTX (struct aes_ctx, AES_BLOCK_SIZE) aes_ctx;
-#else
-  gcry_cipher_hd_t aes_ctx;
-#endif
+  GstHLSDecryptor *decryptor;
   gchar *current_key;
   guint8 *current_iv;
+  GstM3U8KeyMethod current_key_method;
   GstBuffer *pending_buffer; /* decryption scenario:
                               * the last buffer can only be pushed when
                               * resized, so need to store and wait for
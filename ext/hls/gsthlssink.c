@@ -28,6 +28,13 @@
  * gst-launch-1.0 videotestsrc is-live=true ! x264enc ! mpegtsmux ! hlssink max-files=5
  * ]|
  * </refsect2>
+ *
+ * If #GstHlsSink:part-duration is set, the data of the segment being
+ * written is additionally published as partial segments (EXT-X-PART) of
+ * that duration, and the playlist is rewritten every time a part is
+ * complete, together with a preload hint for the next part. This lowers
+ * the latency of clients supporting low-latency HLS from one target
+ * duration to about three part durations.
  */
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -38,6 +45,7 @@
 #include <gst/video/video.h>
 #include <glib/gstdio.h>
 #include <memory.h>
+#include <stdio.h>
 
 
 GST_DEBUG_CATEGORY_STATIC (gst_hls_sink_debug);
@@ -49,8 +57,15 @@ GST_DEBUG_CATEGORY_STATIC (gst_hls_sink_debug);
 #define DEFAULT_MAX_FILES 10
 #define DEFAULT_TARGET_DURATION 15
 #define DEFAULT_PLAYLIST_LENGTH 5
+#define DEFAULT_PART_DURATION 0
+#define DEFAULT_PART_LOCATION "segment%05d.part%u.ts"
+#define DEFAULT_CAN_BLOCK_RELOAD FALSE
 
 #define GST_M3U8_PLAYLIST_VERSION 3
+#define GST_M3U8_PLAYLIST_LOW_LATENCY_VERSION 6
+
+/* Part files of this many completed segments are kept around */
+#define MAX_PART_SEGMENTS 4
 
 enum
 {
@@ -60,7 +75,10 @@ enum
   PROP_PLAYLIST_ROOT,
   PROP_MAX_FILES,
   PROP_TARGET_DURATION,
-  PROP_PLAYLIST_LENGTH
+  PROP_PLAYLIST_LENGTH,
+  PROP_PART_DURATION,
+  PROP_PART_LOCATION,
+  PROP_CAN_BLOCK_RELOAD
 };
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -86,6 +104,8 @@ gst_hls_sink_change_state (GstElement * element, GstStateChange trans);
 static gboolean schedule_next_key_unit (GstHlsSink * sink);
 static GstFlowReturn gst_hls_sink_chain_list (GstPad * pad, GstObject * parent,
     GstBufferList * list);
+static void gst_hls_sink_clear_parts (GstHlsSink * sink);
+static void gst_hls_sink_update_preload_hint (GstHlsSink * sink);
 
 static void
 gst_hls_sink_dispose (GObject * object)
@@ -103,8 +123,11 @@ gst_hls_sink_finalize (GObject * object)
   g_free (sink->location);
   g_free (sink->playlist_location);
   g_free (sink->playlist_root);
+  g_free (sink->part_location);
   if (sink->playlist)
     gst_m3u8_playlist_free (sink->playlist);
+  gst_hls_sink_clear_parts (sink);
+  g_ptr_array_unref (sink->part_files);
 
   G_OBJECT_CLASS (parent_class)->finalize ((GObject *) sink);
 }
@@ -168,6 +191,23 @@ gst_hls_sink_class_init (GstHlsSinkClass * klass)
           "the playlist will be infinite.",
           0, G_MAXUINT, DEFAULT_PLAYLIST_LENGTH,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PART_DURATION,
+      g_param_spec_uint ("part-duration", "Part duration",
+          "The target duration in milliseconds of the partial segments "
+          "published while a segment is being written (0 - disabled)",
+          0, G_MAXUINT, DEFAULT_PART_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PART_LOCATION,
+      g_param_spec_string ("part-location", "Part Location",
+          "Location of the partial segment files to write, formatted with "
+          "the segment index and the part index", DEFAULT_PART_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_CAN_BLOCK_RELOAD,
+      g_param_spec_boolean ("can-block-reload", "Can block reload",
+          "Advertise that the server delivering the playlist supports "
+          "blocking playlist reloads (only with part-duration)",
+          DEFAULT_CAN_BLOCK_RELOAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -189,6 +229,11 @@ gst_hls_sink_init (GstHlsSink * sink)
   sink->playlist_length = DEFAULT_PLAYLIST_LENGTH;
   sink->max_files = DEFAULT_MAX_FILES;
   sink->target_duration = DEFAULT_TARGET_DURATION;
+  sink->part_duration = DEFAULT_PART_DURATION;
+  sink->part_location = g_strdup (DEFAULT_PART_LOCATION);
+  sink->can_block_reload = DEFAULT_CAN_BLOCK_RELOAD;
+  sink->part_files = g_ptr_array_new_with_free_func (g_free);
+  g_queue_init (&sink->old_part_files);
 
   /* haven't added a sink yet, make it is detected as a sink meanwhile */
   GST_OBJECT_FLAG_SET (sink, GST_ELEMENT_FLAG_SINK);
@@ -207,11 +252,38 @@ gst_hls_sink_reset (GstHlsSink * sink)
   gst_event_replace (&sink->force_key_unit_event, NULL);
   gst_segment_init (&sink->segment, GST_FORMAT_UNDEFINED);
 
+  gst_hls_sink_clear_parts (sink);
+  sink->segment_index = 0;
+
   if (sink->playlist)
     gst_m3u8_playlist_free (sink->playlist);
   sink->playlist =
-      gst_m3u8_playlist_new (GST_M3U8_PLAYLIST_VERSION, sink->playlist_length,
-      FALSE);
+      gst_m3u8_playlist_new (sink->part_duration > 0 ?
+      GST_M3U8_PLAYLIST_LOW_LATENCY_VERSION : GST_M3U8_PLAYLIST_VERSION,
+      sink->playlist_length, FALSE);
+  sink->playlist->part_target = sink->part_duration * GST_MSECOND;
+  sink->playlist->can_block_reload = sink->can_block_reload;
+  if (sink->part_duration > 0)
+    gst_hls_sink_update_preload_hint (sink);
+}
+
+/* Forgets about the parts written so far, the files are left alone */
+static void
+gst_hls_sink_clear_parts (GstHlsSink * sink)
+{
+  GPtrArray *files;
+
+  if (sink->part_buffers)
+    gst_buffer_list_unref (sink->part_buffers);
+  sink->part_buffers = NULL;
+  sink->part_index = 0;
+  sink->part_start = GST_CLOCK_TIME_NONE;
+  sink->part_independent = FALSE;
+
+  if (sink->part_files)
+    g_ptr_array_set_size (sink->part_files, 0);
+  while ((files = g_queue_pop_head (&sink->old_part_files)))
+    g_ptr_array_unref (files);
 }
 
 static gboolean
@@ -251,6 +323,20 @@ missing_element:
   return FALSE;
 }
 
+static gchar *
+gst_hls_sink_entry_location (GstHlsSink * sink, const gchar * filename)
+{
+  gchar *name, *entry_location;
+
+  name = g_path_get_basename (filename);
+  if (sink->playlist_root == NULL)
+    return name;
+
+  entry_location = g_build_filename (sink->playlist_root, name, NULL);
+  g_free (name);
+  return entry_location;
+}
+
 static void
 gst_hls_sink_write_playlist (GstHlsSink * sink)
 {
@@ -258,6 +344,8 @@ gst_hls_sink_write_playlist (GstHlsSink * sink)
   GError *error = NULL;
 
   playlist_content = gst_m3u8_playlist_render (sink->playlist);
+  /* g_file_set_contents() writes to a temporary file that is renamed over
+   * the playlist, so clients polling it never see a truncated file */
   if (!g_file_set_contents (sink->playlist_location,
           playlist_content, -1, &error)) {
     GST_ERROR ("Failed to write playlist: %s", error->message);
@@ -270,6 +358,155 @@ gst_hls_sink_write_playlist (GstHlsSink * sink)
 
 }
 
+static void
+gst_hls_sink_update_preload_hint (GstHlsSink * sink)
+{
+  gchar *filename, *entry_location;
+
+  filename = g_strdup_printf (sink->part_location, sink->segment_index,
+      sink->part_index);
+  entry_location = gst_hls_sink_entry_location (sink, filename);
+  gst_m3u8_playlist_set_preload_hint (sink->playlist, entry_location);
+  g_free (entry_location);
+  g_free (filename);
+}
+
+/* Writes the buffers collected since the last part to a new part file and
+ * adds it to the playlist */
+static gboolean
+gst_hls_sink_write_part (GstHlsSink * sink, GstClockTime end_running_time)
+{
+  gchar *filename, *tmp_filename, *entry_location;
+  GstClockTime duration = 0;
+  FILE *file;
+  guint i, len;
+  gboolean ret = TRUE;
+
+  filename = g_strdup_printf (sink->part_location, sink->segment_index,
+      sink->part_index);
+  tmp_filename = g_strconcat (filename, ".tmp", NULL);
+
+  /* Parts are announced as soon as they are written, so write them under a
+   * temporary name first */
+  file = g_fopen (tmp_filename, "wb");
+  if (file == NULL)
+    goto write_failed;
+
+  len = gst_buffer_list_length (sink->part_buffers);
+  for (i = 0; i < len && ret; i++) {
+    GstBuffer *buffer = gst_buffer_list_get (sink->part_buffers, i);
+    GstMapInfo info;
+
+    if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+      ret = FALSE;
+      break;
+    }
+    ret = fwrite (info.data, 1, info.size, file) == info.size;
+    gst_buffer_unmap (buffer, &info);
+  }
+  if (fclose (file) != 0)
+    ret = FALSE;
+  if (!ret || g_rename (tmp_filename, filename) != 0)
+    goto write_failed;
+  g_free (tmp_filename);
+
+  if (GST_CLOCK_TIME_IS_VALID (end_running_time)
+      && GST_CLOCK_TIME_IS_VALID (sink->part_start)
+      && end_running_time > sink->part_start)
+    duration = end_running_time - sink->part_start;
+
+  GST_DEBUG_OBJECT (sink, "wrote part %u of segment %u, duration %"
+      GST_TIME_FORMAT, sink->part_index, sink->segment_index,
+      GST_TIME_ARGS (duration));
+
+  entry_location = gst_hls_sink_entry_location (sink, filename);
+  gst_m3u8_playlist_add_part (sink->playlist, entry_location, duration,
+      sink->part_independent);
+  g_free (entry_location);
+  g_ptr_array_add (sink->part_files, filename);
+
+  gst_buffer_list_unref (sink->part_buffers);
+  sink->part_buffers = NULL;
+  sink->part_index++;
+  sink->part_start = end_running_time;
+
+  return TRUE;
+
+write_failed:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+        (("Failed to write partial segment '%s'."), filename),
+        GST_ERROR_SYSTEM);
+    g_remove (tmp_filename);
+    g_free (tmp_filename);
+    g_free (filename);
+    gst_buffer_list_unref (sink->part_buffers);
+    sink->part_buffers = NULL;
+    return FALSE;
+  }
+}
+
+/* Called when multifilesink closed a segment: the remaining data becomes
+ * its last part, and parts of segments that dropped out of the playlist
+ * are deleted */
+static void
+gst_hls_sink_finish_segment_parts (GstHlsSink * sink,
+    GstClockTime running_time)
+{
+  if (sink->part_buffers)
+    gst_hls_sink_write_part (sink, running_time);
+
+  g_queue_push_tail (&sink->old_part_files, sink->part_files);
+  sink->part_files = g_ptr_array_new_with_free_func (g_free);
+  while (g_queue_get_length (&sink->old_part_files) > MAX_PART_SEGMENTS) {
+    GPtrArray *files = g_queue_pop_head (&sink->old_part_files);
+    guint i;
+
+    for (i = 0; i < files->len; i++)
+      g_remove (g_ptr_array_index (files, i));
+    g_ptr_array_unref (files);
+  }
+
+  sink->segment_index++;
+  sink->part_index = 0;
+  sink->part_start = running_time;
+  gst_hls_sink_update_preload_hint (sink);
+}
+
+static void
+gst_hls_sink_collect_part_buffer (GstHlsSink * sink, GstBuffer * buffer)
+{
+  GstClockTime timestamp, running_time = GST_CLOCK_TIME_NONE;
+
+  timestamp = GST_BUFFER_TIMESTAMP (buffer);
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)
+      && sink->segment.format == GST_FORMAT_TIME)
+    running_time = gst_segment_to_running_time (&sink->segment,
+        GST_FORMAT_TIME, timestamp);
+
+  /* Parts are cut in front of the first buffer past the part duration. This
+   * runs before the buffer reaches multifilesink */
+  if (GST_CLOCK_TIME_IS_VALID (running_time)) {
+    if (!GST_CLOCK_TIME_IS_VALID (sink->part_start)) {
+      sink->part_start = running_time;
+    } else if (sink->part_buffers
+        && running_time >= sink->part_start +
+        sink->part_duration * GST_MSECOND) {
+      if (gst_hls_sink_write_part (sink, running_time)) {
+        gst_hls_sink_update_preload_hint (sink);
+        gst_hls_sink_write_playlist (sink);
+      }
+    }
+  }
+
+  if (sink->part_buffers == NULL) {
+    sink->part_buffers = gst_buffer_list_new ();
+    sink->part_independent =
+        !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+  gst_buffer_list_add (sink->part_buffers, gst_buffer_ref (buffer));
+}
+
 static void
 gst_hls_sink_handle_message (GstBin * bin, GstMessage * message)
 {
@@ -294,13 +531,10 @@ gst_hls_sink_handle_message (GstBin * bin, GstMessage * message)
       sink->last_running_time = running_time;
 
       GST_INFO_OBJECT (sink, "COUNT %d", sink->index);
-      if (sink->playlist_root == NULL)
-        entry_location = g_path_get_basename (filename);
-      else {
-        gchar *name = g_path_get_basename (filename);
-        entry_location = g_build_filename (sink->playlist_root, name, NULL);
-        g_free (name);
-      }
+      entry_location = gst_hls_sink_entry_location (sink, filename);
+
+      if (sink->part_duration > 0)
+        gst_hls_sink_finish_segment_parts (sink, running_time);
 
       gst_m3u8_playlist_add_entry (sink->playlist, entry_location,
           NULL, duration, sink->index, discont);
@@ -406,6 +640,18 @@ gst_hls_sink_set_property (GObject * object, guint prop_id,
       sink->playlist_length = g_value_get_uint (value);
       sink->playlist->window_size = sink->playlist_length;
       break;
+    case PROP_PART_DURATION:
+      /* picked up by the playlist on the next reset */
+      sink->part_duration = g_value_get_uint (value);
+      break;
+    case PROP_PART_LOCATION:
+      g_free (sink->part_location);
+      sink->part_location = g_value_dup_string (value);
+      break;
+    case PROP_CAN_BLOCK_RELOAD:
+      sink->can_block_reload = g_value_get_boolean (value);
+      sink->playlist->can_block_reload = sink->can_block_reload;
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -437,6 +683,15 @@ gst_hls_sink_get_property (GObject * object, guint prop_id,
     case PROP_PLAYLIST_LENGTH:
       g_value_set_uint (value, sink->playlist_length);
       break;
+    case PROP_PART_DURATION:
+      g_value_set_uint (value, sink->part_duration);
+      break;
+    case PROP_PART_LOCATION:
+      g_value_set_string (value, sink->part_location);
+      break;
+    case PROP_CAN_BLOCK_RELOAD:
+      g_value_set_boolean (value, sink->can_block_reload);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -529,6 +784,15 @@ gst_hls_sink_check_schedule_next_key_unit (GstHlsSink * sink, GstBuffer * buf)
   schedule_next_key_unit (sink);
 }
 
+/* Whether the buffer probe has to see the buffers that arrive next, either
+ * to collect them into partial segments or to schedule a key unit */
+static gboolean
+gst_hls_sink_needs_buffers (GstHlsSink * sink)
+{
+  return sink->part_duration > 0 ||
+      (sink->target_duration > 0 && !sink->waiting_fku);
+}
+
 static GstPadProbeReturn
 gst_hls_sink_ghost_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
     gpointer data)
@@ -536,10 +800,15 @@ gst_hls_sink_ghost_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
   GstHlsSink *sink = GST_HLS_SINK_CAST (data);
   GstBuffer *buffer = gst_pad_probe_info_get_buffer (info);
 
-  if (sink->target_duration == 0 || sink->waiting_fku)
+  if (!gst_hls_sink_needs_buffers (sink))
     return GST_PAD_PROBE_OK;
 
-  gst_hls_sink_check_schedule_next_key_unit (sink, buffer);
+  if (sink->part_duration > 0)
+    gst_hls_sink_collect_part_buffer (sink, buffer);
+
+  if (sink->target_duration > 0 && !sink->waiting_fku)
+    gst_hls_sink_check_schedule_next_key_unit (sink, buffer);
+
   return GST_PAD_PROBE_OK;
 }
 
@@ -551,10 +820,13 @@ gst_hls_sink_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
   GstFlowReturn ret;
   GstHlsSink *sink = GST_HLS_SINK_CAST (parent);
 
-  if (sink->target_duration == 0 || sink->waiting_fku)
+  /* the buffer probe only sees buffers chained one by one, so the list is
+   * split up whenever it has work to do. It then handles each buffer
+   * exactly as if it had not arrived in a list */
+  if (!gst_hls_sink_needs_buffers (sink))
     return gst_proxy_pad_chain_list_default (pad, parent, list);
 
-  GST_DEBUG_OBJECT (pad, "chaining each group in list as a merged buffer");
+  GST_DEBUG_OBJECT (pad, "chaining each buffer in list separately");
 
   len = gst_buffer_list_length (list);
 
@@ -562,9 +834,6 @@ gst_hls_sink_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
   for (i = 0; i < len; i++) {
     buffer = gst_buffer_list_get (list, i);
 
-    if (!sink->waiting_fku)
-      gst_hls_sink_check_schedule_next_key_unit (sink, buffer);
-
     ret = gst_pad_chain (pad, gst_buffer_ref (buffer));
     if (ret != GST_FLOW_OK)
       break;
@@ -56,6 +56,18 @@ struct _GstHlsSink
   GstSegment segment;
   gboolean waiting_fku;
   GstClockTime last_running_time;
+
+  /* low-latency partial segments */
+  guint part_duration;
+  gchar *part_location;
+  gboolean can_block_reload;
+  guint segment_index;
+  guint part_index;
+  GstClockTime part_start;
+  gboolean part_independent;
+  GstBufferList *part_buffers;
+  GPtrArray *part_files;        /* parts of the segment being written */
+  GQueue old_part_files;        /* GPtrArray of parts per recent segment */
 };
 
 struct _GstHlsSinkClass
@@ -32,7 +32,11 @@ enum
   GST_M3U8_PLAYLIST_TYPE_VOD,
 };
 
+/* Parts are only listed for the most recent segments */
+#define GST_M3U8_PLAYLIST_PART_WINDOW 3
+
 typedef struct _GstM3U8Entry GstM3U8Entry;
+typedef struct _GstM3U8Part GstM3U8Part;
 
 struct _GstM3U8Entry
 {
@@ -40,8 +44,25 @@ struct _GstM3U8Entry
   gchar *title;
   gchar *url;
   gboolean discontinuous;
+
+  gchar *rendered;              /* EXTINF and URI lines, they never change */
+  GQueue parts;
 };
 
+struct _GstM3U8Part
+{
+  guint64 duration;
+  gchar *url;
+  gboolean independent;
+};
+
+static void
+gst_m3u8_part_free (GstM3U8Part * part)
+{
+  g_free (part->url);
+  g_free (part);
+}
+
 static GstM3U8Entry *
 gst_m3u8_entry_new (const gchar * url, const gchar * title,
     gfloat duration, gboolean discontinuous)
@@ -65,6 +86,9 @@ gst_m3u8_entry_free (GstM3U8Entry * entry)
 
   g_free (entry->url);
   g_free (entry->title);
+  g_free (entry->rendered);
+  g_queue_foreach (&entry->parts, (GFunc) gst_m3u8_part_free, NULL);
+  g_queue_clear (&entry->parts);
   g_free (entry);
 }
 
@@ -80,6 +104,7 @@ gst_m3u8_playlist_new (guint version, guint window_size, gboolean allow_cache)
   playlist->type = GST_M3U8_PLAYLIST_TYPE_EVENT;
   playlist->end_list = FALSE;
   playlist->entries = g_queue_new ();
+  playlist->parts = g_queue_new ();
 
   return playlist;
 }
@@ -91,9 +116,46 @@ gst_m3u8_playlist_free (GstM3U8Playlist * playlist)
 
   g_queue_foreach (playlist->entries, (GFunc) gst_m3u8_entry_free, NULL);
   g_queue_free (playlist->entries);
+  g_queue_foreach (playlist->parts, (GFunc) gst_m3u8_part_free, NULL);
+  g_queue_free (playlist->parts);
+  g_free (playlist->preload_hint);
   g_free (playlist);
 }
 
+static gchar *
+gst_m3u8_entry_render (GstM3U8Entry * entry, guint version)
+{
+  GString *str = g_string_new (NULL);
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  if (entry->discontinuous)
+    g_string_append (str, "#EXT-X-DISCONTINUITY\n");
+
+  if (version < 3) {
+    g_string_append_printf (str, "#EXTINF:%d,%s\n",
+        (gint) ((entry->duration + 500 * GST_MSECOND) / GST_SECOND),
+        entry->title ? entry->title : "");
+  } else {
+    g_string_append_printf (str, "#EXTINF:%s,%s\n",
+        g_ascii_dtostr (buf, sizeof (buf), entry->duration / GST_SECOND),
+        entry->title ? entry->title : "");
+  }
+
+  g_string_append_printf (str, "%s\n", entry->url);
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+gst_m3u8_part_render (GstM3U8Part * part, GString * str)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf (str, "#EXT-X-PART:DURATION=%s,URI=\"%s\"%s\n",
+      g_ascii_formatd (buf, sizeof (buf), "%.5f",
+          (gdouble) part->duration / GST_SECOND), part->url,
+      part->independent ? ",INDEPENDENT=YES" : "");
+}
 
 gboolean
 gst_m3u8_playlist_add_entry (GstM3U8Playlist * playlist,
@@ -109,6 +171,11 @@ gst_m3u8_playlist_add_entry (GstM3U8Playlist * playlist,
     return FALSE;
 
   entry = gst_m3u8_entry_new (url, title, duration, discontinuous);
+  entry->rendered = gst_m3u8_entry_render (entry, playlist->version);
+
+  /* the parts written so far make up this segment */
+  while (!g_queue_is_empty (playlist->parts))
+    g_queue_push_tail (&entry->parts, g_queue_pop_head (playlist->parts));
 
   if (playlist->window_size > 0) {
     /* Delete old entries from the playlist */
@@ -126,6 +193,37 @@ gst_m3u8_playlist_add_entry (GstM3U8Playlist * playlist,
   return TRUE;
 }
 
+gboolean
+gst_m3u8_playlist_add_part (GstM3U8Playlist * playlist, const gchar * url,
+    guint64 duration, gboolean independent)
+{
+  GstM3U8Part *part;
+
+  g_return_val_if_fail (playlist != NULL, FALSE);
+  g_return_val_if_fail (url != NULL, FALSE);
+
+  if (playlist->type == GST_M3U8_PLAYLIST_TYPE_VOD)
+    return FALSE;
+
+  part = g_new0 (GstM3U8Part, 1);
+  part->url = g_strdup (url);
+  part->duration = duration;
+  part->independent = independent;
+  g_queue_push_tail (playlist->parts, part);
+
+  return TRUE;
+}
+
+void
+gst_m3u8_playlist_set_preload_hint (GstM3U8Playlist * playlist,
+    const gchar * url)
+{
+  g_return_if_fail (playlist != NULL);
+
+  g_free (playlist->preload_hint);
+  playlist->preload_hint = g_strdup (url);
+}
+
 static guint
 gst_m3u8_playlist_target_duration (GstM3U8Playlist * playlist)
 {
@@ -147,6 +245,7 @@ gst_m3u8_playlist_render (GstM3U8Playlist * playlist)
 {
   GString *playlist_str;
   GList *l;
+  guint i;
 
   g_return_val_if_fail (playlist != NULL, NULL);
 
@@ -163,27 +262,47 @@ gst_m3u8_playlist_render (GstM3U8Playlist * playlist)
 
   g_string_append_printf (playlist_str, "#EXT-X-TARGETDURATION:%u\n",
       gst_m3u8_playlist_target_duration (playlist));
+
+  if (playlist->part_target > 0) {
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf (playlist_str, "#EXT-X-PART-INF:PART-TARGET=%s\n",
+        g_ascii_formatd (buf, sizeof (buf), "%.5f",
+            (gdouble) playlist->part_target / GST_SECOND));
+    /* clients should stay at least three part targets from the live edge */
+    g_string_append_printf (playlist_str,
+        "#EXT-X-SERVER-CONTROL:%sPART-HOLD-BACK=%s\n",
+        playlist->can_block_reload ? "CAN-BLOCK-RELOAD=YES," : "",
+        g_ascii_formatd (buf, sizeof (buf), "%.5f",
+            (gdouble) 3 * playlist->part_target / GST_SECOND));
+  }
   g_string_append (playlist_str, "\n");
 
   /* Entries */
-  for (l = playlist->entries->head; l != NULL; l = l->next) {
-    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  i = 0;
+  for (l = playlist->entries->head; l != NULL; l = l->next, i++) {
     GstM3U8Entry *entry = l->data;
 
-    if (entry->discontinuous)
-      g_string_append (playlist_str, "#EXT-X-DISCONTINUITY\n");
-
-    if (playlist->version < 3) {
-      g_string_append_printf (playlist_str, "#EXTINF:%d,%s\n",
-          (gint) ((entry->duration + 500 * GST_MSECOND) / GST_SECOND),
-          entry->title ? entry->title : "");
-    } else {
-      g_string_append_printf (playlist_str, "#EXTINF:%s,%s\n",
-          g_ascii_dtostr (buf, sizeof (buf), entry->duration / GST_SECOND),
-          entry->title ? entry->title : "");
+    if (playlist->part_target > 0 && i + GST_M3U8_PLAYLIST_PART_WINDOW >=
+        playlist->entries->length) {
+      GList *p;
+
+      for (p = entry->parts.head; p != NULL; p = p->next)
+        gst_m3u8_part_render (p->data, playlist_str);
     }
 
-    g_string_append_printf (playlist_str, "%s\n", entry->url);
+    g_string_append (playlist_str, entry->rendered);
+  }
+
+  /* Parts of the segment that is still being written */
+  if (playlist->part_target > 0 && !playlist->end_list) {
+    for (l = playlist->parts->head; l != NULL; l = l->next)
+      gst_m3u8_part_render (l->data, playlist_str);
+
+    if (playlist->preload_hint)
+      g_string_append_printf (playlist_str,
+          "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n",
+          playlist->preload_hint);
   }
 
   if (playlist->end_list)
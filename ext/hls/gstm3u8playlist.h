@@ -37,8 +37,14 @@ struct _GstM3U8Playlist
   gboolean end_list;
   guint sequence_number;
 
+  /* Low-latency extensions, only rendered if part_target is set */
+  guint64 part_target;          /* EXT-X-PART-INF target in nanoseconds */
+  gboolean can_block_reload;
+
   /*< Private >*/
   GQueue *entries;
+  GQueue *parts;                /* parts of the segment not completed yet */
+  gchar *preload_hint;
 };
 
 
@@ -55,6 +61,14 @@ gboolean          gst_m3u8_playlist_add_entry (GstM3U8Playlist * playlist,
                                                guint             index,
                                                gboolean          discontinuous);
 
+gboolean          gst_m3u8_playlist_add_part (GstM3U8Playlist * playlist,
+                                              const gchar     * url,
+                                              guint64           duration,
+                                              gboolean          independent);
+
+void              gst_m3u8_playlist_set_preload_hint (GstM3U8Playlist * playlist,
+                                                      const gchar     * url);
+
 gchar *           gst_m3u8_playlist_render (GstM3U8Playlist * playlist);
 
 G_END_DECLS
@@ -284,6 +284,7 @@ gst_m3u8_update (GstM3U8Client * client, GstM3U8 * self, gchar * data,
   gboolean discontinuity = FALSE;
   GstM3U8 *list;
   gchar *current_key = NULL;
+  GstM3U8KeyMethod current_method = GST_M3U8_KEY_METHOD_NONE;
   gboolean have_iv = FALSE;
   guint8 iv[16] = { 0, };
   gint64 size = -1, offset = -1;
@@ -370,6 +371,7 @@ gst_m3u8_update (GstM3U8Client * client, GstM3U8 * self, gchar * data,
 
         /* set encryption params */
         file->key = current_key ? g_strdup (current_key) : NULL;
+        file->key_method = current_method;
         if (file->key) {
           if (have_iv) {
             memcpy (file->iv, iv, sizeof (iv));
@@ -513,6 +515,7 @@ gst_m3u8_update (GstM3U8Client * client, GstM3U8 * self, gchar * data,
         have_iv = FALSE;
         g_free (current_key);
         current_key = NULL;
+        current_method = GST_M3U8_KEY_METHOD_NONE;
         while (data && parse_attributes (&data, &a, &v)) {
           if (g_str_equal (a, "URI")) {
             current_key =
@@ -548,12 +551,29 @@ gst_m3u8_update (GstM3U8Client * client, GstM3U8 * self, gchar * data,
             }
             have_iv = TRUE;
           } else if (g_str_equal (a, "METHOD")) {
-            if (!g_str_equal (v, "AES-128")) {
+            if (g_str_equal (v, "AES-128")) {
+              current_method = GST_M3U8_KEY_METHOD_AES_128;
+            } else if (g_str_equal (v, "SAMPLE-AES")) {
+              current_method = GST_M3U8_KEY_METHOD_SAMPLE_AES;
+            } else if (g_str_equal (v, "NONE")) {
+              current_method = GST_M3U8_KEY_METHOD_NONE;
+            } else {
               GST_WARNING ("Encryption method %s not supported", v);
-              continue;
+              current_method = GST_M3U8_KEY_METHOD_UNSUPPORTED;
             }
           }
         }
+
+        /* METHOD=NONE means the following segments are not encrypted,
+         * whatever URI was given. Encrypted segments without a key can't be
+         * decrypted any more than those of an unknown method */
+        if (current_method == GST_M3U8_KEY_METHOD_NONE) {
+          g_free (current_key);
+          current_key = NULL;
+        } else if (current_key == NULL) {
+          GST_WARNING ("Encrypted segments without a key URI");
+          current_method = GST_M3U8_KEY_METHOD_UNSUPPORTED;
+        }
       } else if (g_str_has_prefix (data_ext_x, "BYTERANGE:")) {
         gchar *v = data + 17;
 
@@ -879,7 +899,8 @@ gboolean
 gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
     gboolean * discontinuity, gchar ** uri, GstClockTime * duration,
     GstClockTime * timestamp, gint64 * range_start, gint64 * range_end,
-    gchar ** key, guint8 ** iv, gboolean forward)
+    gchar ** key, guint8 ** iv, GstM3U8KeyMethod * key_method,
+    gboolean forward)
 {
   GstM3U8MediaFile *file;
 
@@ -926,6 +947,8 @@ gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
     *iv = g_new (guint8, sizeof (file->iv));
     memcpy (*iv, file->iv, sizeof (file->iv));
   }
+  if (key_method)
+    *key_method = file->key_method;
 
   client->sequence = file->sequence;
 
@@ -45,6 +45,15 @@ typedef struct _GstM3U8Client GstM3U8Client;
    value is three fragments */
 #define GST_M3U8_LIVE_MIN_FRAGMENT_DISTANCE 3
 
+typedef enum
+{
+  GST_M3U8_KEY_METHOD_NONE,
+  GST_M3U8_KEY_METHOD_AES_128,
+  GST_M3U8_KEY_METHOD_SAMPLE_AES,
+  /* encrypted with a method we can't decrypt, the segments are unusable */
+  GST_M3U8_KEY_METHOD_UNSUPPORTED
+} GstM3U8KeyMethod;
+
 struct _GstM3U8
 {
   gchar *uri;                   /* actually downloaded URI */
@@ -81,6 +90,7 @@ struct _GstM3U8MediaFile
   gint64 sequence;               /* the sequence nb of this file */
   gboolean discont;             /* this file marks a discontinuity */
   gchar *key;
+  GstM3U8KeyMethod key_method;
   guint8 iv[16];
   gint64 offset, size;
 };
@@ -124,6 +134,7 @@ gboolean        gst_m3u8_client_get_next_fragment   (GstM3U8Client * client,
                                                      gint64        * range_end,
                                                      gchar        ** key,
                                                      guint8       ** iv,
+                                                     GstM3U8KeyMethod * key_method,
                                                      gboolean        forward);
 
 gboolean        gst_m3u8_client_has_next_fragment   (GstM3U8Client * client,
@@ -134,6 +134,8 @@ GST_DEBUG_CATEGORY (adaptivedemux_debug);
 #define DEFAULT_FAILED_COUNT 3
 #define DEFAULT_CONNECTION_SPEED 0
 #define DEFAULT_BITRATE_LIMIT 0.8
+#define DEFAULT_FRAGMENT_CACHE_SIZE 0
+#define DEFAULT_FRAGMENT_CACHE_DISK_SIZE (1024 * 1024 * 1024)
 #define SRC_QUEUE_MAX_BYTES 20 * 1024 * 1024    /* For safety. Large enough to hold a segment. */
 #define NUM_LOOKBACK_FRAGMENTS 3
 
@@ -154,6 +156,11 @@ enum
   PROP_0,
   PROP_CONNECTION_SPEED,
   PROP_BITRATE_LIMIT,
+  PROP_FRAGMENT_CACHE_SIZE,
+  PROP_FRAGMENT_CACHE_LOCATION,
+  PROP_FRAGMENT_CACHE_DISK_SIZE,
+  PROP_FRAGMENT_CACHE_HITS,
+  PROP_FRAGMENT_CACHE_MISSES,
   PROP_LAST
 };
 
@@ -199,6 +206,13 @@ struct _GstAdaptiveDemuxPrivate
    * without needing to stop tasks when they just want to
    * update the segment boundaries */
   GMutex segment_lock;
+
+  /* Fragment cache shared by the downloader and the streams. Only set or
+   * changed from property setters, protected by manifest_lock */
+  GstFragmentCache *fragment_cache;
+  guint64 fragment_cache_size;
+  gchar *fragment_cache_location;
+  guint64 fragment_cache_disk_size;
 };
 
 static GstBinClass *parent_class = NULL;
@@ -301,6 +315,38 @@ gst_adaptive_demux_get_type (void)
   return type;
 }
 
+/* must be called with manifest_lock taken */
+static void
+gst_adaptive_demux_update_fragment_cache (GstAdaptiveDemux * demux)
+{
+  GstAdaptiveDemuxPrivate *priv = demux->priv;
+
+  if (priv->fragment_cache_size == 0 && priv->fragment_cache_location == NULL) {
+    if (priv->fragment_cache) {
+      GST_DEBUG_OBJECT (demux, "Disabling fragment cache");
+      gst_uri_downloader_set_cache (demux->downloader, NULL);
+      gst_object_unref (priv->fragment_cache);
+      priv->fragment_cache = NULL;
+    }
+    return;
+  }
+
+  if (priv->fragment_cache == NULL) {
+    priv->fragment_cache = gst_fragment_cache_new (priv->fragment_cache_size);
+    gst_uri_downloader_set_cache (demux->downloader, priv->fragment_cache);
+  } else {
+    g_object_set (priv->fragment_cache, "max-size", priv->fragment_cache_size,
+        NULL);
+  }
+
+  gst_fragment_cache_set_location (priv->fragment_cache,
+      priv->fragment_cache_location, priv->fragment_cache_disk_size);
+
+  GST_DEBUG_OBJECT (demux, "Fragment cache of %" G_GUINT64_FORMAT " bytes, "
+      "on disk: %s", priv->fragment_cache_size,
+      GST_STR_NULL (priv->fragment_cache_location));
+}
+
 static void
 gst_adaptive_demux_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -319,6 +365,19 @@ gst_adaptive_demux_set_property (GObject * object, guint prop_id,
     case PROP_BITRATE_LIMIT:
       demux->bitrate_limit = g_value_get_float (value);
       break;
+    case PROP_FRAGMENT_CACHE_SIZE:
+      demux->priv->fragment_cache_size = g_value_get_uint64 (value);
+      gst_adaptive_demux_update_fragment_cache (demux);
+      break;
+    case PROP_FRAGMENT_CACHE_LOCATION:
+      g_free (demux->priv->fragment_cache_location);
+      demux->priv->fragment_cache_location = g_value_dup_string (value);
+      gst_adaptive_demux_update_fragment_cache (demux);
+      break;
+    case PROP_FRAGMENT_CACHE_DISK_SIZE:
+      demux->priv->fragment_cache_disk_size = g_value_get_uint64 (value);
+      gst_adaptive_demux_update_fragment_cache (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -343,6 +402,26 @@ gst_adaptive_demux_get_property (GObject * object, guint prop_id,
     case PROP_BITRATE_LIMIT:
       g_value_set_float (value, demux->bitrate_limit);
       break;
+    case PROP_FRAGMENT_CACHE_SIZE:
+      g_value_set_uint64 (value, demux->priv->fragment_cache_size);
+      break;
+    case PROP_FRAGMENT_CACHE_LOCATION:
+      g_value_set_string (value, demux->priv->fragment_cache_location);
+      break;
+    case PROP_FRAGMENT_CACHE_DISK_SIZE:
+      g_value_set_uint64 (value, demux->priv->fragment_cache_disk_size);
+      break;
+    case PROP_FRAGMENT_CACHE_HITS:
+    case PROP_FRAGMENT_CACHE_MISSES:{
+      guint64 hits = 0, misses = 0;
+
+      if (demux->priv->fragment_cache)
+        gst_fragment_cache_get_stats (demux->priv->fragment_cache, &hits,
+            &misses);
+      g_value_set_uint64 (value,
+          prop_id == PROP_FRAGMENT_CACHE_HITS ? hits : misses);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -386,6 +465,40 @@ gst_adaptive_demux_class_init (GstAdaptiveDemuxClass * klass)
           0, 1, DEFAULT_BITRATE_LIMIT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_FRAGMENT_CACHE_SIZE,
+      g_param_spec_uint64 ("fragment-cache-size", "Fragment cache size",
+          "Maximum number of bytes of downloaded fragments, playlists and keys "
+          "to keep in memory for replays and seeks (0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_FRAGMENT_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_FRAGMENT_CACHE_LOCATION,
+      g_param_spec_string ("fragment-cache-location",
+          "Fragment cache location",
+          "Directory in which cached media fragments are also stored on disk "
+          "and kept across runs, playlists and keys are never stored there "
+          "(NULL = memory only)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_FRAGMENT_CACHE_DISK_SIZE,
+      g_param_spec_uint64 ("fragment-cache-disk-size",
+          "Fragment cache disk size",
+          "Maximum number of bytes kept in the fragment cache location",
+          0, G_MAXUINT64, DEFAULT_FRAGMENT_CACHE_DISK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FRAGMENT_CACHE_HITS,
+      g_param_spec_uint64 ("fragment-cache-hits", "Fragment cache hits",
+          "Number of downloads served from the fragment cache",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FRAGMENT_CACHE_MISSES,
+      g_param_spec_uint64 ("fragment-cache-misses", "Fragment cache misses",
+          "Number of downloads not found in the fragment cache",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state = gst_adaptive_demux_change_state;
 
   gstbin_class->handle_message = gst_adaptive_demux_handle_message;
@@ -442,6 +555,8 @@ gst_adaptive_demux_init (GstAdaptiveDemux * demux,
   /* Properties */
   demux->bitrate_limit = DEFAULT_BITRATE_LIMIT;
   demux->connection_speed = DEFAULT_CONNECTION_SPEED;
+  demux->priv->fragment_cache_size = DEFAULT_FRAGMENT_CACHE_SIZE;
+  demux->priv->fragment_cache_disk_size = DEFAULT_FRAGMENT_CACHE_DISK_SIZE;
 
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 }
@@ -456,6 +571,9 @@ gst_adaptive_demux_finalize (GObject * object)
 
   g_object_unref (priv->input_adapter);
   g_object_unref (demux->downloader);
+  if (priv->fragment_cache)
+    gst_object_unref (priv->fragment_cache);
+  g_free (priv->fragment_cache_location);
 
   g_mutex_clear (&priv->updates_timed_lock);
   g_cond_clear (&priv->updates_timed_cond);
@@ -1177,6 +1295,10 @@ gst_adaptive_demux_stream_free (GstAdaptiveDemuxStream * stream)
   if (stream->pending_caps)
     gst_caps_unref (stream->pending_caps);
 
+  gst_buffer_replace (&stream->cache_buffer, NULL);
+  if (stream->cache_headers)
+    gst_structure_free (stream->cache_headers);
+
   g_object_unref (stream->adapter);
 
   g_free (stream);
@@ -1979,15 +2101,14 @@ gst_adaptive_demux_stream_data_received_default (GstAdaptiveDemux * demux,
 }
 
 static GstFlowReturn
-_src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+gst_adaptive_demux_stream_chain (GstAdaptiveDemuxStream * stream,
+    GstBuffer * buffer)
 {
-  GstAdaptiveDemuxStream *stream;
   GstAdaptiveDemux *demux;
   GstAdaptiveDemuxClass *klass;
   GstFlowReturn ret = GST_FLOW_OK;
 
-  demux = GST_ADAPTIVE_DEMUX_CAST (parent);
-  stream = gst_pad_get_element_private (pad);
+  demux = stream->demux;
   klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
 
   GST_MANIFEST_LOCK (demux);
@@ -2044,15 +2165,20 @@ _src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     gint64 chunk_size = 0;
 
     stream->downloading_first_buffer = FALSE;
+    stream->download_first_buffer_time = g_get_monotonic_time ();
 
     if (!stream->downloading_header && !stream->downloading_index) {
       /* If this is the first buffer of a fragment (not the headers or index)
        * and we don't have a birate from the sub-class, then see if we
        * can work it out from the fragment size and duration */
+      if (stream->downloading_from_cache)
+        chunk_size = gst_buffer_get_size (buffer);
+      else if (!gst_element_query_duration (stream->uri_handler,
+              GST_FORMAT_BYTES, &chunk_size))
+        chunk_size = 0;
+
       if (stream->fragment.bitrate == 0 &&
-          stream->fragment.duration != 0 &&
-          gst_element_query_duration (stream->uri_handler, GST_FORMAT_BYTES,
-              &chunk_size)) {
+          stream->fragment.duration != 0 && chunk_size > 0) {
         guint bitrate = MIN (G_MAXUINT, gst_util_uint64_scale (chunk_size,
                 8 * GST_SECOND, stream->fragment.duration));
         GST_LOG_OBJECT (demux,
@@ -2073,6 +2199,15 @@ _src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       g_get_monotonic_time () - stream->download_chunk_start_time;
   stream->download_total_bytes += gst_buffer_get_size (buffer);
 
+  if (demux->priv->fragment_cache && !stream->downloading_from_cache) {
+    GstBuffer *copy = gst_buffer_copy (buffer);
+
+    if (stream->cache_buffer)
+      stream->cache_buffer = gst_buffer_append (stream->cache_buffer, copy);
+    else
+      stream->cache_buffer = copy;
+  }
+
   gst_adapter_push (stream->adapter, buffer);
   GST_DEBUG_OBJECT (stream->pad, "Received buffer of size %" G_GSIZE_FORMAT
       ". Now %" G_GSIZE_FORMAT " on adapter", gst_buffer_get_size (buffer),
@@ -2117,6 +2252,14 @@ error:
   return ret;
 }
 
+static GstFlowReturn
+_src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstAdaptiveDemuxStream *stream = gst_pad_get_element_private (pad);
+
+  return gst_adaptive_demux_stream_chain (stream, buffer);
+}
+
 /* must be called with manifest_lock taken */
 static void
 gst_adaptive_demux_stream_fragment_download_finish (GstAdaptiveDemuxStream *
@@ -2160,6 +2303,21 @@ _src_event (GstPad * pad, GstObject * parent, GstEvent * event)
       GST_MANIFEST_UNLOCK (demux);
       break;
     }
+    case GST_EVENT_CUSTOM_DOWNSTREAM_STICKY:{
+      const GstStructure *s = gst_event_get_structure (event);
+
+      /* keep the response headers for the fragment cache */
+      if (gst_structure_has_name (s, "http-headers")) {
+        GST_MANIFEST_LOCK (demux);
+        if (demux->priv->fragment_cache) {
+          if (stream->cache_headers)
+            gst_structure_free (stream->cache_headers);
+          stream->cache_headers = gst_structure_copy (s);
+        }
+        GST_MANIFEST_UNLOCK (demux);
+      }
+      break;
+    }
     default:
       break;
   }
@@ -2279,14 +2437,23 @@ gst_adaptive_demux_stream_update_source (GstAdaptiveDemuxStream * stream,
       GST_DEBUG_OBJECT (demux, "Re-using old source element");
       if (!gst_uri_handler_set_uri (GST_URI_HANDLER (stream->uri_handler), uri,
               &err)) {
-        GST_DEBUG_OBJECT (demux, "Failed to re-use old source element: %s",
+        /* the previous download might have left the source running, and
+         * some sources only accept a new uri when stopped */
+        GST_DEBUG_OBJECT (demux, "Stopping old source element to set uri: %s",
             err->message);
         g_clear_error (&err);
-        gst_object_unref (stream->src_srcpad);
-        gst_element_set_state (stream->src, GST_STATE_NULL);
-        gst_bin_remove (GST_BIN_CAST (demux), stream->src);
-        stream->src = NULL;
-        stream->src_srcpad = NULL;
+        gst_element_set_state (stream->src, GST_STATE_READY);
+        if (!gst_uri_handler_set_uri (GST_URI_HANDLER (stream->uri_handler),
+                uri, &err)) {
+          GST_DEBUG_OBJECT (demux, "Failed to re-use old source element: %s",
+              err->message);
+          g_clear_error (&err);
+          gst_object_unref (stream->src_srcpad);
+          gst_element_set_state (stream->src, GST_STATE_NULL);
+          gst_bin_remove (GST_BIN_CAST (demux), stream->src);
+          stream->src = NULL;
+          stream->src_srcpad = NULL;
+        }
       }
     }
     g_free (old_uri);
@@ -2423,6 +2590,55 @@ gst_adaptive_demux_stream_update_source (GstAdaptiveDemuxStream * stream,
   return TRUE;
 }
 
+/* must be called with manifest_lock taken.
+ * Feeds the data cached for @uri into the stream as if it had been
+ * downloaded. Returns FALSE if nothing is cached for @uri.
+ */
+static gboolean
+gst_adaptive_demux_stream_download_cached_uri (GstAdaptiveDemux * demux,
+    GstAdaptiveDemuxStream * stream, const gchar * uri, gint64 start,
+    gint64 end, GstFlowReturn * ret)
+{
+  GstAdaptiveDemuxClass *klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
+  GstBuffer *buffer;
+
+  buffer = gst_fragment_cache_lookup (demux->priv->fragment_cache, uri, start,
+      end, NULL, NULL);
+  if (buffer == NULL)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (stream->pad, "Using cached data for uri: %s", uri);
+
+  stream->download_start_time = g_get_monotonic_time ();
+  stream->download_chunk_start_time = g_get_monotonic_time ();
+
+  g_mutex_lock (&stream->fragment_download_lock);
+  stream->download_finished = FALSE;
+  stream->downloading_first_buffer = TRUE;
+  g_mutex_unlock (&stream->fragment_download_lock);
+
+  /* the cached buffer is shared, give the chain a buffer of its own */
+  stream->downloading_from_cache = TRUE;
+  *ret = gst_adaptive_demux_stream_chain (stream, gst_buffer_copy (buffer));
+  stream->downloading_from_cache = FALSE;
+  gst_buffer_unref (buffer);
+
+  /* on errors the chain function has already finished the download */
+  if (*ret == GST_FLOW_OK) {
+    *ret = klass->finish_fragment (demux, stream);
+    gst_adaptive_demux_stream_fragment_download_finish (stream, *ret, NULL);
+  }
+
+  g_mutex_lock (&stream->fragment_download_lock);
+  if (G_UNLIKELY (stream->cancelled))
+    stream->last_ret = GST_FLOW_FLUSHING;
+  g_mutex_unlock (&stream->fragment_download_lock);
+
+  *ret = stream->last_ret;
+
+  return TRUE;
+}
+
 /* must be called with manifest_lock taken.
  * Can temporarily release manifest_lock
  */
@@ -2432,26 +2648,53 @@ gst_adaptive_demux_stream_download_uri (GstAdaptiveDemux * demux,
     gint64 end)
 {
   GstFlowReturn ret = GST_FLOW_OK;
+  GstState state;
+  gboolean running;
+  /* HTTP ranges are inclusive, GStreamer segments are exclusive for the
+   * stop position */
+  gint64 stop = (end != -1) ? end + 1 : -1;
+
   GST_DEBUG_OBJECT (stream->pad, "Downloading uri: %s, range:%" G_GINT64_FORMAT
       " - %" G_GINT64_FORMAT, uri, start, end);
 
+  if (demux->priv->fragment_cache) {
+    if (gst_adaptive_demux_stream_download_cached_uri (demux, stream, uri,
+            start, end, &ret))
+      return ret;
+
+    gst_buffer_replace (&stream->cache_buffer, NULL);
+    if (stream->cache_headers) {
+      gst_structure_free (stream->cache_headers);
+      stream->cache_headers = NULL;
+    }
+  }
+
   if (!gst_adaptive_demux_stream_update_source (stream, uri, NULL, FALSE, TRUE)) {
     ret = stream->last_ret = GST_FLOW_ERROR;
     return ret;
   }
 
-  if (gst_element_set_state (stream->src,
+  /* After a successful download the source is left running, so that HTTP
+   * sources keep their connection open. It then only needs a flushing seek
+   * to request the next fragment */
+  gst_element_get_state (stream->src, &state, NULL, 0);
+  running = state >= GST_STATE_PAUSED;
+
+  if (!running && GST_PAD_IS_EOS (stream->internal_pad)) {
+    /* the source that was left running has been stopped or replaced since,
+     * make our ghostpad fresh for a new stream */
+    gst_pad_set_active (stream->internal_pad, FALSE);
+    gst_pad_set_active (stream->internal_pad, TRUE);
+  }
+
+  if (running || gst_element_set_state (stream->src,
           GST_STATE_READY) != GST_STATE_CHANGE_FAILURE) {
-    if (start != 0 || end != -1) {
-      /* HTTP ranges are inclusive, GStreamer segments are exclusive for the
-       * stop position */
-      if (end != -1)
-        end += 1;
+    if (!running && (start != 0 || end != -1)) {
       /* Send the seek event to the uri_handler, as the other pipeline elements
        * can't handle it when READY. */
       if (!gst_element_send_event (stream->uri_handler, gst_event_new_seek (1.0,
                   GST_FORMAT_BYTES, (GstSeekFlags) GST_SEEK_FLAG_FLUSH,
-                  GST_SEEK_TYPE_SET, start, GST_SEEK_TYPE_SET, end))) {
+                  GST_SEEK_TYPE_SET, start, GST_SEEK_TYPE_SET, stop))) {
 
         /* looks like the source can't handle seeks in READY */
         g_clear_error (&stream->last_error);
@@ -2466,8 +2709,8 @@ gst_adaptive_demux_stream_download_uri (GstAdaptiveDemux * demux,
       stream->download_start_time = g_get_monotonic_time ();
       stream->download_chunk_start_time = g_get_monotonic_time ();
 
-      /* src element is in state READY. Before we start it, we reset
-       * download_finished
+      /* src element is in state READY or waiting for the seek. Before we
+       * start it, we reset download_finished
        */
       g_mutex_lock (&stream->fragment_download_lock);
       stream->download_finished = FALSE;
@@ -2476,7 +2719,19 @@ gst_adaptive_demux_stream_download_uri (GstAdaptiveDemux * demux,
 
       GST_MANIFEST_UNLOCK (demux);
 
-      if (!gst_element_sync_state_with_parent (stream->src)) {
+      if (running) {
+        /* the chain function takes the manifest lock as soon as the source
+         * pushes the first buffer after the seek */
+        if (!gst_element_send_event (stream->uri_handler,
+                gst_event_new_seek (1.0, GST_FORMAT_BYTES,
+                    (GstSeekFlags) GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
+                    start, GST_SEEK_TYPE_SET, stop))) {
+          GST_WARNING_OBJECT (demux, "Could not seek running src element");
+          GST_MANIFEST_LOCK (demux);
+          ret = stream->last_ret = GST_FLOW_ERROR;
+          goto stop_source;
+        }
+      } else if (!gst_element_sync_state_with_parent (stream->src)) {
         GST_WARNING_OBJECT (demux, "Could not sync state for src element");
         GST_MANIFEST_LOCK (demux);
         ret = stream->last_ret = GST_FLOW_ERROR;
@@ -2513,6 +2768,14 @@ gst_adaptive_demux_stream_download_uri (GstAdaptiveDemux * demux,
 
       GST_DEBUG_OBJECT (stream->pad, "Fragment download finished: %s %d %s",
           uri, stream->last_ret, gst_flow_get_name (stream->last_ret));
+
+      if (ret == GST_FLOW_OK && demux->priv->fragment_cache &&
+          stream->cache_buffer) {
+        gst_fragment_cache_insert (demux->priv->fragment_cache, uri, start,
+            end, stream->cache_buffer, stream->cache_headers, NULL, FALSE,
+            GST_FRAGMENT_CACHE_FLAG_PERSIST);
+      }
+      gst_buffer_replace (&stream->cache_buffer, NULL);
     }
   } else {
     if (stream->last_ret == GST_FLOW_OK)
@@ -2520,6 +2783,11 @@ gst_adaptive_demux_stream_download_uri (GstAdaptiveDemux * demux,
     ret = GST_FLOW_CUSTOM_ERROR;
   }
 
+  /* keep the source running for the next fragment */
+  if (ret == GST_FLOW_OK && stream->last_ret == GST_FLOW_OK)
+    return ret;
+
+stop_source:
   /* changing src element state might try to join the streaming thread, so
    * we must not hold the manifest lock.
    */
@@ -3190,6 +3458,7 @@ gst_adaptive_demux_stream_advance_fragment_unlocked (GstAdaptiveDemux * demux,
     GstAdaptiveDemuxStream * stream, GstClockTime duration)
 {
   GstAdaptiveDemuxClass *klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
+  GstClockTime first_byte_time = 0;
   GstFlowReturn ret;
 
   g_return_val_if_fail (klass->stream_advance_fragment != NULL, GST_FLOW_ERROR);
@@ -3197,6 +3466,13 @@ gst_adaptive_demux_stream_advance_fragment_unlocked (GstAdaptiveDemux * demux,
   stream->download_error_count = 0;
   g_clear_error (&stream->last_error);
 
+  /* time from starting the request until the first data arrived. This
+   * includes the server latency, and the connection setup only when the
+   * source had no open connection to reuse */
+  if (stream->download_first_buffer_time > stream->download_start_time)
+    first_byte_time = (stream->download_first_buffer_time -
+        stream->download_start_time) * GST_USECOND;
+
   /* FIXME - url has no indication of byte ranges for subsegments */
   gst_element_post_message (GST_ELEMENT_CAST (demux),
       gst_message_new_element (GST_OBJECT_CAST (demux),
@@ -3209,7 +3485,9 @@ gst_adaptive_demux_stream_advance_fragment_unlocked (GstAdaptiveDemux * demux,
               gst_util_get_timestamp (), "fragment-size", G_TYPE_UINT64,
               stream->download_total_bytes, "fragment-download-time",
               GST_TYPE_CLOCK_TIME,
-              stream->download_total_time * GST_USECOND, NULL)));
+              stream->download_total_time * GST_USECOND,
+              "fragment-first-byte-time", GST_TYPE_CLOCK_TIME,
+              first_byte_time, NULL)));
 
   /* Don't update to the end of the segment if in reverse playback */
   GST_ADAPTIVE_DEMUX_SEGMENT_LOCK (demux);
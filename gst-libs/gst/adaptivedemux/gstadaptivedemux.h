@@ -156,8 +156,14 @@ struct _GstAdaptiveDemuxStream
   gboolean first_fragment_buffer;
   gint64 download_start_time;
   gint64 download_chunk_start_time;
+  gint64 download_first_buffer_time;
   gint64 download_total_time;
   gint64 download_total_bytes;
+
+  /* fragment cache */
+  gboolean downloading_from_cache;
+  GstBuffer *cache_buffer;      /* data of the current download */
+  GstStructure *cache_headers;  /* http-headers of the current download */
   guint64 current_download_rate;
 
   /* Average for the last fragments */
@@ -38,6 +38,7 @@
 
 #include "gstmpeg4parser.h"
 #include "parserutils.h"
+#include "scanutils.h"
 
 #ifndef GST_DISABLE_GST_DEBUG
 
@@ -429,12 +430,9 @@ gst_mpeg4_parse (GstMpeg4Packet * packet, gboolean skip_user_data,
     gsize size)
 {
   gint off1, off2;
-  GstByteReader br;
   GstMpeg4ParseResult resync_res;
   static guint first_resync_marker = TRUE;
 
-  gst_byte_reader_init (&br, data, size);
-
   g_return_val_if_fail (packet != NULL, GST_MPEG4_PARSER_ERROR);
 
   if (size - offset <= 4) {
@@ -462,8 +460,9 @@ gst_mpeg4_parse (GstMpeg4Packet * packet, gboolean skip_user_data,
     first_resync_marker = TRUE;
   }
 
-  off1 = gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
-      offset, size - offset);
+  off1 = scan_for_start_code_prefix (data + offset, size - offset);
+  if (off1 != -1)
+    off1 += offset;
 
   if (off1 == -1) {
     GST_DEBUG ("No start code prefix in this buffer");
@@ -482,11 +481,13 @@ gst_mpeg4_parse (GstMpeg4Packet * packet, gboolean skip_user_data,
 
 find_end:
   if (off1 < size - 4)
-    off2 = gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
-        off1 + 4, size - off1 - 4);
+    off2 = scan_for_start_code_prefix (data + off1 + 4, size - off1 - 4);
   else
     off2 = -1;
 
+  if (off2 != -1)
+    off2 += off1 + 4;
+
   if (off2 == -1) {
     GST_DEBUG ("Packet start %d, No end found", off1 + 4);
 
@@ -71,6 +71,26 @@ ensure_prob_tables (void)
   }
 }
 
+/* below this many frames per thread a batch is not worth splitting */
+#define BATCH_MIN_FRAMES_PER_THREAD 32
+
+/* Records which of the values kept across frames a frame header updates,
+ * so that headers parsed independently of each other can be merged into
+ * the parser state in decoding order afterwards */
+typedef struct
+{
+  GstVp8Segmentation segmentation;
+  GstVp8MbLfAdjustments mb_lf_adjust;
+  /* non-zero for each probability the frame updates */
+  GstVp8TokenProbs token_probs;
+  GstVp8MvProbs mv_probs;
+  /* bit i set if ref_frame_delta[i] or mb_mode_delta[i] is updated */
+  guint8 ref_frame_delta;
+  guint8 mb_mode_delta;
+  gboolean y_prob;
+  gboolean uv_prob;
+} FrameUpdates;
+
 #define READ_BOOL(rd, val, field_name) \
   val = vp8_read_bool ((rd))
 #define READ_UINT(rd, val, nbits, field_name) \
@@ -160,7 +180,8 @@ parse_update_segmentation (GstVp8RangeDecoder * rd, GstVp8Segmentation * seg)
 
 /* Parse mb_lf_adjustments() to update loop filter delta adjustments */
 static gboolean
-parse_mb_lf_adjustments (GstVp8RangeDecoder * rd, GstVp8MbLfAdjustments * adj)
+parse_mb_lf_adjustments (GstVp8RangeDecoder * rd, GstVp8MbLfAdjustments * adj,
+    FrameUpdates * updates)
 {
   gboolean update;
   gint i;
@@ -179,6 +200,8 @@ parse_mb_lf_adjustments (GstVp8RangeDecoder * rd, GstVp8MbLfAdjustments * adj)
     READ_BOOL (rd, update, "ref_frame_delta_update_flag");
     if (update) {
       READ_SINT (rd, adj->ref_frame_delta[i], 6, "ref_frame_delta_magniture");
+      if (updates)
+        updates->ref_frame_delta |= 1 << i;
     }
   }
 
@@ -186,6 +209,8 @@ parse_mb_lf_adjustments (GstVp8RangeDecoder * rd, GstVp8MbLfAdjustments * adj)
     READ_BOOL (rd, update, "mb_mode_delta_update_flag");
     if (update) {
       READ_SINT (rd, adj->mb_mode_delta[i], 6, "mb_mode_delta_magnitude");
+      if (updates)
+        updates->mb_mode_delta |= 1 << i;
     }
   }
   return TRUE;
@@ -234,7 +259,8 @@ parse_quant_indices (GstVp8RangeDecoder * rd, GstVp8QuantIndices * qip)
 
 /* Parse token_prob_update() to update persistent token probabilities */
 static gboolean
-parse_token_prob_update (GstVp8RangeDecoder * rd, GstVp8TokenProbs * probs)
+parse_token_prob_update (GstVp8RangeDecoder * rd, GstVp8TokenProbs * probs,
+    FrameUpdates * updates)
 {
   gint i, j, k, l;
   guint8 prob;
@@ -247,6 +273,8 @@ parse_token_prob_update (GstVp8RangeDecoder * rd, GstVp8TokenProbs * probs)
                   vp8_token_update_probs.prob[i][j][k][l])) {
             READ_UINT (rd, prob, 8, "token_prob_update");
             probs->prob[i][j][k][l] = prob;
+            if (updates)
+              updates->token_probs.prob[i][j][k][l] = 1;
           }
         }
       }
@@ -257,7 +285,8 @@ parse_token_prob_update (GstVp8RangeDecoder * rd, GstVp8TokenProbs * probs)
 
 /* Parse prob_update() to update probabilities used for MV decoding */
 static gboolean
-parse_mv_prob_update (GstVp8RangeDecoder * rd, GstVp8MvProbs * probs)
+parse_mv_prob_update (GstVp8RangeDecoder * rd, GstVp8MvProbs * probs,
+    FrameUpdates * updates)
 {
   gint i, j;
   guint8 prob;
@@ -267,6 +296,8 @@ parse_mv_prob_update (GstVp8RangeDecoder * rd, GstVp8MvProbs * probs)
       if (gst_vp8_range_decoder_read (rd, vp8_mv_update_probs.prob[i][j])) {
         READ_UINT (rd, prob, 7, "mv_prob_update");
         probs->prob[i][j] = prob ? (prob << 1) : 1;
+        if (updates)
+          updates->mv_probs.prob[i][j] = 1;
       }
     }
   }
@@ -362,10 +393,27 @@ error:
   return GST_VP8_PARSER_ERROR;
 }
 
-/* Parse Frame Header (19.2) */
+/* Keep the entropy probabilities of the frame for the next ones */
+static void
+refresh_entropy_probs (GstVp8Parser * parser, const GstVp8FrameHdr * frame_hdr)
+{
+  if (!frame_hdr->refresh_entropy_probs)
+    return;
+
+  memcpy (&parser->token_probs, &frame_hdr->token_probs,
+      sizeof (frame_hdr->token_probs));
+  memcpy (&parser->mv_probs, &frame_hdr->mv_probs,
+      sizeof (frame_hdr->mv_probs));
+  if (!frame_hdr->key_frame)
+    memcpy (&parser->mode_probs, &frame_hdr->mode_probs,
+        sizeof (frame_hdr->mode_probs));
+}
+
+/* Parse Frame Header (19.2). If @updates is not NULL, the values updated
+ * by the frame are recorded there for merge_frame_updates() */
 static GstVp8ParserResult
 parse_frame_header (GstVp8Parser * parser, GstVp8RangeDecoder * rd,
-    GstVp8FrameHdr * frame_hdr)
+    GstVp8FrameHdr * frame_hdr, FrameUpdates * updates)
 {
   gboolean update;
   guint i;
@@ -384,7 +432,7 @@ parse_frame_header (GstVp8Parser * parser, GstVp8RangeDecoder * rd,
   READ_UINT (rd, frame_hdr->loop_filter_level, 6, "loop_filter_level");
   READ_UINT (rd, frame_hdr->sharpness_level, 3, "sharpness_level");
 
-  if (!parse_mb_lf_adjustments (rd, &parser->mb_lf_adjust))
+  if (!parse_mb_lf_adjustments (rd, &parser->mb_lf_adjust, updates))
     goto error;
 
   READ_UINT (rd, frame_hdr->log2_nbr_of_dct_partitions, 2,
@@ -430,7 +478,7 @@ parse_frame_header (GstVp8Parser * parser, GstVp8RangeDecoder * rd,
       sizeof (parser->token_probs));
   memcpy (&frame_hdr->mv_probs, &parser->mv_probs, sizeof (parser->mv_probs));
 
-  if (!parse_token_prob_update (rd, &frame_hdr->token_probs))
+  if (!parse_token_prob_update (rd, &frame_hdr->token_probs, updates))
     goto error;
 
   READ_BOOL (rd, frame_hdr->mb_no_skip_coeff, "mb_no_skip_coeff");
@@ -444,6 +492,8 @@ parse_frame_header (GstVp8Parser * parser, GstVp8RangeDecoder * rd,
     READ_UINT (rd, frame_hdr->prob_gf, 8, "prob_gf");
 
     READ_BOOL (rd, update, "intra_16x16_prob_update_flag");
+    if (updates)
+      updates->y_prob = update;
     if (update) {
       for (i = 0; i < 4; i++) {
         READ_UINT (rd, frame_hdr->mode_probs.y_prob[i], 8, "intra_16x16_prob");
@@ -451,6 +501,8 @@ parse_frame_header (GstVp8Parser * parser, GstVp8RangeDecoder * rd,
     }
 
     READ_BOOL (rd, update, "intra_chroma_prob_update_flag");
+    if (updates)
+      updates->uv_prob = update;
     if (update) {
       for (i = 0; i < 3; i++) {
         READ_UINT (rd, frame_hdr->mode_probs.uv_prob[i], 8,
@@ -458,20 +510,12 @@ parse_frame_header (GstVp8Parser * parser, GstVp8RangeDecoder * rd,
       }
     }
 
-    if (!parse_mv_prob_update (rd, &frame_hdr->mv_probs))
+    if (!parse_mv_prob_update (rd, &frame_hdr->mv_probs, updates))
       goto error;
   }
 
   /* Refresh entropy probabilities */
-  if (frame_hdr->refresh_entropy_probs) {
-    memcpy (&parser->token_probs, &frame_hdr->token_probs,
-        sizeof (frame_hdr->token_probs));
-    memcpy (&parser->mv_probs, &frame_hdr->mv_probs,
-        sizeof (frame_hdr->mv_probs));
-    if (!frame_hdr->key_frame)
-      memcpy (&parser->mode_probs, &frame_hdr->mode_probs,
-          sizeof (frame_hdr->mode_probs));
-  }
+  refresh_entropy_probs (parser, frame_hdr);
 
   /* Calculated values */
   frame_hdr->header_size = gst_vp8_range_decoder_get_pos (rd);
@@ -482,6 +526,150 @@ error:
   return GST_VP8_PARSER_ERROR;
 }
 
+/* Parse a complete frame header, see parse_frame_header() for @updates */
+static GstVp8ParserResult
+parse_frame (GstVp8Parser * parser, GstVp8FrameHdr * frame_hdr,
+    const guint8 * data, gsize size, FrameUpdates * updates)
+{
+  GstByteReader br;
+  GstVp8RangeDecoder rd;
+  GstVp8RangeDecoderState rd_state;
+  GstVp8ParserResult result;
+
+  /* Uncompressed Data Chunk */
+  gst_byte_reader_init (&br, data, size);
+
+  result = parse_uncompressed_data_chunk (parser, &br, frame_hdr);
+  if (result != GST_VP8_PARSER_OK)
+    return result;
+
+  /* Frame Header */
+  if (frame_hdr->data_chunk_size + frame_hdr->first_part_size > size)
+    return GST_VP8_PARSER_BROKEN_DATA;
+
+  data += frame_hdr->data_chunk_size;
+  size -= frame_hdr->data_chunk_size;
+  if (!gst_vp8_range_decoder_init (&rd, data, frame_hdr->first_part_size))
+    return GST_VP8_PARSER_BROKEN_DATA;
+
+  result = parse_frame_header (parser, &rd, frame_hdr, updates);
+  if (result != GST_VP8_PARSER_OK)
+    return result;
+
+  /* Calculate partition sizes */
+  if (!calc_partition_sizes (frame_hdr, data, size))
+    return GST_VP8_PARSER_BROKEN_DATA;
+
+  /* Sync range decoder state */
+  gst_vp8_range_decoder_get_state (&rd, &rd_state);
+  frame_hdr->rd_range = rd_state.range;
+  frame_hdr->rd_value = rd_state.value;
+  frame_hdr->rd_count = rd_state.count;
+  return GST_VP8_PARSER_OK;
+}
+
+/* Replace the probabilities a frame does not update with the ones from the
+ * parser state. Written as a plain select so that it gets vectorized */
+static void
+select_probs (guint8 * probs, const guint8 * state, const guint8 * updated,
+    gsize size)
+{
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    probs[i] = updated[i] ? probs[i] : state[i];
+}
+
+/* Apply a frame parsed with parse_frame() against a scratch parser to the
+ * real parser state, completing @frame_hdr on the way */
+static void
+merge_frame_updates (GstVp8Parser * parser, GstVp8FrameHdr * frame_hdr,
+    const FrameUpdates * updates)
+{
+  GstVp8Segmentation *seg = &parser->segmentation;
+  GstVp8MbLfAdjustments *adj = &parser->mb_lf_adjust;
+  const GstVp8Segmentation *new_seg = &updates->segmentation;
+  const GstVp8MbLfAdjustments *new_adj = &updates->mb_lf_adjust;
+  guint i;
+
+  if (frame_hdr->key_frame)
+    gst_vp8_parser_init (parser);
+
+  seg->segmentation_enabled = new_seg->segmentation_enabled;
+  seg->update_mb_segmentation_map = new_seg->update_mb_segmentation_map;
+  seg->update_segment_feature_data = new_seg->update_segment_feature_data;
+  if (seg->update_segment_feature_data) {
+    seg->segment_feature_mode = new_seg->segment_feature_mode;
+    memcpy (seg->quantizer_update_value, new_seg->quantizer_update_value,
+        sizeof (seg->quantizer_update_value));
+    memcpy (seg->lf_update_value, new_seg->lf_update_value,
+        sizeof (seg->lf_update_value));
+  }
+  if (seg->update_mb_segmentation_map)
+    memcpy (seg->segment_prob, new_seg->segment_prob,
+        sizeof (seg->segment_prob));
+
+  adj->loop_filter_adj_enable = new_adj->loop_filter_adj_enable;
+  adj->mode_ref_lf_delta_update = new_adj->mode_ref_lf_delta_update;
+  for (i = 0; i < 4; i++) {
+    if (updates->ref_frame_delta & (1 << i))
+      adj->ref_frame_delta[i] = new_adj->ref_frame_delta[i];
+    if (updates->mb_mode_delta & (1 << i))
+      adj->mb_mode_delta[i] = new_adj->mb_mode_delta[i];
+  }
+
+  select_probs ((guint8 *) & frame_hdr->token_probs,
+      (const guint8 *) & parser->token_probs,
+      (const guint8 *) & updates->token_probs, sizeof (GstVp8TokenProbs));
+  select_probs ((guint8 *) & frame_hdr->mv_probs,
+      (const guint8 *) & parser->mv_probs,
+      (const guint8 *) & updates->mv_probs, sizeof (GstVp8MvProbs));
+
+  if (!frame_hdr->key_frame) {
+    if (!updates->y_prob)
+      memcpy (frame_hdr->mode_probs.y_prob, parser->mode_probs.y_prob,
+          sizeof (parser->mode_probs.y_prob));
+    if (!updates->uv_prob)
+      memcpy (frame_hdr->mode_probs.uv_prob, parser->mode_probs.uv_prob,
+          sizeof (parser->mode_probs.uv_prob));
+  }
+
+  refresh_entropy_probs (parser, frame_hdr);
+}
+
+typedef struct
+{
+  const guint8 *const *frames;
+  const gsize *sizes;
+  GstVp8FrameHdr *frame_hdrs;
+  GstVp8ParserResult *results;
+  FrameUpdates *updates;
+  guint start;
+  guint end;
+} BatchRange;
+
+static gpointer
+parse_frame_range (gpointer user_data)
+{
+  BatchRange *range = user_data;
+  GstVp8Parser scratch;
+  guint i;
+
+  gst_vp8_parser_init (&scratch);
+
+  for (i = range->start; i < range->end; i++) {
+    FrameUpdates *updates = &range->updates[i];
+
+    memset (updates, 0, sizeof (*updates));
+    range->results[i] = parse_frame (&scratch, &range->frame_hdrs[i],
+        range->frames[i], range->sizes[i], updates);
+    updates->segmentation = scratch.segmentation;
+    updates->mb_lf_adjust = scratch.mb_lf_adjust;
+  }
+
+  return NULL;
+}
+
 /**** API ****/
 /**
  * gst_vp8_parser_init:
@@ -523,45 +711,97 @@ GstVp8ParserResult
 gst_vp8_parser_parse_frame_header (GstVp8Parser * parser,
     GstVp8FrameHdr * frame_hdr, const guint8 * data, gsize size)
 {
-  GstByteReader br;
-  GstVp8RangeDecoder rd;
-  GstVp8RangeDecoderState rd_state;
-  GstVp8ParserResult result;
-
   ensure_debug_category ();
   ensure_prob_tables ();
 
   g_return_val_if_fail (frame_hdr != NULL, GST_VP8_PARSER_ERROR);
   g_return_val_if_fail (parser != NULL, GST_VP8_PARSER_ERROR);
 
-  /* Uncompressed Data Chunk */
-  gst_byte_reader_init (&br, data, size);
+  return parse_frame (parser, frame_hdr, data, size, NULL);
+}
 
-  result = parse_uncompressed_data_chunk (parser, &br, frame_hdr);
-  if (result != GST_VP8_PARSER_OK)
-    return result;
+/**
+ * gst_vp8_parser_parse_frame_headers:
+ * @parser: The #GstVp8Parser
+ * @frames: (array length=n_frames): the frames to parse, in decoding order
+ * @sizes: (array length=n_frames): the size of each frame
+ * @n_frames: the number of frames
+ * @n_threads: the maximum number of threads to use, 0 for one per CPU
+ * @frame_hdrs: (array length=n_frames) (out caller-allocates): the
+ *   #GstVp8FrameHdr to fill, one per frame
+ * @results: (array length=n_frames) (out caller-allocates): the
+ *   #GstVp8ParserResult of each frame
+ *
+ * Parses the headers of @n_frames frames, with the same outcome as
+ * calling gst_vp8_parser_parse_frame_header() on each of them in turn.
+ * The frame headers are decoded on up to @n_threads threads, recording
+ * which probabilities and adjustments each frame updates; those are then
+ * merged into @parser in decoding order.
+ *
+ * Frames that fail to parse leave the parser state untouched.
+ *
+ * Since: 1.8
+ */
+void
+gst_vp8_parser_parse_frame_headers (GstVp8Parser * parser,
+    const guint8 * const *frames, const gsize * sizes, guint n_frames,
+    guint n_threads, GstVp8FrameHdr * frame_hdrs,
+    GstVp8ParserResult * results)
+{
+  FrameUpdates *updates;
+  BatchRange *ranges;
+  GThread **threads;
+  guint i, per_thread;
 
-  /* Frame Header */
-  if (frame_hdr->data_chunk_size + frame_hdr->first_part_size > size)
-    return GST_VP8_PARSER_BROKEN_DATA;
+  ensure_debug_category ();
+  ensure_prob_tables ();
 
-  data += frame_hdr->data_chunk_size;
-  size -= frame_hdr->data_chunk_size;
-  if (!gst_vp8_range_decoder_init (&rd, data, frame_hdr->first_part_size))
-    return GST_VP8_PARSER_BROKEN_DATA;
+  g_return_if_fail (parser != NULL);
+  g_return_if_fail (n_frames == 0 || (frames != NULL && sizes != NULL
+          && frame_hdrs != NULL && results != NULL));
+
+  if (n_frames == 0)
+    return;
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+  n_threads = MIN (n_threads, n_frames / BATCH_MIN_FRAMES_PER_THREAD);
+  n_threads = MAX (n_threads, 1);
+
+  updates = g_new (FrameUpdates, n_frames);
+  ranges = g_new (BatchRange, n_threads);
+  threads = g_new0 (GThread *, n_threads);
+  per_thread = (n_frames + n_threads - 1) / n_threads;
+
+  for (i = 0; i < n_threads; i++) {
+    ranges[i].frames = frames;
+    ranges[i].sizes = sizes;
+    ranges[i].frame_hdrs = frame_hdrs;
+    ranges[i].results = results;
+    ranges[i].updates = updates;
+    ranges[i].start = MIN (i * per_thread, n_frames);
+    ranges[i].end = MIN (ranges[i].start + per_thread, n_frames);
+  }
 
-  result = parse_frame_header (parser, &rd, frame_hdr);
-  if (result != GST_VP8_PARSER_OK)
-    return result;
+  for (i = 1; i < n_threads; i++) {
+    threads[i] = g_thread_try_new ("vp8parser", parse_frame_range,
+        &ranges[i], NULL);
+    if (!threads[i])
+      parse_frame_range (&ranges[i]);
+  }
+  parse_frame_range (&ranges[0]);
 
-  /* Calculate partition sizes */
-  if (!calc_partition_sizes (frame_hdr, data, size))
-    return GST_VP8_PARSER_BROKEN_DATA;
+  for (i = 1; i < n_threads; i++) {
+    if (threads[i])
+      g_thread_join (threads[i]);
+  }
 
-  /* Sync range decoder state */
-  gst_vp8_range_decoder_get_state (&rd, &rd_state);
-  frame_hdr->rd_range = rd_state.range;
-  frame_hdr->rd_value = rd_state.value;
-  frame_hdr->rd_count = rd_state.count;
-  return GST_VP8_PARSER_OK;
+  for (i = 0; i < n_frames; i++) {
+    if (results[i] == GST_VP8_PARSER_OK)
+      merge_frame_updates (parser, &frame_hdrs[i], &updates[i]);
+  }
+
+  g_free (threads);
+  g_free (ranges);
+  g_free (updates);
 }
@@ -333,6 +333,12 @@ GstVp8ParserResult
 gst_vp8_parser_parse_frame_header (GstVp8Parser * parser,
     GstVp8FrameHdr * frame_hdr, const guint8 * data, gsize size);
 
+void
+gst_vp8_parser_parse_frame_headers (GstVp8Parser * parser,
+    const guint8 * const * frames, const gsize * sizes, guint n_frames,
+    guint n_threads, GstVp8FrameHdr * frame_hdrs,
+    GstVp8ParserResult * results);
+
 G_END_DECLS
 
 #endif /* GST_VP8_PARSER_H */
@@ -44,6 +44,9 @@
 /* order of sb64, where sb64 = 64x64 */
 #define ALIGN_SB64(w) ((w + 63) >> 6)
 
+/* below this many frames per thread a batch is not worth splitting */
+#define BATCH_MIN_FRAMES_PER_THREAD 32
+
 GST_DEBUG_CATEGORY (gst_vp9_parser_debug);
 #define GST_CAT_DEFAULT gst_vp9_parser_debug
 
@@ -184,26 +187,21 @@ parse_display_frame_size (GstBitReader * br, GstVp9FrameHdr * frame_hdr)
         &frame_hdr->display_height);
 }
 
-static void
-parse_frame_size_from_refs (const GstVp9Parser * parser,
-    GstVp9FrameHdr * frame_hdr, GstBitReader * br)
+/* Returns the reference slot the frame size is copied from, or -1 if the
+ * size is coded explicitly. The slot is only resolved against the parser
+ * state by parse_frame_header_finish() */
+static gint
+parse_frame_size_from_refs (GstVp9FrameHdr * frame_hdr, GstBitReader * br)
 {
-  gboolean found = FALSE;
   int i;
-  GstVp9ParserPrivate *priv = GST_VP9_PARSER_GET_PRIVATE (parser);
 
   for (i = 0; i < GST_VP9_REFS_PER_FRAME; i++) {
-    found = gst_vp9_read_bit (br);
-
-    if (found) {
-      guint8 idx = frame_hdr->ref_frame_indices[i];
-      frame_hdr->width = priv->reference[idx].width;
-      frame_hdr->height = priv->reference[idx].height;
-      break;
-    }
+    if (gst_vp9_read_bit (br))
+      return frame_hdr->ref_frame_indices[i];
   }
-  if (!found)
-    parse_frame_size (br, &frame_hdr->width, &frame_hdr->height);
+
+  parse_frame_size (br, &frame_hdr->width, &frame_hdr->height);
+  return -1;
 }
 
 static GstVp9InterpolationFilter
@@ -604,85 +602,14 @@ gst_vp9_parser_update (GstVp9Parser * parser, GstVp9FrameHdr * const frame_hdr)
   return GST_VP9_PARSER_OK;
 }
 
-
-/******** API *************/
-
-/**
- * gst_vp9_parser_new:
- *
- * Creates a new #GstVp9Parser. It should be freed with
- * gst_vp9_parser_free() after use.
- *
- * Returns: a new #GstVp9Parser
- *
- * Since: 1.8
- */
-GstVp9Parser *
-gst_vp9_parser_new (void)
-{
-  GstVp9Parser *parser;
-  GstVp9ParserPrivate *priv;
-
-  INITIALIZE_DEBUG_CATEGORY;
-  GST_DEBUG ("Create VP9 Parser");
-
-  parser = g_slice_new (GstVp9Parser);
-  if (!parser)
-    return NULL;
-
-  priv = g_slice_new (GstVp9ParserPrivate);
-  if (!priv)
-    return NULL;
-
-  parser->priv = priv;
-  gst_vp9_parser_init (parser);
-
-  return parser;
-}
-
-/**
- * gst_vp9_parser_free:
- * @parser: the #GstVp9Parser to free
- *
- * Frees @parser.
- *
- * Since: 1.8
- */
-void
-gst_vp9_parser_free (GstVp9Parser * parser)
-{
-  if (parser) {
-    if (parser->priv) {
-      g_slice_free (GstVp9ParserPrivate, parser->priv);
-      parser->priv = NULL;
-    }
-    g_slice_free (GstVp9Parser, parser);
-  }
-}
-
-/**
- * gst_vp9_parser_parse_frame_header:
- * @parser: The #GstVp9Parser
- * @frame_hdr: The #GstVp9FrameHdr to fill
- * @data: The data to parse
- * @size: The size of the @data to parse
- *
- * Parses the VP9 bitstream contained in @data, and fills in @frame_hdr
- * with the information. The @size argument represent the whole frame size.
- *
- * Returns: a #GstVp9ParserResult
- *
- * Since: 1.8
- */
-GstVp9ParserResult
-gst_vp9_parser_parse_frame_header (GstVp9Parser * parser,
-    GstVp9FrameHdr * frame_hdr, const guint8 * data, gsize size)
+/* Parses the uncompressed header up to the tile info. None of this
+ * depends on the parser state, so it can run for many frames at once */
+static GstVp9ParserResult
+parse_frame_header_start (GstVp9FrameHdr * frame_hdr, GstBitReader * br,
+    gint * size_ref)
 {
-  GstBitReader bit_reader;
-  GstBitReader *br = &bit_reader;
-
-  gst_bit_reader_init (br, data, size);
   memset (frame_hdr, 0, sizeof (*frame_hdr));
+  *size_ref = -1;
 
   /* Parsing Uncompressed Data Chunk */
 
@@ -761,7 +688,7 @@ gst_vp9_parser_parse_frame_header (GstVp9Parser * parser,
         frame_hdr->ref_frame_sign_bias[i] = gst_vp9_read_bit (br);
       }
 
-      parse_frame_size_from_refs (parser, frame_hdr, br);
+      *size_ref = parse_frame_size_from_refs (frame_hdr, br);
       parse_display_frame_size (br, frame_hdr);
 
       frame_hdr->allow_high_precision_mv = gst_vp9_read_bit (br);
@@ -796,6 +723,29 @@ gst_vp9_parser_parse_frame_header (GstVp9Parser * parser,
   /* segmentation header */
   parse_segmentation (&frame_hdr->segmentation, br);
 
+  return GST_VP9_PARSER_OK;
+
+error:
+  return GST_VP9_PARSER_ERROR;
+}
+
+/* Resolves the frame size against the reference slots, parses the tile
+ * info which depends on it and updates the parser state. Frames must be
+ * passed through here in decoding order */
+static GstVp9ParserResult
+parse_frame_header_finish (GstVp9Parser * parser, GstVp9FrameHdr * frame_hdr,
+    GstBitReader * br, gint size_ref)
+{
+  GstVp9ParserPrivate *priv = GST_VP9_PARSER_GET_PRIVATE (parser);
+
+  if (frame_hdr->show_existing_frame)
+    return GST_VP9_PARSER_OK;
+
+  if (size_ref >= 0) {
+    frame_hdr->width = priv->reference[size_ref].width;
+    frame_hdr->height = priv->reference[size_ref].height;
+  }
+
   /* tile header */
   if (!parse_tile_info (frame_hdr, br)) {
     GST_ERROR ("Failed to parse tile info...!");
@@ -817,3 +767,311 @@ gst_vp9_parser_parse_frame_header (GstVp9Parser * parser,
 error:
   return GST_VP9_PARSER_ERROR;
 }
+
+
+/* State of a frame between the two halves of the header parsing */
+typedef struct
+{
+  GstBitReader br;
+  gint size_ref;
+} PendingHeader;
+
+typedef struct
+{
+  const guint8 *const *packets;
+  GstVp9BatchFrame *frames;
+  PendingHeader *pending;
+  guint start;
+  guint end;
+} BatchRange;
+
+static gpointer
+parse_frame_header_range (gpointer user_data)
+{
+  BatchRange *range = user_data;
+  guint i;
+
+  for (i = range->start; i < range->end; i++) {
+    GstVp9BatchFrame *frame = &range->frames[i];
+    PendingHeader *pending = &range->pending[i];
+
+    if (frame->result != GST_VP9_PARSER_OK)
+      continue;
+
+    gst_bit_reader_init (&pending->br,
+        range->packets[frame->packet] + frame->offset, frame->size);
+    frame->result = parse_frame_header_start (&frame->frame_hdr,
+        &pending->br, &pending->size_ref);
+  }
+
+  return NULL;
+}
+
+/******** API *************/
+
+/**
+ * gst_vp9_parser_new:
+ *
+ * Creates a new #GstVp9Parser. It should be freed with
+ * gst_vp9_parser_free() after use.
+ *
+ * Returns: a new #GstVp9Parser
+ *
+ * Since: 1.8
+ */
+GstVp9Parser *
+gst_vp9_parser_new (void)
+{
+  GstVp9Parser *parser;
+  GstVp9ParserPrivate *priv;
+
+  INITIALIZE_DEBUG_CATEGORY;
+  GST_DEBUG ("Create VP9 Parser");
+
+  parser = g_slice_new (GstVp9Parser);
+  if (!parser)
+    return NULL;
+
+  priv = g_slice_new (GstVp9ParserPrivate);
+  if (!priv)
+    return NULL;
+
+  parser->priv = priv;
+  gst_vp9_parser_init (parser);
+
+  return parser;
+}
+
+/**
+ * gst_vp9_parser_free:
+ * @parser: the #GstVp9Parser to free
+ *
+ * Frees @parser.
+ *
+ * Since: 1.8
+ */
+void
+gst_vp9_parser_free (GstVp9Parser * parser)
+{
+  if (parser) {
+    if (parser->priv) {
+      g_slice_free (GstVp9ParserPrivate, parser->priv);
+      parser->priv = NULL;
+    }
+    g_slice_free (GstVp9Parser, parser);
+  }
+}
+
+/**
+ * gst_vp9_parser_parse_frame_header:
+ * @parser: The #GstVp9Parser
+ * @frame_hdr: The #GstVp9FrameHdr to fill
+ * @data: The data to parse
+ * @size: The size of the @data to parse
+ *
+ * Parses the VP9 bitstream contained in @data, and fills in @frame_hdr
+ * with the information. The @size argument represent the whole frame size.
+ *
+ * Returns: a #GstVp9ParserResult
+ *
+ * Since: 1.8
+ */
+GstVp9ParserResult
+gst_vp9_parser_parse_frame_header (GstVp9Parser * parser,
+    GstVp9FrameHdr * frame_hdr, const guint8 * data, gsize size)
+{
+  GstBitReader bit_reader;
+  GstBitReader *br = &bit_reader;
+  GstVp9ParserResult res;
+  gint size_ref;
+
+  gst_bit_reader_init (br, data, size);
+
+  res = parse_frame_header_start (frame_hdr, br, &size_ref);
+  if (res != GST_VP9_PARSER_OK)
+    return res;
+
+  return parse_frame_header_finish (parser, frame_hdr, br, size_ref);
+}
+
+/**
+ * gst_vp9_parser_parse_superframe_info:
+ * @parser: The #GstVp9Parser
+ * @superframe_info: The #GstVp9SuperframeInfo to fill
+ * @data: The packet to parse
+ * @size: The size of the @data to parse
+ *
+ * Looks for a superframe index at the end of @data and fills in
+ * @superframe_info with the sizes of the frames the packet holds. A
+ * packet without index is reported as a single frame.
+ *
+ * Returns: a #GstVp9ParserResult
+ *
+ * Since: 1.8
+ */
+GstVp9ParserResult
+gst_vp9_parser_parse_superframe_info (GstVp9Parser * parser,
+    GstVp9SuperframeInfo * superframe_info, const guint8 * data, gsize size)
+{
+  guint32 bytes_per_framesize, frames_in_superframe, index_size;
+  guint32 frame_sizes[GST_VP9_MAX_FRAMES_IN_SUPERFRAME] = { 0, };
+  guint32 total = 0;
+  const guint8 *index;
+  guint8 marker;
+  guint i, j;
+
+  g_return_val_if_fail (parser != NULL, GST_VP9_PARSER_ERROR);
+  g_return_val_if_fail (superframe_info != NULL, GST_VP9_PARSER_ERROR);
+  g_return_val_if_fail (data != NULL || size == 0, GST_VP9_PARSER_ERROR);
+
+  memset (superframe_info, 0, sizeof (*superframe_info));
+  superframe_info->frames_in_superframe = 1;
+  superframe_info->frame_sizes[0] = size;
+
+  if (size == 0)
+    return GST_VP9_PARSER_OK;
+
+  /* the index is framed by a marker byte 110xxyyy on both ends, where xx is
+   * the number of bytes per frame size minus 1 and yyy the number of
+   * frames minus 1 */
+  marker = data[size - 1];
+  if ((marker & 0xe0) != 0xc0)
+    return GST_VP9_PARSER_OK;
+
+  bytes_per_framesize = ((marker >> 3) & 0x3) + 1;
+  frames_in_superframe = (marker & 0x7) + 1;
+  index_size = 2 + bytes_per_framesize * frames_in_superframe;
+
+  if (size < index_size || data[size - index_size] != marker)
+    return GST_VP9_PARSER_OK;
+
+  index = data + size - index_size + 1;
+  for (i = 0; i < frames_in_superframe; i++) {
+    guint32 frame_size = 0;
+
+    for (j = 0; j < bytes_per_framesize; j++)
+      frame_size |= (guint32) (*index++) << (j * 8);
+
+    if (frame_size > size - index_size - total) {
+      GST_ERROR ("Superframe index exceeds the packet size");
+      return GST_VP9_PARSER_BROKEN_DATA;
+    }
+
+    frame_sizes[i] = frame_size;
+    total += frame_size;
+  }
+
+  memcpy (superframe_info->frame_sizes, frame_sizes, sizeof (frame_sizes));
+  superframe_info->bytes_per_framesize = bytes_per_framesize;
+  superframe_info->frames_in_superframe = frames_in_superframe;
+  superframe_info->superframe_index_size = index_size;
+
+  return GST_VP9_PARSER_OK;
+}
+
+/**
+ * gst_vp9_parser_parse_frame_headers:
+ * @parser: The #GstVp9Parser
+ * @packets: (array length=n_packets): the packets to parse, in decoding order
+ * @sizes: (array length=n_packets): the size of each packet
+ * @n_packets: the number of packets
+ * @n_threads: the maximum number of threads to use, 0 for one per CPU
+ *
+ * Splits @packets into frames and parses the header of each frame, as
+ * repeated calls to gst_vp9_parser_parse_frame_header() would. Most of
+ * the uncompressed header does not depend on previous frames, so that part
+ * is parsed on up to @n_threads threads and only the frame size, tile info
+ * and state update are done in order afterwards.
+ *
+ * A packet with a broken superframe index yields a single frame with a
+ * %GST_VP9_PARSER_BROKEN_DATA result.
+ *
+ * Returns: (transfer full) (element-type GstVp9BatchFrame): an array with
+ *   one #GstVp9BatchFrame per frame, free with g_array_free()
+ *
+ * Since: 1.8
+ */
+GArray *
+gst_vp9_parser_parse_frame_headers (GstVp9Parser * parser,
+    const guint8 * const *packets, const gsize * sizes, guint n_packets,
+    guint n_threads)
+{
+  GArray *frames;
+  PendingHeader *pending;
+  BatchRange *ranges;
+  GThread **threads;
+  guint i, j, per_thread;
+
+  g_return_val_if_fail (parser != NULL, NULL);
+  g_return_val_if_fail (n_packets == 0 || (packets != NULL
+          && sizes != NULL), NULL);
+
+  frames = g_array_sized_new (FALSE, TRUE, sizeof (GstVp9BatchFrame),
+      n_packets);
+
+  for (i = 0; i < n_packets; i++) {
+    GstVp9SuperframeInfo info;
+    GstVp9ParserResult res;
+    guint32 offset = 0;
+
+    res = gst_vp9_parser_parse_superframe_info (parser, &info, packets[i],
+        sizes[i]);
+
+    for (j = 0; j < info.frames_in_superframe; j++) {
+      GstVp9BatchFrame *frame;
+
+      g_array_set_size (frames, frames->len + 1);
+      frame = &g_array_index (frames, GstVp9BatchFrame, frames->len - 1);
+      frame->packet = i;
+      frame->offset = offset;
+      frame->size = info.frame_sizes[j];
+      frame->result = res;
+      offset += frame->size;
+    }
+  }
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+  n_threads = MIN (n_threads, frames->len / BATCH_MIN_FRAMES_PER_THREAD);
+  n_threads = MAX (n_threads, 1);
+
+  pending = g_new (PendingHeader, frames->len);
+  ranges = g_new (BatchRange, n_threads);
+  threads = g_new0 (GThread *, n_threads);
+  per_thread = (frames->len + n_threads - 1) / n_threads;
+
+  for (i = 0; i < n_threads; i++) {
+    ranges[i].packets = packets;
+    ranges[i].frames = (GstVp9BatchFrame *) frames->data;
+    ranges[i].pending = pending;
+    ranges[i].start = MIN (i * per_thread, frames->len);
+    ranges[i].end = MIN (ranges[i].start + per_thread, frames->len);
+  }
+
+  for (i = 1; i < n_threads; i++) {
+    threads[i] = g_thread_try_new ("vp9parser", parse_frame_header_range,
+        &ranges[i], NULL);
+    if (!threads[i])
+      parse_frame_header_range (&ranges[i]);
+  }
+  parse_frame_header_range (&ranges[0]);
+
+  for (i = 1; i < n_threads; i++) {
+    if (threads[i])
+      g_thread_join (threads[i]);
+  }
+
+  for (i = 0; i < frames->len; i++) {
+    GstVp9BatchFrame *frame = &g_array_index (frames, GstVp9BatchFrame, i);
+
+    if (frame->result == GST_VP9_PARSER_OK)
+      frame->result = parse_frame_header_finish (parser, &frame->frame_hdr,
+          &pending[i].br, pending[i].size_ref);
+  }
+
+  g_free (threads);
+  g_free (ranges);
+  g_free (pending);
+
+  return frames;
+}
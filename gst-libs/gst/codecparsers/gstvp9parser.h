@@ -60,6 +60,8 @@ G_BEGIN_DECLS
 
 #define GST_VP9_PREDICTION_PROBS   3
 
+#define GST_VP9_MAX_FRAMES_IN_SUPERFRAME 8
+
 typedef struct _GstVp9Parser               GstVp9Parser;
 typedef struct _GstVp9FrameHdr             GstVp9FrameHdr;
 typedef struct _GstVp9LoopFilter           GstVp9LoopFilter;
@@ -67,6 +69,8 @@ typedef struct _GstVp9QuantIndices         GstVp9QuantIndices;
 typedef struct _GstVp9Segmentation         GstVp9Segmentation;
 typedef struct _GstVp9SegmentationInfo     GstVp9SegmentationInfo;
 typedef struct _GstVp9SegmentationInfoData GstVp9SegmentationInfoData;
+typedef struct _GstVp9SuperframeInfo       GstVp9SuperframeInfo;
+typedef struct _GstVp9BatchFrame           GstVp9BatchFrame;
 
 /**
  * GstVp9ParseResult:
@@ -461,6 +465,48 @@ struct _GstVp9Segmentation
   guint8 reference_skip;
 };
 
+/**
+ * GstVp9SuperframeInfo:
+ * @bytes_per_framesize: number of bytes used to code each frame size
+ * @frames_in_superframe: number of frames in the superframe
+ * @frame_sizes: size of each frame, in bitstream order
+ * @superframe_index_size: size of the superframe index at the end of the
+ *   packet, 0 if the packet is not a superframe
+ *
+ * Describes how a packet is split into frames. A packet without superframe
+ * index holds a single frame spanning the whole packet.
+ *
+ * Since: 1.8
+ */
+struct _GstVp9SuperframeInfo
+{
+  guint32 bytes_per_framesize;
+  guint32 frames_in_superframe;
+  guint32 frame_sizes[GST_VP9_MAX_FRAMES_IN_SUPERFRAME];
+  guint32 superframe_index_size;
+};
+
+/**
+ * GstVp9BatchFrame:
+ * @packet: index of the packet the frame was found in
+ * @offset: offset of the frame in its packet
+ * @size: size of the frame
+ * @result: result of parsing the frame header
+ * @frame_hdr: the frame header, valid if @result is %GST_VP9_PARSER_OK
+ *
+ * A frame parsed by gst_vp9_parser_parse_frame_headers()
+ *
+ * Since: 1.8
+ */
+struct _GstVp9BatchFrame
+{
+  guint packet;
+  guint32 offset;
+  guint32 size;
+  GstVp9ParserResult result;
+  GstVp9FrameHdr frame_hdr;
+};
+
 /**
  * GstVp9Parser:
  * @priv: GstVp9ParserPrivate struct to keep track of state variables
@@ -486,6 +532,10 @@ GstVp9Parser *     gst_vp9_parser_new (void);
 
 GstVp9ParserResult gst_vp9_parser_parse_frame_header (GstVp9Parser* parser, GstVp9FrameHdr * frame_hdr, const guint8 * data, gsize size);
 
+GstVp9ParserResult gst_vp9_parser_parse_superframe_info (GstVp9Parser * parser, GstVp9SuperframeInfo * superframe_info, const guint8 * data, gsize size);
+
+GArray *           gst_vp9_parser_parse_frame_headers (GstVp9Parser * parser, const guint8 * const * packets, const gsize * sizes, guint n_packets, guint n_threads);
+
 void               gst_vp9_parser_free (GstVp9Parser * parser);
 
 G_END_DECLS
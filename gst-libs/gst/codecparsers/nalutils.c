@@ -63,6 +63,83 @@ ceil_log2 (guint32 v)
 
 /****** Nal parser ******/
 
+/* Emulation prevention bytes are searched for in windows of this size so
+ * that readers only parsing the start of a big NAL do not scan all of it */
+#define NAL_READER_EPB_SCAN_SIZE 256
+
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+#define nal_reader_clz64(x) ((guint) __builtin_clzll (x))
+#else
+static inline guint
+nal_reader_clz64 (guint64 x)
+{
+  guint n = 0;
+
+  while (!(x & G_GUINT64_CONSTANT (0x8000000000000000))) {
+    x <<= 1;
+    n++;
+  }
+  return n;
+}
+#endif
+
+static inline gboolean
+nal_reader_is_epb (const guint8 * data, guint pos)
+{
+  return pos >= 2 && data[pos] == 0x03 && data[pos - 1] == 0x00 &&
+      data[pos - 2] == 0x00;
+}
+
+/* Returns the position of the next emulation_prevention_three_byte at or
+ * after @pos, or the end of the scanned window if there is none in it.
+ * memchr() is vectorized by the C library, so this is a lot cheaper than
+ * checking every byte while reading */
+static inline guint
+nal_reader_find_epb (const guint8 * data, guint size, guint pos)
+{
+  const guint8 *p;
+  guint end;
+
+  end = MIN (size, pos + NAL_READER_EPB_SCAN_SIZE);
+  pos = MAX (pos, 2);
+
+  while (pos < end && (p = memchr (data + pos, 0x03, end - pos))) {
+    pos = p - data;
+    if (data[pos - 1] == 0x00 && data[pos - 2] == 0x00)
+      return pos;
+    pos++;
+  }
+
+  return end;
+}
+
+/* Fills the cache with as many whole bytes as fit, a word at a time, without
+ * going past the next emulation prevention byte */
+static inline void
+nal_reader_fill (NalReader * nr)
+{
+  guint n;
+
+  n = MIN ((64 - nr->bits_in_cache) / 8, nr->next_epb - nr->byte);
+  if (n == 0)
+    return;
+
+  if (n == 8) {
+    nr->cache = GST_READ_UINT64_BE (nr->data + nr->byte);
+  } else if (nr->byte + 8 <= nr->size) {
+    guint64 word = GST_READ_UINT64_BE (nr->data + nr->byte);
+    nr->cache = (nr->cache << (n * 8)) | (word >> (64 - n * 8));
+  } else {
+    guint i;
+
+    for (i = 0; i < n; i++)
+      nr->cache = (nr->cache << 8) | nr->data[nr->byte + i];
+  }
+
+  nr->byte += n;
+  nr->bits_in_cache += n * 8;
+}
+
 void
 nal_reader_init (NalReader * nr, const guint8 * data, guint size)
 {
@@ -72,41 +149,41 @@ nal_reader_init (NalReader * nr, const guint8 * data, guint size)
 
   nr->byte = 0;
   nr->bits_in_cache = 0;
-  /* fill with something other than 0 to detect emulation prevention bytes */
-  nr->first_byte = 0xff;
-  nr->cache = 0xff;
+  nr->cache = 0;
+  nr->next_epb = nal_reader_find_epb (data, size, 0);
 }
 
 inline gboolean
 nal_reader_read (NalReader * nr, guint nbits)
 {
+  if (G_LIKELY (nr->bits_in_cache >= nbits))
+    return TRUE;
+
   if (G_UNLIKELY (nr->byte * 8 + (nbits - nr->bits_in_cache) > nr->size * 8)) {
     GST_DEBUG ("Can not read %u bits, bits in cache %u, Byte * 8 %u, size in "
         "bits %u", nbits, nr->bits_in_cache, nr->byte * 8, nr->size * 8);
     return FALSE;
   }
 
-  while (nr->bits_in_cache < nbits) {
-    guint8 byte;
-    gboolean check_three_byte;
+  nal_reader_fill (nr);
 
-    check_three_byte = TRUE;
-  next_byte:
+  /* Past an emulation prevention byte only fetch the bytes that are needed,
+   * so that the position and the number of emulation prevention bytes
+   * always refer to the data consumed so far */
+  while (nr->bits_in_cache < nbits) {
     if (G_UNLIKELY (nr->byte >= nr->size))
       return FALSE;
 
-    byte = nr->data[nr->byte++];
-
-    /* check if the byte is a emulation_prevention_three_byte */
-    if (check_three_byte && byte == 0x03 && nr->first_byte == 0x00 &&
-        ((nr->cache & 0xff) == 0)) {
-      /* next byte goes unconditionally to the cache, even if it's 0x03 */
-      check_three_byte = FALSE;
-      nr->n_epb++;
-      goto next_byte;
+    if (nr->byte == nr->next_epb) {
+      if (nal_reader_is_epb (nr->data, nr->byte)) {
+        nr->n_epb++;
+        if (G_UNLIKELY (++nr->byte >= nr->size))
+          return FALSE;
+      }
+      nr->next_epb = nal_reader_find_epb (nr->data, nr->size, nr->byte);
     }
-    nr->cache = (nr->cache << 8) | nr->first_byte;
-    nr->first_byte = byte;
+
+    nr->cache = (nr->cache << 8) | nr->data[nr->byte++];
     nr->bits_in_cache += 8;
   }
 
@@ -120,6 +197,13 @@ nal_reader_skip (NalReader * nr, guint nbits)
 {
   g_assert (nbits <= 8 * sizeof (nr->cache));
 
+  /* the cache can't take more than 64 bits on top of a partial byte */
+  if (nbits > 32) {
+    if (G_UNLIKELY (!nal_reader_skip (nr, 32)))
+      return FALSE;
+    nbits -= 32;
+  }
+
   if (G_UNLIKELY (!nal_reader_read (nr, nbits)))
     return FALSE;
 
@@ -170,14 +254,17 @@ nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint nbits) \
 { \
   guint shift; \
   \
+  if (G_UNLIKELY (nbits == 0)) { \
+    *val = 0; \
+    return TRUE; \
+  } \
+  \
   if (!nal_reader_read (nr, nbits)) \
     return FALSE; \
   \
   /* bring the required bits down and truncate */ \
   shift = nr->bits_in_cache - nbits; \
-  *val = nr->first_byte >> shift; \
-  \
-  *val |= nr->cache << (8 - shift); \
+  *val = (guint##bits) (nr->cache >> shift); \
   /* mask out required bits */ \
   if (nbits < bits) \
     *val &= ((guint##bits)1 << nbits) - 1; \
@@ -187,10 +274,41 @@ nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint nbits) \
   return TRUE; \
 } \
 
+/* A refill leaves at least 57 bits in the cache, which is enough for any
+ * of these */
 NAL_READER_READ_BITS (8);
 NAL_READER_READ_BITS (16);
 NAL_READER_READ_BITS (32);
 
+/* Values longer than 32 bits would not fit in the cache on top of a partial
+ * byte, so they are read in two parts */
+gboolean
+nal_reader_get_bits_uint64 (NalReader * nr, guint64 * val, guint nbits)
+{
+  guint32 hi, lo;
+
+  g_return_val_if_fail (nbits <= 64, FALSE);
+
+  if (nbits <= 32) {
+    if (!nal_reader_get_bits_uint32 (nr, &lo, nbits))
+      return FALSE;
+    *val = lo;
+    return TRUE;
+  }
+
+  /* don't consume the high part if the low one can't be read */
+  if (G_UNLIKELY (nal_reader_get_remaining (nr) < nbits))
+    return FALSE;
+
+  if (!nal_reader_get_bits_uint32 (nr, &hi, nbits - 32) ||
+      !nal_reader_get_bits_uint32 (nr, &lo, 32))
+    return FALSE;
+
+  *val = ((guint64) hi << 32) | lo;
+
+  return TRUE;
+}
+
 #define NAL_READER_PEEK_BITS(bits) \
 gboolean \
 nal_reader_peek_bits_uint##bits (const NalReader *nr, guint##bits *val, guint nbits) \
@@ -210,6 +328,26 @@ nal_reader_get_ue (NalReader * nr, guint32 * val)
   guint8 bit;
   guint32 value;
 
+  /* Fast path: decode the code directly from the cache when it is complete
+   * in there, counting the leading zeros in a single instruction */
+  if (nr->bits_in_cache < 32)
+    nal_reader_fill (nr);
+
+  if (G_LIKELY (nr->bits_in_cache > 0)) {
+    guint64 bits = nr->cache << (64 - nr->bits_in_cache);
+
+    if (G_LIKELY (bits != 0)) {
+      guint zeros = nal_reader_clz64 (bits);
+      guint len = 2 * zeros + 1;
+
+      if (G_LIKELY (zeros < 32 && len <= nr->bits_in_cache)) {
+        *val = (guint32) ((bits >> (64 - len)) - 1);
+        nr->bits_in_cache -= len;
+        return TRUE;
+      }
+    }
+  }
+
   if (G_UNLIKELY (!nal_reader_get_bits_uint8 (nr, &bit, 1)))
     return FALSE;
 
@@ -249,7 +387,8 @@ nal_reader_get_se (NalReader * nr, gint32 * val)
 gboolean
 nal_reader_is_byte_aligned (NalReader * nr)
 {
-  if (nr->bits_in_cache != 0)
+  /* only whole bytes are ever added to the cache */
+  if ((nr->bits_in_cache & 7) != 0)
     return FALSE;
   return TRUE;
 }
@@ -300,10 +439,6 @@ nal_reader_has_more_data (NalReader * nr)
 inline gint
 scan_for_start_codes (const guint8 * data, guint size)
 {
-  GstByteReader br;
-  gst_byte_reader_init (&br, data, size);
-
   /* NALU not empty, so we can at least expect 1 (even 2) bytes following sc */
-  return gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
-      0, size);
+  return scan_for_start_code_prefix (data, size);
 }
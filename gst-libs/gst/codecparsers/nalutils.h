@@ -39,6 +39,8 @@
 #include <gst/base/gstbitreader.h>
 #include <string.h>
 
+#include "scanutils.h"
+
 guint ceil_log2 (guint32 v);
 
 typedef struct
@@ -48,8 +50,9 @@ typedef struct
 
   guint n_epb;                  /* Number of emulation prevention bytes */
   guint byte;                   /* Byte position */
-  guint bits_in_cache;          /* bitpos in the cache of next bit */
-  guint8 first_byte;
+  guint bits_in_cache;          /* number of valid low bits in the cache */
+  guint next_epb;               /* position of the next emulation prevention
+                                 * byte, or end of the scanned area */
   guint64 cache;                /* cached bytes */
 } NalReader;
 
@@ -87,6 +90,7 @@ gboolean nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint
 NAL_READER_READ_BITS_H (8);
 NAL_READER_READ_BITS_H (16);
 NAL_READER_READ_BITS_H (32);
+NAL_READER_READ_BITS_H (64);
 
 #define NAL_READER_PEEK_BITS_H(bits) \
 G_GNUC_INTERNAL \
@@ -139,7 +143,7 @@ gboolean nal_reader_get_se (NalReader * nr, gint32 * val);
 
 #define READ_UINT64(nr, val, nbits) { \
   if (!nal_reader_get_bits_uint64 (nr, &val, nbits)) { \
-    GST_WARNING ("failed to read uint32, nbits: %d", nbits); \
+    GST_WARNING ("failed to read uint64, nbits: %d", nbits); \
     goto error; \
   } \
 }
@@ -0,0 +1,310 @@
+/* Gstreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * Start code and marker scanning shared by the codec parsers.
+ *
+ * Parsers spend most of their time looking for the next unit boundary in
+ * the payload, so this is done 16 or 32 bytes at a time with SSE2 or AVX2
+ * (both selected at runtime, so GST_CPU_FEATURES_DISABLE can turn them
+ * off) or NEON when available. The vector loops compare shifted loads of
+ * the data against the pattern for every position of a block at once and
+ * leave the tail of the buffer to the scalar versions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "scanutils.h"
+#include <gst/gst-cpu-features-private.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef GST_CPU_HAVE_TARGET_ATTRIBUTE
+#define SCAN_USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SCAN_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Scalar versions, also used for the tail of the vectorized ones. They
+ * skip ahead by up to three bytes depending on what can't be part of
+ * a match */
+static inline gint
+scan_start_code_scalar (const guint8 * data, guint i, guint size)
+{
+  while (i + 4 <= size) {
+    if (data[i + 2] > 1) {
+      i += 3;
+    } else if (data[i + 1]) {
+      i += 2;
+    } else if (data[i] || data[i + 2] != 1) {
+      i++;
+    } else {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static inline gint
+scan_jpeg_marker_scalar (const guint8 * data, guint i, guint size)
+{
+  i++;
+  while (i < size) {
+    const guint8 v = data[i];
+
+    if (v < 0xc0)
+      i += 2;
+    else if (v < 0xff && data[i - 1] == 0xff)
+      return i - 1;
+    else
+      i++;
+  }
+
+  return -1;
+}
+
+#if defined(SCAN_USE_AVX2) || defined(SCAN_USE_SSE2)
+/* The features are read once per process, as the scans are too short to
+ * look them up every time */
+static GstCpuFeatures
+scan_cpu_features (void)
+{
+  static gsize init = 0;
+  static GstCpuFeatures features = 0;
+
+  if (g_once_init_enter (&init)) {
+    features = gst_cpu_get_features ();
+    g_once_init_leave (&init, 1);
+  }
+
+  return features;
+}
+#endif
+
+#ifdef SCAN_USE_AVX2
+__attribute__ ((target ("avx2")))
+static gint
+scan_start_code_avx2 (const guint8 * data, guint size)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i one = _mm256_set1_epi8 (1);
+  guint i = 0;
+
+  /* a match at the last position of a block needs data up to i + 35 */
+  while (i + 35 <= size) {
+    __m256i b0 = _mm256_loadu_si256 ((const __m256i *) (data + i));
+    __m256i b1 = _mm256_loadu_si256 ((const __m256i *) (data + i + 1));
+    __m256i b2 = _mm256_loadu_si256 ((const __m256i *) (data + i + 2));
+    __m256i m;
+    guint32 mask;
+
+    m = _mm256_and_si256 (_mm256_cmpeq_epi8 (b0, zero),
+        _mm256_cmpeq_epi8 (b1, zero));
+    m = _mm256_and_si256 (m, _mm256_cmpeq_epi8 (b2, one));
+    mask = (guint32) _mm256_movemask_epi8 (m);
+    if (mask)
+      return i + g_bit_nth_lsf (mask, -1);
+    i += 32;
+  }
+
+  return scan_start_code_scalar (data, i, size);
+}
+
+__attribute__ ((target ("avx2")))
+static gint
+scan_jpeg_marker_avx2 (const guint8 * data, guint size)
+{
+  const __m256i ff = _mm256_set1_epi8 ((gchar) 0xff);
+  const __m256i c0 = _mm256_set1_epi8 ((gchar) 0xc0);
+  guint i = 0;
+
+  while (i + 33 <= size) {
+    __m256i b0 = _mm256_loadu_si256 ((const __m256i *) (data + i));
+    __m256i b1 = _mm256_loadu_si256 ((const __m256i *) (data + i + 1));
+    __m256i code, m;
+    guint32 mask;
+
+    /* marker codes are 0xc0 to 0xfe */
+    code = _mm256_cmpeq_epi8 (_mm256_max_epu8 (b1, c0), b1);
+    code = _mm256_andnot_si256 (_mm256_cmpeq_epi8 (b1, ff), code);
+    m = _mm256_and_si256 (_mm256_cmpeq_epi8 (b0, ff), code);
+    mask = (guint32) _mm256_movemask_epi8 (m);
+    if (mask)
+      return i + g_bit_nth_lsf (mask, -1);
+    i += 32;
+  }
+
+  return scan_jpeg_marker_scalar (data, i, size);
+}
+#endif
+
+#ifdef SCAN_USE_SSE2
+static gint
+scan_start_code_sse2 (const guint8 * data, guint size)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one = _mm_set1_epi8 (1);
+  guint i = 0;
+
+  while (i + 19 <= size) {
+    __m128i b0 = _mm_loadu_si128 ((const __m128i *) (data + i));
+    __m128i b1 = _mm_loadu_si128 ((const __m128i *) (data + i + 1));
+    __m128i b2 = _mm_loadu_si128 ((const __m128i *) (data + i + 2));
+    __m128i m;
+    guint mask;
+
+    m = _mm_and_si128 (_mm_cmpeq_epi8 (b0, zero), _mm_cmpeq_epi8 (b1, zero));
+    m = _mm_and_si128 (m, _mm_cmpeq_epi8 (b2, one));
+    mask = (guint) _mm_movemask_epi8 (m);
+    if (mask)
+      return i + g_bit_nth_lsf (mask, -1);
+    i += 16;
+  }
+
+  return scan_start_code_scalar (data, i, size);
+}
+
+static gint
+scan_jpeg_marker_sse2 (const guint8 * data, guint size)
+{
+  const __m128i ff = _mm_set1_epi8 ((gchar) 0xff);
+  const __m128i c0 = _mm_set1_epi8 ((gchar) 0xc0);
+  guint i = 0;
+
+  while (i + 17 <= size) {
+    __m128i b0 = _mm_loadu_si128 ((const __m128i *) (data + i));
+    __m128i b1 = _mm_loadu_si128 ((const __m128i *) (data + i + 1));
+    __m128i code, m;
+    guint mask;
+
+    code = _mm_cmpeq_epi8 (_mm_max_epu8 (b1, c0), b1);
+    code = _mm_andnot_si128 (_mm_cmpeq_epi8 (b1, ff), code);
+    m = _mm_and_si128 (_mm_cmpeq_epi8 (b0, ff), code);
+    mask = (guint) _mm_movemask_epi8 (m);
+    if (mask)
+      return i + g_bit_nth_lsf (mask, -1);
+    i += 16;
+  }
+
+  return scan_jpeg_marker_scalar (data, i, size);
+}
+#endif
+
+#ifdef SCAN_USE_NEON
+/* NEON has no movemask, so only detect a hit in the block and let the
+ * scalar code find its exact position */
+static inline gboolean
+scan_neon_any (uint8x16_t m)
+{
+  uint64x2_t m64 = vreinterpretq_u64_u8 (m);
+
+  return (vgetq_lane_u64 (m64, 0) | vgetq_lane_u64 (m64, 1)) != 0;
+}
+
+static gint
+scan_start_code_neon (const guint8 * data, guint size)
+{
+  const uint8x16_t zero = vdupq_n_u8 (0);
+  const uint8x16_t one = vdupq_n_u8 (1);
+  guint i = 0;
+
+  while (i + 19 <= size) {
+    uint8x16_t b0 = vld1q_u8 (data + i);
+    uint8x16_t b1 = vld1q_u8 (data + i + 1);
+    uint8x16_t b2 = vld1q_u8 (data + i + 2);
+    uint8x16_t m;
+
+    m = vandq_u8 (vceqq_u8 (b0, zero), vceqq_u8 (b1, zero));
+    m = vandq_u8 (m, vceqq_u8 (b2, one));
+    if (scan_neon_any (m))
+      break;
+    i += 16;
+  }
+
+  return scan_start_code_scalar (data, i, size);
+}
+
+static gint
+scan_jpeg_marker_neon (const guint8 * data, guint size)
+{
+  const uint8x16_t ff = vdupq_n_u8 (0xff);
+  const uint8x16_t c0 = vdupq_n_u8 (0xc0);
+  const uint8x16_t fe = vdupq_n_u8 (0xfe);
+  guint i = 0;
+
+  while (i + 17 <= size) {
+    uint8x16_t b0 = vld1q_u8 (data + i);
+    uint8x16_t b1 = vld1q_u8 (data + i + 1);
+    uint8x16_t m;
+
+    m = vandq_u8 (vcgeq_u8 (b1, c0), vcleq_u8 (b1, fe));
+    m = vandq_u8 (m, vceqq_u8 (b0, ff));
+    if (scan_neon_any (m))
+      break;
+    i += 16;
+  }
+
+  return scan_jpeg_marker_scalar (data, i, size);
+}
+#endif
+
+gint
+scan_for_start_code_prefix (const guint8 * data, guint size)
+{
+#if defined(SCAN_USE_AVX2)
+  if (scan_cpu_features () & GST_CPU_FEATURE_AVX2)
+    return scan_start_code_avx2 (data, size);
+#endif
+
+#if defined(SCAN_USE_SSE2)
+  if (scan_cpu_features () & GST_CPU_FEATURE_SSE2)
+    return scan_start_code_sse2 (data, size);
+#elif defined(SCAN_USE_NEON)
+  return scan_start_code_neon (data, size);
+#endif
+
+  return scan_start_code_scalar (data, 0, size);
+}
+
+gint
+scan_for_jpeg_marker (const guint8 * data, guint size)
+{
+#if defined(SCAN_USE_AVX2)
+  if (scan_cpu_features () & GST_CPU_FEATURE_AVX2)
+    return scan_jpeg_marker_avx2 (data, size);
+#endif
+
+#if defined(SCAN_USE_SSE2)
+  if (scan_cpu_features () & GST_CPU_FEATURE_SSE2)
+    return scan_jpeg_marker_sse2 (data, size);
+#elif defined(SCAN_USE_NEON)
+  return scan_jpeg_marker_neon (data, size);
+#endif
+
+  return scan_jpeg_marker_scalar (data, 0, size);
+}
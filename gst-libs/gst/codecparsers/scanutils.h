@@ -0,0 +1,39 @@
+/* Gstreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * Start code and marker scanning shared by the codec parsers.
+ */
+
+#ifndef __SCAN_UTILS__
+#define __SCAN_UTILS__
+
+#include <gst/gst.h>
+
+/* Returns the offset of the first 0x000001 start code prefix in @data that
+ * is followed by at least one more byte, like a masked scan for 0x000001xx
+ * would, or -1 if there is none */
+G_GNUC_INTERNAL
+gint scan_for_start_code_prefix (const guint8 * data, guint size);
+
+/* Returns the offset of the first JPEG marker in @data, pointing at the last
+ * 0xff before the marker code (so excluding fill bytes), or -1 */
+G_GNUC_INTERNAL
+gint scan_for_jpeg_marker (const guint8 * data, guint size);
+
+#endif /* __SCAN_UTILS__ */
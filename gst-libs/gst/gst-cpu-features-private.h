@@ -0,0 +1,97 @@
+/* GStreamer
+ * Runtime detection of CPU instruction set extensions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_CPU_FEATURES_PRIVATE_H__
+#define __GST_CPU_FEATURES_PRIVATE_H__
+
+#include <glib.h>
+#include <string.h>
+
+G_BEGIN_DECLS
+
+/* Defined if functions for extensions the file is not compiled for can be
+ * built with __attribute__ ((target ("..."))) and selected at runtime */
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define GST_CPU_HAVE_TARGET_ATTRIBUTE 1
+#endif
+
+typedef enum
+{
+  GST_CPU_FEATURE_SSSE3 = (1 << 0),
+  GST_CPU_FEATURE_SSE4_1 = (1 << 1),
+  GST_CPU_FEATURE_AVX2 = (1 << 2),
+  GST_CPU_FEATURE_SSE2 = (1 << 3)
+} GstCpuFeatures;
+
+/* Returns the extensions the CPU supports, minus those named in the
+ * comma separated GST_CPU_FEATURES_DISABLE environment variable ("all"
+ * disables every one of them). The environment is read on every call, so
+ * callers on hot paths cache the result. */
+static inline GstCpuFeatures
+gst_cpu_get_features (void)
+{
+  guint features = 0;
+  const gchar *disable;
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  /* the file is compiled for it, so the CPU has it */
+  features |= GST_CPU_FEATURE_SSE2;
+#endif
+
+#ifdef GST_CPU_HAVE_TARGET_ATTRIBUTE
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2"))
+    features |= GST_CPU_FEATURE_SSE2;
+  if (__builtin_cpu_supports ("ssse3"))
+    features |= GST_CPU_FEATURE_SSSE3;
+  if (__builtin_cpu_supports ("sse4.1"))
+    features |= GST_CPU_FEATURE_SSE4_1;
+  if (__builtin_cpu_supports ("avx2"))
+    features |= GST_CPU_FEATURE_AVX2;
+#endif
+
+  disable = g_getenv ("GST_CPU_FEATURES_DISABLE");
+  if (disable) {
+    gchar **names = g_strsplit (disable, ",", -1);
+    gchar **name;
+
+    for (name = names; *name; name++) {
+      g_strstrip (*name);
+      if (strcmp (*name, "all") == 0)
+        features = 0;
+      else if (strcmp (*name, "sse2") == 0)
+        features &= ~GST_CPU_FEATURE_SSE2;
+      else if (strcmp (*name, "ssse3") == 0)
+        features &= ~GST_CPU_FEATURE_SSSE3;
+      else if (strcmp (*name, "sse4.1") == 0)
+        features &= ~GST_CPU_FEATURE_SSE4_1;
+      else if (strcmp (*name, "avx2") == 0)
+        features &= ~GST_CPU_FEATURE_AVX2;
+    }
+    g_strfreev (names);
+  }
+
+  return (GstCpuFeatures) features;
+}
+
+G_END_DECLS
+
+#endif /* __GST_CPU_FEATURES_PRIVATE_H__ */
@@ -50,6 +50,7 @@ struct _GstFragment
   gchar * name;                 /* Name of the fragment */
   gboolean completed;           /* Whether the fragment is complete or not */
   guint64 download_start_time;  /* Epoch time when the download started */
+  guint64 download_first_buffer_time; /* Epoch time when the first buffer arrived */
   guint64 download_stop_time;   /* Epoch time when the download finished */
   guint64 start_time;           /* Start time of the fragment */
   guint64 stop_time;            /* Stop time of the fragment */
@@ -0,0 +1,1007 @@
+/* GStreamer
+ *
+ * gstfragmentcache.c:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The fragment cache keeps downloaded fragments keyed by URI and byte range.
+ * Entries live in a size limited in-memory LRU and, if a location is set
+ * and the entry was inserted with GST_FRAGMENT_CACHE_FLAG_PERSIST, are also
+ * written to a second size limited LRU on disk. Files on disk survive the
+ * cache object, so a new cache pointed at the same location can serve
+ * fragments fetched by a previous run.
+ *
+ * Each file starts with a small header holding a magic, the expiry time
+ * derived from the Cache-Control/Expires response headers and the redirect
+ * target of the download, followed by the fragment data.
+ *
+ * Files are read and written without holding the lock. Only the rename
+ * that publishes a written file and the unlinks of evicted files are done
+ * with the lock taken, so that the directory always matches the disk LRU. */
+
+#include <string.h>
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gstfragmentcache.h"
+#include "gsturidownloader_debug.h"
+
+#define GST_CAT_DEFAULT uridownloader_debug
+
+#define GST_FRAGMENT_CACHE_GET_PRIVATE(obj)  \
+   (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+    GST_TYPE_FRAGMENT_CACHE, GstFragmentCachePrivate))
+
+#define FILE_MAGIC "GSTFRAG2"
+#define FILE_HEADER_SIZE 24
+#define FILE_FLAG_REDIRECT_PERMANENT (1 << 0)
+#define FILE_SUFFIX ".frag"
+
+#define DEFAULT_MAX_SIZE (32 * 1024 * 1024)
+
+enum
+{
+  PROP_0,
+  PROP_MAX_SIZE,
+  PROP_LOCATION,
+  PROP_MAX_DISK_SIZE,
+  PROP_SIZE,
+  PROP_HITS,
+  PROP_MISSES,
+  PROP_LAST
+};
+
+typedef struct
+{
+  gchar *id;                    /* checksum of the URI and range */
+  GstBuffer *buffer;            /* NULL if the entry is only on disk */
+  gsize size;
+  gint64 expires;               /* real time in microseconds, -1 = never */
+  gchar *redirect_uri;
+  gboolean redirect_permanent;
+  GList *mem_link;              /* link in mem_lru, NULL if not in memory */
+  GList *disk_link;             /* link in disk_lru, NULL if not on disk */
+} GstFragmentCacheEntry;
+
+struct _GstFragmentCachePrivate
+{
+  GMutex lock;
+
+  /* id -> GstFragmentCacheEntry */
+  GHashTable *entries;
+
+  /* most recently used entries at the head */
+  GQueue mem_lru;
+  GQueue disk_lru;
+
+  guint64 max_size;
+  guint64 mem_size;
+
+  gchar *location;
+  guint64 max_disk_size;
+  guint64 disk_size;
+
+  guint64 hits;
+  guint64 misses;
+};
+
+G_DEFINE_TYPE (GstFragmentCache, gst_fragment_cache, GST_TYPE_OBJECT);
+
+static void gst_fragment_cache_finalize (GObject * object);
+
+static void
+gst_fragment_cache_entry_free (GstFragmentCacheEntry * entry)
+{
+  if (entry->buffer)
+    gst_buffer_unref (entry->buffer);
+  g_free (entry->redirect_uri);
+  g_free (entry->id);
+  g_slice_free (GstFragmentCacheEntry, entry);
+}
+
+static void
+gst_fragment_cache_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec)
+{
+  GstFragmentCache *cache = GST_FRAGMENT_CACHE (object);
+
+  switch (property_id) {
+    case PROP_MAX_SIZE:
+      g_mutex_lock (&cache->priv->lock);
+      cache->priv->max_size = g_value_get_uint64 (value);
+      g_mutex_unlock (&cache->priv->lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_fragment_cache_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec)
+{
+  GstFragmentCache *cache = GST_FRAGMENT_CACHE (object);
+  GstFragmentCachePrivate *priv = cache->priv;
+
+  g_mutex_lock (&priv->lock);
+  switch (property_id) {
+    case PROP_MAX_SIZE:
+      g_value_set_uint64 (value, priv->max_size);
+      break;
+    case PROP_LOCATION:
+      g_value_set_string (value, priv->location);
+      break;
+    case PROP_MAX_DISK_SIZE:
+      g_value_set_uint64 (value, priv->max_disk_size);
+      break;
+    case PROP_SIZE:
+      g_value_set_uint64 (value, priv->mem_size);
+      break;
+    case PROP_HITS:
+      g_value_set_uint64 (value, priv->hits);
+      break;
+    case PROP_MISSES:
+      g_value_set_uint64 (value, priv->misses);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+static void
+gst_fragment_cache_class_init (GstFragmentCacheClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (GstFragmentCachePrivate));
+
+  gobject_class->set_property = gst_fragment_cache_set_property;
+  gobject_class->get_property = gst_fragment_cache_get_property;
+  gobject_class->finalize = gst_fragment_cache_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SIZE,
+      g_param_spec_uint64 ("max-size", "Max size",
+          "Maximum number of bytes kept in memory", 0, G_MAXUINT64,
+          DEFAULT_MAX_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "Directory used for the on-disk cache (NULL = memory only)", NULL,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_DISK_SIZE,
+      g_param_spec_uint64 ("max-disk-size", "Max disk size",
+          "Maximum number of bytes kept on disk", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SIZE,
+      g_param_spec_uint64 ("size", "Size",
+          "Number of bytes currently kept in memory", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_HITS,
+      g_param_spec_uint64 ("hits", "Hits",
+          "Number of lookups served from the cache", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MISSES,
+      g_param_spec_uint64 ("misses", "Misses",
+          "Number of lookups not found in the cache", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_fragment_cache_init (GstFragmentCache * cache)
+{
+  GstFragmentCachePrivate *priv;
+
+  cache->priv = priv = GST_FRAGMENT_CACHE_GET_PRIVATE (cache);
+
+  g_mutex_init (&priv->lock);
+  priv->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) gst_fragment_cache_entry_free);
+  g_queue_init (&priv->mem_lru);
+  g_queue_init (&priv->disk_lru);
+  priv->max_size = DEFAULT_MAX_SIZE;
+}
+
+static void
+gst_fragment_cache_finalize (GObject * object)
+{
+  GstFragmentCache *cache = GST_FRAGMENT_CACHE (object);
+  GstFragmentCachePrivate *priv = cache->priv;
+
+  /* files on disk are kept for the next user of the location */
+  g_queue_clear (&priv->mem_lru);
+  g_queue_clear (&priv->disk_lru);
+  g_hash_table_destroy (priv->entries);
+  g_free (priv->location);
+  g_mutex_clear (&priv->lock);
+
+  G_OBJECT_CLASS (gst_fragment_cache_parent_class)->finalize (object);
+}
+
+/**
+ * gst_fragment_cache_new:
+ * @max_size: maximum number of bytes to keep in memory
+ *
+ * Returns: a new #GstFragmentCache
+ */
+GstFragmentCache *
+gst_fragment_cache_new (guint64 max_size)
+{
+  return g_object_new (GST_TYPE_FRAGMENT_CACHE, "max-size", max_size, NULL);
+}
+
+static gchar *
+gst_fragment_cache_make_id (const gchar * uri, gint64 range_start,
+    gint64 range_end)
+{
+  gchar *key, *id;
+
+  key = g_strdup_printf ("%s|%" G_GINT64_FORMAT "-%" G_GINT64_FORMAT, uri,
+      range_start, range_end);
+  id = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  g_free (key);
+
+  return id;
+}
+
+static gchar *
+gst_fragment_cache_get_path (const gchar * location, const gchar * id)
+{
+  gchar *filename, *path;
+
+  filename = g_strconcat (id, FILE_SUFFIX, NULL);
+  path = g_build_filename (location, filename, NULL);
+  g_free (filename);
+
+  return path;
+}
+
+static void
+gst_fragment_cache_remove_from_memory (GstFragmentCachePrivate * priv,
+    GstFragmentCacheEntry * entry)
+{
+  if (entry->mem_link == NULL)
+    return;
+
+  g_queue_delete_link (&priv->mem_lru, entry->mem_link);
+  entry->mem_link = NULL;
+  priv->mem_size -= entry->size;
+  gst_buffer_unref (entry->buffer);
+  entry->buffer = NULL;
+}
+
+static void
+gst_fragment_cache_remove_from_disk (GstFragmentCachePrivate * priv,
+    GstFragmentCacheEntry * entry)
+{
+  gchar *path;
+
+  if (entry->disk_link == NULL)
+    return;
+
+  path = gst_fragment_cache_get_path (priv->location, entry->id);
+  g_unlink (path);
+  g_free (path);
+
+  g_queue_delete_link (&priv->disk_lru, entry->disk_link);
+  entry->disk_link = NULL;
+  priv->disk_size -= entry->size;
+}
+
+static void
+gst_fragment_cache_drop_entry (GstFragmentCachePrivate * priv,
+    GstFragmentCacheEntry * entry)
+{
+  gst_fragment_cache_remove_from_memory (priv, entry);
+  gst_fragment_cache_remove_from_disk (priv, entry);
+  g_hash_table_remove (priv->entries, entry->id);
+}
+
+static void
+gst_fragment_cache_evict (GstFragmentCachePrivate * priv)
+{
+  GstFragmentCacheEntry *entry;
+
+  while (priv->mem_size > priv->max_size && priv->mem_lru.tail) {
+    entry = priv->mem_lru.tail->data;
+    GST_LOG ("Evicting %s from memory", entry->id);
+    gst_fragment_cache_remove_from_memory (priv, entry);
+    if (entry->disk_link == NULL)
+      g_hash_table_remove (priv->entries, entry->id);
+  }
+
+  while (priv->disk_size > priv->max_disk_size && priv->disk_lru.tail) {
+    entry = priv->disk_lru.tail->data;
+    GST_LOG ("Evicting %s from disk", entry->id);
+    gst_fragment_cache_remove_from_disk (priv, entry);
+    if (entry->mem_link == NULL)
+      g_hash_table_remove (priv->entries, entry->id);
+  }
+}
+
+static void
+gst_fragment_cache_touch (GQueue * queue, GList * link)
+{
+  g_queue_unlink (queue, link);
+  g_queue_push_head_link (queue, link);
+}
+
+/* Writes @buffer to a new temporary file in @location and returns its path,
+ * which is renamed to the path of @id once the entry is added */
+static gchar *
+gst_fragment_cache_write_file (const gchar * location, const gchar * id,
+    gint64 expires, const gchar * redirect_uri, gboolean redirect_permanent,
+    GstBuffer * buffer)
+{
+  guint8 header[FILE_HEADER_SIZE];
+  gchar *path, *tmp_path;
+  gsize redirect_len;
+  GstMapInfo map;
+  FILE *file;
+  gint fd;
+
+  path = gst_fragment_cache_get_path (location, id);
+  tmp_path = g_strconcat (path, ".XXXXXX", NULL);
+  g_free (path);
+
+  /* concurrent inserts of the same fragment each get their own file */
+  fd = g_mkstemp (tmp_path);
+  if (fd < 0 || (file = fdopen (fd, "wb")) == NULL) {
+    GST_WARNING ("Could not open %s for writing", tmp_path);
+    if (fd >= 0) {
+      g_close (fd, NULL);
+      g_unlink (tmp_path);
+    }
+    g_free (tmp_path);
+    return NULL;
+  }
+
+  redirect_len = redirect_uri ? strlen (redirect_uri) : 0;
+
+  memcpy (header, FILE_MAGIC, 8);
+  GST_WRITE_UINT64_BE (header + 8, (guint64) expires);
+  GST_WRITE_UINT32_BE (header + 16, redirect_len);
+  GST_WRITE_UINT32_BE (header + 20,
+      redirect_permanent ? FILE_FLAG_REDIRECT_PERMANENT : 0);
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    goto write_failed;
+
+  if (fwrite (header, FILE_HEADER_SIZE, 1, file) != 1 ||
+      (redirect_len > 0 && fwrite (redirect_uri, redirect_len, 1, file) != 1)
+      || (map.size > 0 && fwrite (map.data, map.size, 1, file) != 1)) {
+    gst_buffer_unmap (buffer, &map);
+    goto write_failed;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  if (fclose (file) != 0) {
+    file = NULL;
+    goto write_failed;
+  }
+
+  return tmp_path;
+
+write_failed:
+  GST_WARNING ("Could not write %s", tmp_path);
+  if (file)
+    fclose (file);
+  g_unlink (tmp_path);
+  g_free (tmp_path);
+  return NULL;
+}
+
+/* Parses the header of a cache file, returns the size of the header
+ * including the redirect URI or 0 if the header is invalid */
+static gsize
+gst_fragment_cache_parse_file_header (const guint8 * data, gsize len,
+    gint64 * expires, gchar ** redirect_uri, gboolean * redirect_permanent)
+{
+  guint32 redirect_len;
+
+  if (len < FILE_HEADER_SIZE || memcmp (data, FILE_MAGIC, 8) != 0)
+    return 0;
+
+  redirect_len = GST_READ_UINT32_BE (data + 16);
+  if (redirect_len > len - FILE_HEADER_SIZE)
+    return 0;
+
+  *expires = (gint64) GST_READ_UINT64_BE (data + 8);
+  *redirect_permanent =
+      (GST_READ_UINT32_BE (data + 20) & FILE_FLAG_REDIRECT_PERMANENT) != 0;
+  if (redirect_uri)
+    *redirect_uri = redirect_len ?
+        g_strndup ((const gchar *) data + FILE_HEADER_SIZE, redirect_len) :
+        NULL;
+
+  return FILE_HEADER_SIZE + redirect_len;
+}
+
+static GstBuffer *
+gst_fragment_cache_read_file (const gchar * location, const gchar * id,
+    gint64 * expires, gchar ** redirect_uri, gboolean * redirect_permanent)
+{
+  gchar *path;
+  gchar *data = NULL;
+  gsize len = 0, header_size;
+
+  path = gst_fragment_cache_get_path (location, id);
+  if (!g_file_get_contents (path, &data, &len, NULL)) {
+    g_free (path);
+    return NULL;
+  }
+  g_free (path);
+
+  header_size = gst_fragment_cache_parse_file_header ((const guint8 *) data,
+      len, expires, redirect_uri, redirect_permanent);
+  if (header_size == 0) {
+    GST_WARNING ("Invalid cache file for %s", id);
+    g_free (data);
+    return NULL;
+  }
+
+  return gst_buffer_new_wrapped_full (0, data, len, header_size,
+      len - header_size, data, g_free);
+}
+
+/* Returns a list of disk-only entries for the files found in @location */
+static GList *
+gst_fragment_cache_scan_location (const gchar * location)
+{
+  GList *entries = NULL;
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (location, 0, NULL);
+  if (dir == NULL)
+    return NULL;
+
+  /* entries left by a previous run are added in directory order, their
+   * expiry is only checked when they are read back */
+  while ((name = g_dir_read_name (dir))) {
+    GstFragmentCacheEntry *entry;
+    guint8 header[FILE_HEADER_SIZE];
+    gsize header_size = 0;
+    GStatBuf st;
+    gchar *path;
+    FILE *file;
+
+    if (!g_str_has_suffix (name, FILE_SUFFIX))
+      continue;
+
+    path = g_build_filename (location, name, NULL);
+    file = g_fopen (path, "rb");
+    if (file != NULL) {
+      if (g_stat (path, &st) == 0 &&
+          fread (header, FILE_HEADER_SIZE, 1, file) == 1 &&
+          memcmp (header, FILE_MAGIC, 8) == 0) {
+        header_size = FILE_HEADER_SIZE + GST_READ_UINT32_BE (header + 16);
+        if (header_size > (gsize) st.st_size)
+          header_size = 0;
+      }
+      fclose (file);
+    }
+    g_free (path);
+
+    if (header_size == 0)
+      continue;
+
+    entry = g_slice_new0 (GstFragmentCacheEntry);
+    entry->id = g_strndup (name, strlen (name) - strlen (FILE_SUFFIX));
+    entry->size = st.st_size - header_size;
+    entry->expires = -1;
+    entries = g_list_prepend (entries, entry);
+  }
+  g_dir_close (dir);
+
+  return g_list_reverse (entries);
+}
+
+/**
+ * gst_fragment_cache_set_location:
+ * @cache: the #GstFragmentCache
+ * @location: (allow-none): directory for the on-disk cache, or %NULL
+ * @max_disk_size: maximum number of bytes to keep on disk
+ *
+ * Enables the on-disk cache in @location. Fragments already present in
+ * @location are picked up and can be served by the cache. Passing %NULL
+ * disables the on-disk cache without removing any files.
+ */
+void
+gst_fragment_cache_set_location (GstFragmentCache * cache,
+    const gchar * location, guint64 max_disk_size)
+{
+  GstFragmentCachePrivate *priv;
+  GHashTableIter iter;
+  GList *found = NULL, *l;
+  gpointer value;
+
+  g_return_if_fail (GST_IS_FRAGMENT_CACHE (cache));
+
+  priv = cache->priv;
+
+  if (location != NULL) {
+    if (g_mkdir_with_parents (location, 0755) != 0) {
+      GST_WARNING_OBJECT (cache, "Could not create cache directory %s",
+          location);
+      location = NULL;
+    } else {
+      found = gst_fragment_cache_scan_location (location);
+    }
+  }
+
+  g_mutex_lock (&priv->lock);
+
+  /* forget about the entries of the previous location */
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GstFragmentCacheEntry *entry = value;
+
+    if (entry->disk_link == NULL)
+      continue;
+
+    g_queue_delete_link (&priv->disk_lru, entry->disk_link);
+    entry->disk_link = NULL;
+    if (entry->mem_link == NULL)
+      g_hash_table_iter_remove (&iter);
+  }
+  priv->disk_size = 0;
+
+  g_free (priv->location);
+  priv->location = NULL;
+  priv->max_disk_size = max_disk_size;
+
+  if (location != NULL) {
+    priv->location = g_strdup (location);
+
+    for (l = found; l; l = l->next) {
+      GstFragmentCacheEntry *entry = l->data;
+
+      if (g_hash_table_contains (priv->entries, entry->id)) {
+        gst_fragment_cache_entry_free (entry);
+        continue;
+      }
+
+      g_queue_push_tail (&priv->disk_lru, entry);
+      entry->disk_link = priv->disk_lru.tail;
+      priv->disk_size += entry->size;
+      g_hash_table_insert (priv->entries, entry->id, entry);
+    }
+    g_list_free (found);
+
+    GST_DEBUG_OBJECT (cache, "Found %u cached fragments (%" G_GUINT64_FORMAT
+        " bytes) in %s", priv->disk_lru.length, priv->disk_size, location);
+
+    gst_fragment_cache_evict (priv);
+  }
+
+  g_mutex_unlock (&priv->lock);
+}
+
+static void
+gst_fragment_cache_set_redirect (const gchar * entry_redirect_uri,
+    gboolean entry_redirect_permanent, gchar ** redirect_uri,
+    gboolean * redirect_permanent)
+{
+  if (redirect_uri)
+    *redirect_uri = g_strdup (entry_redirect_uri);
+  if (redirect_permanent)
+    *redirect_permanent = entry_redirect_permanent;
+}
+
+/**
+ * gst_fragment_cache_lookup:
+ * @cache: the #GstFragmentCache
+ * @uri: the uri
+ * @range_start: the starting byte index
+ * @range_end: the final byte index, use -1 for unspecified
+ * @redirect_uri: (out) (transfer full) (allow-none): the redirect target the
+ *     fragment was downloaded from, or %NULL
+ * @redirect_permanent: (out) (allow-none): whether that redirect was permanent
+ *
+ * Looks up the fragment previously inserted for @uri and the given range.
+ * Expired entries are removed and not returned.
+ *
+ * Returns: (transfer full): the cached data or %NULL
+ */
+GstBuffer *
+gst_fragment_cache_lookup (GstFragmentCache * cache, const gchar * uri,
+    gint64 range_start, gint64 range_end, gchar ** redirect_uri,
+    gboolean * redirect_permanent)
+{
+  GstFragmentCachePrivate *priv;
+  GstFragmentCacheEntry *entry;
+  GstBuffer *buffer = NULL;
+  gchar *location = NULL;
+  gchar *file_redirect_uri = NULL;
+  gboolean file_redirect_permanent = FALSE;
+  gint64 now, expires = -1;
+  gchar *id;
+
+  g_return_val_if_fail (GST_IS_FRAGMENT_CACHE (cache), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  if (redirect_uri)
+    *redirect_uri = NULL;
+  if (redirect_permanent)
+    *redirect_permanent = FALSE;
+
+  priv = cache->priv;
+  id = gst_fragment_cache_make_id (uri, range_start, range_end);
+  now = g_get_real_time ();
+
+  g_mutex_lock (&priv->lock);
+  entry = g_hash_table_lookup (priv->entries, id);
+  if (entry && entry->buffer) {
+    if (entry->expires >= 0 && entry->expires <= now) {
+      GST_DEBUG_OBJECT (cache, "Cached %s expired", uri);
+      gst_fragment_cache_drop_entry (priv, entry);
+    } else {
+      buffer = gst_buffer_ref (entry->buffer);
+      gst_fragment_cache_set_redirect (entry->redirect_uri,
+          entry->redirect_permanent, redirect_uri, redirect_permanent);
+      gst_fragment_cache_touch (&priv->mem_lru, entry->mem_link);
+      if (entry->disk_link)
+        gst_fragment_cache_touch (&priv->disk_lru, entry->disk_link);
+    }
+  } else if (entry) {
+    location = g_strdup (priv->location);
+  }
+
+  if (location == NULL)
+    goto done;
+
+  /* only on disk, read it without blocking other users of the cache */
+  g_mutex_unlock (&priv->lock);
+  buffer = gst_fragment_cache_read_file (location, id, &expires,
+      &file_redirect_uri, &file_redirect_permanent);
+  g_mutex_lock (&priv->lock);
+
+  /* the entry might have been dropped, replaced or promoted meanwhile */
+  entry = g_hash_table_lookup (priv->entries, id);
+  if (g_strcmp0 (location, priv->location) != 0)
+    entry = NULL;
+
+  if (buffer == NULL || (expires >= 0 && expires <= now)) {
+    GST_DEBUG_OBJECT (cache, "Cached %s unreadable or expired", uri);
+    if (entry && entry->buffer == NULL)
+      gst_fragment_cache_drop_entry (priv, entry);
+    if (buffer) {
+      gst_buffer_unref (buffer);
+      buffer = NULL;
+    }
+  } else {
+    gst_fragment_cache_set_redirect (file_redirect_uri,
+        file_redirect_permanent, redirect_uri, redirect_permanent);
+
+    if (entry && entry->buffer == NULL && entry->disk_link) {
+      gst_fragment_cache_touch (&priv->disk_lru, entry->disk_link);
+
+      /* promote to the memory cache */
+      entry->expires = expires;
+      g_free (entry->redirect_uri);
+      entry->redirect_uri = file_redirect_uri;
+      entry->redirect_permanent = file_redirect_permanent;
+      file_redirect_uri = NULL;
+      if (entry->size <= priv->max_size) {
+        entry->buffer = gst_buffer_ref (buffer);
+        g_queue_push_head (&priv->mem_lru, entry);
+        entry->mem_link = priv->mem_lru.head;
+        priv->mem_size += entry->size;
+        gst_fragment_cache_evict (priv);
+      }
+    }
+  }
+
+done:
+  if (buffer)
+    priv->hits++;
+  else
+    priv->misses++;
+
+  GST_LOG_OBJECT (cache, "%s %s (range %" G_GINT64_FORMAT "-%"
+      G_GINT64_FORMAT ")", buffer ? "Hit" : "Miss", uri, range_start,
+      range_end);
+  g_mutex_unlock (&priv->lock);
+
+  g_free (file_redirect_uri);
+  g_free (location);
+  g_free (id);
+  return buffer;
+}
+
+static gboolean
+gst_fragment_cache_parse_http_date (const gchar * str, gint64 * time)
+{
+  static const gchar *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+  };
+  gchar month_str[4];
+  gint day, month, year, hour, minute, second;
+  GDateTime *dt;
+
+  /* RFC 7231 IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT" */
+  if (sscanf (str, "%*3s, %d %3s %d %d:%d:%d GMT", &day, month_str, &year,
+          &hour, &minute, &second) != 6)
+    return FALSE;
+
+  for (month = 0; month < 12; month++) {
+    if (g_ascii_strcasecmp (month_str, months[month]) == 0)
+      break;
+  }
+  if (month == 12)
+    return FALSE;
+
+  dt = g_date_time_new_utc (year, month + 1, day, hour, minute, second);
+  if (dt == NULL)
+    return FALSE;
+
+  *time = g_date_time_to_unix (dt) * G_USEC_PER_SEC;
+  g_date_time_unref (dt);
+
+  return TRUE;
+}
+
+static void
+gst_fragment_cache_collect_header (const GValue * value, GString * str)
+{
+  if (G_VALUE_HOLDS_STRING (value)) {
+    if (str->len)
+      g_string_append_c (str, ',');
+    g_string_append (str, g_value_get_string (value));
+  } else if (GST_VALUE_HOLDS_ARRAY (value)) {
+    guint i;
+
+    for (i = 0; i < gst_value_array_get_size (value); i++)
+      gst_fragment_cache_collect_header (gst_value_array_get_value (value, i),
+          str);
+  }
+}
+
+/* Returns FALSE if the response must not be cached, otherwise sets @expires
+ * to the expiry time in microseconds of real time or -1 if none was given */
+static gboolean
+gst_fragment_cache_parse_headers (const GstStructure * headers,
+    gint64 * expires)
+{
+  const GstStructure *response;
+  const GValue *value;
+  GString *cache_control, *expires_str;
+  gint64 max_age = -1;
+  gboolean ret = TRUE;
+  guint i;
+
+  *expires = -1;
+
+  if (headers == NULL)
+    return TRUE;
+
+  value = gst_structure_get_value (headers, "response-headers");
+  if (value == NULL || !GST_VALUE_HOLDS_STRUCTURE (value))
+    return TRUE;
+  response = gst_value_get_structure (value);
+
+  cache_control = g_string_new (NULL);
+  expires_str = g_string_new (NULL);
+  for (i = 0; i < gst_structure_n_fields (response); i++) {
+    const gchar *name = gst_structure_nth_field_name (response, i);
+
+    value = gst_structure_get_value (response, name);
+    if (g_ascii_strcasecmp (name, "Cache-Control") == 0)
+      gst_fragment_cache_collect_header (value, cache_control);
+    else if (g_ascii_strcasecmp (name, "Expires") == 0)
+      gst_fragment_cache_collect_header (value, expires_str);
+  }
+
+  if (cache_control->len) {
+    gchar **directives = g_strsplit (cache_control->str, ",", -1);
+    gchar **d;
+
+    for (d = directives; *d; d++) {
+      gchar *directive = g_strstrip (*d);
+
+      if (g_ascii_strcasecmp (directive, "no-store") == 0 ||
+          g_ascii_strcasecmp (directive, "no-cache") == 0) {
+        ret = FALSE;
+      } else if (g_ascii_strncasecmp (directive, "max-age=", 8) == 0) {
+        max_age = g_ascii_strtoll (directive + 8, NULL, 10);
+      }
+    }
+    g_strfreev (directives);
+  }
+
+  if (ret) {
+    if (max_age >= 0) {
+      *expires = g_get_real_time () + max_age * G_USEC_PER_SEC;
+    } else if (expires_str->len) {
+      /* invalid dates such as "0" mean already expired */
+      if (!gst_fragment_cache_parse_http_date (expires_str->str, expires))
+        ret = FALSE;
+    }
+    if (*expires >= 0 && *expires <= g_get_real_time ())
+      ret = FALSE;
+  }
+
+  g_string_free (cache_control, TRUE);
+  g_string_free (expires_str, TRUE);
+
+  return ret;
+}
+
+/**
+ * gst_fragment_cache_insert:
+ * @cache: the #GstFragmentCache
+ * @uri: the uri
+ * @range_start: the starting byte index
+ * @range_end: the final byte index, use -1 for unspecified
+ * @buffer: the downloaded data
+ * @headers: (allow-none): the "http-headers" structure of the download
+ * @redirect_uri: (allow-none): the redirect target of the download
+ * @redirect_permanent: whether the redirect was permanent
+ * @flags: #GstFragmentCacheFlags
+ *
+ * Stores @buffer for @uri and the given range, replacing any previous entry.
+ * Responses that forbid caching or are already expired according to
+ * @headers are not stored. The entry is only written to the on-disk cache
+ * if @flags contains %GST_FRAGMENT_CACHE_FLAG_PERSIST, so that sensitive
+ * data such as decryption keys never ends up on disk.
+ *
+ * Returns: %TRUE if @buffer was stored
+ */
+gboolean
+gst_fragment_cache_insert (GstFragmentCache * cache, const gchar * uri,
+    gint64 range_start, gint64 range_end, GstBuffer * buffer,
+    const GstStructure * headers, const gchar * redirect_uri,
+    gboolean redirect_permanent, GstFragmentCacheFlags flags)
+{
+  GstFragmentCachePrivate *priv;
+  GstFragmentCacheEntry *entry;
+  gchar *location = NULL, *tmp_path = NULL;
+  gint64 expires;
+  gsize size;
+  gchar *id;
+
+  g_return_val_if_fail (GST_IS_FRAGMENT_CACHE (cache), FALSE);
+  g_return_val_if_fail (uri != NULL, FALSE);
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
+
+  if (!gst_fragment_cache_parse_headers (headers, &expires)) {
+    GST_DEBUG_OBJECT (cache, "Not caching %s", uri);
+    return FALSE;
+  }
+
+  size = gst_buffer_get_size (buffer);
+  if (size == 0)
+    return FALSE;
+
+  priv = cache->priv;
+  id = gst_fragment_cache_make_id (uri, range_start, range_end);
+
+  if (flags & GST_FRAGMENT_CACHE_FLAG_PERSIST) {
+    g_mutex_lock (&priv->lock);
+    if (priv->location && size <= priv->max_disk_size)
+      location = g_strdup (priv->location);
+    g_mutex_unlock (&priv->lock);
+
+    if (location)
+      tmp_path = gst_fragment_cache_write_file (location, id, expires,
+          redirect_uri, redirect_permanent, buffer);
+  }
+
+  g_mutex_lock (&priv->lock);
+  entry = g_hash_table_lookup (priv->entries, id);
+  if (entry)
+    gst_fragment_cache_drop_entry (priv, entry);
+
+  entry = g_slice_new0 (GstFragmentCacheEntry);
+  entry->id = id;
+  entry->size = size;
+  entry->expires = expires;
+  entry->redirect_uri = g_strdup (redirect_uri);
+  entry->redirect_permanent = redirect_permanent;
+
+  if (size <= priv->max_size) {
+    entry->buffer = gst_buffer_ref (buffer);
+    g_queue_push_head (&priv->mem_lru, entry);
+    entry->mem_link = priv->mem_lru.head;
+    priv->mem_size += size;
+  }
+
+  if (tmp_path) {
+    gchar *path = gst_fragment_cache_get_path (location, id);
+
+    /* the location might have changed while the file was written */
+    if (g_strcmp0 (location, priv->location) == 0 &&
+        g_rename (tmp_path, path) == 0) {
+      g_queue_push_head (&priv->disk_lru, entry);
+      entry->disk_link = priv->disk_lru.head;
+      priv->disk_size += size;
+    } else {
+      g_unlink (tmp_path);
+    }
+    g_free (path);
+  }
+
+  if (entry->mem_link == NULL && entry->disk_link == NULL) {
+    gst_fragment_cache_entry_free (entry);
+    g_mutex_unlock (&priv->lock);
+    g_free (tmp_path);
+    g_free (location);
+    return FALSE;
+  }
+
+  GST_LOG_OBJECT (cache, "Cached %s (range %" G_GINT64_FORMAT "-%"
+      G_GINT64_FORMAT ", %" G_GSIZE_FORMAT " bytes%s)", uri, range_start,
+      range_end, size, entry->disk_link ? ", on disk" : "");
+
+  g_hash_table_insert (priv->entries, entry->id, entry);
+  gst_fragment_cache_evict (priv);
+  g_mutex_unlock (&priv->lock);
+
+  g_free (tmp_path);
+  g_free (location);
+
+  return TRUE;
+}
+
+/**
+ * gst_fragment_cache_get_stats:
+ * @cache: the #GstFragmentCache
+ * @hits: (out) (allow-none): number of lookups served from the cache
+ * @misses: (out) (allow-none): number of lookups not found in the cache
+ */
+void
+gst_fragment_cache_get_stats (GstFragmentCache * cache, guint64 * hits,
+    guint64 * misses)
+{
+  g_return_if_fail (GST_IS_FRAGMENT_CACHE (cache));
+
+  g_mutex_lock (&cache->priv->lock);
+  if (hits)
+    *hits = cache->priv->hits;
+  if (misses)
+    *misses = cache->priv->misses;
+  g_mutex_unlock (&cache->priv->lock);
+}
+
+/**
+ * gst_fragment_cache_clear:
+ * @cache: the #GstFragmentCache
+ *
+ * Removes all entries from memory and from disk.
+ */
+void
+gst_fragment_cache_clear (GstFragmentCache * cache)
+{
+  GstFragmentCachePrivate *priv;
+
+  g_return_if_fail (GST_IS_FRAGMENT_CACHE (cache));
+
+  priv = cache->priv;
+  g_mutex_lock (&priv->lock);
+  while (priv->mem_lru.head)
+    gst_fragment_cache_drop_entry (priv, priv->mem_lru.head->data);
+  while (priv->disk_lru.head)
+    gst_fragment_cache_drop_entry (priv, priv->disk_lru.head->data);
+  g_mutex_unlock (&priv->lock);
+}
@@ -0,0 +1,75 @@
+/* GStreamer
+ *
+ * gstfragmentcache.h:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GSTFRAGMENT_CACHE_H__
+#define __GSTFRAGMENT_CACHE_H__
+
+#include <glib-object.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_FRAGMENT_CACHE (gst_fragment_cache_get_type())
+#define GST_FRAGMENT_CACHE(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_FRAGMENT_CACHE,GstFragmentCache))
+#define GST_FRAGMENT_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_FRAGMENT_CACHE,GstFragmentCacheClass))
+#define GST_IS_FRAGMENT_CACHE(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_FRAGMENT_CACHE))
+#define GST_IS_FRAGMENT_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_FRAGMENT_CACHE))
+
+/**
+ * GstFragmentCacheFlags:
+ * @GST_FRAGMENT_CACHE_FLAG_NONE: keep the entry in memory only
+ * @GST_FRAGMENT_CACHE_FLAG_PERSIST: also write the entry to the on-disk cache
+ *     if a location is set
+ */
+typedef enum {
+  GST_FRAGMENT_CACHE_FLAG_NONE = 0,
+  GST_FRAGMENT_CACHE_FLAG_PERSIST = (1 << 0)
+} GstFragmentCacheFlags;
+
+typedef struct _GstFragmentCache GstFragmentCache;
+typedef struct _GstFragmentCachePrivate GstFragmentCachePrivate;
+typedef struct _GstFragmentCacheClass GstFragmentCacheClass;
+
+struct _GstFragmentCache
+{
+  GstObject parent;
+
+  GstFragmentCachePrivate *priv;
+};
+
+struct _GstFragmentCacheClass
+{
+  GstObjectClass parent_class;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GType gst_fragment_cache_get_type (void);
+
+GstFragmentCache * gst_fragment_cache_new (guint64 max_size);
+void gst_fragment_cache_set_location (GstFragmentCache * cache, const gchar * location, guint64 max_disk_size);
+GstBuffer * gst_fragment_cache_lookup (GstFragmentCache * cache, const gchar * uri, gint64 range_start, gint64 range_end, gchar ** redirect_uri, gboolean * redirect_permanent);
+gboolean gst_fragment_cache_insert (GstFragmentCache * cache, const gchar * uri, gint64 range_start, gint64 range_end, GstBuffer * buffer, const GstStructure * headers, const gchar * redirect_uri, gboolean redirect_permanent, GstFragmentCacheFlags flags);
+void gst_fragment_cache_get_stats (GstFragmentCache * cache, guint64 * hits, guint64 * misses);
+void gst_fragment_cache_clear (GstFragmentCache * cache);
+
+G_END_DECLS
+#endif /* __GSTFRAGMENT_CACHE_H__ */
@@ -31,10 +31,20 @@ GST_DEBUG_CATEGORY (uridownloader_debug);
    (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
     GST_TYPE_URI_DOWNLOADER, GstUriDownloaderPrivate))
 
+/* Maximum number of idle source elements kept around */
+#define MAX_SOURCES 4
+
+typedef struct
+{
+  gchar *key;
+  GstElement *src;
+} GstUriDownloaderSource;
+
 struct _GstUriDownloaderPrivate
 {
   /* Fragments fetcher */
-  GstElement *urisrc;
+  GstElement *urisrc;           /* source in use, owned by sources */
+  GQueue sources;               /* GstUriDownloaderSource, MRU first */
   GstBus *bus;
   GstPad *pad;
   GTimeVal *timeout;
@@ -46,6 +56,8 @@ struct _GstUriDownloaderPrivate
 
   GCond cond;
   gboolean cancelled;
+
+  GstFragmentCache *cache;
 };
 
 static void gst_uri_downloader_finalize (GObject * object);
@@ -57,6 +69,7 @@ static gboolean gst_uri_downloader_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 static GstBusSyncReply gst_uri_downloader_bus_handler (GstBus * bus,
     GstMessage * message, gpointer data);
+static void gst_uri_downloader_source_free (GstUriDownloaderSource * source);
 
 static GstStaticPadTemplate sinkpadtemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -103,6 +116,8 @@ gst_uri_downloader_init (GstUriDownloader * downloader)
   /* Create a bus to handle error and warning message from the source element */
   downloader->priv->bus = gst_bus_new ();
 
+  g_queue_init (&downloader->priv->sources);
+
   g_mutex_init (&downloader->priv->download_lock);
   g_cond_init (&downloader->priv->cond);
 }
@@ -112,11 +127,10 @@ gst_uri_downloader_dispose (GObject * object)
 {
   GstUriDownloader *downloader = GST_URI_DOWNLOADER (object);
 
-  if (downloader->priv->urisrc != NULL) {
-    gst_element_set_state (downloader->priv->urisrc, GST_STATE_NULL);
-    gst_object_unref (downloader->priv->urisrc);
-    downloader->priv->urisrc = NULL;
-  }
+  g_queue_foreach (&downloader->priv->sources,
+      (GFunc) gst_uri_downloader_source_free, NULL);
+  g_queue_clear (&downloader->priv->sources);
+  downloader->priv->urisrc = NULL;
 
   if (downloader->priv->bus != NULL) {
     gst_object_unref (downloader->priv->bus);
@@ -133,6 +147,11 @@ gst_uri_downloader_dispose (GObject * object)
     downloader->priv->download = NULL;
   }
 
+  if (downloader->priv->cache) {
+    gst_object_unref (downloader->priv->cache);
+    downloader->priv->cache = NULL;
+  }
+
   G_OBJECT_CLASS (gst_uri_downloader_parent_class)->dispose (object);
 }
 
@@ -282,7 +301,11 @@ gst_uri_downloader_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 
   GST_LOG_OBJECT (downloader, "The uri fetcher received a new buffer "
       "of size %" G_GSIZE_FORMAT, gst_buffer_get_size (buf));
-  downloader->priv->got_buffer = TRUE;
+  if (!downloader->priv->got_buffer) {
+    downloader->priv->download->download_first_buffer_time =
+        gst_util_get_timestamp ();
+    downloader->priv->got_buffer = TRUE;
+  }
   if (!gst_fragment_add_buffer (downloader->priv->download, buf)) {
     GST_WARNING_OBJECT (downloader, "Could not add buffer to fragment");
     gst_buffer_unref (buf);
@@ -328,14 +351,59 @@ gst_uri_downloader_cancel (GstUriDownloader * downloader)
   GST_OBJECT_UNLOCK (downloader);
 }
 
+/**
+ * gst_uri_downloader_set_cache:
+ * @downloader: the #GstUriDownloader
+ * @cache: (allow-none): the #GstFragmentCache to use or %NULL
+ *
+ * Sets the cache used to serve and store the fetched URIs. Fetches that
+ * don't allow caching or request a refresh bypass the cache. Fetched URIs
+ * are only kept in memory, as they include decryption keys which must not
+ * be written to the on-disk cache.
+ */
+void
+gst_uri_downloader_set_cache (GstUriDownloader * downloader,
+    GstFragmentCache * cache)
+{
+  g_return_if_fail (downloader != NULL);
+
+  GST_OBJECT_LOCK (downloader);
+  gst_object_replace ((GstObject **) & downloader->priv->cache,
+      (GstObject *) cache);
+  GST_OBJECT_UNLOCK (downloader);
+}
+
+/**
+ * gst_uri_downloader_get_cache:
+ * @downloader: the #GstUriDownloader
+ *
+ * Returns: (transfer full): the #GstFragmentCache in use or %NULL
+ */
+GstFragmentCache *
+gst_uri_downloader_get_cache (GstUriDownloader * downloader)
+{
+  GstFragmentCache *cache = NULL;
+
+  g_return_val_if_fail (downloader != NULL, NULL);
+
+  GST_OBJECT_LOCK (downloader);
+  if (downloader->priv->cache)
+    cache = gst_object_ref (downloader->priv->cache);
+  GST_OBJECT_UNLOCK (downloader);
+
+  return cache;
+}
+
+/* A source that is already running needs the seek even without a range, as
+ * that is what makes it issue a new request */
 static gboolean
 gst_uri_downloader_set_range (GstUriDownloader * downloader,
-    gint64 range_start, gint64 range_end)
+    gint64 range_start, gint64 range_end, gboolean running)
 {
   g_return_val_if_fail (range_start >= 0, FALSE);
   g_return_val_if_fail (range_end >= -1, FALSE);
 
-  if (range_start || (range_end >= 0)) {
+  if (running || range_start || (range_end >= 0)) {
     GstEvent *seek;
 
     seek = gst_event_new_seek (1.0, GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH,
@@ -346,58 +414,133 @@ gst_uri_downloader_set_range (GstUriDownloader * downloader,
   return TRUE;
 }
 
+static void
+gst_uri_downloader_source_free (GstUriDownloaderSource * source)
+{
+  gst_element_set_state (source->src, GST_STATE_NULL);
+  gst_object_unref (source->src);
+  g_free (source->key);
+  g_slice_free (GstUriDownloaderSource, source);
+}
+
+/* Source elements are kept per scheme, host and port so that switching
+ * between servers (e.g. a key server and a CDN) doesn't recreate and
+ * reconfigure the element every time. After a successful fetch the source
+ * is left in PLAYING, so HTTP sources keep their session and connections
+ * open, and the next fetch only changes the uri and seeks to issue a new
+ * request on the same connection */
+static gchar *
+gst_uri_downloader_get_source_key (const gchar * uri)
+{
+  GstUri *gst_uri;
+  gchar *key;
+
+  gst_uri = gst_uri_from_string (uri);
+  if (gst_uri == NULL)
+    return gst_uri_get_protocol (uri);
+
+  key = g_strdup_printf ("%s://%s:%u", GST_STR_NULL (gst_uri_get_scheme
+          (gst_uri)), GST_STR_NULL (gst_uri_get_host (gst_uri)),
+      gst_uri_get_port (gst_uri));
+  gst_uri_unref (gst_uri);
+
+  return key;
+}
+
+/* Removes and returns the source element kept for @key, or NULL */
+static GstUriDownloaderSource *
+gst_uri_downloader_take_source (GstUriDownloader * downloader,
+    const gchar * key)
+{
+  GList *l;
+
+  for (l = downloader->priv->sources.head; l; l = l->next) {
+    GstUriDownloaderSource *source = l->data;
+
+    if (g_str_equal (source->key, key)) {
+      g_queue_delete_link (&downloader->priv->sources, l);
+      return source;
+    }
+  }
+
+  return NULL;
+}
+
+/* Adds @source as the most recently used one, dropping the least recently
+ * used sources above MAX_SOURCES */
+static void
+gst_uri_downloader_put_source (GstUriDownloader * downloader,
+    GstUriDownloaderSource * source)
+{
+  g_queue_push_head (&downloader->priv->sources, source);
+
+  while (downloader->priv->sources.length > MAX_SOURCES) {
+    GstUriDownloaderSource *old = g_queue_pop_tail (&downloader->priv->sources);
+
+    GST_DEBUG_OBJECT (downloader, "Dropping source element for %s", old->key);
+    gst_uri_downloader_source_free (old);
+  }
+}
+
 static gboolean
 gst_uri_downloader_set_uri (GstUriDownloader * downloader, const gchar * uri,
     const gchar * referer, gboolean compress, gboolean refresh,
     gboolean allow_cache)
 {
+  GstUriDownloaderSource *source;
   GstPad *pad;
   GObjectClass *gobject_class;
+  gchar *key;
 
   if (!gst_uri_is_valid (uri))
     return FALSE;
 
-  if (downloader->priv->urisrc) {
-    gchar *old_protocol, *new_protocol;
-    gchar *old_uri;
+  key = gst_uri_downloader_get_source_key (uri);
+  source = gst_uri_downloader_take_source (downloader, key);
 
-    old_uri =
-        gst_uri_handler_get_uri (GST_URI_HANDLER (downloader->priv->urisrc));
-    old_protocol = gst_uri_get_protocol (old_uri);
-    new_protocol = gst_uri_get_protocol (uri);
-
-    if (!g_str_equal (old_protocol, new_protocol)) {
-      gst_element_set_state (downloader->priv->urisrc, GST_STATE_NULL);
-      gst_object_unref (downloader->priv->urisrc);
-      downloader->priv->urisrc = NULL;
-      GST_DEBUG_OBJECT (downloader, "Can't re-use old source element");
-    } else {
-      GError *err = NULL;
+  if (source) {
+    GError *err = NULL;
 
-      GST_DEBUG_OBJECT (downloader, "Re-using old source element");
-      if (!gst_uri_handler_set_uri (GST_URI_HANDLER (downloader->priv->urisrc),
-              uri, &err)) {
-        GST_DEBUG_OBJECT (downloader, "Failed to re-use old source element: %s",
-            err->message);
+    GST_DEBUG_OBJECT (downloader, "Re-using source element for %s", key);
+    if (!gst_uri_handler_set_uri (GST_URI_HANDLER (source->src), uri, &err)) {
+      /* some sources only accept a new uri while stopped. The source is
+       * unlinked and has no bus at this point, so stopping it can't call
+       * back into the downloader */
+      GST_DEBUG_OBJECT (downloader, "Stopping source element to set uri: %s",
+          err->message);
+      g_clear_error (&err);
+      gst_element_set_state (source->src, GST_STATE_READY);
+      if (!gst_uri_handler_set_uri (GST_URI_HANDLER (source->src), uri, &err)) {
+        GST_DEBUG_OBJECT (downloader,
+            "Failed to re-use old source element: %s", err->message);
         g_clear_error (&err);
-        gst_element_set_state (downloader->priv->urisrc, GST_STATE_NULL);
-        gst_object_unref (downloader->priv->urisrc);
-        downloader->priv->urisrc = NULL;
+        gst_uri_downloader_source_free (source);
+        source = NULL;
       }
     }
-    g_free (old_uri);
-    g_free (old_protocol);
-    g_free (new_protocol);
   }
 
-  if (!downloader->priv->urisrc) {
+  if (!source) {
+    GstElement *src;
+
     GST_DEBUG_OBJECT (downloader, "Creating source element for the URI:%s",
         uri);
-    downloader->priv->urisrc =
-        gst_element_make_from_uri (GST_URI_SRC, uri, NULL, NULL);
-    if (!downloader->priv->urisrc)
+    src = gst_element_make_from_uri (GST_URI_SRC, uri, NULL, NULL);
+    if (!src) {
+      g_free (key);
+      downloader->priv->urisrc = NULL;
       return FALSE;
+    }
+
+    source = g_slice_new (GstUriDownloaderSource);
+    source->key = key;
+    source->src = src;
+    key = NULL;
   }
+  g_free (key);
+
+  gst_uri_downloader_put_source (downloader, source);
+  downloader->priv->urisrc = source->src;
 
   gobject_class = G_OBJECT_GET_CLASS (downloader->priv->urisrc);
   if (g_object_class_find_property (gobject_class, "compress"))
@@ -484,7 +627,11 @@ gst_uri_downloader_fetch_uri_with_range (GstUriDownloader *
     gint64 range_start, gint64 range_end, GError ** err)
 {
   GstStateChangeReturn ret;
+  GstState state;
   GstFragment *download = NULL;
+  GstFragmentCache *cache = NULL;
+  gboolean cached = FALSE;
+  gboolean running;
 
   GST_DEBUG_OBJECT (downloader, "Fetching URI %s", uri);
 
@@ -498,6 +645,43 @@ gst_uri_downloader_fetch_uri_with_range (GstUriDownloader *
     goto quit;
   }
 
+  /* HEAD requests and refreshes always go to the server */
+  if (downloader->priv->cache && allow_cache && !refresh &&
+      (range_start >= 0 || range_end >= 0))
+    cache = gst_object_ref (downloader->priv->cache);
+
+  if (cache) {
+    GstBuffer *buffer;
+
+    /* the cache might read from disk, don't block cancellation meanwhile */
+    GST_OBJECT_UNLOCK (downloader);
+    download = gst_fragment_new ();
+    buffer = gst_fragment_cache_lookup (cache, uri, range_start, range_end,
+        &download->redirect_uri, &download->redirect_permanent);
+    GST_OBJECT_LOCK (downloader);
+
+    if (buffer) {
+      GST_DEBUG_OBJECT (downloader, "Serving %s from the cache", uri);
+      download->uri = g_strdup (uri);
+      download->range_start = range_start;
+      download->range_end = range_end;
+      gst_fragment_add_buffer (download, buffer);
+      download->completed = TRUE;
+      download->download_first_buffer_time = download->download_start_time;
+      download->download_stop_time = download->download_start_time;
+      cached = TRUE;
+      goto quit;
+    }
+
+    g_object_unref (download);
+    download = NULL;
+
+    if (downloader->priv->cancelled) {
+      GST_DEBUG_OBJECT (downloader, "Cancelled, aborting fetch");
+      goto quit;
+    }
+  }
+
   if (!gst_uri_downloader_set_uri (downloader, uri, referer, compress, refresh,
           allow_cache)) {
     GST_WARNING_OBJECT (downloader, "Failed to set URI");
@@ -511,7 +695,12 @@ gst_uri_downloader_fetch_uri_with_range (GstUriDownloader *
   downloader->priv->download->range_start = range_start;
   downloader->priv->download->range_end = range_end;
   GST_OBJECT_UNLOCK (downloader);
-  ret = gst_element_set_state (downloader->priv->urisrc, GST_STATE_READY);
+  gst_element_get_state (downloader->priv->urisrc, &state, NULL, 0);
+  running = state >= GST_STATE_PAUSED;
+  if (!running)
+    ret = gst_element_set_state (downloader->priv->urisrc, GST_STATE_READY);
+  else
+    ret = GST_STATE_CHANGE_SUCCESS;
   GST_OBJECT_LOCK (downloader);
   if (ret == GST_STATE_CHANGE_FAILURE || downloader->priv->download == NULL) {
     GST_WARNING_OBJECT (downloader, "Failed to set src to READY");
@@ -529,14 +718,21 @@ gst_uri_downloader_fetch_uri_with_range (GstUriDownloader *
       goto quit;
     }
   } else {
-    if (!gst_uri_downloader_set_range (downloader, range_start, range_end)) {
-      GST_WARNING_OBJECT (downloader, "Failed to set range");
-      goto quit;
-    }
+    /* the source might have been used for a HEAD request before */
+    gst_uri_downloader_set_method (downloader, "GET");
   }
 
+  /* a running source pushes buffers as soon as it is seeked, which ends up
+   * in the chain function */
   GST_OBJECT_UNLOCK (downloader);
-  ret = gst_element_set_state (downloader->priv->urisrc, GST_STATE_PLAYING);
+  if (!gst_uri_downloader_set_range (downloader, MAX (range_start, 0),
+          range_end, running)) {
+    GST_OBJECT_LOCK (downloader);
+    GST_WARNING_OBJECT (downloader, "Failed to set range");
+    goto quit;
+  }
+  if (!running)
+    ret = gst_element_set_state (downloader->priv->urisrc, GST_STATE_PLAYING);
   GST_OBJECT_LOCK (downloader);
   if (ret == GST_STATE_CHANGE_FAILURE) {
     if (downloader->priv->download) {
@@ -580,14 +776,22 @@ gst_uri_downloader_fetch_uri_with_range (GstUriDownloader *
     }
   }
 
-  if (download != NULL)
+  if (download != NULL) {
     GST_INFO_OBJECT (downloader, "URI fetched successfully");
-  else
+    if (download->download_first_buffer_time) {
+      GST_DEBUG_OBJECT (downloader, "First byte after %" GST_TIME_FORMAT
+          ", transfer took %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (download->download_first_buffer_time -
+              download->download_start_time),
+          GST_TIME_ARGS (download->download_stop_time -
+              download->download_first_buffer_time));
+    }
+  } else
     GST_INFO_OBJECT (downloader, "Error fetching URI");
 
 quit:
   {
-    if (downloader->priv->urisrc) {
+    if (downloader->priv->urisrc && !cached) {
       GstPad *pad;
       GstElement *urisrc;
 
@@ -600,7 +804,7 @@ quit:
       gst_bus_set_sync_handler (downloader->priv->bus, NULL, NULL, NULL);
       gst_bus_set_flushing (downloader->priv->bus, TRUE);
 
-      /* set the element state to NULL */
+      /* on failure set the element state to NULL */
       GST_OBJECT_UNLOCK (downloader);
       if (download == NULL) {
         gst_element_set_state (urisrc, GST_STATE_NULL);
@@ -616,7 +820,7 @@ quit:
               &download->redirect_permanent);
         }
         gst_query_unref (query);
-        gst_element_set_state (urisrc, GST_STATE_READY);
+        /* keep the source running for the next fetch from this host */
       }
       GST_OBJECT_LOCK (downloader);
       gst_element_set_bus (urisrc, NULL);
@@ -630,6 +834,18 @@ quit:
     }
     GST_OBJECT_UNLOCK (downloader);
 
+    if (cache) {
+      if (download != NULL && !cached && downloader->priv->got_buffer) {
+        GstBuffer *buffer = gst_fragment_get_buffer (download);
+
+        gst_fragment_cache_insert (cache, uri, range_start, range_end, buffer,
+            download->headers, download->redirect_uri,
+            download->redirect_permanent, GST_FRAGMENT_CACHE_FLAG_NONE);
+        gst_buffer_unref (buffer);
+      }
+      gst_object_unref (cache);
+    }
+
     if (download == NULL) {
       if (!downloader->priv->err) {
         g_set_error (err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_OPEN_READ,
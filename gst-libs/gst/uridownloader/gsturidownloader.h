@@ -30,6 +30,7 @@
 #include <glib-object.h>
 #include <gst/gst.h>
 #include "gstfragment.h"
+#include "gstfragmentcache.h"
 
 G_BEGIN_DECLS
 
@@ -66,6 +67,8 @@ GstFragment * gst_uri_downloader_fetch_uri_with_range (GstUriDownloader * downlo
 void gst_uri_downloader_reset (GstUriDownloader *downloader);
 void gst_uri_downloader_cancel (GstUriDownloader *downloader);
 void gst_uri_downloader_free (GstUriDownloader *downloader);
+void gst_uri_downloader_set_cache (GstUriDownloader * downloader, GstFragmentCache * cache);
+GstFragmentCache * gst_uri_downloader_get_cache (GstUriDownloader * downloader);
 
 G_END_DECLS
 #endif /* __GSTURIDOWNLOADER_H__ */
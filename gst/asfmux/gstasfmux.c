@@ -90,7 +90,8 @@ enum
   PROP_PREROLL,
   PROP_MERGE_STREAM_TAGS,
   PROP_PADDING,
-  PROP_STREAMABLE
+  PROP_STREAMABLE,
+  PROP_COPY_PACKETS
 };
 
 /* Stores a tag list for the available/known tags
@@ -128,6 +129,13 @@ typedef GstAsfExtContDescData GstAsfMetadataObjData;
 #define DEFAULT_MERGE_STREAM_TAGS TRUE
 #define DEFAULT_PADDING 0
 #define DEFAULT_STREAMABLE FALSE
+#define DEFAULT_COPY_PACKETS FALSE
+
+/* number of data packets that fit in a buffer of the packet pool */
+#define ASF_PACKETS_PER_POOL_BUFFER 8
+/* payloads smaller than this are copied into the packet, larger
+ * ones are referenced */
+#define ASF_MIN_REFERENCED_PAYLOAD_SIZE 256
 
 static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
@@ -168,6 +176,8 @@ static void gst_asf_mux_pad_reset (GstAsfPad * data);
 static GstFlowReturn gst_asf_mux_collected (GstCollectPads * collect,
     gpointer data);
 
+static void gst_asf_mux_stop_packet_pool (GstAsfMux * asfmux);
+
 static GstElementClass *parent_class = NULL;
 
 G_DEFINE_TYPE_WITH_CODE (GstAsfMux, gst_asf_mux, GST_TYPE_ELEMENT,
@@ -197,6 +207,8 @@ gst_asf_mux_reset (GstAsfMux * asfmux)
   asfmux->payloads = NULL;
   asfmux->payload_data_size = 0;
 
+  gst_asf_mux_stop_packet_pool (asfmux);
+
   asfmux->file_id.v1 = 0;
   asfmux->file_id.v2 = 0;
   asfmux->file_id.v3 = 0;
@@ -265,6 +277,13 @@ gst_asf_mux_class_init (GstAsfMuxClass * klass)
           "and hence no indexes written or duration written.",
           DEFAULT_STREAMABLE,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_COPY_PACKETS,
+      g_param_spec_boolean ("copy-packets", "Copy packets",
+          "If set to true, every data packet is allocated on its own with all "
+          "payloads copied into it, and pushed separately instead of in a "
+          "buffer list. This is slower and only meant for comparisons.",
+          DEFAULT_COPY_PACKETS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->request_new_pad =
       GST_DEBUG_FUNCPTR (gst_asf_mux_request_new_pad);
@@ -306,6 +325,7 @@ gst_asf_mux_init (GstAsfMux * asfmux)
   asfmux->prop_merge_stream_tags = DEFAULT_MERGE_STREAM_TAGS;
   asfmux->prop_padding = DEFAULT_PADDING;
   asfmux->prop_streamable = DEFAULT_STREAMABLE;
+  asfmux->prop_copy_packets = DEFAULT_COPY_PACKETS;
   gst_asf_mux_reset (asfmux);
 }
 
@@ -1425,27 +1445,205 @@ gst_asf_mux_add_simple_index_entry (GstAsfMux * asfmux,
   videopad->simple_index = g_slist_append (videopad->simple_index, entry);
 }
 
+static void
+gst_asf_mux_start_packet_pool (GstAsfMux * asfmux)
+{
+  GstStructure *config;
+
+  asfmux->packet_pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (asfmux->packet_pool);
+  gst_buffer_pool_config_set_params (config, NULL,
+      asfmux->packet_size * ASF_PACKETS_PER_POOL_BUFFER, 0, 0);
+  gst_buffer_pool_set_config (asfmux->packet_pool, config);
+  gst_buffer_pool_set_active (asfmux->packet_pool, TRUE);
+}
+
+static void
+gst_asf_mux_release_pool_buffer (GstAsfMux * asfmux)
+{
+  if (asfmux->pool_buffer == NULL)
+    return;
+
+  gst_buffer_unmap (asfmux->pool_buffer, &asfmux->pool_map);
+  gst_buffer_unref (asfmux->pool_buffer);
+  asfmux->pool_buffer = NULL;
+}
+
+static void
+gst_asf_mux_stop_packet_pool (GstAsfMux * asfmux)
+{
+  if (asfmux->packets) {
+    gst_buffer_list_unref (asfmux->packets);
+    asfmux->packets = NULL;
+  }
+
+  gst_asf_mux_release_pool_buffer (asfmux);
+
+  if (asfmux->packet_pool) {
+    /* buffers still used downstream are freed when they are released */
+    gst_buffer_pool_set_active (asfmux->packet_pool, FALSE);
+    gst_object_unref (asfmux->packet_pool);
+    asfmux->packet_pool = NULL;
+  }
+}
+
 /**
- * gst_asf_mux_send_packet:
+ * gst_asf_mux_reserve_packet:
  * @asfmux:
- * @buf: The asf data packet
  *
- * Pushes an asf data packet downstream. The total number
- * of packets and bytes of the stream are incremented.
+ * Makes sure a whole data packet can be writen to the current
+ * buffer of the packet pool, acquiring a new one if needed.
+ *
+ * Returns: where the packet starts in the pool buffer, or NULL
+ * if no buffer could be acquired
+ */
+static guint8 *
+gst_asf_mux_reserve_packet (GstAsfMux * asfmux)
+{
+  GstBuffer *buf = NULL;
+
+  if (asfmux->pool_buffer != NULL &&
+      asfmux->pool_offset + asfmux->packet_size <= asfmux->pool_map.size)
+    return asfmux->pool_map.data + asfmux->pool_offset;
+
+  gst_asf_mux_release_pool_buffer (asfmux);
+
+  if (asfmux->copy_packets) {
+    /* a buffer of a single packet, not reused */
+    buf = gst_buffer_new_allocate (NULL, asfmux->packet_size, NULL);
+  } else if (asfmux->packet_pool == NULL ||
+      gst_buffer_pool_acquire_buffer (asfmux->packet_pool, &buf,
+          NULL) != GST_FLOW_OK) {
+    return NULL;
+  }
+
+  /* the buffer stays mapped until it is full, the packets only
+   * reference its memory */
+  asfmux->pool_buffer = buf;
+  gst_buffer_map (buf, &asfmux->pool_map, GST_MAP_WRITE);
+  asfmux->pool_offset = 0;
+
+  return asfmux->pool_map.data;
+}
+
+/**
+ * gst_asf_mux_add_pool_memory:
+ * @asfmux:
+ * @packet: the data packet
+ * @data: start of the bytes in the current pool buffer
+ * @size: number of bytes
+ *
+ * Appends a memory referencing @size bytes of the current pool
+ * buffer to @packet. The pool buffer is returned to the pool once
+ * all the packets using it are released.
+ */
+static void
+gst_asf_mux_add_pool_memory (GstAsfMux * asfmux, GstBuffer * packet,
+    guint8 * data, gsize size)
+{
+  if (size == 0)
+    return;
+
+  gst_buffer_append_memory (packet,
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, data, size, 0, size,
+          gst_buffer_ref (asfmux->pool_buffer),
+          (GDestroyNotify) gst_buffer_unref));
+}
+
+/**
+ * gst_asf_mux_add_payload_data:
+ * @asfmux:
+ * @packet: the data packet
+ * @start: start of the bytes writen to the pool buffer for this
+ *     packet that are not in @packet yet
+ * @pos: current write position in the pool buffer
+ * @data: payload data
+ * @size: number of bytes of @data to add
+ *
+ * Adds the first @size bytes of @data to the packet. Large payloads
+ * are referenced, after the bytes writen so far to the pool buffer,
+ * as long as the packet doesn't need more memory blocks than a buffer
+ * can hold. Otherwise they are copied to the pool buffer.
+ */
+static void
+gst_asf_mux_add_payload_data (GstAsfMux * asfmux, GstBuffer * packet,
+    guint8 ** start, guint8 ** pos, GstBuffer * data, gsize size)
+{
+  if (!asfmux->copy_packets && size >= ASF_MIN_REFERENCED_PAYLOAD_SIZE &&
+      gst_buffer_n_memory (packet) + gst_buffer_n_memory (data) + 2 <=
+      gst_buffer_get_max_memory ()) {
+    gst_asf_mux_add_pool_memory (asfmux, packet, *start, *pos - *start);
+    gst_buffer_copy_into (packet, data, GST_BUFFER_COPY_MEMORY, 0, size);
+    *start = *pos;
+  } else {
+    gst_buffer_extract (data, 0, *pos, size);
+    *pos += size;
+  }
+}
+
+/**
+ * gst_asf_mux_push_packets:
+ * @asfmux:
+ *
+ * Pushes the pending data packets downstream as a buffer list
+ * and adds their size to the total file size.
  *
- * Returns: the result of pushing the buffer downstream
+ * Returns: the result of pushing the list downstream
  */
 static GstFlowReturn
+gst_asf_mux_push_packets (GstAsfMux * asfmux)
+{
+  GstFlowReturn ret;
+  guint n;
+
+  if (asfmux->packets == NULL)
+    return GST_FLOW_OK;
+
+  n = gst_buffer_list_length (asfmux->packets);
+  GST_LOG_OBJECT (asfmux, "Pushing %u data packets", n);
+
+  if (asfmux->copy_packets) {
+    guint i;
+
+    ret = GST_FLOW_OK;
+    for (i = 0; i < n && ret == GST_FLOW_OK; i++)
+      ret = gst_pad_push (asfmux->srcpad,
+          gst_buffer_ref (gst_buffer_list_get (asfmux->packets, i)));
+    gst_buffer_list_unref (asfmux->packets);
+  } else {
+    ret = gst_pad_push_list (asfmux->srcpad, asfmux->packets);
+  }
+  asfmux->packets = NULL;
+
+  if (ret == GST_FLOW_OK)
+    asfmux->file_size += (guint64) n * asfmux->packet_size;
+
+  return ret;
+}
+
+/**
+ * gst_asf_mux_send_packet:
+ * @asfmux:
+ * @buf: The asf data packet
+ *
+ * Queues an asf data packet to be pushed downstream with
+ * #gst_asf_mux_push_packets. The total number of packets
+ * is incremented.
+ */
+static void
 gst_asf_mux_send_packet (GstAsfMux * asfmux, GstBuffer * buf, gsize bufsize)
 {
   g_assert (bufsize == asfmux->packet_size);
   asfmux->total_data_packets++;
   GST_LOG_OBJECT (asfmux,
-      "Pushing a packet of size %" G_GSIZE_FORMAT " and timestamp %"
+      "Queueing a packet of size %" G_GSIZE_FORMAT " and timestamp %"
       G_GUINT64_FORMAT, bufsize, GST_BUFFER_TIMESTAMP (buf));
   GST_LOG_OBJECT (asfmux, "Total data packets: %" G_GUINT64_FORMAT,
       asfmux->total_data_packets);
-  return gst_asf_mux_push_buffer (asfmux, buf, bufsize);
+
+  if (asfmux->packets == NULL)
+    asfmux->packets = gst_buffer_list_new ();
+  gst_buffer_list_add (asfmux->packets, buf);
 }
 
 /**
@@ -1453,9 +1651,14 @@ gst_asf_mux_send_packet (GstAsfMux * asfmux, GstBuffer * buf, gsize bufsize)
  * @asfmux: #GstAsfMux to flush the payloads from
  *
  * Fills an asf packet with asfmux queued payloads and
- * pushes it downstream.
+ * queues it to be pushed downstream.
+ *
+ * The packet is writen to a buffer of the packet pool, with
+ * the data of large payloads referenced from their buffers, so
+ * only small payloads and the padding are copied or cleared.
  *
- * Returns: The result of pushing the packet
+ * Returns: GST_FLOW_OK, or GST_FLOW_ERROR if no packet could be
+ * allocated
  */
 static GstFlowReturn
 gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
@@ -1465,27 +1668,29 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
   guint i;
   GstClockTime send_ts = GST_CLOCK_TIME_NONE;
   guint64 size_left;
-  guint8 *data;
-  gsize size;
+  guint8 *packet, *start, *data;
   GSList *walk;
   GstAsfPad *pad;
   gboolean has_keyframe;
   AsfPayload *payload;
   guint32 payload_size;
   guint offset;
-  GstMapInfo map;
 
   if (asfmux->payloads == NULL)
     return GST_FLOW_OK;         /* nothing to send is ok */
 
   GST_LOG_OBJECT (asfmux, "Flushing payloads");
 
-  buf = gst_buffer_new_and_alloc (asfmux->packet_size);
-  gst_buffer_map (buf, &map, GST_MAP_WRITE);
-  memset (map.data, 0, asfmux->packet_size);
+  packet = gst_asf_mux_reserve_packet (asfmux);
+  if (G_UNLIKELY (packet == NULL)) {
+    GST_ERROR_OBJECT (asfmux, "Failed to get a buffer for the data packet");
+    return GST_FLOW_ERROR;
+  }
+  buf = gst_buffer_new ();
 
   /* 1 for the multiple payload flags */
-  data = map.data + asfmux->payload_parsing_info_size + 1;
+  start = packet;
+  data = packet + asfmux->payload_parsing_info_size + 1;
   size_left = asfmux->packet_size - asfmux->payload_parsing_info_size - 1;
 
   has_keyframe = FALSE;
@@ -1538,7 +1743,11 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
     GST_DEBUG_OBJECT (asfmux, "buffer duration %" GST_TIME_FORMAT,
         GST_TIME_ARGS (GST_BUFFER_DURATION (payload->data)));
 
-    gst_asf_put_payload (data, payload);
+    gst_asf_put_payload_header (data, payload,
+        gst_buffer_get_size (payload->data));
+    data += ASF_MULTIPLE_PAYLOAD_HEADER_SIZE;
+    gst_asf_mux_add_payload_data (asfmux, buf, &start, &data, payload->data,
+        gst_buffer_get_size (payload->data));
     if (!payload->has_packet_info) {
       payload->has_packet_info = TRUE;
       payload->packet_number = asfmux->total_data_packets;
@@ -1557,7 +1766,6 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
     }
 
     /* update our variables */
-    data += payload_size;
     size_left -= payload_size;
     payloads_count++;
     walk = g_slist_next (walk);
@@ -1591,7 +1799,13 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
       send_ts = GST_BUFFER_TIMESTAMP (payload->data);
     }
 
-    bytes_writen = gst_asf_put_subpayload (data, payload, size_left);
+    bytes_writen = MIN (size_left - ASF_MULTIPLE_PAYLOAD_HEADER_SIZE,
+        MIN (gst_buffer_get_size (payload->data), G_MAXUINT16));
+    gst_asf_put_payload_header (data, payload, bytes_writen);
+    data += ASF_MULTIPLE_PAYLOAD_HEADER_SIZE;
+    gst_asf_mux_add_payload_data (asfmux, buf, &start, &data, payload->data,
+        bytes_writen);
+    gst_asf_payload_skip (payload, bytes_writen);
     if (!payload->has_packet_info) {
       payload->has_packet_info = TRUE;
       payload->packet_number = asfmux->total_data_packets;
@@ -1604,9 +1818,15 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
   GST_LOG_OBJECT (asfmux, "Payload data size: %" G_GUINT32_FORMAT,
       asfmux->payload_data_size);
 
-  /* fill payload parsing info */
-  data = map.data;
-  size = map.size;
+  /* only the padding needs to be cleared, everything else is writen */
+  memset (data, 0, size_left);
+  data += size_left;
+  gst_asf_mux_add_pool_memory (asfmux, buf, start, data - start);
+  asfmux->pool_offset += data - packet;
+
+  /* fill payload parsing info, the memory added to the packet above
+   * points into the pool buffer so it can still be writen */
+  data = packet;
 
   /* flags */
   GST_WRITE_UINT8 (data, (0x0 << 7) |   /* no error correction */
@@ -1649,6 +1869,8 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
   if (GST_CLOCK_TIME_IS_VALID (send_ts)) {
     GST_WRITE_UINT32_LE (data + offset, (send_ts / GST_MSECOND));
     GST_BUFFER_TIMESTAMP (buf) = send_ts;
+  } else {
+    GST_WRITE_UINT32_LE (data + offset, 0);
   }
   offset += 4;
 
@@ -1658,17 +1880,17 @@ gst_asf_mux_flush_payloads (GstAsfMux * asfmux)
 
   /* multiple payloads flags */
   GST_WRITE_UINT8 (data + offset, 0x2 << 6 | payloads_count);
-  gst_buffer_unmap (buf, &map);
 
   if (payloads_count == 0) {
     GST_WARNING_OBJECT (asfmux, "Sending packet without any payload");
   }
-  asfmux->data_object_size += size;
+  asfmux->data_object_size += asfmux->packet_size;
 
   if (!has_keyframe)
     GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
 
-  return gst_asf_mux_send_packet (asfmux, buf, size);
+  gst_asf_mux_send_packet (asfmux, buf, gst_buffer_get_size (buf));
+  return GST_FLOW_OK;
 }
 
 /**
@@ -2023,6 +2245,8 @@ gst_asf_mux_collected (GstCollectPads * collect, gpointer data)
         GST_PAD_NAME (best_pad->collect.pad), GST_TIME_ARGS (best_time));
     buf = gst_collect_pads_pop (collect, &best_pad->collect);
     ret = gst_asf_mux_process_buffer (asfmux, best_pad, buf);
+    if (ret == GST_FLOW_OK)
+      ret = gst_asf_mux_push_packets (asfmux);
   } else {
     /* no data, let's finish it up */
     while (asfmux->payloads) {
@@ -2031,6 +2255,9 @@ gst_asf_mux_collected (GstCollectPads * collect, gpointer data)
         return ret;
       }
     }
+    ret = gst_asf_mux_push_packets (asfmux);
+    if (ret != GST_FLOW_OK)
+      return ret;
     g_assert (asfmux->payloads == NULL);
     g_assert (asfmux->payload_data_size == 0);
     /* in not on 'streamable' mode we need to push indexes
@@ -2373,6 +2600,9 @@ gst_asf_mux_get_property (GObject * object,
     case PROP_STREAMABLE:
       g_value_set_boolean (value, asfmux->prop_streamable);
       break;
+    case PROP_COPY_PACKETS:
+      g_value_set_boolean (value, asfmux->prop_copy_packets);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2402,6 +2632,9 @@ gst_asf_mux_set_property (GObject * object,
     case PROP_STREAMABLE:
       asfmux->prop_streamable = g_value_get_boolean (value);
       break;
+    case PROP_COPY_PACKETS:
+      asfmux->prop_copy_packets = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2425,12 +2658,15 @@ gst_asf_mux_change_state (GstElement * element, GstStateChange transition)
       asfmux->packet_size = asfmux->prop_packet_size;
       asfmux->preroll = asfmux->prop_preroll;
       asfmux->merge_stream_tags = asfmux->prop_merge_stream_tags;
+      asfmux->copy_packets = asfmux->prop_copy_packets;
+      gst_asf_mux_start_packet_pool (asfmux);
       gst_collect_pads_start (asfmux->collect);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       gst_collect_pads_stop (asfmux->collect);
+      gst_asf_mux_stop_packet_pool (asfmux);
       asfmux->state = GST_ASF_MUX_STATE_NONE;
       break;
     default:
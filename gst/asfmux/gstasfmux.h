@@ -123,6 +123,16 @@ struct _GstAsfMux
   guint32 payload_parsing_info_size;
   GSList *payloads;
 
+  /* data packets are written to buffers of this pool, which stay
+   * referenced by the packets until they are released downstream */
+  GstBufferPool *packet_pool;
+  GstBuffer *pool_buffer;
+  GstMapInfo pool_map;
+  gsize pool_offset;
+
+  /* data packets waiting to be pushed */
+  GstBufferList *packets;
+
   Guid file_id;
 
   /* properties */
@@ -131,12 +141,14 @@ struct _GstAsfMux
   gboolean prop_merge_stream_tags;
   guint64 prop_padding;
   gboolean prop_streamable;
+  gboolean prop_copy_packets;
 
   /* same as properties, but those are stored here to be
    * used without modification while muxing a single file */
   guint32 packet_size;
   guint64 preroll;              /* milisecs */
   gboolean merge_stream_tags;
+  gboolean copy_packets;
 
   GstClockTime first_ts;
 
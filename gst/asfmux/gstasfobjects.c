@@ -322,15 +322,18 @@ gst_asf_put_guid (guint8 * buf, Guid guid)
 }
 
 /**
- * gst_asf_put_payload:
- * @buf: memory to write the payload to
- * @payload: #AsfPayload to be writen
- *
- * Writes the asf payload to the buffer. The #AsfPayload
- * packet count is incremented.
+ * gst_asf_put_payload_header:
+ * @buf: memory to write the payload header to
+ * @payload: #AsfPayload whose header is to be writen
+ * @size: number of bytes of the payload data following the header
+ *
+ * Writes the header of the asf payload to the buffer, for the
+ * next @size bytes of its data. The data itself is added to the
+ * packet by the caller, right after the header.
+ * The #AsfPayload packet count is incremented.
  */
 void
-gst_asf_put_payload (guint8 * buf, AsfPayload * payload)
+gst_asf_put_payload_header (guint8 * buf, AsfPayload * payload, guint16 size)
 {
   GST_WRITE_UINT8 (buf, payload->stream_number);
   GST_WRITE_UINT8 (buf + 1, payload->media_obj_num);
@@ -338,61 +341,31 @@ gst_asf_put_payload (guint8 * buf, AsfPayload * payload)
   GST_WRITE_UINT8 (buf + 6, payload->replicated_data_length);
   GST_WRITE_UINT32_LE (buf + 7, payload->media_object_size);
   GST_WRITE_UINT32_LE (buf + 11, payload->presentation_time);
-  GST_WRITE_UINT16_LE (buf + 15, (guint16) gst_buffer_get_size (payload->data));
-  gst_buffer_extract (payload->data, 0, buf + 17,
-      gst_buffer_get_size (payload->data));
+  GST_WRITE_UINT16_LE (buf + 15, size);
 
   payload->packet_count++;
 }
 
 /**
- * gst_asf_put_subpayload:
- * @buf: buffer to write the payload to
- * @payload: the payload to be writen
- * @size: maximum size in bytes to write
- *
- * Serializes part of a payload to a buffer.
- * The maximum size is checked against the payload length,
- * the minimum of this size and the payload length is writen
- * to the buffer and the writen size is returned.
+ * gst_asf_payload_skip:
+ * @payload: the payload that was partially writen
+ * @size: number of bytes of its data that were writen
  *
- * It also updates the values of the payload to match the remaining
- * data.
- * In case there is not enough space to write the headers, nothing is done.
- *
- * Returns: The writen size in bytes.
+ * Updates the values of the payload to match the data remaining
+ * after its first @size bytes were writen to a packet as a
+ * sub-payload.
  */
-guint16
-gst_asf_put_subpayload (guint8 * buf, AsfPayload * payload, guint16 size)
+void
+gst_asf_payload_skip (AsfPayload * payload, guint16 size)
 {
-  guint16 payload_size;
   GstBuffer *newbuf;
-  if (size <= ASF_MULTIPLE_PAYLOAD_HEADER_SIZE) {
-    return 0;                   /* do nothing if there is not enough space */
-  }
-  GST_WRITE_UINT8 (buf, payload->stream_number);
-  GST_WRITE_UINT8 (buf + 1, payload->media_obj_num);
-  GST_WRITE_UINT32_LE (buf + 2, payload->offset_in_media_obj);
-  GST_WRITE_UINT8 (buf + 6, payload->replicated_data_length);
-  GST_WRITE_UINT32_LE (buf + 7, payload->media_object_size);
-  GST_WRITE_UINT32_LE (buf + 11, payload->presentation_time);
-  size -= ASF_MULTIPLE_PAYLOAD_HEADER_SIZE;
-  payload_size = size < gst_buffer_get_size (payload->data) ?
-      size : gst_buffer_get_size (payload->data);
-  GST_WRITE_UINT16_LE (buf + 15, payload_size);
-  gst_buffer_extract (payload->data, 0, buf + 17, payload_size);
-
-  /* updates the payload to the remaining data */
-  payload->offset_in_media_obj += payload_size;
+
+  payload->offset_in_media_obj += size;
   newbuf = gst_buffer_copy_region (payload->data, GST_BUFFER_COPY_ALL,
-      payload_size, gst_buffer_get_size (payload->data) - payload_size);
+      size, gst_buffer_get_size (payload->data) - size);
   GST_BUFFER_TIMESTAMP (newbuf) = GST_BUFFER_TIMESTAMP (payload->data);
   gst_buffer_unref (payload->data);
   payload->data = newbuf;
-
-  payload->packet_count++;
-
-  return payload_size;
 }
 
 /**
@@ -104,9 +104,9 @@ gboolean gst_asf_match_guid (const guint8 * data, const Guid * g);
 void gst_asf_put_i32 (guint8 * buf, gint32 data);
 void gst_asf_put_time (guint8 * buf, guint64 time);
 void gst_asf_put_guid (guint8 * buf, Guid guid);
-void gst_asf_put_payload (guint8 * buf, AsfPayload * payload);
-guint16 gst_asf_put_subpayload (guint8 * buf, AsfPayload * payload,
+void gst_asf_put_payload_header (guint8 * buf, AsfPayload * payload,
     guint16 size);
+void gst_asf_payload_skip (AsfPayload * payload, guint16 size);
 
 gboolean gst_asf_parse_packet (GstBuffer * buffer, GstAsfPacketInfo * packet,
     gboolean trust_delta_flag, guint packet_size);
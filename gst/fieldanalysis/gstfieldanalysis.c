@@ -54,6 +54,17 @@
  * gst-launch-1.0 -v uridecodebin uri=/path/to/foo.bar ! fieldanalysis ! deinterlace ! videoconvert ! autovideosink
  * ]| This pipeline will analyse a video stream with default metrics and thresholds and output progressive frames.
  * </refsect2>
+ *
+ * The metrics are computed on bands of lines in parallel on
+ * #GstFieldAnalysis:threads threads. With #GstFieldAnalysis:decimation
+ * greater than 1, they are computed on a copy of the luma plane with only
+ * every decimation-th column, which is faster but less precise. The block
+ * width of the windowed comb metric then counts columns of the copy.
+ *
+ * The sums of the metrics are accumulated exactly whatever the number of
+ * threads, where previous versions accumulated them in single precision
+ * floating point, so the scores can differ from those versions by the
+ * float rounding of the sums, about 1 part in 10^6.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -66,6 +77,7 @@
 #include <stdlib.h>             /* for abs() */
 
 #include "gstfieldanalysis.h"
+#include "gstfieldanalysiscomb.h"
 #include "gstfieldanalysisorc.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_field_analysis_debug);
@@ -82,6 +94,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_field_analysis_debug);
 #define DEFAULT_BLOCK_HEIGHT 16
 #define DEFAULT_BLOCK_THRESH 80
 #define DEFAULT_IGNORED_LINES 2
+#define DEFAULT_THREADS 0
+#define DEFAULT_DECIMATION 1
+
+#define MAX_THREADS 64
+#define MAX_DECIMATION 16
+/* bands of fewer lines are not worth the synchronization */
+#define MIN_BAND_LINES 32
 
 enum
 {
@@ -96,7 +115,9 @@ enum
   PROP_BLOCK_WIDTH,
   PROP_BLOCK_HEIGHT,
   PROP_BLOCK_THRESH,
-  PROP_IGNORED_LINES
+  PROP_IGNORED_LINES,
+  PROP_THREADS,
+  PROP_DECIMATION
 };
 
 static GstStaticPadTemplate sink_factory =
@@ -274,6 +295,19 @@ gst_field_analysis_class_init (GstFieldAnalysisClass * klass)
           "Ignore this many lines from the top and bottom for windowed comb detection",
           2, G_MAXUINT64, DEFAULT_IGNORED_LINES,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads the metrics are computed on (0 = one per CPU)",
+          0, MAX_THREADS, DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_DECIMATION,
+      g_param_spec_uint ("decimation", "Decimation",
+          "Compute the metrics on a luma-only copy with every Nth column "
+          "(1 = on the frames themselves)", 1, MAX_DECIMATION,
+          DEFAULT_DECIMATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_field_analysis_change_state);
@@ -300,11 +334,14 @@ static gfloat same_parity_3_tap (GstFieldAnalysis * filter,
 static gfloat opposite_parity_5_tap (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2]);
 static guint64 block_score_for_row_32detect (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1);
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores);
 static guint64 block_score_for_row_iscombed (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1);
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores);
 static guint64 block_score_for_row_5_tap (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1);
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores);
 static gfloat opposite_parity_windowed_comb (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2]);
 
@@ -327,10 +364,9 @@ gst_field_analysis_reset (GstFieldAnalysis * filter)
   filter->is_telecine = FALSE;
   filter->first_buffer = TRUE;
   gst_video_info_init (&filter->vinfo);
-  g_free (filter->comb_mask);
-  filter->comb_mask = NULL;
-  g_free (filter->block_scores);
-  filter->block_scores = NULL;
+  g_free (filter->decimated[0]);
+  filter->decimated[0] = filter->decimated[1] = NULL;
+  filter->decimated_width = 0;
 }
 
 static void
@@ -360,6 +396,12 @@ gst_field_analysis_init (GstFieldAnalysis * filter)
   filter->block_height = DEFAULT_BLOCK_HEIGHT;
   filter->block_thresh = DEFAULT_BLOCK_THRESH;
   filter->ignored_lines = DEFAULT_IGNORED_LINES;
+  filter->threads = DEFAULT_THREADS;
+  filter->decimation = DEFAULT_DECIMATION;
+
+  filter->bands = g_new0 (FieldAnalysisBand, MAX_THREADS);
+  g_mutex_init (&filter->band_lock);
+  g_cond_init (&filter->band_cond);
 }
 
 static void
@@ -425,18 +467,6 @@ gst_field_analysis_set_property (GObject * object, guint prop_id,
       break;
     case PROP_BLOCK_WIDTH:
       filter->block_width = g_value_get_uint64 (value);
-      if (GST_VIDEO_FRAME_WIDTH (&filter->frames[0].frame)) {
-        const gint frame_width =
-            GST_VIDEO_FRAME_WIDTH (&filter->frames[0].frame);
-        if (filter->block_scores) {
-          gsize nbytes = (frame_width / filter->block_width) * sizeof (guint);
-          filter->block_scores = g_realloc (filter->block_scores, nbytes);
-          memset (filter->block_scores, 0, nbytes);
-        } else {
-          filter->block_scores =
-              g_malloc0 ((frame_width / filter->block_width) * sizeof (guint));
-        }
-      }
       break;
     case PROP_BLOCK_HEIGHT:
       filter->block_height = g_value_get_uint64 (value);
@@ -447,6 +477,12 @@ gst_field_analysis_set_property (GObject * object, guint prop_id,
     case PROP_IGNORED_LINES:
       filter->ignored_lines = g_value_get_uint64 (value);
       break;
+    case PROP_THREADS:
+      filter->threads = g_value_get_uint (value);
+      break;
+    case PROP_DECIMATION:
+      filter->decimation = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -521,6 +557,12 @@ gst_field_analysis_get_property (GObject * object, guint prop_id,
     case PROP_IGNORED_LINES:
       g_value_set_uint64 (value, filter->ignored_lines);
       break;
+    case PROP_THREADS:
+      g_value_set_uint (value, filter->threads);
+      break;
+    case PROP_DECIMATION:
+      g_value_set_uint (value, filter->decimation);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -530,7 +572,7 @@ gst_field_analysis_get_property (GObject * object, guint prop_id,
 static void
 gst_field_analysis_update_format (GstFieldAnalysis * filter, GstCaps * caps)
 {
-  gint width;
+  gint width, height;
   GQueue *outbufs;
   GstVideoInfo vinfo;
 
@@ -568,20 +610,18 @@ gst_field_analysis_update_format (GstFieldAnalysis * filter, GstCaps * caps)
 
   filter->vinfo = vinfo;
   width = GST_VIDEO_INFO_WIDTH (&filter->vinfo);
-
-  /* update allocations for metric scores */
-  if (filter->comb_mask) {
-    filter->comb_mask = g_realloc (filter->comb_mask, width);
-  } else {
-    filter->comb_mask = g_malloc (width);
-  }
-  if (filter->block_scores) {
-    gsize nbytes = (width / filter->block_width) * sizeof (guint);
-    filter->block_scores = g_realloc (filter->block_scores, nbytes);
-    memset (filter->block_scores, 0, nbytes);
-  } else {
-    filter->block_scores =
-        g_malloc0 ((width / filter->block_width) * sizeof (guint));
+  height = GST_VIDEO_INFO_HEIGHT (&filter->vinfo);
+
+  /* the two decimated copies share one allocation */
+  g_free (filter->decimated[0]);
+  filter->decimated[0] = filter->decimated[1] = NULL;
+  filter->decimated_width = 0;
+  filter->luma_decimation = filter->decimation;
+  if (filter->luma_decimation > 1) {
+    filter->decimated_width = MAX (width / filter->luma_decimation, 1);
+    filter->decimated[0] = g_malloc (2 * filter->decimated_width * height);
+    filter->decimated[1] = filter->decimated[0] +
+        filter->decimated_width * height;
   }
 
   GST_OBJECT_UNLOCK (filter);
@@ -804,121 +844,220 @@ gst_field_analysis_sink_event (GstPad * pad, GstObject * parent,
 }
 
 
-static gfloat
-same_parity_sad (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+static void
+gst_field_analysis_band_func (gpointer data, gpointer user_data)
+{
+  FieldAnalysisBand *band = data;
+  GstFieldAnalysis *filter = band->filter;
+
+  band->func (filter, band->history, band);
+
+  g_mutex_lock (&filter->band_lock);
+  if (--filter->n_pending == 0)
+    g_cond_signal (&filter->band_cond);
+  g_mutex_unlock (&filter->band_lock);
+}
+
+/* Splits @n_lines lines (or rows of blocks) into bands of at least
+ * @min_lines and runs @func on each of them, the first on the calling thread
+ * and the others on the workers. Returns when all bands are done. */
+static void
+gst_field_analysis_run_bands (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBandFunc func,
+    gint n_lines, gint min_lines)
+{
+  gint i, n_bands;
+
+  n_bands = CLAMP (n_lines / min_lines, 1, (gint) filter->n_workers + 1);
+
+  for (i = 0; i < n_bands; i++) {
+    FieldAnalysisBand *band = &filter->bands[i];
+
+    band->filter = filter;
+    band->history = history;
+    band->func = func;
+    band->start = (gint64) n_lines * i / n_bands;
+    band->end = (gint64) n_lines * (i + 1) / n_bands;
+    band->sum = 0;
+    band->combed = band->slightly_combed = FALSE;
+  }
+  filter->n_bands = n_bands;
+
+  if (n_bands == 1) {
+    func (filter, history, &filter->bands[0]);
+    return;
+  }
+
+  filter->n_pending = n_bands - 1;
+  for (i = 1; i < n_bands; i++)
+    g_thread_pool_push (filter->pool, &filter->bands[i], NULL);
+
+  func (filter, history, &filter->bands[0]);
+
+  g_mutex_lock (&filter->band_lock);
+  while (filter->n_pending > 0)
+    g_cond_wait (&filter->band_cond, &filter->band_lock);
+  g_mutex_unlock (&filter->band_lock);
+}
+
+/* Runs @func on the bands of the @n_lines lines of a field and returns the
+ * sum of their results */
+static guint64
+gst_field_analysis_sum_bands (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBandFunc func,
+    gint n_lines)
+{
+  guint64 sum = 0;
+  guint i;
+
+  gst_field_analysis_run_bands (filter, history, func, n_lines,
+      MIN_BAND_LINES);
+
+  for (i = 0; i < filter->n_bands; i++)
+    sum += filter->bands[i].sum;
+
+  return sum;
+}
+
+/* Sets the luma of the frame of @history to the luma of its video frame */
+static void
+gst_field_analysis_frame_luma (FieldAnalysisHistory * history)
+{
+  GstVideoFrame *frame = &history->frame;
+
+  history->luma.data =
+      (guint8 *) GST_VIDEO_FRAME_COMP_DATA (frame,
+      0) + GST_VIDEO_FRAME_COMP_OFFSET (frame, 0);
+  history->luma.width = GST_VIDEO_FRAME_WIDTH (frame);
+  history->luma.height = GST_VIDEO_FRAME_HEIGHT (frame);
+  history->luma.stride = GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+  history->luma.pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, 0);
+}
+
+/* copies every luma_decimation-th sample of the lines of the band from the
+ * luma of (*history)[1] to that of (*history)[0] */
+static void
+gst_field_analysis_decimate_band (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBand * band)
+{
+  const FieldAnalysisLuma *src = &(*history)[1].luma;
+  const FieldAnalysisLuma *dst = &(*history)[0].luma;
+  const gint incr = src->pstride * filter->luma_decimation;
+  gint i, j;
+
+  for (j = band->start; j < band->end; j++) {
+    const guint8 *s = src->data + j * src->stride;
+    guint8 *d = dst->data + j * dst->stride;
+
+    for (i = 0; i < dst->width; i++)
+      d[i] = s[i * incr];
+  }
+}
+
+/* Points the metrics of the current frame at a decimated copy of its luma,
+ * stored in the copy not used by the previous frame */
+static void
+gst_field_analysis_decimate (GstFieldAnalysis * filter)
+{
+  FieldAnalysisFields copy[2];
+  FieldAnalysisLuma *luma = &copy[0].luma;
+
+  luma->data = filter->decimated[0];
+  if (filter->nframes > 1 && filter->frames[1].luma.data == luma->data)
+    luma->data = filter->decimated[1];
+  luma->width = filter->decimated_width;
+  luma->height = filter->frames[0].luma.height;
+  luma->stride = filter->decimated_width;
+  luma->pstride = 1;
+  copy[1].luma = filter->frames[0].luma;
+
+  gst_field_analysis_run_bands (filter, &copy,
+      gst_field_analysis_decimate_band, luma->height, MIN_BAND_LINES);
+
+  filter->frames[0].luma = *luma;
+}
+
+/* Returns the first sample of line @j of the field of @fields */
+static inline guint8 *
+field_line (FieldAnalysisFields * fields, gint j)
+{
+  return fields->luma.data + (fields->parity + 2 * j) * fields->luma.stride;
+}
+
+static void
+same_parity_sad_band (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBand * band)
 {
   gint j;
-  gfloat sum;
-  guint8 *f1j, *f2j;
-
-  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
+  const gint width = (*history)[0].luma.width;
   const guint32 noise_floor = filter->noise_floor;
 
-  f1j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-      0) +
-      (*history)[0].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame,
-      0);
-  f2j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-      0) +
-      (*history)[1].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame,
-      0);
-
-  sum = 0.0f;
-  for (j = 0; j < (height >> 1); j++) {
+  for (j = band->start; j < band->end; j++) {
     guint32 tempsum = 0;
-    fieldanalysis_orc_same_parity_sad_planar_yuv (&tempsum, f1j, f2j,
+    fieldanalysis_orc_same_parity_sad_planar_yuv (&tempsum,
+        field_line (&(*history)[0], j), field_line (&(*history)[1], j),
         noise_floor, width);
-    sum += tempsum;
-    f1j += stride0x2;
-    f2j += stride1x2;
+    band->sum += tempsum;
   }
+}
+
+static gfloat
+same_parity_sad (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+{
+  const gint width = (*history)[0].luma.width;
+  const gint height = (*history)[0].luma.height;
+  guint64 sum;
+
+  sum = gst_field_analysis_sum_bands (filter, history, same_parity_sad_band,
+      height >> 1);
 
   return sum / (0.5f * width * height);
 }
 
-static gfloat
-same_parity_ssd (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+static void
+same_parity_ssd_band (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBand * band)
 {
   gint j;
-  gfloat sum;
-  guint8 *f1j, *f2j;
-
-  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
+  const gint width = (*history)[0].luma.width;
   /* noise floor needs to be squared for SSD */
   const guint32 noise_floor = filter->noise_floor * filter->noise_floor;
 
-  f1j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-      0) +
-      (*history)[0].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame,
-      0);
-  f2j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-      0) +
-      (*history)[1].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame,
-      0);
-
-  sum = 0.0f;
-  for (j = 0; j < (height >> 1); j++) {
+  for (j = band->start; j < band->end; j++) {
     guint32 tempsum = 0;
-    fieldanalysis_orc_same_parity_ssd_planar_yuv (&tempsum, f1j, f2j,
+    fieldanalysis_orc_same_parity_ssd_planar_yuv (&tempsum,
+        field_line (&(*history)[0], j), field_line (&(*history)[1], j),
         noise_floor, width);
-    sum += tempsum;
-    f1j += stride0x2;
-    f2j += stride1x2;
+    band->sum += tempsum;
   }
+}
+
+static gfloat
+same_parity_ssd (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+{
+  const gint width = (*history)[0].luma.width;
+  const gint height = (*history)[0].luma.height;
+  guint64 sum;
+
+  sum = gst_field_analysis_sum_bands (filter, history, same_parity_ssd_band,
+      height >> 1);
 
   return sum / (0.5f * width * height); /* field is half height */
 }
 
-/* horizontal [1,4,1] diff between fields - is this a good idea or should the
- * current sample be emphasised more or less? */
-static gfloat
-same_parity_3_tap (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+static void
+same_parity_3_tap_band (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBand * band)
 {
   gint i, j;
-  gfloat sum;
-  guint8 *f1j, *f2j;
-
-  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
+  const gint width = (*history)[0].luma.width;
+  const gint incr = (*history)[0].luma.pstride;
   /* noise floor needs to be *6 for [1,4,1] */
   const guint32 noise_floor = filter->noise_floor * 6;
 
-  f1j = GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame, 0) +
-      GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame, 0) +
-      (*history)[0].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame,
-      0);
-  f2j =
-      GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-      0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-      0) +
-      (*history)[1].parity * GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame,
-      0);
-
-  sum = 0.0f;
-  for (j = 0; j < (height >> 1); j++) {
+  for (j = band->start; j < band->end; j++) {
+    guint8 *f1j = field_line (&(*history)[0], j);
+    guint8 *f2j = field_line (&(*history)[1], j);
     guint32 tempsum = 0;
     guint32 diff;
 
@@ -926,27 +1065,82 @@ same_parity_3_tap (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
     diff = abs (((f1j[0] << 2) + (f1j[incr] << 1))
         - ((f2j[0] << 2) + (f2j[incr] << 1)));
     if (diff > noise_floor)
-      sum += diff;
+      band->sum += diff;
 
     fieldanalysis_orc_same_parity_3_tap_planar_yuv (&tempsum, f1j, &f1j[incr],
         &f1j[incr << 1], f2j, &f2j[incr], &f2j[incr << 1], noise_floor,
         width - 1);
-    sum += tempsum;
+    band->sum += tempsum;
 
     /* unroll last as it is a special case */
     i = width - 1;
     diff = abs (((f1j[i - incr] << 1) + (f1j[i] << 2))
         - ((f2j[i - incr] << 1) + (f2j[i] << 2)));
     if (diff > noise_floor)
-      sum += diff;
-
-    f1j += stride0x2;
-    f2j += stride1x2;
+      band->sum += diff;
   }
+}
+
+/* horizontal [1,4,1] diff between fields - is this a good idea or should the
+ * current sample be emphasised more or less? */
+static gfloat
+same_parity_3_tap (GstFieldAnalysis * filter, FieldAnalysisFields (*history)[2])
+{
+  const gint width = (*history)[0].luma.width;
+  const gint height = (*history)[0].luma.height;
+  guint64 sum;
+
+  sum = gst_field_analysis_sum_bands (filter, history, same_parity_3_tap_band,
+      height >> 1);
 
   return sum / ((6.0f / 2.0f) * width * height);        /* 1 + 4 + 1 = 6; field is half height */
 }
 
+static void
+opposite_parity_5_tap_band (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBand * band)
+{
+  gint j;
+  const FieldAnalysisLuma *top, *bottom;
+  const gint width = (*history)[0].luma.width;
+  const gint last = ((*history)[0].luma.height >> 1) - 1;
+  /* noise floor needs to be *6 for [1,-3,4,-3,1] */
+  const guint32 noise_floor = filter->noise_floor * 6;
+
+  /* the even lines of the combined frame come from the 0th field if it is
+   * the top field, the odd ones from the other field */
+  if ((*history)[0].parity == TOP_FIELD) {
+    top = &(*history)[0].luma;
+    bottom = &(*history)[1].luma;
+  } else {
+    top = &(*history)[1].luma;
+    bottom = &(*history)[0].luma;
+  }
+
+  for (j = band->start; j < band->end; j++) {
+    guint8 *fj = top->data + 2 * j * top->stride;
+    guint8 *fjp1 = bottom->data + (2 * j + 1) * bottom->stride;
+    guint8 *fjp2 = fj + 2 * top->stride;
+    guint8 *fjm1 = fjp1 - 2 * bottom->stride;
+    guint8 *fjm2 = fj - 2 * top->stride;
+    guint32 tempsum = 0;
+
+    if (j == 0) {
+      /* the first line is a special case */
+      fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjp2,
+          fjp1, fj, fjp1, fjp2, noise_floor, width);
+    } else if (j == last) {
+      /* so is the last one */
+      fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjm2,
+          fjm1, fj, fjm1, fjm2, noise_floor, width);
+    } else {
+      fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjm2,
+          fjm1, fj, fjp1, fjp2, noise_floor, width);
+    }
+    band->sum += tempsum;
+  }
+}
+
 /* vertical [1,-3,4,-3,1] - same as is used in FieldDiff from TIVTC,
  * tritical's AVISynth IVTC filter */
 /* 0th field's parity defines operation */
@@ -954,21 +1148,9 @@ static gfloat
 opposite_parity_5_tap (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2])
 {
-  gint j;
-  gfloat sum;
-  guint8 *fjm2, *fjm1, *fj, *fjp1, *fjp2;
-  guint32 tempsum;
-
-  const gint width = GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame);
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride0x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const gint stride1x2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0) << 1;
-  /* noise floor needs to be *6 for [1,-3,4,-3,1] */
-  const guint32 noise_floor = filter->noise_floor * 6;
-
-  sum = 0.0f;
+  const gint width = (*history)[0].luma.width;
+  const gint height = (*history)[0].luma.height;
+  guint64 sum;
 
   /* fj is line j of the combined frame made from the top field even lines of
    *   field 0 and the bottom field odd lines from field 1
@@ -977,137 +1159,49 @@ opposite_parity_5_tap (GstFieldAnalysis * filter,
    * fj with j == 0 is the 0th line of the top field
    * fj with j == 1 is the 0th line of the bottom field or the 1st field of
    *   the frame*/
-
-  /* unroll first line as it is a special case */
-  if ((*history)[0].parity == TOP_FIELD) {
-    fj = GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame, 0);
-    fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0);
-    fjp2 = fj + stride0x2;
-  } else {
-    fj = GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame, 0);
-    fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0);
-    fjp2 = fj + stride1x2;
-  }
-
-  tempsum = 0;
-  fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjp2, fjp1, fj,
-      fjp1, fjp2, noise_floor, width);
-  sum += tempsum;
-
-  for (j = 1; j < (height >> 1) - 1; j++) {
-    /* shift everything down a line in the field of interest (means += stridex2) */
-    fjm2 = fj;
-    fjm1 = fjp1;
-    fj = fjp2;
-    if ((*history)[0].parity == TOP_FIELD) {
-      fjp1 += stride1x2;
-      fjp2 += stride0x2;
-    } else {
-      fjp1 += stride0x2;
-      fjp2 += stride1x2;
-    }
-
-    tempsum = 0;
-    fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjm2, fjm1,
-        fj, fjp1, fjp2, noise_floor, width);
-    sum += tempsum;
-  }
-
-  /* unroll the last line as it is a special case */
-  /* shift everything down a line in the field of interest (means += stridex2) */
-  fjm2 = fj;
-  fjm1 = fjp1;
-  fj = fjp2;
-
-  tempsum = 0;
-  fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (&tempsum, fjm2, fjm1, fj,
-      fjm1, fjm2, noise_floor, width);
-  sum += tempsum;
+  sum = gst_field_analysis_sum_bands (filter, history,
+      opposite_parity_5_tap_band, height >> 1);
 
   return sum / ((6.0f / 2.0f) * width * height);        /* 1 + 4 + 1 == 3 + 3 == 6; field is half height */
 }
 
-/* this metric was sourced from HandBrake but originally from transcode
- * the return value is the highest block score for the row of blocks */
-static inline guint64
-block_score_for_row_32detect (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1)
+/* the return value is the highest block score for the row of blocks of
+ * block_height lines starting at base_fj */
+static guint64
+block_score_for_row (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores, FieldAnalysisCombMethod method)
 {
   guint64 i, j;
-  guint8 *comb_mask = filter->comb_mask;
-  guint *block_scores = filter->block_scores;
   guint64 block_score;
-  guint8 *fjm2, *fjm1, *fj, *fjp1;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
-  const gint stridex2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
+  guint8 *fjm2, *fjm1, *fj, *fjp1, *fjp2;
+  const gint incr = (*history)[0].luma.pstride;
+  const gint stridex2 = (*history)[0].luma.stride << 1;
   const guint64 block_width = filter->block_width;
   const guint64 block_height = filter->block_height;
-  const gint64 spatial_thresh = filter->spatial_thresh;
   const gint width =
-      GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) -
-      (GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) % block_width);
+      (*history)[0].luma.width - ((*history)[0].luma.width % block_width);
 
   fjm2 = base_fj - stridex2;
   fjm1 = base_fjp1 - stridex2;
   fj = base_fj;
   fjp1 = base_fjp1;
+  fjp2 = fj + stridex2;
 
-  for (j = 0; j < block_height; j++) {
-    /* we have to work one result ahead of ourselves which results in some small
-     * peculiarities below */
-    gint diff1, diff2;
-
-    diff1 = fj[0] - fjm1[0];
-    diff2 = fj[0] - fjp1[0];
-    /* change in the same direction */
-    if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-        || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-      comb_mask[0] = abs (fj[0] - fjm2[0]) < 10 && abs (fj[0] - fjm1[0]) > 15;
-    } else {
-      comb_mask[0] = FALSE;
-    }
-
-    for (i = 1; i < width; i++) {
-      const guint64 idx = i * incr;
-      const guint64 res_idx = (i - 1) / block_width;
+  memset (block_scores, 0, (width / block_width) * sizeof (guint));
 
-      diff1 = fj[idx] - fjm1[idx];
-      diff2 = fj[idx] - fjp1[idx];
-      if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-          || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-        comb_mask[i] = abs (fj[idx] - fjm2[idx]) < 10
-            && abs (fj[idx] - fjm1[idx]) > 15;
-      } else {
-        comb_mask[i] = FALSE;
-      }
+  for (j = 0; j < block_height; j++) {
+    gst_field_analysis_comb_mask (method, comb_mask, fjm2, fjm1, fj, fjp1,
+        fjp2, incr, width, filter->spatial_thresh);
+    gst_field_analysis_comb_block_scores (comb_mask, width, block_width,
+        block_scores);
 
-      if (i == 1 && comb_mask[i - 1] && comb_mask[i]) {
-        /* left edge */
-        block_scores[res_idx]++;
-      } else if (i == width - 1) {
-        /* right edge */
-        if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
-          block_scores[res_idx]++;
-        if (comb_mask[i - 1] && comb_mask[i])
-          block_scores[i / block_width]++;
-      } else if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i]) {
-        block_scores[res_idx]++;
-      }
-    }
     /* advance down a line */
     fjm2 = fjm1;
     fjm1 = fj;
     fj = fjp1;
-    fjp1 = fjm1 + stridex2;
+    fjp1 = fjp2;
+    fjp2 = fj + stridex2;
   }
 
   block_score = 0;
@@ -1116,208 +1210,97 @@ block_score_for_row_32detect (GstFieldAnalysis * filter,
       block_score = block_scores[i];
   }
 
-  g_free (block_scores);
-  g_free (comb_mask);
   return block_score;
 }
 
+/* this metric was sourced from HandBrake but originally from transcode
+ * the return value is the highest block score for the row of blocks */
+static guint64
+block_score_for_row_32detect (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores)
+{
+  return block_score_for_row (filter, history, base_fj, base_fjp1, comb_mask,
+      block_scores, METHOD_32DETECT);
+}
+
 /* this metric was sourced from HandBrake but originally from
  * tritical's isCombedT Avisynth function
  * the return value is the highest block score for the row of blocks */
-static inline guint64
+static guint64
 block_score_for_row_iscombed (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1)
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores)
 {
-  guint64 i, j;
-  guint8 *comb_mask = filter->comb_mask;
-  guint *block_scores = filter->block_scores;
-  guint64 block_score;
-  guint8 *fjm1, *fj, *fjp1;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
-  const gint stridex2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const guint64 block_width = filter->block_width;
-  const guint64 block_height = filter->block_height;
-  const gint64 spatial_thresh = filter->spatial_thresh;
-  const gint64 spatial_thresh_squared = spatial_thresh * spatial_thresh;
-  const gint width =
-      GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) -
-      (GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) % block_width);
-
-  fjm1 = base_fjp1 - stridex2;
-  fj = base_fj;
-  fjp1 = base_fjp1;
-
-  for (j = 0; j < block_height; j++) {
-    /* we have to work one result ahead of ourselves which results in some small
-     * peculiarities below */
-    gint diff1, diff2;
-
-    diff1 = fj[0] - fjm1[0];
-    diff2 = fj[0] - fjp1[0];
-    /* change in the same direction */
-    if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-        || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-      comb_mask[0] =
-          (fjm1[0] - fj[0]) * (fjp1[0] - fj[0]) > spatial_thresh_squared;
-    } else {
-      comb_mask[0] = FALSE;
-    }
-
-    for (i = 1; i < width; i++) {
-      const guint64 idx = i * incr;
-      const guint64 res_idx = (i - 1) / block_width;
-
-      diff1 = fj[idx] - fjm1[idx];
-      diff2 = fj[idx] - fjp1[idx];
-      if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-          || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-        comb_mask[i] =
-            (fjm1[idx] - fj[idx]) * (fjp1[idx] - fj[idx]) >
-            spatial_thresh_squared;
-      } else {
-        comb_mask[i] = FALSE;
-      }
-
-      if (i == 1 && comb_mask[i - 1] && comb_mask[i]) {
-        /* left edge */
-        block_scores[res_idx]++;
-      } else if (i == width - 1) {
-        /* right edge */
-        if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
-          block_scores[res_idx]++;
-        if (comb_mask[i - 1] && comb_mask[i])
-          block_scores[i / block_width]++;
-      } else if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i]) {
-        block_scores[res_idx]++;
-      }
-    }
-    /* advance down a line */
-    fjm1 = fj;
-    fj = fjp1;
-    fjp1 = fjm1 + stridex2;
-  }
-
-  block_score = 0;
-  for (i = 0; i < width / block_width; i++) {
-    if (block_scores[i] > block_score)
-      block_score = block_scores[i];
-  }
-
-  g_free (block_scores);
-  g_free (comb_mask);
-  return block_score;
+  return block_score_for_row (filter, history, base_fj, base_fjp1, comb_mask,
+      block_scores, METHOD_IS_COMBED);
 }
 
 /* this metric was sourced from HandBrake but originally from
  * tritical's isCombedT Avisynth function
  * the return value is the highest block score for the row of blocks */
-static inline guint64
+static guint64
 block_score_for_row_5_tap (GstFieldAnalysis * filter,
-    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1)
+    FieldAnalysisFields (*history)[2], guint8 * base_fj, guint8 * base_fjp1,
+    guint8 * comb_mask, guint * block_scores)
 {
-  guint64 i, j;
-  guint8 *comb_mask = filter->comb_mask;
-  guint *block_scores = filter->block_scores;
-  guint64 block_score;
-  guint8 *fjm2, *fjm1, *fj, *fjp1, *fjp2;
-  const gint incr = GST_VIDEO_FRAME_COMP_PSTRIDE (&(*history)[0].frame, 0);
-  const gint stridex2 =
-      GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0) << 1;
-  const guint64 block_width = filter->block_width;
+  return block_score_for_row (filter, history, base_fj, base_fjp1, comb_mask,
+      block_scores, METHOD_5_TAP);
+}
+
+/* scores the rows of blocks of the band, stopping at the first combed block
+ * found by any band */
+static void
+opposite_parity_windowed_comb_band (GstFieldAnalysis * filter,
+    FieldAnalysisFields (*history)[2], FieldAnalysisBand * band)
+{
+  gint j;
+  const gint width = (*history)[0].luma.width;
+  const gint stride = (*history)[0].luma.stride;
+  const guint64 block_thresh = filter->block_thresh;
   const guint64 block_height = filter->block_height;
-  const gint64 spatial_thresh = filter->spatial_thresh;
-  const gint64 spatial_threshx6 = 6 * spatial_thresh;
-  const gint width =
-      GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) -
-      (GST_VIDEO_FRAME_WIDTH (&(*history)[0].frame) % block_width);
+  const gint n_block_scores = width / filter->block_width + 1;
+  guint8 *base_fj, *base_fjp1;
 
+  if ((*history)[0].parity == TOP_FIELD) {
+    base_fj = (*history)[0].luma.data;
+    base_fjp1 = (*history)[1].luma.data + (*history)[1].luma.stride;
+  } else {
+    base_fj = (*history)[1].luma.data;
+    base_fjp1 = (*history)[0].luma.data + (*history)[0].luma.stride;
+  }
 
-  fjm2 = base_fj - stridex2;
-  fjm1 = base_fjp1 - stridex2;
-  fj = base_fj;
-  fjp1 = base_fjp1;
-  fjp2 = fj + stridex2;
+  if (band->mask_size < width) {
+    band->comb_mask = g_realloc (band->comb_mask, width);
+    band->mask_size = width;
+  }
+  if (band->n_block_scores < n_block_scores) {
+    band->block_scores = g_renew (guint, band->block_scores, n_block_scores);
+    band->n_block_scores = n_block_scores;
+  }
 
-  for (j = 0; j < block_height; j++) {
-    /* we have to work one result ahead of ourselves which results in some small
-     * peculiarities below */
-    gint diff1, diff2;
-
-    diff1 = fj[0] - fjm1[0];
-    diff2 = fj[0] - fjp1[0];
-    /* change in the same direction */
-    if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-        || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-      comb_mask[0] =
-          abs (fjm2[0] + (fj[0] << 2) + fjp2[0] - 3 * (fjm1[0] + fjp1[0])) >
-          spatial_threshx6;
-
-      /* motion detection that needs previous and next frames
-         this isn't really necessary, but acts as an optimisation if the
-         additional delay isn't a problem
-         if (motion_detection) {
-         if (abs(fpj[idx] - fj[idx]               ) > motion_thresh &&
-         abs(           fjm1[idx] - fnjm1[idx]) > motion_thresh &&
-         abs(           fjp1[idx] - fnjp1[idx]) > motion_thresh)
-         motion++;
-         if (abs(             fj[idx]   - fnj[idx]) > motion_thresh &&
-         abs(fpjm1[idx] - fjm1[idx]           ) > motion_thresh &&
-         abs(fpjp1[idx] - fjp1[idx]           ) > motion_thresh)
-         motion++;
-         } else {
-         motion = 1;
-         }
-       */
-    } else {
-      comb_mask[0] = FALSE;
-    }
+  /* we operate on a row of blocks of height block_height through each iteration */
+  for (j = band->start; j < band->end; j++) {
+    guint64 line_offset = (filter->ignored_lines + j * block_height) * stride;
+    guint64 block_score;
 
-    for (i = 1; i < width; i++) {
-      const guint64 idx = i * incr;
-      const guint64 res_idx = (i - 1) / block_width;
-
-      diff1 = fj[idx] - fjm1[idx];
-      diff2 = fj[idx] - fjp1[idx];
-      if ((diff1 > spatial_thresh && diff2 > spatial_thresh)
-          || (diff1 < -spatial_thresh && diff2 < -spatial_thresh)) {
-        comb_mask[i] =
-            abs (fjm2[idx] + (fj[idx] << 2) + fjp2[idx] - 3 * (fjm1[idx] +
-                fjp1[idx])) > spatial_threshx6;
-      } else {
-        comb_mask[i] = FALSE;
-      }
+    if (g_atomic_int_get (&filter->comb_found))
+      break;
 
-      if (i == 1 && comb_mask[i - 1] && comb_mask[i]) {
-        /* left edge */
-        block_scores[res_idx]++;
-      } else if (i == width - 1) {
-        /* right edge */
-        if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i])
-          block_scores[res_idx]++;
-        if (comb_mask[i - 1] && comb_mask[i])
-          block_scores[i / block_width]++;
-      } else if (comb_mask[i - 2] && comb_mask[i - 1] && comb_mask[i]) {
-        block_scores[res_idx]++;
-      }
-    }
-    /* advance down a line */
-    fjm2 = fjm1;
-    fjm1 = fj;
-    fj = fjp1;
-    fjp1 = fjp2;
-    fjp2 = fj + stridex2;
-  }
+    block_score = filter->block_score_for_row (filter, history,
+        base_fj + line_offset, base_fjp1 + line_offset, band->comb_mask,
+        band->block_scores);
 
-  block_score = 0;
-  for (i = 0; i < width / block_width; i++) {
-    if (block_scores[i] > block_score)
-      block_score = block_scores[i];
+    if (block_score > (block_thresh >> 1)
+        && block_score <= block_thresh) {
+      /* blend if nothing more combed comes along */
+      band->slightly_combed = TRUE;
+    } else if (block_score > block_thresh) {
+      band->combed = TRUE;
+      g_atomic_int_set (&filter->comb_found, 1);
+      break;
+    }
   }
-
-  g_free (block_scores);
-  g_free (comb_mask);
-  return block_score;
 }
 
 /* a pass is made over the field using one of three comb-detection metrics
@@ -1333,47 +1316,25 @@ static gfloat
 opposite_parity_windowed_comb (GstFieldAnalysis * filter,
     FieldAnalysisFields (*history)[2])
 {
-  gint j;
   gboolean slightly_combed;
+  guint i;
+  gint n_rows = 0;
 
-  const gint height = GST_VIDEO_FRAME_HEIGHT (&(*history)[0].frame);
-  const gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0);
-  const guint64 block_thresh = filter->block_thresh;
+  const gint height = (*history)[0].luma.height;
   const guint64 block_height = filter->block_height;
-  guint8 *base_fj, *base_fjp1;
 
-  if ((*history)[0].parity == TOP_FIELD) {
-    base_fj =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame, 0);
-    base_fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[1].frame, 0);
-  } else {
-    base_fj =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[1].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[1].frame, 0);
-    base_fjp1 =
-        GST_VIDEO_FRAME_COMP_DATA (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_OFFSET (&(*history)[0].frame,
-        0) + GST_VIDEO_FRAME_COMP_STRIDE (&(*history)[0].frame, 0);
-  }
+  if (block_height > 0 && height >= filter->ignored_lines + block_height)
+    n_rows = (height - filter->ignored_lines - block_height) / block_height
+        + 1;
 
-  /* we operate on a row of blocks of height block_height through each iteration */
-  slightly_combed = FALSE;
-  for (j = 0; j <= height - filter->ignored_lines - block_height;
-      j += block_height) {
-    guint64 line_offset = (filter->ignored_lines + j) * stride;
-    guint block_score =
-        filter->block_score_for_row (filter, history, base_fj + line_offset,
-        base_fjp1 + line_offset);
+  g_atomic_int_set (&filter->comb_found, 0);
+  gst_field_analysis_run_bands (filter, history,
+      opposite_parity_windowed_comb_band, n_rows,
+      MAX (MIN_BAND_LINES / block_height, 1));
 
-    if (block_score > (block_thresh >> 1)
-        && block_score <= block_thresh) {
-      /* blend if nothing more combed comes along */
-      slightly_combed = TRUE;
-    } else if (block_score > block_thresh) {
+  slightly_combed = FALSE;
+  for (i = 0; i < filter->n_bands; i++) {
+    if (filter->bands[i].combed) {
       if (GST_VIDEO_INFO_INTERLACE_MODE (&(*history)[0].frame.info) ==
           GST_VIDEO_INTERLACE_MODE_INTERLEAVED) {
         return 1.0f;            /* blend */
@@ -1381,6 +1342,7 @@ opposite_parity_windowed_comb (GstFieldAnalysis * filter,
         return 2.0f;            /* deinterlace */
       }
     }
+    slightly_combed |= filter->bands[i].slightly_combed;
   }
 
   return (gfloat) slightly_combed;      /* TRUE means blend, else don't */
@@ -1431,14 +1393,20 @@ gst_field_analysis_process_buffer (GstFieldAnalysis * filter,
   /* note that we have a ref and mapping the buffer takes a ref so to destroy a
    * buffer we need to unmap it and unref it */
 
+  gst_field_analysis_frame_luma (&filter->frames[0]);
+  if (filter->decimated_width)
+    gst_field_analysis_decimate (filter);
+
   res0 = &filter->frames[0].results;    /* results for current frame */
   res1 = &filter->frames[1].results;    /* results for previous frame */
 
   history[0].frame = filter->frames[0].frame;
+  history[0].luma = filter->frames[0].luma;
   /* we do it like this because the first frame has no predecessor so this is
    * the only result we can get for it */
   if (filter->nframes >= 1) {
     history[1].frame = filter->frames[0].frame;
+    history[1].luma = filter->frames[0].luma;
     history[0].parity = TOP_FIELD;
     history[1].parity = BOTTOM_FIELD;
     /* compare the fields within the buffer, if the buffer exhibits combing it
@@ -1462,6 +1430,7 @@ gst_field_analysis_process_buffer (GstFieldAnalysis * filter,
     filter->first_buffer = FALSE;
 
     history[1].frame = filter->frames[1].frame;
+    history[1].luma = filter->frames[1].luma;
 
     /* compare the top and bottom fields to the previous frame */
     history[0].parity = TOP_FIELD;
@@ -1791,6 +1760,43 @@ unref_unlock_ret:
   return ret;
 }
 
+static void
+gst_field_analysis_start_workers (GstFieldAnalysis * filter)
+{
+  guint n_threads = filter->threads;
+
+  if (n_threads == 0)
+    n_threads = MIN (g_get_num_processors (), MAX_THREADS);
+
+  filter->n_workers = 0;
+  if (n_threads > 1) {
+    GError *err = NULL;
+
+    filter->pool = g_thread_pool_new (gst_field_analysis_band_func, NULL,
+        n_threads - 1, FALSE, &err);
+    if (filter->pool) {
+      filter->n_workers = n_threads - 1;
+    } else {
+      GST_WARNING_OBJECT (filter, "failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
+    }
+  }
+
+  GST_DEBUG_OBJECT (filter, "computing metrics on %u threads",
+      filter->n_workers + 1);
+}
+
+static void
+gst_field_analysis_stop_workers (GstFieldAnalysis * filter)
+{
+  if (filter->pool) {
+    g_thread_pool_free (filter->pool, FALSE, TRUE);
+    filter->pool = NULL;
+  }
+  filter->n_workers = 0;
+}
+
 static GstStateChangeReturn
 gst_field_analysis_change_state (GstElement * element,
     GstStateChange transition)
@@ -1802,6 +1808,7 @@ gst_field_analysis_change_state (GstElement * element,
     case GST_STATE_CHANGE_NULL_TO_READY:
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_field_analysis_start_workers (filter);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
@@ -1818,6 +1825,7 @@ gst_field_analysis_change_state (GstElement * element,
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       gst_field_analysis_reset (filter);
+      gst_field_analysis_stop_workers (filter);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
     default:
@@ -1831,8 +1839,18 @@ static void
 gst_field_analysis_finalize (GObject * object)
 {
   GstFieldAnalysis *filter = GST_FIELDANALYSIS (object);
+  guint i;
 
   gst_field_analysis_reset (filter);
+  gst_field_analysis_stop_workers (filter);
+
+  for (i = 0; i < MAX_THREADS; i++) {
+    g_free (filter->bands[i].comb_mask);
+    g_free (filter->bands[i].block_scores);
+  }
+  g_free (filter->bands);
+  g_mutex_clear (&filter->band_lock);
+  g_cond_clear (&filter->band_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -45,6 +45,7 @@
 #define __GST_FIELDANALYSIS_H__
 
 #include <gst/gst.h>
+#include <gst/video/video.h>
 
 G_BEGIN_DECLS
 #define GST_TYPE_FIELDANALYSIS \
@@ -63,6 +64,8 @@ typedef struct _GstFieldAnalysisClass GstFieldAnalysisClass;
 typedef struct _FieldAnalysisFields FieldAnalysisFields;
 typedef struct _FieldAnalysisHistory FieldAnalysisHistory;
 typedef struct _FieldAnalysis FieldAnalysis;
+typedef struct _FieldAnalysisLuma FieldAnalysisLuma;
+typedef struct _FieldAnalysisBand FieldAnalysisBand;
 
 typedef enum
 {
@@ -89,15 +92,26 @@ struct _FieldAnalysis
   gboolean drop;
 };
 
+/* the luma samples the metrics are computed on, either those of the frame
+ * or a decimated copy of them */
+struct _FieldAnalysisLuma
+{
+  guint8 *data;
+  gint width, height;
+  gint stride, pstride;
+};
+
 struct _FieldAnalysisFields
 {
   GstVideoFrame frame;
+  FieldAnalysisLuma luma;
   gboolean parity;
 };
 
 struct _FieldAnalysisHistory
 {
   GstVideoFrame frame;
+  FieldAnalysisLuma luma;
   FieldAnalysis results;
 };
 
@@ -108,6 +122,28 @@ typedef enum
   METHOD_5_TAP
 } FieldAnalysisCombMethod;
 
+typedef void (*FieldAnalysisBandFunc) (GstFieldAnalysis *,
+    FieldAnalysisFields (*)[2], FieldAnalysisBand *);
+
+/* a band of lines (or rows of blocks) a metric is computed on by one
+ * thread */
+struct _FieldAnalysisBand
+{
+  GstFieldAnalysis *filter;
+  FieldAnalysisFields (*history)[2];
+  FieldAnalysisBandFunc func;
+  gint start, end;
+
+  /* results */
+  guint64 sum;
+  gboolean combed, slightly_combed;
+
+  /* windowed comb scratch */
+  guint8 *comb_mask;
+  guint *block_scores;
+  gint mask_size, n_block_scores;
+};
+
 struct _GstFieldAnalysis
 {
   GstElement element;
@@ -119,14 +155,29 @@ struct _GstFieldAnalysis
   GstVideoInfo vinfo;
   gfloat (*same_field) (GstFieldAnalysis *, FieldAnalysisFields (*)[2]);
   gfloat (*same_frame) (GstFieldAnalysis *, FieldAnalysisFields (*)[2]);
-  guint64 (*block_score_for_row) (GstFieldAnalysis *, FieldAnalysisFields (*)[2], guint8 *, guint8 *);
+  guint64 (*block_score_for_row) (GstFieldAnalysis *, FieldAnalysisFields (*)[2], guint8 *, guint8 *, guint8 *, guint *);
   gboolean is_telecine;
   gboolean first_buffer; /* indicates the first buffer for which a buffer will be output
                           * after a discont or flushing seek */
-  guint8 *comb_mask;
-  guint *block_scores;
   gboolean flushing;     /* indicates whether we are flushing or not */
 
+  /* decimated luma copies of the current and previous frames, used when
+   * decimated_width is not 0 */
+  guint8 *decimated[2];
+  gint decimated_width;
+  guint luma_decimation;
+
+  /* workers computing all bands but the first, which is computed on the
+   * streaming thread */
+  GThreadPool *pool;
+  guint n_workers;
+  GMutex band_lock;
+  GCond band_cond;
+  guint n_pending;
+  FieldAnalysisBand *bands;
+  guint n_bands;
+  volatile gint comb_found; /* a band found a combed block */
+
   /* properties */
   guint32 noise_floor; /* threshold for the result of a metric to be valid */
   gfloat field_thresh; /* threshold used for the same parity field metric */
@@ -135,6 +186,8 @@ struct _GstFieldAnalysis
   guint64 block_width, block_height; /* width/height of window used for comb clusted detection */
   guint64 block_thresh;
   guint64 ignored_lines;
+  guint threads;
+  guint decimation;
 };
 
 struct _GstFieldAnalysisClass
@@ -0,0 +1,147 @@
+/*
+ * GStreamer
+ * Copyright (C) 2010 Robert Swain <robert.swain@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Comb detection of the windowed comb metric.
+ *
+ * A sample is combed if it differs by more than the spatial threshold from
+ * the lines above and below in the same direction and the comb method
+ * confirms it. The mask of combed samples of a line is computed with ORC
+ * when the samples are contiguous, in 16 bit lanes. Samples only differ by
+ * up to 255, so thresholds above that give the same result as 255 and are
+ * clamped to it to fit the lanes. */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>             /* for abs() */
+
+#include "gstfieldanalysiscomb.h"
+#include "gstfieldanalysisorc.h"
+
+/* the change from the lines above and below is in the same direction */
+#define SAME_DIRECTION(diff1, diff2, thresh) \
+    (((diff1) > (thresh) && (diff2) > (thresh)) \
+        || ((diff1) < -(thresh) && (diff2) < -(thresh)))
+
+static void
+comb_mask_scalar (FieldAnalysisCombMethod method, guint8 * mask,
+    const guint8 * fjm2, const guint8 * fjm1, const guint8 * fj,
+    const guint8 * fjp1, const guint8 * fjp2, gint incr, gint width,
+    gint64 spatial_thresh)
+{
+  gint i;
+
+  for (i = 0; i < width; i++) {
+    const gint idx = i * incr;
+    const gint diff1 = fj[idx] - fjm1[idx];
+    const gint diff2 = fj[idx] - fjp1[idx];
+
+    if (!SAME_DIRECTION (diff1, diff2, spatial_thresh)) {
+      mask[i] = FALSE;
+      continue;
+    }
+
+    switch (method) {
+      case METHOD_32DETECT:
+        mask[i] = abs (fj[idx] - fjm2[idx]) < 10
+            && abs (fj[idx] - fjm1[idx]) > 15;
+        break;
+      case METHOD_IS_COMBED:
+        mask[i] = (fjm1[idx] - fj[idx]) * (fjp1[idx] - fj[idx]) >
+            spatial_thresh * spatial_thresh;
+        break;
+      case METHOD_5_TAP:
+      default:
+        mask[i] = abs (fjm2[idx] + (fj[idx] << 2) + fjp2[idx]
+            - 3 * (fjm1[idx] + fjp1[idx])) > 6 * spatial_thresh;
+        break;
+    }
+  }
+}
+
+/* Sets @mask[i] to 1 if sample i of line @fj is combed and to 0 otherwise.
+ * @fjm2, @fjm1, @fjp1 and @fjp2 are the lines 2 and 1 above and below it.
+ * The lines above and below 2 lines away are only read by the methods that
+ * use them. */
+void
+gst_field_analysis_comb_mask (FieldAnalysisCombMethod method, guint8 * mask,
+    const guint8 * fjm2, const guint8 * fjm1, const guint8 * fj,
+    const guint8 * fjp1, const guint8 * fjp2, gint incr, gint width,
+    gint64 spatial_thresh)
+{
+  const gint thresh = MIN (spatial_thresh, 255);
+
+  if (incr != 1) {
+    comb_mask_scalar (method, mask, fjm2, fjm1, fj, fjp1, fjp2, incr, width,
+        spatial_thresh);
+    return;
+  }
+
+  switch (method) {
+    case METHOD_32DETECT:
+      fieldanalysis_orc_comb_mask_32detect (mask, fjm2, fjm1, fj, fjp1, thresh,
+          width);
+      break;
+    case METHOD_IS_COMBED:
+      fieldanalysis_orc_comb_mask_is_combed (mask, fjm1, fj, fjp1, thresh,
+          thresh * thresh, width);
+      break;
+    case METHOD_5_TAP:
+    default:
+      fieldanalysis_orc_comb_mask_5_tap (mask, fjm2, fjm1, fj, fjp1, fjp2,
+          thresh, 6 * thresh, width);
+      break;
+  }
+}
+
+/* Adds the combed samples of the line with @mask to @block_scores. A sample
+ * counts towards the block of the sample to its left when it and its 2 left
+ * neighbours are combed. At the edges 2 combed samples are enough. @width
+ * is a multiple of @block_width. */
+void
+gst_field_analysis_comb_block_scores (const guint8 * mask, gint width,
+    guint block_width, guint * block_scores)
+{
+  guint b, n_blocks;
+  gint i;
+
+  if (width < 2)
+    return;
+
+  /* left edge */
+  block_scores[0] += mask[0] & mask[1];
+
+  n_blocks = width / block_width;
+  for (b = 0; b < n_blocks; b++) {
+    gint start = MAX (b * block_width + 1, 2);
+    gint end = MIN ((b + 1) * block_width + 1, width);
+    guint score = 0;
+
+    for (i = start; i < end; i++)
+      score += mask[i - 2] & mask[i - 1] & mask[i];
+    block_scores[b] += score;
+  }
+
+  /* right edge */
+  if (width > 2)
+    block_scores[(width - 1) / block_width] +=
+        mask[width - 2] & mask[width - 1];
+}
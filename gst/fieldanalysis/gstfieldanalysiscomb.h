@@ -0,0 +1,42 @@
+/*
+ * GStreamer
+ * Copyright (C) 2010 Robert Swain <robert.swain@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Per-sample comb detection of the windowed comb metric */
+
+#ifndef __GST_FIELDANALYSIS_COMB_H__
+#define __GST_FIELDANALYSIS_COMB_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstfieldanalysis.h"
+
+G_BEGIN_DECLS
+
+void gst_field_analysis_comb_mask (FieldAnalysisCombMethod method,
+    guint8 * mask, const guint8 * fjm2, const guint8 * fjm1,
+    const guint8 * fj, const guint8 * fjp1, const guint8 * fjp2, gint incr,
+    gint width, gint64 spatial_thresh);
+
+void gst_field_analysis_comb_block_scores (const guint8 * mask, gint width,
+    guint block_width, guint * block_scores);
+
+G_END_DECLS
+#endif /* __GST_FIELDANALYSIS_COMB_H__ */
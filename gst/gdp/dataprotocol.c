@@ -137,20 +137,16 @@ static guint16 gst_dp_crc_from_memory_maps (const GstMapInfo * maps,
 
 /* payloading functions */
 
-GstBuffer *
-gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
+/* writes the GDP header for @buffer to @h */
+static void
+gst_dp_header_from_buffer (GstBuffer * buffer, GstDPHeaderFlag flags,
+    guint8 * h)
 {
-  GstBuffer *ret_buf;
-  GstMapInfo map;
-  GstMemory *mem;
-  guint8 *h;
   guint16 flags_mask;
   guint16 header_crc = 0, crc = 0;
   gsize buffer_size;
 
-  mem = gst_allocator_alloc (NULL, GST_DP_HEADER_LENGTH, NULL);
-  gst_memory_map (mem, &map, GST_MAP_READWRITE);
-  h = memset (map.data, 0, map.size);
+  memset (h, 0, GST_DP_HEADER_LENGTH);
 
   /* version, flags, type */
   GST_DP_INIT_HEADER (h, GST_DP_VERSION_1_0, flags, GST_DP_PAYLOAD_BUFFER);
@@ -212,6 +208,18 @@ gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
   GST_WRITE_UINT16_BE (h + 60, crc);
 
   GST_MEMDUMP ("payload header for buffer", h, GST_DP_HEADER_LENGTH);
+}
+
+GstBuffer *
+gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
+{
+  GstBuffer *ret_buf;
+  GstMapInfo map;
+  GstMemory *mem;
+
+  mem = gst_allocator_alloc (NULL, GST_DP_HEADER_LENGTH, NULL);
+  gst_memory_map (mem, &map, GST_MAP_READWRITE);
+  gst_dp_header_from_buffer (buffer, flags, map.data);
   gst_memory_unmap (mem, &map);
 
   ret_buf = gst_buffer_new ();
@@ -223,6 +231,51 @@ gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
   return gst_buffer_append (ret_buf, gst_buffer_ref (buffer));
 }
 
+/**
+ * gst_dp_payload_buffer_list:
+ * @list: a #GstBufferList
+ * @flags: the #GstDPHeaderFlag to use
+ *
+ * Payloads every buffer of @list like gst_dp_payload_buffer() does. The
+ * headers of all buffers share a single allocation.
+ *
+ * Returns: a new #GstBufferList with the GDP buffers, in the same order.
+ */
+GstBufferList *
+gst_dp_payload_buffer_list (GstBufferList * list, GstDPHeaderFlag flags)
+{
+  GstBufferList *ret_list;
+  GstMapInfo map;
+  GstMemory *mem;
+  guint i, n;
+
+  n = gst_buffer_list_length (list);
+  ret_list = gst_buffer_list_new_sized (n);
+  if (n == 0)
+    return ret_list;
+
+  mem = gst_allocator_alloc (NULL, n * GST_DP_HEADER_LENGTH, NULL);
+  gst_memory_map (mem, &map, GST_MAP_READWRITE);
+  for (i = 0; i < n; i++) {
+    gst_dp_header_from_buffer (gst_buffer_list_get (list, i), flags,
+        map.data + i * GST_DP_HEADER_LENGTH);
+  }
+  gst_memory_unmap (mem, &map);
+
+  for (i = 0; i < n; i++) {
+    GstBuffer *buf = gst_buffer_new ();
+
+    gst_buffer_append_memory (buf, gst_memory_share (mem,
+            i * GST_DP_HEADER_LENGTH, GST_DP_HEADER_LENGTH));
+    buf = gst_buffer_append (buf, gst_buffer_ref (gst_buffer_list_get (list,
+                i)));
+    gst_buffer_list_add (ret_list, buf);
+  }
+  gst_memory_unref (mem);
+
+  return ret_list;
+}
+
 GstBuffer *
 gst_dp_payload_caps (const GstCaps * caps, GstDPHeaderFlag flags)
 {
@@ -363,6 +416,59 @@ static const guint16 gst_dp_crc_table[256] = {
   0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
 };
 
+/* Tables for processing 8 bytes at once: gst_dp_crc_slice_table[k][b] is
+ * the CRC register after feeding byte b followed by k zero bytes into a
+ * cleared register, so that the contributions of the 8 bytes can be
+ * combined with XOR. The first table is gst_dp_crc_table. */
+static guint16 gst_dp_crc_slice_table[8][256];
+
+static void
+gst_dp_crc_init_slice_table (void)
+{
+  static gsize init = 0;
+  guint i, k;
+
+  if (g_once_init_enter (&init)) {
+    for (i = 0; i < 256; i++)
+      gst_dp_crc_slice_table[0][i] = gst_dp_crc_table[i];
+
+    for (k = 1; k < 8; k++) {
+      for (i = 0; i < 256; i++) {
+        guint16 prev = gst_dp_crc_slice_table[k - 1][i];
+
+        gst_dp_crc_slice_table[k][i] =
+            (guint16) ((prev << 8) ^ gst_dp_crc_table[prev >> 8]);
+      }
+    }
+    g_once_init_leave (&init, 1);
+  }
+}
+
+static guint16
+gst_dp_crc_update (guint16 crc_register, const guint8 * buffer, gsize length)
+{
+  const guint16 (*t)[256] = (const guint16 (*)[256]) gst_dp_crc_slice_table;
+
+  gst_dp_crc_init_slice_table ();
+
+  while (length >= 8) {
+    guint x = crc_register ^ GST_READ_UINT16_BE (buffer);
+
+    crc_register = t[7][x >> 8] ^ t[6][x & 0xff] ^ t[5][buffer[2]] ^
+        t[4][buffer[3]] ^ t[3][buffer[4]] ^ t[2][buffer[5]] ^
+        t[1][buffer[6]] ^ t[0][buffer[7]];
+    buffer += 8;
+    length -= 8;
+  }
+
+  while (length--) {
+    crc_register = (guint16) ((crc_register << 8) ^
+        gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *buffer++]);
+  }
+
+  return crc_register;
+}
+
 /**
  * gst_dp_crc:
  * @buffer: array of bytes
@@ -377,19 +483,12 @@ static const guint16 gst_dp_crc_table[256] = {
 static guint16
 gst_dp_crc (const guint8 * buffer, guint length)
 {
-  guint16 crc_register = CRC_INIT;
-
   if (length == 0)
     return 0;
 
   g_assert (buffer != NULL);
 
-  /* calc CRC */
-  for (; length--;) {
-    crc_register = (guint16) ((crc_register << 8) ^
-        gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *buffer++]);
-  }
-  return (0xffff ^ crc_register);
+  return (0xffff ^ gst_dp_crc_update (CRC_INIT, buffer, length));
 }
 
 static guint16
@@ -405,15 +504,8 @@ gst_dp_crc_from_memory_maps (const GstMapInfo * maps, guint n_maps)
 
   /* calc CRC */
   while (n_maps > 0) {
-    guint8 *buffer = maps->data;
-    gsize length = maps->size;
-
-    total_length += length;
-
-    while (length-- > 0) {
-      crc_register = (guint16) ((crc_register << 8) ^
-          gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *buffer++]);
-    }
+    total_length += maps->size;
+    crc_register = gst_dp_crc_update (crc_register, maps->data, maps->size);
     --n_maps;
     ++maps;
   }
@@ -489,6 +581,17 @@ gst_dp_header_payload_type (const guint8 * header)
  *
  * Returns: A #GstBuffer if the buffer was successfully created, or NULL.
  */
+static void
+gst_dp_buffer_set_header_fields (GstBuffer * buffer, const guint8 * header)
+{
+  GST_BUFFER_TIMESTAMP (buffer) = GST_DP_HEADER_TIMESTAMP (header);
+  GST_BUFFER_DTS (buffer) = GST_DP_HEADER_DTS (header);
+  GST_BUFFER_DURATION (buffer) = GST_DP_HEADER_DURATION (header);
+  GST_BUFFER_OFFSET (buffer) = GST_DP_HEADER_OFFSET (header);
+  GST_BUFFER_OFFSET_END (buffer) = GST_DP_HEADER_OFFSET_END (header);
+  GST_BUFFER_FLAGS (buffer) = GST_DP_HEADER_BUFFER_FLAGS (header);
+}
+
 GstBuffer *
 gst_dp_buffer_from_header (guint header_length, const guint8 * header)
 {
@@ -503,16 +606,45 @@ gst_dp_buffer_from_header (guint header_length, const guint8 * header)
       gst_buffer_new_allocate (NULL,
       (guint) GST_DP_HEADER_PAYLOAD_LENGTH (header), NULL);
 
-  GST_BUFFER_TIMESTAMP (buffer) = GST_DP_HEADER_TIMESTAMP (header);
-  GST_BUFFER_DTS (buffer) = GST_DP_HEADER_DTS (header);
-  GST_BUFFER_DURATION (buffer) = GST_DP_HEADER_DURATION (header);
-  GST_BUFFER_OFFSET (buffer) = GST_DP_HEADER_OFFSET (header);
-  GST_BUFFER_OFFSET_END (buffer) = GST_DP_HEADER_OFFSET_END (header);
-  GST_BUFFER_FLAGS (buffer) = GST_DP_HEADER_BUFFER_FLAGS (header);
+  gst_dp_buffer_set_header_fields (buffer, header);
 
   return buffer;
 }
 
+/**
+ * gst_dp_buffer_from_payload:
+ * @header_length: the length of the packet header
+ * @header: the byte array of the packet header
+ * @payload: (transfer full): a #GstBuffer with the packet payload
+ *
+ * Turns @payload into the buffer described by @header without copying its
+ * data, only its metadata is replaced.
+ *
+ * This function does not check the header passed to it, use
+ * gst_dp_validate_header() first if the header data is unchecked.
+ *
+ * Returns: A #GstBuffer if the buffer was successfully created, or NULL.
+ */
+GstBuffer *
+gst_dp_buffer_from_payload (guint header_length, const guint8 * header,
+    GstBuffer * payload)
+{
+  g_return_val_if_fail (header != NULL, NULL);
+  g_return_val_if_fail (header_length >= GST_DP_HEADER_LENGTH, NULL);
+  g_return_val_if_fail (GST_IS_BUFFER (payload), NULL);
+
+  if (GST_DP_HEADER_PAYLOAD_TYPE (header) != GST_DP_PAYLOAD_BUFFER ||
+      gst_buffer_get_size (payload) != GST_DP_HEADER_PAYLOAD_LENGTH (header)) {
+    gst_buffer_unref (payload);
+    return NULL;
+  }
+
+  payload = gst_buffer_make_writable (payload);
+  gst_dp_buffer_set_header_fields (payload, header);
+
+  return payload;
+}
+
 /**
  * gst_dp_caps_from_packet:
  * @header_length: the length of the packet header
@@ -750,6 +882,60 @@ crc_error:
   }
 }
 
+/**
+ * gst_dp_validate_payload_buffer:
+ * @header_length: the length of the packet header
+ * @header: the byte array of the packet header
+ * @payload: a #GstBuffer with the packet payload
+ *
+ * Like gst_dp_validate_payload(), for a payload that is not necessarily
+ * contiguous in memory.
+ *
+ * Returns: %TRUE if the CRC matches, or no CRC checksum is present.
+ */
+gboolean
+gst_dp_validate_payload_buffer (guint header_length, const guint8 * header,
+    GstBuffer * payload)
+{
+  guint16 crc_read, crc_calculated;
+  GstMapInfo *maps;
+  guint n_maps, i;
+
+  g_return_val_if_fail (header != NULL, FALSE);
+  g_return_val_if_fail (header_length >= GST_DP_HEADER_LENGTH, FALSE);
+  g_return_val_if_fail (GST_IS_BUFFER (payload), FALSE);
+
+  if (!(GST_DP_HEADER_FLAGS (header) & GST_DP_HEADER_FLAG_CRC_PAYLOAD))
+    return TRUE;
+
+  n_maps = gst_buffer_n_memory (payload);
+  maps = g_newa (GstMapInfo, n_maps);
+  for (i = 0; i < n_maps; i++) {
+    gst_memory_map (gst_buffer_peek_memory (payload, i), &maps[i],
+        GST_MAP_READ);
+  }
+
+  crc_read = GST_DP_HEADER_CRC_PAYLOAD (header);
+  crc_calculated = gst_dp_crc_from_memory_maps (maps, n_maps);
+
+  for (i = 0; i < n_maps; i++)
+    gst_memory_unmap (maps[i].memory, &maps[i]);
+
+  if (crc_read != crc_calculated)
+    goto crc_error;
+
+  GST_LOG ("payload crc validation: %02x", crc_read);
+  return TRUE;
+
+  /* ERRORS */
+crc_error:
+  {
+    GST_WARNING ("payload crc mismatch: read %02x, calculated %02x", crc_read,
+        crc_calculated);
+    return FALSE;
+  }
+}
+
 /**
  * gst_dp_validate_packet:
  * @header_length: the length of the packet header
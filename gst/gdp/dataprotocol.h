@@ -24,6 +24,7 @@
 #define __GST_DATA_PROTOCOL_H__
 
 #include <gst/gstbuffer.h>
+#include <gst/gstbufferlist.h>
 #include <gst/gstevent.h>
 #include <gst/gstcaps.h>
 
@@ -79,6 +80,9 @@ GstDPPayloadType
 /* converting to GstBuffer/GstEvent/GstCaps */
 GstBuffer *     gst_dp_buffer_from_header       (guint header_length,
                                                 const guint8 * header);
+GstBuffer *     gst_dp_buffer_from_payload      (guint header_length,
+                                                const guint8 * header,
+                                                GstBuffer * payload);
 GstCaps *       gst_dp_caps_from_packet         (guint header_length,
                                                 const guint8 * header,
                                                 const guint8 * payload);
@@ -90,6 +94,9 @@ GstEvent *      gst_dp_event_from_packet        (guint header_length,
 GstBuffer *     gst_dp_payload_buffer           (GstBuffer      * buffer,
                                                  GstDPHeaderFlag  flags);
 
+GstBufferList * gst_dp_payload_buffer_list      (GstBufferList  * list,
+                                                 GstDPHeaderFlag  flags);
+
 GstBuffer *     gst_dp_payload_caps             (const GstCaps  * caps,
                                                  GstDPHeaderFlag  flags);
 
@@ -102,6 +109,9 @@ gboolean        gst_dp_validate_header          (guint header_length,
 gboolean        gst_dp_validate_payload         (guint header_length,
                                                 const guint8 * header,
                                                 const guint8 * payload);
+gboolean        gst_dp_validate_payload_buffer  (guint header_length,
+                                                const guint8 * header,
+                                                GstBuffer * payload);
 gboolean        gst_dp_validate_packet          (guint header_length,
                                                 const guint8 * header,
                                                 const guint8 * payload);
@@ -42,10 +42,13 @@
 
 #include "gstgdpdepay.h"
 
+#define DEFAULT_CHECK_CRC TRUE
+
 enum
 {
   PROP_0,
-  PROP_TS_OFFSET
+  PROP_TS_OFFSET,
+  PROP_CHECK_CRC
 };
 
 static GstStaticPadTemplate gdp_depay_sink_template =
@@ -104,6 +107,10 @@ gst_gdp_depay_class_init (GstGDPDepayClass * klass)
           "Timestamp Offset",
           G_MININT64, G_MAXINT64, 0,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_CHECK_CRC,
+      g_param_spec_boolean ("check-crc", "Check CRC",
+          "Verify the CRC checksums of header and payload, if present",
+          DEFAULT_CHECK_CRC, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class,
       "GDP Depayloader", "GDP/Depayloader",
@@ -140,6 +147,7 @@ gst_gdp_depay_init (GstGDPDepay * gdpdepay)
   gst_element_add_pad (GST_ELEMENT (gdpdepay), gdpdepay->srcpad);
 
   gdpdepay->adapter = gst_adapter_new ();
+  gdpdepay->check_crc = DEFAULT_CHECK_CRC;
 }
 
 static void
@@ -150,7 +158,6 @@ gst_gdp_depay_finalize (GObject * gobject)
   this = GST_GDP_DEPAY (gobject);
   if (this->caps)
     gst_caps_unref (this->caps);
-  g_free (this->header);
   gst_adapter_clear (this->adapter);
   g_object_unref (this->adapter);
 
@@ -169,6 +176,9 @@ gst_gdp_depay_set_property (GObject * object, guint prop_id,
     case PROP_TS_OFFSET:
       this->ts_offset = g_value_get_int64 (value);
       break;
+    case PROP_CHECK_CRC:
+      this->check_crc = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -187,6 +197,9 @@ gst_gdp_depay_get_property (GObject * object, guint prop_id,
     case PROP_TS_OFFSET:
       g_value_set_int64 (value, this->ts_offset);
       break;
+    case PROP_CHECK_CRC:
+      g_value_set_boolean (value, this->check_crc);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -278,8 +291,6 @@ gst_gdp_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     switch (this->state) {
       case GST_GDP_DEPAY_STATE_HEADER:
       {
-        guint8 *header;
-
         /* collect a complete header, validate and store the header. Figure out
          * the payload length and switch to the PAYLOAD state */
         available = gst_adapter_available (this->adapter);
@@ -287,19 +298,17 @@ gst_gdp_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
           goto done;
 
         GST_LOG_OBJECT (this, "reading GDP header from adapter");
-        header = gst_adapter_take (this->adapter, GST_DP_HEADER_LENGTH);
-        if (!gst_dp_validate_header (GST_DP_HEADER_LENGTH, header)) {
-          g_free (header);
+        gst_adapter_copy (this->adapter, this->header, 0,
+            GST_DP_HEADER_LENGTH);
+        gst_adapter_flush (this->adapter, GST_DP_HEADER_LENGTH);
+        if (this->check_crc &&
+            !gst_dp_validate_header (GST_DP_HEADER_LENGTH, this->header))
           goto header_validate_error;
-        }
 
-        /* store types and payload length. Also store the header, which we need
+        /* store types and payload length. The header is kept as we need it
          * to make the payload. */
-        this->payload_length = gst_dp_header_payload_length (header);
-        this->payload_type = gst_dp_header_payload_type (header);
-        /* free previous header and store new one. */
-        g_free (this->header);
-        this->header = header;
+        this->payload_length = gst_dp_header_payload_length (this->header);
+        this->payload_type = gst_dp_header_payload_type (this->header);
 
         GST_LOG_OBJECT (this,
             "read GDP header, payload size %d, payload type %d, switching to state PAYLOAD",
@@ -330,7 +339,10 @@ gst_gdp_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
           goto wrong_type;
         }
 
-        if (this->payload_length) {
+        /* buffer payloads are checked once they are taken from the adapter,
+         * without having to make them contiguous */
+        if (this->check_crc && this->payload_length &&
+            this->payload_type != GST_DP_PAYLOAD_BUFFER) {
           const guint8 *data;
           gboolean res;
 
@@ -351,22 +363,25 @@ gst_gdp_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
         if (!this->caps)
           goto no_caps;
 
+        /* take the payload without copying it where possible and turn it
+         * into the output buffer */
         GST_LOG_OBJECT (this, "reading GDP buffer from adapter");
-        buf = gst_dp_buffer_from_header (GST_DP_HEADER_LENGTH, this->header);
-        if (!buf)
-          goto buffer_failed;
-
-        /* now take the payload if there is any */
-        if (this->payload_length > 0) {
-          GstMapInfo map;
-
-          gst_buffer_map (buf, &map, GST_MAP_WRITE);
-          gst_adapter_copy (this->adapter, map.data, 0, this->payload_length);
-          gst_buffer_unmap (buf, &map);
+        if (this->payload_length > 0)
+          buf = gst_adapter_take_buffer (this->adapter, this->payload_length);
+        else
+          buf = gst_buffer_new ();
 
-          gst_adapter_flush (this->adapter, this->payload_length);
+        if (this->check_crc && !gst_dp_validate_payload_buffer
+            (GST_DP_HEADER_LENGTH, this->header, buf)) {
+          gst_buffer_unref (buf);
+          goto payload_validate_error;
         }
 
+        buf = gst_dp_buffer_from_payload (GST_DP_HEADER_LENGTH, this->header,
+            buf);
+        if (!buf)
+          goto buffer_failed;
+
         if (GST_BUFFER_TIMESTAMP (buf) > -this->ts_offset)
           GST_BUFFER_TIMESTAMP (buf) += this->ts_offset;
         else
@@ -397,14 +412,15 @@ gst_gdp_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       }
       case GST_GDP_DEPAY_STATE_CAPS:
       {
-        guint8 *payload;
+        const guint8 *payload;
 
-        /* take the payload of the caps */
+        /* parse the caps from the payload in the adapter */
         GST_LOG_OBJECT (this, "reading GDP caps from adapter");
-        payload = gst_adapter_take (this->adapter, this->payload_length);
+        payload = gst_adapter_map (this->adapter, this->payload_length);
         caps = gst_dp_caps_from_packet (GST_DP_HEADER_LENGTH, this->header,
             payload);
-        g_free (payload);
+        gst_adapter_unmap (this->adapter);
+        gst_adapter_flush (this->adapter, this->payload_length);
         if (!caps)
           goto caps_failed;
 
@@ -420,18 +436,21 @@ gst_gdp_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       }
       case GST_GDP_DEPAY_STATE_EVENT:
       {
-        guint8 *payload;
-
         GST_LOG_OBJECT (this, "reading GDP event from adapter");
 
         /* adapter doesn't like 0 length payload */
-        if (this->payload_length > 0)
-          payload = gst_adapter_take (this->adapter, this->payload_length);
-        else
-          payload = NULL;
-        event = gst_dp_event_from_packet (GST_DP_HEADER_LENGTH, this->header,
-            payload);
-        g_free (payload);
+        if (this->payload_length > 0) {
+          const guint8 *payload;
+
+          payload = gst_adapter_map (this->adapter, this->payload_length);
+          event = gst_dp_event_from_packet (GST_DP_HEADER_LENGTH,
+              this->header, payload);
+          gst_adapter_unmap (this->adapter);
+          gst_adapter_flush (this->adapter, this->payload_length);
+        } else {
+          event = gst_dp_event_from_packet (GST_DP_HEADER_LENGTH,
+              this->header, NULL);
+        }
         if (!event)
           goto event_failed;
 
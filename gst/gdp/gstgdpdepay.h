@@ -63,11 +63,12 @@ struct _GstGDPDepay
   GstGDPDepayState state;
   GstCaps *caps;
 
-  guint8 *header;
+  guint8 header[GST_DP_HEADER_LENGTH];
   guint32 payload_length;
   GstDPPayloadType payload_type;
 
   gint64 ts_offset;
+  gboolean check_crc;
 };
 
 struct _GstGDPDepayClass
@@ -76,6 +76,8 @@ static void gst_gdp_pay_reset (GstGDPPay * this);
 
 static GstFlowReturn gst_gdp_pay_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
+static GstFlowReturn gst_gdp_pay_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list);
 static gboolean gst_gdp_pay_src_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 static gboolean gst_gdp_pay_sink_event (GstPad * pad, GstObject * parent,
@@ -132,6 +134,8 @@ gst_gdp_pay_init (GstGDPPay * gdppay)
       gst_pad_new_from_static_template (&gdp_pay_sink_template, "sink");
   gst_pad_set_chain_function (gdppay->sinkpad,
       GST_DEBUG_FUNCPTR (gst_gdp_pay_chain));
+  gst_pad_set_chain_list_function (gdppay->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_gdp_pay_chain_list));
   gst_pad_set_event_function (gdppay->sinkpad,
       GST_DEBUG_FUNCPTR (gst_gdp_pay_sink_event));
   gst_element_add_pad (GST_ELEMENT (gdppay), gdppay->sinkpad);
@@ -206,6 +210,25 @@ gst_gdp_pay_buffer_from_buffer (GstGDPPay * this, GstBuffer * buffer)
   return gst_dp_payload_buffer (buffer, this->header_flag);
 }
 
+/* copy the metadata of @buffer to its GDP buffer @outbuffer */
+static void
+gst_gdp_pay_stamp_payload (GstGDPPay * this, GstBuffer * buffer,
+    GstBuffer * outbuffer)
+{
+  /* If the incoming buffer is HEADER, that means we have it on the caps
+   * as streamheader, and we have serialized a GDP version of it and put it
+   * on our caps */
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_HEADER)) {
+    GST_DEBUG_OBJECT (this, "Setting HEADER flag on outgoing buffer %p",
+        outbuffer);
+    GST_BUFFER_FLAG_SET (outbuffer, GST_BUFFER_FLAG_HEADER);
+  }
+
+  gst_gdp_stamp_buffer (this, outbuffer);
+  GST_BUFFER_TIMESTAMP (outbuffer) = GST_BUFFER_TIMESTAMP (buffer);
+  GST_BUFFER_DURATION (outbuffer) = GST_BUFFER_DURATION (buffer);
+}
+
 static GstBuffer *
 gst_gdp_buffer_from_event (GstGDPPay * this, GstEvent * event)
 {
@@ -465,18 +488,7 @@ gst_gdp_pay_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   if (!outbuffer)
     goto no_buffer;
 
-  /* If the incoming buffer is HEADER, that means we have it on the caps
-   * as streamheader, and we have serialized a GDP version of it and put it
-   * on our caps */
-  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_HEADER)) {
-    GST_DEBUG_OBJECT (this, "Setting HEADER flag on outgoing buffer %p",
-        outbuffer);
-    GST_BUFFER_FLAG_SET (outbuffer, GST_BUFFER_FLAG_HEADER);
-  }
-
-  gst_gdp_stamp_buffer (this, outbuffer);
-  GST_BUFFER_TIMESTAMP (outbuffer) = GST_BUFFER_TIMESTAMP (buffer);
-  GST_BUFFER_DURATION (outbuffer) = GST_BUFFER_DURATION (buffer);
+  gst_gdp_pay_stamp_payload (this, buffer, outbuffer);
 
   if (this->reset_streamheader)
     gst_gdp_pay_reset_streamheader (this);
@@ -507,6 +519,43 @@ no_buffer:
   }
 }
 
+static GstFlowReturn
+gst_gdp_pay_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstGDPPay *this;
+  GstBufferList *outlist;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint i, n;
+
+  this = GST_GDP_PAY (parent);
+
+  n = gst_buffer_list_length (list);
+
+  /* until the streamheader is out, buffers need to be queued one by one */
+  if (!this->have_segment || !this->caps || !this->sent_streamheader ||
+      this->reset_streamheader) {
+    for (i = 0; i < n && ret == GST_FLOW_OK; i++) {
+      ret = gst_gdp_pay_chain (pad, parent,
+          gst_buffer_ref (gst_buffer_list_get (list, i)));
+    }
+    gst_buffer_list_unref (list);
+
+    return ret;
+  }
+
+  /* payload the whole list at once and push it on as a list */
+  outlist = gst_dp_payload_buffer_list (list, this->header_flag);
+  for (i = 0; i < n; i++) {
+    gst_gdp_pay_stamp_payload (this, gst_buffer_list_get (list, i),
+        gst_buffer_list_get (outlist, i));
+  }
+  gst_buffer_list_unref (list);
+
+  GST_LOG_OBJECT (this, "Pushing list of %u GDP buffers", n);
+
+  return gst_pad_push_list (this->srcpad, outlist);
+}
+
 static gboolean
 gst_gdp_pay_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
@@ -37,6 +37,12 @@
  * stream is inversed telecine'd back to 24 fps, yielding approximately
  * the original videotestsrc content.
  * </refsect2>
+ *
+ * Fields are matched by counting the combed samples of the frame woven from
+ * them. With #GstIvtc:subsample greater than 1, only every subsample-th
+ * line of the luma plane is looked at and the count is scaled up
+ * accordingly. This is faster, but fields whose scores are close to the
+ * matching threshold may then be paired differently.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -46,10 +52,16 @@
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
 #include <gst/video/video.h>
+#include <gst/gst-cpu-features-private.h>
 #include "gstivtc.h"
 #include <string.h>
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IVTC_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 /* only because element registration is in this file */
 #include "gstcombdetect.h"
 
@@ -59,6 +71,10 @@ GST_DEBUG_CATEGORY_STATIC (gst_ivtc_debug_category);
 /* prototypes */
 
 
+static void gst_ivtc_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_ivtc_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
 static GstCaps *gst_ivtc_transform_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter);
 static GstCaps *gst_ivtc_fixate_caps (GstBaseTransform * trans,
@@ -73,13 +89,24 @@ static void gst_ivtc_flush (GstIvtc * ivtc);
 static void gst_ivtc_retire_fields (GstIvtc * ivtc, int n_fields);
 static void gst_ivtc_construct_frame (GstIvtc * itvc, GstBuffer * outbuf);
 
-static int get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom);
+static int get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom,
+    int subsample, int max_score, gboolean use_sse2);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_SUBSAMPLE
 };
 
+#define DEFAULT_SUBSAMPLE 1
+#define MAX_SUBSAMPLE 8
+
+/* fields whose comb score is below this are considered to match */
+#define THRESHOLD 100
+/* comb scores are only compared with the threshold once above it, so they
+ * are not counted past this */
+#define MAX_SCORE (THRESHOLD * 2)
+
 /* pad templates */
 
 #define MAX_WIDTH 2048
@@ -114,6 +141,7 @@ G_DEFINE_TYPE_WITH_CODE (GstIvtc, gst_ivtc, GST_TYPE_BASE_TRANSFORM,
 static void
 gst_ivtc_class_init (GstIvtcClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstBaseTransformClass *base_transform_class =
       GST_BASE_TRANSFORM_CLASS (klass);
 
@@ -128,17 +156,59 @@ gst_ivtc_class_init (GstIvtcClass * klass)
       "Inverse Telecine", "Video/Filter", "Inverse Telecine Filter",
       "David Schleef <ds@schleef.org>");
 
+  gobject_class->set_property = gst_ivtc_set_property;
+  gobject_class->get_property = gst_ivtc_get_property;
   base_transform_class->transform_caps =
       GST_DEBUG_FUNCPTR (gst_ivtc_transform_caps);
   base_transform_class->fixate_caps = GST_DEBUG_FUNCPTR (gst_ivtc_fixate_caps);
   base_transform_class->set_caps = GST_DEBUG_FUNCPTR (gst_ivtc_set_caps);
   base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_ivtc_sink_event);
   base_transform_class->transform = GST_DEBUG_FUNCPTR (gst_ivtc_transform);
+
+  g_object_class_install_property (gobject_class, PROP_SUBSAMPLE,
+      g_param_spec_uint ("subsample", "Subsample",
+          "Match fields on every Nth line of the luma plane (1 = all lines)",
+          1, MAX_SUBSAMPLE, DEFAULT_SUBSAMPLE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 }
 
 static void
 gst_ivtc_init (GstIvtc * ivtc)
 {
+  ivtc->subsample = DEFAULT_SUBSAMPLE;
+}
+
+static void
+gst_ivtc_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstIvtc *ivtc = GST_IVTC (object);
+
+  switch (property_id) {
+    case PROP_SUBSAMPLE:
+      ivtc->subsample = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ivtc_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstIvtc *ivtc = GST_IVTC (object);
+
+  switch (property_id) {
+    case PROP_SUBSAMPLE:
+      g_value_set_uint (value, ivtc->subsample);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
 }
 
 static GstCaps *
@@ -233,6 +303,14 @@ gst_ivtc_set_caps (GstBaseTransform * trans, GstCaps * incaps,
 
   ivtc->field_duration = gst_util_uint64_scale_int (GST_SECOND,
       ivtc->sink_video_info.fps_d, ivtc->sink_video_info.fps_n * 2);
+
+  /* picked here rather than at build time only, so that
+   * GST_CPU_FEATURES_DISABLE can select the scalar comb score */
+#ifdef IVTC_USE_SSE2
+  ivtc->use_sse2 = (gst_cpu_get_features () & GST_CPU_FEATURE_SSE2) != 0;
+#else
+  ivtc->use_sse2 = FALSE;
+#endif
   GST_DEBUG_OBJECT (trans, "field duration %" GST_TIME_FORMAT,
       GST_TIME_ARGS (ivtc->field_duration));
 
@@ -319,9 +397,11 @@ similarity (GstIvtc * ivtc, int i1, int i2)
   f2 = &ivtc->fields[i2];
 
   if (f1->parity == TOP_FIELD) {
-    score = get_comb_score (&f1->frame, &f2->frame);
+    score = get_comb_score (&f1->frame, &f2->frame, ivtc->subsample,
+        MAX_SCORE, ivtc->use_sse2);
   } else {
-    score = get_comb_score (&f2->frame, &f1->frame);
+    score = get_comb_score (&f2->frame, &f1->frame, ivtc->subsample,
+        MAX_SCORE, ivtc->use_sse2);
   }
 
   GST_DEBUG ("score %d", score);
@@ -354,8 +434,22 @@ reconstruct (GstIvtc * ivtc, GstVideoFrame * dest_frame, int i1, int i2)
   }
 
   for (k = 0; k < 3; k++) {
+    int dest_stride = GST_VIDEO_FRAME_COMP_STRIDE (dest_frame, k);
+    int src_stride = GST_VIDEO_FRAME_COMP_STRIDE (top, k);
+
     height = GST_VIDEO_FRAME_COMP_HEIGHT (top, k);
     width = GST_VIDEO_FRAME_COMP_WIDTH (top, k);
+    if (height == 0)
+      continue;
+
+    /* both fields from the same frame, copy the whole plane at once when
+     * the lines are laid out the same way */
+    if (top->data[k] == bottom->data[k] && dest_stride == src_stride) {
+      memcpy (GET_LINE (dest_frame, k, 0), GET_LINE (top, k, 0),
+          (gsize) (height - 1) * src_stride + width);
+      continue;
+    }
+
     for (j = 0; j < height; j++) {
       guint8 *dest = GET_LINE (dest_frame, k, j);
       guint8 *src = GET_LINE_IL (top, bottom, k, j);
@@ -582,7 +676,6 @@ gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
   gst_video_frame_map (&dest_frame, &ivtc->src_video_info, outbuf,
       GST_MAP_WRITE);
 
-#define THRESHOLD 100
   if (prev_score < THRESHOLD) {
     if (forward_ok && next_score < prev_score) {
       reconstruct (ivtc, &dest_frame, anchor_index, anchor_index + 1);
@@ -629,8 +722,54 @@ gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
 
 }
 
+/* Updates the length of the run of combed samples ending at sample @i with
+ * whether the sample is @combed, and returns whether it is long enough to
+ * count towards the comb score. The run continues the ones of the sample
+ * to the left and of the sample above. */
+static inline int
+comb_run (int *thisline, int i, gboolean combed)
+{
+  if (combed) {
+    if (i > 0) {
+      thisline[i] += thisline[i - 1];
+    }
+    thisline[i]++;
+    if (thisline[i] > 1000)
+      thisline[i] = 1000;
+  } else {
+    thisline[i] = 0;
+  }
+  return thisline[i] > 100;
+}
+
+#ifdef IVTC_USE_SSE2
+/* Returns a bit mask of the combed samples among the 16 samples of @src2,
+ * in the same way as get_comb_score(). The saturating arithmetic gives the
+ * same results as comparing in int. */
+static inline int
+comb_mask_16 (const guint8 * src1, const guint8 * src2, const guint8 * src3)
+{
+  const __m128i five = _mm_set1_epi8 (5);
+  __m128i s1 = _mm_loadu_si128 ((const __m128i *) src1);
+  __m128i s2 = _mm_loadu_si128 ((const __m128i *) src2);
+  __m128i s3 = _mm_loadu_si128 ((const __m128i *) src3);
+  __m128i lo = _mm_subs_epu8 (_mm_min_epu8 (s1, s3), five);
+  __m128i hi = _mm_adds_epu8 (_mm_max_epu8 (s1, s3), five);
+  __m128i outside = _mm_or_si128 (_mm_subs_epu8 (lo, s2),
+      _mm_subs_epu8 (s2, hi));
+
+  return ~_mm_movemask_epi8 (_mm_cmpeq_epi8 (outside,
+          _mm_setzero_si128 ())) & 0xffff;
+}
+#endif
+
+/* Returns the comb score of the frame woven from the fields of @top and
+ * @bottom, looking at every @subsample-th line. Counting stops once the
+ * score reaches @max_score. With @use_sse2 the samples are checked 16 at a
+ * time. */
 static int
-get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom)
+get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom, int subsample,
+    int max_score, gboolean use_sse2)
 {
   int j;
   int thisline[MAX_WIDTH];
@@ -647,30 +786,39 @@ get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom)
   k = 0;
   /* remove a few lines from top and bottom, as they sometimes contain
    * artifacts */
-  for (j = 2; j < height - 2; j++) {
+  for (j = 2; j < height - 2 && score * subsample < max_score;
+      j += subsample) {
     guint8 *src1 = GET_LINE_IL (top, bottom, 0, j - 1);
     guint8 *src2 = GET_LINE_IL (top, bottom, 0, j);
     guint8 *src3 = GET_LINE_IL (top, bottom, 0, j + 1);
-    int i;
-
-    for (i = 0; i < width; i++) {
-      if (src2[i] < MIN (src1[i], src3[i]) - 5 ||
-          src2[i] > MAX (src1[i], src3[i]) + 5) {
-        if (i > 0) {
-          thisline[i] += thisline[i - 1];
-        }
-        thisline[i]++;
-        if (thisline[i] > 1000)
-          thisline[i] = 1000;
-      } else {
-        thisline[i] = 0;
-      }
-      if (thisline[i] > 100) {
-        score++;
+    int i = 0;
+
+#ifdef IVTC_USE_SSE2
+    for (; use_sse2 && i + 16 <= width; i += 16) {
+      int mask = comb_mask_16 (src1 + i, src2 + i, src3 + i);
+      int b;
+
+      if (mask == 0) {
+        /* no run goes through, which is by far the most common case for
+         * matching fields */
+        memset (thisline + i, 0, 16 * sizeof (int));
+        continue;
       }
+
+      for (b = 0; b < 16; b++)
+        score += comb_run (thisline, i + b, (mask >> b) & 1);
+    }
+#endif
+
+    for (; i < width; i++) {
+      score += comb_run (thisline, i,
+          src2[i] < MIN (src1[i], src3[i]) - 5 ||
+          src2[i] > MAX (src1[i], src3[i]) + 5);
     }
   }
 
+  score *= subsample;
+
   GST_DEBUG ("score %d", score);
 
   return score;
@@ -58,6 +58,12 @@ struct _GstIvtc
 
   int n_fields;
   GstIvtcField fields[GST_IVTC_MAX_FIELDS];
+
+  /* whether the comb score is computed with SSE2 */
+  gboolean use_sse2;
+
+  /* properties */
+  guint subsample;
 };
 
 struct _GstIvtcClass
@@ -50,6 +50,8 @@
 
 #include <gst/tag/tag.h>
 #include <gst/pbutils/pbutils.h>
+#include <gst/base/gstbytereader.h>
+#include <gst/base/gstbytewriter.h>
 
 #include "gstmpegdefs.h"
 #include "gstmpegdemux.h"
@@ -90,9 +92,40 @@ enum
 enum
 {
   PROP_0,
-  /* FILL ME */
+  PROP_INDEX_LOCATION
 };
 
+/* Seek index
+ *
+ * The SCR and position of packs seen while playing or while bisecting for
+ * a seek are remembered, at most one every INDEX_INTERVAL except for packs
+ * that start a video keyframe. Seeks into a part of the stream that was
+ * seen before are then answered without reading anything, and others start
+ * bisecting from the closest known packs. */
+#define INDEX_INTERVAL (CLOCK_FREQ / 10)
+/* How far before the target a keyframe is still preferred as seek point */
+#define INDEX_KEYFRAME_DISTANCE CLOCK_FREQ
+
+/* Sidecar file format: magic, version, length of the stream, number of
+ * entries, then SCR, offset, SCR adjustment and flags of every entry, all
+ * big endian */
+#define INDEX_FILE_MAGIC "GSTPSIDX"
+#define INDEX_FILE_VERSION 2
+#define INDEX_FILE_ENTRY_SIZE 25
+#define INDEX_FLAG_KEYFRAME (1 << 0)
+
+/* The SCR is 33 bits and wraps around */
+#define SCR_WRAP (G_GUINT64_CONSTANT (1) << 33)
+
+/* A read or write of the sidecar file */
+typedef struct
+{
+  gchar *location;
+  /* the data to write, or NULL to read */
+  GBytes *contents;
+  guint generation;
+} GstPsDemuxIndexIO;
+
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -137,7 +170,13 @@ static void gst_ps_demux_base_init (GstPsDemuxClass * klass);
 static void gst_ps_demux_class_init (GstPsDemuxClass * klass);
 static void gst_ps_demux_init (GstPsDemux * demux);
 static void gst_ps_demux_finalize (GstPsDemux * demux);
+static void gst_ps_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_ps_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static void gst_ps_demux_reset (GstPsDemux * demux);
+static void gst_ps_demux_index_io (GstPsDemuxIndexIO * io, GstPsDemux * demux);
+static void gst_ps_demux_index_update (GstPsDemux * demux, gboolean wait);
 
 static gboolean gst_ps_demux_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
@@ -244,6 +283,21 @@ gst_ps_demux_class_init (GstPsDemuxClass * klass)
   gstelement_class = (GstElementClass *) klass;
 
   gobject_class->finalize = (GObjectFinalizeFunc) gst_ps_demux_finalize;
+  gobject_class->set_property = gst_ps_demux_set_property;
+  gobject_class->get_property = gst_ps_demux_get_property;
+
+  /**
+   * GstMpegPSDemux:index-location:
+   *
+   * File the seek index is loaded from when the stream is opened in pull
+   * mode, and saved to when the element is stopped. The file is read and
+   * written in the background. The index is only loaded if it was made for
+   * a stream of the same length.
+   */
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "File to load the seek index from and to save it to", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state = gst_ps_demux_change_state;
 }
@@ -274,6 +328,11 @@ gst_ps_demux_init (GstPsDemux * demux)
   demux->adapter = gst_adapter_new ();
   demux->rev_adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
+  demux->index = g_array_new (FALSE, FALSE, sizeof (GstPsDemuxIndexEntry));
+  g_mutex_init (&demux->index_io_lock);
+  g_cond_init (&demux->index_io_cond);
+  demux->index_io = g_thread_pool_new ((GFunc) gst_ps_demux_index_io, demux,
+      1, FALSE, NULL);
 
   gst_ps_demux_reset (demux);
 }
@@ -281,6 +340,9 @@ gst_ps_demux_init (GstPsDemux * demux)
 static void
 gst_ps_demux_finalize (GstPsDemux * demux)
 {
+  /* let pending writes of the index finish */
+  g_thread_pool_free (demux->index_io, FALSE, TRUE);
+
   gst_ps_demux_reset (demux);
   g_free (demux->streams);
   g_free (demux->streams_found);
@@ -288,10 +350,51 @@ gst_ps_demux_finalize (GstPsDemux * demux)
   gst_flow_combiner_free (demux->flowcombiner);
   g_object_unref (demux->adapter);
   g_object_unref (demux->rev_adapter);
+  g_array_free (demux->index, TRUE);
+  g_free (demux->index_location);
+  g_mutex_clear (&demux->index_io_lock);
+  g_cond_clear (&demux->index_io_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (G_OBJECT (demux));
 }
 
+static void
+gst_ps_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstPsDemux *demux = GST_PS_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (demux);
+      g_free (demux->index_location);
+      demux->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ps_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstPsDemux *demux = GST_PS_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_string (value, demux->index_location);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_ps_demux_reset (GstPsDemux * demux)
 {
@@ -342,6 +445,22 @@ gst_ps_demux_reset (GstPsDemux * demux)
   gst_ps_demux_flush (demux);
   demux->have_group_id = FALSE;
   demux->group_id = G_MAXUINT;
+  demux->scr_adjust = 0;
+  g_array_set_size (demux->index, 0);
+  demux->index_length = G_MAXUINT64;
+  demux->index_pack_scr = G_MAXUINT64;
+  demux->index_synced = TRUE;
+  demux->index_discont = FALSE;
+
+  /* drop index reads of a previous run */
+  g_mutex_lock (&demux->index_io_lock);
+  demux->index_io_generation++;
+  demux->index_io_pending = 0;
+  if (demux->index_file) {
+    g_bytes_unref (demux->index_file);
+    demux->index_file = NULL;
+  }
+  g_mutex_unlock (&demux->index_io_lock);
 }
 
 static GstPsStream *
@@ -900,6 +1019,7 @@ gst_ps_demux_flush (GstPsDemux * demux)
   demux->adapter_offset = G_MAXUINT64;
   demux->current_scr = G_MAXUINT64;
   demux->bytes_since_scr = 0;
+  demux->index_pack_offset = G_MAXUINT64;
 }
 
 static inline void
@@ -1115,6 +1235,121 @@ not_supported:
   }
 }
 
+/* Returns the number of index entries with an SCR up to @scr */
+static guint
+gst_ps_demux_index_search (GstPsDemux * demux, guint64 scr)
+{
+  guint lo = 0, hi = demux->index->len;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (g_array_index (demux->index, GstPsDemuxIndexEntry, mid).scr <= scr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static void
+gst_ps_demux_index_add (GstPsDemux * demux, guint64 scr, guint64 offset,
+    gint64 adjust, gboolean keyframe)
+{
+  GstPsDemuxIndexEntry *prev = NULL, *next = NULL;
+  GstPsDemuxIndexEntry entry;
+  guint pos;
+
+  pos = gst_ps_demux_index_search (demux, scr);
+  if (pos > 0)
+    prev = &g_array_index (demux->index, GstPsDemuxIndexEntry, pos - 1);
+  if (pos < demux->index->len)
+    next = &g_array_index (demux->index, GstPsDemuxIndexEntry, pos);
+
+  if (prev && prev->offset == offset) {
+    prev->keyframe |= keyframe;
+    return;
+  }
+
+  /* the index is only usable as long as the SCR grows with the offset */
+  if ((prev && prev->offset > offset) || (next && next->offset < offset)) {
+    GST_LOG_OBJECT (demux, "SCR %" G_GUINT64_FORMAT " at %" G_GUINT64_FORMAT
+        " out of order, not indexing", scr, offset);
+    return;
+  }
+
+  if (!keyframe && ((prev && scr - prev->scr < INDEX_INTERVAL) ||
+          (next && next->scr - scr < INDEX_INTERVAL)))
+    return;
+
+  GST_LOG_OBJECT (demux, "indexing SCR %" G_GUINT64_FORMAT " at %"
+      G_GUINT64_FORMAT "%s", scr, offset, keyframe ? " (keyframe)" : "");
+
+  entry.scr = scr;
+  entry.offset = offset;
+  entry.adjust = adjust;
+  entry.keyframe = keyframe;
+  g_array_insert_val (demux->index, pos, entry);
+}
+
+/* Unwraps an SCR of the stream relative to the first one */
+static guint64
+gst_ps_demux_unwrap_scr (GstPsDemux * demux, guint64 scr)
+{
+  if (demux->first_scr != G_MAXUINT64 && scr < demux->first_scr &&
+      demux->first_scr - scr > SCR_WRAP / 2)
+    scr += SCR_WRAP;
+
+  return scr;
+}
+
+/* Indexes a pack found while scanning, whose SCR is only unwrapped. That is
+ * the one on the output timeline as long as the SCR has no other jumps. */
+static void
+gst_ps_demux_index_add_scanned (GstPsDemux * demux, guint64 scr,
+    guint64 offset)
+{
+  guint64 unwrapped = gst_ps_demux_unwrap_scr (demux, scr);
+
+  if (!demux->index_discont)
+    gst_ps_demux_index_add (demux, unwrapped, offset, unwrapped - scr, FALSE);
+}
+
+/* Looks up where to start reading for @scr: a keyframe shortly before it,
+ * or else the last pack before it if the index covers that part of the
+ * stream */
+static gboolean
+gst_ps_demux_index_lookup (GstPsDemux * demux, guint64 scr, guint64 * offset,
+    guint64 * fscr, gint64 * adjust)
+{
+  GstPsDemuxIndexEntry *entry;
+  guint i, pos;
+
+  pos = gst_ps_demux_index_search (demux, scr);
+
+  for (i = pos; i > 0; i--) {
+    entry = &g_array_index (demux->index, GstPsDemuxIndexEntry, i - 1);
+    if (scr - entry->scr > INDEX_KEYFRAME_DISTANCE)
+      break;
+    if (entry->keyframe)
+      goto found;
+  }
+
+  if (pos == 0)
+    return FALSE;
+
+  entry = &g_array_index (demux->index, GstPsDemuxIndexEntry, pos - 1);
+  if (scr - entry->scr > INDEX_INTERVAL)
+    return FALSE;
+
+found:
+  *offset = entry->offset;
+  *fscr = entry->scr;
+  *adjust = entry->adjust;
+  return TRUE;
+}
+
 #define MAX_RECURSION_COUNT 100
 
 /* Binary search for requested SCR */
@@ -1136,8 +1371,10 @@ find_offset (GstPsDemux * demux, guint64 scr,
       MIN (gst_util_uint64_scale (scr - min_scr, scr_rate_n,
           scr_rate_d), demux->sink_segment.stop);
 
-  if (!gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0)) {
-    gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
+  if (gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0) ||
+      gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0)) {
+    gst_ps_demux_index_add_scanned (demux, fscr, offset);
+    fscr = gst_ps_demux_unwrap_scr (demux, fscr);
   }
 
   if (fscr == scr || fscr == min_scr || fscr == max_scr) {
@@ -1157,8 +1394,11 @@ static inline gboolean
 gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
 {
   gboolean found;
-  guint64 fscr, offset;
+  guint64 fscr, offset, last_scr;
+  guint64 min_scr, min_scr_offset, max_scr, max_scr_offset;
   guint64 scr = GSTTIME_TO_MPEGTIME (seeksegment->position + demux->base_time);
+  gint64 adjust;
+  guint pos;
 
   /* In some clips the PTS values are completely unaligned with SCR values.
    * To improve the seek in that situation we apply a factor considering the
@@ -1166,16 +1406,53 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
   if (demux->last_scr > demux->last_pts)
     scr = gst_util_uint64_scale (scr, demux->last_scr, demux->last_pts);
 
-  scr = MIN (demux->last_scr, scr);
+  last_scr = gst_ps_demux_unwrap_scr (demux, demux->last_scr);
+  scr = MIN (last_scr, scr);
   scr = MAX (demux->first_scr, scr);
   fscr = scr;
 
   GST_INFO_OBJECT (demux, "sink segment configured %" GST_SEGMENT_FORMAT
       ", trying to go at SCR: %" G_GUINT64_FORMAT, &demux->sink_segment, scr);
 
-  offset =
-      find_offset (demux, scr, demux->first_scr, demux->first_scr_offset,
-      demux->last_scr, demux->last_scr_offset, 0);
+  /* the index decides where to start, so wait for it to be read */
+  gst_ps_demux_index_update (demux, TRUE);
+
+  if (gst_ps_demux_index_lookup (demux, scr, &offset, &fscr, &adjust)) {
+    GST_DEBUG_OBJECT (demux, "found SCR %" G_GUINT64_FORMAT " at offset %"
+        G_GUINT64_FORMAT " in the index", fscr, offset);
+    demux->scr_adjust = adjust;
+    demux->index_synced = TRUE;
+    goto done;
+  }
+
+  /* bisect between the closest packs we know of */
+  min_scr = demux->first_scr;
+  min_scr_offset = demux->first_scr_offset;
+  max_scr = last_scr;
+  max_scr_offset = demux->last_scr_offset;
+
+  pos = gst_ps_demux_index_search (demux, scr);
+  if (pos > 0) {
+    GstPsDemuxIndexEntry *entry =
+        &g_array_index (demux->index, GstPsDemuxIndexEntry, pos - 1);
+
+    if (entry->scr > min_scr && entry->offset > min_scr_offset) {
+      min_scr = entry->scr;
+      min_scr_offset = entry->offset;
+    }
+  }
+  if (pos < demux->index->len) {
+    GstPsDemuxIndexEntry *entry =
+        &g_array_index (demux->index, GstPsDemuxIndexEntry, pos);
+
+    if (entry->scr < max_scr && entry->offset < max_scr_offset) {
+      max_scr = entry->scr;
+      max_scr_offset = entry->offset;
+    }
+  }
+
+  offset = find_offset (demux, scr, min_scr, min_scr_offset, max_scr,
+      max_scr_offset, 0);
 
   if (offset == (guint64) - 1) {
     return FALSE;
@@ -1185,16 +1462,25 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
   if (!found)
     found = gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
 
-  while (found && fscr < scr) {
+  while (found && gst_ps_demux_unwrap_scr (demux, fscr) < scr) {
     offset++;
     found = gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
   }
 
-  while (found && fscr > scr && offset > 0) {
+  while (found && gst_ps_demux_unwrap_scr (demux, fscr) > scr && offset > 0) {
     offset--;
     found = gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
   }
 
+  /* the SCR adjustment from here on is only known if the SCR doesn't jump */
+  if (found) {
+    gst_ps_demux_index_add_scanned (demux, fscr, offset);
+    demux->scr_adjust = gst_ps_demux_unwrap_scr (demux, fscr) - fscr;
+    fscr += demux->scr_adjust;
+  }
+  demux->index_synced = found && !demux->index_discont;
+
+done:
   GST_INFO_OBJECT (demux, "doing seek at offset %" G_GUINT64_FORMAT
       " SCR: %" G_GUINT64_FORMAT " %" GST_TIME_FORMAT,
       offset, fscr, GST_TIME_ARGS (MPEGTIME_TO_GSTTIME (fscr)));
@@ -1819,6 +2105,29 @@ gst_ps_demux_parse_pack_start (GstPsDemux * demux)
     }
   }
 
+  /* index the pack with its SCR on the output timeline. The offset of the
+   * adapter only follows the start of the last buffer so take the exact one
+   * from the buffer offsets */
+  demux->index_pack_offset = G_MAXUINT64;
+  if (demux->random_access && demux->sink_segment.rate >= 0.0 &&
+      demux->index_synced) {
+    guint64 distance;
+    guint64 prev_offset = gst_adapter_prev_offset (demux->adapter, &distance);
+    guint64 unwrapped = gst_ps_demux_unwrap_scr (demux, scr);
+
+    /* wrapping around is estimated like any other jump */
+    if (MAX (scr_adjusted, unwrapped) - MIN (scr_adjusted, unwrapped) >
+        CLOCK_FREQ)
+      demux->index_discont = TRUE;
+
+    if (prev_offset != GST_BUFFER_OFFSET_NONE) {
+      demux->index_pack_scr = scr_adjusted;
+      demux->index_pack_offset = prev_offset + distance;
+      gst_ps_demux_index_add (demux, scr_adjusted, demux->index_pack_offset,
+          demux->scr_adjust, FALSE);
+    }
+  }
+
   /* update the current_scr and rate members */
   demux->mux_rate = new_rate;
   demux->current_scr = scr_adjusted;
@@ -2174,6 +2483,46 @@ need_more_data:
   }
 }
 
+/* Whether a video PES payload starts a keyframe, that is begins with an
+ * MPEG-1/2 sequence or GOP header or with an H.264 SPS or IDR slice */
+static gboolean
+gst_ps_demux_is_keyframe (gint stream_type, const guint8 * data, gsize size)
+{
+  gsize i;
+
+  /* the headers come before the first picture */
+  size = MIN (size, 256);
+
+  for (i = 0; i + 4 <= size; i++) {
+    guint8 code;
+
+    if (data[i] != 0x00 || data[i + 1] != 0x00 || data[i + 2] != 0x01)
+      continue;
+
+    code = data[i + 3];
+    switch (stream_type) {
+      case ST_VIDEO_MPEG1:
+      case ST_VIDEO_MPEG2:
+      case ST_GST_VIDEO_MPEG1_OR_2:
+        if (code == 0xb3 || code == 0xb8)
+          return TRUE;
+        if (code == 0x00)
+          return FALSE;
+        break;
+      case ST_VIDEO_H264:
+        if ((code & 0x1f) == 5 || (code & 0x1f) == 7)
+          return TRUE;
+        if ((code & 0x1f) == 1)
+          return FALSE;
+        break;
+      default:
+        return FALSE;
+    }
+  }
+
+  return FALSE;
+}
+
 static void
 gst_ps_demux_resync_cb (GstPESFilter * filter, GstPsDemux * demux)
 {
@@ -2263,6 +2612,12 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
     }
 
     demux->current_stream = gst_ps_demux_get_stream (demux, id, stream_type);
+
+    if (demux->index_pack_offset != G_MAXUINT64 &&
+        gst_ps_demux_is_keyframe (stream_type, map.data + offset, datalen)) {
+      gst_ps_demux_index_add (demux, demux->index_pack_scr,
+          demux->index_pack_offset, demux->scr_adjust, TRUE);
+    }
   }
 
   if (G_UNLIKELY (demux->current_stream == NULL)) {
@@ -2707,6 +3062,197 @@ gst_ps_demux_scan_backward_ts (GstPsDemux * demux, guint64 * pos,
   return found;
 }
 
+/* Reads or writes the sidecar file, on a thread of demux->index_io */
+static void
+gst_ps_demux_index_io (GstPsDemuxIndexIO * io, GstPsDemux * demux)
+{
+  GError *err = NULL;
+
+  if (io->contents) {
+    gsize size;
+    const gchar *data = g_bytes_get_data (io->contents, &size);
+
+    if (!g_file_set_contents (io->location, data, size, &err)) {
+      GST_WARNING_OBJECT (demux, "can't save index to %s: %s", io->location,
+          err->message);
+      g_clear_error (&err);
+    } else {
+      GST_INFO_OBJECT (demux, "saved index to %s", io->location);
+    }
+    g_bytes_unref (io->contents);
+  } else {
+    gchar *contents;
+    gsize size;
+
+    if (!g_file_get_contents (io->location, &contents, &size, &err)) {
+      GST_DEBUG_OBJECT (demux, "can't read index %s: %s", io->location,
+          err->message);
+      g_clear_error (&err);
+      contents = NULL;
+    }
+
+    g_mutex_lock (&demux->index_io_lock);
+    if (io->generation == demux->index_io_generation) {
+      if (contents)
+        demux->index_file = g_bytes_new_take (contents, size);
+      demux->index_io_pending--;
+      g_cond_broadcast (&demux->index_io_cond);
+    } else {
+      g_free (contents);
+    }
+    g_mutex_unlock (&demux->index_io_lock);
+  }
+
+  g_free (io->location);
+  g_slice_free (GstPsDemuxIndexIO, io);
+}
+
+static void
+gst_ps_demux_index_queue_io (GstPsDemux * demux, const gchar * location,
+    GBytes * contents)
+{
+  GstPsDemuxIndexIO *io = g_slice_new (GstPsDemuxIndexIO);
+
+  io->location = g_strdup (location);
+  io->contents = contents;
+
+  g_mutex_lock (&demux->index_io_lock);
+  io->generation = demux->index_io_generation;
+  if (!contents)
+    demux->index_io_pending++;
+  g_mutex_unlock (&demux->index_io_lock);
+
+  g_thread_pool_push (demux->index_io, io, NULL);
+}
+
+static void
+gst_ps_demux_load_index (GstPsDemux * demux, GBytes * contents)
+{
+  GstByteReader reader;
+  gconstpointer data;
+  gsize size;
+  const guint8 *magic;
+  guint32 version, n_entries, i;
+  guint64 length;
+  gboolean discont = FALSE;
+  GArray *index;
+
+  data = g_bytes_get_data (contents, &size);
+  gst_byte_reader_init (&reader, data, size);
+  if (!gst_byte_reader_get_data (&reader, 8, &magic) ||
+      memcmp (magic, INDEX_FILE_MAGIC, 8) != 0 ||
+      !gst_byte_reader_get_uint32_be (&reader, &version) ||
+      version != INDEX_FILE_VERSION ||
+      !gst_byte_reader_get_uint64_be (&reader, &length) ||
+      !gst_byte_reader_get_uint32_be (&reader, &n_entries) ||
+      gst_byte_reader_get_remaining (&reader) / INDEX_FILE_ENTRY_SIZE <
+      n_entries)
+    goto invalid;
+
+  if (length != demux->index_length) {
+    GST_WARNING_OBJECT (demux, "index is for a stream of %" G_GUINT64_FORMAT
+        " bytes, not %" G_GUINT64_FORMAT, length, demux->index_length);
+    return;
+  }
+
+  index = g_array_sized_new (FALSE, FALSE, sizeof (GstPsDemuxIndexEntry),
+      n_entries);
+  for (i = 0; i < n_entries; i++) {
+    GstPsDemuxIndexEntry entry;
+    guint64 unwrapped;
+    guint8 flags;
+
+    entry.scr = gst_byte_reader_get_uint64_be_unchecked (&reader);
+    entry.offset = gst_byte_reader_get_uint64_be_unchecked (&reader);
+    entry.adjust = gst_byte_reader_get_int64_be_unchecked (&reader);
+    flags = gst_byte_reader_get_uint8_unchecked (&reader);
+    entry.keyframe = (flags & INDEX_FLAG_KEYFRAME) != 0;
+
+    if (entry.offset >= length || (i > 0 &&
+            (entry.scr < g_array_index (index, GstPsDemuxIndexEntry,
+                    i - 1).scr ||
+                entry.offset <= g_array_index (index, GstPsDemuxIndexEntry,
+                    i - 1).offset))) {
+      g_array_free (index, TRUE);
+      goto invalid;
+    }
+
+    unwrapped = gst_ps_demux_unwrap_scr (demux, entry.scr - entry.adjust);
+    if (MAX (entry.scr, unwrapped) - MIN (entry.scr, unwrapped) > CLOCK_FREQ)
+      discont = TRUE;
+
+    g_array_append_val (index, entry);
+  }
+
+  GST_INFO_OBJECT (demux, "loaded %u index entries", index->len);
+
+  g_array_free (demux->index, TRUE);
+  demux->index = index;
+  demux->index_discont = discont;
+  return;
+
+invalid:
+  {
+    GST_WARNING_OBJECT (demux, "invalid index");
+    return;
+  }
+}
+
+/* Loads the index once it was read and the stream length is known, waiting
+ * for a pending read if @wait */
+static void
+gst_ps_demux_index_update (GstPsDemux * demux, gboolean wait)
+{
+  GBytes *contents;
+
+  if (demux->index_length == G_MAXUINT64)
+    return;
+
+  g_mutex_lock (&demux->index_io_lock);
+  while (wait && demux->index_io_pending > 0)
+    g_cond_wait (&demux->index_io_cond, &demux->index_io_lock);
+  contents = demux->index_file;
+  demux->index_file = NULL;
+  g_mutex_unlock (&demux->index_io_lock);
+
+  if (contents) {
+    gst_ps_demux_load_index (demux, contents);
+    g_bytes_unref (contents);
+  }
+}
+
+/* Queues writing the index to @location */
+static void
+gst_ps_demux_save_index (GstPsDemux * demux, const gchar * location)
+{
+  GstByteWriter writer;
+  guint size, i;
+
+  gst_byte_writer_init_with_size (&writer,
+      24 + demux->index->len * INDEX_FILE_ENTRY_SIZE, FALSE);
+  gst_byte_writer_put_data (&writer, (const guint8 *) INDEX_FILE_MAGIC, 8);
+  gst_byte_writer_put_uint32_be (&writer, INDEX_FILE_VERSION);
+  gst_byte_writer_put_uint64_be (&writer, demux->index_length);
+  gst_byte_writer_put_uint32_be (&writer, demux->index->len);
+  for (i = 0; i < demux->index->len; i++) {
+    GstPsDemuxIndexEntry *entry =
+        &g_array_index (demux->index, GstPsDemuxIndexEntry, i);
+
+    gst_byte_writer_put_uint64_be (&writer, entry->scr);
+    gst_byte_writer_put_uint64_be (&writer, entry->offset);
+    gst_byte_writer_put_int64_be (&writer, entry->adjust);
+    gst_byte_writer_put_uint8 (&writer,
+        entry->keyframe ? INDEX_FLAG_KEYFRAME : 0);
+  }
+
+  size = gst_byte_writer_get_size (&writer);
+  gst_ps_demux_index_queue_io (demux, location,
+      g_bytes_new_take (gst_byte_writer_reset_and_get_data (&writer), size));
+
+  GST_DEBUG_OBJECT (demux, "saving %u index entries to %s", demux->index->len,
+      location);
+}
+
 static inline gboolean
 gst_ps_sink_get_duration (GstPsDemux * demux)
 {
@@ -2775,7 +3321,7 @@ gst_ps_sink_get_duration (GstPsDemux * demux)
         GST_TIME_ARGS (MPEGTIME_TO_GSTTIME (demux->last_pts)), offset);
   }
   /* Detect wrong SCR values */
-  if (demux->first_scr > demux->last_scr) {
+  if (demux->first_scr > gst_ps_demux_unwrap_scr (demux, demux->last_scr)) {
     GST_DEBUG_OBJECT (demux, "Wrong SCR values detected, searching for "
         "a better first SCR value");
     offset = demux->first_scr_offset;
@@ -2798,7 +3344,8 @@ gst_ps_sink_get_duration (GstPsDemux * demux)
   /* Set the base_time and avg rate */
   demux->base_time = MPEGTIME_TO_GSTTIME (demux->first_scr);
   demux->scr_rate_n = demux->last_scr_offset - demux->first_scr_offset;
-  demux->scr_rate_d = demux->last_scr - demux->first_scr;
+  demux->scr_rate_d =
+      gst_ps_demux_unwrap_scr (demux, demux->last_scr) - demux->first_scr;
 
   if (G_LIKELY (demux->first_pts != G_MAXUINT64 &&
           demux->last_pts != G_MAXUINT64)) {
@@ -2817,6 +3364,9 @@ gst_ps_sink_get_duration (GstPsDemux * demux)
   GST_INFO_OBJECT (demux, "src segment configured %" GST_SEGMENT_FORMAT,
       &demux->src_segment);
 
+  demux->index_length = length;
+  gst_ps_demux_index_update (demux, FALSE);
+
   res = TRUE;
 
 beach:
@@ -3222,6 +3772,7 @@ gst_ps_demux_change_state (GstElement * element, GstStateChange transition)
 {
   GstPsDemux *demux = GST_PS_DEMUX (element);
   GstStateChangeReturn result;
+  gchar *index_location;
 
   switch (transition) {
     case GST_STATE_CHANGE_NULL_TO_READY:
@@ -3233,6 +3784,13 @@ gst_ps_demux_change_state (GstElement * element, GstStateChange transition)
       demux->filter.gather_pes = TRUE;
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      GST_OBJECT_LOCK (demux);
+      index_location = g_strdup (demux->index_location);
+      GST_OBJECT_UNLOCK (demux);
+
+      if (index_location)
+        gst_ps_demux_index_queue_io (demux, index_location, NULL);
+      g_free (index_location);
       break;
     default:
       break;
@@ -3242,6 +3800,15 @@ gst_ps_demux_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      GST_OBJECT_LOCK (demux);
+      index_location = g_strdup (demux->index_location);
+      GST_OBJECT_UNLOCK (demux);
+
+      if (index_location && demux->index_length != G_MAXUINT64 &&
+          demux->index->len > 0)
+        gst_ps_demux_save_index (demux, index_location);
+      g_free (index_location);
+
       gst_ps_demux_reset (demux);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
@@ -102,6 +102,16 @@ struct _GstPsStream
   GstTagList *pending_tags;
 };
 
+/* A pack in the seek index. The SCR is on the timeline of the output
+ * timestamps, @adjust is what was added to the SCR of the pack for that */
+typedef struct
+{
+  guint64 scr;
+  guint64 offset;
+  gint64 adjust;
+  gboolean keyframe;
+} GstPsDemuxIndexEntry;
+
 struct _GstPsDemux
 {
   GstElement parent;
@@ -156,6 +166,25 @@ struct _GstPsDemux
 
   /* Indicates an MPEG-2 stream */
   gboolean is_mpeg2_pack;
+
+  /* seek index of GstPsDemuxIndexEntry, sorted by SCR */
+  GArray *index;
+  gchar *index_location;
+  guint64 index_length;
+  guint64 index_pack_scr;
+  guint64 index_pack_offset;
+  /* whether scr_adjust is known for the packs that are read */
+  gboolean index_synced;
+  /* whether the SCR jumps other than by wrapping around */
+  gboolean index_discont;
+
+  /* sidecar file reads and writes, done in order off the streaming thread */
+  GThreadPool *index_io;
+  GMutex index_io_lock;
+  GCond index_io_cond;
+  guint index_io_generation;
+  guint index_io_pending;
+  GBytes *index_file;
 };
 
 struct _GstPsDemuxClass
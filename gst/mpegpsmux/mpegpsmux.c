@@ -54,10 +54,12 @@ GST_DEBUG_CATEGORY (mpegpsmux_debug);
 
 enum
 {
-  PROP_AGGREGATE_GOPS = 1
+  PROP_AGGREGATE_GOPS = 1,
+  PROP_COPY_PACKETS
 };
 
 #define DEFAULT_AGGREGATE_GOPS FALSE
+#define DEFAULT_COPY_PACKETS FALSE
 
 static GstStaticPadTemplate mpegpsmux_sink_factory =
     GST_STATIC_PAD_TEMPLATE ("sink_%u",
@@ -94,7 +96,7 @@ static void gst_mpegpsmux_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
 static void mpegpsmux_finalize (GObject * object);
-static gboolean new_packet_cb (guint8 * data, guint len, void *user_data);
+static gboolean new_packet_cb (GstBuffer * buf, void *user_data);
 
 static gboolean mpegpsdemux_prepare_srcpad (MpegPsMux * mux);
 static GstFlowReturn mpegpsmux_collected (GstCollectPads * pads,
@@ -126,6 +128,12 @@ mpegpsmux_class_init (MpegPsMuxClass * klass)
       g_param_spec_boolean ("aggregate-gops", "Aggregate GOPs",
           "Whether to aggregate GOPs and push them out as buffer lists",
           DEFAULT_AGGREGATE_GOPS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_COPY_PACKETS,
+      g_param_spec_boolean ("copy-packets", "Copy packets",
+          "Whether to copy every packet to a new buffer and push it on its "
+          "own instead of in a buffer list. This is slower and only meant "
+          "for comparisons", DEFAULT_COPY_PACKETS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&mpegpsmux_sink_factory));
@@ -154,7 +162,6 @@ mpegpsmux_init (MpegPsMux * mux)
   psmux_set_write_func (mux->psmux, new_packet_cb, mux);
 
   mux->first = TRUE;
-  mux->last_flow_ret = GST_FLOW_OK;
   mux->last_ts = 0;             /* XXX: or -1? */
 }
 
@@ -190,6 +197,10 @@ gst_mpegpsmux_set_property (GObject * object, guint prop_id,
     case PROP_AGGREGATE_GOPS:
       mux->aggregate_gops = g_value_get_boolean (value);
       break;
+    case PROP_COPY_PACKETS:
+      mux->copy_packets = g_value_get_boolean (value);
+      psmux_set_copy_packets (mux->psmux, mux->copy_packets);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -206,6 +217,9 @@ gst_mpegpsmux_get_property (GObject * object, guint prop_id,
     case PROP_AGGREGATE_GOPS:
       g_value_set_boolean (value, mux->aggregate_gops);
       break;
+    case PROP_COPY_PACKETS:
+      g_value_set_boolean (value, mux->copy_packets);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -490,9 +504,19 @@ mpegpsmux_push_gop_list (MpegPsMux * mux)
 
   g_assert (mux->gop_list != NULL);
 
-  GST_DEBUG_OBJECT (mux, "Sending pending GOP of %u buffers",
+  GST_DEBUG_OBJECT (mux, "Sending %u pending buffers",
       gst_buffer_list_length (mux->gop_list));
-  flow = gst_pad_push_list (mux->srcpad, mux->gop_list);
+  if (mux->copy_packets && !mux->aggregate_gops) {
+    guint i, n = gst_buffer_list_length (mux->gop_list);
+
+    flow = GST_FLOW_OK;
+    for (i = 0; i < n && flow == GST_FLOW_OK; i++)
+      flow = gst_pad_push (mux->srcpad,
+          gst_buffer_ref (gst_buffer_list_get (mux->gop_list, i)));
+    gst_buffer_list_unref (mux->gop_list);
+  } else {
+    flow = gst_pad_push_list (mux->srcpad, mux->gop_list);
+  }
   mux->gop_list = NULL;
   return flow;
 }
@@ -569,15 +593,19 @@ mpegpsmux_collected (GstCollectPads * pads, MpegPsMux * mux)
       }
     }
     mux->last_ts = best->last_ts;
+
+    if (!mux->aggregate_gops && mux->gop_list != NULL)
+      ret = mpegpsmux_push_gop_list (mux);
   } else {
     /* FIXME: Drain all remaining streams */
     /* At EOS */
-    if (mux->gop_list != NULL)
-      mpegpsmux_push_gop_list (mux);
-
     if (!psmux_write_end_code (mux->psmux)) {
       GST_WARNING_OBJECT (mux, "Writing MPEG PS Program end code failed.");
     }
+
+    if (mux->gop_list != NULL)
+      mpegpsmux_push_gop_list (mux);
+
     gst_pad_push_event (mux->srcpad, gst_event_new_eos ());
 
     ret = GST_FLOW_EOS;
@@ -590,7 +618,7 @@ new_seg_fail:
   return GST_FLOW_ERROR;
 write_fail:
   /* FIXME: Failed writing data for some reason. Should set appropriate error */
-  return mux->last_flow_ret;
+  return GST_FLOW_ERROR;
 }
 
 static GstPad *
@@ -659,37 +687,24 @@ mpegpsmux_release_pad (GstElement * element, GstPad * pad)
 }
 
 static gboolean
-new_packet_cb (guint8 * data, guint len, void *user_data)
+new_packet_cb (GstBuffer * buf, void *user_data)
 {
   /* Called when the PsMux has prepared a packet for output. Return FALSE
    * on error */
 
   MpegPsMux *mux = (MpegPsMux *) user_data;
-  GstBuffer *buf;
-  GstFlowReturn ret;
-
-  GST_LOG_OBJECT (mux, "Outputting a packet of length %d", len);
 
-  data = g_memdup (data, len);
-  buf = gst_buffer_new_wrapped (data, len);
+  GST_LOG_OBJECT (mux, "Outputting a packet of length %" G_GSIZE_FORMAT,
+      gst_buffer_get_size (buf));
 
   GST_BUFFER_TIMESTAMP (buf) = mux->last_ts;
 
-  if (mux->aggregate_gops) {
-    if (mux->gop_list == NULL)
-      mux->gop_list = gst_buffer_list_new ();
-
-    gst_buffer_list_add (mux->gop_list, buf);
-    return TRUE;
-  }
-
-  ret = gst_pad_push (mux->srcpad, buf);
-
-  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
-    mux->last_flow_ret = ret;
-    return FALSE;
-  }
+  /* the packets are pushed as a list by mpegpsmux_collected(), once the
+   * input buffer or the GOP is written */
+  if (mux->gop_list == NULL)
+    mux->gop_list = gst_buffer_list_new ();
 
+  gst_buffer_list_add (mux->gop_list, buf);
   return TRUE;
 }
 
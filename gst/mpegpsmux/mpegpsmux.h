@@ -75,12 +75,13 @@ struct MpegPsMux {
   PsMux *psmux;
 
   gboolean first;
-  GstFlowReturn last_flow_ret;
-  
   GstClockTime last_ts;
 
+  /* packets waiting to be pushed: those of the current input buffer,
+   * or of the whole GOP with aggregate-gops */
   GstBufferList *gop_list;
   gboolean       aggregate_gops;
+  gboolean       copy_packets;
 };
 
 struct MpegPsMuxClass  {
@@ -54,7 +54,10 @@
 #include "psmux.h"
 #include "crc.h"
 
-static gboolean psmux_packet_out (PsMux * mux);
+/* size of the pool buffers the packet headers are written to */
+#define PSMUX_HDR_BUF_SIZE 4096
+
+static gboolean psmux_packet_out (PsMux * mux, GstBuffer * buf);
 static gboolean psmux_write_pack_header (PsMux * mux);
 static gboolean psmux_write_system_header (PsMux * mux);
 static gboolean psmux_write_program_stream_map (PsMux * mux);
@@ -70,9 +73,16 @@ PsMux *
 psmux_new (void)
 {
   PsMux *mux;
+  GstStructure *config;
 
   mux = g_slice_new0 (PsMux);
 
+  mux->hdr_pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (mux->hdr_pool);
+  gst_buffer_pool_config_set_params (config, NULL, PSMUX_HDR_BUF_SIZE, 0, 0);
+  gst_buffer_pool_set_config (mux->hdr_pool, config);
+  gst_buffer_pool_set_active (mux->hdr_pool, TRUE);
+
   mux->pts = -1;                /* uninitialized values */
   mux->pack_hdr_pts = -1;
   mux->sys_hdr_pts = -1;
@@ -111,11 +121,85 @@ psmux_set_write_func (PsMux * mux, PsMuxWriteFunc func, void *user_data)
   mux->write_func_data = user_data;
 }
 
+/**
+ * psmux_set_copy_packets:
+ * @mux: a #PsMux
+ * @copy_packets: whether to copy the packets
+ *
+ * Copy every packet, headers and payload, to a newly allocated buffer before
+ * passing it to the write function, instead of referencing the header pool
+ * and the stream buffers. This is slower and only meant for comparisons.
+ */
+void
+psmux_set_copy_packets (PsMux * mux, gboolean copy_packets)
+{
+  g_return_if_fail (mux != NULL);
+
+  mux->copy_packets = copy_packets;
+}
+
+static void
+psmux_release_header_buffer (PsMux * mux)
+{
+  if (mux->hdr_buf == NULL)
+    return;
+
+  gst_buffer_unmap (mux->hdr_buf, &mux->hdr_map);
+  gst_buffer_unref (mux->hdr_buf);
+  mux->hdr_buf = NULL;
+}
+
+/* Returns where up to @len bytes of headers can be written, in the current
+ * header buffer or a new one from the pool if it is full */
+static guint8 *
+psmux_reserve_header (PsMux * mux, guint len)
+{
+  GstBuffer *buf = NULL;
+
+  if (mux->hdr_buf != NULL && mux->hdr_offset + len <= mux->hdr_map.size)
+    return mux->hdr_map.data + mux->hdr_offset;
+
+  psmux_release_header_buffer (mux);
+
+  if (gst_buffer_pool_acquire_buffer (mux->hdr_pool, &buf,
+          NULL) != GST_FLOW_OK)
+    return NULL;
+
+  mux->hdr_buf = buf;
+  gst_buffer_map (buf, &mux->hdr_map, GST_MAP_WRITE);
+  mux->hdr_offset = 0;
+
+  return mux->hdr_map.data;
+}
+
+/* Returns a new buffer referencing the first @len bytes written to the last
+ * reserved header space. The header buffer goes back to the pool once all
+ * buffers referencing it are freed. */
+static GstBuffer *
+psmux_commit_header (PsMux * mux, guint len)
+{
+  GstBuffer *buf = gst_buffer_new ();
+  guint8 *data = mux->hdr_map.data + mux->hdr_offset;
+
+  gst_buffer_append_memory (buf,
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, data, len, 0, len,
+          gst_buffer_ref (mux->hdr_buf), (GDestroyNotify) gst_buffer_unref));
+  mux->hdr_offset += len;
+
+  return buf;
+}
+
 gboolean
 psmux_write_end_code (PsMux * mux)
 {
   guint8 end_code[4] = { 0, 0, 1, PSMUX_PROGRAM_END };
-  return mux->write_func (end_code, 4, mux->write_func_data);
+  guint8 *data;
+
+  if (!(data = psmux_reserve_header (mux, 4)))
+    return FALSE;
+
+  memcpy (data, end_code, 4);
+  return psmux_packet_out (mux, psmux_commit_header (mux, 4));
 }
 
 
@@ -147,6 +231,11 @@ psmux_free (PsMux * mux)
   if (mux->psm != NULL)
     gst_buffer_unref (mux->psm);
 
+  /* header buffers still used downstream are freed when released */
+  psmux_release_header_buffer (mux);
+  gst_buffer_pool_set_active (mux->hdr_pool, FALSE);
+  gst_object_unref (mux->hdr_pool);
+
   g_slice_free (PsMux, mux);
 }
 
@@ -203,19 +292,32 @@ psmux_create_stream (PsMux * mux, PsMuxStreamType stream_type)
 }
 
 static gboolean
-psmux_packet_out (PsMux * mux)
+psmux_packet_out (PsMux * mux, GstBuffer * buf)
 {
+  gsize size = gst_buffer_get_size (buf);
   gboolean res;
-  if (G_UNLIKELY (mux->write_func == NULL))
+
+  if (G_UNLIKELY (mux->write_func == NULL)) {
+    gst_buffer_unref (buf);
     return TRUE;
+  }
 
-  res = mux->write_func (mux->packet_buf, mux->packet_bytes_written,
-      mux->write_func_data);
+  if (mux->copy_packets) {
+    GstBuffer *copy = gst_buffer_new_allocate (NULL, size, NULL);
+    GstMapInfo map;
+
+    gst_buffer_map (copy, &map, GST_MAP_WRITE);
+    gst_buffer_extract (buf, 0, map.data, size);
+    gst_buffer_unmap (copy, &map);
+    gst_buffer_unref (buf);
+    buf = copy;
+  }
+
+  res = mux->write_func (buf, mux->write_func_data);
 
   if (res) {
-    mux->bit_size += mux->packet_bytes_written;
+    mux->bit_size += size;
   }
-  mux->packet_bytes_written = 0;
   return res;
 }
 
@@ -232,6 +334,9 @@ gboolean
 psmux_write_stream_packet (PsMux * mux, PsMuxStream * stream)
 {
   gboolean res;
+  GstBuffer *payload;
+  guint8 *hdr;
+  guint hdr_len;
 
   g_return_val_if_fail (mux != NULL, FALSE);
   g_return_val_if_fail (stream != NULL, FALSE);
@@ -279,14 +384,20 @@ psmux_write_stream_packet (PsMux * mux, PsMuxStream * stream)
     mux->psm_pts = mux->pts;
   }
 
-  /* Write the packet */
-  if (!(mux->packet_bytes_written =
-          psmux_stream_get_data (stream, mux->packet_buf,
-              mux->pes_max_payload + PSMUX_PES_MAX_HDR_LEN))) {
+  /* Write the packet: the PES header goes to a header buffer, the payload
+   * references the data of the stream buffers */
+  if (!(hdr = psmux_reserve_header (mux, PSMUX_PES_MAX_HDR_LEN)))
+    return FALSE;
+
+  payload = gst_buffer_new ();
+  if (!(hdr_len = psmux_stream_get_data (stream, hdr,
+              mux->pes_max_payload + PSMUX_PES_MAX_HDR_LEN, payload))) {
+    gst_buffer_unref (payload);
     return FALSE;
   }
 
-  res = psmux_packet_out (mux);
+  res = psmux_packet_out (mux,
+      gst_buffer_append (psmux_commit_header (mux, hdr_len), payload));
   if (!res) {
     GST_DEBUG_OBJECT (mux, "packet write false");
     return FALSE;
@@ -301,12 +412,16 @@ static gboolean
 psmux_write_pack_header (PsMux * mux)
 {
   bits_buffer_t bw;
+  guint8 *data;
   guint64 scr = mux->pts;       /* XXX: is this correct? necessary to put any offset? */
   if (mux->pts == -1)
     scr = 0;
 
+  if (!(data = psmux_reserve_header (mux, 14)))
+    return FALSE;
+
   /* pack_start_code */
-  bits_initwrite (&bw, 14, mux->packet_buf);
+  bits_initwrite (&bw, 14, data);
   bits_write (&bw, 24, PSMUX_START_CODE_PREFIX);
   bits_write (&bw, 8, PSMUX_PACK_HEADER);
 
@@ -334,8 +449,7 @@ psmux_write_pack_header (PsMux * mux)
   bits_write (&bw, 5, 0x1f);
   bits_write (&bw, 3, 0);       /* pack_stuffing_length */
 
-  mux->packet_bytes_written = 14;
-  return psmux_packet_out (mux);
+  return psmux_packet_out (mux, psmux_commit_header (mux, 14));
 }
 
 static void
@@ -396,16 +510,10 @@ psmux_ensure_system_header (PsMux * mux)
 static gboolean
 psmux_write_system_header (PsMux * mux)
 {
-  GstMapInfo map;
-
   psmux_ensure_system_header (mux);
 
-  gst_buffer_map (mux->sys_header, &map, GST_MAP_READ);
-  memcpy (mux->packet_buf, map.data, map.size);
-  mux->packet_bytes_written = map.size;
-  gst_buffer_unmap (mux->sys_header, &map);
-
-  return psmux_packet_out (mux);
+  /* the copy shares the memory of the header, but gets its own metadata */
+  return psmux_packet_out (mux, gst_buffer_copy (mux->sys_header));
 }
 
 static void
@@ -480,16 +588,9 @@ psmux_ensure_program_stream_map (PsMux * mux)
 static gboolean
 psmux_write_program_stream_map (PsMux * mux)
 {
-  GstMapInfo map;
-
   psmux_ensure_program_stream_map (mux);
 
-  gst_buffer_map (mux->psm, &map, GST_MAP_READ);
-  memcpy (mux->packet_buf, map.data, map.size);
-  mux->packet_bytes_written = map.size;
-  gst_buffer_unmap (mux->psm, &map);
-
-  return psmux_packet_out (mux);
+  return psmux_packet_out (mux, gst_buffer_copy (mux->psm));
 }
 
 GList *
@@ -54,7 +54,8 @@ G_BEGIN_DECLS
 
 #define PSMUX_MAX_ES_INFO_LENGTH ((1 << 12) - 1)
 
-typedef gboolean (*PsMuxWriteFunc) (guint8 *data, guint len, void *user_data);
+/* Takes ownership of @buf */
+typedef gboolean (*PsMuxWriteFunc) (GstBuffer *buf, void *user_data);
 
 struct PsMux {
   GList *streams;    /* PsMuxStream* array of all streams */
@@ -81,10 +82,15 @@ struct PsMux {
   guint psm_freq; /* program stream map frequency */ 
   GstClockTime psm_pts; /* last time a psm is written */
 
-  guint8 packet_buf[PSMUX_MAX_PACKET_LEN];
-  guint packet_bytes_written; /* # of bytes written in the buf */
+  /* headers are written to buffers of this pool, which the output
+   * packets reference together with the payload of the stream buffers */
+  GstBufferPool *hdr_pool;
+  GstBuffer *hdr_buf;
+  GstMapInfo hdr_map;
+  guint hdr_offset;
   PsMuxWriteFunc write_func;
   void *write_func_data;
+  gboolean copy_packets; /* copy every packet to a new buffer */
 
   /* Scratch space for writing ES_info descriptors */
   guint8 es_info_buf[PSMUX_MAX_ES_INFO_LENGTH];
@@ -105,6 +111,7 @@ void 		psmux_free 			(PsMux *mux);
 
 /* Setting muxing session properties */
 void 		psmux_set_write_func 		(PsMux *mux, PsMuxWriteFunc func, void *user_data);
+void 		psmux_set_copy_packets 		(PsMux *mux, gboolean copy_packets);
 
 /* stream management */
 PsMuxStream *	psmux_create_stream 		(PsMux *mux, PsMuxStreamType stream_type);
@@ -262,21 +262,26 @@ psmux_stream_bytes_in_buffer (PsMuxStream * stream)
 /**
  * psmux_stream_get_data:
  * @stream: a #PsMuxStream
- * @buf: a buffer to hold the result
- * @len: the length of @buf
+ * @hdr: memory to hold the PES header, of at least PSMUX_PES_MAX_HDR_LEN bytes
+ * @len: the maximum length of the PES packet
+ * @payload: a buffer the payload memory is appended to
  *
- * Write a PES packet to @buf, up to @len bytes
+ * Write the header of a PES packet of up to @len bytes to @hdr, and append
+ * the memory of its payload to @payload. The payload is not copied but
+ * references the data of the queued buffers.
  *
- * Returns: number of bytes having been written, 0 if error
+ * Returns: length of the PES header, 0 if error
  */
 guint
-psmux_stream_get_data (PsMuxStream * stream, guint8 * buf, guint len)
+psmux_stream_get_data (PsMuxStream * stream, guint8 * hdr, guint len,
+    GstBuffer * payload)
 {
   guint8 pes_hdr_length;
   guint w;
 
   g_return_val_if_fail (stream != NULL, FALSE);
-  g_return_val_if_fail (buf != NULL, FALSE);
+  g_return_val_if_fail (hdr != NULL, FALSE);
+  g_return_val_if_fail (payload != NULL, FALSE);
   g_return_val_if_fail (len >= PSMUX_PES_MAX_HDR_LEN, FALSE);
 
   stream->cur_pes_payload_size =
@@ -306,14 +311,12 @@ psmux_stream_get_data (PsMuxStream * stream, guint8 * buf, guint len)
   /* write pes header */
   GST_LOG ("Writing PES header of length %u and payload %d",
       pes_hdr_length, stream->cur_pes_payload_size);
-  psmux_stream_write_pes_header (stream, buf);
+  psmux_stream_write_pes_header (stream, hdr);
 
-  buf += pes_hdr_length;
   w = stream->cur_pes_payload_size;     /* number of bytes of payload to write */
 
   while (w > 0) {
     guint32 avail;
-    guint8 *cur;
 
     if (stream->cur_buffer == NULL) {
       /* Start next packet */
@@ -324,23 +327,15 @@ psmux_stream_get_data (PsMuxStream * stream, guint8 * buf, guint len)
     }
 
     /* Take as much as we can from the current buffer */
-    avail = stream->cur_buffer->map.size - stream->cur_buffer_consumed;
-    cur = stream->cur_buffer->map.data + stream->cur_buffer_consumed;
-    if (avail < w) {
-      memcpy (buf, cur, avail);
-      psmux_stream_consume (stream, avail);
-
-      buf += avail;
-      w -= avail;
-    } else {
-      memcpy (buf, cur, w);
-      psmux_stream_consume (stream, w);
-
-      w = 0;
-    }
+    avail = MIN (stream->cur_buffer->map.size - stream->cur_buffer_consumed, w);
+    gst_buffer_copy_into (payload, stream->cur_buffer->buf,
+        GST_BUFFER_COPY_MEMORY, stream->cur_buffer_consumed, avail);
+    psmux_stream_consume (stream, avail);
+
+    w -= avail;
   }
 
-  return pes_hdr_length + stream->cur_pes_payload_size;
+  return pes_hdr_length;
 }
 
 static guint8
@@ -148,8 +148,9 @@ gint 		psmux_stream_bytes_in_buffer 	(PsMuxStream *stream);
 /* number of bytes of raw data available for writing */
 gint 		psmux_stream_bytes_avail 	(PsMuxStream *stream);
 
-/* write PES data */
-guint	 	psmux_stream_get_data 		(PsMuxStream *stream, guint8 *buf, guint len);
+/* write PES header and reference the payload */
+guint	 	psmux_stream_get_data 		(PsMuxStream *stream, guint8 *hdr, guint len,
+						 GstBuffer *payload);
 
 /* write corresponding descriptors of the stream */
 void 		psmux_stream_get_es_descrs 	(PsMuxStream *stream, guint8 *buf, guint16 *len);
@@ -1456,10 +1456,65 @@ mxf_aes_bwf_create_caps (MXFMetadataTimelineTrack * track, GstTagList ** tags,
   return NULL;
 }
 
+/* Clip-wrapped uncompressed Wave audio is just the samples back to back, so
+ * every edit unit can be found from the sample rate alone */
+static gboolean
+mxf_aes_bwf_get_edit_unit_range (const MXFMetadataTimelineTrack * track,
+    gint64 position, guint64 * offset, guint64 * size)
+{
+  MXFMetadataGenericSoundEssenceDescriptor *s = NULL;
+  guint block_align;
+  guint64 num, denom, first, last;
+  guint i;
+
+  g_return_val_if_fail (track != NULL, FALSE);
+
+  for (i = 0; i < track->parent.n_descriptor; i++) {
+    if (track->parent.descriptor[i]
+        && MXF_IS_METADATA_GENERIC_SOUND_ESSENCE_DESCRIPTOR (track->parent.
+            descriptor[i])
+        && track->parent.descriptor[i]->essence_container.u[14] == 0x02) {
+      s = (MXFMetadataGenericSoundEssenceDescriptor *) track->parent.
+          descriptor[i];
+      break;
+    }
+  }
+
+  if (!s || !(mxf_ul_is_zero (&s->sound_essence_compression) ||
+          mxf_ul_is_subclass (&mxf_sound_essence_compression_uncompressed,
+              &s->sound_essence_compression) ||
+          mxf_ul_is_subclass (&mxf_sound_essence_compression_s24le,
+              &s->sound_essence_compression)))
+    return FALSE;
+
+  if (s->channel_count == 0 || s->quantization_bits == 0 ||
+      s->audio_sampling_rate.n <= 0 || s->audio_sampling_rate.d <= 0 ||
+      track->edit_rate.n <= 0 || track->edit_rate.d <= 0 || position < 0)
+    return FALSE;
+
+  if (MXF_IS_METADATA_WAVE_AUDIO_ESSENCE_DESCRIPTOR (s)
+      && MXF_METADATA_WAVE_AUDIO_ESSENCE_DESCRIPTOR (s)->block_align != 0)
+    block_align = MXF_METADATA_WAVE_AUDIO_ESSENCE_DESCRIPTOR (s)->block_align;
+  else
+    block_align = (GST_ROUND_UP_8 (s->quantization_bits) * s->channel_count) / 8;
+
+  /* Samples per edit unit don't need to be integer, e.g. 48kHz at 30000/1001 */
+  num = (guint64) s->audio_sampling_rate.n * track->edit_rate.d;
+  denom = (guint64) s->audio_sampling_rate.d * track->edit_rate.n;
+  first = gst_util_uint64_scale (position, num, denom);
+  last = gst_util_uint64_scale (position + 1, num, denom);
+
+  *offset = first * block_align;
+  *size = (last - first) * block_align;
+
+  return TRUE;
+}
+
 static const MXFEssenceElementHandler mxf_aes_bwf_essence_handler = {
   mxf_is_aes_bwf_essence_track,
   mxf_aes_bwf_get_track_wrapping,
-  mxf_aes_bwf_create_caps
+  mxf_aes_bwf_create_caps,
+  mxf_aes_bwf_get_edit_unit_range
 };
 
 typedef struct
@@ -0,0 +1,240 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Conversion of the 8-channel AES3 element of SMPTE 331M to raw audio.
+ *
+ * Every sample of the element carries all 8 channels as little endian
+ * 32 bit words, of which bits 4-27 are the audio sample and the others
+ * status data. The first 4 or 8 channels of a sample are converted at once
+ * with SSE2, SSSE3 (selected at runtime) or NEON when available. The
+ * vector stores write a few bytes past the channels of the sample, which
+ * are overwritten by the next sample, so the last samples that would
+ * write past the output are left to the scalar version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "mxfaes3.h"
+#include <gst/gst-cpu-features-private.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AES3_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef GST_CPU_HAVE_TARGET_ATTRIBUTE
+#define AES3_USE_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AES3_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void
+aes3_to_s16_scalar (const guint8 * in, guint8 * out, guint i, guint nsamples,
+    guint channels)
+{
+  guint j;
+
+  for (; i < nsamples; i++) {
+    const guint8 *s = in + i * MXF_AES3_SAMPLE_SIZE;
+    guint8 *d = out + i * channels * 2;
+
+    for (j = 0; j < channels; j++)
+      GST_WRITE_UINT16_LE (d + 2 * j, GST_READ_UINT32_LE (s + 4 * j) >> 12);
+  }
+}
+
+static void
+aes3_to_s24_scalar (const guint8 * in, guint8 * out, guint i, guint nsamples,
+    guint channels)
+{
+  guint j;
+
+  for (; i < nsamples; i++) {
+    const guint8 *s = in + i * MXF_AES3_SAMPLE_SIZE;
+    guint8 *d = out + i * channels * 3;
+
+    for (j = 0; j < channels; j++)
+      GST_WRITE_UINT24_LE (d + 3 * j, GST_READ_UINT32_LE (s + 4 * j) >> 4);
+  }
+}
+
+/* Number of samples that can be converted with stores of @store_size bytes
+ * without writing past the end of the output */
+static inline guint
+aes3_vector_samples (guint nsamples, guint sample_size, guint store_size)
+{
+  guint total = nsamples * sample_size;
+
+  if (total < store_size)
+    return 0;
+
+  return MIN ((total - store_size) / sample_size + 1, nsamples);
+}
+
+#ifdef AES3_USE_SSE2
+/* Shifting left by 4 and then arithmetically right by 16 leaves bits
+ * 12-27 as a sign extended 16 bit value, which packs without saturation */
+static void
+aes3_to_s16_sse2 (const guint8 * in, guint8 * out, guint nsamples,
+    guint channels)
+{
+  guint i, n;
+
+  if (channels <= 4) {
+    n = aes3_vector_samples (nsamples, channels * 2, 8);
+    for (i = 0; i < n; i++) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (in + i * 32));
+
+      a = _mm_srai_epi32 (_mm_slli_epi32 (a, 4), 16);
+      _mm_storel_epi64 ((__m128i *) (out + i * channels * 2),
+          _mm_packs_epi32 (a, a));
+    }
+  } else {
+    n = aes3_vector_samples (nsamples, channels * 2, 16);
+    for (i = 0; i < n; i++) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (in + i * 32));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (in + i * 32 + 16));
+
+      a = _mm_srai_epi32 (_mm_slli_epi32 (a, 4), 16);
+      b = _mm_srai_epi32 (_mm_slli_epi32 (b, 4), 16);
+      _mm_storeu_si128 ((__m128i *) (out + i * channels * 2),
+          _mm_packs_epi32 (a, b));
+    }
+  }
+
+  aes3_to_s16_scalar (in, out, n, nsamples, channels);
+}
+#endif
+
+#ifdef AES3_USE_SSSE3
+static gboolean
+aes3_cpu_has_ssse3 (void)
+{
+  static gsize init = 0;
+  static gboolean has_ssse3 = FALSE;
+
+  if (g_once_init_enter (&init)) {
+    has_ssse3 = (gst_cpu_get_features () & GST_CPU_FEATURE_SSSE3) != 0;
+    g_once_init_leave (&init, 1);
+  }
+
+  return has_ssse3;
+}
+
+/* After shifting every word right by 4 the sample is in its 3 lower bytes,
+ * which are gathered into the first 12 bytes of the vector */
+__attribute__ ((target ("ssse3")))
+static void
+aes3_to_s24_ssse3 (const guint8 * in, guint8 * out, guint nsamples,
+    guint channels)
+{
+  const __m128i shuffle = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13,
+      14, -1, -1, -1, -1);
+  guint i, n;
+
+  if (channels <= 4) {
+    n = aes3_vector_samples (nsamples, channels * 3, 16);
+    for (i = 0; i < n; i++) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (in + i * 32));
+
+      a = _mm_shuffle_epi8 (_mm_srli_epi32 (a, 4), shuffle);
+      _mm_storeu_si128 ((__m128i *) (out + i * channels * 3), a);
+    }
+  } else {
+    n = aes3_vector_samples (nsamples, channels * 3, 28);
+    for (i = 0; i < n; i++) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (in + i * 32));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (in + i * 32 + 16));
+      guint8 *d = out + i * channels * 3;
+
+      a = _mm_shuffle_epi8 (_mm_srli_epi32 (a, 4), shuffle);
+      b = _mm_shuffle_epi8 (_mm_srli_epi32 (b, 4), shuffle);
+      _mm_storeu_si128 ((__m128i *) d, a);
+      _mm_storeu_si128 ((__m128i *) (d + 12), b);
+    }
+  }
+
+  aes3_to_s24_scalar (in, out, n, nsamples, channels);
+}
+#endif
+
+#ifdef AES3_USE_NEON
+static void
+aes3_to_s16_neon (const guint8 * in, guint8 * out, guint nsamples,
+    guint channels)
+{
+  guint i, n;
+
+  if (channels <= 4) {
+    n = aes3_vector_samples (nsamples, channels * 2, 8);
+    for (i = 0; i < n; i++) {
+      uint32x4_t a = vreinterpretq_u32_u8 (vld1q_u8 (in + i * 32));
+
+      vst1_u8 (out + i * channels * 2,
+          vreinterpret_u8_u16 (vshrn_n_u32 (a, 12)));
+    }
+  } else {
+    n = aes3_vector_samples (nsamples, channels * 2, 16);
+    for (i = 0; i < n; i++) {
+      uint32x4_t a = vreinterpretq_u32_u8 (vld1q_u8 (in + i * 32));
+      uint32x4_t b = vreinterpretq_u32_u8 (vld1q_u8 (in + i * 32 + 16));
+
+      vst1q_u8 (out + i * channels * 2,
+          vreinterpretq_u8_u16 (vcombine_u16 (vshrn_n_u32 (a, 12),
+                  vshrn_n_u32 (b, 12))));
+    }
+  }
+
+  aes3_to_s16_scalar (in, out, n, nsamples, channels);
+}
+#endif
+
+/* Converts @nsamples samples of the AES3 element data at @in, without its
+ * 4 byte header, to @channels channels of interleaved little endian
+ * samples of @width bytes at @out */
+void
+mxf_aes3_to_pcm (const guint8 * in, guint8 * out, guint nsamples,
+    guint channels, guint width)
+{
+  g_return_if_fail (channels > 0 && channels <= MXF_AES3_MAX_CHANNELS);
+  g_return_if_fail (width == 2 || width == 3);
+
+  if (width == 2) {
+#if defined(AES3_USE_SSE2)
+    aes3_to_s16_sse2 (in, out, nsamples, channels);
+#elif defined(AES3_USE_NEON)
+    aes3_to_s16_neon (in, out, nsamples, channels);
+#else
+    aes3_to_s16_scalar (in, out, 0, nsamples, channels);
+#endif
+  } else {
+#if defined(AES3_USE_SSSE3)
+    if (aes3_cpu_has_ssse3 ()) {
+      aes3_to_s24_ssse3 (in, out, nsamples, channels);
+      return;
+    }
+#endif
+    aes3_to_s24_scalar (in, out, 0, nsamples, channels);
+  }
+}
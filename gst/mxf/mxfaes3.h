@@ -0,0 +1,32 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Conversion of the 8-channel AES3 element of SMPTE 331M to raw audio */
+
+#ifndef __MXF_AES3_H__
+#define __MXF_AES3_H__
+
+#include <gst/gst.h>
+
+#define MXF_AES3_MAX_CHANNELS 8
+#define MXF_AES3_SAMPLE_SIZE (4 * MXF_AES3_MAX_CHANNELS)
+
+void mxf_aes3_to_pcm (const guint8 * in, guint8 * out, guint nsamples,
+    guint channels, guint width);
+
+#endif /* __MXF_AES3_H__ */
@@ -31,6 +31,7 @@
 
 #include "mxfd10.h"
 
+#include "mxfaes3.h"
 #include "mxfmpeg.h"
 #include "mxfessence.h"
 
@@ -99,9 +100,7 @@ mxf_d10_sound_handle_essence_element (const MXFUL * key, GstBuffer * buffer,
     MXFMetadataTimelineTrack * track,
     gpointer mapping_data, GstBuffer ** outbuf)
 {
-  guint i, j, nsamples;
-  const guint8 *indata;
-  guint8 *outdata;
+  guint nsamples;
   GstMapInfo map;
   GstMapInfo outmap;
   MXFD10AudioMappingData *data = mapping_data;
@@ -119,7 +118,7 @@ mxf_d10_sound_handle_essence_element (const MXFUL * key, GstBuffer * buffer,
   gst_buffer_map (buffer, &map, GST_MAP_READ);
 
   /* Now transform raw AES3 into raw audio, see SMPTE 331M */
-  if ((map.size - 4) % 32 != 0) {
+  if (map.size < 4 || (map.size - 4) % 32 != 0) {
     gst_buffer_unmap (buffer, &map);
     GST_ERROR ("Invalid D10 sound essence buffer size");
     return GST_FLOW_ERROR;
@@ -131,33 +130,10 @@ mxf_d10_sound_handle_essence_element (const MXFUL * key, GstBuffer * buffer,
   gst_buffer_copy_into (*outbuf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
   gst_buffer_map (*outbuf, &outmap, GST_MAP_WRITE);
 
-  indata = map.data;
-  outdata = outmap.data;
-
-  /* Skip 32 bit header */
-  indata += 4;
-
-  for (i = 0; i < nsamples; i++) {
-    for (j = 0; j < data->channels; j++) {
-      guint32 in = GST_READ_UINT32_LE (indata);
-
-      /* Remove first 4 and last 4 bits as they only
-       * contain status data. Shift the 24 bit samples
-       * to the correct width afterwards. */
-      if (data->width == 2) {
-        in = (in >> 12) & 0xffff;
-        GST_WRITE_UINT16_LE (outdata, in);
-      } else if (data->width == 3) {
-        in = (in >> 4) & 0xffffff;
-        GST_WRITE_UINT24_LE (outdata, in);
-      }
-      indata += 4;
-      outdata += data->width;
-    }
-    /* There are always 8 channels but only the first
-     * ones contain valid data, skip the others */
-    indata += 4 * (8 - data->channels);
-  }
+  /* Skip 32 bit header. There are always 8 channels but only the first
+   * ones contain valid data */
+  mxf_aes3_to_pcm (map.data + 4, outmap.data, nsamples, data->channels,
+      data->width);
 
   gst_buffer_unmap (*outbuf, &outmap);
   gst_buffer_unmap (buffer, &map);
@@ -229,6 +205,11 @@ mxf_d10_create_caps (MXFMetadataTimelineTrack * track, GstTagList ** tags,
       return NULL;
     }
 
+    if (s->channel_count > MXF_AES3_MAX_CHANNELS) {
+      GST_ERROR ("Invalid number of channels %u", s->channel_count);
+      return NULL;
+    }
+
     /* FIXME: set channel layout */
 
     audio_format =
@@ -34,7 +34,7 @@
  *   - Handle timecode tracks correctly (where is this documented?)
  *   - Handle drop-frame field of timecode tracks
  *   - Handle Generic container system items
- *   - Implement correct support for clip-wrapped essence elements.
+ *   - Support clip-wrapped essence elements in push mode.
  *   - Post structural metadata and descriptive metadata trees as a message on the bus
  *     and send them downstream as event.
  *   - Multichannel audio needs channel layouts, define them (SMPTE S320M?).
@@ -71,6 +71,9 @@ GST_STATIC_PAD_TEMPLATE ("track_%u",
 GST_DEBUG_CATEGORY_STATIC (mxfdemux_debug);
 #define GST_CAT_DEFAULT mxfdemux_debug
 
+static GstFlowReturn
+gst_mxf_demux_peek_klv_packet (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * data_offset, guint64 * length);
 static GstFlowReturn
 gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
     GstBuffer ** outbuf, guint * read);
@@ -79,6 +82,16 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer, guint64 offset);
 
 static void collect_index_table_segments (GstMXFDemux * demux);
+static gboolean gst_mxf_demux_merge_index_table_segments (GstMXFDemux * demux);
+static gboolean gst_mxf_demux_refresh_index (GstMXFDemux * demux);
+static gboolean gst_mxf_demux_wait_for_growth (GstMXFDemux * demux);
+static void gst_mxf_demux_set_growth_cancelled (GstMXFDemux * demux,
+    gboolean cancelled);
+
+/* How long to wait for a growing file before looking at it again */
+#define GROWING_FILE_POLL_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+#define DEFAULT_GROWING_FILE FALSE
+#define DEFAULT_LAZY_METADATA FALSE
 
 GType gst_mxf_demux_pad_get_type (void);
 G_DEFINE_TYPE (GstMXFDemuxPad, gst_mxf_demux_pad, GST_TYPE_PAD);
@@ -115,7 +128,9 @@ enum
   PROP_0,
   PROP_PACKAGE,
   PROP_MAX_DRIFT,
-  PROP_STRUCTURE
+  PROP_STRUCTURE,
+  PROP_GROWING_FILE,
+  PROP_LAZY_METADATA
 };
 
 static gboolean gst_mxf_demux_sink_event (GstPad * pad, GstObject * parent,
@@ -148,6 +163,8 @@ gst_mxf_demux_partition_free (GstMXFDemuxPartition * partition)
 {
   mxf_partition_pack_reset (&partition->partition);
   mxf_primer_pack_reset (&partition->primer);
+  if (partition->metadata)
+    gst_buffer_unref (partition->metadata);
 
   g_free (partition);
 }
@@ -173,6 +190,9 @@ gst_mxf_demux_reset_mxf_state (GstMXFDemux * demux)
     if (t->offsets)
       g_array_free (t->offsets, TRUE);
 
+    if (t->clips)
+      g_array_free (t->clips, TRUE);
+
     g_free (t->mapping_data);
 
     if (t->tags)
@@ -182,6 +202,7 @@ gst_mxf_demux_reset_mxf_state (GstMXFDemux * demux)
       gst_caps_unref (t->caps);
   }
   g_array_set_size (demux->essence_tracks, 0);
+  demux->have_clip_wrapped_tracks = FALSE;
 }
 
 static void
@@ -292,6 +313,7 @@ gst_mxf_demux_reset (GstMXFDemux * demux)
   }
 
   demux->index_table_segments_collected = FALSE;
+  demux->index_scan_offset = 0;
 
   gst_mxf_demux_reset_mxf_state (demux);
   gst_mxf_demux_reset_metadata (demux);
@@ -520,6 +542,10 @@ gst_mxf_demux_resolve_references (GstMXFDemux * demux)
   while (g_hash_table_iter_next (&iter, NULL, (gpointer) & m)) {
     gboolean resolved;
 
+    /* Deferred metadata is resolved when something references it */
+    if (mxf_metadata_base_is_deferred (m))
+      continue;
+
     resolved = mxf_metadata_base_resolve (m, demux->metadata);
 
     /* Resolving can fail for anything but the preface, as the preface
@@ -664,6 +690,8 @@ gst_mxf_demux_update_essence_tracks (GstMXFDemux * demux)
   g_return_val_if_fail (demux->preface->content_storage->essence_container_data,
       GST_FLOW_ERROR);
 
+  demux->have_clip_wrapped_tracks = FALSE;
+
   for (i = 0; i < demux->preface->content_storage->n_essence_container_data;
       i++) {
     MXFMetadataEssenceContainerData *edata;
@@ -851,15 +879,20 @@ gst_mxf_demux_update_essence_tracks (GstMXFDemux * demux)
         MXFEssenceWrapping track_wrapping;
 
         track_wrapping = etrack->handler->get_track_wrapping (track);
-        if (track_wrapping == MXF_ESSENCE_WRAPPING_CLIP_WRAPPING) {
+        if (track_wrapping == MXF_ESSENCE_WRAPPING_CLIP_WRAPPING
+            && !demux->random_access) {
           GST_ELEMENT_ERROR (demux, STREAM, NOT_IMPLEMENTED, (NULL),
-              ("Clip essence wrapping is not implemented yet."));
+              ("Clip essence wrapping is only supported in pull mode."));
           return GST_FLOW_ERROR;
         } else if (track_wrapping == MXF_ESSENCE_WRAPPING_CUSTOM_WRAPPING) {
           GST_ELEMENT_ERROR (demux, STREAM, NOT_IMPLEMENTED, (NULL),
               ("Custom essence wrappings are not supported."));
           return GST_FLOW_ERROR;
         }
+
+        etrack->wrapping = track_wrapping;
+        if (track_wrapping == MXF_ESSENCE_WRAPPING_CLIP_WRAPPING)
+          demux->have_clip_wrapped_tracks = TRUE;
       }
 
       etrack->source_package = package;
@@ -1304,6 +1337,16 @@ gst_mxf_demux_handle_metadata (GstMXFDemux * demux, const MXFUL * key,
     return GST_FLOW_OK;
   }
 
+  /* While a file is written, the header metadata that was resolved first
+   * stays in use. The metadata repeated in body partitions and in the
+   * footer is skipped, as re-resolving it would set up the streams again
+   * for every partition */
+  if (demux->growing_file && demux->metadata_resolved
+      && demux->current_partition->partition.type != MXF_PARTITION_PACK_HEADER) {
+    GST_DEBUG_OBJECT (demux, "Growing file, keeping header metadata");
+    return GST_FLOW_OK;
+  }
+
   gst_buffer_map (buffer, &map, GST_MAP_READ);
   metadata =
       mxf_metadata_new (type, &demux->current_partition->primer, demux->offset,
@@ -1363,6 +1406,39 @@ gst_mxf_demux_handle_metadata (GstMXFDemux * demux, const MXFUL * key,
   return ret;
 }
 
+/* Returns where the value of @size bytes of the KLV packet at the current
+ * offset starts in the header metadata pulled for the current partition, or
+ * -1 if it's not part of it */
+static gint64
+gst_mxf_demux_partition_metadata_value_offset (GstMXFDemux * demux,
+    gsize size)
+{
+  GstMXFDemuxPartition *p = demux->current_partition;
+  GstMapInfo map;
+  guint64 pos;
+  gint64 ret = -1;
+
+  if (!p->metadata || demux->offset < p->metadata_offset)
+    return -1;
+
+  pos = demux->offset - p->metadata_offset;
+
+  gst_buffer_map (p->metadata, &map, GST_MAP_READ);
+  if (pos + 17 <= map.size) {
+    /* skip the key and the BER encoded length */
+    if (map.data[pos + 16] & 0x80)
+      pos += 17 + (map.data[pos + 16] & 0x7f);
+    else
+      pos += 17;
+
+    if (pos + size <= map.size)
+      ret = pos;
+  }
+  gst_buffer_unmap (p->metadata, &map);
+
+  return ret;
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer)
@@ -1396,10 +1472,26 @@ gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
     return GST_FLOW_OK;
   }
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  m = mxf_descriptive_metadata_new (scheme, type,
-      &demux->current_partition->primer, demux->offset, map.data, map.size);
-  gst_buffer_unmap (buffer, &map);
+  if (demux->lazy_metadata) {
+    GstMXFDemuxPartition *p = demux->current_partition;
+    gsize size = gst_buffer_get_size (buffer);
+    gint64 value_offset =
+        gst_mxf_demux_partition_metadata_value_offset (demux, size);
+
+    /* The set is only parsed once it's used, until then it keeps its
+     * position in the partition's header metadata */
+    if (value_offset != -1)
+      m = mxf_descriptive_metadata_new_deferred (scheme, type, &p->primer,
+          demux->offset, p->metadata, value_offset, size);
+    else
+      m = mxf_descriptive_metadata_new_deferred (scheme, type, &p->primer,
+          demux->offset, buffer, 0, size);
+  } else {
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    m = mxf_descriptive_metadata_new (scheme, type,
+        &demux->current_partition->primer, demux->offset, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+  }
 
   if (!m) {
     GST_WARNING_OBJECT (demux,
@@ -1607,12 +1699,90 @@ gst_mxf_demux_pad_set_component (GstMXFDemux * demux, GstMXFDemuxPad * pad,
   return ret;
 }
 
+static GstMXFDemuxIndexTable *
+gst_mxf_demux_find_index_table (GstMXFDemux * demux, guint32 body_sid,
+    guint32 index_sid)
+{
+  GList *l;
+
+  for (l = demux->index_tables; l; l = l->next) {
+    GstMXFDemuxIndexTable *tmp = l->data;
+
+    if (tmp->body_sid == body_sid && tmp->index_sid == index_sid)
+      return tmp;
+  }
+
+  return NULL;
+}
+
+/* The offsets of the edit units of a track only grow, so the edit unit at
+ * a given offset can be found by bisection. Holes are edit units whose
+ * offset isn't known yet */
+static gint64
+find_edit_unit_for_offset (GArray * offsets, guint64 offset)
+{
+  gint64 lo = 0, hi;
+
+  if (!offsets)
+    return -1;
+
+  hi = (gint64) offsets->len - 1;
+  while (lo <= hi) {
+    gint64 mid = lo + (hi - lo) / 2;
+    gint64 probe = mid;
+    GstMXFDemuxIndex *idx;
+
+    while (probe >= lo
+        && g_array_index (offsets, GstMXFDemuxIndex, probe).offset == 0)
+      probe--;
+
+    if (probe < lo) {
+      lo = mid + 1;
+      continue;
+    }
+
+    idx = &g_array_index (offsets, GstMXFDemuxIndex, probe);
+    if (idx->offset == offset)
+      return probe;
+    else if (idx->offset < offset)
+      lo = mid + 1;
+    else
+      hi = probe - 1;
+  }
+
+  return -1;
+}
+
+/* Returns the essence track of the essence element with @key in the current
+ * partition */
+static GstMXFDemuxEssenceTrack *
+gst_mxf_demux_find_essence_track (GstMXFDemux * demux, const MXFUL * key)
+{
+  guint32 track_number;
+  guint i;
+
+  if (!demux->current_partition)
+    return NULL;
+
+  track_number = GST_READ_UINT32_BE (&key->u[12]);
+
+  for (i = 0; i < demux->essence_tracks->len; i++) {
+    GstMXFDemuxEssenceTrack *tmp =
+        &g_array_index (demux->essence_tracks, GstMXFDemuxEssenceTrack, i);
+
+    if (tmp->body_sid == demux->current_partition->partition.body_sid &&
+        (tmp->track_number == track_number || tmp->track_number == 0))
+      return tmp;
+  }
+
+  return NULL;
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer, gboolean peek)
 {
   GstFlowReturn ret = GST_FLOW_OK;
-  guint32 track_number;
   guint i;
   GstBuffer *inbuf = NULL;
   GstBuffer *outbuf = NULL;
@@ -1649,19 +1819,7 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
     return GST_FLOW_ERROR;
   }
 
-  track_number = GST_READ_UINT32_BE (&key->u[12]);
-
-  for (i = 0; i < demux->essence_tracks->len; i++) {
-    GstMXFDemuxEssenceTrack *tmp =
-        &g_array_index (demux->essence_tracks, GstMXFDemuxEssenceTrack, i);
-
-    if (tmp->body_sid == demux->current_partition->partition.body_sid &&
-        (tmp->track_number == track_number || tmp->track_number == 0)) {
-      etrack = tmp;
-      break;
-    }
-  }
-
+  etrack = gst_mxf_demux_find_essence_track (demux, key);
   if (!etrack) {
     GST_WARNING_OBJECT (demux,
         "No essence track for this essence element found");
@@ -1671,17 +1829,8 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
   if (etrack->position == -1) {
     GST_DEBUG_OBJECT (demux,
         "Unknown essence track position, looking into index");
-    if (etrack->offsets) {
-      for (i = 0; i < etrack->offsets->len; i++) {
-        GstMXFDemuxIndex *idx =
-            &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
-
-        if (idx->offset != 0 && idx->offset == demux->offset - demux->run_in) {
-          etrack->position = i;
-          break;
-        }
-      }
-    }
+    etrack->position = find_edit_unit_for_offset (etrack->offsets,
+        demux->offset - demux->run_in);
 
     if (etrack->position == -1) {
       GST_WARNING_OBJECT (demux, "Essence track position not in index");
@@ -1730,18 +1879,9 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
 
   /* Prefer keyframe information from index tables over everything else */
   if (demux->index_tables && outbuf) {
-    GList *l;
-    GstMXFDemuxIndexTable *index_table = NULL;
-
-    for (l = demux->index_tables; l; l = l->next) {
-      GstMXFDemuxIndexTable *tmp = l->data;
-
-      if (tmp->body_sid == etrack->body_sid
-          && tmp->index_sid == etrack->index_sid) {
-        index_table = tmp;
-        break;
-      }
-    }
+    GstMXFDemuxIndexTable *index_table =
+        gst_mxf_demux_find_index_table (demux, etrack->body_sid,
+        etrack->index_sid);
 
     if (index_table && index_table->offsets->len > etrack->position) {
       GstMXFDemuxIndex *index =
@@ -1947,7 +2087,8 @@ read_partition_header (GstMXFDemux * demux)
 {
   GstBuffer *buf;
   MXFUL key;
-  guint read;
+  guint read, data_offset;
+  guint64 length;
 
   if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
       != GST_FLOW_OK)
@@ -1965,42 +2106,44 @@ read_partition_header (GstMXFDemux * demux)
   demux->offset += read;
   gst_buffer_unref (buf);
 
-  if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
-      != GST_FLOW_OK)
+  /* Only the index table segments are pulled completely, everything else
+   * can be arbitrarily large, e.g. clip-wrapped essence */
+  if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key, &data_offset,
+          &length) != GST_FLOW_OK)
     return;
 
   while (mxf_is_fill (&key)) {
-    demux->offset += read;
-    gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
-        != GST_FLOW_OK)
+    demux->offset += data_offset + length;
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key,
+            &data_offset, &length) != GST_FLOW_OK)
       return;
   }
 
   if (!mxf_is_index_table_segment (&key)
       && demux->current_partition->partition.header_byte_count) {
-    gst_buffer_unref (buf);
     demux->offset += demux->current_partition->partition.header_byte_count;
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
-        != GST_FLOW_OK)
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key,
+            &data_offset, &length) != GST_FLOW_OK)
       return;
   }
 
   while (mxf_is_index_table_segment (&key)) {
+    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf,
+            &read) != GST_FLOW_OK)
+      return;
     gst_mxf_demux_handle_index_table_segment (demux, &key, buf, demux->offset);
     demux->offset += read;
-
     gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
-        != GST_FLOW_OK)
+
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key,
+            &data_offset, &length) != GST_FLOW_OK)
       return;
   }
 
   while (mxf_is_fill (&key)) {
-    demux->offset += read;
-    gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buf, &read)
-        != GST_FLOW_OK)
+    demux->offset += data_offset + length;
+    if (gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key,
+            &data_offset, &length) != GST_FLOW_OK)
       return;
   }
 
@@ -2012,8 +2155,6 @@ read_partition_header (GstMXFDemux * demux)
           demux->offset - demux->current_partition->partition.this_partition -
           demux->run_in;
   }
-
-  gst_buffer_unref (buf);
 }
 
 static GstFlowReturn
@@ -2118,14 +2259,54 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
   return GST_FLOW_OK;
 }
 
+/* Reads the key and length of the KLV packet at @offset without pulling its
+ * value. @data_offset is set to the size of the key and length */
+/* With lazy-metadata, the header metadata of a partition is pulled in one go
+ * when its primer pack is read. The metadata sets are then taken from it
+ * without copying, and deferred ones only keep their position in it */
+static void
+gst_mxf_demux_pull_partition_metadata (GstMXFDemux * demux, guint64 offset)
+{
+  GstMXFDemuxPartition *p = demux->current_partition;
+
+  if (!p || p->metadata || p->partition.header_byte_count == 0
+      || p->partition.header_byte_count > G_MAXUINT)
+    return;
+
+  /* The header byte count starts after the partition pack, so this might
+   * also include a bit of what follows the header metadata */
+  if (gst_mxf_demux_pull_range (demux, offset, p->partition.header_byte_count,
+          &p->metadata) != GST_FLOW_OK)
+    return;
+
+  p->metadata_offset = offset;
+}
+
+/* Like gst_mxf_demux_pull_range(), but takes the data from the header
+ * metadata pulled for the current partition if it's part of it */
 static GstFlowReturn
-gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
-    GstBuffer ** outbuf, guint * read)
+gst_mxf_demux_pull_klv_range (GstMXFDemux * demux, guint64 offset,
+    guint size, GstBuffer ** buffer)
+{
+  GstMXFDemuxPartition *p = demux->current_partition;
+
+  if (p && p->metadata && offset >= p->metadata_offset
+      && offset + size <=
+      p->metadata_offset + gst_buffer_get_size (p->metadata)) {
+    *buffer = gst_buffer_copy_region (p->metadata, GST_BUFFER_COPY_ALL,
+        offset - p->metadata_offset, size);
+    return GST_FLOW_OK;
+  }
+
+  return gst_mxf_demux_pull_range (demux, offset, size, buffer);
+}
+
+static GstFlowReturn
+gst_mxf_demux_peek_klv_packet (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * data_offset, guint64 * length)
 {
   GstBuffer *buffer = NULL;
   const guint8 *data;
-  guint64 data_offset = 0;
-  guint64 length;
   GstFlowReturn ret = GST_FLOW_OK;
   GstMapInfo map;
 #ifndef GST_DISABLE_GST_DEBUG
@@ -2135,8 +2316,8 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
   memset (key, 0, sizeof (MXFUL));
 
   /* Pull 16 byte key and first byte of BER encoded length */
-  if ((ret =
-          gst_mxf_demux_pull_range (demux, offset, 17, &buffer)) != GST_FLOW_OK)
+  if ((ret = gst_mxf_demux_pull_klv_range (demux, offset, 17,
+              &buffer)) != GST_FLOW_OK)
     goto beach;
 
   gst_buffer_map (buffer, &map, GST_MAP_READ);
@@ -2148,12 +2329,12 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
 
   /* Decode BER encoded packet length */
   if ((map.data[16] & 0x80) == 0) {
-    length = map.data[16];
-    data_offset = 17;
+    *length = map.data[16];
+    *data_offset = 17;
   } else {
     guint slen = map.data[16] & 0x7f;
 
-    data_offset = 16 + 1 + slen;
+    *data_offset = 16 + 1 + slen;
 
     gst_buffer_unmap (buffer, &map);
     gst_buffer_unref (buffer);
@@ -2167,51 +2348,69 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
     }
 
     /* Now pull the length of the packet */
-    if ((ret = gst_mxf_demux_pull_range (demux, offset + 17, slen,
+    if ((ret = gst_mxf_demux_pull_klv_range (demux, offset + 17, slen,
                 &buffer)) != GST_FLOW_OK)
       goto beach;
 
     gst_buffer_map (buffer, &map, GST_MAP_READ);
 
     data = map.data;
-    length = 0;
+    *length = 0;
     while (slen) {
-      length = (length << 8) | *data;
+      *length = (*length << 8) | *data;
       data++;
       slen--;
     }
   }
 
   gst_buffer_unmap (buffer, &map);
-  gst_buffer_unref (buffer);
-  buffer = NULL;
+
+beach:
+  if (buffer)
+    gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
+    GstBuffer ** outbuf, guint * read)
+{
+  GstBuffer *buffer = NULL;
+  guint data_offset = 0;
+  guint64 length;
+  GstFlowReturn ret = GST_FLOW_OK;
+#ifndef GST_DISABLE_GST_DEBUG
+  gchar str[48];
+#endif
+
+  if ((ret = gst_mxf_demux_peek_klv_packet (demux, offset, key, &data_offset,
+              &length)) != GST_FLOW_OK)
+    return ret;
 
   /* GStreamer's buffer sizes are stored in a guint so we
    * limit ourself to G_MAXUINT large buffers */
   if (length > G_MAXUINT) {
     GST_ERROR_OBJECT (demux,
         "Unsupported KLV packet length: %" G_GUINT64_FORMAT, length);
-    ret = GST_FLOW_ERROR;
-    goto beach;
+    return GST_FLOW_ERROR;
   }
 
   GST_DEBUG_OBJECT (demux, "KLV packet with key %s has length "
       "%" G_GUINT64_FORMAT, mxf_ul_to_string (key, str), length);
 
+  if (demux->lazy_metadata && mxf_is_primer_pack (key))
+    gst_mxf_demux_pull_partition_metadata (demux, offset);
+
   /* Pull the complete KLV packet */
-  if ((ret = gst_mxf_demux_pull_range (demux, offset + data_offset, length,
+  if ((ret = gst_mxf_demux_pull_klv_range (demux, offset + data_offset, length,
               &buffer)) != GST_FLOW_OK)
-    goto beach;
+    return ret;
 
   *outbuf = buffer;
-  buffer = NULL;
   if (read)
     *read = data_offset + length;
 
-beach:
-  if (buffer)
-    gst_buffer_unref (buffer);
-
   return ret;
 }
 
@@ -2456,13 +2655,11 @@ out:
   demux->current_partition = old_partition;
 }
 
+/* Resolves the metadata and updates the tracks once all header metadata
+ * before the packet with @key was read */
 static GstFlowReturn
-gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
-    GstBuffer * buffer, gboolean peek)
+gst_mxf_demux_update_metadata (GstMXFDemux * demux, const MXFUL * key)
 {
-#ifndef GST_DISABLE_GST_DEBUG
-  gchar key_str[48];
-#endif
   GstFlowReturn ret = GST_FLOW_OK;
 
   if (demux->update_metadata
@@ -2474,16 +2671,27 @@ gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
           mxf_is_generic_container_essence_element (key) ||
           mxf_is_avid_essence_container_essence_element (key))) {
     demux->current_partition->parsed_metadata = TRUE;
-    if ((ret = gst_mxf_demux_resolve_references (demux)) != GST_FLOW_OK ||
-        (ret = gst_mxf_demux_update_tracks (demux)) != GST_FLOW_OK) {
-      goto beach;
-    }
+    if ((ret = gst_mxf_demux_resolve_references (demux)) == GST_FLOW_OK)
+      ret = gst_mxf_demux_update_tracks (demux);
   } else if (demux->metadata_resolved && demux->requested_package_string) {
-    if ((ret = gst_mxf_demux_update_tracks (demux)) != GST_FLOW_OK) {
-      goto beach;
-    }
+    ret = gst_mxf_demux_update_tracks (demux);
   }
 
+  return ret;
+}
+
+static GstFlowReturn
+gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
+    GstBuffer * buffer, gboolean peek)
+{
+#ifndef GST_DISABLE_GST_DEBUG
+  gchar key_str[48];
+#endif
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if ((ret = gst_mxf_demux_update_metadata (demux, key)) != GST_FLOW_OK)
+    goto beach;
+
   if (!mxf_is_mxf_packet (key)) {
     GST_WARNING_OBJECT (demux,
         "Skipping non-MXF packet of size %" G_GSIZE_FORMAT " at offset %"
@@ -2549,7 +2757,7 @@ gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
 
   /* In pull mode try to get the last metadata */
   if (mxf_is_partition_pack (key) && ret == GST_FLOW_OK
-      && demux->pull_footer_metadata
+      && demux->pull_footer_metadata && !demux->growing_file
       && demux->random_access && demux->current_partition
       && demux->current_partition->partition.type == MXF_PARTITION_PACK_HEADER
       && (!demux->current_partition->partition.closed
@@ -2657,6 +2865,309 @@ find_closest_offset (GArray * offsets, gint64 * position, gboolean keyframe)
   return -1;
 }
 
+/* Gets the byte range of edit unit @position of @etrack inside @clip,
+ * relative to the start of the clip's value. Index table entries are
+ * preferred, then the essence handler and then constant bytes per edit
+ * unit index table segments */
+static gboolean
+gst_mxf_demux_get_clip_edit_unit (GstMXFDemux * demux,
+    GstMXFDemuxEssenceTrack * etrack, const GstMXFDemuxClip * clip,
+    gint64 position, guint64 * offset, guint64 * size)
+{
+  GstMXFDemuxIndexTable *index_table;
+  guint64 value_start = clip->offset + clip->data_offset;
+  guint64 value_end = value_start + clip->length;
+
+  if (position < clip->start)
+    return FALSE;
+
+  index_table =
+      gst_mxf_demux_find_index_table (demux, etrack->body_sid,
+      etrack->index_sid);
+
+  if (index_table && index_table->offsets->len > position) {
+    GstMXFDemuxIndex *idx =
+        &g_array_index (index_table->offsets, GstMXFDemuxIndex, position);
+
+    if (idx->offset >= value_start && idx->offset < value_end) {
+      guint64 end = value_end;
+
+      if (index_table->offsets->len > position + 1) {
+        GstMXFDemuxIndex *next = idx + 1;
+
+        if (next->offset > idx->offset && next->offset < value_end)
+          end = next->offset;
+      }
+
+      *offset = idx->offset - value_start;
+      *size = end - idx->offset;
+      return TRUE;
+    }
+  }
+
+  if (etrack->handler && etrack->handler->get_edit_unit_range
+      && etrack->handler->get_edit_unit_range (etrack->source_track,
+          position - clip->start, offset, size)) {
+    /* nothing to do */
+  } else if (index_table && index_table->edit_unit_byte_count) {
+    *offset = (position - clip->start) * index_table->edit_unit_byte_count;
+    *size = index_table->edit_unit_byte_count;
+  } else {
+    return FALSE;
+  }
+
+  /* The last edit unit of a clip can be incomplete */
+  if (*offset >= clip->length || *size == 0)
+    return FALSE;
+  *size = MIN (*size, clip->length - *offset);
+
+  return TRUE;
+}
+
+/* Edit units are stored back to back in a clip, so the number of them in
+ * there can be found with an exponential search */
+static gint64
+gst_mxf_demux_get_clip_duration (GstMXFDemux * demux,
+    GstMXFDemuxEssenceTrack * etrack, const GstMXFDemuxClip * clip)
+{
+  guint64 offset, size;
+  gint64 lo = 0, hi = 1;
+
+  while (gst_mxf_demux_get_clip_edit_unit (demux, etrack, clip,
+          clip->start + hi - 1, &offset, &size)) {
+    lo = hi;
+    hi *= 2;
+  }
+
+  while (hi - lo > 1) {
+    gint64 mid = lo + (hi - lo) / 2;
+
+    if (gst_mxf_demux_get_clip_edit_unit (demux, etrack, clip,
+            clip->start + mid - 1, &offset, &size))
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static GstMXFDemuxClip *
+gst_mxf_demux_find_clip (GstMXFDemuxEssenceTrack * etrack, gint64 position)
+{
+  guint i;
+
+  if (!etrack->clips)
+    return NULL;
+
+  for (i = 0; i < etrack->clips->len; i++) {
+    GstMXFDemuxClip *clip = &g_array_index (etrack->clips, GstMXFDemuxClip, i);
+
+    if (position >= clip->start && position < clip->start + clip->duration)
+      return clip;
+  }
+
+  return NULL;
+}
+
+/* Returns the clip of @etrack stored in the KLV packet at @offset,
+ * adding it if it wasn't known yet */
+static GstMXFDemuxClip *
+gst_mxf_demux_add_clip (GstMXFDemux * demux, GstMXFDemuxEssenceTrack * etrack,
+    guint64 offset, guint data_offset, guint64 length)
+{
+  GstMXFDemuxIndexTable *index_table;
+  GstMXFDemuxClip clip, *prev = NULL;
+  guint i;
+
+  if (!etrack->clips)
+    etrack->clips = g_array_new (FALSE, FALSE, sizeof (GstMXFDemuxClip));
+
+  for (i = 0; i < etrack->clips->len; i++) {
+    GstMXFDemuxClip *tmp = &g_array_index (etrack->clips, GstMXFDemuxClip, i);
+
+    if (tmp->offset == offset)
+      return tmp;
+    else if (tmp->offset > offset)
+      break;
+    prev = tmp;
+  }
+
+  clip.offset = offset;
+  clip.data_offset = data_offset;
+  clip.length = length;
+
+  /* Without an index the clip continues where the previous one ended */
+  index_table =
+      gst_mxf_demux_find_index_table (demux, etrack->body_sid,
+      etrack->index_sid);
+  clip.start =
+      index_table ? find_edit_unit_for_offset (index_table->offsets,
+      offset + data_offset) : -1;
+  if (clip.start == -1)
+    clip.start = prev ? prev->start + prev->duration : 0;
+  clip.duration = gst_mxf_demux_get_clip_duration (demux, etrack, &clip);
+
+  GST_DEBUG_OBJECT (demux,
+      "Clip of track %u at offset %" G_GUINT64_FORMAT " with edit units %"
+      G_GINT64_FORMAT " to %" G_GINT64_FORMAT, etrack->track_number, offset,
+      clip.start, clip.start + clip.duration);
+
+  g_array_insert_val (etrack->clips, i, clip);
+
+  return &g_array_index (etrack->clips, GstMXFDemuxClip, i);
+}
+
+/* Walks the KLV packets after the last known clip of @etrack, reading only
+ * their keys and lengths, until the clip containing @position shows up */
+static GstMXFDemuxClip *
+gst_mxf_demux_scan_for_clip (GstMXFDemux * demux,
+    GstMXFDemuxEssenceTrack * etrack, gint64 position)
+{
+  guint64 old_offset = demux->offset;
+  GstMXFDemuxPartition *old_partition = demux->current_partition;
+  GstMXFDemuxClip *clip = NULL;
+  guint64 offset = demux->run_in;
+
+  if (etrack->clips && etrack->clips->len > 0) {
+    GstMXFDemuxClip *last = &g_array_index (etrack->clips, GstMXFDemuxClip,
+        etrack->clips->len - 1);
+
+    offset = last->offset + last->data_offset + last->length + demux->run_in;
+  }
+
+  gst_mxf_demux_set_partition_for_offset (demux, offset);
+
+  while (!clip) {
+    MXFUL key;
+    guint data_offset;
+    guint64 length;
+
+    if (gst_mxf_demux_peek_klv_packet (demux, offset, &key, &data_offset,
+            &length) != GST_FLOW_OK)
+      break;
+
+    if (mxf_is_partition_pack (&key)) {
+      GList *l;
+      GstMXFDemuxPartition *partition = NULL;
+
+      for (l = demux->partitions; l; l = l->next) {
+        GstMXFDemuxPartition *p = l->data;
+
+        if (p->partition.this_partition + demux->run_in == offset
+            && p->partition.major_version == 0x0001) {
+          partition = p;
+          break;
+        }
+      }
+
+      if (!partition) {
+        demux->offset = offset;
+        read_partition_header (demux);
+        offset = MAX (offset + data_offset + length, demux->offset);
+        continue;
+      }
+
+      demux->current_partition = partition;
+    } else if (mxf_is_generic_container_essence_element (&key)
+        && gst_mxf_demux_find_essence_track (demux, &key) == etrack) {
+      GstMXFDemuxClip *tmp = gst_mxf_demux_add_clip (demux, etrack,
+          offset - demux->run_in, data_offset, length);
+
+      if (position >= tmp->start && position < tmp->start + tmp->duration)
+        clip = tmp;
+    }
+
+    offset += data_offset + length;
+  }
+
+  demux->offset = old_offset;
+  demux->current_partition = old_partition;
+
+  return clip;
+}
+
+/* Pulls and handles the next edit unit of the clip-wrapped essence element
+ * at the current offset, moving to the next KLV packet once all edit units
+ * of the clip were handled. Only ever pulls one edit unit at once */
+static GstFlowReturn
+gst_mxf_demux_handle_clip_wrapped_essence (GstMXFDemux * demux,
+    GstMXFDemuxEssenceTrack * etrack, const MXFUL * key, guint data_offset,
+    guint64 length)
+{
+  GstMXFDemuxClip *clip;
+  GstBuffer *buffer = NULL;
+  guint64 offset, size;
+  gint64 clip_end;
+  GstFlowReturn ret;
+  guint i;
+
+  clip = gst_mxf_demux_add_clip (demux, etrack, demux->offset - demux->run_in,
+      data_offset, length);
+  clip_end = clip->start + clip->duration;
+
+  /* Neither an index nor the essence handler could tell where the edit
+   * units are, skipping the clip would silently drop all of its essence */
+  if (clip->duration == 0 && clip->length > 0) {
+    GST_ELEMENT_ERROR (demux, STREAM, NOT_IMPLEMENTED, (NULL),
+        ("Can't find the edit units of clip-wrapped essence of track %u",
+            etrack->track_number));
+    return GST_FLOW_ERROR;
+  }
+
+  /* After a seek continue with the earliest position of the track's pads */
+  if (etrack->position == -1) {
+    etrack->position = clip->start;
+
+    for (i = 0; i < demux->src->len; i++) {
+      GstMXFDemuxPad *pad = g_ptr_array_index (demux->src, i);
+
+      if (pad->current_essence_track == etrack && !pad->eos
+          && pad->current_essence_track_position >= clip->start
+          && pad->current_essence_track_position < clip_end) {
+        etrack->position = pad->current_essence_track_position;
+        break;
+      }
+    }
+  }
+
+  if (etrack->position < clip->start || etrack->position >= clip_end
+      || !gst_mxf_demux_get_clip_edit_unit (demux, etrack, clip,
+          etrack->position, &offset, &size)) {
+    GST_DEBUG_OBJECT (demux, "Done with clip at offset %" G_GUINT64_FORMAT,
+        demux->offset);
+    demux->offset += data_offset + length;
+    return GST_FLOW_OK;
+  }
+
+  GST_LOG_OBJECT (demux,
+      "Pulling edit unit %" G_GINT64_FORMAT " of size %" G_GUINT64_FORMAT
+      " from clip at offset %" G_GUINT64_FORMAT, etrack->position, size,
+      demux->offset);
+
+  if (size > G_MAXUINT) {
+    GST_ERROR_OBJECT (demux, "Unsupported edit unit size: %" G_GUINT64_FORMAT,
+        size);
+    return GST_FLOW_ERROR;
+  }
+
+  ret =
+      gst_mxf_demux_pull_range (demux, demux->offset + data_offset + offset,
+      size, &buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  ret =
+      gst_mxf_demux_handle_generic_container_essence_element (demux, key,
+      buffer, FALSE);
+  gst_buffer_unref (buffer);
+
+  if (etrack->position >= clip_end)
+    demux->offset += data_offset + length;
+
+  return ret;
+}
+
 static guint64
 gst_mxf_demux_find_essence_element (GstMXFDemux * demux,
     GstMXFDemuxEssenceTrack * etrack, gint64 * position, gboolean keyframe)
@@ -2673,19 +3184,12 @@ gst_mxf_demux_find_essence_element (GstMXFDemux * demux,
       " of track %u with body_sid %u (keyframe %d)", *position,
       etrack->track_number, etrack->body_sid, keyframe);
 
-  if (demux->index_tables) {
-    GList *l;
+  if (demux->pending_index_table_segments)
+    gst_mxf_demux_merge_index_table_segments (demux);
 
-    for (l = demux->index_tables; l; l = l->next) {
-      GstMXFDemuxIndexTable *tmp = l->data;
-
-      if (tmp->body_sid == etrack->body_sid
-          && tmp->index_sid == etrack->index_sid) {
-        index_table = tmp;
-        break;
-      }
-    }
-  }
+  index_table =
+      gst_mxf_demux_find_index_table (demux, etrack->body_sid,
+      etrack->index_sid);
 
 from_index:
 
@@ -2694,6 +3198,25 @@ from_index:
     return -1;
   }
 
+  /* Clip-wrapped essence only needs the clip, the edit unit inside it is
+   * found when reading it */
+  if (etrack->wrapping == MXF_ESSENCE_WRAPPING_CLIP_WRAPPING) {
+    GstMXFDemuxClip *clip = gst_mxf_demux_find_clip (etrack, *position);
+
+    if (!clip && demux->random_access)
+      clip = gst_mxf_demux_scan_for_clip (demux, etrack, *position);
+
+    if (!clip) {
+      GST_DEBUG_OBJECT (demux, "No clip for edit unit %" G_GINT64_FORMAT,
+          *position);
+      return -1;
+    }
+
+    GST_DEBUG_OBJECT (demux, "Found edit unit %" G_GINT64_FORMAT
+        " in clip at offset %" G_GUINT64_FORMAT, *position, clip->offset);
+    return clip->offset;
+  }
+
   /* First try to find an offset in our index */
   offset = find_offset (etrack->offsets, position, keyframe);
   if (offset != -1) {
@@ -2728,6 +3251,18 @@ from_index:
   } else if (demux->random_access) {
     gint64 index_start_position = *position;
 
+    /* The file might have gained index table segments for this position
+     * since we last looked, which is much cheaper than parsing all essence
+     * up to it */
+    if ((!index_table || index_table->offsets->len <= *position
+            || g_array_index (index_table->offsets, GstMXFDemuxIndex,
+                *position).offset == 0)
+        && gst_mxf_demux_refresh_index (demux)) {
+      index_table =
+          gst_mxf_demux_find_index_table (demux, etrack->body_sid,
+          etrack->index_sid);
+    }
+
     demux->offset = demux->run_in;
 
     offset =
@@ -2775,12 +3310,30 @@ from_index:
       GstBuffer *buffer = NULL;
       MXFUL key;
       guint read = 0;
+      guint data_offset;
+      guint64 length;
+
+      /* Only remember where the clips of other tracks are */
+      if (demux->have_clip_wrapped_tracks
+          && gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key,
+              &data_offset, &length) == GST_FLOW_OK
+          && mxf_is_generic_container_essence_element (&key)) {
+        GstMXFDemuxEssenceTrack *t =
+            gst_mxf_demux_find_essence_track (demux, &key);
+
+        if (t && t->wrapping == MXF_ESSENCE_WRAPPING_CLIP_WRAPPING) {
+          gst_mxf_demux_add_clip (demux, t, demux->offset - demux->run_in,
+              data_offset, length);
+          demux->offset += data_offset + length;
+          continue;
+        }
+      }
 
       ret =
           gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buffer,
           &read);
 
-      if (ret == GST_FLOW_EOS) {
+      if (ret == GST_FLOW_EOS && !demux->growing_file) {
         for (i = 0; i < demux->essence_tracks->len; i++) {
           GstMXFDemuxEssenceTrack *t =
               &g_array_index (demux->essence_tracks, GstMXFDemuxEssenceTrack,
@@ -2847,6 +3400,9 @@ gst_mxf_demux_pull_and_handle_klv_packet (GstMXFDemux * demux)
   MXFUL key;
   GstFlowReturn ret = GST_FLOW_OK;
   guint read = 0;
+  GstMXFDemuxEssenceTrack *clip_track = NULL;
+  guint data_offset;
+  guint64 length;
 
   if (demux->src->len > 0) {
     if (!gst_mxf_demux_get_earliest_pad (demux)) {
@@ -2856,9 +3412,43 @@ gst_mxf_demux_pull_and_handle_klv_packet (GstMXFDemux * demux)
     }
   }
 
-  ret =
-      gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buffer,
-      &read);
+  /* Clip-wrapped essence elements are not pulled completely, they can be
+   * as large as the file. Until the tracks are known every essence element
+   * could be one */
+  if ((!demux->metadata_resolved || demux->have_clip_wrapped_tracks)
+      && gst_mxf_demux_peek_klv_packet (demux, demux->offset, &key,
+          &data_offset, &length) == GST_FLOW_OK
+      && mxf_is_generic_container_essence_element (&key)) {
+    if ((ret = gst_mxf_demux_update_metadata (demux, &key)) != GST_FLOW_OK)
+      goto beach;
+
+    clip_track = gst_mxf_demux_find_essence_track (demux, &key);
+    if (clip_track
+        && clip_track->wrapping != MXF_ESSENCE_WRAPPING_CLIP_WRAPPING)
+      clip_track = NULL;
+  }
+
+  if (clip_track) {
+    ret =
+        gst_mxf_demux_handle_clip_wrapped_essence (demux, clip_track, &key,
+        data_offset, length);
+    if (ret != GST_FLOW_EOS)
+      goto handled;
+  } else {
+    ret =
+        gst_mxf_demux_pull_klv_packet (demux, demux->offset, &key, &buffer,
+        &read);
+  }
+
+  /* Nothing more was written yet, unless we're at the footer already */
+  if (ret == GST_FLOW_EOS && demux->growing_file && !(demux->current_partition
+          && demux->current_partition->partition.type ==
+          MXF_PARTITION_PACK_FOOTER)) {
+    GST_LOG_OBJECT (demux, "Waiting for the file to grow");
+    ret = gst_mxf_demux_wait_for_growth (demux) ? GST_FLOW_OK :
+        GST_FLOW_FLUSHING;
+    goto beach;
+  }
 
   if (ret == GST_FLOW_EOS && demux->src->len > 0) {
     guint i;
@@ -2923,6 +3513,7 @@ gst_mxf_demux_pull_and_handle_klv_packet (GstMXFDemux * demux)
   ret = gst_mxf_demux_handle_klv_packet (demux, &key, buffer, FALSE);
   demux->offset += read;
 
+handled:
   if (ret == GST_FLOW_OK && demux->src->len > 0
       && demux->essence_tracks->len > 0) {
     GstMXFDemuxPad *earliest = NULL;
@@ -3508,7 +4099,6 @@ no_new_offset:
 static void
 collect_index_table_segments (GstMXFDemux * demux)
 {
-  GList *l;
   guint i;
   guint64 old_offset = demux->offset;
   GstMXFDemuxPartition *old_partition = demux->current_partition;
@@ -3532,85 +4122,221 @@ collect_index_table_segments (GstMXFDemux * demux)
   demux->offset = old_offset;
   demux->current_partition = old_partition;
 
-  for (l = demux->pending_index_table_segments; l; l = l->next) {
-    MXFIndexTableSegment *segment = l->data;
-    GstMXFDemuxIndexTable *t = NULL;
-    GList *k;
-    guint64 start, end;
+  gst_mxf_demux_merge_index_table_segments (demux);
+}
+
+/* Adds the entries of @segment to the index table of its essence container.
+ * Returns FALSE if some of them point into a partition that we don't know
+ * the essence start of yet, in which case the segment has to be merged
+ * again later */
+static gboolean
+gst_mxf_demux_merge_index_table_segment (GstMXFDemux * demux,
+    MXFIndexTableSegment * segment)
+{
+  GstMXFDemuxIndexTable *t;
+  gboolean complete = TRUE;
+  guint64 start, end;
+  guint i;
+
+  t = gst_mxf_demux_find_index_table (demux, segment->body_sid,
+      segment->index_sid);
+  if (!t) {
+    t = g_new0 (GstMXFDemuxIndexTable, 1);
+    t->body_sid = segment->body_sid;
+    t->index_sid = segment->index_sid;
+    t->offsets = g_array_new (FALSE, TRUE, sizeof (GstMXFDemuxIndex));
+    demux->index_tables = g_list_prepend (demux->index_tables, t);
+  }
 
-    for (k = demux->index_tables; k; k = k->next) {
-      GstMXFDemuxIndexTable *tmp = k->data;
+  if (segment->edit_unit_byte_count)
+    t->edit_unit_byte_count = segment->edit_unit_byte_count;
 
-      if (tmp->body_sid == segment->body_sid
-          && tmp->index_sid == segment->index_sid) {
-        t = tmp;
+  start = segment->index_start_position;
+  end = start + segment->index_duration;
+
+  if (t->offsets->len < end)
+    g_array_set_size (t->offsets, end);
+
+  for (i = 0; i < segment->n_index_entries && start + i < end; i++) {
+    GstMXFDemuxIndex *index =
+        &g_array_index (t->offsets, GstMXFDemuxIndex, start + i);
+    guint64 offset = segment->index_entries[i].stream_offset;
+    GList *m;
+    GstMXFDemuxPartition *offset_partition = NULL, *next_partition = NULL;
+
+    for (m = demux->partitions; m; m = m->next) {
+      GstMXFDemuxPartition *partition = m->data;
+
+      if (!next_partition && offset_partition)
+        next_partition = partition;
+
+      if (partition->partition.body_sid != t->body_sid)
+        continue;
+      if (partition->partition.body_offset > offset)
         break;
-      }
+
+      offset_partition = partition;
+      next_partition = NULL;
     }
 
-    if (!t) {
-      t = g_new0 (GstMXFDemuxIndexTable, 1);
-      t->body_sid = segment->body_sid;
-      t->index_sid = segment->index_sid;
-      t->offsets = g_array_new (FALSE, TRUE, sizeof (GstMXFDemuxIndex));
-      demux->index_tables = g_list_prepend (demux->index_tables, t);
+    if (!offset_partition || offset_partition->essence_container_offset == 0) {
+      complete = FALSE;
+      continue;
     }
 
-    start = segment->index_start_position;
-    end = start + segment->index_duration;
+    if (offset >= offset_partition->partition.body_offset
+        && (offset - offset_partition->partition.body_offset)) {
+      offset =
+          offset_partition->partition.this_partition +
+          offset_partition->essence_container_offset + (offset -
+          offset_partition->partition.body_offset);
+
+      if (next_partition
+          && offset >= next_partition->partition.this_partition) {
+        GST_ERROR_OBJECT (demux,
+            "Invalid index table segment going into next unrelated partition");
+      } else {
+        index->offset = offset;
+        index->keyframe = ! !(segment->index_entries[i].flags & 0x80)
+            || (segment->index_entries[i].key_frame_offset == 0);
+      }
+    }
+  }
 
-    if (t->offsets->len < end)
-      g_array_set_size (t->offsets, end);
+  return complete;
+}
 
-    for (i = 0; i < segment->n_index_entries; i++) {
-      GstMXFDemuxIndex *index =
-          &g_array_index (t->offsets, GstMXFDemuxIndex, start + i);
-      guint64 offset = segment->index_entries[i].stream_offset;
-      GList *m;
-      GstMXFDemuxPartition *offset_partition = NULL, *next_partition = NULL;
+/* Moves the pending index table segments into the index tables, which are
+ * shared by all tracks of an essence container. Returns TRUE if any
+ * segment was merged */
+static gboolean
+gst_mxf_demux_merge_index_table_segments (GstMXFDemux * demux)
+{
+  GList *l, *next;
+  gboolean merged = FALSE;
 
-      for (m = demux->partitions; m; m = m->next) {
-        GstMXFDemuxPartition *partition = m->data;
+  for (l = demux->pending_index_table_segments; l; l = next) {
+    MXFIndexTableSegment *segment = l->data;
 
-        if (!next_partition && offset_partition)
-          next_partition = partition;
+    next = l->next;
 
-        if (partition->partition.body_sid != t->body_sid)
-          continue;
-        if (partition->partition.body_offset > offset)
-          break;
+    if (!gst_mxf_demux_merge_index_table_segment (demux, segment))
+      continue;
 
-        offset_partition = partition;
-        next_partition = NULL;
-      }
+    mxf_index_table_segment_reset (segment);
+    g_free (segment);
+    demux->pending_index_table_segments =
+        g_list_delete_link (demux->pending_index_table_segments, l);
+    merged = TRUE;
+  }
 
-      if (offset_partition && offset >= offset_partition->partition.body_offset
-          && (offset - offset_partition->partition.body_offset)) {
-        offset =
-            offset_partition->partition.this_partition +
-            offset_partition->essence_container_offset + (offset -
-            offset_partition->partition.body_offset);
-
-        if (next_partition
-            && offset >= next_partition->partition.this_partition) {
-          GST_ERROR_OBJECT (demux,
-              "Invalid index table segment going into next unrelated partition");
-        } else {
-          index->offset = offset;
-          index->keyframe = ! !(segment->index_entries[i].flags & 0x80)
-              || (segment->index_entries[i].key_frame_offset == 0);
+  return merged;
+}
+
+/* Walks the KLV packets after the last partition we know about, without
+ * pulling any essence, to pick up the partitions and index table segments
+ * written since. For files that are still being written this is how the
+ * index keeps up with the file. Returns TRUE if the index tables changed */
+static gboolean
+gst_mxf_demux_refresh_index (GstMXFDemux * demux)
+{
+  guint64 old_offset = demux->offset;
+  GstMXFDemuxPartition *old_partition = demux->current_partition;
+  gint64 filesize = -1;
+  guint64 offset;
+  GList *l;
+
+  /* Don't bother walking files that don't come with an index at all */
+  if (!demux->random_access || (!demux->growing_file && !demux->index_tables
+          && !demux->pending_index_table_segments))
+    return FALSE;
+
+  if (!gst_pad_peer_query_duration (demux->sinkpad, GST_FORMAT_BYTES,
+          &filesize))
+    filesize = -1;
+
+  /* Partitions only known from the random index pack were not read yet */
+  offset = MAX (demux->index_scan_offset, demux->run_in);
+  for (l = demux->partitions; l; l = l->next) {
+    GstMXFDemuxPartition *p = l->data;
+
+    if (p->partition.major_version == 0x0001)
+      offset = MAX (offset, p->partition.this_partition + demux->run_in);
+  }
+
+  GST_DEBUG_OBJECT (demux, "Looking for new index table segments from offset %"
+      G_GUINT64_FORMAT, offset);
+
+  while (filesize == -1 || offset < filesize) {
+    MXFUL key;
+    guint data_offset;
+    guint64 length;
+
+    if (gst_mxf_demux_peek_klv_packet (demux, offset, &key, &data_offset,
+            &length) != GST_FLOW_OK)
+      break;
+
+    /* The end of a growing file might not be completely written yet */
+    if (filesize != -1 && offset + data_offset + length > filesize)
+      break;
+
+    if (mxf_is_partition_pack (&key)) {
+      gboolean known = FALSE;
+
+      for (l = demux->partitions; l; l = l->next) {
+        GstMXFDemuxPartition *p = l->data;
+
+        if (p->partition.this_partition + demux->run_in == offset) {
+          known = p->partition.major_version == 0x0001;
+          break;
         }
       }
+
+      if (!known) {
+        demux->offset = offset;
+        read_partition_header (demux);
+        offset = MAX (offset + data_offset + length, demux->offset);
+      } else {
+        offset += data_offset + length;
+      }
+    } else {
+      offset += data_offset + length;
     }
-  }
 
-  for (l = demux->pending_index_table_segments; l; l = l->next) {
-    MXFIndexTableSegment *s = l->data;
-    mxf_index_table_segment_reset (s);
-    g_free (s);
+    demux->index_scan_offset = offset;
   }
-  g_list_free (demux->pending_index_table_segments);
-  demux->pending_index_table_segments = NULL;
+
+  demux->offset = old_offset;
+  demux->current_partition = old_partition;
+
+  return gst_mxf_demux_merge_index_table_segments (demux);
+}
+
+/* Waits a bit for a file that is still being written to grow. Returns FALSE
+ * if the wait was interrupted by a seek or by shutting down */
+static gboolean
+gst_mxf_demux_wait_for_growth (GstMXFDemux * demux)
+{
+  gint64 end_time = g_get_monotonic_time () + GROWING_FILE_POLL_INTERVAL;
+  gboolean ret;
+
+  g_mutex_lock (&demux->growth_lock);
+  while (!demux->growth_cancelled
+      && g_cond_wait_until (&demux->growth_cond, &demux->growth_lock,
+          end_time));
+  ret = !demux->growth_cancelled;
+  g_mutex_unlock (&demux->growth_lock);
+
+  return ret;
+}
+
+static void
+gst_mxf_demux_set_growth_cancelled (GstMXFDemux * demux, gboolean cancelled)
+{
+  g_mutex_lock (&demux->growth_lock);
+  demux->growth_cancelled = cancelled;
+  g_cond_signal (&demux->growth_cond);
+  g_mutex_unlock (&demux->growth_lock);
 }
 
 static gboolean
@@ -3648,6 +4374,9 @@ gst_mxf_demux_seek_pull (GstMXFDemux * demux, GstEvent * event)
     demux->index_table_segments_collected = TRUE;
   }
 
+  /* Wake up the streaming thread if it waits for a growing file */
+  gst_mxf_demux_set_growth_cancelled (demux, TRUE);
+
   if (flush) {
     GstEvent *e;
 
@@ -3803,6 +4532,7 @@ gst_mxf_demux_seek_pull (GstMXFDemux * demux, GstEvent * event)
 
   demux->seqnum = seqnum;
 
+  gst_mxf_demux_set_growth_cancelled (demux, FALSE);
   gst_pad_start_task (demux->sinkpad,
       (GstTaskFunction) gst_mxf_demux_loop, demux->sinkpad, NULL);
 
@@ -3823,6 +4553,7 @@ wrong_rate:
   }
 unresolved_metadata:
   {
+    gst_mxf_demux_set_growth_cancelled (demux, FALSE);
     gst_pad_start_task (demux->sinkpad,
         (GstTaskFunction) gst_mxf_demux_loop, demux->sinkpad, NULL);
     GST_PAD_STREAM_UNLOCK (demux->sinkpad);
@@ -4037,10 +4768,12 @@ gst_mxf_demux_sink_activate_mode (GstPad * sinkpad, GstObject * parent,
   } else {
     if (active) {
       demux->random_access = TRUE;
+      gst_mxf_demux_set_growth_cancelled (demux, FALSE);
       return gst_pad_start_task (sinkpad, (GstTaskFunction) gst_mxf_demux_loop,
           sinkpad, NULL);
     } else {
       demux->random_access = FALSE;
+      gst_mxf_demux_set_growth_cancelled (demux, TRUE);
       return gst_pad_stop_task (sinkpad);
     }
   }
@@ -4344,6 +5077,12 @@ gst_mxf_demux_set_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       demux->max_drift = g_value_get_uint64 (value);
       break;
+    case PROP_GROWING_FILE:
+      demux->growing_file = g_value_get_boolean (value);
+      break;
+    case PROP_LAZY_METADATA:
+      demux->lazy_metadata = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4363,6 +5102,12 @@ gst_mxf_demux_get_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       g_value_set_uint64 (value, demux->max_drift);
       break;
+    case PROP_GROWING_FILE:
+      g_value_set_boolean (value, demux->growing_file);
+      break;
+    case PROP_LAZY_METADATA:
+      g_value_set_boolean (value, demux->lazy_metadata);
+      break;
     case PROP_STRUCTURE:{
       GstStructure *s;
 
@@ -4422,6 +5167,9 @@ gst_mxf_demux_finalize (GObject * object)
 
   g_rw_lock_clear (&demux->metadata_lock);
 
+  g_mutex_clear (&demux->growth_lock);
+  g_cond_clear (&demux->growth_cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -4455,6 +5203,18 @@ gst_mxf_demux_class_init (GstMXFDemuxClass * klass)
           "Structural metadata of the MXF file",
           GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_GROWING_FILE,
+      g_param_spec_boolean ("growing-file", "Growing file",
+          "Treat the input as a file that is still being written: wait for "
+          "more data at its end and keep the header metadata",
+          DEFAULT_GROWING_FILE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LAZY_METADATA,
+      g_param_spec_boolean ("lazy-metadata", "Lazy metadata",
+          "Only parse the structural metadata when opening the file and keep "
+          "descriptive metadata unparsed until it is referenced",
+          DEFAULT_LAZY_METADATA, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_mxf_demux_change_state);
   gstelement_class->query = GST_DEBUG_FUNCPTR (gst_mxf_demux_query);
@@ -4486,10 +5246,14 @@ gst_mxf_demux_init (GstMXFDemux * demux)
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
   demux->max_drift = 500 * GST_MSECOND;
+  demux->growing_file = DEFAULT_GROWING_FILE;
+  demux->lazy_metadata = DEFAULT_LAZY_METADATA;
 
   demux->adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
   g_rw_lock_init (&demux->metadata_lock);
+  g_mutex_init (&demux->growth_lock);
+  g_cond_init (&demux->growth_cond);
 
   demux->src = g_ptr_array_new ();
   demux->essence_tracks =
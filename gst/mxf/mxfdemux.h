@@ -54,6 +54,11 @@ typedef struct
   MXFPrimerPack primer;
   gboolean parsed_metadata;
   guint64 essence_container_offset;
+
+  /* With lazy-metadata, the header metadata pulled in one go, starting with
+   * the primer pack at metadata_offset */
+  GstBuffer *metadata;
+  guint64 metadata_offset;
 } GstMXFDemuxPartition;
 
 typedef struct
@@ -62,6 +67,17 @@ typedef struct
   gboolean keyframe;
 } GstMXFDemuxIndex;
 
+/* A clip-wrapped KLV packet, holding a range of edit units of a track */
+typedef struct
+{
+  guint64 offset; /* of the key, without run-in */
+  guint data_offset;
+  guint64 length;
+
+  gint64 start;
+  gint64 duration;
+} GstMXFDemuxClip;
+
 typedef struct
 {
   guint32 body_sid;
@@ -76,6 +92,9 @@ typedef struct
 
   GArray *offsets;
 
+  MXFEssenceWrapping wrapping;
+  GArray *clips; /* GstMXFDemuxClip, sorted by offset */
+
   MXFMetadataSourcePackage *source_package;
   MXFMetadataTimelineTrack *source_track;
 
@@ -93,6 +112,8 @@ typedef struct
   guint32 body_sid;
   guint32 index_sid;
   GArray *offsets;
+  /* from constant bytes per edit unit segments, 0 otherwise */
+  guint32 edit_unit_byte_count;
 } GstMXFDemuxIndexTable;
 
 struct _GstMXFDemuxPad
@@ -161,10 +182,13 @@ struct _GstMXFDemux
   GstMXFDemuxPartition *current_partition;
 
   GArray *essence_tracks;
+  gboolean have_clip_wrapped_tracks;
 
   GList *pending_index_table_segments;
   GList *index_tables; /* one per BodySID / IndexSID */
   gboolean index_table_segments_collected;
+  /* where gst_mxf_demux_refresh_index() continues looking for partitions */
+  guint64 index_scan_offset;
 
   GArray *random_index_pack;
 
@@ -183,9 +207,16 @@ struct _GstMXFDemux
 
   GstTagList *tags;
 
+  /* Waiting for a growing file, interrupted on seeks and shutdown */
+  GMutex growth_lock;
+  GCond growth_cond;
+  gboolean growth_cancelled;
+
   /* Properties */
   gchar *requested_package_string;
   GstClockTime max_drift;
+  gboolean growing_file;
+  gboolean lazy_metadata;
 };
 
 struct _GstMXFDemuxClass
@@ -38,6 +38,9 @@ typedef struct {
   gboolean (*handles_track) (const MXFMetadataTimelineTrack *track);
   MXFEssenceWrapping (*get_track_wrapping) (const MXFMetadataTimelineTrack *track);
   GstCaps * (*create_caps) (MXFMetadataTimelineTrack *track, GstTagList **tags, MXFEssenceElementHandleFunc *handler, gpointer *mapping_data);
+  /* Optional, for clip-wrapped tracks: byte range of edit unit @position
+   * relative to the start of the clip, if it can be computed without an index */
+  gboolean (*get_edit_unit_range) (const MXFMetadataTimelineTrack *track, gint64 position, guint64 *offset, guint64 *size);
 } MXFEssenceElementHandler;
 
 typedef GstFlowReturn (*MXFEssenceElementWriteFunc) (GstBuffer *buffer, gpointer mapping_data, GstAdapter *adapter, GstBuffer **outbuf, gboolean flush);
@@ -43,6 +43,15 @@ mxf_metadata_base_finalize (GObject * object)
     self->other_tags = NULL;
   }
 
+  if (self->deferred_buffer) {
+    gst_buffer_unref (self->deferred_buffer);
+    self->deferred_buffer = NULL;
+  }
+  if (self->deferred_mappings) {
+    g_hash_table_unref (self->deferred_mappings);
+    self->deferred_mappings = NULL;
+  }
+
   G_OBJECT_CLASS (mxf_metadata_base_parent_class)->finalize (object);
 }
 
@@ -167,6 +176,91 @@ mxf_metadata_base_parse (MXFMetadataBase * self, MXFPrimerPack * primer,
   return TRUE;
 }
 
+/* Only the instance and generation UIDs of deferred metadata are parsed. The
+ * local set at @offset of @buffer isn't copied, a reference to @buffer and
+ * to the primer pack mappings it was read with are kept until the set is
+ * parsed when it's resolved for the first time */
+gboolean
+mxf_metadata_base_parse_deferred (MXFMetadataBase * self,
+    MXFPrimerPack * primer, GstBuffer * buffer, guint offset, guint size)
+{
+  guint16 tag, tag_size;
+  const guint8 *tag_data;
+  const guint8 *data;
+  guint left = size;
+  GstMapInfo map;
+
+  g_return_val_if_fail (MXF_IS_METADATA_BASE (self), FALSE);
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (primer != NULL, FALSE);
+  g_return_val_if_fail (primer->mappings != NULL, FALSE);
+  g_return_val_if_fail ((gsize) offset + size <= gst_buffer_get_size (buffer),
+      FALSE);
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return FALSE;
+
+  data = map.data + offset;
+  while (mxf_local_tag_parse (data, left, &tag, &tag_size, &tag_data)) {
+    if (tag == 0x3c0a && tag_size == 16)
+      memcpy (&self->instance_uid, tag_data, 16);
+    else if (tag == 0x0102 && tag_size == 16)
+      memcpy (&self->generation_uid, tag_data, 16);
+
+    data += 4 + tag_size;
+    left -= 4 + tag_size;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  if (mxf_uuid_is_zero (&self->instance_uid))
+    return FALSE;
+
+  self->deferred_buffer = gst_buffer_ref (buffer);
+  self->deferred_offset = offset;
+  self->deferred_size = size;
+  self->deferred_mappings = g_hash_table_ref (primer->mappings);
+
+  return TRUE;
+}
+
+static gboolean
+mxf_metadata_base_parse_deferred_data (MXFMetadataBase * self)
+{
+  MXFPrimerPack primer;
+  GstMapInfo map;
+  gboolean ret;
+
+  memset (&primer, 0, sizeof (primer));
+  primer.mappings = self->deferred_mappings;
+
+  GST_DEBUG ("Parsing deferred %s of size %u", G_OBJECT_TYPE_NAME (self),
+      self->deferred_size);
+
+  if (gst_buffer_map (self->deferred_buffer, &map, GST_MAP_READ)) {
+    ret = mxf_metadata_base_parse (self, &primer,
+        map.data + self->deferred_offset, self->deferred_size);
+    gst_buffer_unmap (self->deferred_buffer, &map);
+  } else {
+    ret = FALSE;
+  }
+
+  gst_buffer_unref (self->deferred_buffer);
+  self->deferred_buffer = NULL;
+  self->deferred_offset = self->deferred_size = 0;
+  g_hash_table_unref (self->deferred_mappings);
+  self->deferred_mappings = NULL;
+
+  return ret;
+}
+
+gboolean
+mxf_metadata_base_is_deferred (MXFMetadataBase * self)
+{
+  g_return_val_if_fail (MXF_IS_METADATA_BASE (self), FALSE);
+
+  return self->deferred_buffer != NULL;
+}
+
 gboolean
 mxf_metadata_base_resolve (MXFMetadataBase * self, GHashTable * metadata)
 {
@@ -185,8 +279,12 @@ mxf_metadata_base_resolve (MXFMetadataBase * self, GHashTable * metadata)
 
   klass = MXF_METADATA_BASE_GET_CLASS (self);
 
-  if (klass->resolve)
+  if (self->deferred_buffer && !mxf_metadata_base_parse_deferred_data (self)) {
+    GST_ERROR ("Parsing deferred metadata failed");
+    ret = FALSE;
+  } else if (klass->resolve) {
     ret = klass->resolve (self, metadata);
+  }
 
   self->resolved =
       (ret) ? MXF_METADATA_BASE_RESOLVE_STATE_SUCCESS :
@@ -3778,7 +3876,9 @@ mxf_metadata_dm_segment_resolve (MXFMetadataBase * m, GHashTable * metadata)
 
   current = g_hash_table_lookup (metadata, &self->dm_framework_uid);
   if (current && MXF_IS_DESCRIPTIVE_METADATA_FRAMEWORK (current)) {
-    if (mxf_metadata_base_resolve (current, metadata)) {
+    /* Deferred frameworks are only parsed and resolved once they're used */
+    if (mxf_metadata_base_is_deferred (current)
+        || mxf_metadata_base_resolve (current, metadata)) {
       self->dm_framework = MXF_DESCRIPTIVE_METADATA_FRAMEWORK (current);
     } else {
       GST_ERROR ("Couldn't resolve DM framework %s",
@@ -6477,20 +6577,16 @@ mxf_descriptive_metadata_register (guint8 scheme, GType * types)
   g_array_append_val (_dm_schemes, s);
 }
 
-MXFDescriptiveMetadata *
-mxf_descriptive_metadata_new (guint8 scheme, guint32 type,
-    MXFPrimerPack * primer, guint64 offset, const guint8 * data, guint size)
+static GType
+mxf_descriptive_metadata_find_type (guint8 scheme, guint32 type)
 {
   guint i;
   GType t = G_TYPE_INVALID, *p;
   _MXFDescriptiveMetadataScheme *s = NULL;
-  MXFDescriptiveMetadata *ret = NULL;
-
-  g_return_val_if_fail (primer != NULL, NULL);
 
   if (G_UNLIKELY (type == 0)) {
     GST_WARNING ("Type 0 is invalid");
-    return NULL;
+    return G_TYPE_INVALID;
   }
 
   for (i = 0; i < _dm_schemes->len; i++) {
@@ -6505,7 +6601,7 @@ mxf_descriptive_metadata_new (guint8 scheme, guint32 type,
 
   if (s == NULL) {
     GST_WARNING ("Descriptive metadata scheme 0x%02x not supported", scheme);
-    return NULL;
+    return G_TYPE_INVALID;
   }
 
   p = s->types;
@@ -6527,12 +6623,28 @@ mxf_descriptive_metadata_new (guint8 scheme, guint32 type,
     GST_WARNING
         ("No handler for type 0x%06x of descriptive metadata scheme 0x%02x found",
         type, scheme);
-    return NULL;
+    return G_TYPE_INVALID;
   }
 
   GST_DEBUG ("DM scheme 0x%02x type 0x%06x is handled by type %s", scheme, type,
       g_type_name (t));
 
+  return t;
+}
+
+MXFDescriptiveMetadata *
+mxf_descriptive_metadata_new (guint8 scheme, guint32 type,
+    MXFPrimerPack * primer, guint64 offset, const guint8 * data, guint size)
+{
+  GType t;
+  MXFDescriptiveMetadata *ret = NULL;
+
+  g_return_val_if_fail (primer != NULL, NULL);
+
+  t = mxf_descriptive_metadata_find_type (scheme, type);
+  if (t == G_TYPE_INVALID)
+    return NULL;
+
   ret = (MXFDescriptiveMetadata *) g_type_create_instance (t);
   if (!mxf_metadata_base_parse (MXF_METADATA_BASE (ret), primer, data, size)) {
     GST_ERROR ("Parsing metadata failed");
@@ -6545,6 +6657,36 @@ mxf_descriptive_metadata_new (guint8 scheme, guint32 type,
   return ret;
 }
 
+/* Only the instance UID of the set of @size bytes at @buffer_offset of
+ * @buffer is parsed right away and the rest when it's resolved for the first
+ * time */
+MXFDescriptiveMetadata *
+mxf_descriptive_metadata_new_deferred (guint8 scheme, guint32 type,
+    MXFPrimerPack * primer, guint64 offset, GstBuffer * buffer,
+    guint buffer_offset, guint size)
+{
+  GType t;
+  MXFDescriptiveMetadata *ret = NULL;
+
+  g_return_val_if_fail (primer != NULL, NULL);
+
+  t = mxf_descriptive_metadata_find_type (scheme, type);
+  if (t == G_TYPE_INVALID)
+    return NULL;
+
+  ret = (MXFDescriptiveMetadata *) g_type_create_instance (t);
+  if (!mxf_metadata_base_parse_deferred (MXF_METADATA_BASE (ret), primer,
+          buffer, buffer_offset, size)) {
+    GST_ERROR ("Parsing metadata failed");
+    g_object_unref (ret);
+    return NULL;
+  }
+
+  ret->parent.offset = offset;
+
+  return ret;
+}
+
 GType
 mxf_descriptive_metadata_framework_get_type (void)
 {
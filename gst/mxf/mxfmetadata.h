@@ -389,6 +389,13 @@ struct _MXFMetadataBase {
   MXFMetadataBaseResolveState resolved;
 
   GHashTable *other_tags;
+
+  /* Position of the unparsed local set of deferred metadata in the
+   * partition data it was read from */
+  GstBuffer *deferred_buffer;
+  guint deferred_offset;
+  guint deferred_size;
+  GHashTable *deferred_mappings;
 };
 
 struct _MXFMetadataBaseClass {
@@ -765,6 +772,8 @@ struct _MXFDescriptiveMetadataFrameworkInterface {
 };
 
 gboolean mxf_metadata_base_parse (MXFMetadataBase *self, MXFPrimerPack *primer, const guint8 *data, guint size);
+gboolean mxf_metadata_base_parse_deferred (MXFMetadataBase *self, MXFPrimerPack *primer, GstBuffer *buffer, guint offset, guint size);
+gboolean mxf_metadata_base_is_deferred (MXFMetadataBase *self);
 gboolean mxf_metadata_base_resolve (MXFMetadataBase *self, GHashTable *metadata);
 GstStructure * mxf_metadata_base_to_structure (MXFMetadataBase *self);
 GstBuffer * mxf_metadata_base_to_buffer (MXFMetadataBase *self, MXFPrimerPack *primer);
@@ -785,6 +794,7 @@ gboolean mxf_metadata_generic_sound_essence_descriptor_from_caps (MXFMetadataGen
 
 void mxf_descriptive_metadata_register (guint8 scheme, GType *types);
 MXFDescriptiveMetadata * mxf_descriptive_metadata_new (guint8 scheme, guint32 type, MXFPrimerPack * primer, guint64 offset, const guint8 * data, guint size);
+MXFDescriptiveMetadata * mxf_descriptive_metadata_new_deferred (guint8 scheme, guint32 type, MXFPrimerPack * primer, guint64 offset, GstBuffer * buffer, guint buffer_offset, guint size);
 
 GHashTable *mxf_metadata_hash_table_new (void);
 
@@ -71,6 +71,9 @@ typedef struct
 
   MXFMetadataSourcePackage *source_package;
   MXFMetadataTimelineTrack *source_track;
+
+  /* Slice of the index entries that points to this track's elements */
+  guint index_slice;
 } GstMXFMuxPad;
 
 typedef struct
@@ -112,15 +115,22 @@ static GstStaticPadTemplate src_templ = GST_STATIC_PAD_TEMPLATE ("src",
     GST_STATIC_CAPS ("application/mxf")
     );
 
+#define DEFAULT_PARTITION_DURATION (10 * GST_SECOND)
+
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_PARTITION_DURATION
 };
 
 #define gst_mxf_mux_parent_class parent_class
 G_DEFINE_TYPE (GstMXFMux, gst_mxf_mux, GST_TYPE_AGGREGATOR);
 
 static void gst_mxf_mux_finalize (GObject * object);
+static void gst_mxf_mux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_mxf_mux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static GstFlowReturn gst_mxf_mux_aggregate (GstAggregator * aggregator,
     gboolean timeout);
@@ -162,6 +172,15 @@ gst_mxf_mux_class_init (GstMXFMuxClass * klass)
   gstaggregator_class = (GstAggregatorClass *) klass;
 
   gobject_class->finalize = gst_mxf_mux_finalize;
+  gobject_class->set_property = gst_mxf_mux_set_property;
+  gobject_class->get_property = gst_mxf_mux_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_PARTITION_DURATION,
+      g_param_spec_uint64 ("partition-duration", "Partition duration",
+          "Duration of the essence after which a new body partition with the "
+          "index of the previous one is started (0 = single body partition)",
+          0, G_MAXUINT64, DEFAULT_PARTITION_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstaggregator_class->create_new_pad =
       GST_DEBUG_FUNCPTR (gst_mxf_mux_create_new_pad);
@@ -191,6 +210,9 @@ static void
 gst_mxf_mux_init (GstMXFMux * mux)
 {
   mux->index_table = g_array_new (FALSE, FALSE, sizeof (MXFIndexTableSegment));
+  mux->partitions =
+      g_array_new (FALSE, FALSE, sizeof (MXFRandomIndexPackEntry));
+  mux->partition_duration = DEFAULT_PARTITION_DURATION;
   gst_mxf_mux_reset (mux);
 }
 
@@ -213,9 +235,57 @@ gst_mxf_mux_finalize (GObject * object)
     mux->index_table = NULL;
   }
 
+  if (mux->partitions) {
+    g_array_free (mux->partitions, TRUE);
+    mux->partitions = NULL;
+  }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_mxf_mux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMXFMux *mux = GST_MXF_MUX (object);
+
+  switch (prop_id) {
+    case PROP_PARTITION_DURATION:
+      mux->partition_duration = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_mxf_mux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMXFMux *mux = GST_MXF_MUX (object);
+
+  switch (prop_id) {
+    case PROP_PARTITION_DURATION:
+      g_value_set_uint64 (value, mux->partition_duration);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_mxf_mux_clear_index_table (GstMXFMux * mux)
+{
+  guint i;
+
+  for (i = 0; i < mux->index_table->len; i++)
+    mxf_index_table_segment_reset (&g_array_index (mux->index_table,
+            MXFIndexTableSegment, i));
+  g_array_set_size (mux->index_table, 0);
+}
+
 static void
 gst_mxf_mux_reset (GstMXFMux * mux)
 {
@@ -250,8 +320,10 @@ gst_mxf_mux_reset (GstMXFMux * mux)
   mux->last_gc_timestamp = 0;
   mux->last_gc_position = 0;
   mux->offset = 0;
+  mux->partition_start = 0;
 
-  g_array_set_size (mux->index_table, 0);
+  gst_mxf_mux_clear_index_table (mux);
+  g_array_set_size (mux->partitions, 0);
 }
 
 static gboolean
@@ -1190,6 +1262,34 @@ static const guint8 _gc_essence_element_ul[] = {
   0x0d, 0x01, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00
 };
 
+/* Tracks without an element in the content package of the last index entry
+ * get the end of the content package as their slice offset */
+static void
+gst_mxf_mux_finish_index_entry (GstMXFMux * mux)
+{
+  MXFIndexTableSegment *segment;
+  MXFIndexEntry *entry;
+  guint i;
+
+  if (mux->index_table->len == 0)
+    return;
+
+  segment =
+      &g_array_index (mux->index_table, MXFIndexTableSegment,
+      mux->index_table->len - 1);
+  if (segment->n_index_entries == 0)
+    return;
+
+  entry = &segment->index_entries[segment->n_index_entries - 1];
+  for (i = 0; i < segment->slice_count; i++) {
+    if (entry->slice_offset[i] == G_MAXUINT32)
+      entry->slice_offset[i] =
+          mux->partition.body_offset - entry->stream_offset;
+  }
+}
+
+static GstFlowReturn gst_mxf_mux_write_body_partition (GstMXFMux * mux);
+
 static GstFlowReturn
 gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * pad)
 {
@@ -1248,17 +1348,36 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * pad)
   if (buf == NULL)
     return ret;
 
-  /* We currently only index the first essence stream */
-  if (pad == (GstMXFMuxPad *) GST_ELEMENT_CAST (mux)->sinkpads->data) {
+  /* Every content package gets an index entry when the element of the first
+   * track is written, the elements of all other tracks are found through
+   * the slice offsets of that entry */
+  if (pad->index_slice == 0) {
     MXFIndexTableSegment *segment;
-    const gint max_segment_size = G_MAXUINT16 / 11;
+    MXFIndexEntry *entry;
+    guint slice_count = GST_ELEMENT_CAST (mux)->numsinkpads - 1;
+    const gint max_segment_size =
+        (G_MAXUINT16 - 1) / (11 + 4 * slice_count);
+
+    gst_mxf_mux_finish_index_entry (mux);
+
+    if (mux->partition_duration > 0 && is_keyframe
+        && pad->last_timestamp >=
+        mux->partition_start + mux->partition_duration) {
+      mux->partition_start = pad->last_timestamp;
+      if ((ret = gst_mxf_mux_write_body_partition (mux)) != GST_FLOW_OK) {
+        GST_ERROR_OBJECT (mux, "Failed writing body partition");
+        gst_buffer_unref (buf);
+        return ret;
+      }
+    }
 
     if (mux->index_table->len == 0 ||
         g_array_index (mux->index_table, MXFIndexTableSegment,
             mux->index_table->len - 1).index_duration >= max_segment_size) {
       MXFIndexTableSegment s;
+      guint i;
 
-      memset (&segment, 0, sizeof (segment));
+      memset (&s, 0, sizeof (s));
 
       mxf_uuid_init (&s.instance_id, mux->metadata);
       memcpy (&s.index_edit_rate, &pad->source_track->edit_rate,
@@ -1270,10 +1389,14 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * pad)
           mux->preface->content_storage->essence_container_data[0]->index_sid;
       s.body_sid =
           mux->preface->content_storage->essence_container_data[0]->body_sid;
-      s.slice_count = 0;
+      s.slice_count = slice_count;
       s.pos_table_count = 0;
-      s.n_delta_entries = 0;
-      s.delta_entries = NULL;
+      if (slice_count > 0) {
+        s.n_delta_entries = slice_count + 1;
+        s.delta_entries = g_new0 (MXFDeltaEntry, s.n_delta_entries);
+        for (i = 0; i < s.n_delta_entries; i++)
+          s.delta_entries[i].slice = i;
+      }
       s.n_index_entries = 0;
       s.index_entries = g_new0 (MXFIndexEntry, max_segment_size);
       g_array_append_val (mux->index_table, s);
@@ -1282,14 +1405,32 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * pad)
         &g_array_index (mux->index_table, MXFIndexTableSegment,
         mux->index_table->len - 1);
 
-    segment->index_entries[segment->n_index_entries].temporal_offset = 0;
-    segment->index_entries[segment->n_index_entries].key_frame_offset = 0;
-    segment->index_entries[segment->n_index_entries].flags = is_keyframe ? 0x80 : 0x20; /* FIXME: Need to distinguish all the cases */
-    segment->index_entries[segment->n_index_entries].stream_offset =
-        mux->partition.body_offset;
+    entry = &segment->index_entries[segment->n_index_entries];
+    entry->temporal_offset = 0;
+    entry->key_frame_offset = 0;
+    entry->flags = is_keyframe ? 0x80 : 0x20;   /* FIXME: Need to distinguish all the cases */
+    entry->stream_offset = mux->partition.body_offset;
+    if (slice_count > 0) {
+      entry->slice_offset = g_new (guint32, slice_count);
+      memset (entry->slice_offset, 0xff, slice_count * sizeof (guint32));
+    }
 
     segment->n_index_entries++;
     segment->index_duration++;
+  } else if (mux->index_table->len > 0) {
+    MXFIndexTableSegment *segment =
+        &g_array_index (mux->index_table, MXFIndexTableSegment,
+        mux->index_table->len - 1);
+    MXFIndexEntry *entry;
+
+    /* Only the first element of this track in the content package is
+     * referenced by the index entry */
+    if (segment->n_index_entries > 0) {
+      entry = &segment->index_entries[segment->n_index_entries - 1];
+      if (entry->slice_offset[pad->index_slice - 1] == G_MAXUINT32)
+        entry->slice_offset[pad->index_slice - 1] =
+            mux->partition.body_offset - entry->stream_offset;
+    }
   }
 
   buf_size = gst_buffer_get_size (buf);
@@ -1322,26 +1463,66 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * pad)
   return ret;
 }
 
+/* Writes the pack of a new body partition, followed by the index table
+ * segments of the essence written since the previous one. The essence
+ * stream offset continues from the previous partition */
 static GstFlowReturn
 gst_mxf_mux_write_body_partition (GstMXFMux * mux)
 {
   GstBuffer *buf;
+  GList *index_segments = NULL, *l;
+  guint64 index_byte_count = 0;
+  MXFRandomIndexPackEntry entry;
+  GstFlowReturn ret;
+  guint i;
+
+  for (i = 0; i < mux->index_table->len; i++) {
+    MXFIndexTableSegment *segment =
+        &g_array_index (mux->index_table, MXFIndexTableSegment, i);
+    GstBuffer *segment_buffer = mxf_index_table_segment_to_buffer (segment);
+
+    index_byte_count += gst_buffer_get_size (segment_buffer);
+    index_segments = g_list_prepend (index_segments, segment_buffer);
+  }
+  index_segments = g_list_reverse (index_segments);
+  gst_mxf_mux_clear_index_table (mux);
 
   mux->partition.type = MXF_PARTITION_PACK_BODY;
   mux->partition.closed = TRUE;
   mux->partition.complete = TRUE;
   mux->partition.this_partition = mux->offset;
-  mux->partition.prev_partition = 0;
+  mux->partition.prev_partition =
+      g_array_index (mux->partitions, MXFRandomIndexPackEntry,
+      mux->partitions->len - 1).offset;
   mux->partition.footer_partition = 0;
   mux->partition.header_byte_count = 0;
-  mux->partition.index_byte_count = 0;
-  mux->partition.index_sid = 0;
-  mux->partition.body_offset = 0;
+  mux->partition.index_byte_count = index_byte_count;
+  mux->partition.index_sid = index_byte_count > 0 ?
+      mux->preface->content_storage->essence_container_data[0]->index_sid : 0;
   mux->partition.body_sid =
       mux->preface->content_storage->essence_container_data[0]->body_sid;
 
+  GST_DEBUG_OBJECT (mux, "Writing body partition at offset %" G_GUINT64_FORMAT
+      " with %" G_GUINT64_FORMAT " bytes of index, body offset %"
+      G_GUINT64_FORMAT, mux->offset, index_byte_count,
+      mux->partition.body_offset);
+
+  entry.offset = mux->offset;
+  entry.body_sid = mux->partition.body_sid;
+  g_array_append_val (mux->partitions, entry);
+
   buf = mxf_partition_pack_to_buffer (&mux->partition);
-  return gst_mxf_mux_push (mux, buf);
+  ret = gst_mxf_mux_push (mux, buf);
+
+  for (l = index_segments; l; l = l->next) {
+    if (ret == GST_FLOW_OK)
+      ret = gst_mxf_mux_push (mux, l->data);
+    else
+      gst_buffer_unref (l->data);
+  }
+  g_list_free (index_segments);
+
+  return ret;
 }
 
 static GstFlowReturn
@@ -1458,18 +1639,19 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
   }
 
   {
-    guint64 body_partition = mux->partition.this_partition;
-    guint32 body_sid = mux->partition.body_sid;
+    guint64 first_body_partition =
+        g_array_index (mux->partitions, MXFRandomIndexPackEntry, 1).offset;
     guint64 footer_partition = mux->offset;
-    GArray *rip;
     GstFlowReturn ret;
     GstSegment segment;
     MXFRandomIndexPackEntry entry;
     GList *index_entries = NULL, *l;
-    guint index_byte_count = 0;
+    guint64 index_byte_count = 0;
     guint i;
     GstBuffer *buf;
 
+    /* The footer carries the index of the last body partition's essence */
+    gst_mxf_mux_finish_index_entry (mux);
     for (i = 0; i < mux->index_table->len; i++) {
       MXFIndexTableSegment *segment =
           &g_array_index (mux->index_table, MXFIndexTableSegment, i);
@@ -1483,12 +1665,14 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
     mux->partition.closed = TRUE;
     mux->partition.complete = TRUE;
     mux->partition.this_partition = mux->offset;
-    mux->partition.prev_partition = body_partition;
+    mux->partition.prev_partition =
+        g_array_index (mux->partitions, MXFRandomIndexPackEntry,
+        mux->partitions->len - 1).offset;
     mux->partition.footer_partition = mux->offset;
     mux->partition.header_byte_count = 0;
     mux->partition.index_byte_count = index_byte_count;
-    mux->partition.index_sid =
-        mux->preface->content_storage->essence_container_data[0]->index_sid;
+    mux->partition.index_sid = index_byte_count > 0 ?
+        mux->preface->content_storage->essence_container_data[0]->index_sid : 0;
     mux->partition.body_offset = 0;
     mux->partition.body_sid = 0;
 
@@ -1501,23 +1685,16 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
       }
     }
     g_list_free (index_entries);
+    gst_mxf_mux_clear_index_table (mux);
 
-    rip = g_array_sized_new (FALSE, FALSE, sizeof (MXFRandomIndexPackEntry), 3);
-    entry.offset = 0;
-    entry.body_sid = 0;
-    g_array_append_val (rip, entry);
-    entry.offset = body_partition;
-    entry.body_sid = body_sid;
-    g_array_append_val (rip, entry);
     entry.offset = footer_partition;
     entry.body_sid = 0;
-    g_array_append_val (rip, entry);
+    g_array_append_val (mux->partitions, entry);
 
-    packet = mxf_random_index_pack_to_buffer (rip);
+    packet = mxf_random_index_pack_to_buffer (mux->partitions);
     if ((ret = gst_mxf_mux_push (mux, packet)) != GST_FLOW_OK) {
       GST_ERROR_OBJECT (mux, "Failed pushing random index pack");
     }
-    g_array_free (rip, TRUE);
 
     /* Rewrite header partition with updated values */
     gst_segment_init (&segment, GST_FORMAT_BYTES);
@@ -1542,7 +1719,7 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
         return ret;
       }
 
-      g_assert (mux->offset == body_partition);
+      g_assert (mux->offset == first_body_partition);
 
       mux->partition.type = MXF_PARTITION_PACK_BODY;
       mux->partition.closed = TRUE;
@@ -1605,6 +1782,7 @@ gst_mxf_mux_aggregate (GstAggregator * aggregator, gboolean timeout)
   GstMXFMuxPad *best = NULL;
   GstFlowReturn ret;
   GList *l;
+  guint i;
   gboolean eos = TRUE;
 
   if (timeout) {
@@ -1645,10 +1823,18 @@ gst_mxf_mux_aggregate (GstAggregator * aggregator, gboolean timeout)
     if ((ret = gst_mxf_mux_write_header_metadata (mux)) != GST_FLOW_OK)
       goto error;
 
+    {
+      MXFRandomIndexPackEntry entry = { 0, 0 };
+
+      g_array_append_val (mux->partitions, entry);
+    }
+
     /* Sort pads, we will always write in that order */
     GST_OBJECT_LOCK (mux);
     GST_ELEMENT_CAST (mux)->sinkpads =
         g_list_sort (GST_ELEMENT_CAST (mux)->sinkpads, _sort_mux_pads);
+    for (l = GST_ELEMENT_CAST (mux)->sinkpads, i = 0; l; l = l->next, i++)
+      ((GstMXFMuxPad *) l->data)->index_slice = i;
     GST_OBJECT_UNLOCK (mux);
 
     /* Write body partition */
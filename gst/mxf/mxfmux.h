@@ -69,7 +69,13 @@ typedef struct _GstMXFMux {
 
   gchar *application;
 
+  /* Index table segments for the essence written since the last body
+   * partition, and the RIP entries of all partitions written so far */
   GArray *index_table;
+  GArray *partitions;
+
+  GstClockTime partition_duration;
+  GstClockTime partition_start;
 } GstMXFMux;
 
 typedef struct _GstMXFMuxClass {
@@ -1492,10 +1492,11 @@ mxf_primer_pack_reset (MXFPrimerPack * pack)
 {
   g_return_if_fail (pack != NULL);
 
+  /* Deferred metadata might still hold a reference to the mappings */
   if (pack->mappings)
-    g_hash_table_destroy (pack->mappings);
+    g_hash_table_unref (pack->mappings);
   if (pack->reverse_mappings)
-    g_hash_table_destroy (pack->reverse_mappings);
+    g_hash_table_unref (pack->reverse_mappings);
 
   memset (pack, 0, sizeof (MXFPrimerPack));
 
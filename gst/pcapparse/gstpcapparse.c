@@ -25,6 +25,14 @@
  * #GstPcapParse:src-port and #GstPcapParse:dst-port to restrict which packets
  * should be included.
  *
+ * Both pcap and pcapng captures are understood. The payloads are pushed in
+ * buffer lists and share the memory of the input buffers whenever a packet
+ * is not split across them.
+ *
+ * With #GstPcapParse:index-location, the flows of the capture are indexed
+ * the first time it is parsed, and later runs over the same capture skip the
+ * records of flows that don't match the filters without parsing them.
+ *
  * <refsect2>
  * <title>Example pipelines</title>
  * |[
@@ -46,6 +54,8 @@
 #include "gstpcapparse.h"
 
 #include <string.h>
+#include <gst/base/gstbytereader.h>
+#include <gst/base/gstbytewriter.h>
 
 #ifndef G_OS_WIN32
 #include <arpa/inet.h>
@@ -63,9 +73,31 @@ enum
   PROP_SRC_PORT,
   PROP_DST_PORT,
   PROP_CAPS,
-  PROP_TS_OFFSET
+  PROP_TS_OFFSET,
+  PROP_INDEX_LOCATION
 };
 
+/* Flow of the index entries of records without an IPv4 UDP or TCP packet,
+ * which are always skipped */
+#define INDEX_FLOW_NONE G_MAXUINT32
+/* Flow of the index entries of pcapng blocks describing the capture, which
+ * are never skipped */
+#define INDEX_FLOW_CONTROL (G_MAXUINT32 - 1)
+
+/* Sidecar file format: magic, version, length of the capture, SHA-1 of its
+ * first INDEX_FILE_HASHED_SIZE bytes as hex string, number of flows, their
+ * addresses, ports and protocol, then number of entries and offset, size and
+ * flow of every entry. Addresses are in network byte order, everything else
+ * big endian */
+#define INDEX_FILE_MAGIC "GSTPCIDX"
+#define INDEX_FILE_VERSION 2
+#define INDEX_FILE_DIGEST_SIZE 40
+#define INDEX_FILE_FLOW_SIZE 13
+#define INDEX_FILE_ENTRY_SIZE 20
+/* The file header and the first records, enough to tell apart captures of
+ * the same length */
+#define INDEX_FILE_HASHED_SIZE 4096
+
 GST_DEBUG_CATEGORY_STATIC (gst_pcap_parse_debug);
 #define GST_CAT_DEFAULT gst_pcap_parse_debug
 
@@ -88,6 +120,8 @@ static GstStateChangeReturn
 gst_pcap_parse_change_state (GstElement * element, GstStateChange transition);
 
 static void gst_pcap_parse_reset (GstPcapParse * self);
+static guint gst_pcap_parse_flow_hash (gconstpointer key);
+static gboolean gst_pcap_parse_flow_equal (gconstpointer a, gconstpointer b);
 
 static GstFlowReturn gst_pcap_parse_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buffer);
@@ -138,6 +172,18 @@ gst_pcap_parse_class_init (GstPcapParseClass * klass)
           "Relative timestamp offset (ns) to apply (-1 = use absolute packet time)",
           -1, G_MAXINT64, -1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstPcapParse:index-location:
+   *
+   * File the flow index is loaded from when parsing starts, or saved to once
+   * the whole capture was parsed without an index. The index is only used
+   * for a capture of the same length.
+   */
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "File to load the flow index from and to save it to", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&sink_template));
   gst_element_class_add_pad_template (element_class,
@@ -175,6 +221,13 @@ gst_pcap_parse_init (GstPcapParse * self)
   self->offset = -1;
 
   self->adapter = gst_adapter_new ();
+  self->interfaces = g_array_new (FALSE, FALSE,
+      sizeof (GstPcapParseInterface));
+  self->index = g_array_new (FALSE, FALSE, sizeof (GstPcapParseIndexEntry));
+  self->flows = g_array_new (FALSE, FALSE, sizeof (GstPcapParseFlow));
+  self->flow_ids = g_hash_table_new_full (gst_pcap_parse_flow_hash,
+      gst_pcap_parse_flow_equal, g_free, NULL);
+  self->index_checksum = g_checksum_new (G_CHECKSUM_SHA1);
 
   gst_pcap_parse_reset (self);
 }
@@ -187,6 +240,13 @@ gst_pcap_parse_finalize (GObject * object)
   g_object_unref (self->adapter);
   if (self->caps)
     gst_caps_unref (self->caps);
+  g_free (self->index_location);
+  g_array_free (self->interfaces, TRUE);
+  g_array_free (self->index, TRUE);
+  g_array_free (self->flows, TRUE);
+  g_hash_table_destroy (self->flow_ids);
+  g_checksum_free (self->index_checksum);
+  g_free (self->index_digest);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -246,6 +306,12 @@ gst_pcap_parse_get_property (GObject * object, guint prop_id,
       g_value_set_int64 (value, self->offset);
       break;
 
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->index_location);
+      GST_OBJECT_UNLOCK (self);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -300,6 +366,13 @@ gst_pcap_parse_set_property (GObject * object, guint prop_id,
       self->offset = g_value_get_int64 (value);
       break;
 
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (self);
+      g_free (self->index_location);
+      self->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -311,14 +384,66 @@ gst_pcap_parse_reset (GstPcapParse * self)
 {
   self->initialized = FALSE;
   self->swap_endian = FALSE;
-  self->cur_packet_size = -1;
+  self->pcapng = FALSE;
+  self->nsec_timestamps = FALSE;
   self->cur_ts = GST_CLOCK_TIME_NONE;
   self->base_ts = GST_CLOCK_TIME_NONE;
   self->newsegment_sent = FALSE;
+  self->stream_offset = 0;
+  self->skip = 0;
+
+  self->index_length = 0;
+  self->index_pos = 0;
+  self->index_loaded = FALSE;
+  self->index_building = FALSE;
+  self->index_complete = FALSE;
+  self->index_hashed = 0;
+  g_checksum_reset (self->index_checksum);
+  g_free (self->index_digest);
+  self->index_digest = NULL;
+  g_array_set_size (self->index, 0);
+  g_array_set_size (self->flows, 0);
+  g_hash_table_remove_all (self->flow_ids);
+  g_array_set_size (self->interfaces, 0);
 
   gst_adapter_clear (self->adapter);
 }
 
+static guint
+gst_pcap_parse_flow_hash (gconstpointer key)
+{
+  const GstPcapParseFlow *flow = key;
+
+  return flow->src_ip ^ (flow->dst_ip * 31) ^ (flow->src_port << 16) ^
+      flow->dst_port ^ (flow->protocol << 8);
+}
+
+static gboolean
+gst_pcap_parse_flow_equal (gconstpointer a, gconstpointer b)
+{
+  const GstPcapParseFlow *fa = a, *fb = b;
+
+  return fa->src_ip == fb->src_ip && fa->dst_ip == fb->dst_ip &&
+      fa->src_port == fb->src_port && fa->dst_port == fb->dst_port &&
+      fa->protocol == fb->protocol;
+}
+
+static guint16
+gst_pcap_parse_read_uint16 (GstPcapParse * self, const guint8 * p)
+{
+  guint16 val = *((guint16 *) p);
+
+  if (self->swap_endian) {
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    return GUINT16_FROM_BE (val);
+#else
+    return GUINT16_FROM_LE (val);
+#endif
+  } else {
+    return val;
+  }
+}
+
 static guint32
 gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 {
@@ -343,11 +468,23 @@ gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 #define IP_PROTO_UDP      17
 #define IP_PROTO_TCP      6
 
+#define PCAP_HEADER_LEN         24
+#define PCAP_RECORD_HEADER_LEN  16
+
+#define PCAPNG_BLOCK_HEADER_LEN 12
+#define PCAPNG_BLOCK_IDB        0x00000001
+#define PCAPNG_BLOCK_SPB        0x00000003
+#define PCAPNG_BLOCK_EPB        0x00000006
+#define PCAPNG_BLOCK_SHB        0x0a0d0d0a
+#define PCAPNG_OPTION_END       0
+#define PCAPNG_OPTION_TSRESOL   9
 
+
+/* Finds the payload of the IPv4 UDP or TCP packet in @buf and its flow */
 static gboolean
 gst_pcap_parse_scan_frame (GstPcapParse * self,
-    const guint8 * buf,
-    gint buf_size, const guint8 ** payload, gint * payload_size)
+    GstPcapParseLinktype linktype, const guint8 * buf, gint buf_size,
+    GstPcapParseFlow * flow, const guint8 ** payload, gint * payload_size)
 {
   const guint8 *buf_ip = 0;
   const guint8 *buf_proto;
@@ -361,7 +498,7 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
   guint16 dst_port;
   guint16 len;
 
-  switch (self->linktype) {
+  switch (linktype) {
     case LINKTYPE_ETHER:
       if (buf_size < ETH_HEADER_LEN + IP_HEADER_MIN_LEN + UDP_HEADER_LEN)
         return FALSE;
@@ -431,25 +568,602 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
 
     /* all remaining data following tcp header is payload */
     *payload = buf_proto + len;
-    *payload_size = self->cur_packet_size - (buf_proto - buf) - len;
+    *payload_size = buf_size - (buf_proto - buf) - len;
   }
 
-  /* but still filter as configured */
-  if (self->src_ip >= 0 && ip_src_addr != self->src_ip)
+  flow->src_ip = ip_src_addr;
+  flow->dst_ip = ip_dst_addr;
+  flow->src_port = src_port;
+  flow->dst_port = dst_port;
+  flow->protocol = ip_protocol;
+
+  return TRUE;
+}
+
+/* Filters as configured */
+static gboolean
+gst_pcap_parse_flow_matches (GstPcapParse * self, const GstPcapParseFlow * flow)
+{
+  if (self->src_ip >= 0 && flow->src_ip != self->src_ip)
     return FALSE;
 
-  if (self->dst_ip >= 0 && ip_dst_addr != self->dst_ip)
+  if (self->dst_ip >= 0 && flow->dst_ip != self->dst_ip)
     return FALSE;
 
-  if (self->src_port >= 0 && src_port != self->src_port)
+  if (self->src_port >= 0 && flow->src_port != self->src_port)
     return FALSE;
 
-  if (self->dst_port >= 0 && dst_port != self->dst_port)
+  if (self->dst_port >= 0 && flow->dst_port != self->dst_port)
     return FALSE;
 
   return TRUE;
 }
 
+static guint32
+gst_pcap_parse_flow_id (GstPcapParse * self, const GstPcapParseFlow * flow)
+{
+  gpointer id;
+
+  if (g_hash_table_lookup_extended (self->flow_ids, flow, NULL, &id))
+    return GPOINTER_TO_UINT (id);
+
+  g_array_append_val (self->flows, *flow);
+  g_hash_table_insert (self->flow_ids, g_memdup (flow, sizeof (*flow)),
+      GUINT_TO_POINTER (self->flows->len - 1));
+
+  return self->flows->len - 1;
+}
+
+/* Adds the record of @size bytes at the current position to the index,
+ * merging it with the previous entry if that is of the same flow */
+static void
+gst_pcap_parse_index_add (GstPcapParse * self, guint64 size, guint32 flow)
+{
+  GstPcapParseIndexEntry *last = NULL;
+  GstPcapParseIndexEntry entry;
+
+  if (self->index->len > 0)
+    last = &g_array_index (self->index, GstPcapParseIndexEntry,
+        self->index->len - 1);
+
+  if (last && last->flow == flow &&
+      last->offset + last->size == self->stream_offset) {
+    last->size += size;
+    return;
+  }
+
+  entry.offset = self->stream_offset;
+  entry.size = size;
+  entry.flow = flow;
+  g_array_append_val (self->index, entry);
+}
+
+/* Returns the number of bytes at the current position that belong to
+ * records which can be skipped according to the index, or 0 */
+static guint64
+gst_pcap_parse_index_skip (GstPcapParse * self)
+{
+  GstPcapParseIndexEntry *entry;
+
+  if (!self->index_loaded)
+    return 0;
+
+  while (self->index_pos < self->index->len) {
+    entry = &g_array_index (self->index, GstPcapParseIndexEntry,
+        self->index_pos);
+    if (entry->offset + entry->size > self->stream_offset)
+      break;
+    self->index_pos++;
+  }
+
+  if (self->index_pos == self->index->len)
+    return 0;
+
+  /* only skip whole entries */
+  entry = &g_array_index (self->index, GstPcapParseIndexEntry,
+      self->index_pos);
+  if (entry->offset != self->stream_offset || entry->flow == INDEX_FLOW_CONTROL)
+    return 0;
+
+  if (entry->flow == INDEX_FLOW_NONE ||
+      !gst_pcap_parse_flow_matches (self,
+          &g_array_index (self->flows, GstPcapParseFlow, entry->flow)))
+    return entry->size;
+
+  return 0;
+}
+
+static gboolean
+gst_pcap_parse_load_index (GstPcapParse * self, const gchar * location)
+{
+  GstByteReader reader;
+  GError *err = NULL;
+  gchar *contents;
+  gsize size;
+  const guint8 *magic, *digest, *ips;
+  guint32 version, n_flows, n_entries, i;
+  guint64 length, end = 0;
+  GArray *index = NULL, *flows = NULL;
+
+  if (!g_file_get_contents (location, &contents, &size, &err)) {
+    GST_DEBUG_OBJECT (self, "can't read index %s: %s", location,
+        err->message);
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  gst_byte_reader_init (&reader, (const guint8 *) contents, size);
+  if (!gst_byte_reader_get_data (&reader, 8, &magic) ||
+      memcmp (magic, INDEX_FILE_MAGIC, 8) != 0 ||
+      !gst_byte_reader_get_uint32_be (&reader, &version) ||
+      version != INDEX_FILE_VERSION ||
+      !gst_byte_reader_get_uint64_be (&reader, &length) ||
+      !gst_byte_reader_get_data (&reader, INDEX_FILE_DIGEST_SIZE, &digest) ||
+      !gst_byte_reader_get_uint32_be (&reader, &n_flows) ||
+      gst_byte_reader_get_remaining (&reader) / INDEX_FILE_FLOW_SIZE <
+      n_flows)
+    goto invalid;
+
+  if (length != self->index_length) {
+    GST_WARNING_OBJECT (self, "index %s is for a capture of %"
+        G_GUINT64_FORMAT " bytes, not %" G_GUINT64_FORMAT, location, length,
+        self->index_length);
+    g_free (contents);
+    return FALSE;
+  }
+
+  if (memcmp (digest, self->index_digest, INDEX_FILE_DIGEST_SIZE) != 0) {
+    GST_WARNING_OBJECT (self, "index %s is for a different capture",
+        location);
+    g_free (contents);
+    return FALSE;
+  }
+
+  /* the index built so far is kept until this one turns out valid */
+  index = g_array_sized_new (FALSE, FALSE, sizeof (GstPcapParseIndexEntry),
+      0);
+  flows = g_array_sized_new (FALSE, FALSE, sizeof (GstPcapParseFlow),
+      n_flows);
+
+  for (i = 0; i < n_flows; i++) {
+    GstPcapParseFlow flow;
+
+    ips = gst_byte_reader_get_data_unchecked (&reader, 8);
+    memcpy (&flow.src_ip, ips, 4);
+    memcpy (&flow.dst_ip, ips + 4, 4);
+    flow.src_port = gst_byte_reader_get_uint16_be_unchecked (&reader);
+    flow.dst_port = gst_byte_reader_get_uint16_be_unchecked (&reader);
+    flow.protocol = gst_byte_reader_get_uint8_unchecked (&reader);
+    g_array_append_val (flows, flow);
+  }
+
+  if (!gst_byte_reader_get_uint32_be (&reader, &n_entries) ||
+      gst_byte_reader_get_remaining (&reader) / INDEX_FILE_ENTRY_SIZE <
+      n_entries)
+    goto invalid;
+
+  for (i = 0; i < n_entries; i++) {
+    GstPcapParseIndexEntry entry;
+
+    entry.offset = gst_byte_reader_get_uint64_be_unchecked (&reader);
+    entry.size = gst_byte_reader_get_uint64_be_unchecked (&reader);
+    entry.flow = gst_byte_reader_get_uint32_be_unchecked (&reader);
+
+    if (entry.offset < end || entry.size == 0 || entry.size > length ||
+        entry.offset > length - entry.size || (entry.flow >= n_flows &&
+            entry.flow != INDEX_FLOW_NONE && entry.flow != INDEX_FLOW_CONTROL))
+      goto invalid;
+
+    end = entry.offset + entry.size;
+    g_array_append_val (index, entry);
+  }
+
+  g_array_free (self->index, TRUE);
+  g_array_free (self->flows, TRUE);
+  self->index = index;
+  self->flows = flows;
+  g_hash_table_remove_all (self->flow_ids);
+  self->index_pos = 0;
+
+  GST_INFO_OBJECT (self, "loaded %u index entries of %u flows from %s",
+      self->index->len, self->flows->len, location);
+
+  g_free (contents);
+  return TRUE;
+
+invalid:
+  {
+    GST_WARNING_OBJECT (self, "invalid index %s", location);
+    if (index)
+      g_array_free (index, TRUE);
+    if (flows)
+      g_array_free (flows, TRUE);
+    g_free (contents);
+    return FALSE;
+  }
+}
+
+static void
+gst_pcap_parse_save_index (GstPcapParse * self, const gchar * location)
+{
+  GstByteWriter writer;
+  GError *err = NULL;
+  guint8 *data;
+  guint size, i;
+
+  gst_byte_writer_init_with_size (&writer,
+      28 + INDEX_FILE_DIGEST_SIZE + self->flows->len * INDEX_FILE_FLOW_SIZE +
+      self->index->len * INDEX_FILE_ENTRY_SIZE, FALSE);
+  gst_byte_writer_put_data (&writer, (const guint8 *) INDEX_FILE_MAGIC, 8);
+  gst_byte_writer_put_uint32_be (&writer, INDEX_FILE_VERSION);
+  gst_byte_writer_put_uint64_be (&writer, self->index_length);
+  gst_byte_writer_put_data (&writer, (const guint8 *) self->index_digest,
+      INDEX_FILE_DIGEST_SIZE);
+  gst_byte_writer_put_uint32_be (&writer, self->flows->len);
+  for (i = 0; i < self->flows->len; i++) {
+    GstPcapParseFlow *flow = &g_array_index (self->flows, GstPcapParseFlow, i);
+
+    gst_byte_writer_put_data (&writer, (const guint8 *) &flow->src_ip, 4);
+    gst_byte_writer_put_data (&writer, (const guint8 *) &flow->dst_ip, 4);
+    gst_byte_writer_put_uint16_be (&writer, flow->src_port);
+    gst_byte_writer_put_uint16_be (&writer, flow->dst_port);
+    gst_byte_writer_put_uint8 (&writer, flow->protocol);
+  }
+  gst_byte_writer_put_uint32_be (&writer, self->index->len);
+  for (i = 0; i < self->index->len; i++) {
+    GstPcapParseIndexEntry *entry =
+        &g_array_index (self->index, GstPcapParseIndexEntry, i);
+
+    gst_byte_writer_put_uint64_be (&writer, entry->offset);
+    gst_byte_writer_put_uint64_be (&writer, entry->size);
+    gst_byte_writer_put_uint32_be (&writer, entry->flow);
+  }
+
+  size = gst_byte_writer_get_size (&writer);
+  data = gst_byte_writer_reset_and_get_data (&writer);
+
+  if (!g_file_set_contents (location, (const gchar *) data, size, &err)) {
+    GST_WARNING_OBJECT (self, "can't save index to %s: %s", location,
+        err->message);
+    g_clear_error (&err);
+  } else {
+    GST_INFO_OBJECT (self, "saved %u index entries of %u flows to %s",
+        self->index->len, self->flows->len, location);
+  }
+
+  g_free (data);
+}
+
+/* Loads the index once the start of the capture was hashed. Until then, and
+ * if there is no valid index, it is built. */
+static void
+gst_pcap_parse_check_index (GstPcapParse * self)
+{
+  gchar *location;
+
+  if (!self->index_building || self->index_digest ||
+      self->index_hashed < MIN (INDEX_FILE_HASHED_SIZE, self->index_length))
+    return;
+
+  self->index_digest = g_strdup (g_checksum_get_string (self->index_checksum));
+
+  GST_OBJECT_LOCK (self);
+  location = g_strdup (self->index_location);
+  GST_OBJECT_UNLOCK (self);
+
+  if (location && gst_pcap_parse_load_index (self, location)) {
+    self->index_loaded = TRUE;
+    self->index_building = FALSE;
+  }
+
+  g_free (location);
+}
+
+/* Hashes the start of the capture, which has to match that of the index */
+static void
+gst_pcap_parse_hash_index (GstPcapParse * self, GstBuffer * buffer)
+{
+  GstMapInfo map;
+  gsize size;
+
+  if (self->index_hashed >= INDEX_FILE_HASHED_SIZE)
+    return;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return;
+  size = MIN (map.size, INDEX_FILE_HASHED_SIZE - self->index_hashed);
+  g_checksum_update (self->index_checksum, map.data, size);
+  self->index_hashed += size;
+  gst_buffer_unmap (buffer, &map);
+
+  gst_pcap_parse_check_index (self);
+}
+
+/* Called once the file header was parsed, starts building the index */
+static void
+gst_pcap_parse_start_index (GstPcapParse * self)
+{
+  gboolean indexing;
+  gint64 length;
+
+  GST_OBJECT_LOCK (self);
+  indexing = self->index_location != NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (!indexing)
+    return;
+
+  if (!gst_pad_peer_query_duration (self->sink_pad, GST_FORMAT_BYTES, &length)
+      || length <= 0) {
+    GST_DEBUG_OBJECT (self, "length of the capture unknown, not indexing");
+    return;
+  }
+
+  self->index_length = length;
+  self->index_building = TRUE;
+  gst_pcap_parse_check_index (self);
+}
+
+static void
+gst_pcap_parse_add_interface (GstPcapParse * self, const guint8 * data,
+    gsize size)
+{
+  GstPcapParseInterface iface;
+  gsize pos = 16;
+
+  if (size < 20)
+    return;
+
+  iface.linktype = gst_pcap_parse_read_uint16 (self, data + 8);
+  iface.ts_units = 1000000;
+
+  /* options up to the trailing block length */
+  while (pos + 4 <= size - 4) {
+    guint16 code = gst_pcap_parse_read_uint16 (self, data + pos);
+    guint16 len = gst_pcap_parse_read_uint16 (self, data + pos + 2);
+
+    if (code == PCAPNG_OPTION_END || pos + 4 + len > size - 4)
+      break;
+
+    if (code == PCAPNG_OPTION_TSRESOL && len >= 1) {
+      guint8 resol = data[pos + 4];
+
+      /* negative power of 2 if the highest bit is set, else of 10 */
+      if (resol & 0x80) {
+        if ((resol & 0x7f) < 64)
+          iface.ts_units = G_GUINT64_CONSTANT (1) << (resol & 0x7f);
+      } else if (resol <= 19) {
+        iface.ts_units = 1;
+        while (resol--)
+          iface.ts_units *= 10;
+      }
+    }
+
+    pos += 4 + GST_ROUND_UP_4 (len);
+  }
+
+  GST_DEBUG_OBJECT (self, "interface %u, linktype %u, %" G_GUINT64_FORMAT
+      " timestamp units per second", self->interfaces->len, iface.linktype,
+      iface.ts_units);
+
+  g_array_append_val (self->interfaces, iface);
+}
+
+/* Returns the size of the record or pcapng block whose header is at @data,
+ * or 0 if it is invalid */
+static gsize
+gst_pcap_parse_record_size (GstPcapParse * self, const guint8 * data)
+{
+  guint32 size;
+
+  if (!self->pcapng)
+    return PCAP_RECORD_HEADER_LEN + gst_pcap_parse_read_uint32 (self, data + 8);
+
+  /* the byte order of a section is given by its header */
+  if (GST_READ_UINT32_LE (data) == PCAPNG_BLOCK_SHB) {
+    guint32 magic = *((guint32 *) (data + 8));
+
+    if (magic == 0x1a2b3c4d)
+      self->swap_endian = FALSE;
+    else if (magic == 0x4d3c2b1a)
+      self->swap_endian = TRUE;
+    else
+      return 0;
+  }
+
+  size = gst_pcap_parse_read_uint32 (self, data + 4);
+  if (size < PCAPNG_BLOCK_HEADER_LEN || size % 4 != 0)
+    return 0;
+
+  return size;
+}
+
+/* Parses the record or pcapng block of @size bytes at @data, which starts at
+ * the current position. Returns TRUE if it carries a payload that passes the
+ * filters, at @payload_offset from @data */
+static gboolean
+gst_pcap_parse_record (GstPcapParse * self, const guint8 * data, gsize size,
+    gsize * payload_offset, gint * payload_size)
+{
+  GstPcapParseLinktype linktype = self->linktype;
+  GstPcapParseFlow flow;
+  const guint8 *frame = NULL, *payload;
+  gint frame_size = 0;
+  guint32 flow_id = INDEX_FLOW_NONE;
+  gboolean ret = FALSE;
+
+  if (!self->pcapng) {
+    guint32 ts_sec = gst_pcap_parse_read_uint32 (self, data + 0);
+    guint32 ts_frac = gst_pcap_parse_read_uint32 (self, data + 4);
+
+    self->cur_ts = ts_sec * GST_SECOND +
+        ts_frac * (self->nsec_timestamps ? 1 : GST_USECOND);
+    frame = data + PCAP_RECORD_HEADER_LEN;
+    frame_size = size - PCAP_RECORD_HEADER_LEN;
+  } else {
+    GstPcapParseInterface *iface;
+    guint32 caplen, if_id;
+    guint64 ts;
+
+    switch (gst_pcap_parse_read_uint32 (self, data)) {
+      case PCAPNG_BLOCK_SHB:
+        /* interface ids are per section */
+        g_array_set_size (self->interfaces, 0);
+        flow_id = INDEX_FLOW_CONTROL;
+        break;
+      case PCAPNG_BLOCK_IDB:
+        gst_pcap_parse_add_interface (self, data, size);
+        flow_id = INDEX_FLOW_CONTROL;
+        break;
+      case PCAPNG_BLOCK_EPB:
+        if (size < 32)
+          break;
+        if_id = gst_pcap_parse_read_uint32 (self, data + 8);
+        caplen = gst_pcap_parse_read_uint32 (self, data + 20);
+        if (if_id >= self->interfaces->len || caplen > size - 32) {
+          GST_WARNING_OBJECT (self, "invalid enhanced packet block");
+          break;
+        }
+        iface = &g_array_index (self->interfaces, GstPcapParseInterface, if_id);
+        ts = ((guint64) gst_pcap_parse_read_uint32 (self, data + 12) << 32) |
+            gst_pcap_parse_read_uint32 (self, data + 16);
+        self->cur_ts = gst_util_uint64_scale (ts, GST_SECOND, iface->ts_units);
+        linktype = iface->linktype;
+        frame = data + 28;
+        frame_size = caplen;
+        break;
+      case PCAPNG_BLOCK_SPB:
+        if (size < 16 || self->interfaces->len == 0)
+          break;
+        iface = &g_array_index (self->interfaces, GstPcapParseInterface, 0);
+        /* simple packet blocks have no timestamp */
+        self->cur_ts = GST_CLOCK_TIME_NONE;
+        linktype = iface->linktype;
+        frame = data + 12;
+        frame_size = MIN (gst_pcap_parse_read_uint32 (self, data + 8),
+            size - 16);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (frame && gst_pcap_parse_scan_frame (self, linktype, frame, frame_size,
+          &flow, &payload, payload_size)) {
+    if (self->index_building)
+      flow_id = gst_pcap_parse_flow_id (self, &flow);
+
+    if (gst_pcap_parse_flow_matches (self, &flow)) {
+      *payload_offset = payload - data;
+      ret = TRUE;
+    }
+  }
+
+  if (self->index_building)
+    gst_pcap_parse_index_add (self, size, flow_id);
+
+  return ret;
+}
+
+static void
+gst_pcap_parse_add_payload (GstPcapParse * self, GstBufferList ** list,
+    GstBuffer * out_buf)
+{
+  /* the RTP depayloaders expect the complete RTP header to be in the first
+   * memory, so merge payloads that span memories of the input */
+  if (gst_buffer_n_memory (out_buf) > 1)
+    gst_buffer_replace_all_memory (out_buf, gst_buffer_get_all_memory (out_buf));
+
+  if (GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
+    if (!GST_CLOCK_TIME_IS_VALID (self->base_ts))
+      self->base_ts = self->cur_ts;
+    if (self->offset >= 0) {
+      self->cur_ts -= self->base_ts;
+      self->cur_ts += self->offset;
+    }
+  }
+  GST_BUFFER_TIMESTAMP (out_buf) = self->cur_ts;
+
+  if (*list == NULL)
+    *list = gst_buffer_list_new ();
+  gst_buffer_list_add (*list, out_buf);
+}
+
+/* Parses the complete records of @buffer, which starts at a record
+ * boundary, in place. The payloads are sub-buffers of @buffer and the
+ * remaining data is put back into the adapter */
+static GstFlowReturn
+gst_pcap_parse_buffer (GstPcapParse * self, GstBuffer * buffer,
+    GstBufferList ** list)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo map;
+  gsize header_size, pos = 0;
+
+  header_size = self->pcapng ? PCAPNG_BLOCK_HEADER_LEN : PCAP_RECORD_HEADER_LEN;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    gst_buffer_unref (buffer);
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  while (map.size - pos >= header_size) {
+    gsize record_size, payload_offset;
+    gint payload_size;
+    guint64 skip;
+
+    if ((skip = gst_pcap_parse_index_skip (self)) > 0) {
+      if (skip > map.size - pos) {
+        self->skip = skip - (map.size - pos);
+        self->stream_offset += map.size - pos;
+        pos = map.size;
+        break;
+      }
+      pos += skip;
+      self->stream_offset += skip;
+      continue;
+    }
+
+    record_size = gst_pcap_parse_record_size (self, map.data + pos);
+    if (record_size == 0) {
+      GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+          ("Invalid pcapng block at offset %" G_GUINT64_FORMAT,
+              self->stream_offset));
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+    if (record_size > map.size - pos)
+      break;
+
+    if (gst_pcap_parse_record (self, map.data + pos, record_size,
+            &payload_offset, &payload_size)) {
+      GstBuffer *out_buf;
+
+      if (payload_size > 0) {
+        out_buf = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+            pos + payload_offset, payload_size);
+      } else {
+        out_buf = gst_buffer_new ();
+      }
+      gst_pcap_parse_add_payload (self, list, out_buf);
+    }
+
+    pos += record_size;
+    self->stream_offset += record_size;
+  }
+
+  if (ret == GST_FLOW_OK && pos < map.size)
+    gst_adapter_push (self->adapter, gst_buffer_copy_region (buffer,
+            GST_BUFFER_COPY_MEMORY, pos, map.size - pos));
+
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
 static GstFlowReturn
 gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
@@ -457,115 +1171,134 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   GstFlowReturn ret = GST_FLOW_OK;
   GstBufferList *list = NULL;
 
+  gst_pcap_parse_hash_index (self, buffer);
   gst_adapter_push (self->adapter, buffer);
 
   while (ret == GST_FLOW_OK) {
-    gint avail;
+    gsize avail;
     const guint8 *data;
 
     avail = gst_adapter_available (self->adapter);
 
-    if (self->initialized) {
-      if (self->cur_packet_size >= 0) {
-        if (avail < self->cur_packet_size)
-          break;
+    if (self->skip > 0) {
+      gsize flush = MIN (self->skip, avail);
 
-        if (self->cur_packet_size > 0) {
-          const guint8 *payload_data;
-          gint payload_size;
-
-          data = gst_adapter_map (self->adapter, self->cur_packet_size);
-
-          GST_LOG_OBJECT (self, "examining packet size %" G_GINT64_FORMAT,
-              self->cur_packet_size);
-
-          if (gst_pcap_parse_scan_frame (self, data, self->cur_packet_size,
-                  &payload_data, &payload_size)) {
-            GstBuffer *out_buf;
-            guintptr offset = payload_data - data;
-
-            gst_adapter_unmap (self->adapter);
-            gst_adapter_flush (self->adapter, offset);
-            /* we don't use _take_buffer_fast() on purpose here, we need a
-             * buffer with a single memory, since the RTP depayloaders expect
-             * the complete RTP header to be in the first memory if there are
-             * multiple ones and we can't guarantee that with _fast() */
-            if (payload_size > 0) {
-              out_buf = gst_adapter_take_buffer (self->adapter, payload_size);
-            } else {
-              out_buf = gst_buffer_new ();
-            }
-            gst_adapter_flush (self->adapter,
-                self->cur_packet_size - offset - payload_size);
-
-            if (GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
-              if (!GST_CLOCK_TIME_IS_VALID (self->base_ts))
-                self->base_ts = self->cur_ts;
-              if (self->offset >= 0) {
-                self->cur_ts -= self->base_ts;
-                self->cur_ts += self->offset;
-              }
-            }
-            GST_BUFFER_TIMESTAMP (out_buf) = self->cur_ts;
-
-
-            if (list == NULL)
-              list = gst_buffer_list_new ();
-            gst_buffer_list_add (list, out_buf);
-          } else {
-            gst_adapter_unmap (self->adapter);
-            gst_adapter_flush (self->adapter, self->cur_packet_size);
-          }
-        }
+      if (flush == 0)
+        break;
 
-        self->cur_packet_size = -1;
-      } else {
-        guint32 ts_sec;
-        guint32 ts_usec;
-        guint32 incl_len;
+      gst_adapter_flush (self->adapter, flush);
+      self->skip -= flush;
+      self->stream_offset += flush;
+    } else if (self->initialized) {
+      gsize header_size, record_size, payload_offset;
+      gint payload_size;
 
-        if (avail < 16)
-          break;
+      if ((self->skip = gst_pcap_parse_index_skip (self)) > 0)
+        continue;
+
+      header_size = self->pcapng ? PCAPNG_BLOCK_HEADER_LEN :
+          PCAP_RECORD_HEADER_LEN;
+      if (avail < header_size)
+        break;
+
+      /* everything is in one buffer, parse all complete records in place */
+      if (gst_adapter_available_fast (self->adapter) == avail) {
+        ret = gst_pcap_parse_buffer (self,
+            gst_adapter_take_buffer (self->adapter, avail), &list);
+        if (ret != GST_FLOW_OK)
+          goto out;
+        break;
+      }
+
+      /* a record split across buffers, handle it on its own */
+      data = gst_adapter_map (self->adapter, header_size);
+      record_size = gst_pcap_parse_record_size (self, data);
+      gst_adapter_unmap (self->adapter);
+
+      if (record_size == 0) {
+        GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+            ("Invalid pcapng block at offset %" G_GUINT64_FORMAT,
+                self->stream_offset));
+        ret = GST_FLOW_ERROR;
+        goto out;
+      }
+      if (avail < record_size)
+        break;
 
-        data = gst_adapter_map (self->adapter, 16);
+      data = gst_adapter_map (self->adapter, record_size);
 
-        ts_sec = gst_pcap_parse_read_uint32 (self, data + 0);
-        ts_usec = gst_pcap_parse_read_uint32 (self, data + 4);
-        incl_len = gst_pcap_parse_read_uint32 (self, data + 8);
-        /* orig_len = gst_pcap_parse_read_uint32 (self, data + 12); */
+      GST_LOG_OBJECT (self, "examining record size %" G_GSIZE_FORMAT,
+          record_size);
+
+      if (gst_pcap_parse_record (self, data, record_size, &payload_offset,
+              &payload_size)) {
+        GstBuffer *out_buf;
 
         gst_adapter_unmap (self->adapter);
-        gst_adapter_flush (self->adapter, 16);
+        gst_adapter_flush (self->adapter, payload_offset);
+        /* we don't use _take_buffer_fast() on purpose here, we need a
+         * buffer with a single memory, since the RTP depayloaders expect
+         * the complete RTP header to be in the first memory if there are
+         * multiple ones and we can't guarantee that with _fast() */
+        if (payload_size > 0) {
+          out_buf = gst_adapter_take_buffer (self->adapter, payload_size);
+        } else {
+          out_buf = gst_buffer_new ();
+        }
+        gst_adapter_flush (self->adapter,
+            record_size - payload_offset - payload_size);
 
-        self->cur_ts = ts_sec * GST_SECOND + ts_usec * GST_USECOND;
-        self->cur_packet_size = incl_len;
+        gst_pcap_parse_add_payload (self, &list, out_buf);
+      } else {
+        gst_adapter_unmap (self->adapter);
+        gst_adapter_flush (self->adapter, record_size);
       }
+
+      self->stream_offset += record_size;
     } else {
       guint32 magic;
       guint32 linktype;
       guint16 major_version;
 
-      if (avail < 24)
+      if (avail < 4)
         break;
 
-      data = gst_adapter_map (self->adapter, 24);
-
+      data = gst_adapter_map (self->adapter, 4);
       magic = *((guint32 *) data);
-      major_version = *((guint16 *) (data + 4));
-      linktype = gst_pcap_parse_read_uint32 (self, data + 20);
       gst_adapter_unmap (self->adapter);
 
-      if (magic == 0xa1b2c3d4) {
+      /* the section header block is parsed like any other block */
+      if (magic == PCAPNG_BLOCK_SHB) {
+        GST_DEBUG_OBJECT (self, "pcapng capture");
+        self->pcapng = TRUE;
+        self->initialized = TRUE;
+        gst_pcap_parse_start_index (self);
+        continue;
+      }
+
+      if (avail < PCAP_HEADER_LEN)
+        break;
+
+      data = gst_adapter_map (self->adapter, PCAP_HEADER_LEN);
+
+      major_version = *((guint16 *) (data + 4));
+
+      if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d) {
         self->swap_endian = FALSE;
-      } else if (magic == 0xd4c3b2a1) {
+      } else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1) {
         self->swap_endian = TRUE;
         major_version = major_version << 8 | major_version >> 8;
       } else {
+        gst_adapter_unmap (self->adapter);
         GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
             ("File is not a libpcap file, magic is %X", magic));
         ret = GST_FLOW_ERROR;
         goto out;
       }
+      self->nsec_timestamps = (magic == 0xa1b23c4d || magic == 0x4d3cb2a1);
+
+      linktype = gst_pcap_parse_read_uint32 (self, data + 20);
+      gst_adapter_unmap (self->adapter);
 
       if (major_version != 2) {
         GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
@@ -586,8 +1319,10 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       GST_DEBUG_OBJECT (self, "linktype %u", linktype);
       self->linktype = linktype;
 
-      gst_adapter_flush (self->adapter, 24);
+      gst_adapter_flush (self->adapter, PCAP_HEADER_LEN);
+      self->stream_offset += PCAP_HEADER_LEN;
       self->initialized = TRUE;
+      gst_pcap_parse_start_index (self);
     }
   }
 
@@ -626,6 +1361,12 @@ gst_pcap_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       /* Drop it, we'll replace it with our own */
       gst_event_unref (event);
       break;
+    case GST_EVENT_EOS:
+      /* the index is only saved if it covers the whole capture */
+      if (self->index_building && self->index_digest)
+        self->index_complete = TRUE;
+      ret = gst_pad_push_event (self->src_pad, event);
+      break;
     case GST_EVENT_FLUSH_STOP:
       gst_pcap_parse_reset (self);
       /* Push event down the pipeline so that other elements stop flushing */
@@ -643,11 +1384,20 @@ gst_pcap_parse_change_state (GstElement * element, GstStateChange transition)
 {
   GstPcapParse *self = GST_PCAP_PARSE (element);
   GstStateChangeReturn ret;
+  gchar *index_location;
 
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      GST_OBJECT_LOCK (self);
+      index_location = g_strdup (self->index_location);
+      GST_OBJECT_UNLOCK (self);
+
+      if (index_location && self->index_complete)
+        gst_pcap_parse_save_index (self, index_location);
+      g_free (index_location);
+
       gst_pcap_parse_reset (self);
       break;
     default:
@@ -52,6 +52,32 @@ typedef enum
   LINKTYPE_SLL = 113
 } GstPcapParseLinktype;
 
+/* IPv4 UDP or TCP flow, addresses in network byte order */
+typedef struct
+{
+  guint32 src_ip;
+  guint32 dst_ip;
+  guint16 src_port;
+  guint16 dst_port;
+  guint8 protocol;
+} GstPcapParseFlow;
+
+/* Run of consecutive records of a flow in the capture */
+typedef struct
+{
+  guint64 offset;
+  guint64 size;
+  guint32 flow;
+} GstPcapParseIndexEntry;
+
+/* pcapng interface */
+typedef struct
+{
+  GstPcapParseLinktype linktype;
+  /* timestamp units per second */
+  guint64 ts_units;
+} GstPcapParseInterface;
+
 /**
  * GstPcapParse:
  *
@@ -73,15 +99,37 @@ struct _GstPcapParse
   gint32 dst_port;
   GstCaps *caps;
   gint64 offset;
+  gchar *index_location;
 
   /* state */
   GstAdapter * adapter;
   gboolean initialized;
   gboolean swap_endian;
-  gint64 cur_packet_size;
   GstClockTime cur_ts;
   GstClockTime base_ts;
   GstPcapParseLinktype linktype;
+  gboolean pcapng;
+  gboolean nsec_timestamps;
+  GArray *interfaces;
+
+  /* position of the data in the adapter in the capture */
+  guint64 stream_offset;
+  /* bytes to drop before the next record */
+  guint64 skip;
+
+  /* flow index */
+  guint64 index_length;
+  GArray *index;
+  GArray *flows;
+  GHashTable *flow_ids;
+  guint index_pos;
+  gboolean index_loaded;
+  gboolean index_building;
+  gboolean index_complete;
+  /* hash of the start of the capture */
+  GChecksum *index_checksum;
+  guint64 index_hashed;
+  gchar *index_digest;
 
   gboolean newsegment_sent;
 };
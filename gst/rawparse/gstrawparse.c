@@ -36,6 +36,10 @@
 #include "gstrawparse.h"
 
 static void gst_raw_parse_dispose (GObject * object);
+static void gst_raw_parse_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_raw_parse_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static gboolean gst_raw_parse_sink_activate (GstPad * sinkpad,
     GstObject * parent);
@@ -65,6 +69,14 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS_ANY);
 
+#define DEFAULT_USE_MMAP FALSE
+
+enum
+{
+  PROP_0,
+  PROP_USE_MMAP
+};
+
 GST_DEBUG_CATEGORY_STATIC (gst_raw_parse_debug);
 #define GST_CAT_DEFAULT gst_raw_parse_debug
 
@@ -102,6 +114,24 @@ gst_raw_parse_class_init (GstRawParseClass * klass)
   parent_class = g_type_class_peek_parent (klass);
 
   gobject_class->dispose = gst_raw_parse_dispose;
+  gobject_class->set_property = gst_raw_parse_set_property;
+  gobject_class->get_property = gst_raw_parse_get_property;
+
+  /**
+   * GstRawParse:use-mmap:
+   *
+   * In pull mode, map the file upstream reads from, if it is a local file,
+   * and output frames whose memory points into the mapping instead of
+   * reading every frame into a new buffer.
+   *
+   * The file must not be truncated while it is mapped: accessing a frame
+   * past the new end of the file makes the process crash with SIGBUS.
+   */
+  g_object_class_install_property (gobject_class, PROP_USE_MMAP,
+      g_param_spec_boolean ("use-mmap", "Use mmap",
+          "Output frames from a mapping of the upstream file in pull mode "
+          "(truncating the file while it is mapped crashes the process)",
+          DEFAULT_USE_MMAP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_raw_parse_change_state);
@@ -148,6 +178,7 @@ gst_raw_parse_init (GstRawParse * rp, GstRawParseClass * g_class)
   gst_element_add_pad (GST_ELEMENT (rp), rp->srcpad);
 
   rp->adapter = gst_adapter_new ();
+  rp->use_mmap = DEFAULT_USE_MMAP;
 
   rp->fps_n = 1;
   rp->fps_d = 0;
@@ -169,6 +200,42 @@ gst_raw_parse_dispose (GObject * object)
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gst_raw_parse_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRawParse *rp = GST_RAW_PARSE (object);
+
+  switch (prop_id) {
+    case PROP_USE_MMAP:
+      GST_OBJECT_LOCK (rp);
+      rp->use_mmap = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (rp);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_raw_parse_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstRawParse *rp = GST_RAW_PARSE (object);
+
+  switch (prop_id) {
+    case PROP_USE_MMAP:
+      GST_OBJECT_LOCK (rp);
+      g_value_set_boolean (value, rp->use_mmap);
+      GST_OBJECT_UNLOCK (rp);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 void
 gst_raw_parse_class_set_src_pad_template (GstRawParseClass * klass,
     const GstCaps * allowed_caps)
@@ -199,6 +266,7 @@ gst_raw_parse_reset (GstRawParse * rp)
   rp->n_frames = 0;
   rp->discont = TRUE;
   rp->negotiated = FALSE;
+  rp->align = 0;
 
   gst_segment_init (&rp->segment, GST_FORMAT_TIME);
   gst_adapter_clear (rp->adapter);
@@ -234,6 +302,15 @@ gst_raw_parse_set_src_caps (GstRawParse * rp)
       GST_DEBUG_OBJECT (rp, "peer ALLOCATION query failed");
     }
 
+    /* frames wrapping the mapped file are copied if they don't respect the
+     * alignment requested downstream */
+    if (gst_query_get_n_allocation_params (query) > 0) {
+      GstAllocationParams params;
+
+      gst_query_parse_nth_allocation_param (query, 0, NULL, &params);
+      rp->align = params.align;
+    }
+
     rp_class->decide_allocation (rp, query);
     gst_query_unref (query);
   }
@@ -352,6 +429,83 @@ no_caps:
   }
 }
 
+/* Returns a buffer with @size bytes of the mapped file at @offset. The
+ * memory of the buffer points into the mapping, unless the data doesn't have
+ * the alignment required downstream */
+static GstBuffer *
+gst_raw_parse_wrap_mapped (GstRawParse * rp, gint64 offset, gsize size)
+{
+  guint8 *data = (guint8 *) g_mapped_file_get_contents (rp->mapped_file);
+  gsize length = g_mapped_file_get_length (rp->mapped_file);
+  GstBuffer *buffer;
+
+  if (((guintptr) (data + offset)) & rp->align) {
+    GstAllocationParams params;
+
+    GST_LOG_OBJECT (rp, "copying unaligned data at offset %" G_GINT64_FORMAT,
+        offset);
+
+    gst_allocation_params_init (&params);
+    params.align = rp->align;
+    buffer = gst_buffer_new_allocate (NULL, size, &params);
+    gst_buffer_fill (buffer, 0, data + offset, size);
+  } else {
+    buffer = gst_buffer_new ();
+    gst_buffer_append_memory (buffer,
+        gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, data, length, offset,
+            size, g_mapped_file_ref (rp->mapped_file),
+            (GDestroyNotify) g_mapped_file_unref));
+  }
+
+  return buffer;
+}
+
+/* Maps the upstream file if use-mmap is set and the file can be found from
+ * the URI of upstream */
+static void
+gst_raw_parse_map_upstream (GstRawParse * rp)
+{
+  GstQuery *query;
+  gchar *uri = NULL, *filename = NULL;
+  GError *err = NULL;
+  gboolean use_mmap;
+
+  GST_OBJECT_LOCK (rp);
+  use_mmap = rp->use_mmap;
+  GST_OBJECT_UNLOCK (rp);
+
+  if (!use_mmap)
+    return;
+
+  query = gst_query_new_uri ();
+  if (gst_pad_peer_query (rp->sinkpad, query))
+    gst_query_parse_uri (query, &uri);
+  gst_query_unref (query);
+
+  if (uri && gst_uri_has_protocol (uri, "file"))
+    filename = g_filename_from_uri (uri, NULL, NULL);
+
+  if (filename) {
+    rp->mapped_file = g_mapped_file_new (filename, FALSE, &err);
+    if (rp->mapped_file && g_mapped_file_get_contents (rp->mapped_file)) {
+      GST_DEBUG_OBJECT (rp, "mapped %s, %" G_GSIZE_FORMAT " bytes", filename,
+          g_mapped_file_get_length (rp->mapped_file));
+    } else {
+      GST_DEBUG_OBJECT (rp, "could not map %s: %s", filename,
+          err ? err->message : "empty file");
+      g_clear_error (&err);
+      if (rp->mapped_file)
+        g_mapped_file_unref (rp->mapped_file);
+      rp->mapped_file = NULL;
+    }
+  } else {
+    GST_DEBUG_OBJECT (rp, "upstream is not a local file, not mapping it");
+  }
+
+  g_free (filename);
+  g_free (uri);
+}
+
 static void
 gst_raw_parse_loop (GstElement * element)
 {
@@ -392,6 +546,22 @@ gst_raw_parse_loop (GstElement * element)
     size = rp->framesize;
 
   if (rp->segment.rate >= 0) {
+    /* don't read past the stop position of the segment */
+    if (rp->segment.stop != -1 && rp->fps_n != 0 && rp->fps_d != 0) {
+      gint64 stop;
+
+      if (gst_raw_parse_convert (rp, GST_FORMAT_TIME, rp->segment.stop,
+              GST_FORMAT_BYTES, &stop)) {
+        /* the frame the stop position is in is still output */
+        stop = ((stop + rp->framesize - 1) / rp->framesize) * rp->framesize;
+        if (rp->offset >= stop) {
+          ret = GST_FLOW_EOS;
+          goto pause;
+        }
+        size = MIN (size, stop - rp->offset);
+      }
+    }
+
     if (rp->offset + size > rp->upstream_length) {
       GstFormat fmt = GST_FORMAT_BYTES;
 
@@ -418,7 +588,13 @@ gst_raw_parse_loop (GstElement * element)
   }
 
   buffer = NULL;
-  ret = gst_pad_pull_range (rp->sinkpad, rp->offset, size, &buffer);
+  if (rp->mapped_file &&
+      rp->offset + size <= g_mapped_file_get_length (rp->mapped_file)) {
+    buffer = gst_raw_parse_wrap_mapped (rp, rp->offset, size);
+    ret = GST_FLOW_OK;
+  } else {
+    ret = gst_pad_pull_range (rp->sinkpad, rp->offset, size, &buffer);
+  }
 
   if (ret != GST_FLOW_OK) {
     GST_DEBUG_OBJECT (rp, "pull_range (%" G_GINT64_FORMAT ", %u) "
@@ -545,10 +721,17 @@ gst_raw_parse_sink_activatemode (GstPad * sinkpad, GstObject * parent,
 
         rp->push_stream_start = TRUE;
 
+        gst_raw_parse_map_upstream (rp);
+
         result = gst_raw_parse_handle_seek_pull (rp, NULL);
         rp->mode = mode;
       } else {
         result = gst_pad_stop_task (sinkpad);
+
+        if (rp->mapped_file) {
+          g_mapped_file_unref (rp->mapped_file);
+          rp->mapped_file = NULL;
+        }
       }
       return result;
     case GST_PAD_MODE_PUSH:
@@ -65,6 +65,13 @@ struct _GstRawParse
   gint64 upstream_length;
   gint64 offset;
 
+  /* protected by the object lock */
+  gboolean use_mmap;
+  /* upstream file mapped in pull mode, NULL when frames are pulled */
+  GMappedFile *mapped_file;
+  /* alignment mask of the data pointers required downstream */
+  gsize align;
+
   GstSegment segment;
   GstEvent *start_segment;
 
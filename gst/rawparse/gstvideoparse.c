@@ -23,6 +23,13 @@
  * SECTION:element-videoparse
  *
  * Converts a byte stream into video frames.
+ *
+ * When #GstRawParse:use-mmap is set and a local file is read in pull mode,
+ * the file is mapped and the frames are output without being copied, with a
+ * #GstVideoMeta describing the plane offsets and strides. Frames are only
+ * copied if downstream doesn't support #GstVideoMeta for a non-default
+ * layout, or if the data doesn't have the alignment requested downstream.
+ * The file must not be truncated while it is mapped.
  */
 
 #ifdef HAVE_CONFIG_H
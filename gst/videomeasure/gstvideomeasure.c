@@ -27,10 +27,13 @@
 #include "gstvideomeasure_ssim.h"
 #include "gstvideomeasure_collector.h"
 
+/* Creates the event sent downstream with the measurement of @metric for
+ * frame @framenumber of the stream @stream. @stream, @lowest and @highest
+ * can be NULL. */
 GstEvent *
 gst_event_new_measured (guint64 framenumber, GstClockTime timestamp,
-    const gchar * metric, const GValue * mean, const GValue * lowest,
-    const GValue * highest)
+    const gchar * stream, const gchar * metric, const GValue * mean,
+    const GValue * lowest, const GValue * highest)
 {
   GstStructure *str = gst_structure_new (GST_EVENT_VIDEO_MEASURE,
       "event", G_TYPE_STRING, "frame-measured",
@@ -38,9 +41,13 @@ gst_event_new_measured (guint64 framenumber, GstClockTime timestamp,
       "timestamp", GST_TYPE_CLOCK_TIME, timestamp,
       "metric", G_TYPE_STRING, metric,
       NULL);
+  if (stream)
+    gst_structure_set (str, "stream", G_TYPE_STRING, stream, NULL);
   gst_structure_set_value (str, "mean", mean);
-  gst_structure_set_value (str, "lowest", lowest);
-  gst_structure_set_value (str, "highest", highest);
+  if (lowest)
+    gst_structure_set_value (str, "lowest", lowest);
+  if (highest)
+    gst_structure_set_value (str, "highest", highest);
   return gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM, str);
 }
 
@@ -25,7 +25,7 @@
 #define GST_EVENT_VIDEO_MEASURE "application/x-videomeasure"
 
 GstEvent *gst_event_new_measured (guint64 framenumber, GstClockTime timestamp,
-    const gchar *metric, const GValue *mean, const GValue *lowest,
-    const GValue *highest);
+    const gchar *stream, const gchar *metric, const GValue *mean,
+    const GValue *lowest, const GValue *highest);
 
 #endif /* __GST_VIDEO_MEASURE_H__ */
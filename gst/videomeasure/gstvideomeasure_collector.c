@@ -20,9 +20,33 @@
 /**
  * SECTION:element-measurecollector
  *
- * This plugin collects measurements from measuring elemtns and calculates
- * total measure for the whole sequence and also outputs measurements to a file
- * <classname>&quot;GstMeasureCollector&quot;</classname>.
+ * This element collects the measurements sent downstream by measuring
+ * elements such as ssim, and passes the data through unchanged.
+ *
+ * With the 0x1 bit of #GstMeasureCollector:flags set it writes them to the
+ * file #GstMeasureCollector:filename as comma-separated values, one row per
+ * frame and stream, with the frame number, timestamp and stream followed by
+ * the value of each metric. The rows are written as the frames are measured,
+ * so the measurements of long streams are not kept in memory.
+ *
+ * With the 0x2 bit set it posts an element message named
+ * <classname>&quot;GstMeasureCollector&quot;</classname> for each stream on
+ * EOS, with the name of the stream in the
+ * <classname>&quot;stream&quot;</classname> field and the mean of each
+ * metric over all frames in a #gdouble field named after the metric, such
+ * as <classname>&quot;SSIM&quot;</classname>. The
+ * <classname>&quot;measure-result&quot;</classname> field holds the mean of
+ * the first metric measured.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 ssim name=ssim ! measurecollector flags=3
+ * filename=ssim.csv ! fakesink filesrc location=orig.avi ! decodebin !
+ * ssim.sink_0 filesrc location=compr.avi ! decodebin ! ssim.sink_1
+ * ]| This pipeline writes the SSIM and PSNR of each frame of compr.avi to
+ * ssim.csv and posts their means at the end.
+ * </refsect2>
  */
 
 #ifdef HAVE_CONFIG_H
@@ -33,11 +57,7 @@
 
 #include "gstvideomeasure_collector.h"
 
-#include <stdio.h>
 #include <string.h>
-#include <math.h>
-
-#include <gst/video/video.h>
 
 /* GstMeasureCollector signals and args */
 
@@ -63,93 +83,249 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS_ANY);
 
-//static GstBaseTransformClass *parent_class = NULL;
+/* running sum of a metric of a stream */
+typedef struct
+{
+  gchar *stream;
+  gchar *metric;
+  gdouble sum;
+  guint64 n_frames;
+} GstMeasureTotal;
 
 static void gst_measure_collector_finalize (GObject * object);
 static gboolean gst_measure_collector_event (GstBaseTransform * base,
     GstEvent * event);
-static void gst_measure_collector_save_csv (GstMeasureCollector * mc);
-
-static void gst_measure_collector_post_message (GstMeasureCollector * mc);
+static gboolean gst_measure_collector_start (GstBaseTransform * base);
+static gboolean gst_measure_collector_stop (GstBaseTransform * base);
 
-GST_BOILERPLATE (GstMeasureCollector, gst_measure_collector, GstBaseTransform,
+#define gst_measure_collector_parent_class parent_class
+G_DEFINE_TYPE (GstMeasureCollector, gst_measure_collector,
     GST_TYPE_BASE_TRANSFORM);
 
 static void
+gst_measure_total_free (GstMeasureTotal * total)
+{
+  g_free (total->stream);
+  g_free (total->metric);
+  g_slice_free (GstMeasureTotal, total);
+}
+
+static gboolean
+gst_measure_collector_value_to_double (const GValue * value, gdouble * d)
+{
+  if (G_VALUE_HOLDS_DOUBLE (value))
+    *d = g_value_get_double (value);
+  else if (G_VALUE_HOLDS_FLOAT (value))
+    *d = g_value_get_float (value);
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Formats numbers independently of the locale so that they never contain
+ * the separator */
+static gchar *
+gst_measure_collector_value_to_string (const GValue * value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  GValue tmp = G_VALUE_INIT;
+  gchar *str = NULL;
+  gdouble d;
+
+  if (gst_measure_collector_value_to_double (value, &d))
+    return g_strdup (g_ascii_formatd (buf, sizeof (buf), "%.6f", d));
+
+  g_value_init (&tmp, G_TYPE_STRING);
+  if (g_value_transform (value, &tmp))
+    str = g_value_dup_string (&tmp);
+  g_value_unset (&tmp);
+
+  return str ? str : g_strdup ("<untranslatable>");
+}
+
+static void
+gst_measure_collector_write_row (GstMeasureCollector * mc,
+    const GstStructure * row)
+{
+  guint i;
+
+  if (mc->file == NULL)
+    return;
+
+  if (mc->columns == NULL) {
+    mc->columns = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; i < gst_structure_n_fields (row); i++) {
+      const gchar *name = gst_structure_nth_field_name (row, i);
+
+      g_ptr_array_add (mc->columns, g_strdup (name));
+      fprintf (mc->file, "%s%s", i > 0 ? "," : "", name);
+    }
+    fprintf (mc->file, "\n");
+  }
+
+  for (i = 0; i < mc->columns->len; i++) {
+    const GValue *value = gst_structure_get_value (row,
+        g_ptr_array_index (mc->columns, i));
+
+    if (i > 0)
+      fprintf (mc->file, ",");
+    if (value) {
+      gchar *str = gst_measure_collector_value_to_string (value);
+
+      fprintf (mc->file, "%s", str);
+      g_free (str);
+    }
+  }
+  fprintf (mc->file, "\n");
+}
+
+static void
+gst_measure_collector_add_total (GstMeasureCollector * mc,
+    const gchar * stream, const gchar * metric, gdouble value)
+{
+  GstMeasureTotal *total = NULL;
+  guint i;
+
+  for (i = 0; i < mc->totals->len; i++) {
+    GstMeasureTotal *t = g_ptr_array_index (mc->totals, i);
+
+    if (strcmp (t->stream, stream) == 0 && strcmp (t->metric, metric) == 0) {
+      total = t;
+      break;
+    }
+  }
+
+  if (total == NULL) {
+    total = g_slice_new0 (GstMeasureTotal);
+    total->stream = g_strdup (stream);
+    total->metric = g_strdup (metric);
+    g_ptr_array_add (mc->totals, total);
+  }
+
+  total->sum += value;
+  total->n_frames++;
+}
+
+/* Adds the measurement of @metric in @str to the row of its stream, after
+ * writing the previous row of the stream when it was another frame */
+static void
 gst_measure_collector_collect (GstMeasureCollector * mc, GstEvent * gstevent)
 {
   const GstStructure *str;
-  const gchar *event, *metric;
-  guint64 framenumber = G_MAXUINT64;
-  const GValue *framenumber_v;
+  const gchar *event, *metric, *stream;
+  const GValue *mean, *lowest, *highest;
+  GstClockTime timestamp = GST_CLOCK_TIME_NONE;
+  GstStructure *row = NULL;
+  guint64 framenumber;
+  gdouble value;
+  gchar *name;
+  guint i;
 
   str = gst_event_get_structure (gstevent);
 
   event = gst_structure_get_string (str, "event");
   metric = gst_structure_get_string (str, "metric");
+  mean = gst_structure_get_value (str, "mean");
 
-  if (strcmp (event, "frame-measured") == 0 && metric != NULL) {
-    GstStructure *cpy;
-    cpy = gst_structure_copy (str);
+  if (g_strcmp0 (event, "frame-measured") != 0 || metric == NULL
+      || mean == NULL)
+    return;
 
-    framenumber_v = gst_structure_get_value (str, "offset");
-    if (framenumber_v) {
-      if (G_VALUE_TYPE (framenumber_v) == G_TYPE_UINT64)
-        framenumber = g_value_get_uint64 (framenumber_v);
-      else if (G_VALUE_TYPE (framenumber_v) == G_TYPE_INT64)
-        framenumber = g_value_get_int64 (framenumber_v);
-    }
+  stream = gst_structure_get_string (str, "stream");
+  if (stream == NULL)
+    stream = "";
+  if (!gst_structure_get_uint64 (str, "offset", &framenumber)) {
+    gint64 offset;
 
-    if (framenumber == G_MAXUINT64)
-      framenumber = mc->nextoffset++;
+    if (!gst_structure_get_int64 (str, "offset", &offset))
+      return;
+    framenumber = offset;
+  }
+  gst_structure_get_clock_time (str, "timestamp", &timestamp);
 
-    if (mc->measurements->len <= framenumber)
-      g_ptr_array_set_size (mc->measurements, framenumber + 1);
-    g_ptr_array_index (mc->measurements, framenumber) = cpy;
+  for (i = 0; i < mc->rows->len; i++) {
+    GstStructure *r = g_ptr_array_index (mc->rows, i);
 
-    mc->nextoffset = framenumber + 1;
+    if (strcmp (gst_structure_get_string (r, "stream"), stream) == 0) {
+      guint64 row_offset;
 
-    if (!mc->metric)
-      mc->metric = g_strdup (metric);
+      gst_structure_get_uint64 (r, "offset", &row_offset);
+      if (row_offset == framenumber) {
+        row = r;
+      } else {
+        gst_measure_collector_write_row (mc, r);
+        g_ptr_array_remove_index (mc->rows, i);
+      }
+      break;
+    }
+  }
+
+  if (row == NULL) {
+    row = gst_structure_new ("measurement",
+        "offset", G_TYPE_UINT64, framenumber,
+        "timestamp", G_TYPE_UINT64, timestamp,
+        "stream", G_TYPE_STRING, stream, NULL);
+    g_ptr_array_add (mc->rows, row);
   }
+
+  gst_structure_set_value (row, metric, mean);
+  lowest = gst_structure_get_value (str, "lowest");
+  if (lowest) {
+    name = g_strconcat (metric, "-lowest", NULL);
+    gst_structure_set_value (row, name, lowest);
+    g_free (name);
+  }
+  highest = gst_structure_get_value (str, "highest");
+  if (highest) {
+    name = g_strconcat (metric, "-highest", NULL);
+    gst_structure_set_value (row, name, highest);
+    g_free (name);
+  }
+
+  if (gst_measure_collector_value_to_double (mean, &value))
+    gst_measure_collector_add_total (mc, stream, metric, value);
 }
 
 static void
-gst_measure_collector_post_message (GstMeasureCollector * mc)
+gst_measure_collector_post_messages (GstMeasureCollector * mc)
 {
-  GstMessage *m;
-  guint64 i;
-
-  g_return_if_fail (mc->metric);
-
-  if (strcmp (mc->metric, "SSIM") == 0) {
-    gfloat dresult = 0;
-    guint64 mlen;
-    g_free (mc->result);
-    mc->result = g_new0 (GValue, 1);
-    g_value_init (mc->result, G_TYPE_FLOAT);
-    mlen = mc->measurements->len;
-    for (i = 0; i < mc->measurements->len; i++) {
-      const GValue *v;
-      GstStructure *str =
-          (GstStructure *) g_ptr_array_index (mc->measurements, i);
-      if (str) {
-        v = gst_structure_get_value (str, "mean");
-        dresult += g_value_get_float (v);
-      } else {
-        GST_WARNING_OBJECT (mc,
-            "No measurement info for frame %" G_GUINT64_FORMAT, i);
-        mlen--;
+  GPtrArray *structures;
+  guint i, j;
+
+  structures = g_ptr_array_new ();
+
+  /* one structure per stream, in the order they were first measured */
+  for (i = 0; i < mc->totals->len; i++) {
+    GstMeasureTotal *total = g_ptr_array_index (mc->totals, i);
+    gdouble mean = total->sum / total->n_frames;
+    GstStructure *s = NULL;
+
+    for (j = 0; j < structures->len; j++) {
+      GstStructure *tmp = g_ptr_array_index (structures, j);
+
+      if (strcmp (gst_structure_get_string (tmp, "stream"),
+              total->stream) == 0) {
+        s = tmp;
+        break;
       }
     }
-    g_value_set_float (mc->result, dresult / mlen);
+
+    if (s == NULL) {
+      s = gst_structure_new ("GstMeasureCollector",
+          "stream", G_TYPE_STRING, total->stream,
+          "measure-result", G_TYPE_DOUBLE, mean, NULL);
+      g_ptr_array_add (structures, s);
+    }
+    gst_structure_set (s, total->metric, G_TYPE_DOUBLE, mean, NULL);
   }
 
-  m = gst_message_new_element (GST_OBJECT_CAST (mc),
-      gst_structure_new ("GstMeasureCollector",
-          "measure-result", G_TYPE_VALUE, mc->result, NULL));
+  for (i = 0; i < structures->len; i++)
+    gst_element_post_message (GST_ELEMENT_CAST (mc),
+        gst_message_new_element (GST_OBJECT_CAST (mc),
+            g_ptr_array_index (structures, i)));
 
-  gst_element_post_message (GST_ELEMENT_CAST (mc), m);
+  g_ptr_array_free (structures, TRUE);
 }
 
 static void
@@ -165,6 +341,7 @@ gst_measure_collector_set_property (GObject * object, guint prop_id,
       measurecollector->flags = g_value_get_uint64 (value);
       break;
     case PROP_FILENAME:
+      g_free (measurecollector->filename);
       measurecollector->filename = g_value_dup_string (value);
       break;
     default:
@@ -198,6 +375,7 @@ static gboolean
 gst_measure_collector_event (GstBaseTransform * base, GstEvent * event)
 {
   GstMeasureCollector *mc = GST_MEASURE_COLLECTOR (base);
+  guint i;
 
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_CUSTOM_DOWNSTREAM:
@@ -205,134 +383,107 @@ gst_measure_collector_event (GstBaseTransform * base, GstEvent * event)
         gst_measure_collector_collect (mc, event);
       break;
     case GST_EVENT_EOS:
-      gst_measure_collector_post_message (mc);
-      gst_measure_collector_save_csv (mc);
+      for (i = 0; i < mc->rows->len; i++)
+        gst_measure_collector_write_row (mc, g_ptr_array_index (mc->rows, i));
+      g_ptr_array_set_size (mc->rows, 0);
+      if (mc->file)
+        fflush (mc->file);
+
+      if (mc->flags & GST_MEASURE_COLLECTOR_EMIT_MESSAGE)
+        gst_measure_collector_post_messages (mc);
       break;
     default:
       break;
   }
 
-  return parent_class->event (base, event);
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (base, event);
 }
 
-static void
-gst_measure_collector_save_csv (GstMeasureCollector * mc)
+static gboolean
+gst_measure_collector_start (GstBaseTransform * base)
 {
+  GstMeasureCollector *mc = GST_MEASURE_COLLECTOR (base);
   gchar *name_local;
-  FILE *file;
-  guint64 i, j;
-  GstStructure *str;
-  GValue tmp = { 0 };
-  g_value_init (&tmp, G_TYPE_STRING);
 
   if (!(mc->flags & GST_MEASURE_COLLECTOR_WRITE_CSV))
-    return;
+    return TRUE;
 
-  if (mc->measurements->len <= 0)
-    goto empty;
-
-  /* open the file */
   if (mc->filename == NULL || mc->filename[0] == '\0')
     goto no_filename;
 
   name_local = g_filename_from_utf8 ((const gchar *) mc->filename,
       -1, NULL, NULL, NULL);
 
-  /* open the file */
-  if (name_local == NULL || name_local[0] == '\0')
+  if (name_local == NULL || name_local[0] == '\0') {
+    g_free (name_local);
     goto not_good_filename;
-
+  }
 
   /* FIXME, can we use g_fopen here? some people say that the FILE object is
    * local to the .so that performed the fopen call, which would not be us when
    * we use g_fopen. */
-  file = fopen (name_local, "wb");
+  mc->file = fopen (name_local, "wb");
 
   g_free (name_local);
 
-  if (file == NULL)
+  if (mc->file == NULL)
     goto open_failed;
 
-  str = (GstStructure *) g_ptr_array_index (mc->measurements, 0);
-
-  for (j = 0; j < gst_structure_n_fields (str); j++) {
-    const gchar *fieldname;
-    fieldname = gst_structure_nth_field_name (str, j);
-    if (G_LIKELY (j > 0))
-      fprintf (file, ";");
-    fprintf (file, "%s", fieldname);
-  }
-
-  for (i = 0; i < mc->measurements->len; i++) {
-    fprintf (file, "\n");
-    str = (GstStructure *) g_ptr_array_index (mc->measurements, i);
-    if (str != NULL) {
-      for (j = 0; j < gst_structure_n_fields (str); j++) {
-        const gchar *fieldname;
-        fieldname = gst_structure_nth_field_name (str, j);
-        if (G_LIKELY (j > 0))
-          fprintf (file, ";");
-        if (G_LIKELY (g_value_transform (gst_structure_get_value (str,
-                        fieldname), &tmp)))
-          fprintf (file, "%s", g_value_get_string (&tmp));
-        else
-          fprintf (file, "<untranslatable>");
-      }
-    }
-  }
-
-  fclose (file);
+  return TRUE;
 
   /* ERRORS */
-empty:
-  {
-    return;
-  }
 no_filename:
   {
     GST_ELEMENT_ERROR (mc, RESOURCE, NOT_FOUND,
         (_("No file name specified for writing.")), (NULL));
-    return;
+    return FALSE;
   }
 not_good_filename:
   {
     GST_ELEMENT_ERROR (mc, RESOURCE, NOT_FOUND,
         (_("Given file name \"%s\" can't be converted to local file name \
 encoding."), mc->filename), (NULL));
-    return;
+    return FALSE;
   }
 open_failed:
   {
     GST_ELEMENT_ERROR (mc, RESOURCE, OPEN_WRITE,
         (_("Could not open file \"%s\" for writing."), mc->filename),
         GST_ERROR_SYSTEM);
-    return;
+    return FALSE;
   }
 }
 
-static void
-gst_measure_collector_base_init (gpointer g_class)
+static gboolean
+gst_measure_collector_stop (GstBaseTransform * base)
 {
-  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+  GstMeasureCollector *mc = GST_MEASURE_COLLECTOR (base);
 
-  gst_element_class_set_static_metadata (element_class,
-      "Video measure collector", "Filter/Effect/Video",
-      "Collect measurements from a measuring element",
-      "Руслан Ижбулатов <lrn _at_ gmail _dot_ com>");
+  if (mc->file) {
+    fclose (mc->file);
+    mc->file = NULL;
+  }
 
-  gst_element_class_add_pad_template (element_class,
-      gst_static_pad_template_get (&gst_measure_collector_sink_template));
-  gst_element_class_add_pad_template (element_class,
-      gst_static_pad_template_get (&gst_measure_collector_src_template));
+  if (mc->columns) {
+    g_ptr_array_free (mc->columns, TRUE);
+    mc->columns = NULL;
+  }
+
+  g_ptr_array_set_size (mc->rows, 0);
+  g_ptr_array_set_size (mc->totals, 0);
+
+  return TRUE;
 }
 
 static void
 gst_measure_collector_class_init (GstMeasureCollectorClass * klass)
 {
   GObjectClass *gobject_class;
+  GstElementClass *element_class;
   GstBaseTransformClass *trans_class;
 
   gobject_class = G_OBJECT_CLASS (klass);
+  element_class = GST_ELEMENT_CLASS (klass);
   trans_class = GST_BASE_TRANSFORM_CLASS (klass);
 
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "measurecollect", 0,
@@ -344,7 +495,8 @@ gst_measure_collector_class_init (GstMeasureCollectorClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_FLAGS,
       g_param_spec_uint64 ("flags", "Flags",
-          "Flags that control the operation of the element",
+          "Flags that control the operation of the element "
+          "(0x1 = write CSV, 0x2 = post message)",
           0, G_MAXUINT64, 0,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
@@ -354,54 +506,53 @@ gst_measure_collector_class_init (GstMeasureCollectorClass * klass)
           " information", "",
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
-  trans_class->event = GST_DEBUG_FUNCPTR (gst_measure_collector_event);
+  gst_element_class_set_static_metadata (element_class,
+      "Video measure collector", "Filter/Effect/Video",
+      "Collect measurements from a measuring element",
+      "Руслан Ижбулатов <lrn _at_ gmail _dot_ com>");
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_measure_collector_sink_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_measure_collector_src_template));
 
-  trans_class->passthrough_on_same_caps = TRUE;
+  trans_class->sink_event = GST_DEBUG_FUNCPTR (gst_measure_collector_event);
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_measure_collector_start);
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_measure_collector_stop);
 
+  trans_class->passthrough_on_same_caps = TRUE;
 }
 
 static void
-gst_measure_collector_init (GstMeasureCollector * instance,
-    GstMeasureCollectorClass * g_class)
+gst_measure_collector_init (GstMeasureCollector * measurecollector)
 {
-  GstMeasureCollector *measurecollector;
-
-  measurecollector = GST_MEASURE_COLLECTOR (instance);
-
   GST_DEBUG_OBJECT (measurecollector, "gst_measure_collector_init");
 
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (measurecollector),
+      TRUE);
   gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (measurecollector),
       FALSE);
 
-  measurecollector->measurements = g_ptr_array_new ();
-  measurecollector->metric = NULL;
-  measurecollector->inited = TRUE;
+  measurecollector->rows =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  measurecollector->totals =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_measure_total_free);
+  measurecollector->columns = NULL;
+  measurecollector->file = NULL;
   measurecollector->filename = NULL;
   measurecollector->flags = 0;
-  measurecollector->nextoffset = 0;
-  measurecollector->result = NULL;
 }
 
 static void
 gst_measure_collector_finalize (GObject * object)
 {
-  gint i;
   GstMeasureCollector *mc = GST_MEASURE_COLLECTOR (object);
 
-  for (i = 0; i < mc->measurements->len; i++) {
-    if (g_ptr_array_index (mc->measurements, i) != NULL)
-      gst_structure_free ((GstStructure *) g_ptr_array_index (mc->measurements,
-              i));
-  }
-
-  g_ptr_array_free (mc->measurements, TRUE);
-  mc->measurements = NULL;
-
-  g_free (mc->result);
-  mc->result = NULL;
+  g_ptr_array_free (mc->rows, TRUE);
+  mc->rows = NULL;
 
-  g_free (mc->metric);
-  mc->metric = NULL;
+  g_ptr_array_free (mc->totals, TRUE);
+  mc->totals = NULL;
 
   g_free (mc->filename);
   mc->filename = NULL;
@@ -23,6 +23,8 @@
 #include "gstvideomeasure.h"
 #include <gst/base/gstbasetransform.h>
 
+#include <stdio.h>
+
 G_BEGIN_DECLS
 
 typedef struct _GstMeasureCollector GstMeasureCollector;
@@ -52,21 +54,22 @@ typedef enum {
 
 struct _GstMeasureCollector {
   GstBaseTransform element;
-  
+
   guint64 flags;
 
   gchar *filename;
 
-  /* Array of pointers to GstStructure */
-  GPtrArray *measurements;
+  /* file the rows are written to, open from start to stop */
+  FILE *file;
 
-  GValue *result;
+  /* column names, taken from the first row written */
+  GPtrArray *columns;
 
-  guint64 nextoffset;
-  
-  gchar *metric;
+  /* GstStructure of the frame being measured, one per stream */
+  GPtrArray *rows;
 
-  gboolean inited;
+  /* running sums of each metric of each stream */
+  GPtrArray *totals;
 };
 
 struct _GstMeasureCollectorClass {
@@ -0,0 +1,447 @@
+/* GStreamer
+ * Copyright (C) <2009> Руслан Ижбулатов <lrn1986 _at_ gmail _dot_ com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Quality metrics of 8 bit planes.
+ *
+ * SSIM is computed on 8x8 windows every 4 pixels, like libvpx and x264 do.
+ * The sums of the pixels, of their squares and of their products are first
+ * computed once per 4x4 block, and each window adds up the sums of its 2x2
+ * blocks. The window terms only need products of sums up to 64 * 255, which
+ * are computed exactly in 32 bits, and only the final divisions are done in
+ * single precision. The luminance and contrast-structure terms are kept
+ * apart for MS-SSIM.
+ *
+ * The window rows and pixel rows of a plane can be split in bands which are
+ * measured independently and whose sums are added afterwards. */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include "gstvideomeasure_metrics.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define METRICS_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* (0.01 * 255)^2 and (0.03 * 255)^2 scaled by the 64 * 64 of sums of 64
+ * pixels, the same as libvpx */
+#define SSIM_C1 26634
+#define SSIM_C2 239708
+
+/* block sums of a row of 4x4 blocks, one array per sum */
+typedef struct
+{
+  gint32 *s1;                   /* sum of the reference pixels */
+  gint32 *s2;                   /* sum of the distorted pixels */
+  gint32 *ss;                   /* sum of the squares of both */
+  gint32 *s12;                  /* sum of the products */
+} BlockRow;
+
+void
+gst_video_measure_sums_init (GstVideoMeasureSums * sums)
+{
+  memset (sums, 0, sizeof (GstVideoMeasureSums));
+  sums->ssim_lowest = G_MAXFLOAT;
+  sums->ssim_highest = -G_MAXFLOAT;
+}
+
+void
+gst_video_measure_sums_add (GstVideoMeasureSums * sums,
+    const GstVideoMeasureSums * other)
+{
+  sums->ssim += other->ssim;
+  sums->cs += other->cs;
+  sums->ssim_lowest = MIN (sums->ssim_lowest, other->ssim_lowest);
+  sums->ssim_highest = MAX (sums->ssim_highest, other->ssim_highest);
+  sums->n_windows += other->n_windows;
+  sums->sse += other->sse;
+  sums->n_pixels += other->n_pixels;
+}
+
+/* Number of rows of 8x8 windows of a plane @height pixels high */
+gint
+gst_video_measure_n_window_rows (gint height)
+{
+  return MAX (height / 4 - 1, 0);
+}
+
+/* Size in bytes of the scratch memory gst_video_measure_ssim_rows() needs
+ * for planes @width pixels wide */
+gsize
+gst_video_measure_scratch_size (gint width)
+{
+  return 2 * 4 * (width / 4) * sizeof (gint32);
+}
+
+static void
+block_row_init (BlockRow * row, gint32 * mem, gint n_blocks)
+{
+  row->s1 = mem;
+  row->s2 = mem + n_blocks;
+  row->ss = mem + 2 * n_blocks;
+  row->s12 = mem + 3 * n_blocks;
+}
+
+static void
+block_sums_scalar (const guint8 * ref, gint ref_stride, const guint8 * dist,
+    gint dist_stride, gint b, gint n_blocks, BlockRow * row)
+{
+  for (; b < n_blocks; b++) {
+    gint32 s1 = 0, s2 = 0, ss = 0, s12 = 0;
+    gint x, y;
+
+    for (y = 0; y < 4; y++) {
+      const guint8 *a = ref + y * ref_stride + 4 * b;
+      const guint8 *d = dist + y * dist_stride + 4 * b;
+
+      for (x = 0; x < 4; x++) {
+        s1 += a[x];
+        s2 += d[x];
+        ss += a[x] * a[x] + d[x] * d[x];
+        s12 += a[x] * d[x];
+      }
+    }
+
+    row->s1[b] = s1;
+    row->s2[b] = s2;
+    row->ss[b] = ss;
+    row->s12[b] = s12;
+  }
+}
+
+#ifdef METRICS_USE_SSE2
+/* Adds the pairs of lanes of @lo and @hi, which hold the sums of 2 pixel
+ * pairs of blocks 0-1 and 2-3, into the sums of the 4 blocks */
+static inline __m128i
+block_reduce (__m128i lo, __m128i hi)
+{
+  lo = _mm_shuffle_epi32 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+  hi = _mm_shuffle_epi32 (hi, _MM_SHUFFLE (3, 1, 2, 0));
+
+  return _mm_add_epi32 (_mm_unpacklo_epi64 (lo, hi),
+      _mm_unpackhi_epi64 (lo, hi));
+}
+
+/* 4 blocks of 16 pixels at a time, returns the first block left */
+static gint
+block_sums_sse2 (const guint8 * ref, gint ref_stride, const guint8 * dist,
+    gint dist_stride, gint n_blocks, BlockRow * row)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one = _mm_set1_epi16 (1);
+  gint b;
+
+  for (b = 0; b + 4 <= n_blocks; b += 4) {
+    __m128i sa_lo = zero, sa_hi = zero, sd_lo = zero, sd_hi = zero;
+    __m128i ss_lo = zero, ss_hi = zero, s12_lo = zero, s12_hi = zero;
+    gint y;
+
+    for (y = 0; y < 4; y++) {
+      const __m128i a = _mm_loadu_si128 ((const __m128i *) (ref +
+              y * ref_stride + 4 * b));
+      const __m128i d = _mm_loadu_si128 ((const __m128i *) (dist +
+              y * dist_stride + 4 * b));
+      const __m128i a_lo = _mm_unpacklo_epi8 (a, zero);
+      const __m128i a_hi = _mm_unpackhi_epi8 (a, zero);
+      const __m128i d_lo = _mm_unpacklo_epi8 (d, zero);
+      const __m128i d_hi = _mm_unpackhi_epi8 (d, zero);
+
+      sa_lo = _mm_add_epi16 (sa_lo, a_lo);
+      sa_hi = _mm_add_epi16 (sa_hi, a_hi);
+      sd_lo = _mm_add_epi16 (sd_lo, d_lo);
+      sd_hi = _mm_add_epi16 (sd_hi, d_hi);
+      ss_lo = _mm_add_epi32 (ss_lo, _mm_add_epi32 (_mm_madd_epi16 (a_lo,
+                  a_lo), _mm_madd_epi16 (d_lo, d_lo)));
+      ss_hi = _mm_add_epi32 (ss_hi, _mm_add_epi32 (_mm_madd_epi16 (a_hi,
+                  a_hi), _mm_madd_epi16 (d_hi, d_hi)));
+      s12_lo = _mm_add_epi32 (s12_lo, _mm_madd_epi16 (a_lo, d_lo));
+      s12_hi = _mm_add_epi32 (s12_hi, _mm_madd_epi16 (a_hi, d_hi));
+    }
+
+    _mm_storeu_si128 ((__m128i *) (row->s1 + b),
+        block_reduce (_mm_madd_epi16 (sa_lo, one), _mm_madd_epi16 (sa_hi,
+                one)));
+    _mm_storeu_si128 ((__m128i *) (row->s2 + b),
+        block_reduce (_mm_madd_epi16 (sd_lo, one), _mm_madd_epi16 (sd_hi,
+                one)));
+    _mm_storeu_si128 ((__m128i *) (row->ss + b), block_reduce (ss_lo, ss_hi));
+    _mm_storeu_si128 ((__m128i *) (row->s12 + b), block_reduce (s12_lo,
+            s12_hi));
+  }
+
+  return b;
+}
+#endif
+
+/* Sums of the row of 4x4 blocks starting at the pixel rows @ref and @dist */
+static void
+block_sums (const guint8 * ref, gint ref_stride, const guint8 * dist,
+    gint dist_stride, gint n_blocks, BlockRow * row)
+{
+  gint b = 0;
+
+#ifdef METRICS_USE_SSE2
+  b = block_sums_sse2 (ref, ref_stride, dist, dist_stride, n_blocks, row);
+#endif
+
+  block_sums_scalar (ref, ref_stride, dist, dist_stride, b, n_blocks, row);
+}
+
+static void
+windows_scalar (const BlockRow * r0, const BlockRow * r1, gint x,
+    gint n_windows, GstVideoMeasureSums * sums)
+{
+  for (; x < n_windows; x++) {
+    const gint32 s1 = r0->s1[x] + r0->s1[x + 1] + r1->s1[x] + r1->s1[x + 1];
+    const gint32 s2 = r0->s2[x] + r0->s2[x + 1] + r1->s2[x] + r1->s2[x + 1];
+    const gint32 ss = r0->ss[x] + r0->ss[x + 1] + r1->ss[x] + r1->ss[x + 1];
+    const gint32 s12 =
+        r0->s12[x] + r0->s12[x + 1] + r1->s12[x] + r1->s12[x + 1];
+    const gint32 s1s2 = 2 * s1 * s2;
+    const gint32 sq = s1 * s1 + s2 * s2;
+    const gfloat l = (gfloat) (s1s2 + SSIM_C1) / (gfloat) (sq + SSIM_C1);
+    const gfloat cs = (gfloat) (128 * s12 - s1s2 + SSIM_C2) /
+        (gfloat) (64 * ss - sq + SSIM_C2);
+    const gfloat ssim = l * cs;
+
+    sums->ssim += ssim;
+    sums->cs += cs;
+    sums->ssim_lowest = MIN (sums->ssim_lowest, ssim);
+    sums->ssim_highest = MAX (sums->ssim_highest, ssim);
+  }
+}
+
+#ifdef METRICS_USE_SSE2
+static inline __m128i
+window_sum (const gint32 * r0, const gint32 * r1, gint x)
+{
+  return _mm_add_epi32 (_mm_add_epi32 (_mm_loadu_si128 ((const __m128i *)
+              (r0 + x)), _mm_loadu_si128 ((const __m128i *) (r0 + x + 1))),
+      _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) (r1 + x)),
+          _mm_loadu_si128 ((const __m128i *) (r1 + x + 1))));
+}
+
+/* 4 windows at a time. The sums of pixels fit in 16 bits, so s1 and s2 are
+ * packed in the 16 bit halves of each lane and madd computes s1^2 + s2^2 and
+ * 2 * s1 * s2 exactly. Returns the first window left. */
+static gint
+windows_sse2 (const BlockRow * r0, const BlockRow * r1, gint n_windows,
+    GstVideoMeasureSums * sums)
+{
+  const __m128i c1 = _mm_set1_epi32 (SSIM_C1);
+  const __m128i c2 = _mm_set1_epi32 (SSIM_C2);
+  __m128 lowest = _mm_set1_ps (sums->ssim_lowest);
+  __m128 highest = _mm_set1_ps (sums->ssim_highest);
+  __m128d ssim_acc = _mm_setzero_pd ();
+  __m128d cs_acc = _mm_setzero_pd ();
+  gdouble res[2];
+  gfloat lh[4];
+  gint x;
+
+  /* the windows x to x + 3 read the blocks up to x + 4 */
+  for (x = 0; x + 4 <= n_windows; x += 4) {
+    const __m128i s1 = window_sum (r0->s1, r1->s1, x);
+    const __m128i s2 = window_sum (r0->s2, r1->s2, x);
+    const __m128i ss = window_sum (r0->ss, r1->ss, x);
+    const __m128i s12 = window_sum (r0->s12, r1->s12, x);
+    const __m128i p = _mm_or_si128 (s1, _mm_slli_epi32 (s2, 16));
+    const __m128i q = _mm_or_si128 (s2, _mm_slli_epi32 (s1, 16));
+    const __m128i s1s2 = _mm_madd_epi16 (p, q);
+    const __m128i sq = _mm_madd_epi16 (p, p);
+    __m128 l, cs, ssim;
+
+    l = _mm_div_ps (_mm_cvtepi32_ps (_mm_add_epi32 (s1s2, c1)),
+        _mm_cvtepi32_ps (_mm_add_epi32 (sq, c1)));
+    cs = _mm_div_ps (_mm_cvtepi32_ps (_mm_add_epi32 (_mm_sub_epi32
+                (_mm_slli_epi32 (s12, 7), s1s2), c2)),
+        _mm_cvtepi32_ps (_mm_add_epi32 (_mm_sub_epi32 (_mm_slli_epi32 (ss, 6),
+                    sq), c2)));
+    ssim = _mm_mul_ps (l, cs);
+
+    lowest = _mm_min_ps (lowest, ssim);
+    highest = _mm_max_ps (highest, ssim);
+    ssim_acc = _mm_add_pd (ssim_acc, _mm_add_pd (_mm_cvtps_pd (ssim),
+            _mm_cvtps_pd (_mm_movehl_ps (ssim, ssim))));
+    cs_acc = _mm_add_pd (cs_acc, _mm_add_pd (_mm_cvtps_pd (cs),
+            _mm_cvtps_pd (_mm_movehl_ps (cs, cs))));
+  }
+
+  _mm_storeu_pd (res, ssim_acc);
+  sums->ssim += res[0] + res[1];
+  _mm_storeu_pd (res, cs_acc);
+  sums->cs += res[0] + res[1];
+
+  _mm_storeu_ps (lh, lowest);
+  sums->ssim_lowest = MIN (MIN (lh[0], lh[1]), MIN (lh[2], lh[3]));
+  _mm_storeu_ps (lh, highest);
+  sums->ssim_highest = MAX (MAX (lh[0], lh[1]), MAX (lh[2], lh[3]));
+
+  return x;
+}
+#endif
+
+/* Adds the SSIM of the window rows @start to @end of the planes @ref and
+ * @dist @width pixels wide to @sums. Window row j covers the pixel rows
+ * 4 * j to 4 * j + 7. @scratch holds gst_video_measure_scratch_size() bytes
+ * and is not shared between concurrent calls. */
+void
+gst_video_measure_ssim_rows (const guint8 * ref, gint ref_stride,
+    const guint8 * dist, gint dist_stride, gint width, gint start, gint end,
+    gint32 * scratch, GstVideoMeasureSums * sums)
+{
+  const gint n_blocks = width / 4;
+  const gint n_windows = n_blocks - 1;
+  BlockRow rows[2], *r0 = &rows[0], *r1 = &rows[1], *tmp;
+  gint j;
+
+  if (n_windows <= 0 || start >= end)
+    return;
+
+  block_row_init (&rows[0], scratch, n_blocks);
+  block_row_init (&rows[1], scratch + 4 * n_blocks, n_blocks);
+
+  block_sums (ref + 4 * start * ref_stride, ref_stride,
+      dist + 4 * start * dist_stride, dist_stride, n_blocks, r0);
+
+  for (j = start; j < end; j++) {
+    gint x = 0;
+
+    block_sums (ref + 4 * (j + 1) * ref_stride, ref_stride,
+        dist + 4 * (j + 1) * dist_stride, dist_stride, n_blocks, r1);
+
+#ifdef METRICS_USE_SSE2
+    x = windows_sse2 (r0, r1, n_windows, sums);
+#endif
+    windows_scalar (r0, r1, x, n_windows, sums);
+
+    tmp = r0;
+    r0 = r1;
+    r1 = tmp;
+  }
+
+  sums->n_windows += (guint64) n_windows * (end - start);
+}
+
+#ifdef METRICS_USE_SSE2
+/* each lane adds up to 4 * 255^2 per 16 pixels, so its 32 bits would wrap
+ * after about 264000 pixels; the lanes are flushed well before that */
+#define SSE_ROW_FLUSH_PIXELS 65536
+
+static gint
+sse_row_sse2 (const guint8 * ref, const guint8 * dist, gint width,
+    guint64 * sse)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const gint vector_width = width & ~15;
+  gint32 lanes[4];
+  gint x = 0;
+
+  while (x < vector_width) {
+    const gint end = MIN (vector_width, x + SSE_ROW_FLUSH_PIXELS);
+    __m128i acc = zero;
+
+    for (; x < end; x += 16) {
+      const __m128i a = _mm_loadu_si128 ((const __m128i *) (ref + x));
+      const __m128i d = _mm_loadu_si128 ((const __m128i *) (dist + x));
+      const __m128i lo = _mm_sub_epi16 (_mm_unpacklo_epi8 (a, zero),
+          _mm_unpacklo_epi8 (d, zero));
+      const __m128i hi = _mm_sub_epi16 (_mm_unpackhi_epi8 (a, zero),
+          _mm_unpackhi_epi8 (d, zero));
+
+      acc = _mm_add_epi32 (acc, _mm_add_epi32 (_mm_madd_epi16 (lo, lo),
+              _mm_madd_epi16 (hi, hi)));
+    }
+
+    _mm_storeu_si128 ((__m128i *) lanes, acc);
+    *sse += (guint64) (guint32) lanes[0] + (guint32) lanes[1] +
+        (guint32) lanes[2] + (guint32) lanes[3];
+  }
+
+  return x;
+}
+#endif
+
+/* Adds the sum of squared differences of the pixel rows @start to @end of
+ * the planes @ref and @dist @width pixels wide to @sums */
+void
+gst_video_measure_sse_rows (const guint8 * ref, gint ref_stride,
+    const guint8 * dist, gint dist_stride, gint width, gint start, gint end,
+    GstVideoMeasureSums * sums)
+{
+  gint y;
+
+  for (y = start; y < end; y++) {
+    const guint8 *a = ref + y * ref_stride;
+    const guint8 *d = dist + y * dist_stride;
+    guint64 sse = 0;
+    gint x = 0;
+
+#ifdef METRICS_USE_SSE2
+    x = sse_row_sse2 (a, d, width, &sse);
+#endif
+    for (; x < width; x++) {
+      const gint diff = a[x] - d[x];
+
+      sse += diff * diff;
+    }
+    sums->sse += sse;
+  }
+
+  if (end > start)
+    sums->n_pixels += (guint64) width * (end - start);
+}
+
+/* Halves @src in both directions by averaging 2x2 pixels into @dst. An odd
+ * last row or column is dropped. */
+void
+gst_video_measure_downsample (const guint8 * src, gint src_stride,
+    gint width, gint height, guint8 * dst, gint dst_stride)
+{
+  gint x, y;
+
+  for (y = 0; y < height / 2; y++) {
+    const guint8 *s0 = src + 2 * y * src_stride;
+    const guint8 *s1 = s0 + src_stride;
+    guint8 *d = dst + y * dst_stride;
+
+    for (x = 0; x < width / 2; x++)
+      d[x] = (s0[2 * x] + s0[2 * x + 1] + s1[2 * x] + s1[2 * x + 1] + 2) >> 2;
+  }
+}
+
+/* PSNR in dB of the pixels measured in @sums, capped for identical planes */
+gdouble
+gst_video_measure_psnr (const GstVideoMeasureSums * sums)
+{
+  gdouble mse;
+
+  if (sums->n_pixels == 0)
+    return 0.0;
+
+  mse = (gdouble) sums->sse / sums->n_pixels;
+  if (mse <= 0.0)
+    return GST_VIDEO_MEASURE_MAX_PSNR;
+
+  return MIN (10.0 * log10 (255.0 * 255.0 / mse), GST_VIDEO_MEASURE_MAX_PSNR);
+}
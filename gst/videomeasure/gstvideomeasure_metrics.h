@@ -0,0 +1,77 @@
+/* GStreamer
+ * Copyright (C) <2009> Руслан Ижбулатов <lrn1986 _at_ gmail _dot_ com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_VIDEO_MEASURE_METRICS_H__
+#define __GST_VIDEO_MEASURE_METRICS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* SSIM is computed on 8x8 windows every 4 pixels, so planes must be at
+ * least this big */
+#define GST_VIDEO_MEASURE_MIN_SIZE 8
+
+/* PSNR reported for identical planes */
+#define GST_VIDEO_MEASURE_MAX_PSNR 100.0
+
+typedef struct _GstVideoMeasureSums GstVideoMeasureSums;
+
+/* Sums over a range of window rows or pixel rows of a plane, which can be
+ * added together for the whole plane */
+struct _GstVideoMeasureSums {
+  /* over the windows */
+  gdouble ssim;
+  gdouble cs;
+  gfloat  ssim_lowest;
+  gfloat  ssim_highest;
+  guint64 n_windows;
+
+  /* over the pixels */
+  guint64 sse;
+  guint64 n_pixels;
+};
+
+void     gst_video_measure_sums_init     (GstVideoMeasureSums * sums);
+void     gst_video_measure_sums_add      (GstVideoMeasureSums * sums,
+                                          const GstVideoMeasureSums * other);
+
+gint     gst_video_measure_n_window_rows (gint height);
+gsize    gst_video_measure_scratch_size  (gint width);
+
+void     gst_video_measure_ssim_rows     (const guint8 * ref, gint ref_stride,
+                                          const guint8 * dist, gint dist_stride,
+                                          gint width, gint start, gint end,
+                                          gint32 * scratch,
+                                          GstVideoMeasureSums * sums);
+
+void     gst_video_measure_sse_rows      (const guint8 * ref, gint ref_stride,
+                                          const guint8 * dist, gint dist_stride,
+                                          gint width, gint start, gint end,
+                                          GstVideoMeasureSums * sums);
+
+void     gst_video_measure_downsample    (const guint8 * src, gint src_stride,
+                                          gint width, gint height,
+                                          guint8 * dst, gint dst_stride);
+
+gdouble  gst_video_measure_psnr          (const GstVideoMeasureSums * sums);
+
+G_END_DECLS
+
+#endif /* __GST_VIDEO_MEASURE_METRICS_H__ */
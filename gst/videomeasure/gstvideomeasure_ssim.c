@@ -20,28 +20,70 @@
 /**
  * SECTION:element-ssim
  *
- * The ssim calculates SSIM (Structural SIMilarity) index for two or more 
- * streams, for each frame.
- * First stream is the original, other streams are modified (compressed) ones.
- * ssim will calculate SSIM index of each frame of each modified stream, using 
- * original stream as a reference.
+ * The ssim element compares one or more distorted video streams with a
+ * reference stream and measures their luma quality for each frame.
+ * The first sink pad (the one with the lowest zorder, by default the first
+ * requested one) receives the reference stream and all the other sink pads
+ * receive distorted versions of it, which must have the same size.
  *
- * The ssim accepts only YUV planar top-first data and calculates only Y-SSIM.
- * All streams must have the same width, height and colorspace.
- * Output streams are greyscale video streams, where bright pixels indicate 
- * high SSIM values, dark pixels - low SSIM values.
- * The ssim also calculates mean SSIM index for each frame and emits is as a 
- * message.
- * ssim is intended to be used with videomeasure_collector element to catch the 
- * events (such as mean SSIM index values) and save them into a file.
+ * The reference stream is output unchanged, so ssim can be placed in a
+ * pipeline without changing what the rest of it sees. For every frame and
+ * distorted stream, ssim computes the metrics selected by
+ * #GstSSim:metrics:
+ * <itemizedlist>
+ * <listitem><para>
+ * SSIM (Structural SIMilarity) of 8x8 windows every 4 pixels, reported as
+ * the mean, lowest and highest over the windows of the frame
+ * </para></listitem>
+ * <listitem><para>
+ * PSNR in dB, 100 for identical frames
+ * </para></listitem>
+ * <listitem><para>
+ * MS-SSIM (multi-scale SSIM) over up to 5 scales, each half the size of the
+ * previous one
+ * </para></listitem>
+ * </itemizedlist>
+ *
+ * The frames are split in bands of rows which are measured on
+ * #GstSSim:threads threads. The results are posted as element messages
+ * named <classname>&quot;SSIM&quot;</classname> with the fields:
+ * <itemizedlist>
+ * <listitem><para>
+ * #gchar * <classname>&quot;stream&quot;</classname>: the name of the sink
+ * pad of the distorted stream
+ * </para></listitem>
+ * <listitem><para>
+ * #guint64 <classname>&quot;offset&quot;</classname>: the number of the
+ * frame since the element started
+ * </para></listitem>
+ * <listitem><para>
+ * #GstClockTime <classname>&quot;timestamp&quot;</classname>: the
+ * timestamp of the output frame
+ * </para></listitem>
+ * <listitem><para>
+ * #gdouble <classname>&quot;mean&quot;</classname>,
+ * <classname>&quot;lowest&quot;</classname> and
+ * <classname>&quot;highest&quot;</classname>: the SSIM of the frame
+ * </para></listitem>
+ * <listitem><para>
+ * #gdouble <classname>&quot;psnr&quot;</classname>: the PSNR of the frame
+ * </para></listitem>
+ * <listitem><para>
+ * #gdouble <classname>&quot;ms-ssim&quot;</classname>: the MS-SSIM of the
+ * frame
+ * </para></listitem>
+ * </itemizedlist>
+ * Only the fields of the selected metrics are present. The same results are
+ * also sent downstream in custom events which the measurecollector element
+ * can write to a file.
  *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
- * gst-launch ssim name=ssim ssim.src0 ! videoconvert ! glimagesink filesrc
- * location=orig.avi ! decodebin ! ssim.original filesrc location=compr.avi !
- * decodebin ! ssim.modified0
- * ]| This pipeline produces a video stream that consists of SSIM frames.
+ * gst-launch-1.0 -m ssim name=ssim ! fakesink filesrc location=orig.avi !
+ * decodebin ! ssim.sink_0 filesrc location=compr.avi ! decodebin ! ssim.sink_1
+ * ]| This pipeline posts the SSIM and PSNR of each frame of compr.avi
+ * compared to orig.avi.
  * </refsect2>
  */
 /* Element-Checklist-Version: 5 */
@@ -50,1632 +92,811 @@
 #include "config.h"
 #endif
 
-#include "gstvideomeasure.h"
-#include "gstvideomeasure_ssim.h"
-#include <gst/audio/audio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+#include "gstvideomeasure.h"
+#include "gstvideomeasure_ssim.h"
+
 #define GST_CAT_DEFAULT gst_ssim_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
-/* elementfactory information */
+#define DEFAULT_METRICS (GST_SSIM_METRIC_SSIM | GST_SSIM_METRIC_PSNR)
+#define DEFAULT_THREADS 0
+#define MAX_THREADS 64
+
+/* window rows a band has at least, to keep the workers busy long enough */
+#define MIN_BAND_ROWS 8
 
-#define SINK_CAPS \
-  "video/x-raw-yuv, " \
-  "format = (fourcc) { I420, YV12, Y41B, Y42B } "
+/* scales and weights of MS-SSIM, from Wang, Simoncelli and Bovik */
+#define MS_SSIM_SCALES 5
+static const gdouble ms_ssim_weights[MS_SSIM_SCALES] = {
+  0.0448, 0.2856, 0.3001, 0.2363, 0.1333
+};
 
+enum
+{
+  PROP_0,
+  PROP_METRICS,
+  PROP_THREADS
+};
 
-#define SRC_CAPS \
-  "video/x-raw-gray, " \
-  "width = (int) [ 1, MAX ], " \
-  "height = (int) [ 1, MAX ], " \
-  "framerate = (fraction) [ 0/1, MAX ], " \
-  "bpp = (int) 8, " \
-  "depth = (int) 8 "
+/* formats with an 8 bit luma plane */
+#define FORMATS "{ I420, YV12, Y41B, Y42B, Y444, NV12, NV21, GRAY8 }"
+
+#define CAPS \
+  "video/x-raw, " \
+  "format = (string) " FORMATS ", " \
+  "width = (int) [ 8, MAX ], " \
+  "height = (int) [ 8, MAX ], " \
+  "framerate = (fraction) [ 0/1, MAX ]"
 
 static GstStaticPadTemplate gst_ssim_src_template =
-GST_STATIC_PAD_TEMPLATE ("src_%u",
+GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
-    GST_PAD_SOMETIMES,
-    GST_STATIC_CAPS (SRC_CAPS)
-    );
-
-static GstStaticPadTemplate gst_ssim_sink_original_template =
-GST_STATIC_PAD_TEMPLATE ("original",
-    GST_PAD_SINK,
-    GST_PAD_REQUEST,
-    GST_STATIC_CAPS (SINK_CAPS)
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (CAPS)
     );
 
-static GstStaticPadTemplate gst_ssim_sink_modified_template =
-GST_STATIC_PAD_TEMPLATE ("modified_%u",
+static GstStaticPadTemplate gst_ssim_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink_%u",
     GST_PAD_SINK,
     GST_PAD_REQUEST,
-    GST_STATIC_CAPS (SINK_CAPS)
+    GST_STATIC_CAPS (CAPS)
     );
 
-static void gst_ssim_class_init (GstSSimClass * klass);
-static void gst_ssim_init (GstSSim * ssim);
-static void gst_ssim_finalize (GObject * object);
-
-static gboolean gst_ssim_setcaps (GstPad * pad, GstCaps * caps);
-static gboolean gst_ssim_query (GstPad * pad, GstQuery * query);
-static gboolean gst_ssim_src_event (GstPad * pad, GstEvent * event);
-static gboolean gst_ssim_sink_event (GstPad * pad, GstEvent * event);
-
-static GstPad *gst_ssim_request_new_pad (GstElement * element,
-    GstPadTemplate * temp, const gchar * unused);
-static void gst_ssim_release_pad (GstElement * element, GstPad * pad);
-
-static GstStateChangeReturn gst_ssim_change_state (GstElement * element,
-    GstStateChange transition);
-
-static GstFlowReturn gst_ssim_collected (GstCollectPads * pads,
-    gpointer user_data);
+/* luma plane of a frame or of a downscaled copy */
+typedef struct
+{
+  const guint8 *data;
+  gint stride;
+  gint width;
+  gint height;
+} GstSSimPlane;
 
-static GstElementClass *parent_class = NULL;
+#define gst_ssim_parent_class parent_class
+G_DEFINE_TYPE (GstSSim, gst_ssim, GST_TYPE_VIDEO_AGGREGATOR);
 
 GType
-gst_ssim_get_type (void)
+gst_ssim_metrics_get_type (void)
 {
-  static GType ssim_type = 0;
-
-  if (G_UNLIKELY (ssim_type == 0)) {
-    static const GTypeInfo ssim_info = {
-      sizeof (GstSSimClass), NULL, NULL,
-      (GClassInitFunc) gst_ssim_class_init, NULL, NULL,
-      sizeof (GstSSim), 0,
-      (GInstanceInitFunc) gst_ssim_init,
-    };
-
-    ssim_type = g_type_register_static (GST_TYPE_ELEMENT, "GstSSim",
-        &ssim_info, 0);
-    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "ssim", 0, "SSIM calculator");
+  static volatile gsize metrics_type = 0;
+  static const GFlagsValue metrics[] = {
+    {GST_SSIM_METRIC_SSIM, "SSIM", "ssim"},
+    {GST_SSIM_METRIC_PSNR, "PSNR", "psnr"},
+    {GST_SSIM_METRIC_MS_SSIM, "Multi-scale SSIM", "ms-ssim"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&metrics_type)) {
+    GType tmp = g_flags_register_static ("GstSSimMetrics", metrics);
+    g_once_init_leave (&metrics_type, tmp);
   }
-  return ssim_type;
+
+  return (GType) metrics_type;
 }
 
 static void
-gst_ssim_post_message (GstSSim * ssim, GstBuffer * buffer, gfloat mssim,
-    gfloat lowest, gfloat highest)
+gst_ssim_plane_init (GstSSimPlane * plane, GstVideoFrame * frame)
 {
-  GstMessage *m;
-  guint64 offset;
-
-  offset = GST_BUFFER_OFFSET (buffer);
-
-  m = gst_message_new_element (GST_OBJECT_CAST (ssim),
-      gst_structure_new ("SSIM",
-          "offset", G_TYPE_UINT64, offset,
-          "timestamp", GST_TYPE_CLOCK_TIME, GST_BUFFER_TIMESTAMP (buffer),
-          "mean", G_TYPE_FLOAT, mssim,
-          "lowest", G_TYPE_FLOAT, lowest,
-          "highest", G_TYPE_FLOAT, highest, NULL));
-
-  GST_DEBUG_OBJECT (GST_OBJECT (ssim), "Frame %" G_GINT64_FORMAT
-      " @ %" GST_TIME_FORMAT " mean SSIM is %f, l-h is %f-%f", offset,
-      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), mssim, lowest, highest);
-
-  gst_element_post_message (GST_ELEMENT_CAST (ssim), m);
+  plane->data = GST_VIDEO_FRAME_COMP_DATA (frame, 0);
+  plane->stride = GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+  plane->width = GST_VIDEO_FRAME_COMP_WIDTH (frame, 0);
+  plane->height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, 0);
 }
 
-static GstCaps *
-gst_ssim_src_getcaps (GstPad * pad)
+static void
+gst_ssim_measure_band (GstSSimJob * job)
 {
-  GstCaps *result;
-  gchar *capstr;
-
-  result = gst_caps_copy (gst_pad_get_pad_template_caps (pad));
-  capstr = gst_caps_to_string (result);
-  GST_DEBUG ("getsrccaps - return static caps: %s", capstr);
-  g_free (capstr);
-  return result;
+  gst_video_measure_sums_init (&job->sums);
+  gst_video_measure_ssim_rows (job->ref, job->ref_stride, job->dist,
+      job->dist_stride, job->width, job->win_start, job->win_end,
+      job->scratch, &job->sums);
+  gst_video_measure_sse_rows (job->ref, job->ref_stride, job->dist,
+      job->dist_stride, job->width, job->row_start, job->row_end, &job->sums);
 }
 
-static GstCaps *
-gst_ssim_sink_getcaps (GstPad * pad)
+static void
+gst_ssim_downsample_band (GstSSimJob * job)
 {
-  GstCaps *result = NULL;
-  GstSSim *ssim;
-  gchar *capstr;
-
-  ssim = GST_SSIM (GST_PAD_PARENT (pad));
-
-  GST_OBJECT_LOCK (ssim);
-
-  result = gst_pad_get_fixed_caps_func (pad);
-  capstr = gst_caps_to_string (result);
-  GST_DEBUG ("getsinkcaps - return caps: %s", capstr);
-  g_free (capstr);
-
-  GST_OBJECT_UNLOCK (ssim);
-
-  return result;
+  gst_video_measure_downsample (job->ref + 2 * job->row_start *
+      job->ref_stride, job->ref_stride, job->width,
+      2 * (job->row_end - job->row_start),
+      job->dst + job->row_start * job->dst_stride, job->dst_stride);
 }
 
 static void
-calculate_mu (GstSSim * ssim, gfloat * outmu, guint8 * buf)
+gst_ssim_take_jobs (GstSSim * ssim)
 {
-  gint oy, ox, iy, ix;
-
-  for (oy = 0; oy < ssim->height; oy++) {
-    for (ox = 0; ox < ssim->width; ox++) {
-      gfloat mu = 0;
-      gfloat elsumm;
-      gint weight_y_base, weight_x_base;
-      gint weight_offset;
-      gint pixel_offset;
-      gint winstart_y;
-      gint wghstart_y;
-      gint winend_y;
-      gint winstart_x;
-      gint wghstart_x;
-      gint winend_x;
-      gfloat weight;
-      gint source_offset;
-
-      source_offset = oy * ssim->width + ox;
-
-      winstart_x = ssim->windows[source_offset].x_window_start;
-      wghstart_x = ssim->windows[source_offset].x_weight_start;
-      winend_x = ssim->windows[source_offset].x_window_end;
-      winstart_y = ssim->windows[source_offset].y_window_start;
-      wghstart_y = ssim->windows[source_offset].y_weight_start;
-      winend_y = ssim->windows[source_offset].y_window_end;
-      elsumm = ssim->windows[source_offset].element_summ;
-
-      switch (ssim->windowtype) {
-        case 0:
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            pixel_offset = iy * ssim->width;
-            for (ix = winstart_x; ix <= winend_x; ix++)
-              mu += buf[pixel_offset + ix];
-          }
-          mu = mu / elsumm;
-          break;
-        case 1:
-
-          weight_y_base = wghstart_y - winstart_y;
-          weight_x_base = wghstart_x - winstart_x;
-
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            pixel_offset = iy * ssim->width;
-            weight_offset = (weight_y_base + iy) * ssim->windowsize +
-                weight_x_base;
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              weight = ssim->weights[weight_offset + ix];
-              mu += weight * buf[pixel_offset + ix];
-            }
-          }
-          mu = mu / elsumm;
-          break;
-      }
-      outmu[oy * ssim->width + ox] = mu;
-    }
-  }
+  gint i;
 
+  while ((i = g_atomic_int_add (&ssim->next_job, 1)) < (gint) ssim->n_jobs)
+    ssim->jobs[i].func (&ssim->jobs[i]);
 }
 
 static void
-calcssim_without_mu (GstSSim * ssim, guint8 * org, gfloat * orgmu, guint8 * mod,
-    guint8 * out, gfloat * mean, gfloat * lowest, gfloat * highest)
+gst_ssim_worker_func (gpointer data, gpointer user_data)
 {
-  gint oy, ox, iy, ix;
-  gfloat cumulative_ssim = 0;
-  *lowest = G_MAXFLOAT;
-  *highest = -G_MAXFLOAT;
-
-  for (oy = 0; oy < ssim->height; oy++) {
-    for (ox = 0; ox < ssim->width; ox++) {
-      gfloat mu_o = 128, mu_m = 128;
-      gdouble sigma_o = 0, sigma_m = 0, sigma_om = 0;
-      gfloat tmp1 = 0, tmp2 = 0;
-      gfloat elsumm = 0;
-      gint weight_y_base, weight_x_base;
-      gint weight_offset;
-      gint pixel_offset;
-      gint winstart_y;
-      gint wghstart_y;
-      gint winend_y;
-      gint winstart_x;
-      gint wghstart_x;
-      gint winend_x;
-      gfloat weight;
-      gint source_offset;
-
-      source_offset = oy * ssim->width + ox;
-
-      winstart_x = ssim->windows[source_offset].x_window_start;
-      wghstart_x = ssim->windows[source_offset].x_weight_start;
-      winend_x = ssim->windows[source_offset].x_window_end;
-      winstart_y = ssim->windows[source_offset].y_window_start;
-      wghstart_y = ssim->windows[source_offset].y_weight_start;
-      winend_y = ssim->windows[source_offset].y_window_end;
-      elsumm = ssim->windows[source_offset].element_summ;
-
-      weight_y_base = wghstart_y - winstart_y;
-      weight_x_base = wghstart_x - winstart_x;
-      switch (ssim->windowtype) {
-        case 0:
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            guint8 *org_with_offset, *mod_with_offset;
-            pixel_offset = iy * ssim->width;
-            org_with_offset = &org[pixel_offset];
-            mod_with_offset = &mod[pixel_offset];
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              tmp1 = org_with_offset[ix] - mu_o;
-              sigma_o += tmp1 * tmp1;
-              tmp2 = mod_with_offset[ix] - mu_m;
-              sigma_m += tmp2 * tmp2;
-              sigma_om += tmp1 * tmp2;
-            }
-          }
-          break;
-        case 1:
-
-          weight_y_base = wghstart_y - winstart_y;
-          weight_x_base = wghstart_x - winstart_x;
-
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            guint8 *org_with_offset, *mod_with_offset;
-            gfloat *weights_with_offset;
-            gfloat wt1, wt2;
-            pixel_offset = iy * ssim->width;
-            weight_offset = (weight_y_base + iy) * ssim->windowsize +
-                weight_x_base;
-            org_with_offset = &org[pixel_offset];
-            mod_with_offset = &mod[pixel_offset];
-            weights_with_offset = &ssim->weights[weight_offset];
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              weight = weights_with_offset[ix];
-              tmp1 = org_with_offset[ix] - mu_o;
-              tmp2 = mod_with_offset[ix] - mu_m;
-              wt1 = weight * tmp1;
-              wt2 = weight * tmp2;
-              sigma_o += wt1 * tmp1;
-              sigma_m += wt2 * tmp2;
-              sigma_om += wt1 * tmp2;
-            }
-          }
-          break;
-      }
-      sigma_o = sqrt (sigma_o / elsumm);
-      sigma_m = sqrt (sigma_m / elsumm);
-      sigma_om = sigma_om / elsumm;
-      tmp1 = (2 * mu_o * mu_m + ssim->const1) * (2 * sigma_om + ssim->const2) /
-          ((mu_o * mu_o + mu_m * mu_m + ssim->const1) *
-          (sigma_o * sigma_o + sigma_m * sigma_m + ssim->const2));
-
-      /* SSIM can go negative, that's why it is
-         127 + index * 128 instead of index * 255 */
-      out[oy * ssim->width + ox] = 127 + tmp1 * 128;
-      *lowest = MIN (*lowest, tmp1);
-      *highest = MAX (*highest, tmp1);
-      cumulative_ssim += tmp1;
-    }
-  }
-  *mean = cumulative_ssim / (ssim->width * ssim->height);
-}
+  GstSSim *ssim = data;
 
-static void
-calcssim_canonical (GstSSim * ssim, guint8 * org, gfloat * orgmu, guint8 * mod,
-    guint8 * out, gfloat * mean, gfloat * lowest, gfloat * highest)
-{
-  gint oy, ox, iy, ix;
-  gfloat cumulative_ssim = 0;
-  *lowest = G_MAXFLOAT;
-  *highest = -G_MAXFLOAT;
-
-  for (oy = 0; oy < ssim->height; oy++) {
-    for (ox = 0; ox < ssim->width; ox++) {
-      gfloat mu_o = 0, mu_m = 0;
-      gdouble sigma_o = 0, sigma_m = 0, sigma_om = 0;
-      gfloat tmp1, tmp2;
-      gfloat elsumm = 0;
-      gint weight_y_base, weight_x_base;
-      gint weight_offset;
-      gint pixel_offset;
-      gint winstart_y;
-      gint wghstart_y;
-      gint winend_y;
-      gint winstart_x;
-      gint wghstart_x;
-      gint winend_x;
-      gfloat weight;
-      gint source_offset;
-
-      source_offset = oy * ssim->width + ox;
-
-      winstart_x = ssim->windows[source_offset].x_window_start;
-      wghstart_x = ssim->windows[source_offset].x_weight_start;
-      winend_x = ssim->windows[source_offset].x_window_end;
-      winstart_y = ssim->windows[source_offset].y_window_start;
-      wghstart_y = ssim->windows[source_offset].y_weight_start;
-      winend_y = ssim->windows[source_offset].y_window_end;
-      elsumm = ssim->windows[source_offset].element_summ;
-
-      switch (ssim->windowtype) {
-        case 0:
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            pixel_offset = iy * ssim->width;
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              mu_m += mod[pixel_offset + ix];
-            }
-          }
-          mu_m = mu_m / elsumm;
-          mu_o = orgmu[oy * ssim->width + ox];
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            pixel_offset = iy * ssim->width;
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              tmp1 = org[pixel_offset + ix] - mu_o;
-              tmp2 = mod[pixel_offset + ix] - mu_m;
-              sigma_o += tmp1 * tmp1;
-              sigma_m += tmp2 * tmp2;
-              sigma_om += tmp1 * tmp2;
-            }
-          }
-          break;
-        case 1:
-
-          weight_y_base = wghstart_y - winstart_y;
-          weight_x_base = wghstart_x - winstart_x;
-
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            pixel_offset = iy * ssim->width;
-            weight_offset = (weight_y_base + iy) * ssim->windowsize +
-                weight_x_base;
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              weight = ssim->weights[weight_offset + ix];
-              mu_o += weight * org[pixel_offset + ix];
-              mu_m += weight * mod[pixel_offset + ix];
-            }
-          }
-          mu_m = mu_m / elsumm;
-          mu_o = orgmu[oy * ssim->width + ox];
-          for (iy = winstart_y; iy <= winend_y; iy++) {
-            gfloat *weights_with_offset;
-            guint8 *org_with_offset, *mod_with_offset;
-            gfloat wt1, wt2;
-            pixel_offset = iy * ssim->width;
-            weight_offset = (weight_y_base + iy) * ssim->windowsize +
-                weight_x_base;
-            weights_with_offset = &ssim->weights[weight_offset];
-            org_with_offset = &org[pixel_offset];
-            mod_with_offset = &mod[pixel_offset];
-            for (ix = winstart_x; ix <= winend_x; ix++) {
-              weight = weights_with_offset[ix];
-              tmp1 = org_with_offset[ix] - mu_o;
-              tmp2 = mod_with_offset[ix] - mu_m;
-              wt1 = weight * tmp1;
-              wt2 = weight * tmp2;
-              sigma_o += wt1 * tmp1;
-              sigma_m += wt2 * tmp2;
-              sigma_om += wt1 * tmp2;
-            }
-          }
-          break;
-      }
-      sigma_o = sqrt (sigma_o / elsumm);
-      sigma_m = sqrt (sigma_m / elsumm);
-      sigma_om = sigma_om / elsumm;
-      tmp1 = (2 * mu_o * mu_m + ssim->const1) * (2 * sigma_om + ssim->const2) /
-          ((mu_o * mu_o + mu_m * mu_m + ssim->const1) *
-          (sigma_o * sigma_o + sigma_m * sigma_m + ssim->const2));
-
-      /* SSIM can go negative, that's why it is
-         127 + index * 128 instead of index * 255 */
-      out[oy * ssim->width + ox] = 127 + tmp1 * 128;
-      *lowest = MIN (*lowest, tmp1);
-      *highest = MAX (*highest, tmp1);
-      cumulative_ssim += tmp1;
-    }
-  }
-  *mean = cumulative_ssim / (ssim->width * ssim->height);
-}
+  gst_ssim_take_jobs (ssim);
 
+  g_mutex_lock (&ssim->job_lock);
+  if (--ssim->n_pending == 0)
+    g_cond_signal (&ssim->job_cond);
+  g_mutex_unlock (&ssim->job_lock);
+}
 
-/* the first caps we receive on any of the sinkpads will define the caps for all
- * the other sinkpads because we can only measure streams with the same caps.
- */
-static gboolean
-gst_ssim_setcaps (GstPad * pad, GstCaps * caps)
+/* Runs the first n_jobs jobs on the streaming thread and the workers, which
+ * take the next job left when they are done with one. Returns when all jobs
+ * are done. */
+static void
+gst_ssim_run_jobs (GstSSim * ssim)
 {
-  GstSSim *ssim;
-  GList *pads;
-  const char *media_type;
-  GstStructure *capsstr;
-  gint width, height, fps_n, fps_d;
-  guint32 fourcc;
+  guint i, n_helpers;
 
-  ssim = GST_SSIM (GST_PAD_PARENT (pad));
+  n_helpers = MIN (ssim->n_workers, ssim->n_jobs - 1);
 
-  GST_DEBUG_OBJECT (ssim, "setting caps on pad %p,%s to %" GST_PTR_FORMAT, pad,
-      GST_PAD_NAME (pad), caps);
+  g_atomic_int_set (&ssim->next_job, 0);
+  ssim->n_pending = n_helpers;
+  for (i = 0; i < n_helpers; i++)
+    g_thread_pool_push (ssim->pool, ssim, NULL);
 
-  capsstr = gst_caps_get_structure (caps, 0);
-  gst_structure_get_int (capsstr, "width", &width);
-  gst_structure_get_int (capsstr, "height", &height);
-  gst_structure_get_fraction (capsstr, "framerate", &fps_n, &fps_d);
-  gst_structure_get_fourcc (capsstr, "format", &fourcc);
-
-  GST_OBJECT_LOCK (ssim);
+  gst_ssim_take_jobs (ssim);
 
-  /* Sink caps are stored only once. At the moment it doesn't feel
-   * right to measure streams with variable caps.
-   */
-  if (G_UNLIKELY (!ssim->sinkcaps)) {
-    GstStructure *newstr;
-    GValue list = { 0, }
-    , fourcc = {
-    0,};
-
-    g_value_init (&list, GST_TYPE_LIST);
-    g_value_init (&fourcc, GST_TYPE_FOURCC);
-
-    gst_value_set_fourcc (&fourcc, GST_MAKE_FOURCC ('I', '4', '2', '0'));
-    gst_value_list_append_value (&list, &fourcc);
-    gst_value_set_fourcc (&fourcc, GST_MAKE_FOURCC ('Y', 'V', '1', '2'));
-    gst_value_list_append_value (&list, &fourcc);
-    gst_value_set_fourcc (&fourcc, GST_MAKE_FOURCC ('Y', '4', '1', 'B'));
-    gst_value_list_append_value (&list, &fourcc);
-    gst_value_set_fourcc (&fourcc, GST_MAKE_FOURCC ('Y', '4', '2', 'B'));
-    gst_value_list_append_value (&list, &fourcc);
-
-    newstr = gst_structure_new ("video/x-raw-yuv", NULL);
-    gst_structure_set (newstr, "width", G_TYPE_INT, width, NULL);
-    gst_structure_set (newstr, "height", G_TYPE_INT, height, NULL);
-    gst_structure_set_value (newstr, "format", &list);
-
-    ssim->sinkcaps = gst_caps_new_full (newstr, NULL);
-
-    g_value_unset (&list);
-    g_value_unset (&fourcc);
-  }
+  g_mutex_lock (&ssim->job_lock);
+  while (ssim->n_pending > 0)
+    g_cond_wait (&ssim->job_cond, &ssim->job_lock);
+  g_mutex_unlock (&ssim->job_lock);
+}
 
-  if (G_UNLIKELY (!ssim->srccaps)) {
-    GstStructure *newstr;
-
-    newstr = gst_structure_new ("video/x-raw-gray", NULL);
-    gst_structure_set (newstr, "width", G_TYPE_INT, width, NULL);
-    gst_structure_set (newstr, "height", G_TYPE_INT, height, NULL);
-    gst_structure_set (newstr, "framerate", GST_TYPE_FRACTION, fps_n, fps_d,
-        NULL);
-    /* Calculates SSIM only for Y channel, hence the output is monochrome.
-     * TODO: an option (a mask?) to calculate SSIM for more than one channel,
-     * will probably output RGB, one metric per channel...that would
-     * look kinda funny :)
-     */
-    gst_structure_set (newstr, "bpp", G_TYPE_INT, 8, "depth", G_TYPE_INT, 8,
-        NULL);
-
-    ssim->srccaps = gst_caps_new_full (newstr, NULL);
-  }
+/* Makes room for @n_jobs jobs on planes up to @width pixels wide */
+static void
+gst_ssim_ensure_jobs (GstSSim * ssim, guint n_jobs, gint width)
+{
+  gsize scratch_size = gst_video_measure_scratch_size (width);
+  guint i;
 
-  pads = GST_ELEMENT (ssim)->pads;
-  while (pads) {
-    GstPadDirection direction;
-    GstPad *otherpad = GST_PAD (pads->data);
-    direction = gst_pad_get_direction (otherpad);
-
-    GST_DEBUG_OBJECT (ssim, "checking caps on pad %p", otherpad);
-    if (direction == GST_PAD_SINK) {
-      gchar *capstr;
-      capstr = gst_caps_to_string (GST_PAD_CAPS (otherpad));
-      GST_DEBUG_OBJECT (ssim, "old caps on pad %p,%s were %s", otherpad,
-          GST_PAD_NAME (otherpad), capstr);
-      g_free (capstr);
-      gst_caps_replace (&GST_PAD_CAPS (otherpad), ssim->sinkcaps);
-      capstr = gst_caps_to_string (ssim->sinkcaps);
-      GST_DEBUG_OBJECT (ssim, "new caps on pad %p,%s are %s", otherpad,
-          GST_PAD_NAME (otherpad), capstr);
-      g_free (capstr);
-    } else if (direction == GST_PAD_SRC) {
-      gst_caps_replace (&GST_PAD_CAPS (otherpad), ssim->srccaps);
+  if (scratch_size > ssim->scratch_size) {
+    for (i = 0; i < ssim->jobs_size; i++) {
+      g_free (ssim->jobs[i].scratch);
+      ssim->jobs[i].scratch = NULL;
     }
-    pads = g_list_next (pads);
+    ssim->scratch_size = scratch_size;
   }
 
-  /* parse caps now */
-  media_type = gst_structure_get_name (capsstr);
-  GST_DEBUG_OBJECT (ssim, "media type is %s", media_type);
-  if (strcmp (media_type, "video/x-raw-yuv") == 0) {
-    ssim->width = width;
-    ssim->height = height;
-    ssim->frame_rate = fps_n;
-    ssim->frame_rate_base = fps_d;
-
-    GST_INFO_OBJECT (ssim, "parse_caps sets ssim to yuv format "
-        "%d, %dx%d, %d/%d fps", fourcc, ssim->width, ssim->height,
-        ssim->frame_rate, ssim->frame_rate_base);
-
-    /* Only planar formats are supported.
-     * TODO: implement support for interleaved formats
-     * Only YUV formats are supported. There's no sense in calculating the
-     * index for R, G or B channels separately.
-     */
-    switch (fourcc) {
-      case GST_MAKE_FOURCC ('I', '4', '2', '0'):
-      case GST_MAKE_FOURCC ('Y', 'V', '1', '2'):
-      case GST_MAKE_FOURCC ('Y', '4', '1', 'B'):
-      case GST_MAKE_FOURCC ('Y', '4', '2', 'B'):
-        break;
-      default:
-        goto not_supported;
-    }
-
-  } else {
-    goto not_supported;
+  if (n_jobs > ssim->jobs_size) {
+    ssim->jobs = g_renew (GstSSimJob, ssim->jobs, n_jobs);
+    memset (ssim->jobs + ssim->jobs_size, 0,
+        (n_jobs - ssim->jobs_size) * sizeof (GstSSimJob));
+    ssim->jobs_size = n_jobs;
   }
 
-  GST_OBJECT_UNLOCK (ssim);
-  return TRUE;
-  /* ERRORS */
-not_supported:
-  {
-    GST_OBJECT_UNLOCK (ssim);
-    GST_DEBUG_OBJECT (ssim, "unsupported format set as caps");
-    return FALSE;
+  for (i = 0; i < n_jobs; i++) {
+    if (ssim->jobs[i].scratch == NULL)
+      ssim->jobs[i].scratch = g_malloc (ssim->scratch_size);
   }
 }
 
-static gboolean
-gst_ssim_query_latency (GstSSim * ssim, GstQuery * query)
+static guint
+gst_ssim_n_bands (GstSSim * ssim, gint n_rows)
 {
-  GstClockTime min, max;
-  gboolean live;
-  gboolean res;
-  GstIterator *it;
-  gboolean done;
-
-  res = TRUE;
-  done = FALSE;
-
-  live = FALSE;
-  min = 0;
-  max = GST_CLOCK_TIME_NONE;
-
-  /* Take maximum of all latency values */
-  it = gst_element_iterate_sink_pads (GST_ELEMENT_CAST (ssim));
-  while (!done) {
-    GstIteratorResult ires;
-
-    gpointer item;
-
-    ires = gst_iterator_next (it, &item);
-    switch (ires) {
-      case GST_ITERATOR_DONE:
-        done = TRUE;
-        break;
-      case GST_ITERATOR_OK:
-      {
-        GstPad *pad = GST_PAD_CAST (item);
-        GstQuery *peerquery;
-        GstClockTime min_cur, max_cur;
-        gboolean live_cur;
-
-        peerquery = gst_query_new_latency ();
-
-        /* Ask peer for latency */
-        res &= gst_pad_peer_query (pad, peerquery);
-
-        /* take max from all valid return values */
-        if (res) {
-          gst_query_parse_latency (peerquery, &live_cur, &min_cur, &max_cur);
-
-          if (live_cur) {
-            if (min_cur > min)
-              min = min_cur;
-
-            if (max == GST_CLOCK_TIME_NONE)
-              max = max_cur;
-            else if (max_cur < max)
-              max = max_cur;
-
-            live = TRUE;
-          }
-        }
-
-        gst_query_unref (peerquery);
-        gst_object_unref (pad);
-        break;
-      }
-      case GST_ITERATOR_RESYNC:
-        live = FALSE;
-        min = 0;
-        max = GST_CLOCK_TIME_NONE;
-        res = TRUE;
-        gst_iterator_resync (it);
-        break;
-      default:
-        res = FALSE;
-        done = TRUE;
-        break;
-    }
-  }
-  gst_iterator_free (it);
-
-  if (res) {
-    /* store the results */
-    GST_DEBUG_OBJECT (ssim, "Calculated total latency: live %s, min %"
-        GST_TIME_FORMAT ", max %" GST_TIME_FORMAT,
-        (live ? "yes" : "no"), GST_TIME_ARGS (min), GST_TIME_ARGS (max));
-    gst_query_set_latency (query, live, min, max);
-  }
-
-  return res;
+  return CLAMP (n_rows / MIN_BAND_ROWS, 1, (gint) ssim->n_workers + 1);
 }
 
-static gboolean
-gst_ssim_query_duration (GstSSim * ssim, GstQuery * query)
+/* Measures the distorted planes @planes[1] to @planes[@n_planes - 1] against
+ * the reference plane @planes[0] and stores their sums in @sums */
+static void
+gst_ssim_measure_scale (GstSSim * ssim, const GstSSimPlane * planes,
+    guint n_planes, gboolean with_ssim, gboolean with_sse,
+    GstVideoMeasureSums * sums)
 {
-  gint64 max, min;
-  gboolean res;
-  GstFormat format;
-  GstIterator *it;
-  gboolean done;
-
-  /* parse format */
-  gst_query_parse_duration (query, &format, NULL);
-
-  max = -1;
-  min = G_MAXINT64;
-  res = TRUE;
-  done = FALSE;
-
-  it = gst_element_iterate_sink_pads (GST_ELEMENT_CAST (ssim));
-  while (!done) {
-    GstIteratorResult ires;
-
-    gpointer item;
-
-    ires = gst_iterator_next (it, &item);
-    switch (ires) {
-      case GST_ITERATOR_DONE:
-        done = TRUE;
-        break;
-      case GST_ITERATOR_OK:
-      {
-        GstPad *pad = GST_PAD_CAST (item);
-
-        gint64 duration;
-
-        /* ask sink peer for duration */
-        res &= gst_pad_query_peer_duration (pad, &format, &duration);
-        /* take min&max from all valid return values */
-        if (res) {
-          /* valid unknown length, stop searching */
-          if (duration == -1) {
-            max = duration;
-            done = TRUE;
-          }
-          /* else see if bigger than current max */
-          else {
-            if (duration > max)
-              max = duration;
-            if (duration < min)
-              min = duration;
-          }
-        }
-        gst_object_unref (pad);
-        break;
+  const GstSSimPlane *ref = &planes[0];
+  gint n_win_rows = gst_video_measure_n_window_rows (ref->height);
+  guint n_bands = gst_ssim_n_bands (ssim, n_win_rows);
+  guint d, b;
+
+  ssim->n_jobs = (n_planes - 1) * n_bands;
+  for (d = 1; d < n_planes; d++) {
+    for (b = 0; b < n_bands; b++) {
+      GstSSimJob *job = &ssim->jobs[(d - 1) * n_bands + b];
+
+      job->func = gst_ssim_measure_band;
+      job->ref = ref->data;
+      job->ref_stride = ref->stride;
+      job->dist = planes[d].data;
+      job->dist_stride = planes[d].stride;
+      job->width = ref->width;
+      job->win_start = job->win_end = 0;
+      job->row_start = job->row_end = 0;
+      if (with_ssim) {
+        job->win_start = (gint64) n_win_rows * b / n_bands;
+        job->win_end = (gint64) n_win_rows * (b + 1) / n_bands;
+      }
+      if (with_sse) {
+        job->row_start = (gint64) ref->height * b / n_bands;
+        job->row_end = (gint64) ref->height * (b + 1) / n_bands;
       }
-      case GST_ITERATOR_RESYNC:
-        max = -1;
-        min = G_MAXINT64;
-        res = TRUE;
-        gst_iterator_resync (it);
-        break;
-      default:
-        res = FALSE;
-        done = TRUE;
-        break;
     }
   }
-  gst_iterator_free (it);
 
-  if (res) {
-    /* and store the max */
-    GST_DEBUG_OBJECT (ssim, "Total duration in format %s: %"
-        GST_TIME_FORMAT, gst_format_get_name (format), GST_TIME_ARGS (min));
-    gst_query_set_duration (query, format, min);
-  }
+  gst_ssim_run_jobs (ssim);
 
-  return res;
+  for (d = 1; d < n_planes; d++) {
+    gst_video_measure_sums_init (&sums[d - 1]);
+    for (b = 0; b < n_bands; b++)
+      gst_video_measure_sums_add (&sums[d - 1],
+          &ssim->jobs[(d - 1) * n_bands + b].sums);
+  }
 }
 
-
-static gboolean
-gst_ssim_query (GstPad * pad, GstQuery * query)
+/* Halves the @n_planes planes @src into @dst */
+static void
+gst_ssim_downsample (GstSSim * ssim, const GstSSimPlane * src,
+    GstSSimPlane * dst, guint n_planes)
 {
-  GstSSim *ssim = GST_SSIM (gst_pad_get_parent (pad));
-  gboolean res = FALSE;
-
-  switch (GST_QUERY_TYPE (query)) {
-    case GST_QUERY_POSITION:
-    {
-      GstFormat format;
-
-      gst_query_parse_position (query, &format, NULL);
-
-      switch (format) {
-        case GST_FORMAT_TIME:
-          /* FIXME, bring to stream time, might be tricky */
-          gst_query_set_position (query, format, ssim->timestamp);
-          res = TRUE;
-          break;
-        case GST_FORMAT_DEFAULT:
-          gst_query_set_position (query, format, ssim->offset);
-          res = TRUE;
-          break;
-        default:
-          break;
-      }
-      break;
+  gint n_rows = dst[0].height;
+  guint n_bands = gst_ssim_n_bands (ssim, n_rows / 4);
+  guint p, b;
+
+  ssim->n_jobs = n_planes * n_bands;
+  for (p = 0; p < n_planes; p++) {
+    for (b = 0; b < n_bands; b++) {
+      GstSSimJob *job = &ssim->jobs[p * n_bands + b];
+
+      job->func = gst_ssim_downsample_band;
+      job->ref = src[p].data;
+      job->ref_stride = src[p].stride;
+      job->width = src[p].width;
+      job->dst = (guint8 *) dst[p].data;
+      job->dst_stride = dst[p].stride;
+      job->row_start = (gint64) n_rows * b / n_bands;
+      job->row_end = (gint64) n_rows * (b + 1) / n_bands;
     }
-    case GST_QUERY_DURATION:
-      res = gst_ssim_query_duration (ssim, query);
-      break;
-    case GST_QUERY_LATENCY:
-      res = gst_ssim_query_latency (ssim, query);
-      break;
-    default:
-      /* FIXME, needs a custom query handler because we have multiple
-       * sinkpads
-       */
-      res = gst_pad_query_default (pad, query);
-      break;
   }
 
-  gst_object_unref (ssim);
-  return res;
-}
-
-static gboolean
-forward_event_func (GstPad * pad, GValue * ret, GstEvent * event)
-{
-  gst_event_ref (event);
-  GST_LOG_OBJECT (pad, "About to send event %s", GST_EVENT_TYPE_NAME (event));
-  if (!gst_pad_push_event (pad, event)) {
-    g_value_set_boolean (ret, FALSE);
-    GST_LOG_OBJECT (pad, "Sending event  %p (%s) failed.",
-        event, GST_EVENT_TYPE_NAME (event));
-  } else {
-    GST_LOG_OBJECT (pad, "Sent event  %p (%s).",
-        event, GST_EVENT_TYPE_NAME (event));
-  }
-  gst_object_unref (pad);
-  return TRUE;
+  gst_ssim_run_jobs (ssim);
 }
 
-/* forwards the event to all sinkpads, takes ownership of the
- * event
- *
- * Returns: TRUE if the event could be forwarded on all
- * sinkpads.
- */
-static gboolean
-forward_event (GstSSim * ssim, GstEvent * event)
+static gdouble
+gst_ssim_mean (gdouble sum, guint64 n)
 {
-  GstIterator *it;
-  GValue vret = { 0 };
-
-  GST_LOG_OBJECT (ssim, "Forwarding event %p (%s)", event,
-      GST_EVENT_TYPE_NAME (event));
-
-  g_value_init (&vret, G_TYPE_BOOLEAN);
-  g_value_set_boolean (&vret, TRUE);
-  it = gst_element_iterate_sink_pads (GST_ELEMENT_CAST (ssim));
-  gst_iterator_fold (it, (GstIteratorFoldFunction) forward_event_func, &vret,
-      event);
-  gst_iterator_free (it);
-  gst_event_unref (event);
-
-  return g_value_get_boolean (&vret);
+  return n > 0 ? MAX (sum / n, 0.0) : 0.0;
 }
 
-static gboolean
-gst_ssim_src_event (GstPad * pad, GstEvent * event)
+/* Computes the MS-SSIM of the distorted planes from the sums of their
+ * full scale in @sums. The reference is downscaled only once for all. */
+static void
+gst_ssim_measure_ms_ssim (GstSSim * ssim, const GstSSimPlane * planes,
+    guint n_planes, const GstVideoMeasureSums * sums, gdouble * ms_ssim)
 {
-  GstSSim *ssim;
-  gboolean result;
-
-  ssim = GST_SSIM (gst_pad_get_parent (pad));
-
-  switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_QOS:
-      /* QoS might be tricky */
-      result = FALSE;
-      break;
-    case GST_EVENT_SEEK:
-    {
-      GstSeekFlags flags;
-      GstSeekType curtype;
-      gint64 cur;
-
-      /* parse the seek parameters */
-      gst_event_parse_seek (event, &ssim->segment_rate, NULL, &flags, &curtype,
-          &cur, NULL, NULL);
-
-      /* check if we are flushing */
-      if (flags & GST_SEEK_FLAG_FLUSH) {
-        /* make sure we accept nothing anymore and return WRONG_STATE */
-        gst_collect_pads_set_flushing (ssim->collect, TRUE);
-
-        /* flushing seek, start flush downstream, the flush will be done
-         * when all pads received a FLUSH_STOP. */
-        gst_pad_push_event (pad, gst_event_new_flush_start ());
-      }
-      /* now wait for the collected to be finished and mark a new
-       * segment */
-      GST_OBJECT_LOCK (ssim->collect);
-      if (curtype == GST_SEEK_TYPE_SET)
-        ssim->segment_position = cur;
-      else
-        ssim->segment_position = 0;
-      {
-        GstSSimOutputContext *c;
-        gint i = 0;
-        for (i = 0; i < ssim->src->len; i++) {
-          c = (GstSSimOutputContext *) g_ptr_array_index (ssim->src, i);
-          c->segment_pending = TRUE;
-        }
-      }
-      GST_OBJECT_UNLOCK (ssim->collect);
-
-      result = forward_event (ssim, event);
+  const guint n_dists = n_planes - 1;
+  GstSSimPlane *scale, *prev;
+  GstVideoMeasureSums *scale_sums;
+  gdouble total = 0.0;
+  gsize size = 0;
+  guint8 *mem;
+  gint n_scales, k;
+  guint d, p;
+
+  /* every scale must still hold a window */
+  for (n_scales = 1; n_scales < MS_SSIM_SCALES; n_scales++) {
+    if ((planes[0].width >> n_scales) < GST_VIDEO_MEASURE_MIN_SIZE ||
+        (planes[0].height >> n_scales) < GST_VIDEO_MEASURE_MIN_SIZE)
       break;
+    size += (gsize) (planes[0].width >> n_scales) *
+        (planes[0].height >> n_scales);
+  }
+
+  for (k = 0; k < n_scales; k++)
+    total += ms_ssim_weights[k];
+
+  size *= n_planes;
+  if (size > ssim->pyramid_size) {
+    g_free (ssim->pyramid);
+    ssim->pyramid = g_malloc (size);
+    ssim->pyramid_size = size;
+  }
+
+  scale = g_new (GstSSimPlane, 2 * n_planes);
+  prev = scale + n_planes;
+  scale_sums = g_new (GstVideoMeasureSums, n_dists);
+  memcpy (scale, planes, n_planes * sizeof (GstSSimPlane));
+  memcpy (scale_sums, sums, n_dists * sizeof (GstVideoMeasureSums));
+
+  for (d = 0; d < n_dists; d++)
+    ms_ssim[d] = 1.0;
+
+  mem = ssim->pyramid;
+  for (k = 1; k < n_scales; k++) {
+    /* contrast and structure of the previous scale */
+    for (d = 0; d < n_dists; d++)
+      ms_ssim[d] *= pow (gst_ssim_mean (scale_sums[d].cs,
+              scale_sums[d].n_windows), ms_ssim_weights[k - 1] / total);
+
+    memcpy (prev, scale, n_planes * sizeof (GstSSimPlane));
+    for (p = 0; p < n_planes; p++) {
+      scale[p].width = prev[p].width / 2;
+      scale[p].height = prev[p].height / 2;
+      scale[p].stride = scale[p].width;
+      scale[p].data = mem;
+      mem += scale[p].width * scale[p].height;
     }
-    case GST_EVENT_NAVIGATION:
-      /* navigation is rather pointless. */
-      result = FALSE;
-      break;
-    default:
-      /* just forward the rest for now */
-      result = forward_event (ssim, event);
-      break;
-  }
-  gst_object_unref (ssim);
 
-  return result;
-}
-
-static gboolean
-gst_ssim_sink_event (GstPad * pad, GstEvent * event)
-{
-  GstSSim *ssim;
-  gboolean ret;
-
-  ssim = GST_SSIM (gst_pad_get_parent (pad));
-
-  GST_DEBUG ("Got %s event on pad %s:%s", GST_EVENT_TYPE_NAME (event),
-      GST_DEBUG_PAD_NAME (pad));
-
-  switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_NEWSEGMENT:
-    {
-      gboolean update;
-      gdouble rate;
-      gdouble applied_rate;
-      GstFormat format;
-      gint64 start;
-      gint64 stop;
-      gint64 position;
-      gst_event_parse_new_segment_full (event, &update, &rate, &applied_rate,
-          &format, &start, &stop, &position);
-      GST_DEBUG ("NEWSEGMENTEVENT: update(%d), rate(%f), app_rate(%f), "
-          "format(%d), start(%" GST_TIME_FORMAT ") stop(%" GST_TIME_FORMAT ") "
-          "position(%" GST_TIME_FORMAT ")", update, rate, applied_rate, format,
-          GST_TIME_ARGS (start), GST_TIME_ARGS (stop),
-          GST_TIME_ARGS (position));
-      break;
-    }
-    case GST_EVENT_FLUSH_STOP:
-      /* mark a pending new segment. This event is synchronized
-       * with the streaming thread so we can safely update the
-       * variable without races. It's somewhat weird because we
-       * assume the collectpads forwarded the FLUSH_STOP past us
-       * and downstream (using our source pad, the bastard!).
-       */
-    {
-      GstSSimOutputContext *c;
-      gint i = 0;
-      for (i = 0; i < ssim->src->len; i++) {
-        c = (GstSSimOutputContext *) g_ptr_array_index (ssim->src, i);
-        c->segment_pending = TRUE;
-      }
-    }
-      break;
-    default:
-      break;
+    gst_ssim_downsample (ssim, prev, scale, n_planes);
+    gst_ssim_measure_scale (ssim, scale, n_planes, TRUE, FALSE, scale_sums);
   }
 
-  /* now GstCollectPads can take care of the rest, e.g. EOS */
-  GST_DEBUG ("Dispatching %s event on pad %s:%s", GST_EVENT_TYPE_NAME (event),
-      GST_DEBUG_PAD_NAME (pad));
-  ret = ssim->collect_event (pad, event);
-  GST_DEBUG ("Event %s on pad %s:%s is dispatched", GST_EVENT_TYPE_NAME (event),
-      GST_DEBUG_PAD_NAME (pad));
-  gst_object_unref (ssim);
-  return ret;
-}
+  /* luminance, contrast and structure of the coarsest scale */
+  for (d = 0; d < n_dists; d++)
+    ms_ssim[d] *= pow (gst_ssim_mean (scale_sums[d].ssim,
+            scale_sums[d].n_windows), ms_ssim_weights[n_scales - 1] / total);
 
-static void
-gst_ssim_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec)
-{
-  GstSSim *ssim;
-
-  ssim = GST_SSIM (object);
-
-  switch (prop_id) {
-    case PROP_SSIM_TYPE:
-      ssim->ssimtype = g_value_get_int (value);
-      break;
-    case PROP_WINDOW_TYPE:
-      ssim->windowtype = g_value_get_int (value);
-      g_free (ssim->windows);
-      ssim->windows = NULL;
-      break;
-    case PROP_WINDOW_SIZE:
-      ssim->windowsize = g_value_get_int (value);
-      g_free (ssim->windows);
-      ssim->windows = NULL;
-      break;
-    case PROP_GAUSS_SIGMA:
-      ssim->sigma = g_value_get_float (value);
-      g_free (ssim->windows);
-      ssim->windows = NULL;
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
-  }
+  g_free (scale_sums);
+  g_free (scale);
 }
 
 static void
-gst_ssim_get_property (GObject * object, guint prop_id, GValue * value,
-    GParamSpec * pspec)
+gst_ssim_push_measured (GstSSim * ssim, const gchar * stream,
+    GstClockTime timestamp, const gchar * metric, gdouble mean,
+    const gdouble * lowest, const gdouble * highest)
 {
-  GstSSim *ssim;
-
-  ssim = GST_SSIM (object);
-
-  switch (prop_id) {
-    case PROP_SSIM_TYPE:
-      g_value_set_int (value, ssim->ssimtype);
-      break;
-    case PROP_WINDOW_TYPE:
-      g_value_set_int (value, ssim->windowtype);
-      break;
-    case PROP_WINDOW_SIZE:
-      g_value_set_int (value, ssim->windowsize);
-      break;
-    case PROP_GAUSS_SIGMA:
-      g_value_set_float (value, ssim->sigma);
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
-  }
+  GValue mean_v = G_VALUE_INIT;
+  GValue lowest_v = G_VALUE_INIT;
+  GValue highest_v = G_VALUE_INIT;
+  GstEvent *event;
+
+  g_value_init (&mean_v, G_TYPE_DOUBLE);
+  g_value_set_double (&mean_v, mean);
+  if (lowest) {
+    g_value_init (&lowest_v, G_TYPE_DOUBLE);
+    g_value_set_double (&lowest_v, *lowest);
+  }
+  if (highest) {
+    g_value_init (&highest_v, G_TYPE_DOUBLE);
+    g_value_set_double (&highest_v, *highest);
+  }
+
+  event = gst_event_new_measured (ssim->offset, timestamp, stream, metric,
+      &mean_v, lowest ? &lowest_v : NULL, highest ? &highest_v : NULL);
+  gst_pad_push_event (GST_AGGREGATOR_SRC_PAD (ssim), event);
+
+  g_value_unset (&mean_v);
+  if (lowest)
+    g_value_unset (&lowest_v);
+  if (highest)
+    g_value_unset (&highest_v);
 }
 
-
 static void
-gst_ssim_class_init (GstSSimClass * klass)
+gst_ssim_post_results (GstSSim * ssim, GstPad * pad, GstClockTime timestamp,
+    GstSSimMetrics metrics, const GstVideoMeasureSums * sums, gdouble ms_ssim)
 {
-  GObjectClass *gobject_class = (GObjectClass *) klass;
-  GstElementClass *gstelement_class = (GstElementClass *) klass;
+  GstStructure *s;
+  gchar *stream;
 
-  gobject_class->set_property = gst_ssim_set_property;
-  gobject_class->get_property = gst_ssim_get_property;
-  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_ssim_finalize);
-
-  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_SSIM_TYPE,
-      g_param_spec_int ("ssim-type", "SSIM type",
-          "Type of the SSIM metric. 0 - canonical. 1 - with fixed mu "
-          "(almost the same results, but roughly 20% faster)",
-          0, 1, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_WINDOW_TYPE,
-      g_param_spec_int ("window-type", "Window type",
-          "Type of the weighting in the window. "
-          "0 - no weighting. 1 - Gaussian weighting (controlled by \"sigma\")",
-          0, 1, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_WINDOW_SIZE,
-      g_param_spec_int ("window-size", "Window size",
-          "Size of a window.", 1, 22, 11,
-          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_GAUSS_SIGMA,
-      g_param_spec_float ("gauss-sigma", "Deviation (for Gauss function)",
-          "Used to calculate Gussian weights "
-          "(only when using Gaussian window).",
-          G_MINFLOAT, 10, 1.5, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-
-  gst_element_class_add_pad_template (gstelement_class,
-      gst_static_pad_template_get (&gst_ssim_src_template));
-  gst_element_class_add_pad_template (gstelement_class,
-      gst_static_pad_template_get (&gst_ssim_sink_original_template));
-  gst_element_class_add_pad_template (gstelement_class,
-      gst_static_pad_template_get (&gst_ssim_sink_modified_template));
-  gst_element_class_set_static_metadata (gstelement_class, "SSim",
-      "Filter/Analyzer/Video",
-      "Calculate Y-SSIM for n+2 YUV video streams",
-      "Руслан Ижбулатов <lrn1986 _at_ gmail _dot_ com>");
-
-  parent_class = g_type_class_peek_parent (klass);
+  stream = gst_pad_get_name (pad);
+  s = gst_structure_new ("SSIM",
+      "stream", G_TYPE_STRING, stream,
+      "offset", G_TYPE_UINT64, ssim->offset,
+      "timestamp", GST_TYPE_CLOCK_TIME, timestamp, NULL);
 
-  gstelement_class->request_new_pad =
-      GST_DEBUG_FUNCPTR (gst_ssim_request_new_pad);
-  gstelement_class->release_pad = GST_DEBUG_FUNCPTR (gst_ssim_release_pad);
+  if (metrics & GST_SSIM_METRIC_SSIM) {
+    gdouble mean = sums->ssim / sums->n_windows;
+    gdouble lowest = sums->ssim_lowest;
+    gdouble highest = sums->ssim_highest;
 
-  gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_ssim_change_state);
-}
-
-static GstPad *
-gst_ssim_request_new_pad (GstElement * element, GstPadTemplate * templ,
-    const gchar * padname)
-{
-  gchar *name;
-  GstSSim *ssim;
-  GstPad *newpad;
-  GstPad *newsrc;
-  gint padcount;
-  GstPadTemplate *template;
-  guint num = -1;
+    gst_structure_set (s, "mean", G_TYPE_DOUBLE, mean,
+        "lowest", G_TYPE_DOUBLE, lowest,
+        "highest", G_TYPE_DOUBLE, highest, NULL);
+    gst_ssim_push_measured (ssim, stream, timestamp, "SSIM", mean, &lowest,
+        &highest);
 
-  if (templ->direction != GST_PAD_SINK)
-    goto not_sink;
-
-  ssim = GST_SSIM (element);
+    GST_LOG_OBJECT (ssim, "%s frame %" G_GUINT64_FORMAT " @ %"
+        GST_TIME_FORMAT " mean SSIM is %f, l-h is %f-%f", stream,
+        ssim->offset, GST_TIME_ARGS (timestamp), mean, lowest, highest);
+  }
 
-  padcount = ssim->padcount;
+  if (metrics & GST_SSIM_METRIC_PSNR) {
+    gdouble psnr = gst_video_measure_psnr (sums);
 
-  GST_DEBUG_OBJECT (ssim, "number of pads = %d", padcount);
+    gst_structure_set (s, "psnr", G_TYPE_DOUBLE, psnr, NULL);
+    gst_ssim_push_measured (ssim, stream, timestamp, "PSNR", psnr, NULL, NULL);
 
-  if (padname)
-    GST_DEBUG_OBJECT (ssim, "reqested pad %s", padname);
-  else
-    goto unnamed_pad;
-
-  if (strcmp (padname, "original") == 0) {
-    newpad = gst_pad_new_from_template (templ, "original");
-    GST_DEBUG_OBJECT (ssim, "request new sink pad original");
-    ssim->orig = newpad;
-  } else if (strncmp (padname, "modified_", 9) == 0) {
-    const gchar *numstr = &padname[9];
-    num = strtoul (numstr, NULL, 10);
-    if (errno == EINVAL || errno == ERANGE)
-      goto bad_name;
-    newpad = gst_pad_new_from_template (templ, padname);
-    GST_DEBUG_OBJECT (ssim, "request new sink pad %s", padname);
-  } else
-    goto bad_name;
-
-  gst_pad_set_getcaps_function (newpad,
-      GST_DEBUG_FUNCPTR (gst_ssim_sink_getcaps));
-  gst_pad_set_setcaps_function (newpad, GST_DEBUG_FUNCPTR (gst_ssim_setcaps));
-  gst_collect_pads_add_pad (ssim->collect, newpad, sizeof (GstCollectData),
-      NULL, TRUE);
-
-  /* FIXME: hacked way to override/extend the event function of
-   * GstCollectPads; because it sets its own event function giving the
-   * element no access to events
-   */
-  GST_DEBUG_OBJECT (ssim, "Current collect_event is %p, changing to %p",
-      ssim->collect_event, GST_PAD_EVENTFUNC (newpad));
-  ssim->collect_event = (GstPadEventFunction) GST_PAD_EVENTFUNC (newpad);
-  gst_pad_set_event_function (newpad, GST_DEBUG_FUNCPTR (gst_ssim_sink_event));
-
-  GST_DEBUG_OBJECT (ssim, "Adding a pad...");
-  /* takes ownership of the pad */
-  if (!gst_element_add_pad (GST_ELEMENT (ssim), newpad))
-    goto could_not_add_sink;
-  else
-    /* increment pad counter */
-    padcount = g_atomic_int_add (&ssim->padcount, 1);
-
-  if (num != -1) {
-    GstSSimOutputContext *c;
-
-    template = gst_static_pad_template_get (&gst_ssim_src_template);
-    name = g_strdup_printf ("src_%u", num);
-    newsrc = gst_pad_new_from_template (template, name);
-    GST_DEBUG_OBJECT (ssim, "creating src pad %s", name);
-    g_free (name);
-    gst_object_unref (template);
-
-    gst_pad_set_getcaps_function (newsrc,
-        GST_DEBUG_FUNCPTR (gst_ssim_src_getcaps));
-    gst_pad_set_query_function (newsrc, GST_DEBUG_FUNCPTR (gst_ssim_query));
-    gst_pad_set_event_function (newsrc, GST_DEBUG_FUNCPTR (gst_ssim_src_event));
-
-    if (!gst_element_add_pad (GST_ELEMENT (ssim), newsrc))
-      goto could_not_add_src;
-
-    c = g_new (GstSSimOutputContext, 1);
-    c->pad = newsrc;
-    g_object_set_data (G_OBJECT (newpad), "ssim-match-output-context", c);
-    g_ptr_array_add (ssim->src, (gpointer) c);
+    GST_LOG_OBJECT (ssim, "%s frame %" G_GUINT64_FORMAT " PSNR is %f dB",
+        stream, ssim->offset, psnr);
   }
 
-  return newpad;
+  if (metrics & GST_SSIM_METRIC_MS_SSIM) {
+    gst_structure_set (s, "ms-ssim", G_TYPE_DOUBLE, ms_ssim, NULL);
+    gst_ssim_push_measured (ssim, stream, timestamp, "MS-SSIM", ms_ssim,
+        NULL, NULL);
 
-  /* errors */
-bad_name:
-  {
-    g_warning ("gstssim: request new pad with bad name %s (must be "
-        "'modified')\n", padname);
-    return NULL;
-  }
-unnamed_pad:
-  {
-    g_warning ("gstssim: request new pad without a name (must be "
-        "'modified')\n");
-    return NULL;
+    GST_LOG_OBJECT (ssim, "%s frame %" G_GUINT64_FORMAT " MS-SSIM is %f",
+        stream, ssim->offset, ms_ssim);
   }
-not_sink:
-  {
-    g_warning ("gstssim: request new pad that is not a SINK pad\n");
-    return NULL;
-  }
-could_not_add_src:
-  {
-    GST_DEBUG_OBJECT (ssim, "could not add src pad");
-    gst_object_unref (newsrc);
-  }
-could_not_add_sink:
-  {
-    GST_DEBUG_OBJECT (ssim, "could not add sink pad");
-    gst_collect_pads_remove_pad (ssim->collect, newpad);
-    gst_object_unref (newpad);
-    return NULL;
-  }
-}
-
-static void
-gst_ssim_release_pad (GstElement * element, GstPad * pad)
-{
-  GstSSim *ssim;
 
-  ssim = GST_SSIM (element);
+  g_free (stream);
 
-  GST_DEBUG_OBJECT (ssim, "release pad %s:%s", GST_DEBUG_PAD_NAME (pad));
-
-  gst_collect_pads_remove_pad (ssim->collect, pad);
-  gst_element_remove_pad (element, pad);
+  gst_element_post_message (GST_ELEMENT_CAST (ssim),
+      gst_message_new_element (GST_OBJECT_CAST (ssim), s));
 }
 
-
-static void
-gst_ssim_init (GstSSim * ssim)
+/* Measures the frames of the distorted pads @dists against @ref */
+static GstFlowReturn
+gst_ssim_measure (GstSSim * ssim, GstVideoAggregatorPad * ref,
+    GPtrArray * dists, GstSSimMetrics metrics, GstClockTime timestamp)
 {
-  ssim->windowsize = 11;
-  ssim->windowtype = 1;
-  ssim->windows = NULL;
-  ssim->sigma = 1.5;
-  ssim->ssimtype = 0;
-  ssim->src = g_ptr_array_new ();
-  ssim->padcount = 0;
-  ssim->collect_event = NULL;
-  ssim->sinkcaps = NULL;
-
-  /* keep track of the sinkpads requested */
-  ssim->collect = gst_collect_pads_new ();
-  gst_collect_pads_set_function (ssim->collect,
-      GST_DEBUG_FUNCPTR (gst_ssim_collected), ssim);
-}
+  const guint n_planes = dists->len + 1;
+  GstVideoMeasureSums *sums;
+  GstSSimPlane *planes;
+  gdouble *ms_ssim;
+  guint d;
 
-static void
-gst_ssim_finalize (GObject * object)
-{
-  GstSSim *ssim = GST_SSIM (object);
+  planes = g_new (GstSSimPlane, n_planes);
+  gst_ssim_plane_init (&planes[0], ref->aggregated_frame);
 
-  gst_object_unref (ssim->collect);
-  ssim->collect = NULL;
+  for (d = 0; d < dists->len; d++) {
+    GstVideoAggregatorPad *pad = g_ptr_array_index (dists, d);
 
-  g_free (ssim->windows);
-  ssim->windows = NULL;
+    gst_ssim_plane_init (&planes[d + 1], pad->aggregated_frame);
+    if (planes[d + 1].width != planes[0].width ||
+        planes[d + 1].height != planes[0].height)
+      goto wrong_size;
+  }
 
-  g_free (ssim->weights);
-  ssim->weights = NULL;
+  sums = g_new (GstVideoMeasureSums, dists->len);
+  ms_ssim = g_new0 (gdouble, dists->len);
 
-  if (ssim->sinkcaps)
-    gst_caps_unref (ssim->sinkcaps);
-  if (ssim->srccaps)
-    gst_caps_unref (ssim->srccaps);
+  /* the scales of MS-SSIM are downsampled with as many jobs as planes */
+  gst_ssim_ensure_jobs (ssim, n_planes * (ssim->n_workers + 1),
+      planes[0].width);
 
-  g_ptr_array_free (ssim->src, TRUE);
+  gst_ssim_measure_scale (ssim, planes, n_planes,
+      (metrics & (GST_SSIM_METRIC_SSIM | GST_SSIM_METRIC_MS_SSIM)) != 0,
+      (metrics & GST_SSIM_METRIC_PSNR) != 0, sums);
+  if (metrics & GST_SSIM_METRIC_MS_SSIM)
+    gst_ssim_measure_ms_ssim (ssim, planes, n_planes, sums, ms_ssim);
 
-  G_OBJECT_CLASS (parent_class)->finalize (object);
-}
+  for (d = 0; d < dists->len; d++)
+    gst_ssim_post_results (ssim, g_ptr_array_index (dists, d), timestamp,
+        metrics, &sums[d], ms_ssim[d]);
 
-typedef gfloat (*GstSSimWeightFunc) (GstSSim * ssim, gint y, gint x);
+  g_free (ms_ssim);
+  g_free (sums);
+  g_free (planes);
 
-static gfloat
-gst_ssim_weight_func_none (GstSSim * ssim, gint y, gint x)
-{
-  return 1;
-}
+  return GST_FLOW_OK;
 
-static gfloat
-gst_ssim_weight_func_gauss (GstSSim * ssim, gint y, gint x)
-{
-  gfloat coord = sqrt (x * x + y * y);
-  return exp (-1 * (coord * coord) / (2 * ssim->sigma * ssim->sigma)) /
-      (ssim->sigma * sqrt (2 * G_PI));
+  /* ERRORS */
+wrong_size:
+  {
+    GST_ELEMENT_ERROR (ssim, STREAM, FORMAT,
+        ("Distorted streams must have the same size as the reference"),
+        ("%s is %dx%d but the reference is %dx%d",
+            GST_PAD_NAME (g_ptr_array_index (dists, d)), planes[d + 1].width,
+            planes[d + 1].height, planes[0].width, planes[0].height));
+    g_free (planes);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
 }
 
-static gboolean
-gst_ssim_regenerate_windows (GstSSim * ssim)
+static GstFlowReturn
+gst_ssim_aggregate_frames (GstVideoAggregator * vagg, GstBuffer * outbuf)
 {
-  gint windowiseven;
-  gint y, x, y2, x2;
-  GstSSimWeightFunc func;
-  gfloat normal_summ = 0;
-  gint normal_count = 0;
+  GstSSim *ssim = GST_SSIM (vagg);
+  GstVideoAggregatorPad *ref = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstSSimMetrics metrics;
+  GPtrArray *dists;
+  GList *l;
 
-  g_free (ssim->weights);
+  dists = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_object_unref);
 
-  ssim->weights = g_new (gfloat, ssim->windowsize * ssim->windowsize);
+  GST_OBJECT_LOCK (ssim);
+  for (l = GST_ELEMENT (ssim)->sinkpads; l; l = l->next) {
+    GstVideoAggregatorPad *pad = l->data;
 
-  windowiseven = ((gint) ssim->windowsize / 2) * 2 == ssim->windowsize ? 1 : 0;
+    if (ref == NULL)
+      ref = gst_object_ref (pad);
+    else if (pad->aggregated_frame)
+      g_ptr_array_add (dists, gst_object_ref (pad));
+  }
+  metrics = ssim->metrics;
+  GST_OBJECT_UNLOCK (ssim);
 
-  g_free (ssim->windows);
+  if (ref == NULL || ref->aggregated_frame == NULL)
+    goto done;
 
-  ssim->windows = g_new (GstSSimWindowCache, ssim->height * ssim->width);
+  if (ssim->copy_reference) {
+    GstVideoFrame out_frame;
+    gboolean copied = FALSE;
 
-  switch (ssim->windowtype) {
-    case 0:
-      func = gst_ssim_weight_func_none;
-      break;
-    case 1:
-      func = gst_ssim_weight_func_gauss;
-      break;
-    default:
-      GST_WARNING_OBJECT (ssim, "unknown window type - %d. Defaulting to %d",
-          ssim->windowtype, 1);
-      ssim->windowtype = 1;
-      func = gst_ssim_weight_func_gauss;
-  }
+    if (gst_video_frame_map (&out_frame, &vagg->info, outbuf, GST_MAP_WRITE)) {
+      copied = gst_video_frame_copy (&out_frame, ref->aggregated_frame);
+      gst_video_frame_unmap (&out_frame);
+    }
 
-  for (y = 0; y < ssim->windowsize; y++) {
-    gint yoffset = y * ssim->windowsize;
-    for (x = 0; x < ssim->windowsize; x++) {
-      ssim->weights[yoffset + x] = func (ssim, x - ssim->windowsize / 2 +
-          windowiseven, y - ssim->windowsize / 2 + windowiseven);
-      normal_summ += ssim->weights[yoffset + x];
-      normal_count++;
+    if (!copied) {
+      GST_ELEMENT_ERROR (ssim, STREAM, FORMAT, (NULL),
+          ("Could not copy the reference frame to the output"));
+      ret = GST_FLOW_NOT_NEGOTIATED;
+      goto done;
     }
   }
 
-  for (y = 0; y < ssim->height; y++) {
-    for (x = 0; x < ssim->width; x++) {
-      GstSSimWindowCache win;
-      gint element_count = 0;
-
-      win.x_window_start = x - ssim->windowsize / 2 + windowiseven;
-      win.x_weight_start = 0;
-      if (win.x_window_start < 0) {
-        win.x_weight_start = -win.x_window_start;
-        win.x_window_start = 0;
-      }
+  if (dists->len > 0 && metrics != 0)
+    ret = gst_ssim_measure (ssim, ref, dists, metrics,
+        GST_BUFFER_TIMESTAMP (outbuf));
 
-      win.x_window_end = x + ssim->windowsize / 2;
-      if (win.x_window_end >= ssim->width)
-        win.x_window_end = ssim->width - 1;
-
-      win.y_window_start = y - ssim->windowsize / 2 + windowiseven;
-      win.y_weight_start = 0;
-      if (win.y_window_start < 0) {
-        win.y_weight_start = -win.y_window_start;
-        win.y_window_start = 0;
-      }
+  ssim->offset++;
 
-      win.y_window_end = y + ssim->windowsize / 2;
-      if (win.y_window_end >= ssim->height)
-        win.y_window_end = ssim->height - 1;
-
-      win.element_summ = 0;
-      element_count = (win.y_window_end - win.y_window_start + 1) *
-          (win.x_window_end - win.x_window_start + 1);
-      if (element_count == normal_count)
-        win.element_summ = normal_summ;
-      else {
-        for (y2 = win.y_weight_start; y2 < ssim->windowsize; y2++) {
-          for (x2 = win.x_weight_start; x2 < ssim->windowsize; x2++) {
-            win.element_summ += ssim->weights[y2 * ssim->windowsize + x2];
-          }
-        }
-      }
-      ssim->windows[(y * ssim->width + x)] = win;
-    }
-  }
+done:
+  if (ref)
+    gst_object_unref (ref);
+  g_ptr_array_free (dists, TRUE);
 
-  /* FIXME: while 0.01 and 0.03 are pretty much static, the 255 implies that
-   * we're working with 8-bit-per-color-component format, which may not be true
-   */
-  ssim->const1 = 0.01 * 255 * 0.01 * 255;
-  ssim->const2 = 0.03 * 255 * 0.03 * 255;
-  return TRUE;
+  return ret;
 }
 
+/* Outputs the buffer of the reference pad itself when it is in the output
+ * format, and nothing when it has no buffer */
 static GstFlowReturn
-gst_ssim_collected (GstCollectPads * pads, gpointer user_data)
+gst_ssim_get_output_buffer (GstVideoAggregator * vagg, GstBuffer ** outbuf)
 {
-  GstSSim *ssim;
-  GSList *collected;
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstBuffer *orgbuf = NULL;
-  gfloat *orgmu = NULL;
-  GstBuffer *outbuf = NULL;
-  gpointer outdata = NULL;
-  guint outsize = 0;
-  gfloat mssim = 0, lowest = 1, highest = -1;
-  gboolean ready = TRUE;
-  gint padnumber = 0;
-
-  ssim = GST_SSIM (user_data);
-
-  if (G_UNLIKELY (ssim->windows == NULL)) {
-    GST_DEBUG_OBJECT (ssim, "Regenerating windows");
-    gst_ssim_regenerate_windows (ssim);
+  GstSSim *ssim = GST_SSIM (vagg);
+  GstVideoAggregatorPad *ref;
+  GstBuffer *buffer = NULL;
+  gboolean same_format = FALSE;
+
+  GST_OBJECT_LOCK (vagg);
+  if (GST_ELEMENT (vagg)->sinkpads) {
+    ref = GST_ELEMENT (vagg)->sinkpads->data;
+
+    if (ref->buffer) {
+      buffer = gst_buffer_ref (ref->buffer);
+      same_format = GST_VIDEO_INFO_FORMAT (&ref->buffer_vinfo) ==
+          GST_VIDEO_INFO_FORMAT (&vagg->info) &&
+          GST_VIDEO_INFO_WIDTH (&ref->buffer_vinfo) ==
+          GST_VIDEO_INFO_WIDTH (&vagg->info) &&
+          GST_VIDEO_INFO_HEIGHT (&ref->buffer_vinfo) ==
+          GST_VIDEO_INFO_HEIGHT (&vagg->info);
+    }
   }
+  GST_OBJECT_UNLOCK (vagg);
 
-  switch (ssim->ssimtype) {
-    case 0:
-      ssim->func = (GstSSimFunction) calcssim_canonical;
-      break;
-    case 1:
-      ssim->func = (GstSSimFunction) calcssim_without_mu;
-      break;
-    default:
-      return GST_FLOW_ERROR;
+  if (buffer == NULL) {
+    *outbuf = NULL;
+    return GST_FLOW_OK;
   }
 
-  for (collected = pads->data; collected; collected = g_slist_next (collected)) {
-    GstCollectData *collect_data;
-    GstBuffer *inbuf;
-
-    collect_data = (GstCollectData *) collected->data;
-
-    inbuf = gst_collect_pads_peek (pads, collect_data);
-
-    if (inbuf == NULL) {
-      GST_LOG_OBJECT (ssim, "channel %p: no bytes available", collect_data);
-      ready = FALSE;
-    } else
-      gst_buffer_unref (inbuf);
+  ssim->copy_reference = !same_format;
+  if (ssim->copy_reference) {
+    gst_buffer_unref (buffer);
+    return GST_VIDEO_AGGREGATOR_CLASS (parent_class)->get_output_buffer (vagg,
+        outbuf);
   }
 
-  /* if _collected() was called, all pads should have data, but if
-   * one of them doesn't, it means that it is EOS and we can't go any further
-   *
-   * FIXME, shouldn't we do something about pads that DO have data?
-   * Flush them or something?
-   */
-  if (G_UNLIKELY (!ready))
-    goto eos;
+  /* the timestamps of the output are set on the copy */
+  *outbuf = gst_buffer_copy (buffer);
+  gst_buffer_unref (buffer);
 
-  /* Mu is just a blur, we can calculate it once */
-  if (ssim->ssimtype == 0) {
-    orgmu = g_new (gfloat, ssim->width * ssim->height);
+  return GST_FLOW_OK;
+}
 
-    for (collected = pads->data; collected;
-        collected = g_slist_next (collected)) {
-      GstCollectData *collect_data;
+/* Prefers the format, size and frame rate of the reference stream */
+static GstCaps *
+gst_ssim_fixate_caps (GstVideoAggregator * vagg, GstCaps * caps)
+{
+  GstVideoInfo info;
+  gboolean have_reference = FALSE;
+  GstStructure *s;
+
+  GST_OBJECT_LOCK (vagg);
+  if (GST_ELEMENT (vagg)->sinkpads) {
+    GstVideoAggregatorPad *ref = GST_ELEMENT (vagg)->sinkpads->data;
+
+    info = ref->info;
+    have_reference = GST_VIDEO_INFO_FORMAT (&info) != GST_VIDEO_FORMAT_UNKNOWN
+        && GST_VIDEO_INFO_WIDTH (&info) > 0;
+  }
+  GST_OBJECT_UNLOCK (vagg);
+
+  if (!have_reference)
+    return GST_VIDEO_AGGREGATOR_CLASS (parent_class)->fixate_caps (vagg, caps);
+
+  s = gst_caps_get_structure (caps, 0);
+  gst_structure_fixate_field_string (s, "format",
+      gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&info)));
+  gst_structure_fixate_field_nearest_int (s, "width",
+      GST_VIDEO_INFO_WIDTH (&info));
+  gst_structure_fixate_field_nearest_int (s, "height",
+      GST_VIDEO_INFO_HEIGHT (&info));
+  if (GST_VIDEO_INFO_FPS_N (&info) > 0)
+    gst_structure_fixate_field_nearest_fraction (s, "framerate",
+        GST_VIDEO_INFO_FPS_N (&info), GST_VIDEO_INFO_FPS_D (&info));
+  else
+    gst_structure_fixate_field_nearest_fraction (s, "framerate", 25, 1);
+  if (gst_structure_has_field (s, "pixel-aspect-ratio"))
+    gst_structure_fixate_field_nearest_fraction (s, "pixel-aspect-ratio",
+        GST_VIDEO_INFO_PAR_N (&info), GST_VIDEO_INFO_PAR_D (&info));
 
-      collect_data = (GstCollectData *) collected->data;
+  return gst_caps_fixate (caps);
+}
 
-      if (collect_data->pad == ssim->orig) {
-        orgbuf = gst_collect_pads_pop (pads, collect_data);
+static gboolean
+gst_ssim_start (GstAggregator * agg)
+{
+  GstSSim *ssim = GST_SSIM (agg);
+  guint n_threads;
 
-        GST_DEBUG_OBJECT (ssim, "Original stream - flags(0x%x), timestamp(%"
-            GST_TIME_FORMAT "), duration(%" GST_TIME_FORMAT ")",
-            GST_BUFFER_FLAGS (orgbuf),
-            GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (orgbuf)),
-            GST_TIME_ARGS (GST_BUFFER_DURATION (orgbuf)));
-        calculate_mu (ssim, orgmu, GST_BUFFER_DATA (orgbuf));
+  if (!GST_AGGREGATOR_CLASS (parent_class)->start (agg))
+    return FALSE;
 
-        break;
-      }
-    }
-  }
+  GST_OBJECT_LOCK (ssim);
+  n_threads = ssim->threads;
+  GST_OBJECT_UNLOCK (ssim);
 
-  GST_LOG_OBJECT (ssim, "starting to cycle through streams");
-
-  for (collected = pads->data; collected; collected = g_slist_next (collected)) {
-    GstCollectData *collect_data;
-    GstBuffer *inbuf;
-    guint8 *indata;
-
-    collect_data = (GstCollectData *) collected->data;
-
-    if (collect_data->pad != ssim->orig) {
-      inbuf = gst_collect_pads_pop (pads, collect_data);
-
-      indata = GST_BUFFER_DATA (inbuf);
-
-      GST_DEBUG_OBJECT (ssim, "Modified stream - flags(0x%x), timestamp(%"
-          GST_TIME_FORMAT "), duration(%" GST_TIME_FORMAT ")",
-          GST_BUFFER_FLAGS (inbuf),
-          GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (inbuf)),
-          GST_TIME_ARGS (GST_BUFFER_DURATION (inbuf)));
-
-      if (!GST_BUFFER_FLAG_IS_SET (inbuf, GST_BUFFER_FLAG_GAP)) {
-        GstSSimOutputContext *c;
-        GstEvent *measured;
-        guint64 offset;
-        GValue vmean = { 0 }
-        , vlowest = {
-        0}
-        , vhighest = {
-        0};
-
-        c = (GstSSimOutputContext *)
-            g_object_get_data (G_OBJECT (collect_data->pad),
-            "ssim-match-output-context");
-
-        GST_DEBUG_OBJECT (ssim, "Output context is %" GST_PTR_FORMAT
-            ", pad will be %" GST_PTR_FORMAT, c, c->pad);
-
-        outsize = GST_ROUND_UP_4 (ssim->width) * ssim->height;
-        GST_LOG_OBJECT (ssim, "channel %p: making output buffer of %d bytes",
-            collect_data, outsize);
-
-        /* first buffer, alloc outsize.
-         * FIXME: we can easily subbuffer and _make_writable.
-         * FIXME: only create empty buffer for first non-gap buffer, so that we
-         * only use ssim function when really calculating
-         */
-        outbuf = gst_buffer_new_and_alloc (GST_ROUND_UP_4 (ssim->width) *
-            ssim->height);
-        outdata = GST_BUFFER_DATA (outbuf);
-        gst_buffer_set_caps (outbuf, gst_pad_get_fixed_caps_func (c->pad));
-
-        /* Videos should match, so the output video has the same characteristics
-         * as the input video
-         */
-        /* set timestamps on the output buffer */
-        gst_buffer_copy_metadata (outbuf, inbuf, (GstBufferCopyFlags)
-            GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS);
-
-        g_value_init (&vmean, G_TYPE_FLOAT);
-        g_value_init (&vlowest, G_TYPE_FLOAT);
-        g_value_init (&vhighest, G_TYPE_FLOAT);
-
-        GST_LOG_OBJECT (ssim, "channel %p: calculating SSIM", collect_data);
-
-        ssim->func (ssim, GST_BUFFER_DATA (orgbuf), orgmu, indata, outdata,
-            &mssim, &lowest, &highest);
-
-        GST_DEBUG_OBJECT (GST_OBJECT (ssim), "MSSIM is %f, l-h is %f - %f",
-            mssim, lowest, highest);
-
-        gst_ssim_post_message (ssim, outbuf, mssim, lowest, highest);
-
-        g_value_set_float (&vmean, mssim);
-        g_value_set_float (&vlowest, lowest);
-        g_value_set_float (&vhighest, highest);
-        offset = GST_BUFFER_OFFSET (inbuf);
-
-        /* our timestamping is very simple, just an ever incrementing
-         * counter, the new segment time will take care of their respective
-         * stream time.
-         */
-        if (c->segment_pending) {
-          GstEvent *event;
-
-          /* FIXME, use rate/applied_rate as set on all sinkpads.
-           * - currently we just set rate as received from last seek-event
-           * We could potentially figure out the duration as well using
-           * the current segment positions and the stated stop positions.
-           * Also we just start from stream time 0 which is rather
-           * weird. For non-synchronized mixing, the time should be
-           * the min of the stream times of all received segments,
-           * rationale being that the duration is at least going to
-           * be as long as the earliest stream we start mixing. This
-           * would also be correct for synchronized mixing but then
-           * the later streams would be delayed until the stream times`
-           * match.
-           */
-          event = gst_event_new_new_segment_full (FALSE, ssim->segment_rate,
-              1.0, GST_FORMAT_TIME, ssim->timestamp, -1,
-              ssim->segment_position);
-
-          gst_pad_push_event (c->pad, event);
-          c->segment_pending = FALSE;
-        }
-
-        measured = gst_event_new_measured (offset,
-            GST_BUFFER_TIMESTAMP (inbuf), "SSIM", &vmean, &vlowest, &vhighest);
-        gst_pad_push_event (c->pad, measured);
-
-        /* send it out */
-        GST_DEBUG_OBJECT (ssim, "pushing outbuf, timestamp %" GST_TIME_FORMAT
-            ", size %d", GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (outbuf)),
-            GST_BUFFER_SIZE (outbuf));
-        ret &= gst_pad_push (c->pad, outbuf);
-
-      } else {
-        GST_LOG_OBJECT (ssim, "channel %p: skipping", collect_data);
-      }
-      gst_buffer_unref (inbuf);
-      padnumber++;
+  if (n_threads == 0)
+    n_threads = MIN (g_get_num_processors (), MAX_THREADS);
+
+  ssim->offset = 0;
+  ssim->n_workers = 0;
+  if (n_threads > 1) {
+    GError *err = NULL;
+
+    ssim->pool = g_thread_pool_new (gst_ssim_worker_func, NULL,
+        n_threads - 1, FALSE, &err);
+    if (ssim->pool) {
+      ssim->n_workers = n_threads - 1;
+    } else {
+      GST_WARNING_OBJECT (ssim, "failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
     }
   }
-  gst_buffer_unref (orgbuf);
 
-  if (ssim->ssimtype == 0)
-    g_free (orgmu);
+  GST_DEBUG_OBJECT (ssim, "measuring on %u threads", ssim->n_workers + 1);
 
-  ssim->segment_position = 0;
-
-  return ret;
+  return TRUE;
+}
 
-  /* ERRORS */
-eos:
-  {
-    gint i;
-    GST_DEBUG_OBJECT (ssim, "no data available, must be EOS");
-    for (i = 0; i < ssim->src->len; i++) {
-      GstSSimOutputContext *c =
-          (GstSSimOutputContext *) g_ptr_array_index (ssim->src, i);
-      gst_pad_push_event (c->pad, gst_event_new_eos ());
-    }
+static gboolean
+gst_ssim_stop (GstAggregator * agg)
+{
+  GstSSim *ssim = GST_SSIM (agg);
+  guint i;
 
-    return GST_FLOW_UNEXPECTED;
+  if (ssim->pool) {
+    g_thread_pool_free (ssim->pool, FALSE, TRUE);
+    ssim->pool = NULL;
   }
+  ssim->n_workers = 0;
+
+  for (i = 0; i < ssim->jobs_size; i++)
+    g_free (ssim->jobs[i].scratch);
+  g_free (ssim->jobs);
+  ssim->jobs = NULL;
+  ssim->jobs_size = ssim->n_jobs = 0;
+  ssim->scratch_size = 0;
+
+  g_free (ssim->pyramid);
+  ssim->pyramid = NULL;
+  ssim->pyramid_size = 0;
+
+  return GST_AGGREGATOR_CLASS (parent_class)->stop (agg);
 }
 
-static GstStateChangeReturn
-gst_ssim_change_state (GstElement * element, GstStateChange transition)
+static void
+gst_ssim_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
 {
-  GstSSim *ssim;
-  GstStateChangeReturn ret;
-
-  ssim = GST_SSIM (element);
+  GstSSim *ssim = GST_SSIM (object);
 
-  switch (transition) {
-    case GST_STATE_CHANGE_NULL_TO_READY:
-      break;
-    case GST_STATE_CHANGE_READY_TO_PAUSED:
-      ssim->timestamp = 0;
-      ssim->offset = 0;
-      {
-        GstSSimOutputContext *c;
-        gint i = 0;
-        for (i = 0; i < ssim->src->len; i++) {
-          c = (GstSSimOutputContext *) g_ptr_array_index (ssim->src, i);
-          c->segment_pending = TRUE;
-        }
-      }
-      ssim->segment_position = 0;
-      ssim->segment_rate = 1.0;
-      gst_segment_init (&ssim->segment, GST_FORMAT_UNDEFINED);
-      gst_collect_pads_start (ssim->collect);
-      break;
-    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+  switch (prop_id) {
+    case PROP_METRICS:
+      GST_OBJECT_LOCK (ssim);
+      ssim->metrics = g_value_get_flags (value);
+      GST_OBJECT_UNLOCK (ssim);
       break;
-    case GST_STATE_CHANGE_PAUSED_TO_READY:
-      /* need to unblock the collectpads before calling the
-       * parent change_state so that streaming can finish
-       */
-      gst_collect_pads_stop (ssim->collect);
+    case PROP_THREADS:
+      GST_OBJECT_LOCK (ssim);
+      ssim->threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (ssim);
       break;
     default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+}
 
-  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+static void
+gst_ssim_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstSSim *ssim = GST_SSIM (object);
 
-  switch (transition) {
+  switch (prop_id) {
+    case PROP_METRICS:
+      GST_OBJECT_LOCK (ssim);
+      g_value_set_flags (value, ssim->metrics);
+      GST_OBJECT_UNLOCK (ssim);
+      break;
+    case PROP_THREADS:
+      GST_OBJECT_LOCK (ssim);
+      g_value_set_uint (value, ssim->threads);
+      GST_OBJECT_UNLOCK (ssim);
+      break;
     default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+}
 
-  return ret;
+static void
+gst_ssim_finalize (GObject * object)
+{
+  GstSSim *ssim = GST_SSIM (object);
+
+  g_mutex_clear (&ssim->job_lock);
+  g_cond_clear (&ssim->job_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ssim_class_init (GstSSimClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstElementClass *gstelement_class = (GstElementClass *) klass;
+  GstAggregatorClass *agg_class = (GstAggregatorClass *) klass;
+  GstVideoAggregatorClass *videoaggregator_class =
+      (GstVideoAggregatorClass *) klass;
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "ssim", 0, "SSIM calculator");
+
+  gobject_class->set_property = gst_ssim_set_property;
+  gobject_class->get_property = gst_ssim_get_property;
+  gobject_class->finalize = gst_ssim_finalize;
+
+  agg_class->start = GST_DEBUG_FUNCPTR (gst_ssim_start);
+  agg_class->stop = GST_DEBUG_FUNCPTR (gst_ssim_stop);
+
+  videoaggregator_class->aggregate_frames =
+      GST_DEBUG_FUNCPTR (gst_ssim_aggregate_frames);
+  videoaggregator_class->get_output_buffer =
+      GST_DEBUG_FUNCPTR (gst_ssim_get_output_buffer);
+  videoaggregator_class->fixate_caps = GST_DEBUG_FUNCPTR (gst_ssim_fixate_caps);
+
+  g_object_class_install_property (gobject_class, PROP_METRICS,
+      g_param_spec_flags ("metrics", "Metrics",
+          "Metrics computed for each distorted stream", GST_TYPE_SSIM_METRICS,
+          DEFAULT_METRICS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads the metrics are computed on (0 = one per CPU)",
+          0, MAX_THREADS, DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_ssim_src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_ssim_sink_template));
+  gst_element_class_set_static_metadata (gstelement_class, "SSim",
+      "Filter/Analyzer/Video",
+      "Measure the SSIM, PSNR and MS-SSIM of video streams against a "
+      "reference", "Руслан Ижбулатов <lrn1986 _at_ gmail _dot_ com>");
+}
+
+static void
+gst_ssim_init (GstSSim * ssim)
+{
+  g_mutex_init (&ssim->job_lock);
+  g_cond_init (&ssim->job_cond);
+
+  ssim->metrics = DEFAULT_METRICS;
+  ssim->threads = DEFAULT_THREADS;
 }
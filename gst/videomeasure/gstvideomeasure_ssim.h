@@ -21,20 +21,12 @@
 #define __GST_SSIM_H__
 
 #include <gst/gst.h>
-#include <gst/base/gstcollectpads.h>
 #include <gst/video/video.h>
+#include <gst/video/gstvideoaggregator.h>
 
-G_BEGIN_DECLS
-
-enum
-{
-  PROP_0,
-  PROP_SSIM_TYPE,
-  PROP_WINDOW_TYPE,
-  PROP_WINDOW_SIZE,
-  PROP_GAUSS_SIGMA,
-};
+#include "gstvideomeasure_metrics.h"
 
+G_BEGIN_DECLS
 
 #define GST_TYPE_SSIM            (gst_ssim_get_type())
 #define GST_SSIM(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),            \
@@ -48,28 +40,46 @@ enum
 #define GST_SSIM_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj) ,            \
     GST_TYPE_SSIM,GstSSimClass))
 
+#define GST_TYPE_SSIM_METRICS    (gst_ssim_metrics_get_type())
+
 typedef struct _GstSSim             GstSSim;
 typedef struct _GstSSimClass        GstSSimClass;
+typedef struct _GstSSimJob          GstSSimJob;
+
+/**
+ * GstSSimMetrics:
+ * @GST_SSIM_METRIC_SSIM: mean, lowest and highest SSIM of the windows
+ * @GST_SSIM_METRIC_PSNR: PSNR of the luma plane
+ * @GST_SSIM_METRIC_MS_SSIM: multi-scale SSIM
+ *
+ * The metrics computed for each distorted stream.
+ */
+typedef enum {
+  GST_SSIM_METRIC_SSIM = (1 << 0),
+  GST_SSIM_METRIC_PSNR = (1 << 1),
+  GST_SSIM_METRIC_MS_SSIM = (1 << 2)
+} GstSSimMetrics;
+
+/* Measures a band of rows of one scale of a distorted stream, or halves a
+ * band of rows of a plane into dst for the next scale */
+struct _GstSSimJob {
+  void (*func) (GstSSimJob * job);
+
+  const guint8 *ref, *dist;
+  gint ref_stride, dist_stride;
+  gint width;
+
+  guint8 *dst;
+  gint dst_stride;
+
+  /* window rows for SSIM and pixel rows for PSNR, or the rows of dst */
+  gint win_start, win_end;
+  gint row_start, row_end;
+
+  /* gst_video_measure_scratch_size() bytes for the band */
+  gint32 *scratch;
 
-typedef struct _GstSSimWindowCache {
-  gint x_window_start;
-  gint x_weight_start;
-  gint x_window_end;
-  gint y_window_start;
-  gint y_weight_start;
-  gint y_window_end;
-  gfloat element_summ;
-} GstSSimWindowCache;
-
-typedef void (*GstSSimFunction) (GstSSim *ssim, guint8 *org, gfloat *orgmu,
-    guint8 *mod, guint8 *out, gfloat *mean, gfloat *lowest, gfloat *highest);
-
-typedef struct _GstSSimOutputContext GstSSimOutputContext;
-
-/* TODO: check if all fields are used */
-struct _GstSSimOutputContext {
-  GstPad       *pad;
-  gboolean      segment_pending;
+  GstVideoMeasureSums sums;
 };
 
 /**
@@ -78,62 +88,42 @@ struct _GstSSimOutputContext {
  * The ssim object structure.
  */
 struct _GstSSim {
-  GstElement      element;
-
-  /* Array of GstSSimOutputContext */
-  GPtrArray      *src;
-  
-  gint            padcount;
-
-  GstCollectPads *collect;
-  GstPad         *orig;
-
-  gint            frame_rate;
-  gint            frame_rate_base;
-  gint            width;
-  gint            height;
-  GstCaps        *sinkcaps;
-  GstCaps        *srccaps;
-
-  /* SSIM type (0 - canonical; 1 - without mu) */
-  gint            ssimtype;
-  
-  /* Size of a window, windows are square */
-  gint            windowsize;
-
-  /* Type of a weight-generator. 0 - no weighting. 1 - Gaussian weighting */
-  gint            windowtype;
-
-  /* Array of width*height GstSSimWindowCaches */
-  GstSSimWindowCache *windows;
-
-  /* Array of windowsize*windowsize gfloats */
-  gfloat         *weights;
-
-  /* For Gaussian function */
-  gfloat          sigma;
-  
-  GstSSimFunction func;
-
-  gfloat         const1;
-  gfloat         const2;
-
-  /* counters to keep track of timestamps */
-  gint64          timestamp;
-  gint64          offset;
-
-  /* sink event handling */
-  GstPadEventFunction  collect_event;
-  GstSegment      segment;
-  guint64         segment_position;
-  gdouble         segment_rate;
+  GstVideoAggregator videoaggregator;
+
+  /* frames measured since start */
+  guint64 offset;
+
+  /* the output format is not the reference one, so its frames are copied */
+  gboolean copy_reference;
+
+  /* workers measuring all jobs but those taken by the streaming thread */
+  GThreadPool *pool;
+  guint n_workers;
+  GMutex job_lock;
+  GCond job_cond;
+  guint n_pending;
+  volatile gint next_job;
+
+  GstSSimJob *jobs;
+  guint n_jobs;
+  guint jobs_size;
+  gsize scratch_size;
+
+  /* downscaled luma planes for MS-SSIM */
+  guint8 *pyramid;
+  gsize pyramid_size;
+
+  /* properties */
+  GstSSimMetrics metrics;
+  guint threads;
 };
 
 struct _GstSSimClass {
-  GstElementClass parent_class;
+  GstVideoAggregatorClass parent_class;
 };
 
 GType    gst_ssim_get_type (void);
+GType    gst_ssim_metrics_get_type (void);
 
 G_END_DECLS
 
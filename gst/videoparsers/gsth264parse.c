@@ -30,6 +30,7 @@
 #include <gst/pbutils/pbutils.h>
 #include <gst/video/video.h>
 #include "gsth264parse.h"
+#include "gstvideoparseutils.h"
 
 #include <string.h>
 
@@ -37,11 +38,14 @@ GST_DEBUG_CATEGORY (h264_parse_debug);
 #define GST_CAT_DEFAULT h264_parse_debug
 
 #define DEFAULT_CONFIG_INTERVAL      (0)
+#define DEFAULT_FAST_SCAN            FALSE
 
 enum
 {
   PROP_0,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_FAST_SCAN,
+  PROP_REUSED_HEADERS
 };
 
 enum
@@ -136,6 +140,19 @@ gst_h264_parse_class_init (GstH264ParseClass * klass)
           0, 3600, DEFAULT_CONFIG_INTERVAL,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_FAST_SCAN,
+      g_param_spec_boolean ("fast-scan", "Fast scan",
+          "Only fully parse IDR slices and parameter sets, other slices are "
+          "framed from their NAL header and slice type (for indexing)",
+          DEFAULT_FAST_SCAN,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_REUSED_HEADERS,
+      g_param_spec_uint64 ("reused-headers", "Reused headers",
+          "Number of in-band SPS/PPS that were identical to a stored one and "
+          "were not parsed again", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   /* Override BaseParse vfuncs */
   parse_class->start = GST_DEBUG_FUNCPTR (gst_h264_parse_start);
   parse_class->stop = GST_DEBUG_FUNCPTR (gst_h264_parse_stop);
@@ -233,6 +250,8 @@ gst_h264_parse_reset_stream_info (GstH264Parse * h264parse)
     gst_buffer_replace (&h264parse->sps_nals[i], NULL);
   for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++)
     gst_buffer_replace (&h264parse->pps_nals[i], NULL);
+  memset (h264parse->sps_hashes, 0, sizeof (h264parse->sps_hashes));
+  memset (h264parse->pps_hashes, 0, sizeof (h264parse->pps_hashes));
 }
 
 static void
@@ -441,20 +460,61 @@ gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
   return buf;
 }
 
+static const guint8 h264_start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+/* like wrap_nal, but only allocates the start code or length prefix and
+ * shares the NAL payload memory of @src */
+static GstBuffer *
+gst_h264_parse_wrap_nal_buffer (GstH264Parse * h264parse, guint format,
+    GstBuffer * src, guint offset, guint size)
+{
+  GstBuffer *buf;
+  GstMemory *prefix;
+  guint nl = h264parse->nal_length_size;
+
+  GST_DEBUG_OBJECT (h264parse, "nal length %d", size);
+
+  if (format == GST_H264_PARSE_FORMAT_AVC
+      || format == GST_H264_PARSE_FORMAT_AVC3) {
+    GstMapInfo map;
+    guint32 tmp;
+
+    tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
+    prefix = gst_allocator_alloc (NULL, nl, NULL);
+    gst_memory_map (prefix, &map, GST_MAP_WRITE);
+    memcpy (map.data, &tmp, nl);
+    gst_memory_unmap (prefix, &map);
+  } else {
+    /* byte-stream SC is always 4 bytes, see above */
+    prefix = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (gpointer) h264_start_code, sizeof (h264_start_code), 0,
+        sizeof (h264_start_code), NULL, NULL);
+  }
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf, prefix);
+  gst_buffer_copy_into (buf, src, GST_BUFFER_COPY_MEMORY, offset, size);
+
+  return buf;
+}
+
 static void
 gst_h264_parser_store_nal (GstH264Parse * h264parse, guint id,
     GstH264NalUnitType naltype, GstH264NalUnit * nalu)
 {
   GstBuffer *buf, **store;
+  guint32 *hashes;
   guint size = nalu->size, store_size;
 
   if (naltype == GST_H264_NAL_SPS || naltype == GST_H264_NAL_SUBSET_SPS) {
     store_size = GST_H264_MAX_SPS_COUNT;
     store = h264parse->sps_nals;
+    hashes = h264parse->sps_hashes;
     GST_DEBUG_OBJECT (h264parse, "storing sps %u", id);
   } else if (naltype == GST_H264_NAL_PPS) {
     store_size = GST_H264_MAX_PPS_COUNT;
     store = h264parse->pps_nals;
+    hashes = h264parse->pps_hashes;
     GST_DEBUG_OBJECT (h264parse, "storing pps %u", id);
   } else
     return;
@@ -475,6 +535,97 @@ gst_h264_parser_store_nal (GstH264Parse * h264parse, guint id,
     gst_buffer_unref (store[id]);
 
   store[id] = buf;
+  hashes[id] =
+      gst_video_parse_utils_hash_nal (nalu->data + nalu->offset, size);
+}
+
+/* Returns the id of the stored SPS or PPS that is byte-identical to @nalu,
+ * or -1. The hash rules out nearly all candidates without a memcmp. */
+static gint
+gst_h264_parse_find_stored_nal (GstH264Parse * h264parse,
+    GstH264NalUnit * nalu)
+{
+  GstBuffer **store;
+  guint32 *hashes, hash;
+  guint i, store_size;
+
+  if (nalu->type == GST_H264_NAL_SPS) {
+    store_size = GST_H264_MAX_SPS_COUNT;
+    store = h264parse->sps_nals;
+    hashes = h264parse->sps_hashes;
+  } else {
+    store_size = GST_H264_MAX_PPS_COUNT;
+    store = h264parse->pps_nals;
+    hashes = h264parse->pps_hashes;
+  }
+
+  hash =
+      gst_video_parse_utils_hash_nal (nalu->data + nalu->offset, nalu->size);
+  for (i = 0; i < store_size; i++) {
+    if (hashes[i] == hash && store[i] &&
+        gst_buffer_get_size (store[i]) == nalu->size &&
+        gst_buffer_memcmp (store[i], 0, nalu->data + nalu->offset,
+            nalu->size) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+/* Handles an in-band SPS or PPS that repeats a stored one. The parsed copy
+ * held by the NAL parser is still valid, so only the parse state is updated.
+ * A caps check is only triggered if the repeat makes a different SPS or PPS
+ * the active one. */
+static gboolean
+gst_h264_parse_reuse_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
+{
+  GstH264NalParser *nalparser = h264parse->nalparser;
+  gint id;
+
+  if (nalu->type == GST_H264_NAL_PPS &&
+      !GST_H264_PARSE_STATE_VALID (h264parse, GST_H264_PARSE_STATE_GOT_SPS))
+    return FALSE;
+
+  id = gst_h264_parse_find_stored_nal (h264parse, nalu);
+  if (id < 0)
+    return FALSE;
+
+  if (nalu->type == GST_H264_NAL_SPS) {
+    if (!nalparser->sps[id].valid)
+      return FALSE;
+    GST_DEBUG_OBJECT (h264parse, "SPS %d repeated, not parsing again", id);
+    if (nalparser->last_sps != &nalparser->sps[id]) {
+      GST_DEBUG_OBJECT (h264parse, "switching SPS, triggering src caps check");
+      h264parse->update_caps = TRUE;
+    }
+    nalparser->last_sps = &nalparser->sps[id];
+    h264parse->state = GST_H264_PARSE_STATE_GOT_SPS;
+    h264parse->have_sps = TRUE;
+  } else {
+    if (!nalparser->pps[id].valid)
+      return FALSE;
+    GST_DEBUG_OBJECT (h264parse, "PPS %d repeated, not parsing again", id);
+    if (nalparser->last_pps != &nalparser->pps[id]) {
+      GST_DEBUG_OBJECT (h264parse, "switching PPS, triggering src caps check");
+      h264parse->update_caps = TRUE;
+    }
+    nalparser->last_pps = &nalparser->pps[id];
+    h264parse->state &= GST_H264_PARSE_STATE_GOT_SPS;
+    h264parse->state |= GST_H264_PARSE_STATE_GOT_PPS;
+    h264parse->have_pps = TRUE;
+  }
+
+  if (h264parse->push_codec && h264parse->have_sps && h264parse->have_pps) {
+    GST_INFO_OBJECT (h264parse, "have SPS/PPS in stream");
+    h264parse->push_codec = FALSE;
+    h264parse->have_sps = FALSE;
+    h264parse->have_pps = FALSE;
+  }
+
+  h264parse->header |= TRUE;
+  h264parse->reused_headers++;
+
+  return TRUE;
 }
 
 #ifndef GST_DISABLE_GST_DEBUG
@@ -693,6 +844,69 @@ gst_h264_parse_process_sei (GstH264Parse * h264parse, GstH264NalUnit * nalu)
   g_array_free (messages, TRUE);
 }
 
+/* fast-scan handling of a non-IDR slice: the header is only read up to
+ * pic_parameter_set_id, which is all that framing and keyframe detection
+ * need. Returns FALSE if the full slice header still has to be parsed,
+ * i.e. if the stream may contain field pictures (field_pic_flag feeds the
+ * timestamp interpolation) */
+static gboolean
+gst_h264_parse_scan_slice (GstH264Parse * h264parse, GstH264NalUnit * nalu)
+{
+  const GstH264PPS *pps;
+  const GstH264SPS *sps;
+  guint8 header[GST_VIDEO_PARSE_UTILS_SLICE_HEADER_SIZE];
+  GstBitReader br;
+  guint32 first_mb, slice_type, pps_id;
+
+  gst_video_parse_utils_init_rbsp_reader (&br, header, sizeof (header),
+      nalu->data + nalu->offset + nalu->header_bytes,
+      nalu->size - nalu->header_bytes);
+  if (!gst_video_parse_utils_get_ue (&br, &first_mb) ||
+      !gst_video_parse_utils_get_ue (&br, &slice_type) || slice_type > 9 ||
+      !gst_video_parse_utils_get_ue (&br, &pps_id) ||
+      pps_id >= GST_H264_MAX_PPS_COUNT)
+    return FALSE;
+
+  /* the SPS of the slice is the one its PPS refers to, which is not
+   * necessarily the last one received */
+  pps = &h264parse->nalparser->pps[pps_id];
+  sps = pps->sequence;
+  if (!pps->valid || !sps || !sps->valid || !sps->frame_mbs_only_flag)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (h264parse, "first MB: %u, slice type: %u, PPS: %u",
+      first_mb, slice_type, pps_id);
+  slice_type %= 5;
+  if (slice_type == GST_H264_I_SLICE || slice_type == GST_H264_SI_SLICE)
+    h264parse->keyframe |= TRUE;
+
+  h264parse->state |= GST_H264_PARSE_STATE_GOT_SLICE;
+  h264parse->field_pic_flag = 0;
+
+  return TRUE;
+}
+
+/* in fast-scan mode SEI is only parsed if it can affect the timestamps,
+ * that is when we interpolate them and the SPS signals picture timing or
+ * buffering period messages. That's the last SPS received, as it's the one
+ * gst_h264_parser_parse_sei() reads the messages with */
+static gboolean
+gst_h264_parse_sei_needed (GstH264Parse * h264parse)
+{
+  const GstH264SPS *sps = h264parse->nalparser->last_sps;
+  const GstH264VUIParams *vui;
+
+  if (!h264parse->do_ts || !sps || !sps->valid)
+    return FALSE;
+  if (!sps->vui_parameters_present_flag)
+    return FALSE;
+
+  vui = &sps->vui_parameters;
+  return vui->timing_info_present_flag && (vui->pic_struct_present_flag ||
+      vui->nal_hrd_parameters_present_flag ||
+      vui->vcl_hrd_parameters_present_flag);
+}
+
 /* caller guarantees 2 bytes of nal payload */
 static gboolean
 gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
@@ -723,6 +937,8 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       goto process_sps;
 
     case GST_H264_NAL_SPS:
+      if (gst_h264_parse_reuse_nal (h264parse, nalu))
+        break;
       /* reset state, everything else is obsolete */
       h264parse->state = 0;
       pres = gst_h264_parser_parse_sps (nalparser, nalu, &sps, TRUE);
@@ -736,6 +952,8 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
 
       GST_DEBUG_OBJECT (h264parse, "triggering src caps check");
       h264parse->update_caps = TRUE;
+      /* stored PPS may have been parsed against the previous SPS */
+      memset (h264parse->pps_hashes, 0, sizeof (h264parse->pps_hashes));
       h264parse->have_sps = TRUE;
       if (h264parse->push_codec && h264parse->have_pps) {
         /* SPS and PPS found in stream before the first pre_push_frame, no need
@@ -752,6 +970,8 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       h264parse->header |= TRUE;
       break;
     case GST_H264_NAL_PPS:
+      if (gst_h264_parse_reuse_nal (h264parse, nalu))
+        break;
       /* expected state: got-sps */
       h264parse->state &= GST_H264_PARSE_STATE_GOT_SPS;
       if (!GST_H264_PARSE_STATE_VALID (h264parse, GST_H264_PARSE_STATE_GOT_SPS))
@@ -791,7 +1011,8 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
         return FALSE;
 
       h264parse->header |= TRUE;
-      gst_h264_parse_process_sei (h264parse, nalu);
+      if (!h264parse->fast_scan || gst_h264_parse_sei_needed (h264parse))
+        gst_h264_parse_process_sei (h264parse, nalu);
       /* mark SEI pos */
       if (h264parse->sei_pos == -1) {
         if (h264parse->transform)
@@ -825,7 +1046,10 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       GST_DEBUG_OBJECT (h264parse, "frame start: %i", h264parse->frame_start);
       if (nal_type == GST_H264_NAL_SLICE_EXT && !GST_H264_IS_MVC_NALU (nalu))
         break;
-      {
+      if (h264parse->fast_scan && nal_type != GST_H264_NAL_SLICE_IDR &&
+          gst_h264_parse_scan_slice (h264parse, nalu)) {
+        GST_LOG_OBJECT (h264parse, "fast scan, skipped slice header");
+      } else {
         GstH264SliceHdr slice;
 
         pres = gst_h264_parser_parse_slice_hdr (nalparser, nalu, &slice,
@@ -887,8 +1111,12 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
     GstBuffer *buf;
 
     GST_LOG_OBJECT (h264parse, "collecting NAL in AVC frame");
-    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-        nalu->data + nalu->offset, nalu->size);
+    if (h264parse->nal_buffer)
+      buf = gst_h264_parse_wrap_nal_buffer (h264parse, h264parse->format,
+          h264parse->nal_buffer, nalu->offset, nalu->size);
+    else
+      buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
+          nalu->data + nalu->offset, nalu->size);
     gst_adapter_push (h264parse->frame_out, buf);
   }
   return TRUE;
@@ -974,6 +1202,9 @@ gst_h264_parse_handle_frame_packetized (GstBaseParse * parse,
   GST_LOG_OBJECT (h264parse,
       "processing packet buffer of size %" G_GSIZE_FORMAT, map.size);
 
+  /* let transformed output reference the NAL payloads in place */
+  h264parse->nal_buffer = buffer;
+
   parse_res = gst_h264_parser_identify_nalu_avc (h264parse->nalparser,
       map.data, 0, map.size, nl, &nalu);
 
@@ -1007,6 +1238,7 @@ gst_h264_parse_handle_frame_packetized (GstBaseParse * parse,
         map.data, nalu.offset + nalu.size, map.size, nl, &nalu);
   }
 
+  h264parse->nal_buffer = NULL;
   gst_buffer_unmap (buffer, &map);
 
   if (!h264parse->split_packetized) {
@@ -1049,7 +1281,7 @@ gst_h264_parse_handle_frame (GstBaseParse * parse,
   guint8 *data;
   gsize size;
   gint current_off = 0;
-  gboolean drain, nonext;
+  gboolean drain, nonext, processed;
   GstH264NalParser *nalparser = h264parse->nalparser;
   GstH264NalUnit nalu;
   GstH264ParserResult pres;
@@ -1199,7 +1431,10 @@ gst_h264_parse_handle_frame (GstBaseParse * parse,
       }
     }
 
-    if (!gst_h264_parse_process_nal (h264parse, &nalu)) {
+    h264parse->nal_buffer = buffer;
+    processed = gst_h264_parse_process_nal (h264parse, &nalu);
+    h264parse->nal_buffer = NULL;
+    if (!processed) {
       GST_WARNING_OBJECT (h264parse,
           "broken/invalid nal Type: %d %s, Size: %u will be dropped",
           nalu.type, _nal_name (nalu.type), nalu.size);
@@ -2076,7 +2311,7 @@ gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h264parse->frame_out, av);
+    buf = gst_adapter_take_buffer_fast (h264parse->frame_out, av);
     gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     gst_buffer_replace (&frame->out_buffer, buf);
     gst_buffer_unref (buf);
@@ -2091,12 +2326,8 @@ static GstFlowReturn
 gst_h264_parse_push_codec_buffer (GstH264Parse * h264parse,
     GstBuffer * nal, GstClockTime ts)
 {
-  GstMapInfo map;
-
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  nal = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-      map.data, map.size);
-  gst_buffer_unmap (nal, &map);
+  nal = gst_h264_parse_wrap_nal_buffer (h264parse, h264parse->format,
+      nal, 0, gst_buffer_get_size (nal));
 
   GST_BUFFER_TIMESTAMP (nal) = ts;
   GST_BUFFER_DURATION (nal) = 0;
@@ -2233,7 +2464,8 @@ gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     h264parse->sent_codec_tag = TRUE;
   }
 
-  buffer = frame->buffer;
+  /* idr_pos refers to the transformed output, if there is one */
+  buffer = frame->out_buffer ? frame->out_buffer : frame->buffer;
 
   if ((event = check_pending_key_unit_event (h264parse->force_key_unit_event,
               &parse->segment, GST_BUFFER_TIMESTAMP (buffer),
@@ -2299,54 +2531,37 @@ gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
             }
           }
         } else {
-          /* insert config NALs into AU */
-          GstByteWriter bw;
+          /* insert config NALs into AU, sharing the AU memory */
           GstBuffer *new_buf;
-          const gboolean bs = h264parse->format == GST_H264_PARSE_FORMAT_BYTE;
-          const gint nls = 4 - h264parse->nal_length_size;
-          gboolean ok;
+          GstBuffer *nal_buf;
 
-          gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer),
-              FALSE);
-          ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h264parse->idr_pos);
+          new_buf = gst_buffer_new ();
+          if (h264parse->idr_pos > 0)
+            gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_MEMORY, 0,
+                h264parse->idr_pos);
           GST_DEBUG_OBJECT (h264parse, "- inserting SPS/PPS");
           for (i = 0; i < GST_H264_MAX_SPS_COUNT; i++) {
             if ((codec_nal = h264parse->sps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h264parse, "inserting SPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              nal_buf = gst_h264_parse_wrap_nal_buffer (h264parse,
+                  h264parse->format, codec_nal, 0,
+                  gst_buffer_get_size (codec_nal));
+              new_buf = gst_buffer_append (new_buf, nal_buf);
               h264parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++) {
             if ((codec_nal = h264parse->pps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h264parse, "inserting PPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              nal_buf = gst_h264_parse_wrap_nal_buffer (h264parse,
+                  h264parse->format, codec_nal, 0,
+                  gst_buffer_get_size (codec_nal));
+              new_buf = gst_buffer_append (new_buf, nal_buf);
               h264parse->last_report = new_ts;
             }
           }
-          ok &=
-              gst_byte_writer_put_buffer (&bw, buffer, h264parse->idr_pos, -1);
-          /* collect result and push */
-          new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
+          new_buf = gst_buffer_append_region (new_buf, gst_buffer_ref (buffer),
+              h264parse->idr_pos, -1);
           gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0,
               -1);
           /* should already be keyframe/IDR, but it may not have been,
@@ -2354,10 +2569,6 @@ gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
           GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
           gst_buffer_replace (&frame->out_buffer, new_buf);
           gst_buffer_unref (new_buf);
-          /* some result checking seems to make some compilers happy */
-          if (G_UNLIKELY (!ok)) {
-            GST_ERROR_OBJECT (h264parse, "failed to insert SPS/PPS");
-          }
         }
       }
       /* we pushed whatever we had */
@@ -2798,6 +3009,9 @@ gst_h264_parse_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       parse->interval = g_value_get_uint (value);
       break;
+    case PROP_FAST_SCAN:
+      parse->fast_scan = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2816,6 +3030,12 @@ gst_h264_parse_get_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       g_value_set_uint (value, parse->interval);
       break;
+    case PROP_FAST_SCAN:
+      g_value_set_boolean (value, parse->fast_scan);
+      break;
+    case PROP_REUSED_HEADERS:
+      g_value_set_uint64 (value, parse->reused_headers);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -89,6 +89,11 @@ struct _GstH264Parse
   /* collected SPS and PPS NALUs */
   GstBuffer *sps_nals[GST_H264_MAX_SPS_COUNT];
   GstBuffer *pps_nals[GST_H264_MAX_PPS_COUNT];
+  /* and their hashes, to spot in-band repeats before parsing them */
+  guint32 sps_hashes[GST_H264_MAX_SPS_COUNT];
+  guint32 pps_hashes[GST_H264_MAX_PPS_COUNT];
+  /* number of repeats that were not parsed again */
+  guint64 reused_headers;
 
   /* Infos we need to keep track of */
   guint32 sei_cpb_removal_delay;
@@ -111,6 +116,9 @@ struct _GstH264Parse
   gint idr_pos, sei_pos;
   gboolean update_caps;
   GstAdapter *frame_out;
+  /* buffer the NALs handed to process_nal are mapped from, if any;
+   * transformed output shares its memory instead of copying it */
+  GstBuffer *nal_buffer;
   gboolean keyframe;
   gboolean header;
   gboolean frame_start;
@@ -119,6 +127,7 @@ struct _GstH264Parse
 
   /* props */
   guint interval;
+  gboolean fast_scan;
 
   GstClockTime pending_key_unit_ts;
   GstEvent *force_key_unit_event;
@@ -26,6 +26,7 @@
 #include <gst/pbutils/pbutils.h>
 #include <gst/video/video.h>
 #include "gsth265parse.h"
+#include "gstvideoparseutils.h"
 
 #include <string.h>
 
@@ -33,11 +34,14 @@ GST_DEBUG_CATEGORY (h265_parse_debug);
 #define GST_CAT_DEFAULT h265_parse_debug
 
 #define DEFAULT_CONFIG_INTERVAL      (0)
+#define DEFAULT_FAST_SCAN            FALSE
 
 enum
 {
   PROP_0,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_FAST_SCAN,
+  PROP_REUSED_HEADERS
 };
 
 enum
@@ -113,6 +117,17 @@ gst_h265_parse_class_init (GstH265ParseClass * klass)
           "will be multiplexed in the data stream when detected.) (0 = disabled)",
           0, 3600, DEFAULT_CONFIG_INTERVAL,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_FAST_SCAN,
+      g_param_spec_boolean ("fast-scan", "Fast scan",
+          "Only fully parse IRAP slices and parameter sets, other slices are "
+          "framed from their NAL header and slice type (for indexing)",
+          DEFAULT_FAST_SCAN,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_REUSED_HEADERS,
+      g_param_spec_uint64 ("reused-headers", "Reused headers",
+          "Number of in-band VPS/SPS/PPS that were identical to a stored one "
+          "and were not parsed again", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
   /* Override BaseParse vfuncs */
   parse_class->start = GST_DEBUG_FUNCPTR (gst_h265_parse_start);
   parse_class->stop = GST_DEBUG_FUNCPTR (gst_h265_parse_stop);
@@ -236,6 +251,9 @@ gst_h265_parse_stop (GstBaseParse * parse)
     gst_buffer_replace (&h265parse->sps_nals[i], NULL);
   for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++)
     gst_buffer_replace (&h265parse->pps_nals[i], NULL);
+  memset (h265parse->vps_hashes, 0, sizeof (h265parse->vps_hashes));
+  memset (h265parse->sps_hashes, 0, sizeof (h265parse->sps_hashes));
+  memset (h265parse->pps_hashes, 0, sizeof (h265parse->pps_hashes));
 
   gst_h265_parser_free (h265parse->nalparser);
 
@@ -391,24 +409,66 @@ gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
   return buf;
 }
 
+static const guint8 h265_start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+/* like wrap_nal, but only allocates the start code or length prefix and
+ * shares the NAL payload memory of @src */
+static GstBuffer *
+gst_h265_parse_wrap_nal_buffer (GstH265Parse * h265parse, guint format,
+    GstBuffer * src, guint offset, guint size)
+{
+  GstBuffer *buf;
+  GstMemory *prefix;
+  guint nl = h265parse->nal_length_size;
+
+  GST_DEBUG_OBJECT (h265parse, "nal length %d", size);
+
+  if (format == GST_H265_PARSE_FORMAT_HVC1
+      || format == GST_H265_PARSE_FORMAT_HEV1) {
+    GstMapInfo map;
+    guint32 tmp;
+
+    tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
+    prefix = gst_allocator_alloc (NULL, nl, NULL);
+    gst_memory_map (prefix, &map, GST_MAP_WRITE);
+    memcpy (map.data, &tmp, nl);
+    gst_memory_unmap (prefix, &map);
+  } else {
+    /* byte-stream SC is always 4 bytes, see above */
+    prefix = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (gpointer) h265_start_code, sizeof (h265_start_code), 0,
+        sizeof (h265_start_code), NULL, NULL);
+  }
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf, prefix);
+  gst_buffer_copy_into (buf, src, GST_BUFFER_COPY_MEMORY, offset, size);
+
+  return buf;
+}
+
 static void
 gst_h265_parser_store_nal (GstH265Parse * h265parse, guint id,
     GstH265NalUnitType naltype, GstH265NalUnit * nalu)
 {
   GstBuffer *buf, **store;
+  guint32 *hashes;
   guint size = nalu->size, store_size;
 
   if (naltype == GST_H265_NAL_VPS) {
     store_size = GST_H265_MAX_VPS_COUNT;
     store = h265parse->vps_nals;
+    hashes = h265parse->vps_hashes;
     GST_DEBUG_OBJECT (h265parse, "storing vps %u", id);
   } else if (naltype == GST_H265_NAL_SPS) {
     store_size = GST_H265_MAX_SPS_COUNT;
     store = h265parse->sps_nals;
+    hashes = h265parse->sps_hashes;
     GST_DEBUG_OBJECT (h265parse, "storing sps %u", id);
   } else if (naltype == GST_H265_NAL_PPS) {
     store_size = GST_H265_MAX_PPS_COUNT;
     store = h265parse->pps_nals;
+    hashes = h265parse->pps_hashes;
     GST_DEBUG_OBJECT (h265parse, "storing pps %u", id);
   } else
     return;
@@ -429,6 +489,109 @@ gst_h265_parser_store_nal (GstH265Parse * h265parse, guint id,
     gst_buffer_unref (store[id]);
 
   store[id] = buf;
+  hashes[id] =
+      gst_video_parse_utils_hash_nal (nalu->data + nalu->offset, size);
+}
+
+/* Returns the id of the stored VPS, SPS or PPS that is byte-identical to
+ * @nalu, or -1. The hash rules out nearly all candidates without a memcmp. */
+static gint
+gst_h265_parse_find_stored_nal (GstH265Parse * h265parse,
+    GstH265NalUnit * nalu)
+{
+  GstBuffer **store;
+  guint32 *hashes, hash;
+  guint i, store_size;
+
+  if (nalu->type == GST_H265_NAL_VPS) {
+    store_size = GST_H265_MAX_VPS_COUNT;
+    store = h265parse->vps_nals;
+    hashes = h265parse->vps_hashes;
+  } else if (nalu->type == GST_H265_NAL_SPS) {
+    store_size = GST_H265_MAX_SPS_COUNT;
+    store = h265parse->sps_nals;
+    hashes = h265parse->sps_hashes;
+  } else {
+    store_size = GST_H265_MAX_PPS_COUNT;
+    store = h265parse->pps_nals;
+    hashes = h265parse->pps_hashes;
+  }
+
+  hash =
+      gst_video_parse_utils_hash_nal (nalu->data + nalu->offset, nalu->size);
+  for (i = 0; i < store_size; i++) {
+    if (hashes[i] == hash && store[i] &&
+        gst_buffer_get_size (store[i]) == nalu->size &&
+        gst_buffer_memcmp (store[i], 0, nalu->data + nalu->offset,
+            nalu->size) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+/* Handles an in-band parameter set that repeats a stored one. The parsed
+ * copy held by the NAL parser is still valid, so it is not parsed again. A
+ * caps check is only triggered if the repeat makes a different parameter
+ * set the active one. */
+static gboolean
+gst_h265_parse_reuse_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
+{
+  GstH265Parser *nalparser = h265parse->nalparser;
+  gboolean switched = FALSE;
+  gint id;
+
+  id = gst_h265_parse_find_stored_nal (h265parse, nalu);
+  if (id < 0)
+    return FALSE;
+
+  switch (nalu->type) {
+    case GST_H265_NAL_VPS:
+      if (!nalparser->vps[id].valid)
+        return FALSE;
+      if (nalparser->last_vps != &nalparser->vps[id])
+        switched = TRUE;
+      nalparser->last_vps = &nalparser->vps[id];
+      h265parse->have_vps = TRUE;
+      break;
+    case GST_H265_NAL_SPS:
+      if (!nalparser->sps[id].valid)
+        return FALSE;
+      if (nalparser->last_sps != &nalparser->sps[id])
+        switched = TRUE;
+      nalparser->last_sps = &nalparser->sps[id];
+      h265parse->have_sps = TRUE;
+      break;
+    default:
+      if (!nalparser->pps[id].valid)
+        return FALSE;
+      if (nalparser->last_pps != &nalparser->pps[id])
+        switched = TRUE;
+      nalparser->last_pps = &nalparser->pps[id];
+      h265parse->have_pps = TRUE;
+      break;
+  }
+  GST_DEBUG_OBJECT (h265parse, "nal type %u id %d repeated, not parsing "
+      "again", nalu->type, id);
+
+  if (switched) {
+    GST_DEBUG_OBJECT (h265parse, "switching parameter set, triggering src "
+        "caps check");
+    h265parse->update_caps = TRUE;
+  }
+
+  if (h265parse->push_codec && h265parse->have_sps && h265parse->have_pps) {
+    GST_INFO_OBJECT (h265parse, "have VPS/SPS/PPS in stream");
+    h265parse->push_codec = FALSE;
+    h265parse->have_vps = FALSE;
+    h265parse->have_sps = FALSE;
+    h265parse->have_pps = FALSE;
+  }
+
+  h265parse->header |= TRUE;
+  h265parse->reused_headers++;
+
+  return TRUE;
 }
 
 #ifndef GST_DISABLE_GST_DEBUG
@@ -485,6 +648,56 @@ _nal_name (GstH265NalUnitType nal_type)
 }
 #endif
 
+/* fast-scan handling of a non-IRAP slice segment: the header is only read
+ * up to slice_type, which is all keyframe detection needs. Returns FALSE
+ * if the full slice header has to be parsed after all */
+static gboolean
+gst_h265_parse_scan_slice (GstH265Parse * h265parse, GstH265NalUnit * nalu)
+{
+  const GstH265PPS *pps;
+  guint8 header[GST_VIDEO_PARSE_UTILS_SLICE_HEADER_SIZE];
+  GstBitReader br;
+  guint8 first_slice_segment, dependent = 0;
+  guint32 pps_id, slice_type;
+
+  gst_video_parse_utils_init_rbsp_reader (&br, header, sizeof (header),
+      nalu->data + nalu->offset + nalu->header_bytes,
+      nalu->size - nalu->header_bytes);
+  if (!gst_bit_reader_get_bits_uint8 (&br, &first_slice_segment, 1) ||
+      !gst_video_parse_utils_get_ue (&br, &pps_id) ||
+      pps_id >= GST_H265_MAX_PPS_COUNT)
+    return FALSE;
+
+  pps = &h265parse->nalparser->pps[pps_id];
+  if (!pps->valid || !pps->sps)
+    return FALSE;
+
+  if (!first_slice_segment) {
+    guint32 size_in_ctbs = pps->PicWidthInCtbsY * pps->PicHeightInCtbsY;
+    guint address_bits = size_in_ctbs > 1 ? g_bit_storage (size_in_ctbs - 1)
+        : 0;
+
+    if (pps->dependent_slice_segments_enabled_flag &&
+        !gst_bit_reader_get_bits_uint8 (&br, &dependent, 1))
+      return FALSE;
+    if (!gst_bit_reader_skip (&br, address_bits))
+      return FALSE;
+  }
+
+  if (!dependent) {
+    if (!gst_bit_reader_skip (&br, pps->num_extra_slice_header_bits) ||
+        !gst_video_parse_utils_get_ue (&br, &slice_type))
+      return FALSE;
+
+    GST_DEBUG_OBJECT (h265parse, "first slice segment: %u, slice type: %u",
+        first_slice_segment, slice_type);
+    if (slice_type == GST_H265_I_SLICE)
+      h265parse->keyframe |= TRUE;
+  }
+
+  return TRUE;
+}
+
 /* caller guarantees 2 bytes of nal payload */
 static void
 gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
@@ -510,6 +723,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       nal_type, _nal_name (nal_type), nalu->size);
   switch (nal_type) {
     case GST_H265_NAL_VPS:
+      if (gst_h265_parse_reuse_nal (h265parse, nalu))
+        break;
       /* It is not mandatory to have VPS in the stream. But it might
        * be needed for other extensions like svc */
       pres = gst_h265_parser_parse_vps (nalparser, nalu, &vps);
@@ -518,6 +733,9 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
 
       GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
       h265parse->update_caps = TRUE;
+      /* stored SPS/PPS may have been parsed against the previous VPS */
+      memset (h265parse->sps_hashes, 0, sizeof (h265parse->sps_hashes));
+      memset (h265parse->pps_hashes, 0, sizeof (h265parse->pps_hashes));
       h265parse->have_vps = TRUE;
       if (h265parse->push_codec && h265parse->have_pps) {
         /* VPS/SPS/PPS found in stream before the first pre_push_frame, no need
@@ -533,6 +751,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       h265parse->header |= TRUE;
       break;
     case GST_H265_NAL_SPS:
+      if (gst_h265_parse_reuse_nal (h265parse, nalu))
+        break;
       pres = gst_h265_parser_parse_sps (nalparser, nalu, &sps, TRUE);
 
 
@@ -542,6 +762,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
 
       GST_DEBUG_OBJECT (h265parse, "triggering src caps check");
       h265parse->update_caps = TRUE;
+      /* stored PPS may have been parsed against the previous SPS */
+      memset (h265parse->pps_hashes, 0, sizeof (h265parse->pps_hashes));
       h265parse->have_sps = TRUE;
       if (h265parse->push_codec && h265parse->have_pps) {
         /* SPS and PPS found in stream before the first pre_push_frame, no need
@@ -556,6 +778,8 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       h265parse->header |= TRUE;
       break;
     case GST_H265_NAL_PPS:
+      if (gst_h265_parse_reuse_nal (h265parse, nalu))
+        break;
       pres = gst_h265_parser_parse_pps (nalparser, nalu, &pps);
 
 
@@ -611,28 +835,31 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
     case GST_H265_NAL_SLICE_IDR_W_RADL:
     case GST_H265_NAL_SLICE_IDR_N_LP:
     case GST_H265_NAL_SLICE_CRA_NUT:
-    {
-      GstH265SliceHdr slice;
+      is_irap = ((nal_type >= GST_H265_NAL_SLICE_BLA_W_LP)
+          && (nal_type <= GST_H265_NAL_SLICE_CRA_NUT)) ? TRUE : FALSE;
+      if (h265parse->fast_scan && !is_irap &&
+          gst_h265_parse_scan_slice (h265parse, nalu)) {
+        GST_LOG_OBJECT (h265parse, "fast scan, skipped slice header");
+      } else {
+        GstH265SliceHdr slice;
 
-      pres = gst_h265_parser_parse_slice_hdr (nalparser, nalu, &slice);
+        pres = gst_h265_parser_parse_slice_hdr (nalparser, nalu, &slice);
 
-      if (pres == GST_H265_PARSER_OK) {
-        if (GST_H265_IS_I_SLICE (&slice))
-          h265parse->keyframe |= TRUE;
-      }
-      if (slice.first_slice_segment_in_pic_flag == 1)
-        GST_DEBUG_OBJECT (h265parse,
-            "frame start, first_slice_segment_in_pic_flag = 1");
+        if (pres == GST_H265_PARSER_OK) {
+          if (GST_H265_IS_I_SLICE (&slice))
+            h265parse->keyframe |= TRUE;
+        }
+        if (slice.first_slice_segment_in_pic_flag == 1)
+          GST_DEBUG_OBJECT (h265parse,
+              "frame start, first_slice_segment_in_pic_flag = 1");
 
-      GST_DEBUG_OBJECT (h265parse,
-          "parse result %d, first slice_segment: %u, slice type: %u",
-          pres, slice.first_slice_segment_in_pic_flag, slice.type);
+        GST_DEBUG_OBJECT (h265parse,
+            "parse result %d, first slice_segment: %u, slice type: %u",
+            pres, slice.first_slice_segment_in_pic_flag, slice.type);
 
-      gst_h265_slice_hdr_free (&slice);
-    }
+        gst_h265_slice_hdr_free (&slice);
+      }
 
-      is_irap = ((nal_type >= GST_H265_NAL_SLICE_BLA_W_LP)
-          && (nal_type <= GST_H265_NAL_SLICE_CRA_NUT)) ? TRUE : FALSE;
       if (G_LIKELY (!is_irap && !h265parse->push_codec))
         break;
 
@@ -666,8 +893,12 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
     GstBuffer *buf;
 
     GST_LOG_OBJECT (h265parse, "collecting NAL in HEVC frame");
-    buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-        nalu->data + nalu->offset, nalu->size);
+    if (h265parse->nal_buffer)
+      buf = gst_h265_parse_wrap_nal_buffer (h265parse, h265parse->format,
+          h265parse->nal_buffer, nalu->offset, nalu->size);
+    else
+      buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
+          nalu->data + nalu->offset, nalu->size);
     gst_adapter_push (h265parse->frame_out, buf);
   }
 }
@@ -751,6 +982,9 @@ gst_h265_parse_handle_frame_packetized (GstBaseParse * parse,
   GST_LOG_OBJECT (h265parse,
       "processing packet buffer of size %" G_GSIZE_FORMAT, map.size);
 
+  /* let transformed output reference the NAL payloads in place */
+  h265parse->nal_buffer = buffer;
+
   parse_res = gst_h265_parser_identify_nalu_hevc (h265parse->nalparser,
       map.data, 0, map.size, nl, &nalu);
 
@@ -775,6 +1009,7 @@ gst_h265_parse_handle_frame_packetized (GstBaseParse * parse,
         map.data, nalu.offset + nalu.size, map.size, nl, &nalu);
   }
 
+  h265parse->nal_buffer = NULL;
   gst_buffer_unmap (buffer, &map);
 
   if (!h265parse->split_packetized) {
@@ -965,7 +1200,9 @@ gst_h265_parse_handle_frame (GstBaseParse * parse,
         nalu.type == GST_H265_NAL_SPS ||
         nalu.type == GST_H265_NAL_PPS ||
         (h265parse->have_sps && h265parse->have_pps)) {
+      h265parse->nal_buffer = buffer;
       gst_h265_parse_process_nal (h265parse, &nalu);
+      h265parse->nal_buffer = NULL;
     } else {
       GST_WARNING_OBJECT (h265parse,
           "no SPS/PPS yet, nal Type: %d %s, Size: %u will be dropped",
@@ -1642,7 +1879,7 @@ gst_h265_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h265parse->frame_out, av);
+    buf = gst_adapter_take_buffer_fast (h265parse->frame_out, av);
     gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     gst_buffer_replace (&frame->out_buffer, buf);
     gst_buffer_unref (buf);
@@ -1657,12 +1894,8 @@ static GstFlowReturn
 gst_h265_parse_push_codec_buffer (GstH265Parse * h265parse, GstBuffer * nal,
     GstClockTime ts)
 {
-  GstMapInfo map;
-
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  nal = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-      map.data, map.size);
-  gst_buffer_unmap (nal, &map);
+  nal = gst_h265_parse_wrap_nal_buffer (h265parse, h265parse->format,
+      nal, 0, gst_buffer_get_size (nal));
 
   GST_BUFFER_TIMESTAMP (nal) = ts;
   GST_BUFFER_DURATION (nal) = 0;
@@ -1805,7 +2038,8 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     h265parse->sent_codec_tag = TRUE;
   }
 
-  buffer = frame->buffer;
+  /* idr_pos refers to the transformed output, if there is one */
+  buffer = frame->out_buffer ? frame->out_buffer : frame->buffer;
 
   if ((event = check_pending_key_unit_event (h265parse->force_key_unit_event,
               &parse->segment, GST_BUFFER_TIMESTAMP (buffer),
@@ -1877,71 +2111,47 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
             }
           }
         } else {
-          /* insert config NALs into AU */
-          GstByteWriter bw;
+          /* insert config NALs into AU, sharing the AU memory */
           GstBuffer *new_buf;
-          const gboolean bs = h265parse->format == GST_H265_PARSE_FORMAT_BYTE;
-          const gint nls = 4 - h265parse->nal_length_size;
-          gboolean ok;
+          GstBuffer *nal_buf;
 
-          gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer),
-              FALSE);
-          ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h265parse->idr_pos);
+          new_buf = gst_buffer_new ();
+          if (h265parse->idr_pos > 0)
+            gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_MEMORY, 0,
+                h265parse->idr_pos);
           GST_DEBUG_OBJECT (h265parse, "- inserting VPS/SPS/PPS");
           for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++) {
             if ((codec_nal = h265parse->vps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting VPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              nal_buf = gst_h265_parse_wrap_nal_buffer (h265parse,
+                  h265parse->format, codec_nal, 0,
+                  gst_buffer_get_size (codec_nal));
+              new_buf = gst_buffer_append (new_buf, nal_buf);
               h265parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H265_MAX_SPS_COUNT; i++) {
             if ((codec_nal = h265parse->sps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting SPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              nal_buf = gst_h265_parse_wrap_nal_buffer (h265parse,
+                  h265parse->format, codec_nal, 0,
+                  gst_buffer_get_size (codec_nal));
+              new_buf = gst_buffer_append (new_buf, nal_buf);
               h265parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++) {
             if ((codec_nal = h265parse->pps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting PPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              nal_buf = gst_h265_parse_wrap_nal_buffer (h265parse,
+                  h265parse->format, codec_nal, 0,
+                  gst_buffer_get_size (codec_nal));
+              new_buf = gst_buffer_append (new_buf, nal_buf);
               h265parse->last_report = new_ts;
             }
           }
-          ok &=
-              gst_byte_writer_put_buffer (&bw, buffer, h265parse->idr_pos, -1);
-          /* collect result and push */
-          new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
+          new_buf = gst_buffer_append_region (new_buf, gst_buffer_ref (buffer),
+              h265parse->idr_pos, -1);
           gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0,
               -1);
           /* should already be keyframe/IDR, but it may not have been,
@@ -1949,10 +2159,6 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
           GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
           gst_buffer_replace (&frame->out_buffer, new_buf);
           gst_buffer_unref (new_buf);
-          /* some result checking seems to make some compilers happy */
-          if (G_UNLIKELY (!ok)) {
-            GST_ERROR_OBJECT (h265parse, "failed to insert SPS/PPS");
-          }
         }
       }
       /* we pushed whatever we had */
@@ -2277,6 +2483,9 @@ gst_h265_parse_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       parse->interval = g_value_get_uint (value);
       break;
+    case PROP_FAST_SCAN:
+      parse->fast_scan = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2294,6 +2503,12 @@ gst_h265_parse_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_CONFIG_INTERVAL:
       g_value_set_uint (value, parse->interval);
       break;
+    case PROP_FAST_SCAN:
+      g_value_set_boolean (value, parse->fast_scan);
+      break;
+    case PROP_REUSED_HEADERS:
+      g_value_set_uint64 (value, parse->reused_headers);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -77,11 +77,20 @@ struct _GstH265Parse
   GstBuffer *vps_nals[GST_H265_MAX_VPS_COUNT];
   GstBuffer *sps_nals[GST_H265_MAX_SPS_COUNT];
   GstBuffer *pps_nals[GST_H265_MAX_PPS_COUNT];
+  /* and their hashes, to spot in-band repeats before parsing them */
+  guint32 vps_hashes[GST_H265_MAX_VPS_COUNT];
+  guint32 sps_hashes[GST_H265_MAX_SPS_COUNT];
+  guint32 pps_hashes[GST_H265_MAX_PPS_COUNT];
+  /* number of repeats that were not parsed again */
+  guint64 reused_headers;
 
   /* frame parsing */
   gint idr_pos, sei_pos;
   gboolean update_caps;
   GstAdapter *frame_out;
+  /* buffer the NALs handed to process_nal are mapped from, if any;
+   * transformed output shares its memory instead of copying it */
+  GstBuffer *nal_buffer;
   gboolean keyframe;
   gboolean header;
   /* AU state */
@@ -89,6 +98,7 @@ struct _GstH265Parse
 
   /* props */
   guint interval;
+  gboolean fast_scan;
 
   gboolean sent_codec_tag;
 
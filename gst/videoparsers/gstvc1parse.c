@@ -184,10 +184,18 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
         "header-format=(string) {none, asf, sequence-layer}"));
 
 
+enum
+{
+  PROP_0,
+  PROP_REUSED_HEADERS
+};
+
 #define parent_class gst_vc1_parse_parent_class
 G_DEFINE_TYPE (GstVC1Parse, gst_vc1_parse, GST_TYPE_BASE_PARSE);
 
 static void gst_vc1_parse_finalize (GObject * object);
+static void gst_vc1_parse_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static gboolean gst_vc1_parse_start (GstBaseParse * parse);
 static gboolean gst_vc1_parse_stop (GstBaseParse * parse);
@@ -221,6 +229,13 @@ gst_vc1_parse_class_init (GstVC1ParseClass * klass)
   GST_DEBUG_CATEGORY_INIT (vc1_parse_debug, "vc1parse", 0, "vc1 parser");
 
   gobject_class->finalize = gst_vc1_parse_finalize;
+  gobject_class->get_property = gst_vc1_parse_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_REUSED_HEADERS,
+      g_param_spec_uint64 ("reused-headers", "Reused headers",
+          "Number of in-band sequence headers and entry points that were "
+          "identical to the stored one and were not parsed again",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&srctemplate));
@@ -263,6 +278,22 @@ gst_vc1_parse_finalize (GObject * object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_vc1_parse_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstVC1Parse *vc1parse = GST_VC1_PARSE (object);
+
+  switch (prop_id) {
+    case PROP_REUSED_HEADERS:
+      g_value_set_uint64 (value, vc1parse->reused_headers);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_vc1_parse_reset (GstVC1Parse * vc1parse)
 {
@@ -2048,6 +2079,25 @@ static const guint framerates_d[] = {
   1001
 };
 
+/* Sequence headers and entry points are usually repeated unchanged before
+ * every key frame, so compare with the stored copy before parsing */
+static gboolean
+gst_vc1_parse_is_stored_header (GstBuffer * stored, GstBuffer * buf,
+    guint offset, guint size)
+{
+  GstMapInfo minfo;
+  gboolean same;
+
+  if (!stored || gst_buffer_get_size (stored) != size)
+    return FALSE;
+
+  gst_buffer_map (buf, &minfo, GST_MAP_READ);
+  same = gst_buffer_memcmp (stored, 0, minfo.data + offset, size) == 0;
+  gst_buffer_unmap (buf, &minfo);
+
+  return same;
+}
+
 static gboolean
 gst_vc1_parse_handle_seq_hdr (GstVC1Parse * vc1parse,
     GstBuffer * buf, guint offset, guint size)
@@ -2057,6 +2107,14 @@ gst_vc1_parse_handle_seq_hdr (GstVC1Parse * vc1parse,
   GstMapInfo minfo;
 
   g_assert (gst_buffer_get_size (buf) >= offset + size);
+
+  if (gst_vc1_parse_is_stored_header (vc1parse->seq_hdr_buffer, buf, offset,
+          size)) {
+    GST_LOG_OBJECT (vc1parse, "sequence header repeated, not parsing again");
+    vc1parse->reused_headers++;
+    return TRUE;
+  }
+
   gst_buffer_replace (&vc1parse->seq_hdr_buffer, NULL);
   memset (&vc1parse->seq_hdr, 0, sizeof (vc1parse->seq_hdr));
 
@@ -2252,6 +2310,12 @@ gst_vc1_parse_handle_entrypoint (GstVC1Parse * vc1parse,
 {
   g_assert (gst_buffer_get_size (buf) >= offset + size);
 
+  if (gst_vc1_parse_is_stored_header (vc1parse->entrypoint_buffer, buf,
+          offset, size)) {
+    vc1parse->reused_headers++;
+    return TRUE;
+  }
+
   gst_buffer_replace (&vc1parse->entrypoint_buffer, NULL);
   vc1parse->entrypoint_buffer =
       gst_buffer_copy_region (buf, GST_BUFFER_COPY_ALL, offset, size);
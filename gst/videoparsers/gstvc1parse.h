@@ -99,6 +99,8 @@ struct _GstVC1Parse
   GstVC1SeqHdr seq_hdr;
   GstBuffer *seq_hdr_buffer;
   GstBuffer *entrypoint_buffer;
+  /* in-band headers identical to the stored ones, not parsed again */
+  guint64 reused_headers;
 
   GstVC1SeqLayer seq_layer;
   GstBuffer *seq_layer_buffer;
@@ -0,0 +1,88 @@
+/* GStreamer
+ * Helpers shared by the video parsers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstvideoparseutils.h"
+
+/* Hashes a stored parameter set NAL with FNV-1a. The result is never 0, so
+ * that a cleared hash slot matches nothing. */
+guint32
+gst_video_parse_utils_hash_nal (const guint8 * data, gsize size)
+{
+  guint32 hash = 2166136261U;
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * 16777619U;
+
+  return hash ? hash : 1;
+}
+
+/* Sets up @br to read the start of the NAL payload @data, copying at most
+ * @buf_size bytes of it to @buf without the emulation prevention bytes.
+ * Reads past what fits in @buf fail, as they would at the end of the
+ * payload. */
+void
+gst_video_parse_utils_init_rbsp_reader (GstBitReader * br, guint8 * buf,
+    guint buf_size, const guint8 * data, gsize size)
+{
+  guint n = 0, zeros = 0;
+  gsize i;
+
+  for (i = 0; i < size && n < buf_size; i++) {
+    if (zeros >= 2 && data[i] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+
+    zeros = data[i] == 0x00 ? zeros + 1 : 0;
+    buf[n++] = data[i];
+  }
+
+  gst_bit_reader_init (br, buf, n);
+}
+
+/* Reads an unsigned Exp-Golomb code */
+gboolean
+gst_video_parse_utils_get_ue (GstBitReader * br, guint32 * val)
+{
+  guint leading_zeros = 0;
+  guint8 bit;
+  guint32 value;
+
+  do {
+    if (!gst_bit_reader_get_bits_uint8 (br, &bit, 1))
+      return FALSE;
+    if (!bit)
+      leading_zeros++;
+  } while (!bit && leading_zeros < 32);
+
+  if (leading_zeros > 31)
+    return FALSE;
+
+  if (!gst_bit_reader_get_bits_uint32 (br, &value, leading_zeros))
+    return FALSE;
+
+  *val = (1U << leading_zeros) - 1 + value;
+
+  return TRUE;
+}
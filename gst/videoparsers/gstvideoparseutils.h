@@ -0,0 +1,40 @@
+/* GStreamer
+ * Helpers shared by the video parsers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VIDEO_PARSE_UTILS_H__
+#define __GST_VIDEO_PARSE_UTILS_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbitreader.h>
+
+G_BEGIN_DECLS
+
+/* enough for the start of a slice header up to the slice type */
+#define GST_VIDEO_PARSE_UTILS_SLICE_HEADER_SIZE 32
+
+guint32 gst_video_parse_utils_hash_nal (const guint8 * data, gsize size);
+
+void gst_video_parse_utils_init_rbsp_reader (GstBitReader * br,
+    guint8 * buf, guint buf_size, const guint8 * data, gsize size);
+
+gboolean gst_video_parse_utils_get_ue (GstBitReader * br, guint32 * val);
+
+G_END_DECLS
+
+#endif /* __GST_VIDEO_PARSE_UTILS_H__ */
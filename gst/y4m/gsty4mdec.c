@@ -41,6 +41,7 @@
 #include <string.h>
 
 #define MAX_SIZE 32768
+#define MAX_HEADER_LENGTH 80
 
 GST_DEBUG_CATEGORY (y4mdec_debug);
 #define GST_CAT_DEFAULT y4mdec_debug
@@ -57,6 +58,10 @@ static void gst_y4m_dec_finalize (GObject * object);
 
 static GstFlowReturn gst_y4m_dec_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
+static gboolean gst_y4m_dec_sink_activate (GstPad * pad, GstObject * parent);
+static gboolean gst_y4m_dec_sink_activatemode (GstPad * pad,
+    GstObject * parent, GstPadMode mode, gboolean active);
+static void gst_y4m_dec_loop (GstY4mDec * y4mdec);
 static gboolean gst_y4m_dec_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 
@@ -127,6 +132,10 @@ gst_y4m_dec_init (GstY4mDec * y4mdec)
       GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_event));
   gst_pad_set_chain_function (y4mdec->sinkpad,
       GST_DEBUG_FUNCPTR (gst_y4m_dec_chain));
+  gst_pad_set_activate_function (y4mdec->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_activate));
+  gst_pad_set_activatemode_function (y4mdec->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_activatemode));
   gst_element_add_pad (GST_ELEMENT (y4mdec), y4mdec->sinkpad);
 
   y4mdec->srcpad = gst_pad_new_from_static_template (&gst_y4m_dec_src_template,
@@ -481,15 +490,206 @@ error:
   return FALSE;
 }
 
+/* Turns the line at the start of @header into a NUL terminated string */
+static void
+gst_y4m_dec_terminate_line (char *header)
+{
+  int i;
+
+  header[MAX_HEADER_LENGTH - 1] = 0;
+  for (i = 0; i < MAX_HEADER_LENGTH; i++) {
+    if (header[i] == 0x0a)
+      header[i] = 0;
+  }
+}
+
+static gboolean
+gst_y4m_dec_negotiate (GstY4mDec * y4mdec)
+{
+  gboolean ret;
+  GstCaps *caps;
+  GstQuery *query;
+
+  caps = gst_video_info_to_caps (&y4mdec->info);
+  ret = gst_pad_set_caps (y4mdec->srcpad, caps);
+
+  query = gst_query_new_allocation (caps, FALSE);
+  y4mdec->video_meta = FALSE;
+
+  if (y4mdec->pool) {
+    gst_buffer_pool_set_active (y4mdec->pool, FALSE);
+    gst_object_unref (y4mdec->pool);
+  }
+  y4mdec->pool = NULL;
+
+  if (gst_pad_peer_query (y4mdec->srcpad, query)) {
+    y4mdec->video_meta =
+        gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+    /* We only need a pool if we need to do stride conversion for downstream */
+    if (!y4mdec->video_meta && memcmp (&y4mdec->info, &y4mdec->out_info,
+            sizeof (y4mdec->info)) != 0) {
+      GstBufferPool *pool = NULL;
+      GstAllocator *allocator = NULL;
+      GstAllocationParams params;
+      GstStructure *config;
+      guint size, min, max;
+
+      if (gst_query_get_n_allocation_params (query) > 0) {
+        gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+      } else {
+        allocator = NULL;
+        gst_allocation_params_init (&params);
+      }
+
+      if (gst_query_get_n_allocation_pools (query) > 0) {
+        gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min,
+            &max);
+        size = MAX (size, y4mdec->out_info.size);
+      } else {
+        pool = NULL;
+        size = y4mdec->out_info.size;
+        min = max = 0;
+      }
+
+      if (pool == NULL) {
+        pool = gst_video_buffer_pool_new ();
+      }
+
+      config = gst_buffer_pool_get_config (pool);
+      gst_buffer_pool_config_set_params (config, caps, size, min, max);
+      gst_buffer_pool_config_set_allocator (config, allocator, &params);
+      gst_buffer_pool_set_config (pool, config);
+
+      if (allocator)
+        gst_object_unref (allocator);
+
+      y4mdec->pool = pool;
+    }
+  } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
+          sizeof (y4mdec->info)) != 0) {
+    GstBufferPool *pool;
+    GstStructure *config;
+
+    /* No pool, create our own if we need to do stride conversion */
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, y4mdec->out_info.size, 0,
+        0);
+    gst_buffer_pool_set_config (pool, config);
+    y4mdec->pool = pool;
+  }
+  if (y4mdec->pool) {
+    gst_buffer_pool_set_active (y4mdec->pool, TRUE);
+  }
+  gst_query_unref (query);
+  gst_caps_unref (caps);
+  if (!ret) {
+    GST_DEBUG_OBJECT (y4mdec, "Couldn't set caps on src pad");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_y4m_dec_push_segment (GstY4mDec * y4mdec)
+{
+  GstEvent *event;
+  GstClockTime start = gst_y4m_dec_bytes_to_timestamp (y4mdec,
+      y4mdec->segment.start);
+  GstClockTime stop = gst_y4m_dec_bytes_to_timestamp (y4mdec,
+      y4mdec->segment.stop);
+  GstClockTime time = gst_y4m_dec_bytes_to_timestamp (y4mdec,
+      y4mdec->segment.time);
+  GstSegment seg;
+
+  gst_segment_init (&seg, GST_FORMAT_TIME);
+  seg.start = start;
+  seg.stop = stop;
+  seg.time = time;
+  event = gst_event_new_segment (&seg);
+
+  gst_pad_push_event (y4mdec->srcpad, event);
+
+  y4mdec->have_new_segment = FALSE;
+  y4mdec->frame_index = gst_y4m_dec_bytes_to_frames (y4mdec,
+      y4mdec->segment.time);
+  GST_DEBUG ("new frame_index %d", y4mdec->frame_index);
+}
+
+/* Timestamps and pushes the frame data in @buffer, converting the strides
+ * if downstream doesn't support video meta */
+static GstFlowReturn
+gst_y4m_dec_push_frame (GstY4mDec * y4mdec, GstBuffer * buffer)
+{
+  GstFlowReturn flow_ret;
+
+  GST_BUFFER_TIMESTAMP (buffer) =
+      gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index);
+  GST_BUFFER_DURATION (buffer) =
+      gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index + 1) -
+      GST_BUFFER_TIMESTAMP (buffer);
+
+  y4mdec->frame_index++;
+
+  if (y4mdec->video_meta) {
+    gst_buffer_add_video_meta_full (buffer, 0, y4mdec->info.finfo->format,
+        y4mdec->info.width, y4mdec->info.height, y4mdec->info.finfo->n_planes,
+        y4mdec->info.offset, y4mdec->info.stride);
+  } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
+          sizeof (y4mdec->info)) != 0) {
+    GstBuffer *outbuf;
+    GstVideoFrame iframe, oframe;
+    gint i, j;
+    gint w, h, istride, ostride;
+    guint8 *src, *dest;
+
+    /* Allocate a new buffer and do stride conversion */
+    g_assert (y4mdec->pool != NULL);
+
+    flow_ret = gst_buffer_pool_acquire_buffer (y4mdec->pool, &outbuf, NULL);
+    if (flow_ret != GST_FLOW_OK) {
+      gst_buffer_unref (buffer);
+      return flow_ret;
+    }
+
+    gst_video_frame_map (&iframe, &y4mdec->info, buffer, GST_MAP_READ);
+    gst_video_frame_map (&oframe, &y4mdec->out_info, outbuf, GST_MAP_WRITE);
+
+    for (i = 0; i < 3; i++) {
+      w = GST_VIDEO_FRAME_COMP_WIDTH (&iframe, i);
+      h = GST_VIDEO_FRAME_COMP_HEIGHT (&iframe, i);
+      istride = GST_VIDEO_FRAME_COMP_STRIDE (&iframe, i);
+      ostride = GST_VIDEO_FRAME_COMP_STRIDE (&oframe, i);
+      src = GST_VIDEO_FRAME_COMP_DATA (&iframe, i);
+      dest = GST_VIDEO_FRAME_COMP_DATA (&oframe, i);
+
+      for (j = 0; j < h; j++) {
+        memcpy (dest, src, w);
+
+        dest += ostride;
+        src += istride;
+      }
+    }
+
+    gst_video_frame_unmap (&iframe);
+    gst_video_frame_unmap (&oframe);
+    gst_buffer_copy_into (outbuf, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    gst_buffer_unref (buffer);
+    buffer = outbuf;
+  }
+
+  return gst_pad_push (y4mdec->srcpad, buffer);
+}
+
 static GstFlowReturn
 gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
   GstY4mDec *y4mdec;
   int n_avail;
   GstFlowReturn flow_ret = GST_FLOW_OK;
-#define MAX_HEADER_LENGTH 80
   char header[MAX_HEADER_LENGTH];
-  int i;
   int len;
 
   y4mdec = GST_Y4M_DEC (parent);
@@ -506,19 +706,12 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
   if (!y4mdec->have_header) {
     gboolean ret;
-    GstCaps *caps;
-    GstQuery *query;
 
     if (n_avail < MAX_HEADER_LENGTH)
       return GST_FLOW_OK;
 
     gst_adapter_copy (y4mdec->adapter, (guint8 *) header, 0, MAX_HEADER_LENGTH);
-
-    header[MAX_HEADER_LENGTH - 1] = 0;
-    for (i = 0; i < MAX_HEADER_LENGTH; i++) {
-      if (header[i] == 0x0a)
-        header[i] = 0;
-    }
+    gst_y4m_dec_terminate_line (header);
 
     ret = gst_y4m_dec_parse_header (y4mdec, header);
     if (!ret) {
@@ -530,113 +723,14 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     y4mdec->header_size = strlen (header) + 1;
     gst_adapter_flush (y4mdec->adapter, y4mdec->header_size);
 
-    caps = gst_video_info_to_caps (&y4mdec->info);
-    ret = gst_pad_set_caps (y4mdec->srcpad, caps);
-
-    query = gst_query_new_allocation (caps, FALSE);
-    y4mdec->video_meta = FALSE;
-
-    if (y4mdec->pool) {
-      gst_buffer_pool_set_active (y4mdec->pool, FALSE);
-      gst_object_unref (y4mdec->pool);
-    }
-    y4mdec->pool = NULL;
-
-    if (gst_pad_peer_query (y4mdec->srcpad, query)) {
-      y4mdec->video_meta =
-          gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
-
-      /* We only need a pool if we need to do stride conversion for downstream */
-      if (!y4mdec->video_meta && memcmp (&y4mdec->info, &y4mdec->out_info,
-              sizeof (y4mdec->info)) != 0) {
-        GstBufferPool *pool = NULL;
-        GstAllocator *allocator = NULL;
-        GstAllocationParams params;
-        GstStructure *config;
-        guint size, min, max;
-
-        if (gst_query_get_n_allocation_params (query) > 0) {
-          gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
-        } else {
-          allocator = NULL;
-          gst_allocation_params_init (&params);
-        }
-
-        if (gst_query_get_n_allocation_pools (query) > 0) {
-          gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min,
-              &max);
-          size = MAX (size, y4mdec->out_info.size);
-        } else {
-          pool = NULL;
-          size = y4mdec->out_info.size;
-          min = max = 0;
-        }
-
-        if (pool == NULL) {
-          pool = gst_video_buffer_pool_new ();
-        }
-
-        config = gst_buffer_pool_get_config (pool);
-        gst_buffer_pool_config_set_params (config, caps, size, min, max);
-        gst_buffer_pool_config_set_allocator (config, allocator, &params);
-        gst_buffer_pool_set_config (pool, config);
-
-        if (allocator)
-          gst_object_unref (allocator);
-
-        y4mdec->pool = pool;
-      }
-    } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
-            sizeof (y4mdec->info)) != 0) {
-      GstBufferPool *pool;
-      GstStructure *config;
-
-      /* No pool, create our own if we need to do stride conversion */
-      pool = gst_video_buffer_pool_new ();
-      config = gst_buffer_pool_get_config (pool);
-      gst_buffer_pool_config_set_params (config, caps, y4mdec->out_info.size, 0,
-          0);
-      gst_buffer_pool_set_config (pool, config);
-      y4mdec->pool = pool;
-    }
-    if (y4mdec->pool) {
-      gst_buffer_pool_set_active (y4mdec->pool, TRUE);
-    }
-    gst_query_unref (query);
-    gst_caps_unref (caps);
-    if (!ret) {
-      GST_DEBUG_OBJECT (y4mdec, "Couldn't set caps on src pad");
+    if (!gst_y4m_dec_negotiate (y4mdec))
       return GST_FLOW_ERROR;
-    }
 
     y4mdec->have_header = TRUE;
   }
 
-  if (y4mdec->have_new_segment) {
-    GstEvent *event;
-    GstClockTime start = gst_y4m_dec_bytes_to_timestamp (y4mdec,
-        y4mdec->segment.start);
-    GstClockTime stop = gst_y4m_dec_bytes_to_timestamp (y4mdec,
-        y4mdec->segment.stop);
-    GstClockTime time = gst_y4m_dec_bytes_to_timestamp (y4mdec,
-        y4mdec->segment.time);
-    GstSegment seg;
-
-    gst_segment_init (&seg, GST_FORMAT_TIME);
-    seg.start = start;
-    seg.stop = stop;
-    seg.time = time;
-    event = gst_event_new_segment (&seg);
-
-    gst_pad_push_event (y4mdec->srcpad, event);
-    //gst_event_unref (event);
-
-    y4mdec->have_new_segment = FALSE;
-    y4mdec->frame_index = gst_y4m_dec_bytes_to_frames (y4mdec,
-        y4mdec->segment.time);
-    GST_DEBUG ("new frame_index %d", y4mdec->frame_index);
-
-  }
+  if (y4mdec->have_new_segment)
+    gst_y4m_dec_push_segment (y4mdec);
 
   while (1) {
     n_avail = gst_adapter_available (y4mdec->adapter);
@@ -644,11 +738,7 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       break;
 
     gst_adapter_copy (y4mdec->adapter, (guint8 *) header, 0, MAX_HEADER_LENGTH);
-    header[MAX_HEADER_LENGTH - 1] = 0;
-    for (i = 0; i < MAX_HEADER_LENGTH; i++) {
-      if (header[i] == 0x0a)
-        header[i] = 0;
-    }
+    gst_y4m_dec_terminate_line (header);
     if (memcmp (header, "FRAME", 5) != 0) {
       GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
           ("Failed to parse YUV4MPEG frame"), (NULL));
@@ -668,69 +758,218 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
     buffer = gst_adapter_take_buffer (y4mdec->adapter, y4mdec->info.size);
 
-    GST_BUFFER_TIMESTAMP (buffer) =
-        gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index);
-    GST_BUFFER_DURATION (buffer) =
-        gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index + 1) -
-        GST_BUFFER_TIMESTAMP (buffer);
+    flow_ret = gst_y4m_dec_push_frame (y4mdec, buffer);
+    if (flow_ret != GST_FLOW_OK)
+      break;
+  }
 
-    y4mdec->frame_index++;
+  GST_DEBUG ("returning %d", flow_ret);
 
-    if (y4mdec->video_meta) {
-      gst_buffer_add_video_meta_full (buffer, 0, y4mdec->info.finfo->format,
-          y4mdec->info.width, y4mdec->info.height, y4mdec->info.finfo->n_planes,
-          y4mdec->info.offset, y4mdec->info.stride);
-    } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
-            sizeof (y4mdec->info)) != 0) {
-      GstBuffer *outbuf;
-      GstVideoFrame iframe, oframe;
-      gint i, j;
-      gint w, h, istride, ostride;
-      guint8 *src, *dest;
-
-      /* Allocate a new buffer and do stride conversion */
-      g_assert (y4mdec->pool != NULL);
-
-      flow_ret = gst_buffer_pool_acquire_buffer (y4mdec->pool, &outbuf, NULL);
-      if (flow_ret != GST_FLOW_OK) {
-        gst_buffer_unref (buffer);
-        break;
-      }
+  return flow_ret;
+}
 
-      gst_video_frame_map (&iframe, &y4mdec->info, buffer, GST_MAP_READ);
-      gst_video_frame_map (&oframe, &y4mdec->out_info, outbuf, GST_MAP_WRITE);
+static void
+gst_y4m_dec_loop (GstY4mDec * y4mdec)
+{
+  GstFlowReturn flow_ret;
+  GstBuffer *buffer = NULL;
+  char header[MAX_HEADER_LENGTH];
+  gsize n_read;
+  int len;
 
-      for (i = 0; i < 3; i++) {
-        w = GST_VIDEO_FRAME_COMP_WIDTH (&iframe, i);
-        h = GST_VIDEO_FRAME_COMP_HEIGHT (&iframe, i);
-        istride = GST_VIDEO_FRAME_COMP_STRIDE (&iframe, i);
-        ostride = GST_VIDEO_FRAME_COMP_STRIDE (&oframe, i);
-        src = GST_VIDEO_FRAME_COMP_DATA (&iframe, i);
-        dest = GST_VIDEO_FRAME_COMP_DATA (&oframe, i);
+  if (G_UNLIKELY (y4mdec->push_stream_start)) {
+    gchar *stream_id;
+    GstEvent *event;
 
-        for (j = 0; j < h; j++) {
-          memcpy (dest, src, w);
+    stream_id = gst_pad_create_stream_id (y4mdec->srcpad,
+        GST_ELEMENT_CAST (y4mdec), NULL);
 
-          dest += ostride;
-          src += istride;
-        }
-      }
+    event = gst_event_new_stream_start (stream_id);
+    gst_event_set_group_id (event, gst_util_group_id_next ());
+    gst_pad_push_event (y4mdec->srcpad, event);
+    y4mdec->push_stream_start = FALSE;
+    g_free (stream_id);
+  }
 
-      gst_video_frame_unmap (&iframe);
-      gst_video_frame_unmap (&oframe);
-      gst_buffer_copy_into (outbuf, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
-      gst_buffer_unref (buffer);
-      buffer = outbuf;
+  /* the frame at the stop position of a seek isn't output any more */
+  if (y4mdec->have_header && y4mdec->segment.stop != -1
+      && y4mdec->offset >= y4mdec->segment.stop) {
+    flow_ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  flow_ret = gst_pad_pull_range (y4mdec->sinkpad, y4mdec->offset,
+      MAX_HEADER_LENGTH, &buffer);
+  if (flow_ret != GST_FLOW_OK)
+    goto pause;
+
+  memset (header, 0, MAX_HEADER_LENGTH);
+  n_read = gst_buffer_extract (buffer, 0, header, MAX_HEADER_LENGTH);
+  gst_buffer_unref (buffer);
+  buffer = NULL;
+
+  if (n_read == 0) {
+    flow_ret = GST_FLOW_EOS;
+    goto pause;
+  }
+  gst_y4m_dec_terminate_line (header);
+
+  if (!y4mdec->have_header) {
+    if (!gst_y4m_dec_parse_header (y4mdec, header)) {
+      GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
+          ("Failed to parse YUV4MPEG header"), (NULL));
+      flow_ret = GST_FLOW_ERROR;
+      goto pause;
     }
 
-    flow_ret = gst_pad_push (y4mdec->srcpad, buffer);
-    if (flow_ret != GST_FLOW_OK)
-      break;
+    y4mdec->header_size = strlen (header) + 1;
+    y4mdec->offset = MAX (y4mdec->offset, y4mdec->header_size);
+
+    if (!gst_y4m_dec_negotiate (y4mdec)) {
+      flow_ret = GST_FLOW_NOT_NEGOTIATED;
+      goto pause;
+    }
+
+    y4mdec->have_header = TRUE;
+    return;
   }
 
-  GST_DEBUG ("returning %d", flow_ret);
+  if (y4mdec->have_new_segment)
+    gst_y4m_dec_push_segment (y4mdec);
 
-  return flow_ret;
+  if (memcmp (header, "FRAME", 5) != 0) {
+    GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
+        ("Failed to parse YUV4MPEG frame"), (NULL));
+    flow_ret = GST_FLOW_ERROR;
+    goto pause;
+  }
+
+  len = strlen (header);
+  flow_ret = gst_pad_pull_range (y4mdec->sinkpad, y4mdec->offset + len + 1,
+      y4mdec->info.size, &buffer);
+  if (flow_ret != GST_FLOW_OK)
+    goto pause;
+
+  if (gst_buffer_get_size (buffer) < y4mdec->info.size) {
+    GST_DEBUG_OBJECT (y4mdec, "short frame at offset %" G_GUINT64_FORMAT,
+        y4mdec->offset);
+    gst_buffer_unref (buffer);
+    flow_ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  y4mdec->offset += len + 1 + y4mdec->info.size;
+
+  flow_ret = gst_y4m_dec_push_frame (y4mdec, buffer);
+  if (flow_ret != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+pause:
+  {
+    GST_LOG_OBJECT (y4mdec, "pausing task, reason %s",
+        gst_flow_get_name (flow_ret));
+    gst_pad_pause_task (y4mdec->sinkpad);
+
+    if (flow_ret == GST_FLOW_EOS) {
+      gst_pad_push_event (y4mdec->srcpad, gst_event_new_eos ());
+    } else if (flow_ret == GST_FLOW_NOT_LINKED || flow_ret < GST_FLOW_EOS) {
+      /* parsing errors were already posted */
+      if (flow_ret != GST_FLOW_ERROR)
+        GST_ELEMENT_ERROR (y4mdec, STREAM, FAILED,
+            ("Internal data stream error."),
+            ("stream stopped, reason %s", gst_flow_get_name (flow_ret)));
+      gst_pad_push_event (y4mdec->srcpad, gst_event_new_eos ());
+    }
+  }
+}
+
+static gboolean
+gst_y4m_dec_sink_activate (GstPad * sinkpad, GstObject * parent)
+{
+  GstQuery *query;
+  gboolean pull_mode = FALSE;
+
+  query = gst_query_new_scheduling ();
+
+  if (gst_pad_peer_query (sinkpad, query))
+    pull_mode = gst_query_has_scheduling_mode_with_flags (query,
+        GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE);
+
+  gst_query_unref (query);
+
+  if (pull_mode) {
+    GST_DEBUG ("going to pull mode");
+    return gst_pad_activate_mode (sinkpad, GST_PAD_MODE_PULL, TRUE);
+  } else {
+    GST_DEBUG ("going to push (streaming) mode");
+    return gst_pad_activate_mode (sinkpad, GST_PAD_MODE_PUSH, TRUE);
+  }
+}
+
+static gboolean
+gst_y4m_dec_sink_activatemode (GstPad * sinkpad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstY4mDec *y4mdec = GST_Y4M_DEC (parent);
+  gboolean res;
+
+  switch (mode) {
+    case GST_PAD_MODE_PULL:
+      if (active) {
+        y4mdec->have_header = FALSE;
+        y4mdec->offset = 0;
+        y4mdec->push_stream_start = TRUE;
+        gst_segment_init (&y4mdec->segment, GST_FORMAT_BYTES);
+        y4mdec->have_new_segment = TRUE;
+
+        y4mdec->mode = mode;
+        res = gst_pad_start_task (sinkpad, (GstTaskFunction) gst_y4m_dec_loop,
+            y4mdec, NULL);
+      } else {
+        res = gst_pad_stop_task (sinkpad);
+      }
+      return res;
+    case GST_PAD_MODE_PUSH:
+      y4mdec->mode = mode;
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+gst_y4m_dec_handle_seek_pull (GstY4mDec * y4mdec, GstSeekFlags flags,
+    guint64 byte, guint64 stop_byte)
+{
+  gboolean flush = (flags & GST_SEEK_FLAG_FLUSH) != 0;
+
+  if (flush)
+    gst_pad_push_event (y4mdec->srcpad, gst_event_new_flush_start ());
+  else
+    gst_pad_pause_task (y4mdec->sinkpad);
+
+  /* wait for the streaming thread to stop */
+  GST_PAD_STREAM_LOCK (y4mdec->sinkpad);
+
+  if (flush)
+    gst_pad_push_event (y4mdec->srcpad, gst_event_new_flush_stop (TRUE));
+
+  /* same as the segment upstream would send in push mode */
+  y4mdec->offset = byte;
+  gst_segment_init (&y4mdec->segment, GST_FORMAT_BYTES);
+  y4mdec->segment.start = byte;
+  y4mdec->segment.stop = stop_byte;
+  y4mdec->segment.time = byte;
+  y4mdec->have_new_segment = TRUE;
+
+  gst_pad_start_task (y4mdec->sinkpad, (GstTaskFunction) gst_y4m_dec_loop,
+      y4mdec, NULL);
+
+  GST_PAD_STREAM_UNLOCK (y4mdec->sinkpad);
+
+  return TRUE;
 }
 
 static gboolean
@@ -798,7 +1037,7 @@ gst_y4m_dec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
       GstSeekType start_type, stop_type;
       gint64 start, stop;
       gint64 framenum;
-      guint64 byte;
+      guint64 byte, stop_byte = -1;
 
       gst_event_parse_seek (event, &rate, &format, &flags, &start_type,
           &start, &stop_type, &stop);
@@ -808,6 +1047,13 @@ gst_y4m_dec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
         break;
       }
 
+      /* the frame size and rate are not known yet */
+      if (!y4mdec->have_header) {
+        gst_event_unref (event);
+        res = FALSE;
+        break;
+      }
+
       framenum = gst_y4m_dec_timestamp_to_frames (y4mdec, start);
       GST_DEBUG ("seeking to frame %" G_GINT64_FORMAT, framenum);
       if (framenum == -1) {
@@ -822,9 +1068,22 @@ gst_y4m_dec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
         break;
       }
 
+      /* up to the start of the first frame after the stop position */
+      if (stop_type == GST_SEEK_TYPE_SET && stop != -1) {
+        stop_byte = gst_y4m_dec_frames_to_bytes (y4mdec,
+            gst_util_uint64_scale_ceil (stop, y4mdec->info.fps_n,
+                GST_SECOND * y4mdec->info.fps_d));
+      }
+
       gst_event_unref (event);
+
+      if (y4mdec->mode == GST_PAD_MODE_PULL) {
+        res = gst_y4m_dec_handle_seek_pull (y4mdec, flags, byte, stop_byte);
+        break;
+      }
+
       event = gst_event_new_seek (rate, GST_FORMAT_BYTES, flags,
-          start_type, byte, stop_type, -1);
+          start_type, byte, stop_type, stop_byte);
 
       res = gst_pad_push_event (y4mdec->sinkpad, event);
     }
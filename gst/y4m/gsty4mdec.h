@@ -54,6 +54,11 @@ struct _GstY4mDec
   GstVideoInfo out_info;
   gboolean video_meta;
   GstBufferPool *pool;
+
+  /* pull mode */
+  GstPadMode mode;
+  guint64 offset;
+  gboolean push_stream_start;
 };
 
 struct _GstY4mDecClass
@@ -34,6 +34,10 @@
  * This pipeline creates an interlaced test pattern, and then deinterlaces
  * it using the yadif filter.
  * </refsect2>
+ *
+ * The lines of every frame are split into slices that are filtered on
+ * #GstYadif:threads threads. 10 bit planar formats are filtered with the
+ * 16 bit version of the filter.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -72,10 +76,19 @@ static GstFlowReturn gst_yadif_transform (GstBaseTransform * trans,
 enum
 {
   PROP_0,
-  PROP_MODE
+  PROP_MODE,
+  PROP_THREADS
 };
 
 #define DEFAULT_MODE GST_DEINTERLACE_MODE_AUTO
+#define DEFAULT_THREADS 0
+
+#define MAX_THREADS 64
+/* slices of fewer lines are not worth the synchronization */
+#define MIN_SLICE_LINES 32
+
+#define YADIF_FORMATS "{Y42B,I420,Y444," GST_VIDEO_NE (I420_10) "," \
+    GST_VIDEO_NE (I422_10) "," GST_VIDEO_NE (Y444_10) "}"
 
 /* pad templates */
 
@@ -83,7 +96,7 @@ static GstStaticPadTemplate gst_yadif_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{Y42B,I420,Y444}")
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (YADIF_FORMATS)
         ",interlace-mode=(string){interleaved,mixed,progressive}")
     );
 
@@ -91,7 +104,7 @@ static GstStaticPadTemplate gst_yadif_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{Y42B,I420,Y444}")
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (YADIF_FORMATS)
         ",interlace-mode=(string)progressive")
     );
 
@@ -160,11 +173,20 @@ gst_yadif_class_init (GstYadifClass * klass)
           DEFAULT_MODE,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads the lines of a frame are filtered on "
+          "(0 = one per CPU)", 0, MAX_THREADS, DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
 }
 
 static void
 gst_yadif_init (GstYadif * yadif)
 {
+  yadif->threads = DEFAULT_THREADS;
+  g_mutex_init (&yadif->lock);
+  g_cond_init (&yadif->cond);
 }
 
 void
@@ -177,6 +199,9 @@ gst_yadif_set_property (GObject * object, guint property_id,
     case PROP_MODE:
       yadif->mode = g_value_get_enum (value);
       break;
+    case PROP_THREADS:
+      yadif->threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -193,6 +218,9 @@ gst_yadif_get_property (GObject * object, guint property_id,
     case PROP_MODE:
       g_value_set_enum (value, yadif->mode);
       break;
+    case PROP_THREADS:
+      g_value_set_uint (value, yadif->threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -212,9 +240,10 @@ gst_yadif_dispose (GObject * object)
 void
 gst_yadif_finalize (GObject * object)
 {
-  /* GstYadif *yadif = GST_YADIF (object); */
+  GstYadif *yadif = GST_YADIF (object);
 
-  /* clean up object here */
+  g_mutex_clear (&yadif->lock);
+  g_cond_clear (&yadif->cond);
 
   G_OBJECT_CLASS (gst_yadif_parent_class)->finalize (object);
 }
@@ -260,6 +289,7 @@ gst_yadif_set_caps (GstBaseTransform * trans, GstCaps * incaps,
   GstYadif *yadif = GST_YADIF (trans);
 
   gst_video_info_from_caps (&yadif->video_info, incaps);
+  yadif_select_filter_line (yadif);
 
   return TRUE;
 }
@@ -277,9 +307,45 @@ gst_yadif_get_unit_size (GstBaseTransform * trans, GstCaps * caps, gsize * size)
   return FALSE;
 }
 
+static void
+gst_yadif_filter_slice (gpointer data, gpointer user_data)
+{
+  GstYadif *yadif = GST_YADIF (user_data);
+
+  yadif_filter (yadif, yadif->parity, yadif->tff, GPOINTER_TO_INT (data),
+      yadif->n_slices);
+
+  g_mutex_lock (&yadif->lock);
+  if (--yadif->n_pending == 0)
+    g_cond_signal (&yadif->cond);
+  g_mutex_unlock (&yadif->lock);
+}
+
 static gboolean
 gst_yadif_start (GstBaseTransform * trans)
 {
+  GstYadif *yadif = GST_YADIF (trans);
+  guint n_threads = yadif->threads;
+
+  if (n_threads == 0)
+    n_threads = MIN (g_get_num_processors (), MAX_THREADS);
+
+  yadif->n_workers = 0;
+  if (n_threads > 1) {
+    GError *err = NULL;
+
+    yadif->pool = g_thread_pool_new (gst_yadif_filter_slice, yadif,
+        n_threads - 1, FALSE, &err);
+    if (yadif->pool) {
+      yadif->n_workers = n_threads - 1;
+    } else {
+      GST_WARNING_OBJECT (yadif, "failed to create thread pool: %s",
+          err->message);
+      g_clear_error (&err);
+    }
+  }
+
+  GST_DEBUG_OBJECT (yadif, "filtering on %u threads", yadif->n_workers + 1);
 
   return TRUE;
 }
@@ -287,11 +353,47 @@ gst_yadif_start (GstBaseTransform * trans)
 static gboolean
 gst_yadif_stop (GstBaseTransform * trans)
 {
+  GstYadif *yadif = GST_YADIF (trans);
+
+  if (yadif->pool) {
+    g_thread_pool_free (yadif->pool, FALSE, TRUE);
+    yadif->pool = NULL;
+  }
+  yadif->n_workers = 0;
 
   return TRUE;
 }
 
-void yadif_filter (GstYadif * yadif, int parity, int tff);
+/* Filters the first slice on the calling thread and the others on the
+ * workers, and waits for all of them */
+static void
+gst_yadif_filter_frame (GstYadif * yadif, int parity, int tff)
+{
+  gint i, n_slices;
+
+  n_slices = GST_VIDEO_INFO_HEIGHT (&yadif->video_info) / MIN_SLICE_LINES;
+  n_slices = CLAMP (n_slices, 1, (gint) yadif->n_workers + 1);
+
+  if (n_slices == 1) {
+    yadif_filter (yadif, parity, tff, 0, 1);
+    return;
+  }
+
+  yadif->parity = parity;
+  yadif->tff = tff;
+  yadif->n_slices = n_slices;
+  yadif->n_pending = n_slices - 1;
+
+  for (i = 1; i < n_slices; i++)
+    g_thread_pool_push (yadif->pool, GINT_TO_POINTER (i), NULL);
+
+  yadif_filter (yadif, parity, tff, 0, n_slices);
+
+  g_mutex_lock (&yadif->lock);
+  while (yadif->n_pending > 0)
+    g_cond_wait (&yadif->cond, &yadif->lock);
+  g_mutex_unlock (&yadif->lock);
+}
 
 static GstFlowReturn
 gst_yadif_transform (GstBaseTransform * trans, GstBuffer * inbuf,
@@ -315,7 +417,7 @@ gst_yadif_transform (GstBaseTransform * trans, GstBuffer * inbuf,
   yadif->next_frame = yadif->cur_frame;
   yadif->prev_frame = yadif->cur_frame;
 
-  yadif_filter (yadif, parity, tff);
+  gst_yadif_filter_frame (yadif, parity, tff);
 
   gst_video_frame_unmap (&yadif->dest_frame);
   gst_video_frame_unmap (&yadif->cur_frame);
@@ -35,6 +35,13 @@ G_BEGIN_DECLS
 typedef struct _GstYadif GstYadif;
 typedef struct _GstYadifClass GstYadifClass;
 
+typedef void (*GstYadifFilterLineFunc) (guint8 * dst,
+    guint8 * prev, guint8 * cur, guint8 * next,
+    int w, int prefs, int mrefs, int parity, int mode);
+typedef void (*GstYadifFilterLine16bitFunc) (guint16 * dst,
+    guint16 * prev, guint16 * cur, guint16 * next,
+    int w, int prefs, int mrefs, int parity, int mode);
+
 typedef enum {
   GST_DEINTERLACE_MODE_AUTO,
   GST_DEINTERLACE_MODE_INTERLACED,
@@ -46,8 +53,22 @@ struct _GstYadif
   GstBaseTransform base_yadif;
 
   GstDeinterlaceMode mode;
+  guint threads;
 
   GstVideoInfo video_info;
+  GstYadifFilterLineFunc filter_line;
+  GstYadifFilterLine16bitFunc filter_line_16bit;
+
+  /* workers filtering all slices but the first, which is filtered on the
+   * streaming thread */
+  GThreadPool *pool;
+  guint n_workers;
+  GMutex lock;
+  GCond cond;
+  guint n_pending;
+  gint parity;
+  gint tff;
+  gint n_slices;
 
   GstVideoFrame prev_frame;
   GstVideoFrame cur_frame;
@@ -62,6 +83,10 @@ struct _GstYadifClass
 
 GType gst_yadif_get_type (void);
 
+void yadif_select_filter_line (GstYadif * yadif);
+void yadif_filter (GstYadif * yadif, int parity, int tff, int slice,
+    int n_slices);
+
 G_END_DECLS
 
 #endif
@@ -26,69 +26,9 @@
 #include <gstyadif.h>
 #include <string.h>
 
-#undef NDEBUG
-#include <assert.h>
-
-#define FFABS(a) ABS(a)
-#define FFMIN(a,b) MIN(a,b)
-#define FFMAX(a,b) MAX(a,b)
-#define FFMAX3(a,b,c) FFMAX(FFMAX(a,b),c)
-#define FFMIN3(a,b,c) FFMIN(FFMIN(a,b),c)
-
-
-#define PERM_RWP AV_PERM_WRITE | AV_PERM_PRESERVE | AV_PERM_REUSE
-
-#define CHECK(j)\
-    {   int score = FFABS(cur[mrefs-1+(j)] - cur[prefs-1-(j)])\
-                  + FFABS(cur[mrefs  +(j)] - cur[prefs  -(j)])\
-                  + FFABS(cur[mrefs+1+(j)] - cur[prefs+1-(j)]);\
-        if (score < spatial_score) {\
-            spatial_score= score;\
-            spatial_pred= (cur[mrefs  +(j)] + cur[prefs  -(j)])>>1;\
-
-#define FILTER \
-    for (x = 0;  x < w; x++) { \
-        int c = cur[mrefs]; \
-        int d = (prev2[0] + next2[0])>>1; \
-        int e = cur[prefs]; \
-        int temporal_diff0 = FFABS(prev2[0] - next2[0]); \
-        int temporal_diff1 =(FFABS(prev[mrefs] - c) + FFABS(prev[prefs] - e) )>>1; \
-        int temporal_diff2 =(FFABS(next[mrefs] - c) + FFABS(next[prefs] - e) )>>1; \
-        int diff = FFMAX3(temporal_diff0 >> 1, temporal_diff1, temporal_diff2); \
-        int spatial_pred = (c+e) >> 1; \
-        int spatial_score = -1; \
- \
-        if (mrefs > 0 && prefs > 0) { \
-            spatial_score = FFABS(cur[mrefs - 1] - cur[prefs - 1]) + FFABS(c-e) \
-                            + FFABS(cur[mrefs + 1] - cur[prefs + 1]) - 1; \
- \
-            CHECK(-1) CHECK(-2) }} }} \
-            CHECK( 1) CHECK( 2) }} }} \
-        } \
-        if (mode < 2) { \
-            int b = (prev2[2 * mrefs] + next2[2 * mrefs])>>1; \
-            int f = (prev2[2 * prefs] + next2[2 * prefs])>>1; \
-            int max = FFMAX3(d - e, d - c, FFMIN(b - c, f - e)); \
-            int min = FFMIN3(d - e, d - c, FFMAX(b - c, f - e)); \
- \
-            diff = FFMAX3(diff, min, -max); \
-        } \
- \
-        if (spatial_pred > d + diff) \
-           spatial_pred = d + diff; \
-        else if (spatial_pred < d - diff) \
-           spatial_pred = d - diff; \
- \
-        dst[0] = spatial_pred; \
- \
-        dst++; \
-        cur++; \
-        prev++; \
-        next++; \
-        prev2++; \
-        next2++; \
-    }
+#include "vf_yadif.h"
 
+#ifndef HAVE_CPU_X86_64
 static void
 filter_line_c (guint8 * dst,
     guint8 * prev, guint8 * cur, guint8 * next,
@@ -97,10 +37,15 @@ filter_line_c (guint8 * dst,
   int x;
   guint8 *prev2 = parity ? prev : cur;
   guint8 *next2 = parity ? cur : next;
+  int border = MIN (w, YADIF_BORDER);
+  int inner_end = MAX (w - YADIF_BORDER, border);
 
-FILTER}
+  FILTER (0, border, 0)
+  FILTER (border, inner_end, 1)
+  FILTER (inner_end, w, 0)
+}
+#endif
 
-#if 0
 static void
 filter_line_c_16bit (guint16 * dst,
     guint16 * prev, guint16 * cur, guint16 * next,
@@ -109,21 +54,54 @@ filter_line_c_16bit (guint16 * dst,
   int x;
   guint16 *prev2 = parity ? prev : cur;
   guint16 *next2 = parity ? cur : next;
+  int border = MIN (w, YADIF_BORDER);
+  int inner_end = MAX (w - YADIF_BORDER, border);
   mrefs /= 2;
   prefs /= 2;
 
-FILTER}
-#endif
+  FILTER (0, border, 0)
+  FILTER (border, inner_end, 1)
+  FILTER (inner_end, w, 0)
+}
 
-void yadif_filter (GstYadif * yadif, int parity, int tff);
 #ifdef HAVE_CPU_X86_64
 void filter_line_x86_64 (guint8 * dst,
     guint8 * prev, guint8 * cur, guint8 * next,
     int w, int prefs, int mrefs, int parity, int mode);
 #endif
 
+/* Picks the fastest line filters the CPU supports. The choice is made per
+ * element when the caps are set, so GST_CPU_FEATURES_DISABLE can select the
+ * fallbacks for a single element */
+void
+yadif_select_filter_line (GstYadif * yadif)
+{
+#ifdef YADIF_USE_INTRINSICS
+  GstCpuFeatures features = gst_cpu_get_features ();
+#endif
+
+#if HAVE_CPU_X86_64
+  yadif->filter_line = filter_line_x86_64;
+#else
+  yadif->filter_line = filter_line_c;
+#endif
+  yadif->filter_line_16bit = filter_line_c_16bit;
+
+#ifdef YADIF_USE_INTRINSICS
+  if (features & GST_CPU_FEATURE_SSE4_1)
+    yadif->filter_line_16bit = yadif_filter_line_16bit_sse4;
+  if (features & GST_CPU_FEATURE_AVX2) {
+    yadif->filter_line = yadif_filter_line_avx2;
+    yadif->filter_line_16bit = yadif_filter_line_16bit_avx2;
+  }
+#endif
+}
+
+/* Filters the lines of slice @slice of @n_slices of every plane. The slices
+ * only write their own lines of the destination, so they can be filtered
+ * in parallel */
 void
-yadif_filter (GstYadif * yadif, int parity, int tff)
+yadif_filter (GstYadif * yadif, int parity, int tff, int slice, int n_slices)
 {
   int y, i;
   const GstVideoInfo *vi = &yadif->video_info;
@@ -134,30 +112,29 @@ yadif_filter (GstYadif * yadif, int parity, int tff)
     int h = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (vfi, i, vi->height);
     int refs = GST_VIDEO_INFO_COMP_STRIDE (vi, i);
     int df = GST_VIDEO_INFO_COMP_PSTRIDE (vi, i);
+    int y_start = h * slice / n_slices;
+    int y_end = h * (slice + 1) / n_slices;
     guint8 *prev_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->prev_frame, i);
     guint8 *cur_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->cur_frame, i);
     guint8 *next_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->next_frame, i);
     guint8 *dest_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->dest_frame, i);
 
-    for (y = 0; y < h; y++) {
+    for (y = y_start; y < y_end; y++) {
       if ((y ^ parity) & 1) {
         guint8 *prev = prev_data + y * refs;
         guint8 *cur = cur_data + y * refs;
         guint8 *next = next_data + y * refs;
         guint8 *dst = dest_data + y * refs;
         int mode = ((y == 1) || (y + 2 == h)) ? 2 : yadif->mode;
-#if HAVE_CPU_X86_64
-        if (0) {
-          filter_line_c (dst, prev, cur, next, w,
+
+        if (df == 2) {
+          yadif->filter_line_16bit ((guint16 *) dst, (guint16 *) prev,
+              (guint16 *) cur, (guint16 *) next, w,
               y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
         } else {
-          filter_line_x86_64 (dst, prev, cur, next, w,
+          yadif->filter_line (dst, prev, cur, next, w,
               y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
         }
-#else
-        filter_line_c (dst, prev, cur, next, w,
-            y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
-#endif
       } else {
         guint8 *dst = dest_data + y * refs;
         guint8 *cur = cur_data + y * refs;
@@ -166,8 +143,4 @@ yadif_filter (GstYadif * yadif, int parity, int tff)
       }
     }
   }
-
-#if 0
-  emms_c ();
-#endif
 }
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2006 Michael Niedermayer <michaelni@gmx.at>
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Libav; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* AVX2 and SSE4.1 versions of the line filter, selected at runtime by
+ * vf_yadif.c. 8 bit pixels are filtered in 16 bit lanes and 16 bit pixels
+ * in 32 bit lanes, which leaves enough headroom for the scores. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vf_yadif.h"
+
+#ifdef YADIF_USE_INTRINSICS
+
+#include <immintrin.h>
+
+/* 8 bit, AVX2 */
+#define TYPE guint8
+#define TARGET __attribute__ ((target ("avx2")))
+#define RENAME(a) yadif_ ## a ## _avx2
+#define V __m256i
+#define STEP 16
+#define VLOAD(p) _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (p)))
+#define VSTORE(p,v) _mm_storeu_si128 ((__m128i *) (p), \
+    _mm256_castsi256_si128 (_mm256_permute4x64_epi64 ( \
+            _mm256_packus_epi16 ((v), (v)), 0xd8)))
+#define VSET1(a) _mm256_set1_epi16 (a)
+#define VADD(a,b) _mm256_add_epi16 (a, b)
+#define VSUB(a,b) _mm256_sub_epi16 (a, b)
+#define VABS(a) _mm256_abs_epi16 (a)
+#define VMIN(a,b) _mm256_min_epi16 (a, b)
+#define VMAX(a,b) _mm256_max_epi16 (a, b)
+#define VSRL1(a) _mm256_srli_epi16 (a, 1)
+#define VAND(a,b) _mm256_and_si256 (a, b)
+#define VCMPGT(a,b) _mm256_cmpgt_epi16 (a, b)
+#define VBLEND(a,b,m) _mm256_blendv_epi8 (a, b, m)
+#include "yadif_intrin_template.c"
+#undef TYPE
+#undef RENAME
+#undef STEP
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VABS
+#undef VMIN
+#undef VMAX
+#undef VSRL1
+#undef VCMPGT
+
+/* 16 bit, AVX2 */
+#define TYPE guint16
+#define RENAME(a) yadif_ ## a ## _16bit_avx2
+#define STEP 8
+#define VLOAD(p) _mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i *) (p)))
+#define VSTORE(p,v) _mm_storeu_si128 ((__m128i *) (p), \
+    _mm256_castsi256_si128 (_mm256_permute4x64_epi64 ( \
+            _mm256_packus_epi32 ((v), (v)), 0xd8)))
+#define VSET1(a) _mm256_set1_epi32 (a)
+#define VADD(a,b) _mm256_add_epi32 (a, b)
+#define VSUB(a,b) _mm256_sub_epi32 (a, b)
+#define VABS(a) _mm256_abs_epi32 (a)
+#define VMIN(a,b) _mm256_min_epi32 (a, b)
+#define VMAX(a,b) _mm256_max_epi32 (a, b)
+#define VSRL1(a) _mm256_srli_epi32 (a, 1)
+#define VCMPGT(a,b) _mm256_cmpgt_epi32 (a, b)
+#include "yadif_intrin_template.c"
+#undef TARGET
+#undef RENAME
+#undef V
+#undef STEP
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VABS
+#undef VMIN
+#undef VMAX
+#undef VSRL1
+#undef VAND
+#undef VCMPGT
+#undef VBLEND
+
+/* 16 bit, SSE4.1 */
+#define TARGET __attribute__ ((target ("sse4.1")))
+#define RENAME(a) yadif_ ## a ## _16bit_sse4
+#define V __m128i
+#define STEP 4
+#define VLOAD(p) _mm_cvtepu16_epi32 (_mm_loadl_epi64 ((const __m128i *) (p)))
+#define VSTORE(p,v) _mm_storel_epi64 ((__m128i *) (p), \
+    _mm_packus_epi32 ((v), (v)))
+#define VSET1(a) _mm_set1_epi32 (a)
+#define VADD(a,b) _mm_add_epi32 (a, b)
+#define VSUB(a,b) _mm_sub_epi32 (a, b)
+#define VABS(a) _mm_abs_epi32 (a)
+#define VMIN(a,b) _mm_min_epi32 (a, b)
+#define VMAX(a,b) _mm_max_epi32 (a, b)
+#define VSRL1(a) _mm_srli_epi32 (a, 1)
+#define VAND(a,b) _mm_and_si128 (a, b)
+#define VCMPGT(a,b) _mm_cmpgt_epi32 (a, b)
+#define VBLEND(a,b,m) _mm_blendv_epi8 (a, b, m)
+#include "yadif_intrin_template.c"
+
+#endif /* YADIF_USE_INTRINSICS */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2006 Michael Niedermayer <michaelni@gmx.at>
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Libav; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Vector version of FILTER, included by yadif_intrin.c with TYPE, TARGET,
+ * RENAME, the vector type V of STEP lanes and the operations on it defined.
+ * Every lane holds one widened pixel, so the arithmetic is the same as in
+ * the C version. */
+
+#define ABSDIFF(a,b) VABS (VSUB (VLOAD (a), VLOAD (b)))
+#define SCORE(j) \
+    VADD (VADD (ABSDIFF (cur + mrefs - 1 + (j), cur + prefs - 1 - (j)), \
+            ABSDIFF (cur + mrefs + (j), cur + prefs - (j))), \
+        ABSDIFF (cur + mrefs + 1 + (j), cur + prefs + 1 - (j)))
+#define PRED(j) \
+    VSRL1 (VADD (VLOAD (cur + mrefs + (j)), VLOAD (cur + prefs - (j))))
+
+/* Takes the score and prediction of @j where @mask is set */
+#define CHECK_VEC(j) \
+    s = SCORE (j); \
+    mask = VAND (mask, VCMPGT (spatial_score, s)); \
+    spatial_score = VBLEND (spatial_score, s, mask); \
+    spatial_pred = VBLEND (spatial_pred, PRED (j), mask);
+
+TARGET void
+RENAME (filter_line) (TYPE * dst, TYPE * prev, TYPE * cur, TYPE * next,
+    int w, int prefs, int mrefs, int parity, int mode)
+{
+  int x;
+  TYPE *prev2 = parity ? prev : cur;
+  TYPE *next2 = parity ? cur : next;
+  int border = MIN (w, YADIF_BORDER);
+  int inner_end = MAX (w - YADIF_BORDER, border);
+  int vec_end = border + (inner_end - border) / STEP * STEP;
+  const V one = VSET1 (1);
+
+  mrefs /= (int) sizeof (TYPE);
+  prefs /= (int) sizeof (TYPE);
+
+  FILTER (0, border, 0)
+
+  for (x = border; x < vec_end; x += STEP) {
+    V c = VLOAD (cur + mrefs);
+    V e = VLOAD (cur + prefs);
+    V p2 = VLOAD (prev2);
+    V n2 = VLOAD (next2);
+    V d = VSRL1 (VADD (p2, n2));
+    V temporal_diff0 = VABS (VSUB (p2, n2));
+    V temporal_diff1 = VSRL1 (VADD (VABS (VSUB (VLOAD (prev + mrefs), c)),
+            VABS (VSUB (VLOAD (prev + prefs), e))));
+    V temporal_diff2 = VSRL1 (VADD (VABS (VSUB (VLOAD (next + mrefs), c)),
+            VABS (VSUB (VLOAD (next + prefs), e))));
+    V diff = VMAX (VMAX (VSRL1 (temporal_diff0), temporal_diff1),
+        temporal_diff2);
+    V spatial_pred = VSRL1 (VADD (c, e));
+    V spatial_score, s, mask;
+
+    spatial_score = VSUB (VADD (VADD (ABSDIFF (cur + mrefs - 1,
+                    cur + prefs - 1), VABS (VSUB (c, e))),
+            ABSDIFF (cur + mrefs + 1, cur + prefs + 1)), one);
+
+    mask = VSET1 (-1);
+    CHECK_VEC (-1);
+    CHECK_VEC (-2);
+    mask = VSET1 (-1);
+    CHECK_VEC (1);
+    CHECK_VEC (2);
+
+    if (mode < 2) {
+      V b = VSRL1 (VADD (VLOAD (prev2 + 2 * mrefs),
+              VLOAD (next2 + 2 * mrefs)));
+      V f = VSRL1 (VADD (VLOAD (prev2 + 2 * prefs),
+              VLOAD (next2 + 2 * prefs)));
+      V de = VSUB (d, e), dc = VSUB (d, c);
+      V bc = VSUB (b, c), fe = VSUB (f, e);
+      V max = VMAX (VMAX (de, dc), VMIN (bc, fe));
+      V min = VMIN (VMIN (de, dc), VMAX (bc, fe));
+
+      diff = VMAX (VMAX (diff, min), VSUB (VSET1 (0), max));
+    }
+
+    /* diff is never negative, so this is the same as the two comparisons
+     * of FILTER */
+    spatial_pred = VMAX (VMIN (spatial_pred, VADD (d, diff)),
+        VSUB (d, diff));
+    VSTORE (dst, spatial_pred);
+
+    dst += STEP;
+    cur += STEP;
+    prev += STEP;
+    next += STEP;
+    prev2 += STEP;
+    next2 += STEP;
+  }
+
+  FILTER (vec_end, inner_end, 1)
+  FILTER (inner_end, w, 0)
+}
+
+#undef ABSDIFF
+#undef SCORE
+#undef PRED
+#undef CHECK_VEC
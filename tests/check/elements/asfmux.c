@@ -23,6 +23,9 @@
 #include <unistd.h>
 
 #include <gst/check/gstcheck.h>
+#include <gst/base/gstbytereader.h>
+
+#define DEFAULT_PACKET_SIZE 4800
 
 /* For ease of programming we use globals to keep refs for our floating
  * src and sink pads we create; otherwise we always have to do get_pad,
@@ -189,6 +192,249 @@ GST_START_TEST (test_audio_pad)
 
 GST_END_TEST;
 
+/* Small frames get copied into the data packets and large ones are
+ * referenced. Each frame is filled with its media object number. */
+static GstBuffer *
+make_video_frame (guint i)
+{
+  gsize size = (i % 2) ? 20000 : 100;
+  GstBuffer *inbuffer = gst_buffer_new_and_alloc (size);
+
+  gst_buffer_memset (inbuffer, 0, i & 0xff, size);
+  GST_BUFFER_TIMESTAMP (inbuffer) = i * 40 * GST_MSECOND;
+  GST_BUFFER_DURATION (inbuffer) = 40 * GST_MSECOND;
+  if (i % 10)
+    GST_BUFFER_FLAG_SET (inbuffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return inbuffer;
+}
+
+static void
+setup_video_events (GstElement * asfmux)
+{
+  GstCaps *caps;
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, asfmux, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+}
+
+/* Pushes @n video frames, alternately small and large ones, and returns the
+ * number of payload bytes pushed. The first large one is kept in @large if
+ * not NULL. */
+static guint64
+push_video_frames (GstElement * asfmux, guint n, GstBuffer ** large)
+{
+  guint64 total = 0;
+  guint i;
+
+  setup_video_events (asfmux);
+
+  for (i = 0; i < n; i++) {
+    GstBuffer *inbuffer = make_video_frame (i);
+
+    if (large && i == 1)
+      *large = gst_buffer_ref (inbuffer);
+    total += gst_buffer_get_size (inbuffer);
+
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  return total;
+}
+
+/* Checks a data packet with the layout asfmux writes by default, and
+ * returns the number of payload bytes in it */
+static guint
+check_data_packet (GstBuffer * buffer)
+{
+  GstByteReader reader;
+  GstMapInfo map;
+  guint16 length, padding;
+  guint8 flags, count, media_obj, repl_len;
+  guint i, total = 0;
+
+  fail_unless_equals_int (gst_buffer_get_size (buffer), DEFAULT_PACKET_SIZE);
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  gst_byte_reader_init (&reader, map.data, map.size);
+
+  fail_unless (gst_byte_reader_skip (&reader, 2));
+  fail_unless (gst_byte_reader_get_uint16_le (&reader, &length));
+  fail_unless (gst_byte_reader_get_uint16_le (&reader, &padding));
+  fail_unless_equals_int (length + padding, DEFAULT_PACKET_SIZE);
+  fail_unless (gst_byte_reader_skip (&reader, 6));
+  fail_unless (gst_byte_reader_get_uint8 (&reader, &flags));
+  count = flags & 0x3f;
+
+  for (i = 0; i < count; i++) {
+    const guint8 *data;
+    guint16 size;
+    guint j;
+
+    fail_unless (gst_byte_reader_skip (&reader, 1));
+    fail_unless (gst_byte_reader_get_uint8 (&reader, &media_obj));
+    fail_unless (gst_byte_reader_skip (&reader, 4));
+    fail_unless (gst_byte_reader_get_uint8 (&reader, &repl_len));
+    fail_unless (gst_byte_reader_skip (&reader, repl_len));
+    fail_unless (gst_byte_reader_get_uint16_le (&reader, &size));
+    fail_unless (gst_byte_reader_get_data (&reader, size, &data));
+    for (j = 0; j < size; j++)
+      fail_unless_equals_int (data[j], media_obj);
+    total += size;
+  }
+
+  /* the padding is cleared */
+  fail_unless_equals_int (gst_byte_reader_get_remaining (&reader), padding);
+  for (i = 0; i < padding; i++)
+    fail_unless_equals_int (map.data[map.size - padding + i], 0);
+
+  gst_buffer_unmap (buffer, &map);
+
+  return total;
+}
+
+static gboolean
+buffer_references (GstBuffer * buffer, GstBuffer * data)
+{
+  GstMapInfo map, dmap;
+  gboolean found = FALSE;
+  guint i;
+
+  gst_buffer_map (data, &dmap, GST_MAP_READ);
+  for (i = 0; i < gst_buffer_n_memory (buffer) && !found; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+
+    gst_memory_map (mem, &map, GST_MAP_READ);
+    found = map.data >= dmap.data && map.data < dmap.data + dmap.size;
+    gst_memory_unmap (mem, &map);
+  }
+  gst_buffer_unmap (data, &dmap);
+
+  return found;
+}
+
+GST_START_TEST (test_data_packets)
+{
+  GstElement *asfmux;
+  GstBuffer *large = NULL;
+  gboolean referenced = FALSE;
+  guint64 pushed, muxed = 0;
+  GList *l;
+
+  asfmux = setup_asfmux (&srcvideotemplate, "video_%u");
+  g_object_set (asfmux, "streamable", TRUE, NULL);
+  fail_unless (gst_element_set_state (asfmux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  pushed = push_video_frames (asfmux, 50, &large);
+
+  /* the headers come first, then only data packets */
+  fail_unless (g_list_length (buffers) > 1);
+  for (l = buffers->next; l; l = l->next) {
+    muxed += check_data_packet (l->data);
+    referenced |= buffer_references (l->data, large);
+  }
+  fail_unless_equals_uint64 (muxed, pushed);
+  fail_unless (referenced, "large payload was copied into the packets");
+  gst_buffer_unref (large);
+
+  cleanup_asfmux (asfmux, "video_%u");
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_copy_packets)
+{
+  GstElement *asfmux;
+  GstBuffer *large = NULL;
+  guint64 pushed, muxed = 0;
+  GList *l;
+
+  asfmux = setup_asfmux (&srcvideotemplate, "video_%u");
+  g_object_set (asfmux, "streamable", TRUE, "copy-packets", TRUE, NULL);
+  fail_unless (gst_element_set_state (asfmux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  pushed = push_video_frames (asfmux, 50, &large);
+
+  /* every packet is a block of memory of its own */
+  fail_unless (g_list_length (buffers) > 1);
+  for (l = buffers->next; l; l = l->next) {
+    muxed += check_data_packet (l->data);
+    fail_unless_equals_int (gst_buffer_n_memory (l->data), 1);
+    fail_if (buffer_references (l->data, large));
+  }
+  fail_unless_equals_uint64 (muxed, pushed);
+  gst_buffer_unref (large);
+
+  cleanup_asfmux (asfmux, "video_%u");
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+}
+
+GST_END_TEST;
+
+/* Checks the data packets received so far and releases them, so that the
+ * buffers of the packet pool get reused. The first buffer ever received
+ * has the headers. */
+static guint64
+check_and_release_data_packets (gboolean * have_headers)
+{
+  guint64 muxed = 0;
+  GList *l;
+
+  for (l = buffers; l; l = l->next) {
+    if (*have_headers)
+      muxed += check_data_packet (l->data);
+    *have_headers = TRUE;
+  }
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  return muxed;
+}
+
+GST_START_TEST (test_data_packets_recycled)
+{
+  GstElement *asfmux;
+  gboolean have_headers = FALSE;
+  guint64 pushed = 0, muxed = 0;
+  guint i;
+
+  asfmux = setup_asfmux (&srcvideotemplate, "video_%u");
+  g_object_set (asfmux, "streamable", TRUE, NULL);
+  fail_unless (gst_element_set_state (asfmux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* enough packets for the media object numbers to wrap around a few times
+   * and the pool buffers to be recycled often */
+  setup_video_events (asfmux);
+  for (i = 0; i < 1000; i++) {
+    GstBuffer *inbuffer = make_video_frame (i);
+
+    pushed += gst_buffer_get_size (inbuffer);
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+    muxed += check_and_release_data_packets (&have_headers);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  muxed += check_and_release_data_packets (&have_headers);
+
+  fail_unless_equals_uint64 (muxed, pushed);
+
+  cleanup_asfmux (asfmux, "video_%u");
+}
+
+GST_END_TEST;
+
 static Suite *
 asfmux_suite (void)
 {
@@ -196,6 +442,9 @@ asfmux_suite (void)
   TCase *tc_chain = tcase_create ("general");
   tcase_add_test (tc_chain, test_video_pad);
   tcase_add_test (tc_chain, test_audio_pad);
+  tcase_add_test (tc_chain, test_data_packets);
+  tcase_add_test (tc_chain, test_data_packets_recycled);
+  tcase_add_test (tc_chain, test_copy_packets);
 
   suite_add_tcase (s, tc_chain);
 
@@ -684,6 +684,253 @@ GST_START_TEST (testReverseSeekSnapAfterPosition)
 
 GST_END_TEST;
 
+/* isoff-on-demand representation with a 'sidx' index of SIDX_SUBSEGMENTS
+ * subsegments of one second, every second one starting with a stream
+ * access point */
+#define SIDX_HEADER_SIZE 1000
+#define SIDX_SUBSEGMENTS 10
+#define SIDX_SUBSEGMENT_SIZE 1000
+#define SIDX_INDEX_SIZE (32 + 12 * SIDX_SUBSEGMENTS)
+#define SIDX_MEDIA_OFFSET (SIDX_HEADER_SIZE + SIDX_INDEX_SIZE)
+#define SIDX_FILE_SIZE \
+    (SIDX_MEDIA_OFFSET + SIDX_SUBSEGMENTS * SIDX_SUBSEGMENT_SIZE)
+#define SIDX_SUBSEGMENT_OFFSET(i) \
+    (SIDX_MEDIA_OFFSET + (i) * SIDX_SUBSEGMENT_SIZE)
+
+typedef struct _GstDashDemuxTestRequest
+{
+  guint64 offset;
+  guint64 size;
+} GstDashDemuxTestRequest;
+
+/* the range requests done for the media file by the sidx tests */
+static GMutex requests_lock;
+static GArray *requests;
+static gboolean new_request;
+
+static gchar *
+make_sidx_mpd (void)
+{
+  return g_strdup_printf ("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+      "<MPD xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\""
+      "     xmlns=\"urn:mpeg:DASH:schema:MPD:2011\""
+      "     xsi:schemaLocation=\"urn:mpeg:DASH:schema:MPD:2011 DASH-MPD.xsd\""
+      "     profiles=\"urn:mpeg:dash:profile:isoff-on-demand:2011\""
+      "     type=\"static\""
+      "     minBufferTime=\"PT1.500S\""
+      "     mediaPresentationDuration=\"PT%dS\">"
+      "  <Period>"
+      "    <AdaptationSet mimeType=\"video/mp4\""
+      "                   subsegmentAlignment=\"true\">"
+      "      <Representation id=\"1\""
+      "                      codecs=\"avc1.4d401e\""
+      "                      width=\"320\""
+      "                      height=\"240\""
+      "                      bandwidth=\"250000\">"
+      "        <BaseURL>video.mp4</BaseURL>"
+      "        <SegmentBase indexRange=\"%d-%d\""
+      "                     indexRangeExact=\"true\">"
+      "          <Initialization range=\"0-%d\" />"
+      "        </SegmentBase>"
+      "      </Representation></AdaptationSet></Period></MPD>",
+      SIDX_SUBSEGMENTS, SIDX_HEADER_SIZE, SIDX_MEDIA_OFFSET - 1,
+      SIDX_HEADER_SIZE - 1);
+}
+
+static guint8 *
+make_sidx_file (void)
+{
+  guint8 *data = g_malloc (SIDX_FILE_SIZE);
+  guint8 *sidx = data + SIDX_HEADER_SIZE;
+  guint i;
+
+  for (i = 0; i < SIDX_FILE_SIZE; i++)
+    data[i] = i % 251;
+
+  /* version 0, timescale 1000 */
+  GST_WRITE_UINT32_BE (sidx, SIDX_INDEX_SIZE);
+  GST_WRITE_UINT32_LE (sidx + 4, GST_MAKE_FOURCC ('s', 'i', 'd', 'x'));
+  GST_WRITE_UINT32_BE (sidx + 8, 0);
+  GST_WRITE_UINT32_BE (sidx + 12, 1);
+  GST_WRITE_UINT32_BE (sidx + 16, 1000);
+  GST_WRITE_UINT32_BE (sidx + 20, 0);
+  GST_WRITE_UINT32_BE (sidx + 24, 0);
+  GST_WRITE_UINT16_BE (sidx + 28, 0);
+  GST_WRITE_UINT16_BE (sidx + 30, SIDX_SUBSEGMENTS);
+  for (i = 0; i < SIDX_SUBSEGMENTS; i++) {
+    guint8 *entry = sidx + 32 + 12 * i;
+
+    GST_WRITE_UINT32_BE (entry, SIDX_SUBSEGMENT_SIZE);
+    GST_WRITE_UINT32_BE (entry + 4, 1000);
+    /* SAP of type 1 */
+    GST_WRITE_UINT32_BE (entry + 8, i % 2 == 0 ? 0x90000000 : 0);
+  }
+
+  return data;
+}
+
+static gboolean
+gst_dashdemux_recording_http_src_start (GstTestHTTPSrc * src,
+    const gchar * uri, GstTestHTTPSrcInput * input_data, gpointer user_data)
+{
+  if (!gst_dashdemux_http_src_start (src, uri, input_data, user_data))
+    return FALSE;
+
+  if (g_str_has_suffix (uri, ".mp4")) {
+    g_mutex_lock (&requests_lock);
+    new_request = TRUE;
+    g_mutex_unlock (&requests_lock);
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_dashdemux_recording_http_src_create (GstTestHTTPSrc * src,
+    guint64 offset,
+    guint length, GstBuffer ** retbuf, gpointer context, gpointer user_data)
+{
+  const GstDashDemuxTestInputData *input =
+      (const GstDashDemuxTestInputData *) context;
+
+  if (g_str_has_suffix (input->uri, ".mp4")) {
+    g_mutex_lock (&requests_lock);
+    /* range requests are done with a seek after starting the source, the
+     * first buffer tells where it starts */
+    if (new_request) {
+      GstDashDemuxTestRequest request = { offset, 0 };
+
+      g_array_append_val (requests, request);
+      new_request = FALSE;
+    }
+    g_array_index (requests, GstDashDemuxTestRequest,
+        requests->len - 1).size += length;
+    g_mutex_unlock (&requests_lock);
+  }
+
+  return gst_dashdemux_http_src_create (src, offset, length, retbuf, context,
+      user_data);
+}
+
+static guint
+count_requests_at (guint64 offset)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < requests->len; i++) {
+    if (g_array_index (requests, GstDashDemuxTestRequest, i).offset == offset)
+      n++;
+  }
+
+  return n;
+}
+
+static void
+assert_request (guint i, guint64 offset, guint64 size)
+{
+  GstDashDemuxTestRequest *request;
+
+  fail_unless (i < requests->len);
+  request = &g_array_index (requests, GstDashDemuxTestRequest, i);
+  fail_unless (request->offset == offset && request->size == size,
+      "request %u is %" G_GUINT64_FORMAT "+%" G_GUINT64_FORMAT ", expected %"
+      G_GUINT64_FORMAT "+%" G_GUINT64_FORMAT, i, request->offset,
+      request->size, offset, size);
+}
+
+/* Plays the sidx indexed representation and issues @seek_event once the
+ * first media byte is out, records the requests for the media file */
+static void
+run_sidx_seek_test (GstEvent * seek_event, guint64 expected_size)
+{
+  gchar *mpd = make_sidx_mpd ();
+  guint8 *file = make_sidx_file ();
+  GstDashDemuxTestInputData inputTestData[] = {
+    {"http://unit.test/test.mpd", (guint8 *) mpd, 0},
+    {"http://unit.test/video.mp4", file, SIDX_FILE_SIZE},
+    {NULL, NULL, 0},
+  };
+  GstTestHTTPSrcCallbacks http_src_callbacks = { 0 };
+  GstAdaptiveDemuxTestExpectedOutput outputTestData[] = {
+    {"video_00", expected_size, file},
+  };
+  GstAdaptiveDemuxTestCase *testData;
+
+  testData = gst_adaptive_demux_test_case_new ();
+
+  http_src_callbacks.src_start = gst_dashdemux_recording_http_src_start;
+  http_src_callbacks.src_create = gst_dashdemux_recording_http_src_create;
+  COPY_OUTPUT_TEST_DATA (outputTestData, testData);
+
+  testData->threshold_for_seek = SIDX_MEDIA_OFFSET + 1;
+  testData->seek_event = seek_event;
+
+  requests = g_array_new (FALSE, FALSE, sizeof (GstDashDemuxTestRequest));
+  new_request = FALSE;
+
+  gst_test_http_src_install_callbacks (&http_src_callbacks, inputTestData);
+  gst_adaptive_demux_test_seek (DEMUX_ELEMENT_NAME,
+      "http://unit.test/test.mpd", testData);
+  gst_object_unref (testData);
+
+  g_free (mpd);
+  g_free (file);
+}
+
+/*
+ * Test that a flushing seek repositions the stream in the index that was
+ * already parsed instead of downloading it again
+ */
+GST_START_TEST (testSeekSidxCache)
+{
+  /* seek into subsegment 5, only the header and the subsegments from there
+   * on are downloaded again */
+  run_sidx_seek_test (gst_event_new_seek (1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 5500 * GST_MSECOND,
+          GST_SEEK_TYPE_NONE, 0),
+      SIDX_HEADER_SIZE + 5 * SIDX_SUBSEGMENT_SIZE);
+
+  fail_unless_equals_int (count_requests_at (SIDX_HEADER_SIZE), 1);
+  fail_unless_equals_int (count_requests_at (0), 2);
+  assert_request (requests->len - 2, 0, SIDX_HEADER_SIZE);
+  assert_request (requests->len - 1, SIDX_SUBSEGMENT_OFFSET (5),
+      5 * SIDX_SUBSEGMENT_SIZE);
+
+  g_array_unref (requests);
+}
+
+GST_END_TEST;
+
+/*
+ * Test that in key unit trick mode only the subsegments starting with a
+ * stream access point are downloaded, each with its own range request
+ */
+GST_START_TEST (testSeekSidxTrickModeKeyUnits)
+{
+  guint i;
+
+  /* subsegment 3 does not start with a SAP, playback restarts from 2 */
+  run_sidx_seek_test (gst_event_new_seek (1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS,
+          GST_SEEK_TYPE_SET, 3500 * GST_MSECOND, GST_SEEK_TYPE_NONE, 0),
+      SIDX_HEADER_SIZE + 4 * SIDX_SUBSEGMENT_SIZE);
+
+  fail_unless_equals_int (count_requests_at (SIDX_HEADER_SIZE), 1);
+  for (i = 1; i < SIDX_SUBSEGMENTS; i += 2)
+    fail_unless_equals_int (count_requests_at (SIDX_SUBSEGMENT_OFFSET (i)), 0);
+
+  fail_unless (requests->len >= 5);
+  assert_request (requests->len - 5, 0, SIDX_HEADER_SIZE);
+  for (i = 0; i < 4; i++) {
+    assert_request (requests->len - 4 + i,
+        SIDX_SUBSEGMENT_OFFSET (2 + 2 * i), SIDX_SUBSEGMENT_SIZE);
+  }
+
+  g_array_unref (requests);
+}
+
+GST_END_TEST;
+
 static void
 testDownloadErrorMessageCallback (GstAdaptiveDemuxTestEngine * engine,
     GstMessage * msg, gpointer user_data)
@@ -1013,6 +1260,8 @@ dash_demux_suite (void)
   tcase_add_test (tc_basicTest, testSeekSnapAfterSamePosition);
   tcase_add_test (tc_basicTest, testReverseSeekSnapBeforePosition);
   tcase_add_test (tc_basicTest, testReverseSeekSnapAfterPosition);
+  tcase_add_test (tc_basicTest, testSeekSidxCache);
+  tcase_add_test (tc_basicTest, testSeekSidxTrickModeKeyUnits);
   tcase_add_test (tc_basicTest, testDownloadError);
   tcase_add_test (tc_basicTest, testFragmentDownloadError);
   tcase_add_test (tc_basicTest, testQuery);
@@ -0,0 +1,251 @@
+/* GStreamer
+ *
+ * unit test for fieldanalysis
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+/* the width is not a multiple of the block width nor of any vector size;
+ * the height gives 6 rows of 16 line blocks */
+#define WIDTH 100
+#define HEIGHT 96
+#define N_FRAMES 10
+
+#define OUTPUT_FLAGS (GST_VIDEO_BUFFER_FLAG_INTERLACED | \
+    GST_VIDEO_BUFFER_FLAG_TFF | GST_VIDEO_BUFFER_FLAG_ONEFIELD | \
+    GST_VIDEO_BUFFER_FLAG_RFF)
+
+static const gchar *methods[] = { "32-detect", "isCombed", "5-tap" };
+
+static const gboolean mixed[N_FRAMES] = {
+  FALSE, FALSE, TRUE, TRUE, FALSE, TRUE, FALSE, FALSE, TRUE, TRUE
+};
+
+static const gboolean all_combed[N_FRAMES] = {
+  TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE
+};
+
+static const gboolean none_combed[N_FRAMES] = { FALSE, };
+
+/* Vertical stripes 8 samples wide moving right by 4 samples per frame,
+ * with a bit of noise. The odd lines of combed frames have the stripes
+ * inverted, which combs every sample. */
+static guint8
+luma_sample (GRand * rand, guint frame, gboolean combed, gint x, gint y)
+{
+  gint phase = (x + 4 * frame) / 8 + (combed && (y & 1));
+
+  return (phase & 1 ? 220 : 30) + g_rand_int_range (rand, -4, 5);
+}
+
+/* I420 frames use the ORC comb masks, the luma of YUY2 frames is strided
+ * and uses the C ones */
+static GstBuffer *
+make_frame (const GstVideoInfo * info, guint frame, gboolean combed)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, info->size, NULL);
+  GRand *rand = g_rand_new_with_seed (frame);
+  GstVideoFrame vframe;
+  gint x, y;
+
+  fail_unless (gst_video_frame_map (&vframe, info, buf, GST_MAP_WRITE));
+  if (GST_VIDEO_INFO_FORMAT (info) == GST_VIDEO_FORMAT_YUY2) {
+    for (y = 0; y < HEIGHT; y++) {
+      guint8 *line = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&vframe, 0) +
+          y * GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, 0);
+
+      for (x = 0; x < WIDTH; x++) {
+        line[2 * x] = luma_sample (rand, frame, combed, x, y);
+        line[2 * x + 1] = 128;
+      }
+    }
+  } else {
+    for (y = 0; y < HEIGHT; y++) {
+      guint8 *line = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&vframe, 0) +
+          y * GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, 0);
+
+      for (x = 0; x < WIDTH; x++)
+        line[x] = luma_sample (rand, frame, combed, x, y);
+    }
+    for (y = 1; y < 3; y++) {
+      memset (GST_VIDEO_FRAME_PLANE_DATA (&vframe, y), 128,
+          GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, y) *
+          GST_VIDEO_FRAME_COMP_HEIGHT (&vframe, y));
+    }
+  }
+  gst_video_frame_unmap (&vframe);
+  g_rand_free (rand);
+
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (frame, GST_SECOND, 25);
+  GST_BUFFER_DURATION (buf) = GST_SECOND / 25;
+
+  return buf;
+}
+
+/* Analyses N_FRAMES frames, the ones in @combed being combed, with the
+ * windowed comb metric and returns the flags of the output buffers */
+static GArray *
+run_fieldanalysis (const gchar * format, const gchar * method, guint threads,
+    guint decimation, const gboolean * combed)
+{
+  GstHarness *h;
+  GstVideoInfo info;
+  GstBuffer *buf;
+  GArray *flags = g_array_new (FALSE, FALSE, sizeof (guint));
+  gchar *caps;
+  guint i;
+
+  h = gst_harness_new ("fieldanalysis");
+  gst_util_set_object_arg (G_OBJECT (h->element), "frame-metric",
+      "windowed-comb");
+  gst_util_set_object_arg (G_OBJECT (h->element), "comb-method", method);
+  g_object_set (h->element, "threads", threads, "decimation", decimation,
+      NULL);
+
+  caps = g_strdup_printf ("video/x-raw, format=(string)%s, width=(int)%d, "
+      "height=(int)%d, framerate=(fraction)25/1", format, WIDTH, HEIGHT);
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (caps);
+
+  gst_video_info_init (&info);
+  gst_video_info_set_format (&info, gst_video_format_from_string (format),
+      WIDTH, HEIGHT);
+  for (i = 0; i < N_FRAMES; i++) {
+    fail_unless_equals_int (gst_harness_push (h, make_frame (&info, i,
+                combed[i])), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (h))) {
+    guint f = GST_BUFFER_FLAGS (buf) & OUTPUT_FLAGS;
+
+    g_array_append_val (flags, f);
+    gst_buffer_unref (buf);
+  }
+  fail_unless (flags->len > 0);
+
+  gst_harness_teardown (h);
+
+  return flags;
+}
+
+static void
+assert_same_flags (GArray * a, GArray * b, const gchar * what)
+{
+  guint i;
+
+  fail_unless_equals_int (a->len, b->len);
+  for (i = 0; i < a->len; i++) {
+    fail_unless (g_array_index (a, guint, i) == g_array_index (b, guint, i),
+        "flags of buffer %u differ for %s", i, what);
+  }
+}
+
+static guint
+count_interlaced (GArray * flags)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < flags->len; i++) {
+    if (g_array_index (flags, guint, i) & GST_VIDEO_BUFFER_FLAG_INTERLACED)
+      n++;
+  }
+
+  return n;
+}
+
+GST_START_TEST (test_orc_matches_c)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (methods); i++) {
+    GArray *orc = run_fieldanalysis ("I420", methods[i], 1, 1, mixed);
+    GArray *c = run_fieldanalysis ("YUY2", methods[i], 1, 1, mixed);
+
+    assert_same_flags (orc, c, methods[i]);
+    fail_if (count_interlaced (orc) == 0, "no combing found with %s",
+        methods[i]);
+
+    g_array_unref (orc);
+    g_array_unref (c);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_threads)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (methods); i++) {
+    GArray *single = run_fieldanalysis ("I420", methods[i], 1, 1, mixed);
+    GArray *multi = run_fieldanalysis ("I420", methods[i], 4, 1, mixed);
+    gchar *what = g_strdup_printf ("%s on 4 threads", methods[i]);
+
+    assert_same_flags (single, multi, what);
+
+    g_free (what);
+    g_array_unref (single);
+    g_array_unref (multi);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decimation)
+{
+  GArray *combed, *progressive, *packed, *multi;
+
+  /* the stripes are still combed with every 2nd column */
+  combed = run_fieldanalysis ("I420", "5-tap", 1, 2, all_combed);
+  fail_if (count_interlaced (combed) == 0);
+  progressive = run_fieldanalysis ("I420", "5-tap", 1, 2, none_combed);
+  fail_unless_equals_int (count_interlaced (progressive), 0);
+
+  /* the luma copy is the same for packed and planar formats */
+  packed = run_fieldanalysis ("YUY2", "5-tap", 1, 2, all_combed);
+  assert_same_flags (combed, packed, "YUY2 with decimation 2");
+
+  multi = run_fieldanalysis ("I420", "5-tap", 4, 2, all_combed);
+  assert_same_flags (combed, multi, "decimation 2 on 4 threads");
+
+  g_array_unref (combed);
+  g_array_unref (progressive);
+  g_array_unref (packed);
+  g_array_unref (multi);
+}
+
+GST_END_TEST;
+
+static Suite *
+fieldanalysis_suite (void)
+{
+  Suite *s = suite_create ("fieldanalysis");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_orc_matches_c);
+  tcase_add_test (tc_chain, test_threads);
+  tcase_add_test (tc_chain, test_decimation);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fieldanalysis);
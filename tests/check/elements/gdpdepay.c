@@ -401,6 +401,150 @@ GST_START_TEST (test_streamheader)
 
 GST_END_TEST;
 
+/* makes a single memory GDP stream of stream-start, caps, segment and a
+ * buffer with @size bytes of @payload_value */
+static GstBuffer *
+create_gdp_stream (GstDPHeaderFlag flags, guint size, guint8 payload_value)
+{
+  GstBuffer *buffer, *inbuffer, *stream;
+  GstEvent *event;
+  GstCaps *caps;
+  GstSegment segment;
+  GstMapInfo map;
+
+  event = gst_event_new_stream_start ("s-s-id-1234");
+  inbuffer = gst_dp_payload_event (event, flags);
+  gst_event_unref (event);
+
+  caps = gst_caps_from_string (AUDIO_CAPS_STRING);
+  inbuffer = gst_buffer_append (inbuffer, gst_dp_payload_caps (caps, flags));
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  event = gst_event_new_segment (&segment);
+  inbuffer = gst_buffer_append (inbuffer, gst_dp_payload_event (event,
+          flags));
+  gst_event_unref (event);
+
+  buffer = gst_buffer_new_and_alloc (size);
+  gst_buffer_memset (buffer, 0, payload_value, size);
+  inbuffer = gst_buffer_append (inbuffer, gst_dp_payload_buffer (buffer,
+          flags));
+  gst_buffer_unref (buffer);
+
+  stream = gst_buffer_new_and_alloc (gst_buffer_get_size (inbuffer));
+  gst_buffer_map (stream, &map, GST_MAP_WRITE);
+  gst_buffer_extract (inbuffer, 0, map.data, map.size);
+  gst_buffer_unmap (stream, &map);
+  gst_buffer_unref (inbuffer);
+
+  return stream;
+}
+
+GST_START_TEST (test_payload_not_copied)
+{
+  GstElement *gdpdepay;
+  GstBuffer *inbuffer, *outbuffer;
+  GstMapInfo inmap, outmap;
+  GstCaps *caps;
+
+  gdpdepay = setup_gdpdepay ();
+
+  fail_unless (gst_element_set_state (gdpdepay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_empty_simple ("application/x-gdp");
+  gst_check_setup_events (mysrcpad, gdpdepay, caps, GST_FORMAT_BYTES);
+  gst_caps_unref (caps);
+
+  inbuffer = create_gdp_stream (GST_DP_HEADER_FLAG_CRC, 1024, 0x42);
+  gst_buffer_map (inbuffer, &inmap, GST_MAP_READ);
+  gst_buffer_ref (inbuffer);
+  fail_unless_equals_int (gst_pad_push (mysrcpad, inbuffer), GST_FLOW_OK);
+
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  outbuffer = (GstBuffer *) buffers->data;
+  buffers = g_list_remove (buffers, outbuffer);
+
+  /* the payload is still in the memory we pushed */
+  fail_unless_equals_int (gst_buffer_get_size (outbuffer), 1024);
+  gst_buffer_map (outbuffer, &outmap, GST_MAP_READ);
+  fail_unless (outmap.data >= inmap.data &&
+      outmap.data + outmap.size <= inmap.data + inmap.size);
+  fail_unless_equals_int (outmap.data[0], 0x42);
+  gst_buffer_unmap (outbuffer, &outmap);
+  gst_buffer_unref (outbuffer);
+
+  gst_buffer_unmap (inbuffer, &inmap);
+  gst_buffer_unref (inbuffer);
+
+  fail_unless (gst_element_set_state (gdpdepay,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+  ASSERT_OBJECT_REFCOUNT (gdpdepay, "gdpdepay", 1);
+  cleanup_gdpdepay (gdpdepay);
+}
+
+GST_END_TEST;
+
+/* pushes a stream with a corrupted payload, returns the number of buffers
+ * that came out */
+static guint
+push_corrupted_stream (gboolean check_crc, GstFlowReturn expected)
+{
+  GstElement *gdpdepay;
+  GstBuffer *inbuffer;
+  GstMapInfo map;
+  GstCaps *caps;
+  guint n_buffers;
+
+  gdpdepay = setup_gdpdepay ();
+  g_object_set (gdpdepay, "check-crc", check_crc, NULL);
+
+  fail_unless (gst_element_set_state (gdpdepay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_empty_simple ("application/x-gdp");
+  gst_check_setup_events (mysrcpad, gdpdepay, caps, GST_FORMAT_BYTES);
+  gst_caps_unref (caps);
+
+  /* flip the last byte of the payload */
+  inbuffer = create_gdp_stream (GST_DP_HEADER_FLAG_CRC, 64, 0x42);
+  gst_buffer_map (inbuffer, &map, GST_MAP_WRITE);
+  map.data[map.size - 1] ^= 0xff;
+  gst_buffer_unmap (inbuffer, &map);
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, inbuffer), expected);
+  n_buffers = g_list_length (buffers);
+
+  fail_unless (gst_element_set_state (gdpdepay,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+  ASSERT_OBJECT_REFCOUNT (gdpdepay, "gdpdepay", 1);
+  cleanup_gdpdepay (gdpdepay);
+
+  return n_buffers;
+}
+
+GST_START_TEST (test_payload_crc)
+{
+  /* the corruption is detected when checking the CRC */
+  fail_unless_equals_int (push_corrupted_stream (TRUE, GST_FLOW_ERROR), 0);
+
+  /* and the buffer passes when not */
+  fail_unless_equals_int (push_corrupted_stream (FALSE, GST_FLOW_OK), 1);
+}
+
+GST_END_TEST;
+
 static Suite *
 gdpdepay_suite (void)
 {
@@ -411,6 +555,8 @@ gdpdepay_suite (void)
   tcase_add_test (tc_chain, test_audio_per_byte);
   tcase_add_test (tc_chain, test_audio_in_one_buffer);
   tcase_add_test (tc_chain, test_streamheader);
+  tcase_add_test (tc_chain, test_payload_not_copied);
+  tcase_add_test (tc_chain, test_payload_crc);
 
   return s;
 }
@@ -556,6 +556,124 @@ GST_START_TEST (test_crc)
 
 GST_END_TEST;
 
+/* bit by bit version of the CRC */
+static guint16
+crc_reference (const guint8 * data, guint length)
+{
+  guint16 crc = CRC_INIT;
+  gint i;
+
+  if (length == 0)
+    return 0;
+
+  while (length--) {
+    crc ^= *data++ << 8;
+    for (i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ POLY : crc << 1;
+  }
+
+  return 0xffff ^ crc;
+}
+
+GST_START_TEST (test_crc_sliced)
+{
+  guint8 data[1024];
+  guint i, length;
+
+  for (i = 0; i < sizeof (data); i++)
+    data[i] = g_random_int () & 0xff;
+
+  for (length = 0; length <= sizeof (data); length += 1 + length / 16) {
+    fail_unless_equals_int (gst_dp_crc (data, length),
+        crc_reference (data, length));
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffer_list)
+{
+  GstCaps *caps;
+  GstElement *gdppay;
+  GstBuffer *inbuffer, *outbuffer;
+  GstBufferList *list;
+  GstMapInfo map;
+  guint64 offset;
+  guint i;
+
+  gdppay = setup_gdppay ();
+  g_object_set (gdppay, "crc-payload", TRUE, NULL);
+
+  fail_unless (gst_element_set_state (gdppay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (AUDIO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, gdppay, caps, GST_FORMAT_TIME);
+
+  /* a first buffer gets the streamheader out */
+  inbuffer = gst_buffer_new_and_alloc (4);
+  gst_buffer_memset (inbuffer, 0, 0, 4);
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+
+  fail_unless_equals_int (g_list_length (buffers), 4);
+  check_stream_start_buffer (1);
+  check_caps_buffer (1, caps);
+  check_segment_buffer (1);
+  outbuffer = (GstBuffer *) buffers->data;
+  buffers = g_list_remove (buffers, outbuffer);
+  offset = GST_BUFFER_OFFSET_END (outbuffer);
+  gst_buffer_unref (outbuffer);
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < 3; i++) {
+    inbuffer = gst_buffer_new_and_alloc (8 * (i + 1));
+    gst_buffer_memset (inbuffer, 0, i, 8 * (i + 1));
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND;
+    gst_buffer_list_add (list, inbuffer);
+  }
+  fail_unless (gst_pad_push_list (mysrcpad, list) == GST_FLOW_OK);
+
+  fail_unless_equals_int (g_list_length (buffers), 3);
+  for (i = 0; i < 3; i++) {
+    guint8 *payload;
+
+    outbuffer = (GstBuffer *) buffers->data;
+    buffers = g_list_remove (buffers, outbuffer);
+
+    fail_unless_equals_int (gst_buffer_get_size (outbuffer),
+        GST_DP_HEADER_LENGTH + 8 * (i + 1));
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (outbuffer), offset);
+    fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer),
+        i * GST_SECOND);
+    offset = GST_BUFFER_OFFSET_END (outbuffer);
+
+    gst_buffer_map (outbuffer, &map, GST_MAP_READ);
+    fail_unless (gst_dp_validate_header (GST_DP_HEADER_LENGTH, map.data));
+    fail_unless_equals_int (gst_dp_header_payload_length (map.data),
+        8 * (i + 1));
+    payload = map.data + GST_DP_HEADER_LENGTH;
+    fail_unless (gst_dp_validate_payload (GST_DP_HEADER_LENGTH, map.data,
+            payload));
+    fail_unless_equals_int (payload[0], i);
+    gst_buffer_unmap (outbuffer, &map);
+
+    gst_buffer_unref (outbuffer);
+  }
+
+  fail_unless (gst_element_set_state (gdppay,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+
+  gst_caps_unref (caps);
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+  ASSERT_OBJECT_REFCOUNT (gdppay, "gdppay", 1);
+  cleanup_gdppay (gdppay);
+}
+
+GST_END_TEST;
+
 
 static Suite *
 gdppay_suite (void)
@@ -569,6 +687,8 @@ gdppay_suite (void)
   tcase_add_test (tc_chain, test_first_no_new_segment);
   tcase_add_test (tc_chain, test_streamheader);
   tcase_add_test (tc_chain, test_crc);
+  tcase_add_test (tc_chain, test_crc_sliced);
+  tcase_add_test (tc_chain, test_buffer_list);
 
   return s;
 }
@@ -24,6 +24,7 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 #include "parser.h"
 
 #define SRC_CAPS_TMPL   "video/x-h264, parsed=(boolean)false"
@@ -416,6 +417,332 @@ h264parse_packetized_suite (void)
 }
 
 
+/* Two baseline streams with their own SPS/PPS ids: 64x48 using SPS 0 and
+ * PPS 0, and 128x96 using SPS 1 and PPS 1 */
+static guint8 h264_sps_0[] = {
+  0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1e, 0xda, 0x11, 0xe4
+};
+
+static guint8 h264_pps_0[] = {
+  0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80
+};
+
+static guint8 h264_idr_0[] = {
+  0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0xa5, 0xa5, 0xa8
+};
+
+static guint8 h264_sps_1[] = {
+  0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1e, 0x56, 0x82, 0x0d, 0x90
+};
+
+static guint8 h264_pps_1[] = {
+  0x00, 0x00, 0x00, 0x01, 0x68, 0x48, 0xe3, 0xc8
+};
+
+static guint8 h264_idr_1[] = {
+  0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x41, 0x29, 0x69, 0x6a
+};
+
+static GstBuffer *
+make_access_unit (const guint8 * sps, gsize sps_size, const guint8 * pps,
+    gsize pps_size, const guint8 * idr, gsize idr_size)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL,
+      sps_size + pps_size + idr_size, NULL);
+
+  gst_buffer_fill (buf, 0, sps, sps_size);
+  gst_buffer_fill (buf, sps_size, pps, pps_size);
+  gst_buffer_fill (buf, sps_size + pps_size, idr, idr_size);
+
+  return buf;
+}
+
+#define make_access_unit_for(n) \
+  make_access_unit (h264_sps_##n, sizeof (h264_sps_##n), h264_pps_##n, \
+      sizeof (h264_pps_##n), h264_idr_##n, sizeof (h264_idr_##n))
+
+GST_START_TEST (test_parse_switch_repeated_sps)
+{
+  GstHarness *h = gst_harness_new ("h264parse");
+  GstEvent *event;
+  guint64 reused;
+  gint widths[3], n_caps = 0;
+
+  gst_harness_set_src_caps_str (h, "video/x-h264, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  fail_unless_equals_int (gst_harness_push (h, make_access_unit_for (0)),
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h, make_access_unit_for (1)),
+      GST_FLOW_OK);
+  /* switches back to the stored SPS 0, which is not parsed again but must
+   * still update the caps */
+  fail_unless_equals_int (gst_harness_push (h, make_access_unit_for (0)),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_received (h), 3);
+
+  while ((event = gst_harness_try_pull_event (h))) {
+    /* the caps set before any SPS was seen carry no size */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      GstCaps *caps;
+      gint width;
+
+      gst_event_parse_caps (event, &caps);
+      if (gst_structure_get_int (gst_caps_get_structure (caps, 0), "width",
+              &width)) {
+        fail_unless (n_caps < G_N_ELEMENTS (widths));
+        widths[n_caps++] = width;
+      }
+    }
+    gst_event_unref (event);
+  }
+
+  fail_unless_equals_int (n_caps, 3);
+  fail_unless_equals_int (widths[0], 64);
+  fail_unless_equals_int (widths[1], 128);
+  fail_unless_equals_int (widths[2], 64);
+
+  /* the PPS hashes were dropped when SPS 1 was stored, so only the SPS was
+   * reused */
+  g_object_get (h->element, "reused-headers", &reused, NULL);
+  fail_unless_equals_uint64 (reused, 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Minimal bit writer for building parameter sets and slice headers */
+typedef struct
+{
+  guint8 data[64];
+  guint bit;
+} BitWriter;
+
+static void
+put_bits (BitWriter * bw, guint32 val, guint nbits)
+{
+  while (nbits--) {
+    fail_unless (bw->bit < sizeof (bw->data) * 8);
+    if ((val >> nbits) & 1)
+      bw->data[bw->bit / 8] |= 0x80 >> (bw->bit % 8);
+    bw->bit++;
+  }
+}
+
+/* se(v) 0 is coded the same way as ue(v) 0 */
+static void
+put_ue (BitWriter * bw, guint32 val)
+{
+  guint nbits = g_bit_storage (val + 1);
+
+  put_bits (bw, 0, nbits - 1);
+  put_bits (bw, val + 1, nbits);
+}
+
+/* Appends the RBSP in @bw with trailing bits as a NAL unit with a start
+ * code, inserting emulation prevention bytes */
+static void
+append_nal (GByteArray * au, guint8 header, BitWriter * bw)
+{
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+  guint i, zeros = 0;
+
+  put_bits (bw, 1, 1);
+  if (bw->bit % 8)
+    put_bits (bw, 0, 8 - bw->bit % 8);
+
+  g_byte_array_append (au, start_code, sizeof (start_code));
+  g_byte_array_append (au, &header, 1);
+  for (i = 0; i < bw->bit / 8; i++) {
+    if (zeros == 2 && bw->data[i] <= 0x03) {
+      static const guint8 epb = 0x03;
+
+      g_byte_array_append (au, &epb, 1);
+      zeros = 0;
+    }
+    g_byte_array_append (au, &bw->data[i], 1);
+    zeros = bw->data[i] ? 0 : zeros + 1;
+  }
+}
+
+/* 64 pixels wide and 25 frames per second, with field pictures allowed if
+ * not @frame_mbs_only */
+static void
+append_sps (GByteArray * au, guint id, gboolean frame_mbs_only)
+{
+  BitWriter bw = { {0,}, 0 };
+
+  put_bits (&bw, 77, 8);        /* profile_idc */
+  put_bits (&bw, 0, 8);         /* constraint flags */
+  put_bits (&bw, 30, 8);        /* level_idc */
+  put_ue (&bw, id);
+  put_ue (&bw, 0);              /* log2_max_frame_num_minus4 */
+  put_ue (&bw, 2);              /* pic_order_cnt_type */
+  put_ue (&bw, 1);              /* max_num_ref_frames */
+  put_bits (&bw, 0, 1);         /* gaps_in_frame_num_value_allowed_flag */
+  put_ue (&bw, 3);              /* pic_width_in_mbs_minus1 */
+  put_ue (&bw, frame_mbs_only ? 2 : 1); /* pic_height_in_map_units_minus1 */
+  put_bits (&bw, frame_mbs_only, 1);
+  if (!frame_mbs_only)
+    put_bits (&bw, 0, 1);       /* mb_adaptive_frame_field_flag */
+  put_bits (&bw, 1, 1);         /* direct_8x8_inference_flag */
+  put_bits (&bw, 0, 1);         /* frame_cropping_flag */
+  put_bits (&bw, 1, 1);         /* vui_parameters_present_flag */
+  put_bits (&bw, 0, 4);         /* aspect ratio, overscan, signal, chroma */
+  put_bits (&bw, 1, 1);         /* timing_info_present_flag */
+  put_bits (&bw, 1, 32);        /* num_units_in_tick */
+  put_bits (&bw, 50, 32);       /* time_scale */
+  put_bits (&bw, 1, 1);         /* fixed_frame_rate_flag */
+  put_bits (&bw, 0, 4);         /* HRD, pic_struct, bitstream restriction */
+
+  append_nal (au, 0x67, &bw);
+}
+
+static void
+append_pps (GByteArray * au, guint id, guint sps_id)
+{
+  BitWriter bw = { {0,}, 0 };
+
+  put_ue (&bw, id);
+  put_ue (&bw, sps_id);
+  put_bits (&bw, 0, 2);         /* CAVLC, bottom_field_pic_order... */
+  put_ue (&bw, 0);              /* num_slice_groups_minus1 */
+  put_ue (&bw, 0);              /* num_ref_idx_l0_default_active_minus1 */
+  put_ue (&bw, 0);              /* num_ref_idx_l1_default_active_minus1 */
+  put_bits (&bw, 0, 3);         /* weighted_pred_flag, weighted_bipred_idc */
+  put_ue (&bw, 0);              /* pic_init_qp_minus26 */
+  put_ue (&bw, 0);              /* pic_init_qs_minus26 */
+  put_ue (&bw, 0);              /* chroma_qp_index_offset */
+  put_bits (&bw, 1, 1);         /* deblocking_filter_control_present_flag */
+  put_bits (&bw, 0, 2);         /* constrained_intra_pred, redundant_pic_cnt */
+
+  append_nal (au, 0x68, &bw);
+}
+
+/* A field slice of a picture using PPS @pps_id */
+static void
+append_field_slice (GByteArray * au, gboolean idr, guint slice_type,
+    guint pps_id, guint frame_num, gboolean bottom)
+{
+  BitWriter bw = { {0,}, 0 };
+
+  put_ue (&bw, 0);              /* first_mb_in_slice */
+  put_ue (&bw, slice_type);
+  put_ue (&bw, pps_id);
+  put_bits (&bw, frame_num, 4);
+  put_bits (&bw, 1, 1);         /* field_pic_flag */
+  put_bits (&bw, bottom, 1);
+  if (idr)
+    put_ue (&bw, 0);            /* idr_pic_id */
+  if (slice_type % 5 == 0)     /* P slice */
+    put_bits (&bw, 0, 2);       /* no ref count override or list changes */
+  put_bits (&bw, 0, idr ? 2 : 1);       /* dec_ref_pic_marking */
+  put_ue (&bw, 0);              /* slice_qp_delta */
+  put_ue (&bw, 1);              /* disable_deblocking_filter_idc */
+  put_bits (&bw, 0xa5a5, 16);   /* some slice data */
+
+  append_nal (au, idr ? 0x65 : 0x41, &bw);
+}
+
+static GstBuffer *
+byte_array_to_buffer (GByteArray * au)
+{
+  gsize size = au->len;
+
+  return gst_buffer_new_wrapped (g_byte_array_free (au, FALSE), size);
+}
+
+/* Pushes field coded pictures whose SPS is not the last one received and
+ * returns the output buffers */
+static GList *
+run_fields (gboolean fast_scan)
+{
+  GstHarness *h = gst_harness_new ("h264parse");
+  GByteArray *au;
+  GstBuffer *buf;
+  GList *out = NULL;
+  guint i;
+
+  g_object_set (h->element, "fast-scan", fast_scan, NULL);
+  gst_harness_set_src_caps_str (h, "video/x-h264, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  /* the pictures use PPS 1 and the interlaced SPS 1, but the progressive
+   * SPS 0 is received last */
+  au = g_byte_array_new ();
+  append_sps (au, 1, FALSE);
+  append_pps (au, 1, 1);
+  append_sps (au, 0, TRUE);
+  append_pps (au, 0, 0);
+  append_field_slice (au, TRUE, 7, 1, 0, FALSE);
+  fail_unless_equals_int (gst_harness_push (h, byte_array_to_buffer (au)),
+      GST_FLOW_OK);
+
+  for (i = 1; i < 4; i++) {
+    au = g_byte_array_new ();
+    /* the fields of a frame share its frame_num */
+    append_field_slice (au, FALSE, i == 1 ? 7 : 5, 1, i / 2, i % 2);
+    fail_unless_equals_int (gst_harness_push (h, byte_array_to_buffer (au)),
+        GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (h)))
+    out = g_list_append (out, buf);
+
+  gst_harness_teardown (h);
+
+  return out;
+}
+
+GST_START_TEST (test_parse_fast_scan_fields)
+{
+  GList *normal = run_fields (FALSE);
+  GList *fast = run_fields (TRUE);
+  GList *n, *f;
+  guint i = 0;
+
+  fail_unless_equals_int (g_list_length (normal), 4);
+  fail_unless_equals_int (g_list_length (fast), 4);
+
+  for (n = normal, f = fast; n && f; n = n->next, f = f->next, i++) {
+    GstBuffer *nbuf = n->data, *fbuf = f->data;
+
+    /* every field lasts one tick */
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (nbuf), 20 * GST_MSECOND);
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (fbuf),
+        GST_BUFFER_DURATION (nbuf));
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (fbuf), GST_BUFFER_PTS (nbuf));
+
+    /* the non-IDR I field is a key unit in both modes */
+    fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (nbuf,
+            GST_BUFFER_FLAG_DELTA_UNIT), i > 1);
+    fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (fbuf,
+            GST_BUFFER_FLAG_DELTA_UNIT), i > 1);
+  }
+
+  g_list_free_full (normal, (GDestroyNotify) gst_buffer_unref);
+  g_list_free_full (fast, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_END_TEST;
+
+static Suite *
+h264parse_parameter_sets_suite (void)
+{
+  Suite *s = suite_create ("h264parse_parameter_sets");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_switch_repeated_sps);
+  tcase_add_test (tc_chain, test_parse_fast_scan_fields);
+
+  return s;
+}
+
 /*
  * TODO:
  *   - Both push- and pull-modes need to be tested
@@ -522,5 +849,11 @@ main (int argc, char **argv)
   nf += srunner_ntests_failed (sr);
   srunner_free (sr);
 
+  s = h264parse_parameter_sets_suite ();
+  sr = srunner_create (s);
+  srunner_run_all (sr, CK_NORMAL);
+  nf += srunner_ntests_failed (sr);
+  srunner_free (sr);
+
   return nf;
 }
@@ -252,6 +252,131 @@ gst_hlsdemux_test_network_error_src_create (GstTestHTTPSrc * src,
       user_data);
 }
 
+/* AES-128 encryption to produce encrypted segments, the demuxer decrypts
+ * them with whatever crypto library it was built with */
+static const guint8 aes_sbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+  0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+  0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+  0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+  0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+  0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+  0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+  0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+  0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+  0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+  0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+  0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+  0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+  0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+  0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+  0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+  0xb0, 0x54, 0xbb, 0x16,
+};
+
+static guint8
+aes_xtime (guint8 x)
+{
+  return (x << 1) ^ ((x & 0x80) ? 0x1b : 0x00);
+}
+
+static void
+aes128_expand_key (const guint8 * key, guint8 * round_keys)
+{
+  guint8 rcon = 0x01;
+  guint i;
+
+  memcpy (round_keys, key, 16);
+  for (i = 16; i < 176; i += 4) {
+    guint8 t[4];
+
+    memcpy (t, round_keys + i - 4, 4);
+    if (i % 16 == 0) {
+      guint8 t0 = t[0];
+
+      t[0] = aes_sbox[t[1]] ^ rcon;
+      t[1] = aes_sbox[t[2]];
+      t[2] = aes_sbox[t[3]];
+      t[3] = aes_sbox[t0];
+      rcon = aes_xtime (rcon);
+    }
+    round_keys[i + 0] = round_keys[i - 16 + 0] ^ t[0];
+    round_keys[i + 1] = round_keys[i - 16 + 1] ^ t[1];
+    round_keys[i + 2] = round_keys[i - 16 + 2] ^ t[2];
+    round_keys[i + 3] = round_keys[i - 16 + 3] ^ t[3];
+  }
+}
+
+static void
+aes128_encrypt_block (const guint8 * round_keys, guint8 * state)
+{
+  guint round, i;
+
+  for (i = 0; i < 16; i++)
+    state[i] ^= round_keys[i];
+
+  for (round = 1; round <= 10; round++) {
+    guint8 s[16];
+
+    /* SubBytes and ShiftRows, the state is stored column by column */
+    for (i = 0; i < 16; i++)
+      s[i] = aes_sbox[state[(i + 4 * (i % 4)) % 16]];
+
+    /* MixColumns, except in the last round */
+    for (i = 0; i < 16; i += 4) {
+      if (round < 10) {
+        guint8 a0 = s[i], a1 = s[i + 1], a2 = s[i + 2], a3 = s[i + 3];
+        guint8 all = a0 ^ a1 ^ a2 ^ a3;
+
+        state[i] = a0 ^ all ^ aes_xtime (a0 ^ a1);
+        state[i + 1] = a1 ^ all ^ aes_xtime (a1 ^ a2);
+        state[i + 2] = a2 ^ all ^ aes_xtime (a2 ^ a3);
+        state[i + 3] = a3 ^ all ^ aes_xtime (a3 ^ a0);
+      } else {
+        memcpy (state + i, s + i, 4);
+      }
+    }
+
+    for (i = 0; i < 16; i++)
+      state[i] ^= round_keys[16 * round + i];
+  }
+}
+
+/* Encrypts @data in CBC mode, with PKCS#7 padding unless @size is already a
+ * multiple of the block size and @pad is FALSE */
+static GByteArray *
+aes128_cbc_encrypt (const guint8 * key, const guint8 * iv,
+    const guint8 * data, gsize size, gboolean pad)
+{
+  guint8 round_keys[176];
+  guint8 padding = pad ? 16 - size % 16 : 0;
+  GByteArray *out;
+  const guint8 *prev = iv;
+  gsize i, j;
+
+  aes128_expand_key (key, round_keys);
+
+  out = g_byte_array_sized_new (size + padding);
+  g_byte_array_append (out, data, size);
+  for (i = 0; i < padding; i++)
+    g_byte_array_append (out, &padding, 1);
+  fail_unless (out->len % 16 == 0);
+
+  for (i = 0; i < out->len; i += 16) {
+    for (j = 0; j < 16; j++)
+      out->data[i + j] ^= prev[j];
+    aes128_encrypt_block (round_keys, out->data + i);
+    prev = out->data + i;
+  }
+
+  return out;
+}
+
 /******************** Test specific code starts here **************************/
 
 /*
@@ -713,6 +838,148 @@ GST_START_TEST (testFragmentDownloadError)
 
 GST_END_TEST;
 
+static const guint8 test_aes_key[16] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+static const guint8 test_aes_iv[16] = {
+  0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87,
+  0x78, 0x69, 0x5a, 0x4b, 0x3c, 0x2d, 0x1e, 0x0f
+};
+
+#define TEST_AES_IV_ATTRIBUTE "IV=0xf0e1d2c3b4a5968778695a4b3c2d1e0f"
+
+/* test decrypting an AES-128 encrypted segment */
+GST_START_TEST (testAes128Decryption)
+{
+  const guint segment_size = 30 * TS_PACKET_LEN;
+  const gchar *manifest =
+      "#EXTM3U \n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-KEY:METHOD=AES-128,URI=\"key.bin\"," TEST_AES_IV_ATTRIBUTE "\n"
+      "#EXTINF:1,Test\n" "001.ts\n" "#EXT-X-ENDLIST\n";
+  GstHlsDemuxTestInputData inputTestData[] = {
+    {"http://unit.test/media.m3u8", (guint8 *) manifest, 0},
+    {"http://unit.test/key.bin", test_aes_key, sizeof (test_aes_key)},
+    {"http://unit.test/001.ts", NULL, 0},
+    {NULL, NULL, 0},
+  };
+  GstAdaptiveDemuxTestExpectedOutput outputTestData[] = {
+    {"src_0", segment_size, NULL},
+    {NULL, 0, NULL}
+  };
+  GByteArray *encrypted;
+  TESTCASE_INIT_BOILERPLATE (segment_size);
+
+  /* the demuxer has to output the clear stream, without the padding */
+  encrypted = aes128_cbc_encrypt (test_aes_key, test_aes_iv, mpeg_ts->data,
+      segment_size, TRUE);
+  fail_unless_equals_int (encrypted->len, segment_size + 8);
+  inputTestData[2].payload = encrypted->data;
+  inputTestData[2].size = encrypted->len;
+
+  http_src_callbacks.src_start = gst_hlsdemux_test_src_start;
+  http_src_callbacks.src_create = gst_hlsdemux_test_src_create;
+  engine_callbacks.appsink_received_data =
+      gst_adaptive_demux_test_check_received_data;
+  engine_callbacks.appsink_eos =
+      gst_adaptive_demux_test_check_size_of_received_data;
+
+  gst_test_http_src_install_callbacks (&http_src_callbacks, &hlsTestCase);
+  gst_adaptive_demux_test_run (DEMUX_ELEMENT_NAME,
+      inputTestData[0].uri, &engine_callbacks, engineTestData);
+
+  g_byte_array_free (encrypted, TRUE);
+  TESTCASE_UNREF_BOILERPLATE;
+}
+
+GST_END_TEST;
+
+/* test that a padding byte of 0 is rejected instead of being stripped */
+GST_START_TEST (testAes128InvalidPadding)
+{
+  /* a multiple of the AES block size, so nothing needs to be padded */
+  const guint segment_size = 32 * TS_PACKET_LEN;
+  const gchar *manifest =
+      "#EXTM3U \n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-KEY:METHOD=AES-128,URI=\"key.bin\"," TEST_AES_IV_ATTRIBUTE "\n"
+      "#EXTINF:1,Test\n" "001.ts\n" "#EXT-X-ENDLIST\n";
+  GstHlsDemuxTestInputData inputTestData[] = {
+    {"http://unit.test/media.m3u8", (guint8 *) manifest, 0},
+    {"http://unit.test/key.bin", test_aes_key, sizeof (test_aes_key)},
+    {"http://unit.test/001.ts", NULL, 0},
+    {NULL, NULL, 0},
+  };
+  GstAdaptiveDemuxTestExpectedOutput outputTestData[] = {
+    {"src_0", segment_size, NULL},
+    {NULL, 0, NULL}
+  };
+  GByteArray *encrypted;
+  TESTCASE_INIT_BOILERPLATE (segment_size);
+
+  mpeg_ts->data[segment_size - 1] = 0x00;
+  encrypted = aes128_cbc_encrypt (test_aes_key, test_aes_iv, mpeg_ts->data,
+      segment_size, FALSE);
+  fail_unless_equals_int (encrypted->len, segment_size);
+  inputTestData[2].payload = encrypted->data;
+  inputTestData[2].size = encrypted->len;
+
+  http_src_callbacks.src_start = gst_hlsdemux_test_src_start;
+  http_src_callbacks.src_create = gst_hlsdemux_test_src_create;
+  engine_callbacks.appsink_received_data =
+      gst_adaptive_demux_test_check_received_data;
+  engine_callbacks.bus_error_message = testDownloadErrorMessageCallback;
+
+  gst_test_http_src_install_callbacks (&http_src_callbacks, &hlsTestCase);
+  gst_adaptive_demux_test_run (DEMUX_ELEMENT_NAME,
+      inputTestData[0].uri, &engine_callbacks, engineTestData);
+
+  g_byte_array_free (encrypted, TRUE);
+  TESTCASE_UNREF_BOILERPLATE;
+}
+
+GST_END_TEST;
+
+/* test that segments encrypted with an unknown method are not pushed as
+ * clear data */
+GST_START_TEST (testUnsupportedKeyMethod)
+{
+  const guint segment_size = 30 * TS_PACKET_LEN;
+  const gchar *manifest =
+      "#EXTM3U \n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-KEY:METHOD=SAMPLE-AES-CTR,URI=\"key.bin\"\n"
+      "#EXTINF:1,Test\n" "001.ts\n" "#EXT-X-ENDLIST\n";
+  GstHlsDemuxTestInputData inputTestData[] = {
+    {"http://unit.test/media.m3u8", (guint8 *) manifest, 0},
+    {"http://unit.test/key.bin", test_aes_key, sizeof (test_aes_key)},
+    {"http://unit.test/001.ts", NULL, segment_size},
+    {NULL, NULL, 0},
+  };
+  GstAdaptiveDemuxTestExpectedOutput outputTestData[] = {
+    {"src_0", 0, NULL},
+    {NULL, 0, NULL}
+  };
+  TESTCASE_INIT_BOILERPLATE (segment_size);
+
+  http_src_callbacks.src_start = gst_hlsdemux_test_src_start;
+  http_src_callbacks.src_create = gst_hlsdemux_test_src_create;
+  engine_callbacks.appsink_received_data =
+      gst_adaptive_demux_test_check_received_data;
+  engine_callbacks.appsink_eos = hlsdemux_test_check_no_data_received;
+  engine_callbacks.bus_error_message = testDownloadErrorMessageCallback;
+
+  gst_test_http_src_install_callbacks (&http_src_callbacks, &hlsTestCase);
+  gst_adaptive_demux_test_run (DEMUX_ELEMENT_NAME,
+      inputTestData[0].uri, &engine_callbacks, engineTestData);
+
+  TESTCASE_UNREF_BOILERPLATE;
+}
+
+GST_END_TEST;
+
 static Suite *
 hls_demux_suite (void)
 {
@@ -724,6 +991,9 @@ hls_demux_suite (void)
   tcase_add_test (tc_basicTest, testMediaPlaylistNotFound);
   tcase_add_test (tc_basicTest, testFragmentNotFound);
   tcase_add_test (tc_basicTest, testFragmentDownloadError);
+  tcase_add_test (tc_basicTest, testAes128Decryption);
+  tcase_add_test (tc_basicTest, testAes128InvalidPadding);
+  tcase_add_test (tc_basicTest, testUnsupportedKeyMethod);
   tcase_add_test (tc_basicTest, testSeek);
   tcase_add_test (tc_basicTest, testSeekKeyUnitPosition);
   tcase_add_test (tc_basicTest, testSeekPosition);
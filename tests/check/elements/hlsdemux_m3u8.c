@@ -300,6 +300,22 @@ http://media.example.com/mid/video-only-004.ts\n\
 http://media.example.com/mid/video-only-005.ts\n\
 #EXT-X-ENDLIST";
 
+static const gchar *SAMPLE_AES_ENCRYPTED_PLAYLIST = "#EXTM3U \n\
+#EXT-X-TARGETDURATION:10\n\
+#EXT-X-KEY:METHOD=SAMPLE-AES,URI=\"https://priv.example.com/key.bin\",IV=0x00000000000000000000000000000001\n\
+#EXTINF:10,Test\n\
+http://media.example.com/mid/video-only-001.ts\n\
+#EXT-X-KEY:METHOD=AES-128,URI=\"https://priv.example.com/key2.bin\"\n\
+#EXTINF:10,Test\n\
+http://media.example.com/mid/video-only-002.ts\n\
+#EXT-X-KEY:METHOD=NONE,URI=\"https://priv.example.com/key3.bin\"\n\
+#EXTINF:10,Test\n\
+http://media.example.com/mid/video-only-003.ts\n\
+#EXT-X-KEY:METHOD=SAMPLE-AES-CTR,URI=\"https://priv.example.com/key4.bin\"\n\
+#EXTINF:10,Test\n\
+http://media.example.com/mid/video-only-004.ts\n\
+#EXT-X-ENDLIST";
+
 static const gchar *WINDOWS_LINE_ENDINGS_PLAYLIST = "#EXTM3U \r\n\
 #EXT-X-TARGETDURATION:10\r\n\
 #EXTINF:10,Test\r\n\
@@ -561,7 +577,7 @@ GST_START_TEST (test_live_playlist_rotated)
   ret = gst_m3u8_client_update (client, g_strdup (LIVE_ROTATED_PLAYLIST));
   assert_equals_int (ret, TRUE);
   gst_m3u8_client_get_next_fragment (client, NULL, NULL, NULL, NULL, NULL, NULL,
-      NULL, NULL, TRUE);
+      NULL, NULL, NULL, TRUE);
   /* FIXME: Sequence should last - 3. Should it? */
   assert_equals_int (client->sequence, 3001);
   /* Check first media segments */
@@ -645,6 +661,56 @@ GST_START_TEST (test_playlist_with_encryption)
 
 GST_END_TEST;
 
+GST_START_TEST (test_playlist_with_sample_aes)
+{
+  GstM3U8Client *client;
+  GstM3U8 *pl;
+  GstM3U8MediaFile *file;
+  GstM3U8KeyMethod method;
+  gchar *key;
+  guint8 *iv;
+  guint8 iv1[16] = { 0, };
+
+  iv1[15] = 1;
+
+  client = load_playlist (SAMPLE_AES_ENCRYPTED_PLAYLIST);
+
+  pl = client->current;
+  assert_equals_int (g_list_length (pl->files), 4);
+
+  file = GST_M3U8_MEDIA_FILE (g_list_nth_data (pl->files, 0));
+  assert_equals_string (file->key, "https://priv.example.com/key.bin");
+  assert_equals_int (file->key_method, GST_M3U8_KEY_METHOD_SAMPLE_AES);
+  fail_unless (memcmp (&file->iv, iv1, 16) == 0);
+
+  file = GST_M3U8_MEDIA_FILE (g_list_nth_data (pl->files, 1));
+  assert_equals_string (file->key, "https://priv.example.com/key2.bin");
+  assert_equals_int (file->key_method, GST_M3U8_KEY_METHOD_AES_128);
+
+  /* METHOD=NONE ignores the URI */
+  file = GST_M3U8_MEDIA_FILE (g_list_nth_data (pl->files, 2));
+  fail_unless (file->key == NULL);
+  assert_equals_int (file->key_method, GST_M3U8_KEY_METHOD_NONE);
+
+  /* Unsupported methods must neither be mistaken for AES-128 nor for clear
+   * segments */
+  file = GST_M3U8_MEDIA_FILE (g_list_nth_data (pl->files, 3));
+  assert_equals_string (file->key, "https://priv.example.com/key4.bin");
+  assert_equals_int (file->key_method, GST_M3U8_KEY_METHOD_UNSUPPORTED);
+
+  fail_unless (gst_m3u8_client_get_next_fragment (client, NULL, NULL, NULL,
+          NULL, NULL, NULL, &key, &iv, &method, TRUE));
+  assert_equals_string (key, "https://priv.example.com/key.bin");
+  assert_equals_int (method, GST_M3U8_KEY_METHOD_SAMPLE_AES);
+  fail_unless (memcmp (iv, iv1, 16) == 0);
+  g_free (key);
+  g_free (iv);
+
+  gst_m3u8_client_free (client);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_update_invalid_playlist)
 {
   GstM3U8Client *client;
@@ -789,7 +855,7 @@ GST_START_TEST (test_get_next_fragment)
 
   /* Check the next fragment */
   gst_m3u8_client_get_next_fragment (client, &discontinous, &uri, &duration,
-      &timestamp, &range_start, &range_end, NULL, NULL, TRUE);
+      &timestamp, &range_start, &range_end, NULL, NULL, NULL, TRUE);
   assert_equals_int (discontinous, FALSE);
   assert_equals_string (uri, "http://media.example.com/all.ts");
   assert_equals_uint64 (timestamp, 0);
@@ -802,7 +868,7 @@ GST_START_TEST (test_get_next_fragment)
 
   /* Check next media segments */
   gst_m3u8_client_get_next_fragment (client, &discontinous, &uri, &duration,
-      &timestamp, &range_start, &range_end, NULL, NULL, TRUE);
+      &timestamp, &range_start, &range_end, NULL, NULL, NULL, TRUE);
   assert_equals_int (discontinous, FALSE);
   assert_equals_string (uri, "http://media.example.com/all.ts");
   assert_equals_uint64 (timestamp, 10 * GST_SECOND);
@@ -815,7 +881,7 @@ GST_START_TEST (test_get_next_fragment)
 
   /* Check next media segments */
   gst_m3u8_client_get_next_fragment (client, &discontinous, &uri, &duration,
-      &timestamp, &range_start, &range_end, NULL, NULL, TRUE);
+      &timestamp, &range_start, &range_end, NULL, NULL, NULL, TRUE);
   assert_equals_int (discontinous, FALSE);
   assert_equals_string (uri, "http://media.example.com/all.ts");
   assert_equals_uint64 (timestamp, 20 * GST_SECOND);
@@ -1416,6 +1482,7 @@ hlsdemux_suite (void)
 #endif
   tcase_add_test (tc_m3u8, test_playlist_with_doubles_duration);
   tcase_add_test (tc_m3u8, test_playlist_with_encryption);
+  tcase_add_test (tc_m3u8, test_playlist_with_sample_aes);
   tcase_add_test (tc_m3u8, test_url_with_slash_query_param);
   tcase_add_test (tc_m3u8, test_stream_inf_tag);
   return s;
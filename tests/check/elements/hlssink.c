@@ -0,0 +1,185 @@
+/* GStreamer
+ *
+ * unit test for hlssink
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+#include <glib/gstdio.h>
+
+#define N_BUFFERS 20
+#define BUFFER_DURATION (50 * GST_MSECOND)
+#define PACKET_SIZE 188
+
+typedef struct
+{
+  gchar *dir;
+  gchar *playlist;
+  GPtrArray *parts;
+  guint n_force_key_unit;
+} HlsSinkResult;
+
+static GstBuffer *
+make_buffer (guint i)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, PACKET_SIZE, NULL);
+
+  gst_buffer_memset (buf, 0, i, PACKET_SIZE);
+  GST_BUFFER_PTS (buf) = i * BUFFER_DURATION;
+  GST_BUFFER_DURATION (buf) = BUFFER_DURATION;
+  if (i % 5 != 0)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buf;
+}
+
+/* Feeds N_BUFFERS buffers into an hlssink writing 100ms parts into a new
+ * temporary directory, either one by one or as a single buffer list */
+static void
+run_hlssink (gboolean as_list, HlsSinkResult * result)
+{
+  GstElement *hlssink;
+  GstHarness *h;
+  GstEvent *event;
+  gchar *location, *playlist_location, *part_location, *content;
+  guint i;
+
+  result->dir = g_dir_make_tmp ("hlssink-XXXXXX", NULL);
+  fail_unless (result->dir != NULL);
+
+  location = g_build_filename (result->dir, "segment%05d.ts", NULL);
+  playlist_location = g_build_filename (result->dir, "playlist.m3u8", NULL);
+  part_location = g_build_filename (result->dir, "segment%05d.part%u.ts",
+      NULL);
+
+  hlssink = gst_element_factory_make ("hlssink", NULL);
+  fail_unless (hlssink != NULL);
+  g_object_set (hlssink, "location", location, "playlist-location",
+      playlist_location, "part-location", part_location, "target-duration", 1,
+      "part-duration", 100, NULL);
+
+  h = gst_harness_new_with_element (hlssink, "sink", NULL);
+  gst_harness_set_src_caps_str (h, "video/mpegts, systemstream=(boolean)true");
+
+  if (as_list) {
+    GstBufferList *list = gst_buffer_list_new ();
+
+    for (i = 0; i < N_BUFFERS; i++)
+      gst_buffer_list_add (list, make_buffer (i));
+    fail_unless_equals_int (gst_pad_push_list (h->srcpad, list), GST_FLOW_OK);
+  } else {
+    for (i = 0; i < N_BUFFERS; i++)
+      fail_unless_equals_int (gst_harness_push (h, make_buffer (i)),
+          GST_FLOW_OK);
+  }
+
+  result->n_force_key_unit = 0;
+  while ((event = gst_harness_try_pull_upstream_event (h))) {
+    if (gst_video_event_is_force_key_unit (event))
+      result->n_force_key_unit++;
+    gst_event_unref (event);
+  }
+
+  fail_unless (g_file_get_contents (playlist_location, &result->playlist, NULL,
+          NULL));
+
+  result->parts = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0;; i++) {
+    gchar *filename = g_strdup_printf (part_location, 0, i);
+
+    if (!g_file_get_contents (filename, &content, NULL, NULL)) {
+      g_free (filename);
+      break;
+    }
+    g_ptr_array_add (result->parts, content);
+    g_free (filename);
+  }
+
+  gst_harness_teardown (h);
+  gst_object_unref (hlssink);
+
+  g_free (location);
+  g_free (playlist_location);
+  g_free (part_location);
+}
+
+static void
+clear_result (HlsSinkResult * result)
+{
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (result->dir, 0, NULL);
+  while ((name = g_dir_read_name (dir))) {
+    gchar *path = g_build_filename (result->dir, name, NULL);
+
+    g_unlink (path);
+    g_free (path);
+  }
+  g_dir_close (dir);
+  g_rmdir (result->dir);
+
+  g_free (result->dir);
+  g_free (result->playlist);
+  g_ptr_array_unref (result->parts);
+}
+
+GST_START_TEST (test_buffer_list_matches_buffers)
+{
+  HlsSinkResult buffers, list;
+  guint i;
+
+  run_hlssink (FALSE, &buffers);
+  run_hlssink (TRUE, &list);
+
+  /* a part is cut every 2 buffers, the last one is still open */
+  fail_unless_equals_int (buffers.parts->len, N_BUFFERS / 2 - 1);
+  fail_unless (strstr (buffers.playlist, "#EXT-X-PART:") != NULL);
+
+  /* the key unit of the first segment is scheduled once */
+  fail_unless_equals_int (buffers.n_force_key_unit, 1);
+
+  fail_unless_equals_int (list.n_force_key_unit, buffers.n_force_key_unit);
+  fail_unless_equals_string (list.playlist, buffers.playlist);
+  fail_unless_equals_int (list.parts->len, buffers.parts->len);
+  for (i = 0; i < buffers.parts->len; i++) {
+    fail_unless (memcmp (g_ptr_array_index (list.parts, i),
+            g_ptr_array_index (buffers.parts, i), 2 * PACKET_SIZE) == 0,
+        "part %u differs", i);
+  }
+
+  clear_result (&buffers);
+  clear_result (&list);
+}
+
+GST_END_TEST;
+
+static Suite *
+hlssink_suite (void)
+{
+  Suite *s = suite_create ("hlssink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_buffer_list_matches_buffers);
+
+  return s;
+}
+
+GST_CHECK_MAIN (hlssink);
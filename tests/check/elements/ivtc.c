@@ -0,0 +1,326 @@
+/* GStreamer
+ *
+ * unit test for ivtc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+/* the width is not a multiple of the SSE2 vector size, so the scalar tail
+ * of the comb score is used as well */
+#define WIDTH 100
+#define HEIGHT 96
+#define N_FILM_FRAMES 12
+#define N_VIDEO_FRAMES (N_FILM_FRAMES * 5 / 4)
+
+/* the film frames the top and the bottom field of the telecined frames of
+ * a 2:3 pulldown cycle come from */
+static const guint pulldown_top[5] = { 0, 1, 1, 2, 3 };
+static const guint pulldown_bottom[5] = { 0, 1, 2, 3, 3 };
+
+/* Vertical stripes 8 samples wide moving right by 4 samples per frame,
+ * with less noise than the comb metric tolerates. Fields of the same frame
+ * never comb, fields of different frames comb on half of the samples. */
+static GstBuffer *
+make_film_frame (const GstVideoInfo * info, guint frame)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, info->size, NULL);
+  GRand *rand = g_rand_new_with_seed (frame);
+  GstVideoFrame vframe;
+  gint x, y;
+
+  fail_unless (gst_video_frame_map (&vframe, info, buf, GST_MAP_WRITE));
+  for (y = 0; y < HEIGHT; y++) {
+    guint8 *line = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&vframe, 0) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, 0);
+
+    for (x = 0; x < WIDTH; x++) {
+      gint phase = (x + 4 * frame) / 8;
+
+      line[x] = (phase & 1 ? 220 : 30) + g_rand_int_range (rand, -2, 3);
+    }
+  }
+  for (y = 1; y < 3; y++) {
+    memset (GST_VIDEO_FRAME_PLANE_DATA (&vframe, y), 128 + frame,
+        GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, y) *
+        GST_VIDEO_FRAME_COMP_HEIGHT (&vframe, y));
+  }
+  gst_video_frame_unmap (&vframe);
+  g_rand_free (rand);
+
+  return buf;
+}
+
+/* Returns a frame with the even lines of @top and the odd ones of
+ * @bottom */
+static GstBuffer *
+weave_fields (const GstVideoInfo * info, GstBuffer * top, GstBuffer * bottom)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, info->size, NULL);
+  GstVideoFrame dest, top_frame, bottom_frame;
+  gint comp, y;
+
+  fail_unless (gst_video_frame_map (&dest, info, buf, GST_MAP_WRITE));
+  fail_unless (gst_video_frame_map (&top_frame, info, top, GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&bottom_frame, info, bottom,
+          GST_MAP_READ));
+  for (comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS (info); comp++) {
+    gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&dest, comp);
+
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&dest, comp); y++) {
+      GstVideoFrame *src = (y & 1) ? &bottom_frame : &top_frame;
+
+      memcpy ((guint8 *) GST_VIDEO_FRAME_COMP_DATA (&dest, comp) + y * stride,
+          (guint8 *) GST_VIDEO_FRAME_COMP_DATA (src, comp) + y * stride,
+          GST_VIDEO_FRAME_COMP_WIDTH (&dest, comp));
+    }
+  }
+  gst_video_frame_unmap (&bottom_frame);
+  gst_video_frame_unmap (&top_frame);
+  gst_video_frame_unmap (&dest);
+
+  return buf;
+}
+
+static void
+get_video_info (GstVideoInfo * info)
+{
+  gst_video_info_init (info);
+  gst_video_info_set_format (info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+}
+
+/* Pushes @input through an ivtc with @caps and returns the output
+ * buffers. Without @simd the element computes the comb score without
+ * SSE2. */
+static GList *
+run_ivtc (GPtrArray * input, const gchar * caps, guint subsample,
+    gboolean simd)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GList *out = NULL;
+  guint i;
+
+  if (simd)
+    g_unsetenv ("GST_CPU_FEATURES_DISABLE");
+  else
+    g_setenv ("GST_CPU_FEATURES_DISABLE", "all", TRUE);
+
+  h = gst_harness_new ("ivtc");
+  g_object_set (h->element, "subsample", subsample, NULL);
+  gst_harness_set_src_caps_str (h, caps);
+
+  for (i = 0; i < input->len; i++) {
+    fail_unless_equals_int (gst_harness_push (h,
+            gst_buffer_ref (g_ptr_array_index (input, i))), GST_FLOW_OK);
+  }
+  while ((buf = gst_harness_try_pull (h)))
+    out = g_list_append (out, buf);
+  fail_unless (out != NULL);
+
+  gst_harness_teardown (h);
+  g_unsetenv ("GST_CPU_FEATURES_DISABLE");
+
+  return out;
+}
+
+/* 30000/1001 fps frames made from N_FILM_FRAMES with 2:3 pulldown */
+static GPtrArray *
+make_telecined_frames (void)
+{
+  GPtrArray *film = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  GPtrArray *video = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  GstVideoInfo info;
+  guint i;
+
+  get_video_info (&info);
+  for (i = 0; i < N_FILM_FRAMES; i++)
+    g_ptr_array_add (film, make_film_frame (&info, i));
+
+  for (i = 0; i < N_VIDEO_FRAMES; i++) {
+    guint cycle = i / 5 * 4;
+    GstBuffer *buf = weave_fields (&info,
+        g_ptr_array_index (film, cycle + pulldown_top[i % 5]),
+        g_ptr_array_index (film, cycle + pulldown_bottom[i % 5]));
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, 1001 * GST_SECOND,
+        30000);
+    GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, 1001 * GST_SECOND,
+        30000);
+    GST_BUFFER_FLAG_SET (buf, GST_VIDEO_BUFFER_FLAG_INTERLACED |
+        GST_VIDEO_BUFFER_FLAG_TFF);
+    g_ptr_array_add (video, buf);
+  }
+  g_ptr_array_unref (film);
+
+  return video;
+}
+
+#define TELECINE_CAPS "video/x-raw, format=(string)I420, width=(int)100, " \
+    "height=(int)96, framerate=(fraction)30000/1001, " \
+    "interlace-mode=(string)interleaved"
+
+/* Compares the visible samples of the frames only, the padding at the end
+ * of the lines is not written by ivtc */
+static void
+assert_same_frame (GstBuffer * a, GstBuffer * b, const gchar * what)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame_a, frame_b;
+  gint comp, y;
+
+  get_video_info (&info);
+  fail_unless (gst_video_frame_map (&frame_a, &info, a, GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&frame_b, &info, b, GST_MAP_READ));
+  for (comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS (&info); comp++) {
+    gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame_a, comp);
+
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame_a, comp); y++) {
+      fail_unless (memcmp ((guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame_a,
+                  comp) + y * stride,
+              (guint8 *) GST_VIDEO_FRAME_COMP_DATA (&frame_b,
+                  comp) + y * stride,
+              GST_VIDEO_FRAME_COMP_WIDTH (&frame_a, comp)) == 0,
+          "line %d of component %d differs for %s", y, comp, what);
+    }
+  }
+  gst_video_frame_unmap (&frame_b);
+  gst_video_frame_unmap (&frame_a);
+}
+
+static void
+assert_same_output (GList * a, GList * b, const gchar * what)
+{
+  fail_unless_equals_int (g_list_length (a), g_list_length (b));
+
+  for (; a && b; a = a->next, b = b->next) {
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (a->data),
+        GST_BUFFER_PTS (b->data));
+    assert_same_frame (a->data, b->data, what);
+  }
+}
+
+static void
+free_output (GList * out)
+{
+  g_list_free_full (out, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_START_TEST (test_sse2_matches_scalar)
+{
+  GPtrArray *input = make_telecined_frames ();
+  guint subsample;
+
+  for (subsample = 1; subsample <= 2; subsample++) {
+    GList *simd = run_ivtc (input, TELECINE_CAPS, subsample, TRUE);
+    GList *scalar = run_ivtc (input, TELECINE_CAPS, subsample, FALSE);
+    gchar *what = g_strdup_printf ("subsample %u", subsample);
+
+    assert_same_output (simd, scalar, what);
+
+    g_free (what);
+    free_output (simd);
+    free_output (scalar);
+  }
+
+  g_ptr_array_unref (input);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_subsample)
+{
+  GPtrArray *input = make_telecined_frames ();
+  GstElement *ivtc;
+  GList *all, *subsampled;
+  guint subsample;
+
+  ivtc = gst_check_setup_element ("ivtc");
+  g_object_get (ivtc, "subsample", &subsample, NULL);
+  fail_unless_equals_int (subsample, 1);
+  g_object_set (ivtc, "subsample", 4, NULL);
+  g_object_get (ivtc, "subsample", &subsample, NULL);
+  fail_unless_equals_int (subsample, 4);
+  gst_check_teardown_element (ivtc);
+
+  /* matching fields score 0 and the others are combed on every line, so
+   * looking at every other line takes the same decisions */
+  all = run_ivtc (input, TELECINE_CAPS, 1, TRUE);
+  subsampled = run_ivtc (input, TELECINE_CAPS, 2, TRUE);
+  assert_same_output (all, subsampled, "subsample 2");
+
+  free_output (all);
+  free_output (subsampled);
+  g_ptr_array_unref (input);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_progressive_passthrough)
+{
+  GPtrArray *input = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  GstVideoInfo info;
+  GList *out, *l;
+  guint i;
+
+  get_video_info (&info);
+  for (i = 0; i < N_FILM_FRAMES; i++) {
+    GstBuffer *buf = make_film_frame (&info, i);
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 24);
+    GST_BUFFER_DURATION (buf) = GST_SECOND / 24;
+    g_ptr_array_add (input, buf);
+  }
+
+  /* both fields of every frame match, so each frame is copied out whole;
+   * the last one stays queued waiting for the next fields */
+  out = run_ivtc (input, "video/x-raw, format=(string)I420, width=(int)100, "
+      "height=(int)96, framerate=(fraction)24/1", 1, TRUE);
+  fail_unless_equals_int (g_list_length (out), N_FILM_FRAMES - 1);
+  for (l = out, i = 0; l; l = l->next, i++) {
+    gchar *what = g_strdup_printf ("frame %u", i);
+
+    assert_same_frame (l->data, g_ptr_array_index (input, i), what);
+    g_free (what);
+  }
+
+  free_output (out);
+  g_ptr_array_unref (input);
+}
+
+GST_END_TEST;
+
+static Suite *
+ivtc_suite (void)
+{
+  Suite *s = suite_create ("ivtc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_sse2_matches_scalar);
+  tcase_add_test (tc_chain, test_subsample);
+  tcase_add_test (tc_chain, test_progressive_passthrough);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ivtc);
@@ -0,0 +1,280 @@
+/* GStreamer
+ *
+ * unit test for mpegpsdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbytereader.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CLOCK_FREQ 90000
+
+/* packs of 40ms at 51200 bytes per second, the SCR jumps forward by 100s
+ * in the middle and there is a keyframe every 10 packs */
+#define N_PACKS 100
+#define PACK_SIZE 2048
+#define PACK_DURATION (CLOCK_FREQ / 25)
+#define MUX_RATE (PACK_SIZE * 25 / 50)
+#define FIRST_SCR CLOCK_FREQ
+#define SCR_JUMP (100 * CLOCK_FREQ)
+#define PTS_DELAY (CLOCK_FREQ / 10)
+
+#define PACK_HEADER_SIZE 14
+#define PES_HEADER_SIZE 14
+
+#define INDEX_HEADER_SIZE 24
+#define INDEX_ENTRY_SIZE 25
+
+static guint64
+pack_scr (guint i)
+{
+  return FIRST_SCR + i * PACK_DURATION + (i >= N_PACKS / 2 ? SCR_JUMP : 0);
+}
+
+static void
+write_pack (guint8 * data, guint i)
+{
+  guint64 scr = pack_scr (i);
+  guint64 pts = scr + PTS_DELAY;
+  guint16 pes_length = PACK_SIZE - PACK_HEADER_SIZE - 6;
+  guint8 *payload;
+
+  memset (data, 0, PACK_SIZE);
+
+  /* MPEG-2 pack header without stuffing */
+  GST_WRITE_UINT32_BE (data, 0x000001ba);
+  GST_WRITE_UINT32_BE (data + 4, 0x44000400 | ((scr >> 30) & 0x7) << 27 |
+      ((scr >> 15) & 0x7fff) << 11 | ((scr >> 5) & 0x3ff));
+  data[8] = (scr & 0x1f) << 3 | 0x04;
+  data[9] = 0x01;
+  GST_WRITE_UINT32_BE (data + 10, MUX_RATE << 10 | 0x3f8);
+
+  /* video PES packet with a PTS */
+  data += PACK_HEADER_SIZE;
+  GST_WRITE_UINT32_BE (data, 0x000001e0);
+  GST_WRITE_UINT16_BE (data + 4, pes_length);
+  data[6] = 0x80;
+  data[7] = 0x80;
+  data[8] = 5;
+  data[9] = 0x21 | ((pts >> 29) & 0x0e);
+  data[10] = (pts >> 22) & 0xff;
+  data[11] = ((pts >> 14) & 0xfe) | 0x01;
+  data[12] = (pts >> 7) & 0xff;
+  data[13] = ((pts << 1) & 0xfe) | 0x01;
+
+  /* a sequence header or a picture */
+  payload = data + PES_HEADER_SIZE;
+  GST_WRITE_UINT32_BE (payload, i % 10 == 0 ? 0x000001b3 : 0x00000100);
+}
+
+static gchar *
+make_stream (void)
+{
+  gchar *location;
+  guint8 *data;
+  gint fd;
+  guint i;
+
+  data = g_malloc (N_PACKS * PACK_SIZE);
+  for (i = 0; i < N_PACKS; i++)
+    write_pack (data + i * PACK_SIZE, i);
+
+  fd = g_file_open_tmp ("mpegpsdemux-XXXXXX.mpg", &location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (location, (gchar *) data,
+          N_PACKS * PACK_SIZE, NULL));
+  g_free (data);
+
+  return location;
+}
+
+typedef struct
+{
+  GstElement *pipeline;
+  GMutex lock;
+  gboolean waiting;
+  GstClockTime first_pts;
+} DemuxData;
+
+static GstPadProbeReturn
+buffer_probe (GstPad * pad, GstPadProbeInfo * info, DemuxData * data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  g_mutex_lock (&data->lock);
+  if (data->waiting) {
+    data->first_pts = GST_BUFFER_PTS (buffer);
+    data->waiting = FALSE;
+  }
+  g_mutex_unlock (&data->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+pad_added (GstElement * demux, GstPad * pad, DemuxData * data)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad;
+
+  gst_bin_add (GST_BIN (data->pipeline), sink);
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) buffer_probe, data, NULL);
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+  gst_element_sync_state_with_parent (sink);
+}
+
+static void
+setup_pipeline (DemuxData * data, const gchar * location,
+    const gchar * index_location)
+{
+  GstElement *src, *demux;
+
+  data->pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("mpegpsdemux", NULL);
+  fail_unless (demux != NULL);
+  g_object_set (src, "location", location, NULL);
+  g_object_set (demux, "index-location", index_location, NULL);
+  gst_bin_add_many (GST_BIN (data->pipeline), src, demux, NULL);
+  fail_unless (gst_element_link (src, demux));
+
+  g_mutex_init (&data->lock);
+  data->waiting = FALSE;
+  data->first_pts = GST_CLOCK_TIME_NONE;
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added), data);
+}
+
+static void
+teardown_pipeline (DemuxData * data)
+{
+  /* the index is written before the demuxer is freed */
+  gst_element_set_state (data->pipeline, GST_STATE_NULL);
+  gst_object_unref (data->pipeline);
+  g_mutex_clear (&data->lock);
+}
+
+GST_START_TEST (test_index_adjusted_scr)
+{
+  gchar *location, *index_location, *contents;
+  GstByteReader reader;
+  guint64 scr, offset, prev_scr = 0, prev_offset = 0;
+  gboolean found_second_half = FALSE;
+  GstClockTime target, expected;
+  DemuxData data;
+  GstMessage *msg;
+  guint32 n_entries, i;
+  gsize size;
+  gint fd;
+
+  location = make_stream ();
+  fd = g_file_open_tmp ("mpegpsdemux-XXXXXX.idx", &index_location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  g_unlink (index_location);
+
+  /* play the whole stream to build the index */
+  setup_pipeline (&data, location, index_location);
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (data.pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  teardown_pipeline (&data);
+
+  /* the packs after the jump are indexed on the continuous timeline of the
+   * output timestamps, not with the SCR of the stream */
+  fail_unless (g_file_get_contents (index_location, &contents, &size, NULL));
+  gst_byte_reader_init (&reader, (const guint8 *) contents, size);
+  fail_unless (gst_byte_reader_skip (&reader, INDEX_HEADER_SIZE - 4));
+  fail_unless (gst_byte_reader_get_uint32_be (&reader, &n_entries));
+  fail_unless (n_entries > 0);
+  fail_unless_equals_int (gst_byte_reader_get_remaining (&reader),
+      n_entries * INDEX_ENTRY_SIZE);
+  for (i = 0; i < n_entries; i++) {
+    scr = gst_byte_reader_get_uint64_be_unchecked (&reader);
+    offset = gst_byte_reader_get_uint64_be_unchecked (&reader);
+    gst_byte_reader_skip_unchecked (&reader, INDEX_ENTRY_SIZE - 16);
+
+    fail_unless (i == 0 || (scr > prev_scr && offset > prev_offset));
+    fail_unless (scr < FIRST_SCR + N_PACKS * PACK_DURATION + CLOCK_FREQ);
+    if (offset >= N_PACKS / 2 * PACK_SIZE)
+      found_second_half = TRUE;
+    prev_scr = scr;
+    prev_offset = offset;
+  }
+  fail_unless (found_second_half);
+  g_free (contents);
+
+  /* seeking into pack 80 after the jump with the saved index starts from
+   * its keyframe */
+  setup_pipeline (&data, location, index_location);
+  fail_unless_equals_int (gst_element_set_state (data.pipeline,
+          GST_STATE_PAUSED), GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (data.pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  g_mutex_lock (&data.lock);
+  data.waiting = TRUE;
+  g_mutex_unlock (&data.lock);
+
+  target = gst_util_uint64_scale (80 * PACK_DURATION + PACK_DURATION / 2,
+      GST_SECOND, CLOCK_FREQ);
+  fail_unless (gst_element_seek_simple (data.pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, target));
+  fail_unless_equals_int (gst_element_get_state (data.pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  expected = gst_util_uint64_scale (FIRST_SCR + 80 * PACK_DURATION + PTS_DELAY,
+      GST_SECOND, CLOCK_FREQ);
+  g_mutex_lock (&data.lock);
+  fail_if (data.waiting);
+  fail_unless (data.first_pts + GST_SECOND / 10 >= expected &&
+      data.first_pts <= expected + GST_SECOND / 10,
+      "first buffer at %" GST_TIME_FORMAT " instead of %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (data.first_pts), GST_TIME_ARGS (expected));
+  g_mutex_unlock (&data.lock);
+
+  teardown_pipeline (&data);
+
+  g_unlink (location);
+  g_unlink (index_location);
+  g_free (location);
+  g_free (index_location);
+}
+
+GST_END_TEST;
+
+static Suite *
+mpegpsdemux_suite (void)
+{
+  Suite *s = suite_create ("mpegpsdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_index_adjusted_scr);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mpegpsdemux);
@@ -0,0 +1,311 @@
+/* GStreamer
+ *
+ * unit test for mpegpsmux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/base/gstadapter.h>
+#include <gst/base/gstbytereader.h>
+#include <string.h>
+
+#define VIDEO_CAPS_STRING "video/mpeg, " \
+                          "mpegversion = (int) 2, " \
+                          "systemstream = (boolean) false, " \
+                          "width = (int) 720, " \
+                          "height = (int) 576, " \
+                          "framerate = (fraction) 25/1"
+
+#define FRAME_SIZE 50000
+
+static GstHarness *
+setup_psmux (gboolean aggregate_gops)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("mpegpsmux", "sink_%u", "src");
+  g_object_set (h->element, "aggregate-gops", aggregate_gops, NULL);
+  gst_harness_set_src_caps_str (h, VIDEO_CAPS_STRING);
+
+  return h;
+}
+
+/* Frames are filled with their number */
+static GstBuffer *
+make_frame (guint i)
+{
+  GstBuffer *buf = gst_buffer_new_and_alloc (FRAME_SIZE);
+
+  gst_buffer_memset (buf, 0, i & 0xff, FRAME_SIZE);
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = i * 40 * GST_MSECOND;
+  GST_BUFFER_DURATION (buf) = 40 * GST_MSECOND;
+  if (i % 12)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buf;
+}
+
+/* Pushes @n frames and returns their total size. The first frame is kept in
+ * @first if not NULL. */
+static guint64
+push_frames (GstHarness * h, guint n, GstBuffer ** first)
+{
+  guint64 total = 0;
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    GstBuffer *buf = make_frame (i);
+
+    if (first && i == 0)
+      *first = gst_buffer_ref (buf);
+    total += FRAME_SIZE;
+
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  return total;
+}
+
+static gboolean
+buffer_references (GstBuffer * buffer, GstBuffer * data)
+{
+  GstMapInfo map, dmap;
+  gboolean found = FALSE;
+  guint i;
+
+  gst_buffer_map (data, &dmap, GST_MAP_READ);
+  for (i = 0; i < gst_buffer_n_memory (buffer) && !found; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+
+    gst_memory_map (mem, &map, GST_MAP_READ);
+    found = map.data >= dmap.data && map.data < dmap.data + dmap.size;
+    gst_memory_unmap (mem, &map);
+  }
+  gst_buffer_unmap (data, &dmap);
+
+  return found;
+}
+
+/* Walks the packs of the program stream and checks that the PES payloads
+ * have the content of the frames. Returns the number of payload bytes. */
+static guint64
+check_program_stream (const guint8 * data, gsize size)
+{
+  GstByteReader reader;
+  guint64 total = 0;
+  guint32 code = 0;
+
+  gst_byte_reader_init (&reader, data, size);
+
+  while (gst_byte_reader_get_remaining (&reader) > 0) {
+    guint16 length;
+    guint8 hdr_len;
+    const guint8 *payload;
+    guint i;
+
+    fail_unless (gst_byte_reader_get_uint32_be (&reader, &code));
+    fail_unless_equals_int (code >> 8, 0x000001);
+
+    switch (code & 0xff) {
+      case 0xba:
+        /* pack header without stuffing */
+        fail_unless (gst_byte_reader_skip (&reader, 10));
+        break;
+      case 0xb9:
+        /* program end code is last */
+        fail_unless_equals_int (gst_byte_reader_get_remaining (&reader), 0);
+        break;
+      case 0xe0:
+        fail_unless (gst_byte_reader_get_uint16_be (&reader, &length));
+        fail_unless (gst_byte_reader_skip (&reader, 2));
+        fail_unless (gst_byte_reader_get_uint8 (&reader, &hdr_len));
+        fail_unless (gst_byte_reader_skip (&reader, hdr_len));
+        length -= 3 + hdr_len;
+        fail_unless (gst_byte_reader_get_data (&reader, length, &payload));
+        for (i = 0; i < length; i++)
+          fail_unless_equals_int (payload[i],
+              ((total + i) / FRAME_SIZE) & 0xff);
+        total += length;
+        break;
+      default:
+        /* system header and program stream map */
+        fail_unless (gst_byte_reader_get_uint16_be (&reader, &length));
+        fail_unless (gst_byte_reader_skip (&reader, length));
+        break;
+    }
+  }
+  fail_unless_equals_int (code, 0x000001b9);
+
+  return total;
+}
+
+static void
+check_mux (gboolean aggregate_gops)
+{
+  GstHarness *h;
+  GstBuffer *first = NULL, *buf;
+  GstAdapter *adapter;
+  gboolean referenced = FALSE;
+  guint64 pushed;
+  gsize size;
+
+  h = setup_psmux (aggregate_gops);
+  pushed = push_frames (h, 30, &first);
+
+  adapter = gst_adapter_new ();
+  while ((buf = gst_harness_try_pull (h))) {
+    referenced |= buffer_references (buf, first);
+    gst_adapter_push (adapter, buf);
+  }
+  fail_unless (referenced, "payload was copied into the PES packets");
+
+  size = gst_adapter_available (adapter);
+  fail_unless_equals_uint64 (check_program_stream (gst_adapter_map (adapter,
+              size), size), pushed);
+  gst_adapter_unmap (adapter);
+
+  g_object_unref (adapter);
+  gst_buffer_unref (first);
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_payload_referenced)
+{
+  check_mux (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate_gops)
+{
+  check_mux (TRUE);
+}
+
+GST_END_TEST;
+
+/* Copies out and releases the output, so that the header buffers of the
+ * pool and the input frames are freed as soon as possible */
+static void
+pull_program_stream (GstHarness * h, GByteArray * data)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+
+  while ((buf = gst_harness_try_pull (h))) {
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    g_byte_array_append (data, map.data, map.size);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+}
+
+GST_START_TEST (test_buffers_recycled)
+{
+  GstHarness *h;
+  GByteArray *data;
+  guint i;
+
+  h = setup_psmux (FALSE);
+  data = g_byte_array_new ();
+
+  for (i = 0; i < 500; i++) {
+    fail_unless_equals_int (gst_harness_push (h, make_frame (i)),
+        GST_FLOW_OK);
+    pull_program_stream (h, data);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  pull_program_stream (h, data);
+
+  fail_unless_equals_uint64 (check_program_stream (data->data, data->len),
+      500 * FRAME_SIZE);
+
+  g_byte_array_unref (data);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Muxes @n frames and returns the program stream. With copy-packets every
+ * packet must be a single block of memory of its own. */
+static GByteArray *
+mux_program_stream (gboolean copy_packets, guint n)
+{
+  GstHarness *h;
+  GByteArray *data;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint i;
+
+  h = setup_psmux (FALSE);
+  g_object_set (h->element, "copy-packets", copy_packets, NULL);
+  data = g_byte_array_new ();
+
+  for (i = 0; i < n; i++)
+    fail_unless_equals_int (gst_harness_push (h, make_frame (i)),
+        GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (h))) {
+    if (copy_packets)
+      fail_unless_equals_int (gst_buffer_n_memory (buf), 1);
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    g_byte_array_append (data, map.data, map.size);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+
+  return data;
+}
+
+GST_START_TEST (test_copy_packets)
+{
+  GByteArray *referenced, *copied;
+
+  referenced = mux_program_stream (FALSE, 30);
+  copied = mux_program_stream (TRUE, 30);
+
+  fail_unless_equals_uint64 (check_program_stream (copied->data,
+          copied->len), 30 * FRAME_SIZE);
+  fail_unless_equals_int (copied->len, referenced->len);
+  fail_unless (memcmp (copied->data, referenced->data, copied->len) == 0);
+
+  g_byte_array_unref (referenced);
+  g_byte_array_unref (copied);
+}
+
+GST_END_TEST;
+
+static Suite *
+mpegpsmux_suite (void)
+{
+  Suite *s = suite_create ("mpegpsmux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_payload_referenced);
+  tcase_add_test (tc_chain, test_aggregate_gops);
+  tcase_add_test (tc_chain, test_buffers_recycled);
+  tcase_add_test (tc_chain, test_copy_packets);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mpegpsmux);
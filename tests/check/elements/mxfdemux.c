@@ -28,6 +28,12 @@ static GstPad *mysrcpad, *mysinkpad;
 static GMainLoop *loop = NULL;
 static gboolean have_eos = FALSE;
 static gboolean have_data = FALSE;
+/* number of bytes of mxf_file that the pull source pretends to have */
+static gint available = sizeof (mxf_file);
+/* file served by the pull source */
+static const guint8 *file_data = mxf_file;
+/* if not 0, the file grows to its full size on this read past its end */
+static gint grow_on_read = 0;
 
 static GstStaticPadTemplate mysrctemplate =
 GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
@@ -134,11 +140,18 @@ static GstFlowReturn
 _src_getrange (GstPad * pad, GstObject * parent, guint64 offset, guint length,
     GstBuffer ** buffer)
 {
-  if (offset + length > sizeof (mxf_file))
-    return GST_FLOW_EOS;
+  if (offset + length > g_atomic_int_get (&available)) {
+    if (grow_on_read == 0 || --grow_on_read > 0)
+      return GST_FLOW_EOS;
+
+    /* The demuxer must have waited for the essence instead of finishing */
+    fail_unless (have_eos == FALSE);
+    fail_unless (have_data == FALSE);
+    g_atomic_int_set (&available, sizeof (mxf_file));
+  }
 
   *buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
-      (guint8 *) (mxf_file + offset), length, 0, length, NULL, NULL);
+      (guint8 *) (file_data + offset), length, 0, length, NULL, NULL);
 
   return GST_FLOW_OK;
 }
@@ -156,7 +169,7 @@ _src_query (GstPad * pad, GstObject * parent, GstQuery * query)
       if (fmt != GST_FORMAT_BYTES)
         break;
 
-      gst_query_set_duration (query, fmt, sizeof (mxf_file));
+      gst_query_set_duration (query, fmt, g_atomic_int_get (&available));
       res = TRUE;
       break;
     }
@@ -232,6 +245,282 @@ GST_START_TEST (test_pull)
 
 GST_END_TEST;
 
+/* Returns where the essence of mxf_file starts, after the header partition
+ * pack and the header metadata and index that follow it */
+static gint
+_essence_offset (void)
+{
+  const guint8 *pack = mxf_file + 16;
+  guint pack_size;
+  guint64 header_byte_count, index_byte_count;
+
+  /* the partition pack length is coded as 4 byte BER */
+  fail_unless_equals_int (pack[0], 0x83);
+  pack_size = GST_READ_UINT24_BE (pack + 1);
+  pack += 4;
+
+  /* major/minor version, KAG size, this/previous/footer partition */
+  header_byte_count = GST_READ_UINT64_BE (pack + 32);
+  index_byte_count = GST_READ_UINT64_BE (pack + 40);
+
+  return 16 + 4 + pack_size + header_byte_count + index_byte_count;
+}
+
+GST_START_TEST (test_pull_growing)
+{
+  GstStateChangeReturn sret;
+  GstElement *mxfdemux;
+  GstPad *sinkpad;
+
+  have_eos = FALSE;
+  have_data = FALSE;
+  loop = g_main_loop_new (NULL, FALSE);
+
+  /* Only the header partition is written so far, the essence follows. The
+   * file grows on the second attempt to read the essence, i.e. only if the
+   * demuxer waited and tried again after the first one failed */
+  fail_unless (_essence_offset () < (gint) sizeof (mxf_file));
+  g_atomic_int_set (&available, _essence_offset ());
+  grow_on_read = 2;
+
+  mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
+  fail_unless (mxfdemux != NULL);
+  g_object_set (mxfdemux, "growing-file", TRUE, NULL);
+  g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
+  sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
+  fail_unless (sinkpad != NULL);
+
+  mysinkpad = _create_sink_pad ();
+  fail_unless (mysinkpad != NULL);
+  mysrcpad = _create_src_pad_pull ();
+  fail_unless (mysrcpad != NULL);
+
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_set_active (mysinkpad, TRUE);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  GST_INFO ("Setting to PLAYING");
+  sret = gst_element_set_state (mxfdemux, GST_STATE_PLAYING);
+  fail_unless_equals_int (sret, GST_STATE_CHANGE_SUCCESS);
+
+  g_main_loop_run (loop);
+  fail_unless (have_eos == TRUE);
+  fail_unless (have_data == TRUE);
+
+  fail_unless_equals_int (grow_on_read, 0);
+
+  gst_element_set_state (mxfdemux, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_pad_set_active (mysrcpad, FALSE);
+
+  gst_object_unref (mxfdemux);
+  gst_object_unref (mysinkpad);
+  gst_object_unref (mysrcpad);
+  g_main_loop_unref (loop);
+  loop = NULL;
+}
+
+GST_END_TEST;
+
+/* Replaces every @size bytes long occurrence of @from in @data with @to and
+ * returns how many were replaced */
+static guint
+_replace_bytes (guint8 * data, gsize data_size, const guint8 * from,
+    const guint8 * to, gsize size)
+{
+  guint n = 0;
+  gsize i;
+
+  for (i = 0; i + size <= data_size; i++) {
+    if (memcmp (data + i, from, size) == 0) {
+      memcpy (data + i, to, size);
+      n++;
+    }
+  }
+
+  return n;
+}
+
+GST_START_TEST (test_pull_clip_without_edit_units)
+{
+  /* essence container labels of frame-wrapped BWF and clip-wrapped AES3 */
+  static const guint8 bwf_frame_wrapped[] = {
+    0x06, 0x0e, 0x2b, 0x34, 0x04, 0x01, 0x01, 0x01,
+    0x0d, 0x01, 0x03, 0x01, 0x02, 0x06, 0x01, 0x00
+  };
+  static const guint8 aes3_clip_wrapped[] = {
+    0x06, 0x0e, 0x2b, 0x34, 0x04, 0x01, 0x01, 0x01,
+    0x0d, 0x01, 0x03, 0x01, 0x02, 0x06, 0x04, 0x00
+  };
+  /* the index table's edit unit byte count local tag and its value */
+  static const guint8 byte_count[] = { 0x3f, 0x05, 0x00, 0x04,
+    0x00, 0x00, 0x08, 0x9d
+  };
+  static const guint8 no_byte_count[] = { 0x3f, 0x05, 0x00, 0x04,
+    0x00, 0x00, 0x00, 0x00
+  };
+  GstStateChangeReturn sret;
+  GstElement *mxfdemux;
+  GstMessage *msg;
+  GstPad *sinkpad;
+  GstBus *bus;
+  GError *err = NULL;
+  guint8 *data;
+
+  have_eos = FALSE;
+  have_data = FALSE;
+
+  /* Clip-wrapped AES3 without an index, so the edit units in the clip
+   * can't be found */
+  data = g_memdup (mxf_file, sizeof (mxf_file));
+  fail_unless (_replace_bytes (data, sizeof (mxf_file), bwf_frame_wrapped,
+          aes3_clip_wrapped, sizeof (bwf_frame_wrapped)) > 0);
+  fail_unless_equals_int (_replace_bytes (data, sizeof (mxf_file), byte_count,
+          no_byte_count, sizeof (byte_count)), 1);
+  file_data = data;
+
+  mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
+  fail_unless (mxfdemux != NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (mxfdemux, bus);
+  g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
+  sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
+  fail_unless (sinkpad != NULL);
+
+  mysinkpad = _create_sink_pad ();
+  fail_unless (mysinkpad != NULL);
+  mysrcpad = _create_src_pad_pull ();
+  fail_unless (mysrcpad != NULL);
+
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_set_active (mysinkpad, TRUE);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  GST_INFO ("Setting to PLAYING");
+  sret = gst_element_set_state (mxfdemux, GST_STATE_PLAYING);
+  fail_unless_equals_int (sret, GST_STATE_CHANGE_SUCCESS);
+
+  /* The clip must not be skipped silently */
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND, GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  gst_message_parse_error (msg, &err, NULL);
+  fail_unless (g_error_matches (err, GST_STREAM_ERROR,
+          GST_STREAM_ERROR_NOT_IMPLEMENTED), "unexpected error %s",
+      err->message);
+  g_error_free (err);
+  gst_message_unref (msg);
+  fail_unless (have_data == FALSE);
+
+  gst_element_set_state (mxfdemux, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_pad_set_active (mysrcpad, FALSE);
+
+  gst_element_set_bus (mxfdemux, NULL);
+  gst_object_unref (bus);
+  gst_object_unref (mxfdemux);
+  gst_object_unref (mysinkpad);
+  gst_object_unref (mysrcpad);
+  file_data = mxf_file;
+  g_free (data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pull_lazy_metadata)
+{
+  /* a DMS-1 production framework set with only an instance UID */
+  static const guint8 dm_set[] = {
+    0x06, 0x0e, 0x2b, 0x34, 0x02, 0x53, 0x01, 0x01,
+    0x0d, 0x01, 0x04, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x83, 0x00, 0x00, 0x14,
+    0x3c, 0x0a, 0x00, 0x10,
+    0x5d, 0x2a, 0x6c, 0x1b, 0x7e, 0x41, 0x4d, 0x3f,
+    0x9a, 0x01, 0x22, 0x6e, 0x30, 0xc8, 0x55, 0x17
+  };
+  GstStateChangeReturn sret;
+  GstElement *mxfdemux;
+  GstPad *sinkpad;
+  const guint8 *fill;
+  guint8 *data;
+  guint essence_offset, fill_offset, fill_size;
+  gint lazy;
+
+  /* The header metadata ends with a fill item, the DM set goes in front of
+   * a shorter one so that nothing else moves */
+  essence_offset = _essence_offset ();
+  for (fill = mxf_file + 20 + GST_READ_UINT24_BE (mxf_file + 17);
+      fill < mxf_file + essence_offset;
+      fill += 20 + GST_READ_UINT24_BE (fill + 17)) {
+    fail_unless_equals_int (fill[16], 0x83);
+    if (fill[8] == 0x03)
+      break;
+  }
+  fail_unless (fill < mxf_file + essence_offset);
+  fill_size = 20 + GST_READ_UINT24_BE (fill + 17);
+  fail_unless (fill_size > sizeof (dm_set) + 20);
+
+  data = g_memdup (mxf_file, sizeof (mxf_file));
+  fill_offset = fill - mxf_file;
+  memcpy (data + fill_offset, dm_set, sizeof (dm_set));
+  memcpy (data + fill_offset + sizeof (dm_set), fill, 17);
+  GST_WRITE_UINT24_BE (data + fill_offset + sizeof (dm_set) + 17,
+      fill_size - sizeof (dm_set) - 20);
+  file_data = data;
+
+  for (lazy = 0; lazy < 2; lazy++) {
+    have_eos = FALSE;
+    have_data = FALSE;
+    loop = g_main_loop_new (NULL, FALSE);
+
+    mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
+    fail_unless (mxfdemux != NULL);
+    g_object_set (mxfdemux, "lazy-metadata", lazy, NULL);
+    g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
+    sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
+    fail_unless (sinkpad != NULL);
+
+    mysinkpad = _create_sink_pad ();
+    fail_unless (mysinkpad != NULL);
+    mysrcpad = _create_src_pad_pull ();
+    fail_unless (mysrcpad != NULL);
+
+    fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+    gst_object_unref (sinkpad);
+
+    gst_pad_set_active (mysinkpad, TRUE);
+    gst_pad_set_active (mysrcpad, TRUE);
+
+    GST_INFO ("Setting to PLAYING, lazy-metadata %d", lazy);
+    sret = gst_element_set_state (mxfdemux, GST_STATE_PLAYING);
+    fail_unless_equals_int (sret, GST_STATE_CHANGE_SUCCESS);
+
+    /* the DM set must neither get in the way of the structural metadata
+     * nor of the essence after it */
+    g_main_loop_run (loop);
+    fail_unless (have_eos == TRUE);
+    fail_unless (have_data == TRUE);
+
+    gst_element_set_state (mxfdemux, GST_STATE_NULL);
+    gst_pad_set_active (mysinkpad, FALSE);
+    gst_pad_set_active (mysrcpad, FALSE);
+
+    gst_object_unref (mxfdemux);
+    gst_object_unref (mysinkpad);
+    gst_object_unref (mysrcpad);
+    g_main_loop_unref (loop);
+    loop = NULL;
+  }
+
+  file_data = mxf_file;
+  g_free (data);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_push)
 {
   GstElement *mxfdemux;
@@ -301,6 +590,9 @@ mxfdemux_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_set_timeout (tc_chain, 180);
   tcase_add_test (tc_chain, test_pull);
+  tcase_add_test (tc_chain, test_pull_growing);
+  tcase_add_test (tc_chain, test_pull_clip_without_edit_units);
+  tcase_add_test (tc_chain, test_pull_lazy_metadata);
   tcase_add_test (tc_chain, test_push);
 
   return s;
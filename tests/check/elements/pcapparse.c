@@ -1,6 +1,9 @@
 #include "parser.h"
 #include <gst/check/gstcheck.h>
 #include <gst/check/gstharness.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
 
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
@@ -115,6 +118,265 @@ GST_START_TEST (test_parse_zerosize_frames)
 
 GST_END_TEST;
 
+GST_START_TEST (test_parse_pcapng)
+{
+  static const guint8 shb[] = {
+    0x0a, 0x0d, 0x0d, 0x0a, 0x1c, 0x00, 0x00, 0x00,
+    0x4d, 0x3c, 0x2b, 0x1a, 0x01, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x1c, 0x00, 0x00, 0x00
+  };
+  static const guint8 idb[] = {
+    0x01, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00,
+    0x14, 0x00, 0x00, 0x00
+  };
+  /* interface 0, timestamp 1000000 us, 60 bytes captured */
+  static const guint8 epb_header[] = {
+    0x06, 0x00, 0x00, 0x00, 0x5c, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x40, 0x42, 0x0f, 0x00, 0x3c, 0x00, 0x00, 0x00,
+    0x3c, 0x00, 0x00, 0x00
+  };
+  static const guint8 epb_trailer[] = { 0x5c, 0x00, 0x00, 0x00 };
+  const guint frame_size = sizeof (pcap_frame_with_eth_padding) - 16;
+  const guint payload_size = sizeof (pcap_frame_with_eth_padding) -
+      pcap_frame_with_eth_padding_offset - 2;
+  GstBuffer *in_buf, *out_buf;
+  GstHarness *h;
+  guint8 *data;
+  gsize size, pos = 0;
+
+  size = sizeof (shb) + sizeof (idb) + sizeof (epb_header) + frame_size +
+      sizeof (epb_trailer);
+  data = g_malloc (size);
+  memcpy (data + pos, shb, sizeof (shb));
+  pos += sizeof (shb);
+  memcpy (data + pos, idb, sizeof (idb));
+  pos += sizeof (idb);
+  memcpy (data + pos, epb_header, sizeof (epb_header));
+  pos += sizeof (epb_header);
+  memcpy (data + pos, pcap_frame_with_eth_padding + 16, frame_size);
+  pos += frame_size;
+  memcpy (data + pos, epb_trailer, sizeof (epb_trailer));
+
+  h = gst_harness_new ("pcapparse");
+  gst_harness_set_src_caps_str (h, "raw/x-pcap");
+
+  in_buf = gst_buffer_new_wrapped (data, size);
+  fail_unless_equals_int (gst_harness_push (h, in_buf), GST_FLOW_OK);
+
+  out_buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (out_buf), payload_size);
+  fail_unless (gst_buffer_memcmp (out_buf, 0, pcap_frame_with_eth_padding +
+          pcap_frame_with_eth_padding_offset, payload_size) == 0);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (out_buf), GST_SECOND);
+
+  gst_buffer_unref (out_buf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_payload_not_copied)
+{
+  GstBuffer *in_buf, *out_buf;
+  GstMapInfo in_map, out_map;
+  GstHarness *h;
+  guint8 *data;
+  gsize size;
+
+  size = sizeof (pcap_header) + sizeof (pcap_frame_with_eth_padding);
+  data = g_malloc (size);
+  memcpy (data, pcap_header, sizeof (pcap_header));
+  memcpy (data + sizeof (pcap_header), pcap_frame_with_eth_padding,
+      sizeof (pcap_frame_with_eth_padding));
+
+  h = gst_harness_new ("pcapparse");
+  gst_harness_set_src_caps_str (h, "raw/x-pcap");
+
+  in_buf = gst_buffer_new_wrapped (data, size);
+  gst_buffer_ref (in_buf);
+  fail_unless_equals_int (gst_harness_push (h, in_buf), GST_FLOW_OK);
+
+  /* the payload points into the input */
+  out_buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_n_memory (out_buf), 1);
+  gst_buffer_map (in_buf, &in_map, GST_MAP_READ);
+  gst_buffer_map (out_buf, &out_map, GST_MAP_READ);
+  fail_unless (out_map.data == in_map.data + sizeof (pcap_header) +
+      pcap_frame_with_eth_padding_offset);
+  gst_buffer_unmap (out_buf, &out_map);
+  gst_buffer_unmap (in_buf, &in_map);
+
+  gst_buffer_unref (out_buf);
+  gst_buffer_unref (in_buf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+count_buffers (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    guint * n_buffers)
+{
+  (*n_buffers)++;
+}
+
+static guint
+parse_capture (const gchar * location, const gchar * index_location)
+{
+  GstElement *pipeline, *element;
+  GstMessage *msg;
+  guint n_buffers = 0;
+
+  pipeline = gst_parse_launch ("filesrc name=src ! pcapparse name=parse "
+      "dst-port=40946 ! fakesink name=sink signal-handoffs=true", NULL);
+  fail_unless (pipeline != NULL);
+
+  element = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_set (element, "location", location, NULL);
+  gst_object_unref (element);
+  element = gst_bin_get_by_name (GST_BIN (pipeline), "parse");
+  g_object_set (element, "index-location", index_location, NULL);
+  gst_object_unref (element);
+  element = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (element, "handoff", G_CALLBACK (count_buffers),
+      &n_buffers);
+  gst_object_unref (element);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return n_buffers;
+}
+
+/* More records than fit in the start of the capture that the index is
+ * checked against */
+#define N_INDEX_RECORDS 64
+
+/* Returns a capture with records of the flow to port 40946 alternating with
+ * another flow, starting with the other flow if @swap */
+static guint8 *
+make_flow_capture (gboolean swap, gsize * size)
+{
+  const gsize record_size = sizeof (pcap_frame_with_eth_padding);
+  guint8 *data;
+  gint i;
+
+  *size = sizeof (pcap_header) + N_INDEX_RECORDS * record_size;
+  data = g_malloc (*size);
+  memcpy (data, pcap_header, sizeof (pcap_header));
+  for (i = 0; i < N_INDEX_RECORDS; i++) {
+    guint8 *record = data + sizeof (pcap_header) + i * record_size;
+
+    memcpy (record, pcap_frame_with_eth_padding, record_size);
+    if (i % 2 != swap)
+      record[16 + 14 + 20 + 3]++;
+  }
+
+  return data;
+}
+
+static gchar *
+make_index_location (void)
+{
+  gchar *index_location;
+  gint fd;
+
+  fd = g_file_open_tmp ("pcapparse-XXXXXX.idx", &index_location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  g_unlink (index_location);
+
+  return index_location;
+}
+
+GST_START_TEST (test_flow_index)
+{
+  const gsize record_size = sizeof (pcap_frame_with_eth_padding);
+  gchar *location, *index_location;
+  guint8 *data;
+  gsize size;
+  gint fd;
+
+  data = make_flow_capture (FALSE, &size);
+  fd = g_file_open_tmp ("pcapparse-XXXXXX.pcap", &location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  index_location = make_index_location ();
+
+  fail_unless (g_file_set_contents (location, (gchar *) data, size, NULL));
+  fail_unless_equals_int (parse_capture (location, index_location),
+      N_INDEX_RECORDS / 2);
+  fail_unless (g_file_test (index_location, G_FILE_TEST_EXISTS));
+
+  /* break the length of a record of the other flow after the hashed start of
+   * the capture, which is only fine if it is skipped without being parsed */
+  GST_WRITE_UINT32_LE (data + sizeof (pcap_header) +
+      (N_INDEX_RECORDS - 3) * record_size + 8, 0xffffff);
+  fail_unless (g_file_set_contents (location, (gchar *) data, size, NULL));
+  fail_unless_equals_int (parse_capture (location, index_location),
+      N_INDEX_RECORDS / 2);
+
+  g_unlink (location);
+  g_unlink (index_location);
+  g_free (location);
+  g_free (index_location);
+  g_free (data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flow_index_other_capture)
+{
+  gchar *location, *index_location, *index, *other_index;
+  gsize size, index_size, other_index_size;
+  guint8 *data;
+  gint fd;
+
+  fd = g_file_open_tmp ("pcapparse-XXXXXX.pcap", &location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  index_location = make_index_location ();
+
+  data = make_flow_capture (FALSE, &size);
+  fail_unless (g_file_set_contents (location, (gchar *) data, size, NULL));
+  fail_unless_equals_int (parse_capture (location, index_location),
+      N_INDEX_RECORDS / 2);
+  fail_unless (g_file_get_contents (index_location, &index, &index_size,
+          NULL));
+  g_free (data);
+
+  /* a capture of the same length with the flows swapped, whose records would
+   * all be skipped by the index of the first one */
+  data = make_flow_capture (TRUE, &size);
+  fail_unless (g_file_set_contents (location, (gchar *) data, size, NULL));
+  fail_unless_equals_int (parse_capture (location, index_location),
+      N_INDEX_RECORDS / 2);
+
+  /* and the index was replaced by one for this capture */
+  fail_unless (g_file_get_contents (index_location, &other_index,
+          &other_index_size, NULL));
+  fail_unless_equals_int (other_index_size, index_size);
+  fail_unless (memcmp (other_index, index, index_size) != 0);
+  g_free (index);
+  g_free (other_index);
+
+  g_unlink (location);
+  g_unlink (index_location);
+  g_free (location);
+  g_free (index_location);
+  g_free (data);
+}
+
+GST_END_TEST;
+
 static Suite *
 pcapparse_suite (void)
 {
@@ -133,6 +395,10 @@ pcapparse_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_parse_frames_with_eth_padding);
   tcase_add_test (tc_chain, test_parse_zerosize_frames);
+  tcase_add_test (tc_chain, test_parse_pcapng);
+  tcase_add_test (tc_chain, test_payload_not_copied);
+  tcase_add_test (tc_chain, test_flow_index);
+  tcase_add_test (tc_chain, test_flow_index_other_capture);
 
   return s;
 }
@@ -98,6 +98,9 @@ typedef struct _GstTestHTTPSrc
 
   GstEvent *http_headers_event;
   gboolean duration_changed;
+  /* like souphttpsrc, every seek after the one that follows start() issues
+   * a new request for the current uri */
+  gboolean seek_opens_request;
 } GstTestHTTPSrc;
 
 typedef struct _GstTestHTTPSrcClass
@@ -220,13 +223,14 @@ gst_test_http_src_init (GstTestHTTPSrc * src)
   src->segment_end = 0;
   src->http_headers_event = NULL;
   src->duration_changed = FALSE;
+  src->seek_opens_request = FALSE;
   if (gst_test_http_src_blocksize)
     gst_base_src_set_blocksize (GST_BASE_SRC (src),
         gst_test_http_src_blocksize);
 }
 
 static void
-gst_test_http_src_reset_input (GstTestHTTPSrc * src)
+gst_test_http_src_reset_request (GstTestHTTPSrc * src)
 {
   src->input.context = NULL;
   src->input.size = 0;
@@ -243,6 +247,13 @@ gst_test_http_src_reset_input (GstTestHTTPSrc * src)
     gst_event_unref (src->http_headers_event);
     src->http_headers_event = NULL;
   }
+  src->duration_changed = FALSE;
+}
+
+static void
+gst_test_http_src_reset_input (GstTestHTTPSrc * src)
+{
+  gst_test_http_src_reset_request (src);
   if (src->extra_headers) {
     gst_structure_free (src->extra_headers);
     src->extra_headers = NULL;
@@ -251,7 +262,6 @@ gst_test_http_src_reset_input (GstTestHTTPSrc * src)
   src->http_method_name = NULL;
   g_free (src->user_agent);
   src->user_agent = NULL;
-  src->duration_changed = FALSE;
 }
 
 static void
@@ -268,32 +278,27 @@ gst_test_http_src_finalize (GObject * object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* must be called with the mutex held */
 static gboolean
-gst_test_http_src_start (GstBaseSrc * basesrc)
+gst_test_http_src_open (GstTestHTTPSrc * src)
 {
-  GstTestHTTPSrc *src;
+  GstBaseSrc *basesrc = GST_BASE_SRC (src);
   GstStructure *http_headers;
 
-  src = GST_TEST_HTTP_SRC (basesrc);
-  g_mutex_lock (&src->mutex);
-  gst_test_http_src_reset_input (src);
   if (!src->uri) {
     GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (("No URL set.")),
         ("Missing location property"));
-    g_mutex_unlock (&src->mutex);
     return FALSE;
   }
   if (!gst_test_http_src_callbacks) {
     GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
         (("Callbacks not registered.")), ("Callbacks not registered"));
-    g_mutex_unlock (&src->mutex);
     return FALSE;
   }
   if (!gst_test_http_src_callbacks->src_start) {
     GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
         (("src_start callback not defined.")),
         ("src_start callback not registered"));
-    g_mutex_unlock (&src->mutex);
     return FALSE;
   }
   if (!gst_test_http_src_callbacks->src_start (src, src->uri, &src->input,
@@ -366,10 +371,24 @@ gst_test_http_src_start (GstBaseSrc * basesrc)
   }
   src->http_headers_event =
       gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM_STICKY, http_headers);
-  g_mutex_unlock (&src->mutex);
+  src->seek_opens_request = FALSE;
   return TRUE;
 }
 
+static gboolean
+gst_test_http_src_start (GstBaseSrc * basesrc)
+{
+  GstTestHTTPSrc *src;
+  gboolean ret;
+
+  src = GST_TEST_HTTP_SRC (basesrc);
+  g_mutex_lock (&src->mutex);
+  gst_test_http_src_reset_input (src);
+  ret = gst_test_http_src_open (src);
+  g_mutex_unlock (&src->mutex);
+  return ret;
+}
+
 static gboolean
 gst_test_http_src_stop (GstBaseSrc * basesrc)
 {
@@ -419,6 +438,16 @@ gst_test_http_src_do_seek (GstBaseSrc * basesrc, GstSegment * segment)
     g_mutex_unlock (&src->mutex);
     return FALSE;
   }
+  if (src->seek_opens_request) {
+    GST_DEBUG ("seek issues a new request for %s", src->uri);
+    gst_test_http_src_reset_request (src);
+    if (!gst_test_http_src_open (src)) {
+      g_mutex_unlock (&src->mutex);
+      return FALSE;
+    }
+    segment->duration = src->input.size;
+  }
+  src->seek_opens_request = TRUE;
   if (src->input.status_code >= 200 && src->input.status_code < 300) {
     if (segment->start >= src->input.size) {
       GST_DEBUG ("attempt to seek to %" G_GUINT64_FORMAT " but size is %"
@@ -0,0 +1,262 @@
+/* GStreamer
+ *
+ * unit test for ssim and measurecollector
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include <gst/check/gstcheck.h>
+
+#define N_FRAMES 5
+
+#define SOURCE(pattern, format, width, height) \
+    "videotestsrc num-buffers=" G_STRINGIFY (N_FRAMES) " pattern=" pattern \
+    " ! video/x-raw,format=" format ",width=" G_STRINGIFY (width) \
+    ",height=" G_STRINGIFY (height) ",framerate=25/1"
+
+typedef struct
+{
+  GList *ssim;                  /* structures of the SSIM messages */
+  GList *collector;             /* structures of the collector messages */
+  gboolean error;
+} Results;
+
+static void
+results_clear (Results * results)
+{
+  g_list_free_full (results->ssim, (GDestroyNotify) gst_structure_free);
+  g_list_free_full (results->collector, (GDestroyNotify) gst_structure_free);
+  memset (results, 0, sizeof (Results));
+}
+
+static void
+run_pipeline (const gchar * desc, Results * results)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstBus *bus;
+  gboolean done = FALSE;
+
+  memset (results, 0, sizeof (Results));
+
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+
+  bus = gst_element_get_bus (pipeline);
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  while (!done) {
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT);
+
+    switch (GST_MESSAGE_TYPE (msg)) {
+      case GST_MESSAGE_ELEMENT:{
+        const GstStructure *s = gst_message_get_structure (msg);
+
+        if (gst_structure_has_name (s, "SSIM"))
+          results->ssim = g_list_append (results->ssim, gst_structure_copy (s));
+        else if (gst_structure_has_name (s, "GstMeasureCollector"))
+          results->collector = g_list_append (results->collector,
+              gst_structure_copy (s));
+        break;
+      }
+      case GST_MESSAGE_ERROR:
+        results->error = TRUE;
+        done = TRUE;
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+    gst_message_unref (msg);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+}
+
+static gdouble
+get_double (const GstStructure * s, const gchar * field)
+{
+  gdouble value = -1.0;
+
+  fail_unless (gst_structure_get_double (s, field, &value),
+      "no field %s in %" GST_PTR_FORMAT, field, s);
+
+  return value;
+}
+
+GST_START_TEST (test_identical)
+{
+  Results results;
+  GList *l;
+  guint64 offset = 0;
+
+  run_pipeline ("ssim name=ssim metrics=ssim+psnr+ms-ssim threads=2 ! "
+      "fakesink " SOURCE ("smpte", "I420", 160, 120) " ! ssim.sink_0 "
+      SOURCE ("smpte", "I420", 160, 120) " ! ssim.sink_1", &results);
+
+  fail_if (results.error);
+  fail_unless_equals_int (g_list_length (results.ssim), N_FRAMES);
+
+  for (l = results.ssim; l; l = l->next) {
+    const GstStructure *s = l->data;
+    guint64 frame;
+
+    fail_unless_equals_string (gst_structure_get_string (s, "stream"),
+        "sink_1");
+    fail_unless (gst_structure_get_uint64 (s, "offset", &frame));
+    fail_unless_equals_uint64 (frame, offset++);
+
+    fail_unless (fabs (get_double (s, "mean") - 1.0) < 1e-6);
+    fail_unless (fabs (get_double (s, "lowest") - 1.0) < 1e-6);
+    fail_unless (fabs (get_double (s, "highest") - 1.0) < 1e-6);
+    fail_unless (get_double (s, "psnr") == 100.0);
+    fail_unless (fabs (get_double (s, "ms-ssim") - 1.0) < 1e-6);
+  }
+
+  results_clear (&results);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_different)
+{
+  Results results;
+  GList *l;
+
+  /* the distorted stream is converted to the format of the reference */
+  run_pipeline ("ssim name=ssim metrics=ssim+psnr+ms-ssim ! fakesink "
+      SOURCE ("smpte", "I420", 160, 120) " ! ssim.sink_0 "
+      SOURCE ("snow", "NV12", 160, 120) " ! ssim.sink_1 "
+      SOURCE ("smpte", "Y444", 160, 120) " ! ssim.sink_2", &results);
+
+  fail_if (results.error);
+  fail_unless_equals_int (g_list_length (results.ssim), 2 * N_FRAMES);
+
+  for (l = results.ssim; l; l = l->next) {
+    const GstStructure *s = l->data;
+    const gchar *stream = gst_structure_get_string (s, "stream");
+    gdouble mean = get_double (s, "mean");
+
+    fail_unless (get_double (s, "lowest") <= mean);
+    fail_unless (get_double (s, "highest") >= mean);
+
+    if (g_strcmp0 (stream, "sink_1") == 0) {
+      fail_unless (mean < 0.5);
+      fail_unless (get_double (s, "psnr") < 20.0);
+      fail_unless (get_double (s, "ms-ssim") < 0.5);
+    } else {
+      fail_unless_equals_string (stream, "sink_2");
+      fail_unless (mean > 0.99);
+    }
+  }
+
+  results_clear (&results);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_wrong_size)
+{
+  Results results;
+
+  run_pipeline ("ssim name=ssim ! fakesink "
+      SOURCE ("smpte", "I420", 160, 120) " ! ssim.sink_0 "
+      SOURCE ("smpte", "I420", 80, 60) " ! ssim.sink_1", &results);
+
+  fail_unless (results.error);
+  fail_unless (results.ssim == NULL);
+
+  results_clear (&results);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_collector)
+{
+  Results results;
+  const GstStructure *s;
+  gchar *filename, *desc, *contents;
+  gchar **lines;
+  gint fd;
+
+  fd = g_file_open_tmp ("videomeasure-XXXXXX.csv", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+
+  desc = g_strdup_printf ("ssim name=ssim ! measurecollector flags=3 "
+      "filename=%s ! fakesink " SOURCE ("smpte", "I420", 160, 120)
+      " ! ssim.sink_0 " SOURCE ("smpte", "I420", 160, 120) " ! ssim.sink_1",
+      filename);
+  run_pipeline (desc, &results);
+  g_free (desc);
+
+  fail_if (results.error);
+  fail_unless_equals_int (g_list_length (results.collector), 1);
+  s = results.collector->data;
+  fail_unless_equals_string (gst_structure_get_string (s, "stream"),
+      "sink_1");
+  fail_unless (fabs (get_double (s, "SSIM") - 1.0) < 1e-6);
+  fail_unless (fabs (get_double (s, "measure-result") - 1.0) < 1e-6);
+  fail_unless (get_double (s, "PSNR") == 100.0);
+
+  fail_unless (g_file_get_contents (filename, &contents, NULL, NULL));
+  lines = g_strsplit (contents, "\n", -1);
+  /* header, one row per frame and the empty string after the last newline */
+  fail_unless_equals_int (g_strv_length (lines), N_FRAMES + 2);
+  fail_unless_equals_string (lines[0],
+      "offset,timestamp,stream,SSIM,SSIM-lowest,SSIM-highest,PSNR");
+  fail_unless (g_str_has_prefix (lines[1], "0,0,sink_1,1.000000,"));
+  fail_unless (g_str_has_suffix (lines[1], ",100.000000"));
+  fail_unless_equals_string (lines[N_FRAMES + 1], "");
+  g_strfreev (lines);
+  g_free (contents);
+
+  g_unlink (filename);
+  g_free (filename);
+  results_clear (&results);
+}
+
+GST_END_TEST;
+
+static Suite *
+videomeasure_suite (void)
+{
+  Suite *s = suite_create ("videomeasure");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_identical);
+  tcase_add_test (tc_chain, test_different);
+  tcase_add_test (tc_chain, test_wrong_size);
+  tcase_add_test (tc_chain, test_collector);
+
+  return s;
+}
+
+GST_CHECK_MAIN (videomeasure);
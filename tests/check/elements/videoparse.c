@@ -0,0 +1,368 @@
+/* GStreamer
+ *
+ * unit test for videoparse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* GRAY8 frames of 4x4 pixels, every pixel is the frame number */
+#define WIDTH 4
+#define HEIGHT 4
+#define FRAME_SIZE (WIDTH * HEIGHT)
+#define N_FRAMES 10
+#define FPS_N 25
+
+static guint8 file_data[N_FRAMES * FRAME_SIZE];
+/* URI answered upstream, NULL if upstream has none */
+static gchar *file_uri = NULL;
+static gint n_pulls = 0;
+
+static GstPad *mysrcpad, *mysinkpad;
+static GList *frames = NULL;
+static gboolean have_eos = FALSE;
+static GMutex check_lock;
+static GCond check_cond;
+
+static GstStaticPadTemplate mysrctemplate =
+GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate mysinktemplate =
+GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstFlowReturn
+_src_getrange (GstPad * pad, GstObject * parent, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  g_atomic_int_inc (&n_pulls);
+
+  if (offset >= sizeof (file_data))
+    return GST_FLOW_EOS;
+
+  length = MIN (length, sizeof (file_data) - offset);
+  *buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      file_data + offset, length, 0, length, NULL, NULL);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_DURATION:{
+      GstFormat fmt;
+
+      gst_query_parse_duration (query, &fmt, NULL);
+      if (fmt != GST_FORMAT_BYTES)
+        return FALSE;
+
+      gst_query_set_duration (query, fmt, sizeof (file_data));
+      return TRUE;
+    }
+    case GST_QUERY_SCHEDULING:
+      gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+      return TRUE;
+    case GST_QUERY_URI:
+      if (!file_uri)
+        return FALSE;
+      gst_query_set_uri (query, file_uri);
+      return TRUE;
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static GstFlowReturn
+_sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  g_mutex_lock (&check_lock);
+  frames = g_list_append (frames, buffer);
+  g_mutex_unlock (&check_lock);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  g_mutex_lock (&check_lock);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      /* everything before a flushing seek is thrown away */
+      g_list_free_full (frames, (GDestroyNotify) gst_buffer_unref);
+      frames = NULL;
+      have_eos = FALSE;
+      break;
+    case GST_EVENT_EOS:
+      have_eos = TRUE;
+      g_cond_signal (&check_cond);
+      break;
+    default:
+      break;
+  }
+  g_mutex_unlock (&check_lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static void
+wait_for_eos (void)
+{
+  g_mutex_lock (&check_lock);
+  while (!have_eos)
+    g_cond_wait (&check_cond, &check_lock);
+  g_mutex_unlock (&check_lock);
+}
+
+static GstElement *
+setup_videoparse (void)
+{
+  GstElement *videoparse;
+  GstPad *pad;
+  guint i;
+
+  for (i = 0; i < N_FRAMES; i++)
+    memset (file_data + i * FRAME_SIZE, i, FRAME_SIZE);
+
+  videoparse = gst_check_setup_element ("videoparse");
+  gst_util_set_object_arg (G_OBJECT (videoparse), "format", "gray8");
+  g_object_set (videoparse, "width", WIDTH, "height", HEIGHT,
+      "framerate", FPS_N, 1, NULL);
+
+  mysrcpad = gst_pad_new_from_static_template (&mysrctemplate, "src");
+  gst_pad_set_getrange_function (mysrcpad, _src_getrange);
+  gst_pad_set_query_function (mysrcpad, _src_query);
+  mysinkpad = gst_pad_new_from_static_template (&mysinktemplate, "sink");
+  gst_pad_set_chain_function (mysinkpad, _sink_chain);
+  gst_pad_set_event_function (mysinkpad, _sink_event);
+
+  pad = gst_element_get_static_pad (videoparse, "sink");
+  fail_unless (gst_pad_link (mysrcpad, pad) == GST_PAD_LINK_OK);
+  gst_object_unref (pad);
+  pad = gst_element_get_static_pad (videoparse, "src");
+  fail_unless (gst_pad_link (pad, mysinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (pad);
+
+  gst_pad_set_active (mysinkpad, TRUE);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  have_eos = FALSE;
+  n_pulls = 0;
+
+  return videoparse;
+}
+
+static void
+cleanup_videoparse (GstElement * videoparse)
+{
+  gst_element_set_state (videoparse, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_pad_set_active (mysrcpad, FALSE);
+
+  g_list_free_full (frames, (GDestroyNotify) gst_buffer_unref);
+  frames = NULL;
+
+  gst_object_unref (mysrcpad);
+  gst_object_unref (mysinkpad);
+  gst_check_teardown_element (videoparse);
+}
+
+/* checks that the frames first to last - 1 were output */
+static void
+check_frames (guint first, guint last)
+{
+  GList *l;
+  guint i = first;
+
+  fail_unless_equals_int (g_list_length (frames), last - first);
+
+  for (l = frames; l; l = l->next, i++) {
+    GstBuffer *buffer = l->data;
+    guint8 data[FRAME_SIZE], expected[FRAME_SIZE];
+
+    fail_unless_equals_int (gst_buffer_get_size (buffer), FRAME_SIZE);
+    gst_buffer_extract (buffer, 0, data, FRAME_SIZE);
+    memset (expected, i, FRAME_SIZE);
+    fail_unless (memcmp (data, expected, FRAME_SIZE) == 0,
+        "unexpected data in frame %u", i);
+
+    fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (buffer),
+        gst_util_uint64_scale (i, GST_SECOND, FPS_N));
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+        gst_util_uint64_scale (i + 1, GST_SECOND, FPS_N) -
+        GST_BUFFER_TIMESTAMP (buffer));
+  }
+}
+
+GST_START_TEST (test_pull)
+{
+  GstElement *videoparse = setup_videoparse ();
+
+  fail_unless_equals_int (gst_element_set_state (videoparse,
+          GST_STATE_PLAYING), GST_STATE_CHANGE_SUCCESS);
+  wait_for_eos ();
+
+  check_frames (0, N_FRAMES);
+
+  cleanup_videoparse (videoparse);
+}
+
+GST_END_TEST;
+
+/* writes the frames to a file and makes upstream report its URI */
+static gchar *
+write_file_data (void)
+{
+  gchar *filename;
+  gint fd;
+
+  fd = g_file_open_tmp ("videoparse-XXXXXX.raw", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (filename, (gchar *) file_data,
+          sizeof (file_data), NULL));
+
+  file_uri = g_filename_to_uri (filename, NULL, NULL);
+  fail_unless (file_uri != NULL);
+
+  return filename;
+}
+
+static void
+remove_file_data (gchar * filename)
+{
+  g_unlink (filename);
+  g_free (filename);
+  g_free (file_uri);
+  file_uri = NULL;
+}
+
+GST_START_TEST (test_pull_file)
+{
+  GstElement *videoparse = setup_videoparse ();
+  gchar *filename = write_file_data ();
+  gboolean use_mmap;
+
+  /* the file is only mapped on request */
+  g_object_get (videoparse, "use-mmap", &use_mmap, NULL);
+  fail_if (use_mmap);
+
+  fail_unless_equals_int (gst_element_set_state (videoparse,
+          GST_STATE_PLAYING), GST_STATE_CHANGE_SUCCESS);
+  wait_for_eos ();
+
+  check_frames (0, N_FRAMES);
+  fail_unless (g_atomic_int_get (&n_pulls) > 0);
+
+  cleanup_videoparse (videoparse);
+  remove_file_data (filename);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pull_mmap)
+{
+  GstElement *videoparse = setup_videoparse ();
+  gchar *filename = write_file_data ();
+
+  g_object_set (videoparse, "use-mmap", TRUE, NULL);
+
+  fail_unless_equals_int (gst_element_set_state (videoparse,
+          GST_STATE_PLAYING), GST_STATE_CHANGE_SUCCESS);
+  wait_for_eos ();
+
+  /* all frames come from the mapping, nothing is pulled */
+  check_frames (0, N_FRAMES);
+  fail_unless_equals_int (g_atomic_int_get (&n_pulls), 0);
+
+  /* seeking works the same way */
+  fail_unless (gst_element_seek (videoparse, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (3, GST_SECOND, FPS_N), GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (6, GST_SECOND, FPS_N)));
+  wait_for_eos ();
+  check_frames (3, 6);
+  fail_unless_equals_int (g_atomic_int_get (&n_pulls), 0);
+
+  cleanup_videoparse (videoparse);
+  remove_file_data (filename);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pull_seek)
+{
+  GstElement *videoparse = setup_videoparse ();
+
+  fail_unless_equals_int (gst_element_set_state (videoparse,
+          GST_STATE_PLAYING), GST_STATE_CHANGE_SUCCESS);
+  wait_for_eos ();
+
+  /* the frame starting at the stop position is not output any more */
+  fail_unless (gst_element_seek (videoparse, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (2, GST_SECOND, FPS_N), GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (5, GST_SECOND, FPS_N)));
+  wait_for_eos ();
+  check_frames (2, 5);
+
+  /* a stop position inside a frame includes that frame */
+  fail_unless (gst_element_seek (videoparse, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (6, GST_SECOND, FPS_N), GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (15, GST_SECOND, 2 * FPS_N)));
+  wait_for_eos ();
+  check_frames (6, 8);
+
+  /* clearing the stop position again plays until the end */
+  fail_unless (gst_element_seek (videoparse, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
+          gst_util_uint64_scale (7, GST_SECOND, FPS_N), GST_SEEK_TYPE_SET,
+          -1));
+  wait_for_eos ();
+  check_frames (7, N_FRAMES);
+
+  cleanup_videoparse (videoparse);
+}
+
+GST_END_TEST;
+
+static Suite *
+videoparse_suite (void)
+{
+  Suite *s = suite_create ("videoparse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_pull);
+  tcase_add_test (tc_chain, test_pull_seek);
+  tcase_add_test (tc_chain, test_pull_file);
+  tcase_add_test (tc_chain, test_pull_mmap);
+
+  return s;
+}
+
+GST_CHECK_MAIN (videoparse);
@@ -0,0 +1,260 @@
+/* GStreamer
+ *
+ * unit test for yadif
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+/* the width is not a multiple of any vector size, so the vector kernels
+ * also have to handle a tail; the height gives 3 slices of 32 lines */
+#define WIDTH 100
+#define HEIGHT 96
+#define N_FRAMES 3
+
+static const gchar *formats[] = {
+  "I420", "Y42B", "Y444", GST_VIDEO_NE (I420_10), GST_VIDEO_NE (I422_10),
+  GST_VIDEO_NE (Y444_10)
+};
+
+/* The element passes the same frame as previous, current and next field,
+ * and the parity only picks which of those the temporal check compares, so
+ * all parities give the same result. The filter mode is the mode property
+ * for all lines but the second and second to last one, which always use
+ * mode 2. */
+static const gchar *modes[] = { "auto", "interlaced" };
+
+static GstBuffer *
+make_frame (const GstVideoInfo * info, guint32 seed)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, info->size, NULL);
+  GRand *rand = g_rand_new_with_seed (seed);
+  GstMapInfo map;
+  gsize i;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  if (GST_VIDEO_INFO_COMP_DEPTH (info, 0) > 8) {
+    guint16 *data = (guint16 *) map.data;
+
+    for (i = 0; i < map.size / 2; i++)
+      data[i] = g_rand_int_range (rand, 0, 1 << 10);
+  } else {
+    for (i = 0; i < map.size; i++)
+      map.data[i] = g_rand_int_range (rand, 0, 256);
+  }
+  gst_buffer_unmap (buf, &map);
+  g_rand_free (rand);
+
+  return buf;
+}
+
+static void
+get_video_info (GstVideoInfo * info, const gchar * format)
+{
+  gst_video_info_init (info);
+  gst_video_info_set_format (info, gst_video_format_from_string (format),
+      WIDTH, HEIGHT);
+}
+
+/* Deinterlaces N_FRAMES frames and returns the output buffers. Without
+ * @simd the element falls back to its non-vector line filters. */
+static GList *
+run_yadif (const gchar * format, const gchar * mode, guint threads,
+    gboolean simd)
+{
+  GstHarness *h;
+  GstVideoInfo info;
+  GList *out = NULL;
+  gchar *caps;
+  guint i;
+
+  if (simd)
+    g_unsetenv ("GST_CPU_FEATURES_DISABLE");
+  else
+    g_setenv ("GST_CPU_FEATURES_DISABLE", "all", TRUE);
+
+  h = gst_harness_new ("yadif");
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", mode);
+  g_object_set (h->element, "threads", threads, NULL);
+
+  caps = g_strdup_printf ("video/x-raw, format=(string)%s, width=(int)%d, "
+      "height=(int)%d, framerate=(fraction)25/1, "
+      "interlace-mode=(string)interleaved", format, WIDTH, HEIGHT);
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (caps);
+
+  get_video_info (&info, format);
+  for (i = 0; i < N_FRAMES; i++) {
+    fail_unless_equals_int (gst_harness_push (h, make_frame (&info, i)),
+        GST_FLOW_OK);
+    out = g_list_append (out, gst_harness_pull (h));
+  }
+
+  gst_harness_teardown (h);
+  g_unsetenv ("GST_CPU_FEATURES_DISABLE");
+
+  return out;
+}
+
+static void
+assert_same_output (GList * a, GList * b, const gchar * what)
+{
+  fail_unless_equals_int (g_list_length (a), g_list_length (b));
+
+  for (; a && b; a = a->next, b = b->next) {
+    GstMapInfo map;
+
+    gst_buffer_map (a->data, &map, GST_MAP_READ);
+    fail_unless_equals_int (gst_buffer_get_size (b->data), map.size);
+    fail_unless (gst_buffer_memcmp (b->data, 0, map.data, map.size) == 0,
+        "output differs for %s", what);
+    gst_buffer_unmap (a->data, &map);
+  }
+}
+
+static void
+free_output (GList * out)
+{
+  g_list_free_full (out, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_START_TEST (test_simd_matches_fallback)
+{
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    for (j = 0; j < G_N_ELEMENTS (modes); j++) {
+      GList *simd = run_yadif (formats[i], modes[j], 1, TRUE);
+      GList *fallback = run_yadif (formats[i], modes[j], 1, FALSE);
+      gchar *what = g_strdup_printf ("%s, mode %s", formats[i], modes[j]);
+
+      assert_same_output (simd, fallback, what);
+
+      g_free (what);
+      free_output (simd);
+      free_output (fallback);
+    }
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_threads)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    GList *single = run_yadif (formats[i], "interlaced", 1, TRUE);
+    GList *multi = run_yadif (formats[i], "interlaced", 4, TRUE);
+    gchar *what = g_strdup_printf ("%s on 4 threads", formats[i]);
+
+    assert_same_output (single, multi, what);
+
+    g_free (what);
+    free_output (single);
+    free_output (multi);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_10bit)
+{
+  GstHarness *h;
+  GstVideoInfo info;
+  GstVideoFrame in_frame, out_frame;
+  GstBuffer *in, *out;
+  GstCaps *caps;
+  GstStructure *s;
+  gint comp, y;
+  gboolean changed = FALSE;
+
+  h = gst_harness_new ("yadif");
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", "interlaced");
+  gst_harness_set_src_caps_str (h, "video/x-raw, format=(string)"
+      GST_VIDEO_NE (I420_10) ", width=(int)100, height=(int)96, "
+      "framerate=(fraction)25/1, interlace-mode=(string)interleaved");
+
+  get_video_info (&info, GST_VIDEO_NE (I420_10));
+  in = make_frame (&info, 42);
+  fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (in)),
+      GST_FLOW_OK);
+  out = gst_harness_pull (h);
+
+  /* the 10 bit format is kept and only made progressive */
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (s, "format"),
+      GST_VIDEO_NE (I420_10));
+  fail_unless_equals_string (gst_structure_get_string (s, "interlace-mode"),
+      "progressive");
+  gst_caps_unref (caps);
+
+  /* the even lines are the kept field, the odd ones are interpolated */
+  fail_unless (gst_video_frame_map (&in_frame, &info, in, GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&out_frame, &info, out, GST_MAP_READ));
+  for (comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS (&info); comp++) {
+    gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&in_frame, comp);
+    gint w = GST_VIDEO_FRAME_COMP_WIDTH (&in_frame, comp);
+    gint hh = GST_VIDEO_FRAME_COMP_HEIGHT (&in_frame, comp);
+    const guint8 *in_data = GST_VIDEO_FRAME_COMP_DATA (&in_frame, comp);
+    const guint8 *out_data = GST_VIDEO_FRAME_COMP_DATA (&out_frame, comp);
+
+    for (y = 0; y < hh; y++) {
+      const guint16 *out_line = (const guint16 *) (out_data + y * stride);
+      gint x;
+
+      if (y % 2 == 0) {
+        fail_unless (memcmp (in_data + y * stride, out_line, w * 2) == 0,
+            "kept line %d of component %d was modified", y, comp);
+      } else if (memcmp (in_data + y * stride, out_line, w * 2) != 0) {
+        changed = TRUE;
+      }
+
+      /* no overflow into the unused bits */
+      for (x = 0; x < w; x++)
+        fail_unless (out_line[x] < (1 << 10));
+    }
+  }
+  fail_unless (changed);
+  gst_video_frame_unmap (&out_frame);
+  gst_video_frame_unmap (&in_frame);
+
+  gst_buffer_unref (in);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+yadif_suite (void)
+{
+  Suite *s = suite_create ("yadif");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_simd_matches_fallback);
+  tcase_add_test (tc_chain, test_threads);
+  tcase_add_test (tc_chain, test_10bit);
+
+  return s;
+}
+
+GST_CHECK_MAIN (yadif);
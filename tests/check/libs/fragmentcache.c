@@ -0,0 +1,349 @@
+/* GStreamer
+ *
+ * unit test for GstFragmentCache
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/uridownloader/gstfragmentcache.h>
+
+#define FRAGMENT_URI "http://cdn.example.com/fragment.ts"
+#define KEY_URI "https://keys.example.com/key.bin"
+
+static GstBuffer *
+make_buffer (gsize size, guint8 fill)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, size, NULL);
+
+  gst_buffer_memset (buffer, 0, fill, size);
+
+  return buffer;
+}
+
+static void
+check_buffer (GstBuffer * buffer, gsize size, guint8 fill)
+{
+  GstMapInfo map;
+  gsize i;
+
+  fail_unless (buffer != NULL);
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.size, size);
+  for (i = 0; i < map.size; i++)
+    fail_unless_equals_int (map.data[i], fill);
+  gst_buffer_unmap (buffer, &map);
+}
+
+static gboolean
+insert (GstFragmentCache * cache, const gchar * uri, gint64 range_start,
+    gint64 range_end, gsize size, guint8 fill, GstFragmentCacheFlags flags)
+{
+  GstBuffer *buffer = make_buffer (size, fill);
+  gboolean ret;
+
+  ret = gst_fragment_cache_insert (cache, uri, range_start, range_end, buffer,
+      NULL, NULL, FALSE, flags);
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static gboolean
+is_cached (GstFragmentCache * cache, const gchar * uri, gint64 range_start,
+    gint64 range_end)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_fragment_cache_lookup (cache, uri, range_start, range_end,
+      NULL, NULL);
+  if (buffer == NULL)
+    return FALSE;
+
+  gst_buffer_unref (buffer);
+  return TRUE;
+}
+
+GST_START_TEST (test_hit_miss)
+{
+  GstFragmentCache *cache;
+  GstBuffer *buffer;
+  guint64 hits, misses;
+
+  cache = gst_fragment_cache_new (1024);
+
+  fail_if (is_cached (cache, FRAGMENT_URI, 0, -1));
+  fail_unless (insert (cache, FRAGMENT_URI, 0, -1, 100, 0xab,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+
+  buffer = gst_fragment_cache_lookup (cache, FRAGMENT_URI, 0, -1, NULL, NULL);
+  check_buffer (buffer, 100, 0xab);
+  gst_buffer_unref (buffer);
+
+  fail_if (is_cached (cache, KEY_URI, 0, -1));
+
+  gst_fragment_cache_get_stats (cache, &hits, &misses);
+  fail_unless_equals_uint64 (hits, 1);
+  fail_unless_equals_uint64 (misses, 2);
+
+  gst_fragment_cache_clear (cache);
+  fail_if (is_cached (cache, FRAGMENT_URI, 0, -1));
+
+  gst_object_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_range)
+{
+  GstFragmentCache *cache;
+  GstBuffer *buffer;
+
+  cache = gst_fragment_cache_new (1024);
+
+  fail_unless (insert (cache, FRAGMENT_URI, 0, 99, 100, 1,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_unless (insert (cache, FRAGMENT_URI, 100, 199, 100, 2,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+
+  buffer = gst_fragment_cache_lookup (cache, FRAGMENT_URI, 100, 199, NULL,
+      NULL);
+  check_buffer (buffer, 100, 2);
+  gst_buffer_unref (buffer);
+
+  buffer = gst_fragment_cache_lookup (cache, FRAGMENT_URI, 0, 99, NULL, NULL);
+  check_buffer (buffer, 100, 1);
+  gst_buffer_unref (buffer);
+
+  /* other ranges of the same URI are different entries */
+  fail_if (is_cached (cache, FRAGMENT_URI, 0, -1));
+  fail_if (is_cached (cache, FRAGMENT_URI, 0, 199));
+  fail_if (is_cached (cache, FRAGMENT_URI, 200, 299));
+
+  /* inserting the same range again replaces the entry */
+  fail_unless (insert (cache, FRAGMENT_URI, 0, 99, 50, 3,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  buffer = gst_fragment_cache_lookup (cache, FRAGMENT_URI, 0, 99, NULL, NULL);
+  check_buffer (buffer, 50, 3);
+  gst_buffer_unref (buffer);
+
+  gst_object_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_eviction)
+{
+  GstFragmentCache *cache;
+  guint64 size;
+
+  cache = gst_fragment_cache_new (250);
+
+  fail_unless (insert (cache, "http://a/1", 0, -1, 100, 1,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_unless (insert (cache, "http://a/2", 0, -1, 100, 2,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+
+  /* make 2 the least recently used entry */
+  fail_unless (is_cached (cache, "http://a/1", 0, -1));
+
+  fail_unless (insert (cache, "http://a/3", 0, -1, 100, 3,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+
+  fail_unless (is_cached (cache, "http://a/1", 0, -1));
+  fail_if (is_cached (cache, "http://a/2", 0, -1));
+  fail_unless (is_cached (cache, "http://a/3", 0, -1));
+
+  g_object_get (cache, "size", &size, NULL);
+  fail_unless_equals_uint64 (size, 200);
+
+  /* entries bigger than the cache are not stored at all */
+  fail_if (insert (cache, "http://a/4", 0, -1, 251, 4,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_unless (is_cached (cache, "http://a/1", 0, -1));
+  fail_unless (is_cached (cache, "http://a/3", 0, -1));
+
+  /* shrinking the cache evicts immediately on the next insert */
+  g_object_set (cache, "max-size", (guint64) 100, NULL);
+  fail_unless (insert (cache, "http://a/5", 0, -1, 100, 5,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_if (is_cached (cache, "http://a/1", 0, -1));
+  fail_if (is_cached (cache, "http://a/3", 0, -1));
+  fail_unless (is_cached (cache, "http://a/5", 0, -1));
+
+  gst_object_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_headers)
+{
+  GstFragmentCache *cache;
+  GstStructure *headers, *response;
+  GstBuffer *buffer;
+
+  cache = gst_fragment_cache_new (1024);
+  buffer = make_buffer (10, 0);
+
+  response = gst_structure_new ("response-headers", "Cache-Control",
+      G_TYPE_STRING, "private, no-store", NULL);
+  headers = gst_structure_new ("http-headers", "response-headers",
+      GST_TYPE_STRUCTURE, response, NULL);
+  fail_if (gst_fragment_cache_insert (cache, FRAGMENT_URI, 0, -1, buffer,
+          headers, NULL, FALSE, GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_if (is_cached (cache, FRAGMENT_URI, 0, -1));
+  gst_structure_free (headers);
+  gst_structure_free (response);
+
+  response = gst_structure_new ("response-headers", "Cache-Control",
+      G_TYPE_STRING, "max-age=3600", NULL);
+  headers = gst_structure_new ("http-headers", "response-headers",
+      GST_TYPE_STRUCTURE, response, NULL);
+  fail_unless (gst_fragment_cache_insert (cache, FRAGMENT_URI, 0, -1, buffer,
+          headers, NULL, FALSE, GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_unless (is_cached (cache, FRAGMENT_URI, 0, -1));
+  gst_structure_free (headers);
+  gst_structure_free (response);
+
+  gst_buffer_unref (buffer);
+  gst_object_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_redirect)
+{
+  GstFragmentCache *cache;
+  GstBuffer *buffer;
+  gchar *redirect_uri;
+  gboolean redirect_permanent;
+
+  cache = gst_fragment_cache_new (1024);
+  buffer = make_buffer (10, 0);
+
+  fail_unless (gst_fragment_cache_insert (cache, FRAGMENT_URI, 0, -1, buffer,
+          NULL, "http://mirror.example.com/fragment.ts", TRUE,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  fail_unless (gst_fragment_cache_insert (cache, KEY_URI, 0, -1, buffer,
+          NULL, NULL, FALSE, GST_FRAGMENT_CACHE_FLAG_NONE));
+  gst_buffer_unref (buffer);
+
+  buffer = gst_fragment_cache_lookup (cache, FRAGMENT_URI, 0, -1,
+      &redirect_uri, &redirect_permanent);
+  fail_unless (buffer != NULL);
+  fail_unless_equals_string (redirect_uri,
+      "http://mirror.example.com/fragment.ts");
+  fail_unless (redirect_permanent);
+  gst_buffer_unref (buffer);
+  g_free (redirect_uri);
+
+  buffer = gst_fragment_cache_lookup (cache, KEY_URI, 0, -1,
+      &redirect_uri, &redirect_permanent);
+  fail_unless (buffer != NULL);
+  fail_unless (redirect_uri == NULL);
+  fail_if (redirect_permanent);
+  gst_buffer_unref (buffer);
+
+  gst_object_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_disk)
+{
+  GstFragmentCache *cache;
+  GstBuffer *buffer;
+  gchar *location, *redirect_uri;
+  gboolean redirect_permanent;
+  const gchar *name;
+  GDir *dir;
+  guint n_files = 0;
+
+  location = g_dir_make_tmp ("fragmentcache-XXXXXX", NULL);
+  fail_unless (location != NULL);
+
+  cache = gst_fragment_cache_new (1024);
+  gst_fragment_cache_set_location (cache, location, 1024);
+
+  /* keys are only kept in memory, fragments are persisted */
+  fail_unless (insert (cache, KEY_URI, 0, -1, 16, 0x55,
+          GST_FRAGMENT_CACHE_FLAG_NONE));
+  buffer = make_buffer (100, 0xaa);
+  fail_unless (gst_fragment_cache_insert (cache, FRAGMENT_URI, 0, 99, buffer,
+          NULL, "http://mirror.example.com/fragment.ts", FALSE,
+          GST_FRAGMENT_CACHE_FLAG_PERSIST));
+  gst_buffer_unref (buffer);
+  gst_object_unref (cache);
+
+  dir = g_dir_open (location, 0, NULL);
+  fail_unless (dir != NULL);
+  while ((name = g_dir_read_name (dir)))
+    n_files++;
+  g_dir_close (dir);
+  fail_unless_equals_int (n_files, 1);
+
+  /* a new cache picks up the fragment stored by the previous one */
+  cache = gst_fragment_cache_new (1024);
+  gst_fragment_cache_set_location (cache, location, 1024);
+
+  fail_if (is_cached (cache, KEY_URI, 0, -1));
+  buffer = gst_fragment_cache_lookup (cache, FRAGMENT_URI, 0, 99,
+      &redirect_uri, &redirect_permanent);
+  check_buffer (buffer, 100, 0xaa);
+  fail_unless_equals_string (redirect_uri,
+      "http://mirror.example.com/fragment.ts");
+  fail_if (redirect_permanent);
+  gst_buffer_unref (buffer);
+  g_free (redirect_uri);
+
+  /* evicted from memory and disk when it no longer fits */
+  fail_unless (insert (cache, "http://cdn.example.com/other.ts", 0, -1, 1000,
+          1, GST_FRAGMENT_CACHE_FLAG_PERSIST));
+  fail_if (is_cached (cache, FRAGMENT_URI, 0, 99));
+  fail_unless (is_cached (cache, "http://cdn.example.com/other.ts", 0, -1));
+
+  gst_fragment_cache_clear (cache);
+  gst_object_unref (cache);
+
+  fail_unless (g_rmdir (location) == 0);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+static Suite *
+fragment_cache_suite (void)
+{
+  Suite *s = suite_create ("fragmentcache");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_hit_miss);
+  tcase_add_test (tc_chain, test_range);
+  tcase_add_test (tc_chain, test_eviction);
+  tcase_add_test (tc_chain, test_headers);
+  tcase_add_test (tc_chain, test_redirect);
+  tcase_add_test (tc_chain, test_disk);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fragment_cache);
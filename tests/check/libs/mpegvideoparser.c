@@ -163,6 +163,80 @@ GST_START_TEST (test_mis_identified_datas)
 
 GST_END_TEST;
 
+/* Random data with start codes all over the place, including overlapping
+ * and truncated ones. The size is not a multiple of any vector size. */
+#define SCAN_DATA_SIZE 4099
+
+static guint8 *
+make_scan_data (void)
+{
+  static const guint8 values[] = { 0x00, 0x00, 0x00, 0x01, 0xb3, 0xff };
+  guint8 *data = g_malloc (SCAN_DATA_SIZE);
+  GRand *rand = g_rand_new_with_seed (42);
+  guint i;
+
+  for (i = 0; i < SCAN_DATA_SIZE; i++)
+    data[i] = values[g_rand_int_range (rand, 0, G_N_ELEMENTS (values))];
+  /* one at the very end without the byte that has to follow it */
+  data[SCAN_DATA_SIZE - 3] = 0x00;
+  data[SCAN_DATA_SIZE - 2] = 0x00;
+  data[SCAN_DATA_SIZE - 1] = 0x01;
+  g_rand_free (rand);
+
+  return data;
+}
+
+/* Checks that the packets found are exactly the 00 00 01 xx sequences */
+static void
+check_scan (void)
+{
+  GstMpegVideoPacket packet = { 0, };
+  guint8 *data = make_scan_data ();
+  guint i, offset = 0, n_found = 0, n_expected = 0;
+
+  for (i = 0; i + 3 < SCAN_DATA_SIZE; i++) {
+    if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01)
+      n_expected++;
+  }
+  fail_unless (n_expected > 0);
+
+  while (gst_mpeg_video_parse (&packet, data, SCAN_DATA_SIZE, offset)) {
+    guint start = packet.offset - 4;
+
+    for (i = offset; i < start; i++) {
+      fail_if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01,
+          "missed the start code at %u", i);
+    }
+    fail_unless (data[start] == 0x00 && data[start + 1] == 0x00 &&
+        data[start + 2] == 0x01, "no start code at %u", start);
+    n_found++;
+
+    /* the next one can begin on the type byte of this one */
+    offset = start + 3;
+  }
+  fail_unless_equals_int (n_found, n_expected);
+
+  g_free (data);
+}
+
+GST_START_TEST (test_scan_start_codes)
+{
+  check_scan ();
+}
+
+GST_END_TEST;
+
+/* Every test runs in its own process, so the scanner only reads the CPU
+ * features after this and uses its scalar loop */
+GST_START_TEST (test_scan_start_codes_scalar)
+{
+  g_setenv ("GST_CPU_FEATURES_DISABLE", "all", TRUE);
+  check_scan ();
+  g_unsetenv ("GST_CPU_FEATURES_DISABLE");
+}
+
+GST_END_TEST;
+
 static Suite *
 mpegvideoparsers_suite (void)
 {
@@ -175,6 +249,8 @@ mpegvideoparsers_suite (void)
   tcase_add_test (tc_chain, test_mpeg_parse_sequence_header);
   tcase_add_test (tc_chain, test_mpeg_parse_sequence_extension);
   tcase_add_test (tc_chain, test_mis_identified_datas);
+  tcase_add_test (tc_chain, test_scan_start_codes);
+  tcase_add_test (tc_chain, test_scan_start_codes_scalar);
 
   return s;
 }
@@ -0,0 +1,233 @@
+/* GStreamer
+ *
+ * unit test for GstUriDownloader
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/uridownloader/gsturidownloader.h>
+
+#include "../elements/test_http_src.h"
+
+#define PAYLOAD_SIZE 64
+
+static GQuark uses_quark;
+static guint sources_created;
+static guint last_source_uses;
+static gboolean last_source_running;
+
+/* counts the requests of every source element, so re-used elements can be
+ * told apart from new ones even if they end up at the same address. A
+ * source that is kept running issues its requests from a seek */
+static gboolean
+src_start (GstTestHTTPSrc * src, const gchar * uri,
+    GstTestHTTPSrcInput * input_data, gpointer user_data)
+{
+  guint uses = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (src),
+          uses_quark));
+
+  if (uses == 0)
+    sources_created++;
+  g_object_set_qdata (G_OBJECT (src), uses_quark, GUINT_TO_POINTER (++uses));
+  last_source_uses = uses;
+  last_source_running = GST_STATE (src) >= GST_STATE_PAUSED;
+
+  input_data->size = PAYLOAD_SIZE;
+  return TRUE;
+}
+
+static GstFlowReturn
+src_create (GstTestHTTPSrc * src, guint64 offset, guint length,
+    GstBuffer ** retbuf, gpointer context, gpointer user_data)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, length, NULL);
+
+  gst_buffer_memset (buf, 0, 0xAB, length);
+  *retbuf = buf;
+
+  return GST_FLOW_OK;
+}
+
+static const GstTestHTTPSrcCallbacks callbacks = { src_start, src_create };
+
+static void
+setup (void)
+{
+  fail_unless (gst_test_http_src_register_plugin (gst_registry_get (),
+          "testhttpsrc"));
+  gst_test_http_src_install_callbacks (&callbacks, NULL);
+  uses_quark = g_quark_from_static_string ("uridownloader-test-uses");
+  sources_created = 0;
+  last_source_uses = 0;
+  last_source_running = FALSE;
+}
+
+static void
+teardown (void)
+{
+  gst_test_http_src_install_callbacks (NULL, NULL);
+}
+
+static void
+fetch_range (GstUriDownloader * downloader, const gchar * uri,
+    gint64 range_start, gint64 range_end, gsize size)
+{
+  GstFragment *fragment;
+  GstBuffer *buffer;
+  GError *err = NULL;
+
+  fragment = gst_uri_downloader_fetch_uri_with_range (downloader, uri, NULL,
+      FALSE, FALSE, FALSE, range_start, range_end, &err);
+  fail_unless (fragment != NULL, "fetching %s failed: %s", uri,
+      err ? err->message : "no error");
+  fail_unless (fragment->completed);
+
+  buffer = gst_fragment_get_buffer (fragment);
+  if (size == 0) {
+    fail_unless (buffer == NULL);
+  } else {
+    fail_unless (buffer != NULL);
+    fail_unless_equals_int (gst_buffer_get_size (buffer), size);
+    gst_buffer_unref (buffer);
+  }
+  g_object_unref (fragment);
+}
+
+static void
+fetch (GstUriDownloader * downloader, const gchar * uri)
+{
+  fetch_range (downloader, uri, 0, -1, PAYLOAD_SIZE);
+}
+
+GST_START_TEST (test_reuse_source)
+{
+  GstUriDownloader *downloader = gst_uri_downloader_new ();
+
+  fetch (downloader, "http://a.test/1");
+  fail_unless_equals_int (sources_created, 1);
+  fail_unless_equals_int (last_source_uses, 1);
+
+  /* same host, the source is re-aimed at the new URI */
+  fetch (downloader, "http://a.test/2");
+  fail_unless_equals_int (sources_created, 1);
+  fail_unless_equals_int (last_source_uses, 2);
+
+  /* another host gets its own source, the first one is kept */
+  fetch (downloader, "http://b.test/1");
+  fail_unless_equals_int (sources_created, 2);
+  fail_unless_equals_int (last_source_uses, 1);
+
+  fetch (downloader, "http://a.test/3");
+  fail_unless_equals_int (sources_created, 2);
+  fail_unless_equals_int (last_source_uses, 3);
+
+  /* a different port is a different server */
+  fetch (downloader, "http://a.test:8080/1");
+  fail_unless_equals_int (sources_created, 3);
+  fail_unless_equals_int (last_source_uses, 1);
+
+  g_object_unref (downloader);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_source_limit)
+{
+  GstUriDownloader *downloader = gst_uri_downloader_new ();
+
+  fetch (downloader, "http://a.test/1");
+  fetch (downloader, "http://b.test/1");
+  fetch (downloader, "http://c.test/1");
+  fetch (downloader, "http://d.test/1");
+  fail_unless_equals_int (sources_created, 4);
+
+  /* all four are still around */
+  fetch (downloader, "http://a.test/2");
+  fail_unless_equals_int (sources_created, 4);
+  fail_unless_equals_int (last_source_uses, 2);
+
+  /* a fifth host pushes out the least recently used one, b.test */
+  fetch (downloader, "http://e.test/1");
+  fail_unless_equals_int (sources_created, 5);
+
+  fetch (downloader, "http://b.test/2");
+  fail_unless_equals_int (sources_created, 6);
+  fail_unless_equals_int (last_source_uses, 1);
+
+  fetch (downloader, "http://a.test/3");
+  fail_unless_equals_int (sources_created, 6);
+  fail_unless_equals_int (last_source_uses, 3);
+
+  g_object_unref (downloader);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_keep_source_running)
+{
+  GstUriDownloader *downloader = gst_uri_downloader_new ();
+
+  fetch (downloader, "http://a.test/1");
+  fail_unless_equals_int (last_source_uses, 1);
+  fail_if (last_source_running);
+
+  /* the source was left running and only gets seeked for the next request,
+   * with or without a range */
+  fetch_range (downloader, "http://a.test/2", 16, -1, PAYLOAD_SIZE - 16);
+  fail_unless_equals_int (sources_created, 1);
+  fail_unless_equals_int (last_source_uses, 2);
+  fail_unless (last_source_running);
+
+  fetch (downloader, "http://a.test/3");
+  fail_unless_equals_int (last_source_uses, 3);
+  fail_unless (last_source_running);
+
+  /* HEAD requests don't return any data */
+  fetch_range (downloader, "http://a.test/4", -1, -1, 0);
+  fail_unless_equals_int (last_source_uses, 4);
+  fail_unless (last_source_running);
+
+  fetch (downloader, "http://a.test/5");
+  fail_unless_equals_int (sources_created, 1);
+  fail_unless_equals_int (last_source_uses, 5);
+  fail_unless (last_source_running);
+
+  g_object_unref (downloader);
+}
+
+GST_END_TEST;
+
+static Suite *
+uridownloader_suite (void)
+{
+  Suite *s = suite_create ("uridownloader");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_reuse_source);
+  tcase_add_test (tc_chain, test_source_limit);
+  tcase_add_test (tc_chain, test_keep_source_running);
+
+  return s;
+}
+
+GST_CHECK_MAIN (uridownloader);
@@ -211,6 +211,76 @@ GST_START_TEST (test_vp8_parse_inter_frame)
 
 GST_END_TEST;
 
+#define N_BATCH_FRAMES 128
+
+GST_START_TEST (test_vp8_parse_frame_headers)
+{
+  const guint8 *frames[N_BATCH_FRAMES];
+  gsize sizes[N_BATCH_FRAMES];
+  GstVp8FrameHdr *frame_hdrs;
+  GstVp8ParserResult results[N_BATCH_FRAMES];
+  GstVp8Parser parser, batch_parser;
+  guint i;
+
+  /* key and inter frames alternate, so every inter frame depends on the
+   * state left behind by the key frame before it */
+  for (i = 0; i < N_BATCH_FRAMES; i++) {
+    if (i % 2 == 0) {
+      frames[i] = vp8_frame_data_0;
+      sizes[i] = sizeof (vp8_frame_data_0);
+    } else {
+      frames[i] = vp8_frame_data_1;
+      sizes[i] = sizeof (vp8_frame_data_1);
+    }
+  }
+
+  gst_vp8_parser_init (&parser);
+  gst_vp8_parser_init (&batch_parser);
+
+  frame_hdrs = g_new0 (GstVp8FrameHdr, N_BATCH_FRAMES);
+  gst_vp8_parser_parse_frame_headers (&batch_parser, frames, sizes,
+      N_BATCH_FRAMES, 4, frame_hdrs, results);
+
+  for (i = 0; i < N_BATCH_FRAMES; i++) {
+    GstVp8FrameHdr frame_hdr;
+
+    memset (&frame_hdr, 0, sizeof (frame_hdr));
+    assert_equals_int (gst_vp8_parser_parse_frame_header (&parser, &frame_hdr,
+            frames[i], sizes[i]), GST_VP8_PARSER_OK);
+
+    assert_equals_int (results[i], GST_VP8_PARSER_OK);
+    assert_equals_int (frame_hdrs[i].key_frame, frame_hdr.key_frame);
+    assert_equals_int (frame_hdrs[i].first_part_size,
+        frame_hdr.first_part_size);
+    assert_equals_int (frame_hdrs[i].width, frame_hdr.width);
+    assert_equals_int (frame_hdrs[i].height, frame_hdr.height);
+    assert_equals_int (frame_hdrs[i].quant_indices.y_ac_qi,
+        frame_hdr.quant_indices.y_ac_qi);
+    assert_equals_int (frame_hdrs[i].prob_skip_false,
+        frame_hdr.prob_skip_false);
+    assert_equals_int (frame_hdrs[i].prob_intra, frame_hdr.prob_intra);
+    assert_equals_int (frame_hdrs[i].rd_range, frame_hdr.rd_range);
+    assert_equals_int (frame_hdrs[i].rd_value, frame_hdr.rd_value);
+    assert_equals_int (frame_hdrs[i].rd_count, frame_hdr.rd_count);
+  }
+
+  /* both parsers end up with the same probabilities and adjustments */
+  assert_equals_int (memcmp (&parser.token_probs, &batch_parser.token_probs,
+          sizeof (parser.token_probs)), 0);
+  assert_equals_int (memcmp (&parser.mv_probs, &batch_parser.mv_probs,
+          sizeof (parser.mv_probs)), 0);
+  assert_equals_int (memcmp (&parser.mode_probs, &batch_parser.mode_probs,
+          sizeof (parser.mode_probs)), 0);
+  assert_equals_int (memcmp (&parser.mb_lf_adjust, &batch_parser.mb_lf_adjust,
+          sizeof (parser.mb_lf_adjust)), 0);
+  assert_equals_int (memcmp (&parser.segmentation, &batch_parser.segmentation,
+          sizeof (parser.segmentation)), 0);
+
+  g_free (frame_hdrs);
+}
+
+GST_END_TEST;
+
 static Suite *
 vp8parsers_suite (void)
 {
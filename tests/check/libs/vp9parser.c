@@ -0,0 +1,300 @@
+/* GStreamer
+ *
+ * unit test for the VP9 parser library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/codecparsers/gstvp9parser.h>
+
+/* A 352x288 profile 0 key frame, base_q_idx 60, filter level 10 and a first
+ * partition of 100 bytes, followed by two bytes of payload */
+static const guint8 vp9_key_frame_cif[] = {
+  0x82, 0x49, 0x83, 0x42, 0x40, 0x15, 0xf0, 0x11, 0xf6, 0x14, 0x07, 0x80,
+  0x00, 0x64, 0x00, 0x00
+};
+
+/* The same key frame at 176x144 */
+static const guint8 vp9_key_frame_qcif[] = {
+  0x82, 0x49, 0x83, 0x42, 0x40, 0x0a, 0xf0, 0x08, 0xf6, 0x14, 0x07, 0x80,
+  0x00, 0x64, 0x00, 0x00
+};
+
+/* An inter frame taking its size from reference slot 0 and refreshing only
+ * that slot, base_q_idx 70, filter level 8 and a first partition of 50
+ * bytes, followed by two bytes of payload */
+static const guint8 vp9_inter_frame[] = {
+  0x86, 0x00, 0x40, 0x92, 0xe4, 0x80, 0x46, 0x00, 0x01, 0x90, 0x00, 0x00
+};
+
+#define N_PACKETS 64
+
+/* Builds a superframe of two inter frames, with one byte per frame size */
+static guint8 *
+make_superframe (gsize * size)
+{
+  const gsize frame_size = sizeof (vp9_inter_frame);
+  guint8 *data;
+
+  *size = 2 * frame_size + 4;
+  data = g_malloc (*size);
+  memcpy (data, vp9_inter_frame, frame_size);
+  memcpy (data + frame_size, vp9_inter_frame, frame_size);
+  data[2 * frame_size] = 0xc1;
+  data[2 * frame_size + 1] = frame_size;
+  data[2 * frame_size + 2] = frame_size;
+  data[2 * frame_size + 3] = 0xc1;
+
+  return data;
+}
+
+GST_START_TEST (test_vp9_parse_key_frame)
+{
+  GstVp9Parser *parser;
+  GstVp9FrameHdr frame_hdr;
+
+  parser = gst_vp9_parser_new ();
+
+  assert_equals_int (gst_vp9_parser_parse_frame_header (parser, &frame_hdr,
+          vp9_key_frame_cif, sizeof (vp9_key_frame_cif)), GST_VP9_PARSER_OK);
+
+  assert_equals_int (frame_hdr.profile, GST_VP9_PROFILE_0);
+  assert_equals_int (frame_hdr.frame_type, GST_VP9_KEY_FRAME);
+  assert_equals_int (frame_hdr.show_frame, 1);
+  assert_equals_int (frame_hdr.bit_depth, GST_VP9_BIT_DEPTH_8);
+  assert_equals_int (frame_hdr.color_space, GST_VP9_CS_BT_709);
+  assert_equals_int (frame_hdr.width, 352);
+  assert_equals_int (frame_hdr.height, 288);
+  assert_equals_int (frame_hdr.loopfilter.filter_level, 10);
+  assert_equals_int (frame_hdr.quant_indices.y_ac_qi, 60);
+  assert_equals_int (frame_hdr.first_partition_size, 100);
+  assert_equals_int (frame_hdr.frame_header_length_in_bytes, 14);
+
+  /* the inter frame inherits the size of the key frame */
+  assert_equals_int (gst_vp9_parser_parse_frame_header (parser, &frame_hdr,
+          vp9_inter_frame, sizeof (vp9_inter_frame)), GST_VP9_PARSER_OK);
+
+  assert_equals_int (frame_hdr.frame_type, GST_VP9_INTER_FRAME);
+  assert_equals_int (frame_hdr.width, 352);
+  assert_equals_int (frame_hdr.height, 288);
+  assert_equals_int (frame_hdr.refresh_frame_flags, 0x01);
+  assert_equals_int (frame_hdr.mcomp_filter_type,
+      GST_VP9_INTERPOLATION_FILTER_SWITCHABLE);
+  assert_equals_int (frame_hdr.quant_indices.y_ac_qi, 70);
+  assert_equals_int (frame_hdr.first_partition_size, 50);
+  assert_equals_int (frame_hdr.frame_header_length_in_bytes, 10);
+
+  gst_vp9_parser_free (parser);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_vp9_parse_superframe_info)
+{
+  GstVp9Parser *parser;
+  GstVp9SuperframeInfo info;
+  guint8 *superframe;
+  gsize size;
+
+  parser = gst_vp9_parser_new ();
+
+  /* a packet without index is a single frame */
+  assert_equals_int (gst_vp9_parser_parse_superframe_info (parser, &info,
+          vp9_inter_frame, sizeof (vp9_inter_frame)), GST_VP9_PARSER_OK);
+  assert_equals_int (info.frames_in_superframe, 1);
+  assert_equals_int (info.frame_sizes[0], sizeof (vp9_inter_frame));
+  assert_equals_int (info.superframe_index_size, 0);
+
+  superframe = make_superframe (&size);
+  assert_equals_int (gst_vp9_parser_parse_superframe_info (parser, &info,
+          superframe, size), GST_VP9_PARSER_OK);
+  assert_equals_int (info.bytes_per_framesize, 1);
+  assert_equals_int (info.frames_in_superframe, 2);
+  assert_equals_int (info.frame_sizes[0], sizeof (vp9_inter_frame));
+  assert_equals_int (info.frame_sizes[1], sizeof (vp9_inter_frame));
+  assert_equals_int (info.superframe_index_size, 4);
+
+  /* an index pointing past the end of the packet is rejected */
+  superframe[size - 2] = 0xff;
+  assert_equals_int (gst_vp9_parser_parse_superframe_info (parser, &info,
+          superframe, size), GST_VP9_PARSER_BROKEN_DATA);
+
+  /* a trailing byte that looks like a marker without the matching first
+   * marker is not an index */
+  superframe[size - 4] = 0x00;
+  assert_equals_int (gst_vp9_parser_parse_superframe_info (parser, &info,
+          superframe, size), GST_VP9_PARSER_OK);
+  assert_equals_int (info.frames_in_superframe, 1);
+  assert_equals_int (info.frame_sizes[0], size);
+
+  g_free (superframe);
+  gst_vp9_parser_free (parser);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_vp9_parse_frame_headers)
+{
+  const guint8 *packets[N_PACKETS];
+  gsize sizes[N_PACKETS];
+  GstVp9Parser *parser, *batch_parser;
+  GArray *frames;
+  guint8 *superframe;
+  gsize superframe_size;
+  guint i, j, n_frames = 0;
+
+  superframe = make_superframe (&superframe_size);
+
+  /* the key frame size changes halfway through, so the inter frames after
+   * it only get the right size if the batch resolves them in order */
+  for (i = 0; i < N_PACKETS; i++) {
+    if (i == 0) {
+      packets[i] = vp9_key_frame_cif;
+      sizes[i] = sizeof (vp9_key_frame_cif);
+    } else if (i == N_PACKETS / 2) {
+      packets[i] = vp9_key_frame_qcif;
+      sizes[i] = sizeof (vp9_key_frame_qcif);
+    } else if (i % 2) {
+      packets[i] = superframe;
+      sizes[i] = superframe_size;
+    } else {
+      packets[i] = vp9_inter_frame;
+      sizes[i] = sizeof (vp9_inter_frame);
+    }
+  }
+
+  parser = gst_vp9_parser_new ();
+  batch_parser = gst_vp9_parser_new ();
+
+  frames = gst_vp9_parser_parse_frame_headers (batch_parser, packets, sizes,
+      N_PACKETS, 4);
+  fail_unless (frames != NULL);
+
+  for (i = 0; i < N_PACKETS; i++) {
+    GstVp9SuperframeInfo info;
+    guint32 offset = 0;
+
+    assert_equals_int (gst_vp9_parser_parse_superframe_info (parser, &info,
+            packets[i], sizes[i]), GST_VP9_PARSER_OK);
+
+    for (j = 0; j < info.frames_in_superframe; j++) {
+      GstVp9BatchFrame *frame;
+      GstVp9FrameHdr frame_hdr;
+
+      fail_unless (n_frames < frames->len);
+      frame = &g_array_index (frames, GstVp9BatchFrame, n_frames);
+
+      assert_equals_int (gst_vp9_parser_parse_frame_header (parser,
+              &frame_hdr, packets[i] + offset, info.frame_sizes[j]),
+          GST_VP9_PARSER_OK);
+
+      assert_equals_int (frame->packet, i);
+      assert_equals_int (frame->offset, offset);
+      assert_equals_int (frame->size, info.frame_sizes[j]);
+      assert_equals_int (frame->result, GST_VP9_PARSER_OK);
+      assert_equals_int (frame->frame_hdr.frame_type, frame_hdr.frame_type);
+      assert_equals_int (frame->frame_hdr.width, frame_hdr.width);
+      assert_equals_int (frame->frame_hdr.height, frame_hdr.height);
+      assert_equals_int (frame->frame_hdr.refresh_frame_flags,
+          frame_hdr.refresh_frame_flags);
+      assert_equals_int (frame->frame_hdr.quant_indices.y_ac_qi,
+          frame_hdr.quant_indices.y_ac_qi);
+      assert_equals_int (frame->frame_hdr.loopfilter.filter_level,
+          frame_hdr.loopfilter.filter_level);
+      assert_equals_int (frame->frame_hdr.first_partition_size,
+          frame_hdr.first_partition_size);
+      assert_equals_int (frame->frame_hdr.frame_header_length_in_bytes,
+          frame_hdr.frame_header_length_in_bytes);
+
+      offset += info.frame_sizes[j];
+      n_frames++;
+    }
+  }
+  assert_equals_int (frames->len, n_frames);
+
+  /* the last inter frame follows the QCIF key frame */
+  assert_equals_int (g_array_index (frames, GstVp9BatchFrame,
+          n_frames - 1).frame_hdr.width, 176);
+  assert_equals_int (g_array_index (frames, GstVp9BatchFrame,
+          n_frames - 1).frame_hdr.height, 144);
+
+  /* both parsers end up in the same state */
+  assert_equals_int (memcmp (parser->segmentation,
+          batch_parser->segmentation, sizeof (parser->segmentation)), 0);
+
+  g_array_free (frames, TRUE);
+  gst_vp9_parser_free (batch_parser);
+  gst_vp9_parser_free (parser);
+  g_free (superframe);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_vp9_parse_frame_headers_broken)
+{
+  const guint8 *packets[2];
+  gsize sizes[2];
+  GstVp9Parser *parser;
+  GArray *frames;
+  guint8 *superframe;
+  gsize superframe_size;
+
+  superframe = make_superframe (&superframe_size);
+  superframe[superframe_size - 2] = 0xff;
+
+  packets[0] = vp9_key_frame_cif;
+  sizes[0] = sizeof (vp9_key_frame_cif);
+  packets[1] = superframe;
+  sizes[1] = superframe_size;
+
+  parser = gst_vp9_parser_new ();
+  frames = gst_vp9_parser_parse_frame_headers (parser, packets, sizes, 2, 0);
+
+  /* the broken packet is reported as one frame instead of being skipped */
+  assert_equals_int (frames->len, 2);
+  assert_equals_int (g_array_index (frames, GstVp9BatchFrame, 0).result,
+      GST_VP9_PARSER_OK);
+  assert_equals_int (g_array_index (frames, GstVp9BatchFrame, 1).packet, 1);
+  assert_equals_int (g_array_index (frames, GstVp9BatchFrame, 1).size,
+      superframe_size);
+  assert_equals_int (g_array_index (frames, GstVp9BatchFrame, 1).result,
+      GST_VP9_PARSER_BROKEN_DATA);
+
+  g_array_free (frames, TRUE);
+  gst_vp9_parser_free (parser);
+  g_free (superframe);
+}
+
+GST_END_TEST;
+
+static Suite *
+vp9parsers_suite (void)
+{
+  Suite *s = suite_create ("VP9 Parser library");
+
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_vp9_parse_key_frame);
+  tcase_add_test (tc_chain, test_vp9_parse_superframe_info);
+  tcase_add_test (tc_chain, test_vp9_parse_frame_headers);
+  tcase_add_test (tc_chain, test_vp9_parse_frame_headers_broken);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vp9parsers);
@@ -21,7 +21,10 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/base/gstbytereader.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#include <unistd.h>
 
 static const gchar *
 get_mpeg2enc_element_name (void)
@@ -287,6 +290,283 @@ GST_START_TEST (test_h264_raw_audio)
 
 GST_END_TEST;
 
+#define ROUND_TRIP_FRAMES 125
+#define ROUND_TRIP_FRAME_DURATION (GST_SECOND / 25)
+
+static const guint8 partition_pack_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x05, 0x01, 0x01, 0x0d, 0x01, 0x02, 0x01, 0x01
+};
+
+static const guint8 index_table_segment_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x53, 0x01, 0x01, 0x0d, 0x01, 0x02, 0x01, 0x01,
+  0x10, 0x01, 0x00
+};
+
+typedef struct
+{
+  guint n_buffers;
+  GstClockTime first_pts;
+  GstClockTime end;
+} TrackData;
+
+typedef struct
+{
+  GstElement *pipeline;
+  GMutex lock;
+  TrackData video, audio;
+} RoundTripData;
+
+static void
+reset_tracks (RoundTripData * data)
+{
+  g_mutex_lock (&data->lock);
+  data->video.n_buffers = data->audio.n_buffers = 0;
+  data->video.first_pts = data->audio.first_pts = GST_CLOCK_TIME_NONE;
+  data->video.end = data->audio.end = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&data->lock);
+}
+
+static GstPadProbeReturn
+round_trip_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    RoundTripData * data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  TrackData *track;
+
+  fail_unless (caps != NULL);
+  g_mutex_lock (&data->lock);
+  if (g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps,
+                  0)), "video/"))
+    track = &data->video;
+  else
+    track = &data->audio;
+
+  track->n_buffers++;
+  if (!GST_CLOCK_TIME_IS_VALID (track->first_pts))
+    track->first_pts = GST_BUFFER_PTS (buffer);
+  track->end = GST_BUFFER_PTS (buffer) + GST_BUFFER_DURATION (buffer);
+  g_mutex_unlock (&data->lock);
+  gst_caps_unref (caps);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+round_trip_pad_added (GstElement * demux, GstPad * pad, RoundTripData * data)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad;
+
+  gst_bin_add (GST_BIN (data->pipeline), sink);
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) round_trip_buffer_probe, data, NULL);
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+  gst_element_sync_state_with_parent (sink);
+}
+
+static void
+wait_for_eos (GstElement * pipeline)
+{
+  GstMessage *msg;
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+}
+
+static gboolean
+read_klv (GstByteReader * reader, const guint8 ** key, const guint8 ** value,
+    guint64 * length)
+{
+  guint8 b;
+
+  if (!gst_byte_reader_get_data (reader, 16, key)
+      || !gst_byte_reader_get_uint8 (reader, &b))
+    return FALSE;
+
+  if (b & 0x80) {
+    guint n = b & 0x7f;
+
+    *length = 0;
+    while (n--) {
+      if (!gst_byte_reader_get_uint8 (reader, &b))
+        return FALSE;
+      *length = (*length << 8) | b;
+    }
+  } else {
+    *length = b;
+  }
+
+  return gst_byte_reader_get_data (reader, *length, value);
+}
+
+/* Checks that the index table segment indexes the audio track through one
+ * slice, returns the number of index entries */
+static guint
+check_index_table_segment (const guint8 * data, guint64 size)
+{
+  GstByteReader reader = GST_BYTE_READER_INIT (data, size);
+  guint16 tag, tag_size;
+  guint slice_count = G_MAXUINT, n_entries = 0, i;
+
+  while (gst_byte_reader_get_uint16_be (&reader, &tag)
+      && gst_byte_reader_get_uint16_be (&reader, &tag_size)) {
+    const guint8 *value;
+
+    fail_unless (gst_byte_reader_get_data (&reader, tag_size, &value));
+
+    if (tag == 0x3f08) {
+      slice_count = GST_READ_UINT8 (value);
+    } else if (tag == 0x3f09) {
+      /* one delta entry per element of the content package */
+      fail_unless_equals_int (GST_READ_UINT32_BE (value), 2);
+    } else if (tag == 0x3f0a) {
+      guint32 entry_size = GST_READ_UINT32_BE (value + 4);
+
+      n_entries = GST_READ_UINT32_BE (value);
+      fail_unless_equals_int (entry_size, 11 + 4);
+      fail_unless_equals_int (tag_size, 8 + n_entries * entry_size);
+      for (i = 0; i < n_entries; i++) {
+        guint32 slice_offset =
+            GST_READ_UINT32_BE (value + 8 + i * entry_size + 11);
+
+        /* the audio element follows the video frame */
+        fail_unless (slice_offset > 0 && slice_offset != G_MAXUINT32,
+            "invalid slice offset %u in index entry %u", slice_offset, i);
+      }
+    }
+  }
+  fail_unless_equals_int (slice_count, 1);
+
+  return n_entries;
+}
+
+/* Muxes 5s of video and audio into body partitions of 1s and demuxes the
+ * file again, before and after seeking with the index of a later partition */
+GST_START_TEST (test_partitions_index)
+{
+  RoundTripData data;
+  GstElement *src, *demux;
+  GstByteReader reader;
+  gchar *location, *pipeline_string, *contents;
+  gsize size;
+  guint n_body_partitions = 0, n_partition_segments = 0, n_entries = 0;
+  guint first_frame;
+  gboolean in_body_partition = FALSE, in_first_body_partition = FALSE;
+  GstClockTime target;
+  gint fd;
+
+  fd = g_file_open_tmp ("mxf-XXXXXX.mxf", &location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+
+  pipeline_string = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+      "video/x-raw,format=(string)v308,width=64,height=48,framerate=25/1 ! "
+      "mxfmux name=mux partition-duration=%" G_GUINT64_FORMAT " ! "
+      "filesink location=%s "
+      "audiotestsrc num-buffers=%d samplesperbuffer=1920 ! "
+      "audioconvert ! audio/x-raw,rate=48000,channels=2 ! mux. ",
+      ROUND_TRIP_FRAMES, GST_SECOND, location, ROUND_TRIP_FRAMES);
+  data.pipeline = gst_parse_launch (pipeline_string, NULL);
+  fail_unless (data.pipeline != NULL);
+  g_free (pipeline_string);
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  wait_for_eos (data.pipeline);
+  gst_element_set_state (data.pipeline, GST_STATE_NULL);
+  gst_object_unref (data.pipeline);
+
+  /* every body partition but the first one starts with the index of the
+   * previous one, the footer has the index of the last one */
+  fail_unless (g_file_get_contents (location, &contents, &size, NULL));
+  gst_byte_reader_init (&reader, (const guint8 *) contents, size);
+  while (gst_byte_reader_get_remaining (&reader) > 0) {
+    const guint8 *key, *value;
+    guint64 length;
+
+    fail_unless (read_klv (&reader, &key, &value, &length));
+
+    if (memcmp (key, partition_pack_key, sizeof (partition_pack_key)) == 0) {
+      in_body_partition = key[13] == 0x03;
+      in_first_body_partition = in_body_partition && n_body_partitions == 0;
+      if (in_body_partition)
+        n_body_partitions++;
+    } else if (memcmp (key, index_table_segment_key,
+            sizeof (index_table_segment_key)) == 0) {
+      fail_if (in_first_body_partition);
+      n_entries += check_index_table_segment (value, length);
+      if (in_body_partition)
+        n_partition_segments++;
+    }
+  }
+  g_free (contents);
+
+  fail_unless_equals_int (n_body_partitions, 5);
+  fail_unless_equals_int (n_partition_segments, n_body_partitions - 1);
+  fail_unless_equals_int (n_entries, ROUND_TRIP_FRAMES);
+
+  /* both tracks are demuxed completely */
+  g_mutex_init (&data.lock);
+  data.pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("mxfdemux", NULL);
+  g_object_set (src, "location", location, NULL);
+  gst_bin_add_many (GST_BIN (data.pipeline), src, demux, NULL);
+  fail_unless (gst_element_link (src, demux));
+  g_signal_connect (demux, "pad-added", G_CALLBACK (round_trip_pad_added),
+      &data);
+
+  reset_tracks (&data);
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  wait_for_eos (data.pipeline);
+
+  g_mutex_lock (&data.lock);
+  fail_unless_equals_int (data.video.n_buffers, ROUND_TRIP_FRAMES);
+  fail_unless_equals_uint64 (data.video.first_pts, 0);
+  fail_unless (data.audio.n_buffers > 0);
+  fail_unless_equals_uint64 (data.audio.first_pts, 0);
+  fail_unless (data.audio.end + ROUND_TRIP_FRAME_DURATION >=
+      ROUND_TRIP_FRAMES * ROUND_TRIP_FRAME_DURATION);
+  g_mutex_unlock (&data.lock);
+
+  /* seeking into the fourth body partition starts both tracks at the
+   * same content package */
+  gst_element_set_state (data.pipeline, GST_STATE_PAUSED);
+  fail_unless_equals_int (gst_element_get_state (data.pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+  reset_tracks (&data);
+
+  first_frame = 87;
+  target = first_frame * ROUND_TRIP_FRAME_DURATION + GST_MSECOND;
+  fail_unless (gst_element_seek_simple (data.pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, target));
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  wait_for_eos (data.pipeline);
+
+  g_mutex_lock (&data.lock);
+  fail_unless_equals_uint64 (data.video.first_pts,
+      first_frame * ROUND_TRIP_FRAME_DURATION);
+  fail_unless_equals_int (data.video.n_buffers,
+      ROUND_TRIP_FRAMES - first_frame);
+  fail_unless (data.audio.first_pts + ROUND_TRIP_FRAME_DURATION >= target
+      && data.audio.first_pts <= target,
+      "first audio buffer at %" GST_TIME_FORMAT, GST_TIME_ARGS
+      (data.audio.first_pts));
+  g_mutex_unlock (&data.lock);
+
+  gst_element_set_state (data.pipeline, GST_STATE_NULL);
+  gst_object_unref (data.pipeline);
+  g_mutex_clear (&data.lock);
+
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
 static Suite *
 mxf_suite (void)
 {
@@ -303,6 +583,7 @@ mxf_suite (void)
   tcase_add_test (tc_chain, test_dnxhd_mp3);
   tcase_add_test (tc_chain, test_h264_raw_audio);
   tcase_add_test (tc_chain, test_multiple_av_streams);
+  tcase_add_test (tc_chain, test_partitions_index);
 
   return s;
 }
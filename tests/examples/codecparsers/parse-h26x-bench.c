@@ -0,0 +1,207 @@
+/*
+ * parse-h26x-bench.c - Measure H.264/H.265 header parsing speed
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Parses every parameter set, SEI and slice header of an Annex B byte-stream
+ * file a number of times and reports the time spent. This mostly exercises
+ * the bit reader and Exp-Golomb decoding shared by both parsers. */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+
+typedef struct _BenchStats BenchStats;
+struct _BenchStats
+{
+  guint n_nals;
+  guint n_slices;
+  guint n_seis;
+  guint n_errors;
+};
+
+static void
+parse_h264 (const guint8 * data, gsize size, BenchStats * stats)
+{
+  GstH264NalParser *parser;
+  GstH264NalUnit nalu;
+  GstH264ParserResult res;
+  GstH264SliceHdr slice;
+  GArray *messages;
+  guint offset = 0;
+
+  parser = gst_h264_nal_parser_new ();
+
+  while (offset < size) {
+    res = gst_h264_parser_identify_nalu (parser, data, offset, size, &nalu);
+    if (res == GST_H264_PARSER_NO_NAL_END)
+      res = gst_h264_parser_identify_nalu_unchecked (parser, data, offset,
+          size, &nalu);
+    if (res != GST_H264_PARSER_OK)
+      break;
+
+    stats->n_nals++;
+    switch (nalu.type) {
+      case GST_H264_NAL_SLICE:
+      case GST_H264_NAL_SLICE_IDR:
+        stats->n_slices++;
+        res = gst_h264_parser_parse_slice_hdr (parser, &nalu, &slice, TRUE,
+            TRUE);
+        break;
+      case GST_H264_NAL_SEI:
+        stats->n_seis++;
+        res = gst_h264_parser_parse_sei (parser, &nalu, &messages);
+        if (res == GST_H264_PARSER_OK)
+          g_array_free (messages, TRUE);
+        break;
+      default:
+        res = gst_h264_parser_parse_nal (parser, &nalu);
+        break;
+    }
+    if (res != GST_H264_PARSER_OK)
+      stats->n_errors++;
+
+    offset = nalu.offset + nalu.size;
+  }
+
+  gst_h264_nal_parser_free (parser);
+}
+
+static void
+parse_h265 (const guint8 * data, gsize size, BenchStats * stats)
+{
+  GstH265Parser *parser;
+  GstH265NalUnit nalu;
+  GstH265ParserResult res;
+  GstH265SliceHdr slice;
+  GArray *messages;
+  guint offset = 0;
+
+  parser = gst_h265_parser_new ();
+
+  while (offset < size) {
+    res = gst_h265_parser_identify_nalu (parser, data, offset, size, &nalu);
+    if (res == GST_H265_PARSER_NO_NAL_END)
+      res = gst_h265_parser_identify_nalu_unchecked (parser, data, offset,
+          size, &nalu);
+    if (res != GST_H265_PARSER_OK)
+      break;
+
+    stats->n_nals++;
+    if (nalu.type <= GST_H265_NAL_SLICE_CRA_NUT) {
+      stats->n_slices++;
+      memset (&slice, 0, sizeof (slice));
+      res = gst_h265_parser_parse_slice_hdr (parser, &nalu, &slice);
+      if (res == GST_H265_PARSER_OK)
+        gst_h265_slice_hdr_free (&slice);
+    } else if (nalu.type == GST_H265_NAL_PREFIX_SEI ||
+        nalu.type == GST_H265_NAL_SUFFIX_SEI) {
+      stats->n_seis++;
+      res = gst_h265_parser_parse_sei (parser, &nalu, &messages);
+      if (res == GST_H265_PARSER_OK)
+        g_array_free (messages, TRUE);
+    } else {
+      res = gst_h265_parser_parse_nal (parser, &nalu);
+    }
+    if (res != GST_H265_PARSER_OK)
+      stats->n_errors++;
+
+    offset = nalu.offset + nalu.size;
+  }
+
+  gst_h265_parser_free (parser);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gchar *codec = NULL;
+  gint iterations = 20;
+  gchar *contents = NULL;
+  gsize size;
+  BenchStats stats;
+  gint64 start, elapsed;
+  gboolean h265;
+  gint i;
+  GOptionEntry options[] = {
+    {"codec", 'c', 0, G_OPTION_ARG_STRING, &codec,
+        "Codec of the stream, h264 (default) or h265", "CODEC"},
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of times the stream is parsed", "N"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("<byte-stream file>");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (argc < 2 || iterations <= 0) {
+    g_printerr ("Usage: %s [-c h264|h265] [-n N] <byte-stream file>\n",
+        argv[0]);
+    return 1;
+  }
+
+  h265 = codec != NULL && g_ascii_strcasecmp (codec, "h265") == 0;
+
+  if (!g_file_get_contents (argv[1], &contents, &size, &err)) {
+    g_printerr ("failed to read %s: %s\n", argv[1], err->message);
+    g_clear_error (&err);
+    return 1;
+  }
+
+  /* warm up the caches once before measuring */
+  memset (&stats, 0, sizeof (stats));
+  if (h265)
+    parse_h265 ((const guint8 *) contents, size, &stats);
+  else
+    parse_h264 ((const guint8 *) contents, size, &stats);
+
+  g_print ("%s: %" G_GSIZE_FORMAT " bytes, %u NAL units, %u slices, "
+      "%u SEI, %u errors\n", argv[1], size, stats.n_nals, stats.n_slices,
+      stats.n_seis, stats.n_errors);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    memset (&stats, 0, sizeof (stats));
+    if (h265)
+      parse_h265 ((const guint8 *) contents, size, &stats);
+    else
+      parse_h264 ((const guint8 *) contents, size, &stats);
+  }
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  g_print ("%d iterations in %.3f ms: %.1f MB/s, %.1f ns per NAL unit\n",
+      iterations, elapsed / 1000.0,
+      (gdouble) size * iterations / elapsed,
+      stats.n_nals ? elapsed * 1000.0 / ((gdouble) stats.n_nals * iterations) :
+      0.0);
+
+  g_free (contents);
+  g_free (codec);
+
+  return 0;
+}
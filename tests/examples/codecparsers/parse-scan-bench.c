@@ -0,0 +1,210 @@
+/*
+ * parse-scan-bench.c - Measure start code and marker scanning throughput
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Splits an elementary stream file into its units with the codec parser's
+ * identification function, without parsing them, and reports the
+ * throughput. For large streams this is dominated by the start code or
+ * marker search. */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <gst/codecparsers/gstmpegvideoparser.h>
+#include <gst/codecparsers/gstmpeg4parser.h>
+#include <gst/codecparsers/gstvc1parser.h>
+#include <gst/codecparsers/gstjpegparser.h>
+
+typedef guint (*SplitFunc) (const guint8 * data, gsize size);
+
+static guint
+split_h264 (const guint8 * data, gsize size)
+{
+  GstH264NalParser *parser = gst_h264_nal_parser_new ();
+  GstH264NalUnit nalu;
+  guint offset = 0, n = 0;
+
+  while (gst_h264_parser_identify_nalu (parser, data, offset, size,
+          &nalu) == GST_H264_PARSER_OK) {
+    offset = nalu.offset + nalu.size;
+    n++;
+  }
+
+  gst_h264_nal_parser_free (parser);
+  return n;
+}
+
+static guint
+split_h265 (const guint8 * data, gsize size)
+{
+  GstH265Parser *parser = gst_h265_parser_new ();
+  GstH265NalUnit nalu;
+  guint offset = 0, n = 0;
+
+  while (gst_h265_parser_identify_nalu (parser, data, offset, size,
+          &nalu) == GST_H265_PARSER_OK) {
+    offset = nalu.offset + nalu.size;
+    n++;
+  }
+
+  gst_h265_parser_free (parser);
+  return n;
+}
+
+static guint
+split_mpeg2 (const guint8 * data, gsize size)
+{
+  GstMpegVideoPacket packet;
+  guint offset = 0, n = 0;
+
+  while (gst_mpeg_video_parse (&packet, data, size, offset)) {
+    n++;
+    if (packet.size < 0)
+      break;
+    offset = packet.offset + packet.size;
+  }
+
+  return n;
+}
+
+static guint
+split_mpeg4 (const guint8 * data, gsize size)
+{
+  GstMpeg4Packet packet;
+  guint offset = 0, n = 0;
+
+  while (gst_mpeg4_parse (&packet, FALSE, NULL, data, offset,
+          size) == GST_MPEG4_PARSER_OK) {
+    offset = packet.offset + packet.size;
+    n++;
+  }
+
+  return n;
+}
+
+static guint
+split_vc1 (const guint8 * data, gsize size)
+{
+  GstVC1BDU bdu;
+  guint offset = 0, n = 0;
+
+  while (offset < size && gst_vc1_identify_next_bdu (data + offset,
+          size - offset, &bdu) == GST_VC1_PARSER_OK) {
+    offset += bdu.offset + bdu.size;
+    n++;
+  }
+
+  return n;
+}
+
+static guint
+split_jpeg (const guint8 * data, gsize size)
+{
+  GstJpegSegment seg;
+  guint offset = 0, n = 0;
+
+  while (gst_jpeg_parse (&seg, data, size, offset)) {
+    offset = seg.offset + MAX (seg.size, 0);
+    n++;
+  }
+
+  return n;
+}
+
+static const struct
+{
+  const gchar *name;
+  SplitFunc func;
+} codecs[] = {
+  {"h264", split_h264},
+  {"h265", split_h265},
+  {"mpeg2", split_mpeg2},
+  {"mpeg4", split_mpeg4},
+  {"vc1", split_vc1},
+  {"jpeg", split_jpeg},
+};
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gchar *codec = NULL;
+  gint iterations = 10;
+  gchar *contents = NULL;
+  gsize size;
+  SplitFunc func = NULL;
+  gint64 start, elapsed;
+  guint n_units = 0;
+  gint i;
+  GOptionEntry options[] = {
+    {"codec", 'c', 0, G_OPTION_ARG_STRING, &codec,
+        "Codec of the stream: h264 (default), h265, mpeg2, mpeg4, vc1 or jpeg",
+        "CODEC"},
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of times the stream is scanned", "N"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("<elementary stream file>");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  for (i = 0; i < G_N_ELEMENTS (codecs); i++) {
+    if (g_strcmp0 (codec ? codec : "h264", codecs[i].name) == 0)
+      func = codecs[i].func;
+  }
+
+  if (argc < 2 || iterations <= 0 || func == NULL) {
+    g_printerr ("Usage: %s [-c CODEC] [-n N] <elementary stream file>\n",
+        argv[0]);
+    return 1;
+  }
+
+  if (!g_file_get_contents (argv[1], &contents, &size, &err)) {
+    g_printerr ("failed to read %s: %s\n", argv[1], err->message);
+    g_clear_error (&err);
+    return 1;
+  }
+
+  /* warm up the caches once before measuring */
+  func ((const guint8 *) contents, size);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    n_units = func ((const guint8 *) contents, size);
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  g_print ("%s: %" G_GSIZE_FORMAT " bytes, %u units\n", argv[1], size,
+      n_units);
+  g_print ("%d iterations in %.3f ms: %.1f MB/s\n", iterations,
+      elapsed / 1000.0, (gdouble) size * iterations / elapsed);
+
+  g_free (contents);
+  g_free (codec);
+
+  return 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * parse-vpx-bench.c - Compare sequential and batch VP8/VP9 header parsing
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Demuxes an IVF file with ivfparse, then parses the header of every frame
+ * a number of times, once frame by frame and once through the batch API,
+ * and reports the time spent by both. The headers returned by the two are
+ * compared, so this doubles as a consistency check. */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/codecparsers/gstvp8parser.h>
+#include <gst/codecparsers/gstvp9parser.h>
+
+typedef struct _Packets Packets;
+struct _Packets
+{
+  GPtrArray *buffers;
+  GArray *maps;
+  GPtrArray *data;
+  GArray *sizes;
+  gboolean vp9;
+};
+
+static void
+handoff_cb (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    Packets * packets)
+{
+  GstCaps *caps;
+
+  if (packets->buffers->len == 0 && (caps = gst_pad_get_current_caps (pad))) {
+    packets->vp9 = gst_structure_has_name (gst_caps_get_structure (caps, 0),
+        "video/x-vp9");
+    gst_caps_unref (caps);
+  }
+
+  g_ptr_array_add (packets->buffers, gst_buffer_ref (buffer));
+}
+
+static gboolean
+read_packets (const gchar * location, Packets * packets)
+{
+  GstElement *pipeline, *src, *sink;
+  GstMessage *msg;
+  GstMapInfo map;
+  gboolean ret;
+  guint i;
+
+  pipeline = gst_parse_launch ("filesrc name=src ! ivfparse ! "
+      "fakesink name=sink signal-handoffs=true sync=false", NULL);
+  if (!pipeline)
+    return FALSE;
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_set (src, "location", location, NULL);
+  gst_object_unref (src);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff_cb), packets);
+  gst_object_unref (sink);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  ret = GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS;
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* the buffers are kept mapped for the whole run */
+  for (i = 0; i < packets->buffers->len; i++) {
+    gst_buffer_map (g_ptr_array_index (packets->buffers, i), &map,
+        GST_MAP_READ);
+    g_array_append_val (packets->maps, map);
+    g_ptr_array_add (packets->data, map.data);
+    g_array_append_val (packets->sizes, map.size);
+  }
+
+  return ret;
+}
+
+static void
+free_packets (Packets * packets)
+{
+  guint i;
+
+  for (i = 0; i < packets->buffers->len; i++) {
+    GstBuffer *buffer = g_ptr_array_index (packets->buffers, i);
+
+    if (i < packets->maps->len)
+      gst_buffer_unmap (buffer, &g_array_index (packets->maps, GstMapInfo, i));
+    gst_buffer_unref (buffer);
+  }
+  g_ptr_array_free (packets->buffers, TRUE);
+  g_array_free (packets->maps, TRUE);
+  g_ptr_array_free (packets->data, TRUE);
+  g_array_free (packets->sizes, TRUE);
+}
+
+/* Returns the number of frames that parsed differently in both modes */
+static guint
+bench_vp8 (Packets * packets, gint iterations, guint n_threads,
+    gint64 * seq_time, gint64 * batch_time)
+{
+  const guint8 *const *data = (const guint8 * const *) packets->data->pdata;
+  const gsize *sizes = (const gsize *) packets->sizes->data;
+  guint n = packets->sizes->len;
+  GstVp8FrameHdr *seq_hdrs, *batch_hdrs;
+  GstVp8ParserResult *seq_results, *batch_results;
+  GstVp8Parser parser;
+  gint64 start;
+  guint i, n_diffs = 0;
+  gint j;
+
+  seq_hdrs = g_new0 (GstVp8FrameHdr, n);
+  batch_hdrs = g_new0 (GstVp8FrameHdr, n);
+  seq_results = g_new0 (GstVp8ParserResult, n);
+  batch_results = g_new0 (GstVp8ParserResult, n);
+
+  start = g_get_monotonic_time ();
+  for (j = 0; j < iterations; j++) {
+    gst_vp8_parser_init (&parser);
+    for (i = 0; i < n; i++)
+      seq_results[i] = gst_vp8_parser_parse_frame_header (&parser,
+          &seq_hdrs[i], data[i], sizes[i]);
+  }
+  *seq_time = MAX (g_get_monotonic_time () - start, 1);
+
+  start = g_get_monotonic_time ();
+  for (j = 0; j < iterations; j++) {
+    gst_vp8_parser_init (&parser);
+    gst_vp8_parser_parse_frame_headers (&parser, data, sizes, n, n_threads,
+        batch_hdrs, batch_results);
+  }
+  *batch_time = MAX (g_get_monotonic_time () - start, 1);
+
+  for (i = 0; i < n; i++) {
+    if (seq_results[i] != batch_results[i] || (seq_results[i] ==
+            GST_VP8_PARSER_OK && memcmp (&seq_hdrs[i], &batch_hdrs[i],
+                sizeof (GstVp8FrameHdr)) != 0))
+      n_diffs++;
+  }
+
+  g_free (seq_hdrs);
+  g_free (batch_hdrs);
+  g_free (seq_results);
+  g_free (batch_results);
+
+  return n_diffs;
+}
+
+static guint
+bench_vp9 (Packets * packets, gint iterations, guint n_threads,
+    gint64 * seq_time, gint64 * batch_time)
+{
+  const guint8 *const *data = (const guint8 * const *) packets->data->pdata;
+  const gsize *sizes = (const gsize *) packets->sizes->data;
+  guint n = packets->sizes->len;
+  GstVp9BatchFrame *seq_frames = NULL;
+  GArray *batch = NULL;
+  GstVp9Parser *parser;
+  gint64 start;
+  guint i, k, n_frames = 0, n_diffs = 0;
+  gint j;
+
+  start = g_get_monotonic_time ();
+  for (j = 0; j < iterations; j++) {
+    parser = gst_vp9_parser_new ();
+    for (i = 0, n_frames = 0; i < n; i++) {
+      GstVp9SuperframeInfo info;
+      guint32 offset = 0;
+
+      gst_vp9_parser_parse_superframe_info (parser, &info, data[i], sizes[i]);
+      seq_frames = g_renew (GstVp9BatchFrame, seq_frames,
+          n_frames + info.frames_in_superframe);
+      for (k = 0; k < info.frames_in_superframe; k++) {
+        GstVp9BatchFrame *frame = &seq_frames[n_frames++];
+
+        memset (frame, 0, sizeof (*frame));
+        frame->result = gst_vp9_parser_parse_frame_header (parser,
+            &frame->frame_hdr, data[i] + offset, info.frame_sizes[k]);
+        offset += info.frame_sizes[k];
+      }
+    }
+    gst_vp9_parser_free (parser);
+  }
+  *seq_time = MAX (g_get_monotonic_time () - start, 1);
+
+  start = g_get_monotonic_time ();
+  for (j = 0; j < iterations; j++) {
+    if (batch)
+      g_array_free (batch, TRUE);
+    parser = gst_vp9_parser_new ();
+    batch = gst_vp9_parser_parse_frame_headers (parser, data, sizes, n,
+        n_threads);
+    gst_vp9_parser_free (parser);
+  }
+  *batch_time = MAX (g_get_monotonic_time () - start, 1);
+
+  if (batch->len != n_frames)
+    n_diffs = MAX (batch->len, n_frames);
+
+  for (i = 0; i < MIN (batch->len, n_frames); i++) {
+    GstVp9BatchFrame *frame = &g_array_index (batch, GstVp9BatchFrame, i);
+
+    if (frame->result != seq_frames[i].result || (frame->result ==
+            GST_VP9_PARSER_OK && memcmp (&frame->frame_hdr,
+                &seq_frames[i].frame_hdr, sizeof (GstVp9FrameHdr)) != 0))
+      n_diffs++;
+  }
+
+  g_print ("%u frames in %u packets\n", n_frames, n);
+
+  g_array_free (batch, TRUE);
+  g_free (seq_frames);
+
+  return n_diffs;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint iterations = 20;
+  gint n_threads = 0;
+  Packets packets;
+  gint64 seq_time, batch_time;
+  guint n_diffs;
+  GOptionEntry options[] = {
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of times the stream is parsed", "N"},
+    {"threads", 't', 0, G_OPTION_ARG_INT, &n_threads,
+        "Maximum number of threads of the batch parser, 0 for one per CPU",
+        "THREADS"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("<ivf file>");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (argc < 2 || iterations <= 0 || n_threads < 0) {
+    g_printerr ("Usage: %s [-n N] [-t THREADS] <ivf file>\n", argv[0]);
+    return 1;
+  }
+
+  packets.buffers = g_ptr_array_new ();
+  packets.maps = g_array_new (FALSE, FALSE, sizeof (GstMapInfo));
+  packets.data = g_ptr_array_new ();
+  packets.sizes = g_array_new (FALSE, FALSE, sizeof (gsize));
+  packets.vp9 = FALSE;
+
+  if (!read_packets (argv[1], &packets)) {
+    g_printerr ("failed to demux %s\n", argv[1]);
+    free_packets (&packets);
+    return 1;
+  }
+
+  g_print ("%s: %s, %u packets\n", argv[1], packets.vp9 ? "VP9" : "VP8",
+      packets.buffers->len);
+
+  if (packets.vp9)
+    n_diffs = bench_vp9 (&packets, iterations, n_threads, &seq_time,
+        &batch_time);
+  else
+    n_diffs = bench_vp8 (&packets, iterations, n_threads, &seq_time,
+        &batch_time);
+
+  g_print ("%d iterations: sequential %.3f ms, batch %.3f ms (%.2fx)\n",
+      iterations, seq_time / 1000.0, batch_time / 1000.0,
+      (gdouble) seq_time / batch_time);
+  if (n_diffs)
+    g_print ("%u frames parsed differently\n", n_diffs);
+
+  free_packets (&packets);
+
+  return n_diffs ? 1 : 0;
+}
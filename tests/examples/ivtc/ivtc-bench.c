@@ -0,0 +1,225 @@
+/*
+ * ivtc-bench.c - Measure the frame rate of the ivtc element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Telecines a short moving test pattern with 2:3 pulldown, then pushes it
+ * in a loop through ivtc and reports how many progressive frames per
+ * second ivtc produces. Generating the telecined frames is not part of
+ * the measurement. */
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
+
+/* two 2:3 pulldown cycles of 4 progressive frames */
+#define N_SOURCE_FRAMES 8
+
+typedef struct
+{
+  GPtrArray *frames;
+  GstClockTime cycle_duration;
+  gint n_pushed;
+  gint n_frames;
+  gint n_output;
+} Bench;
+
+static GstCaps *
+make_telecined_frames (Bench * bench, gint width, gint height)
+{
+  GstElement *pipeline, *sink;
+  GstSample *sample;
+  GstCaps *caps = NULL;
+  GError *err = NULL;
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc pattern=smpte horizontal-speed=4 "
+      "num-buffers=%d ! video/x-raw,format=I420,width=%d,height=%d,"
+      "framerate=24000/1001 ! interlace ! appsink name=sink sync=false",
+      N_SOURCE_FRAMES, width, height);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (!pipeline) {
+    g_printerr ("Could not create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return NULL;
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  while ((sample = gst_app_sink_pull_sample (GST_APP_SINK (sink)))) {
+    if (!caps)
+      caps = gst_caps_ref (gst_sample_get_caps (sample));
+    g_ptr_array_add (bench->frames,
+        gst_buffer_ref (gst_sample_get_buffer (sample)));
+    gst_sample_unref (sample);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  if (bench->frames->len > 0) {
+    GstBuffer *last = g_ptr_array_index (bench->frames,
+        bench->frames->len - 1);
+
+    bench->cycle_duration = GST_BUFFER_PTS (last) +
+        GST_BUFFER_DURATION (last);
+  }
+
+  return caps;
+}
+
+static void
+need_data (GstAppSrc * src, guint length, gpointer user_data)
+{
+  Bench *bench = user_data;
+  guint len = bench->frames->len;
+  GstBuffer *buf;
+
+  if (bench->n_pushed == bench->n_frames) {
+    gst_app_src_end_of_stream (src);
+    return;
+  }
+
+  /* the frames are shared, only the metadata is copied */
+  buf = gst_buffer_copy (g_ptr_array_index (bench->frames,
+          bench->n_pushed % len));
+  GST_BUFFER_PTS (buf) += (bench->n_pushed / len) * bench->cycle_duration;
+  GST_BUFFER_DTS (buf) = GST_CLOCK_TIME_NONE;
+  bench->n_pushed++;
+
+  gst_app_src_push_buffer (src, buf);
+}
+
+static void
+handoff (GstElement * fakesink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  Bench *bench = user_data;
+
+  bench->n_output++;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint n_frames = 600;
+  gint width = 1920;
+  gint height = 1080;
+  gint subsample = 1;
+  GstAppSrcCallbacks callbacks = { need_data, NULL, NULL };
+  GstElement *pipeline, *src, *ivtc, *sink;
+  GstMessage *msg;
+  GstCaps *caps;
+  Bench bench = { NULL, };
+  gint64 start, time;
+  gint ret = 0;
+  GOptionEntry options[] = {
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &n_frames,
+        "Number of telecined frames pushed through ivtc", "N"},
+    {"width", 'w', 0, G_OPTION_ARG_INT, &width, "Frame width", "WIDTH"},
+    {"height", 0, 0, G_OPTION_ARG_INT, &height, "Frame height", "HEIGHT"},
+    {"subsample", 's', 0, G_OPTION_ARG_INT, &subsample,
+        "Value of the subsample property of ivtc", "N"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new (NULL);
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (n_frames <= 0 || width <= 0 || width > 2048 || height <= 0
+      || subsample < 1 || subsample > 8) {
+    g_printerr ("Usage: %s [-n N] [-w WIDTH] [--height HEIGHT] "
+        "[-s SUBSAMPLE]\n", argv[0]);
+    return 1;
+  }
+
+  bench.frames = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  bench.n_frames = n_frames;
+
+  caps = make_telecined_frames (&bench, width, height);
+  if (!caps) {
+    g_ptr_array_free (bench.frames, TRUE);
+    return 1;
+  }
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("appsrc", NULL);
+  ivtc = gst_element_factory_make ("ivtc", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  if (!src || !ivtc || !sink) {
+    g_printerr ("Missing appsrc, ivtc or fakesink\n");
+    if (src)
+      gst_object_unref (src);
+    if (ivtc)
+      gst_object_unref (ivtc);
+    if (sink)
+      gst_object_unref (sink);
+    gst_object_unref (pipeline);
+    gst_caps_unref (caps);
+    g_ptr_array_free (bench.frames, TRUE);
+    return 1;
+  }
+
+  g_object_set (src, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+  gst_app_src_set_callbacks (GST_APP_SRC (src), &callbacks, &bench, NULL);
+  g_object_set (ivtc, "subsample", subsample, NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff), &bench);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, ivtc, sink, NULL);
+  gst_element_link_many (src, ivtc, sink, NULL);
+
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  time = MAX (g_get_monotonic_time () - start, 1);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("Error: %s\n", err->message);
+    g_clear_error (&err);
+    ret = 1;
+  } else {
+    g_print ("%dx%d, subsample %d: %d telecined frames in, %d frames out\n",
+        width, height, subsample, bench.n_pushed, bench.n_output);
+    g_print ("%.3f ms, %.1f output frames/s\n", time / 1000.0,
+        bench.n_output * (gdouble) G_USEC_PER_SEC / time);
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_ptr_array_free (bench.frames, TRUE);
+
+  return ret;
+}
@@ -0,0 +1,236 @@
+/*
+ * mux-bench.c - Measure the throughput of asfmux and mpegpsmux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Pushes the same video frames through asfmux and mpegpsmux twice, once
+ * with the packets built in pooled buffers that reference the payload and
+ * pushed as buffer lists, and once with copy-packets set, where every packet
+ * is allocated, copied and pushed on its own like the muxers used to do.
+ * Reports the input bytes per second of both runs. */
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *sink_pad;
+  const gchar *caps;
+  /* frames alternate between these sizes */
+  gsize small_size;
+  gsize large_size;
+} Muxer;
+
+static const Muxer muxers[] = {
+  {"asfmux", "video_%u",
+        "video/x-wmv,wmvversion=2,width=384,height=288,framerate=25/1",
+      100, 20000},
+  {"mpegpsmux", "sink_%u",
+        "video/mpeg,mpegversion=2,systemstream=false,width=720,height=576,"
+        "framerate=25/1",
+      50000, 50000}
+};
+
+typedef struct
+{
+  GstBuffer *frames[2];
+  gint n_pushed;
+  gint n_frames;
+  guint64 bytes_in;
+  guint64 bytes_out;
+  guint n_output;
+} Bench;
+
+static GstBuffer *
+make_frame (gsize size, guint8 value)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, size, NULL);
+
+  gst_buffer_memset (buf, 0, value, size);
+
+  return buf;
+}
+
+static void
+need_data (GstAppSrc * src, guint length, gpointer user_data)
+{
+  Bench *bench = user_data;
+  GstBuffer *buf;
+
+  if (bench->n_pushed == bench->n_frames) {
+    gst_app_src_end_of_stream (src);
+    return;
+  }
+
+  /* the frames are shared, only the metadata is copied */
+  buf = gst_buffer_copy (bench->frames[bench->n_pushed % 2]);
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) =
+      bench->n_pushed * 40 * GST_MSECOND;
+  GST_BUFFER_DURATION (buf) = 40 * GST_MSECOND;
+  if (bench->n_pushed % 12)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  bench->bytes_in += gst_buffer_get_size (buf);
+  bench->n_pushed++;
+
+  gst_app_src_push_buffer (src, buf);
+}
+
+static void
+handoff (GstElement * fakesink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  Bench *bench = user_data;
+
+  bench->bytes_out += gst_buffer_get_size (buffer);
+  bench->n_output++;
+}
+
+static gboolean
+run_muxer (const Muxer * muxer, gboolean copy_packets, gint n_frames)
+{
+  GstAppSrcCallbacks callbacks = { need_data, NULL, NULL };
+  GstElement *pipeline, *src, *mux, *sink;
+  GstPad *srcpad, *sinkpad;
+  GstCaps *caps;
+  GstMessage *msg;
+  GError *err = NULL;
+  Bench bench = { {NULL, NULL}, };
+  gint64 start, time;
+  gboolean ret = TRUE;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("appsrc", NULL);
+  mux = gst_element_factory_make (muxer->name, NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  if (!src || !mux || !sink) {
+    g_printerr ("Missing appsrc, %s or fakesink\n", muxer->name);
+    if (src)
+      gst_object_unref (src);
+    if (mux)
+      gst_object_unref (mux);
+    if (sink)
+      gst_object_unref (sink);
+    gst_object_unref (pipeline);
+    return FALSE;
+  }
+
+  bench.frames[0] = make_frame (muxer->small_size, 0x11);
+  bench.frames[1] = make_frame (muxer->large_size, 0x22);
+  bench.n_frames = n_frames;
+
+  caps = gst_caps_from_string (muxer->caps);
+  g_object_set (src, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+  gst_caps_unref (caps);
+  gst_app_src_set_callbacks (GST_APP_SRC (src), &callbacks, &bench, NULL);
+  g_object_set (mux, "copy-packets", copy_packets, NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff), &bench);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, mux, sink, NULL);
+  srcpad = gst_element_get_static_pad (src, "src");
+  sinkpad = gst_element_get_request_pad (mux, muxer->sink_pad);
+  gst_pad_link (srcpad, sinkpad);
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+  gst_element_link (mux, sink);
+
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  time = MAX (g_get_monotonic_time () - start, 1);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("Error: %s\n", err->message);
+    g_clear_error (&err);
+    ret = FALSE;
+  } else {
+    g_print ("%-9s %-6s: %" G_GUINT64_FORMAT " bytes in %d frames, %"
+        G_GUINT64_FORMAT " bytes in %u buffers out\n", muxer->name,
+        copy_packets ? "copied" : "pooled", bench.bytes_in, bench.n_pushed,
+        bench.bytes_out, bench.n_output);
+    g_print ("%-9s %-6s: %.3f ms, %.1f MB/s\n", muxer->name,
+        copy_packets ? "copied" : "pooled", time / 1000.0,
+        (gdouble) bench.bytes_in / time);
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  gst_buffer_unref (bench.frames[0]);
+  gst_buffer_unref (bench.frames[1]);
+
+  return ret;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint n_frames = 5000;
+  gchar *muxer_name = NULL;
+  gboolean found = FALSE;
+  gint ret = 0;
+  guint i;
+  GOptionEntry options[] = {
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &n_frames,
+        "Number of frames pushed through each muxer", "N"},
+    {"muxer", 'm', 0, G_OPTION_ARG_STRING, &muxer_name,
+        "Only run asfmux or mpegpsmux", "NAME"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new (NULL);
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (n_frames <= 0) {
+    g_printerr ("Usage: %s [-n N] [-m asfmux|mpegpsmux]\n", argv[0]);
+    g_free (muxer_name);
+    return 1;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (muxers) && ret == 0; i++) {
+    if (muxer_name && strcmp (muxer_name, muxers[i].name) != 0)
+      continue;
+    found = TRUE;
+
+    if (!run_muxer (&muxers[i], FALSE, n_frames) ||
+        !run_muxer (&muxers[i], TRUE, n_frames))
+      ret = 1;
+  }
+
+  if (!found) {
+    g_printerr ("Unknown muxer %s\n", muxer_name);
+    ret = 1;
+  }
+  g_free (muxer_name);
+
+  return ret;
+}
@@ -0,0 +1,131 @@
+/*
+ * aes3-bench.c - Measure the SMPTE 331M AES3 to raw audio conversion
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Converts synthetic D-10 AES3 elements of one edit unit each with the
+ * conversion used by mxfdemux and with a plain per-word loop, reports the
+ * time spent by both and checks that they produce the same samples. */
+
+#include <string.h>
+#include <gst/gst.h>
+
+#include "mxfaes3.h"
+
+static void
+convert_reference (const guint8 * in, guint8 * out, guint nsamples,
+    guint channels, guint width)
+{
+  guint i, j;
+
+  for (i = 0; i < nsamples; i++) {
+    for (j = 0; j < channels; j++) {
+      guint32 v = GST_READ_UINT32_LE (in + 4 * j);
+
+      if (width == 2)
+        GST_WRITE_UINT16_LE (out, v >> 12);
+      else
+        GST_WRITE_UINT24_LE (out, v >> 4);
+      out += width;
+    }
+    in += MXF_AES3_SAMPLE_SIZE;
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint iterations = 2000;
+  gint channels = 8;
+  gint width = 3;
+  gint nsamples = 1920;
+  guint8 *in, *out, *ref;
+  gsize in_size, out_size, k;
+  gint64 start, ref_time, time;
+  GRand *rand;
+  gint i;
+  GOptionEntry options[] = {
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of elements converted", "N"},
+    {"channels", 'c', 0, G_OPTION_ARG_INT, &channels,
+        "Number of channels, 1 to 8", "CHANNELS"},
+    {"width", 'w', 0, G_OPTION_ARG_INT, &width,
+        "Bytes per output sample, 2 or 3", "WIDTH"},
+    {"samples", 's', 0, G_OPTION_ARG_INT, &nsamples,
+        "Samples per element", "SAMPLES"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new (NULL);
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (iterations <= 0 || channels < 1 || channels > MXF_AES3_MAX_CHANNELS
+      || (width != 2 && width != 3) || nsamples <= 0) {
+    g_printerr ("Usage: %s [-n N] [-c CHANNELS] [-w WIDTH] [-s SAMPLES]\n",
+        argv[0]);
+    return 1;
+  }
+
+  in_size = (gsize) nsamples * MXF_AES3_SAMPLE_SIZE;
+  out_size = (gsize) nsamples * channels * width;
+  in = g_malloc (in_size);
+  out = g_malloc (out_size);
+  ref = g_malloc (out_size);
+
+  /* The status bits are random as well, they must not leak into the
+   * samples */
+  rand = g_rand_new_with_seed (0x331);
+  for (k = 0; k < in_size; k += 4)
+    GST_WRITE_UINT32_LE (in + k, g_rand_int (rand));
+  g_rand_free (rand);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    convert_reference (in, ref, nsamples, channels, width);
+  ref_time = MAX (g_get_monotonic_time () - start, 1);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    mxf_aes3_to_pcm (in, out, nsamples, channels, width);
+  time = MAX (g_get_monotonic_time () - start, 1);
+
+  g_print ("%d elements of %d samples, %d channels, %d bits\n", iterations,
+      nsamples, channels, width * 8);
+  g_print ("reference %.3f ms, mxfdemux %.3f ms (%.2fx), %.1f Msamples/s\n",
+      ref_time / 1000.0, time / 1000.0, (gdouble) ref_time / time,
+      (gdouble) nsamples * channels * iterations / time);
+
+  i = memcmp (out, ref, out_size) != 0;
+  if (i)
+    g_print ("converted samples differ\n");
+
+  g_free (in);
+  g_free (out);
+  g_free (ref);
+
+  return i;
+}